@@ -0,0 +1,967 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "semant.h"
+#include "instances.h"
+#include "compiler.h"
+#include "layout.h"
+#include "lower.h"
+#include "vm.h"
+
+//benchmark driver: `benchmarks [filter]` runs every benchmark whose name contains `filter`.
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double millisecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    void report(const char* name, double ms, const std::string& detail = "")
+    {
+        printf("%-40s %10.3f ms  %s\n", name, ms, detail.c_str());
+    }
+
+    std::string moduleSource(int functions)
+    {
+        std::string src = "module Big {\n";
+        for(int i = 0; i < functions; i++)
+        {
+            auto n = std::to_string(i);
+            src.append("    struct R").append(n).append(" { x: Int; y: Double; }\n");
+            src.append("    fn f").append(n).append("(x: Int, y: Int): Int {\n        let z = x;\n        return z;\n    }\n");
+        }
+        src.append("}\nlet result = Big.f0(1, 2);\n");
+        return src;
+    }
+
+    void moduleCache()
+    {
+        auto dir = std::filesystem::temp_directory_path() / "pilaf-bench-interfaces";
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        pilaf::CompileOptions options;
+        options.dumpConstraints = false;
+        options.interfaceCacheDir = dir.string();
+
+        auto src = moduleSource(2000);
+        auto start = Clock::now();
+        auto cold = pilaf::analyze(src.c_str(), options);
+        report("module_cache/cold", millisecondsSince(start), cold ? "" : "(compile failed)");
+
+        start = Clock::now();
+        auto warm = pilaf::analyze(src.c_str(), options);
+        report("module_cache/warm", millisecondsSince(start), warm ? "" : "(compile failed)");
+        std::filesystem::remove_all(dir);
+    }
+
+    std::string annotatedSource(int functions)
+    {
+        std::string src = "struct Point { x: Int; y: Double; }\nfn f0(a: Int, b: Double): Int { return a; }\n";
+        for(int i = 1; i < functions; i++)
+        {
+            auto n = std::to_string(i);
+            auto prev = std::to_string(i - 1);
+            src.append("fn f").append(n).append("(a: Int, b: Double): Int {\n");
+            src.append("    let p: Point = Point { x: a, y: b };\n");
+            src.append("    let scale: Double = 2.5;\n");
+            src.append("    let pair: (Int, Double) = (a, scale);\n");
+            src.append("    let next: Int = f").append(prev).append("(a, b);\n");
+            src.append("    if(true) { return next; } else { return f").append(prev).append("(next, scale); }\n}\n");
+        }
+        src.append("let result = f").append(std::to_string(functions - 1)).append("(1, 2.0);\n");
+        return src;
+    }
+
+    void annotatedConstraints()
+    {
+        pilaf::CompileOptions options;
+        options.dumpConstraints = false;
+        auto src = annotatedSource(2000);
+        auto start = Clock::now();
+        auto program = pilaf::analyze(src.c_str(), options);
+        auto ms = millisecondsSince(start);
+        report("annotated_constraints", ms, program ? std::to_string(program->constraintCount) + " constraints" : "(compile failed)");
+    }
+
+    //unannotated locals, so every binding and array element is left to the constraint builder
+    std::string inferredSource(int functions)
+    {
+        std::string src;
+        for(int i = 0; i < functions; i++)
+        {
+            src.append("fn g").append(std::to_string(i)).append("(a: Int, b: Double): Int {\n");
+            src.append("    let x = a;\n    let y = x;\n    let z = y;\n");
+            src.append("    let xs = [x, y, z, a, 1, 2, 3];\n");
+            src.append("    let t = (x, b);\n    let u = t;\n    let v = u;\n");
+            src.append("    return z;\n}\n");
+        }
+        src.append("let result = g0(1, 2.0);\n");
+        return src;
+    }
+
+    void inferredConstraints()
+    {
+        pilaf::CompileOptions options;
+        options.dumpConstraints = false;
+        auto src = inferredSource(500);
+        auto start = Clock::now();
+        auto program = pilaf::analyze(src.c_str(), options);
+        auto ms = millisecondsSince(start);
+        report("inferred_constraints", ms, program ? std::to_string(program->constraintCount) + " constraints, " + std::to_string(program->constraintsEliminated) + " eliminated" : "(compile failed)");
+    }
+
+    //`(x, Pair y z) -> List (...)` nested `depth` times, with leaves quantified or all Int
+    std::shared_ptr<pilaf::Ty> nestedSignature(int depth, bool quantified)
+    {
+        auto leaf = [&](int i) -> std::shared_ptr<pilaf::Ty>
+        {
+            if(quantified) return std::make_shared<pilaf::TyVar>(std::string(1, (char)('a' + i % 6)));
+            return std::make_shared<pilaf::TyBasic>("Int");
+        };
+        std::shared_ptr<pilaf::Ty> t = leaf(0);
+        for(int i = 0; i < depth; i++)
+        {
+            auto pair = std::make_shared<pilaf::TyAppl>(std::make_shared<pilaf::TyBasic>("Pair"), std::vector<std::shared_ptr<pilaf::Ty>>{leaf(i + 1), leaf(i + 2)});
+            auto list = std::make_shared<pilaf::TyAppl>(std::make_shared<pilaf::TyBasic>("List"), std::vector<std::shared_ptr<pilaf::Ty>>{t});
+            t = std::make_shared<pilaf::TyFunc>(std::make_shared<pilaf::TyTuple>(std::vector<std::shared_ptr<pilaf::Ty>>{leaf(i), pair}), list);
+        }
+        return t;
+    }
+
+    void genericInstantiation()
+    {
+        const int iterations = 20000;
+        for(bool quantified : {true, false})
+        {
+            auto signature = nestedSignature(64, quantified);
+            size_t shared = 0;
+            auto start = Clock::now();
+            for(int i = 0; i < iterations; i++)
+            {
+                pilaf::TypeVarMap map;
+                shared += pilaf::generic(signature, map) == signature;
+            }
+            report(quantified ? "generic_instantiation/quantified" : "generic_instantiation/monotype", millisecondsSince(start),
+                std::to_string(shared) + "/" + std::to_string(iterations) + " returned unchanged");
+        }
+    }
+
+    void instanceLookup()
+    {
+        const int classes = 100, instances = 100, lookups = 1000000;
+        std::string src;
+        for(int t = 0; t < instances; t++) src.append("struct T").append(std::to_string(t)).append(" { x: Int; }\n");
+        for(int c = 0; c < classes; c++)
+        {
+            auto n = std::to_string(c);
+            src.append("class C").append(n).append(" a { fn m").append(n).append("(x: a): Int; }\n");
+            for(int t = 0; t < instances; t++)
+            {
+                auto ty = "T" + std::to_string(t);
+                src.append("implement C").append(n).append(" ").append(ty).append(" { fn m").append(n).append("(x: ").append(ty).append("): Int { return 1; } }\n");
+            }
+        }
+        auto start = Clock::now();
+        auto program = pilaf::parse(src.c_str());
+        report("instance_lookup/declare", millisecondsSince(start), program ? "" : "(parse failed)");
+        if(program == nullptr) return;
+
+        std::vector<pilaf::Symbol> methods;
+        std::vector<std::shared_ptr<pilaf::Ty>> types;
+        for(int c = 0; c < classes; c++) methods.push_back(pilaf::intern("m" + std::to_string(c)));
+        for(int t = 0; t < instances; t++) types.push_back(std::make_shared<pilaf::TyBasic>("T" + std::to_string(t)));
+        int found = 0;
+        start = Clock::now();
+        for(int i = 0; i < lookups; i++)
+        {
+            found += pilaf::resolveMethod(program->globalScope, methods[i % classes], types[(i / classes) % instances]) != nullptr;
+        }
+        report("instance_lookup/resolve", millisecondsSince(start), std::to_string(found) + "/" + std::to_string(lookups) + " resolved");
+    }
+
+    //a million constraints between fresh variables and a pool of shared signatures, as generic leaves them
+    //asks every top-level declaration of a program with deeply nested bodies whether it contains an error
+    void errorFlag()
+    {
+        std::string src;
+        for(int i = 0; i < 2000; i++)
+        {
+            src.append("fn f").append(std::to_string(i)).append("(x: Int): Int {\n");
+            for(int depth = 0; depth < 8; depth++) src.append("if(x) { let y = (x, (x, x)); x = f0(x); ");
+            for(int depth = 0; depth < 8; depth++) src.append("} else { return x; }\n");
+            src.append("return x;\n}\n");
+        }
+        auto program = pilaf::parse(src.c_str());
+        const int rounds = 100;
+        size_t errors = 0;
+        auto start = Clock::now();
+        for(int r = 0; r < rounds; r++)
+        {
+            for(auto& dec : program->declarations) errors += dec->hasError();
+        }
+        auto ms = millisecondsSince(start);
+        report("error_flag", ms, std::to_string(rounds * program->declarations.size()) + " queries, " + std::to_string(errors) + " with errors");
+    }
+
+    void constraintDump()
+    {
+        std::vector<std::shared_ptr<pilaf::Ty>> signatures;
+        for(int i = 0; i < 64; i++) signatures.push_back(nestedSignature(4 + i % 8, false));
+        auto scope = std::make_shared<pilaf::ScopeNode>();
+        for(int i = 0; i < 1000000; i++)
+        {
+            auto sig = signatures[i % signatures.size()];
+            if(i % 4 == 0) sig = std::make_shared<pilaf::TyTuple>(std::vector<std::shared_ptr<pilaf::Ty>>{sig, pilaf::newGenericType()});
+            scope->constraints.emplace_back(pilaf::newGenericType(), sig);
+        }
+        auto out = tmpfile();
+        if(out == nullptr) return;
+        auto start = Clock::now();
+        pilaf::printConstraints(scope, out);
+        fflush(out);
+        auto ms = millisecondsSince(start);
+        report("constraint_dump", ms, std::to_string(ftell(out) >> 20) + " MiB for " + std::to_string(scope->constraints.size()) + " constraints");
+        fclose(out);
+    }
+
+    //reports type errors, so it has to run after every benchmark that expects a clean program
+    void diagnostics()
+    {
+        std::string src = "let a = 1;\n";
+        for(int i = 0; i < 20000; i++)
+        {
+            src.append("let b").append(std::to_string(i)).append(" = a.nope;\n");
+        }
+        pilaf::DiagnosticEngine engine(src.c_str());
+        pilaf::CompileOptions options;
+        options.dumpConstraints = false;
+        options.diagnostics = &engine;
+        auto start = Clock::now();
+        pilaf::analyze(src.c_str(), options);
+        auto ms = millisecondsSince(start);
+        report("diagnostics_analyze", ms, std::to_string(engine.errorCount()) + " errors recorded");
+        auto out = tmpfile();
+        if(out == nullptr) return;
+        start = Clock::now();
+        engine.render(out, options.diagnosticFormat, options.maxDiagnostics);
+        fflush(out);
+        ms = millisecondsSince(start);
+        report("diagnostics_render", ms, std::to_string(ftell(out) >> 10) + " KiB for the first " + std::to_string(options.maxDiagnostics));
+        fclose(out);
+    }
+
+    //one compile of a file with independent syntax, field and solver errors in every tenth declaration
+    void errorRecovery()
+    {
+        std::string src = "struct Point { x: Int; y: Double; }\nfn pick(x, y) { let z = x; z = y; return z; }\nlet p = Point { x: 1, y: 2.0 };\n";
+        int planted = 0;
+        for(int i = 0; i < 3000; i++)
+        {
+            auto n = std::to_string(i);
+            switch(i % 30)
+            {
+                case 0: src.append("let e").append(n).append(" = ;\n"); planted++; break;
+                case 10: src.append("let e").append(n).append(" = p.nope;\n"); planted++; break;
+                case 20: src.append("let e").append(n).append(" = pick(1, 2.0);\n"); planted++; break;
+                default: src.append("let v").append(n).append(" = p.y;\n"); break;
+            }
+        }
+        pilaf::DiagnosticEngine engine(src.c_str());
+        pilaf::CompileOptions options;
+        options.dumpConstraints = false;
+        options.diagnostics = &engine;
+        auto start = Clock::now();
+        pilaf::analyze(src.c_str(), options);
+        auto ms = millisecondsSince(start);
+        report("error_recovery", ms, std::to_string(engine.errorCount()) + " of " + std::to_string(planted) + " errors reported by one compile");
+    }
+
+    //`functions` annotated functions whose bodies hold `statements` statements each
+    std::string bodySource(int functions, int statements)
+    {
+        std::string src;
+        for(int i = 0; i < functions; i++)
+        {
+            src.append("fn f").append(std::to_string(i)).append("(x: Int, y: Int): Int {\n");
+            for(int s = 0; s < statements; s++) src.append("    let v").append(std::to_string(s)).append(" = x;\n");
+            src.append("    return x;\n}\n");
+        }
+        return src;
+    }
+
+    void lazyParsing()
+    {
+        const int functions = 1000;
+        for(int statements : {10, 100})
+        {
+            auto src = bodySource(functions, statements);
+            auto detail = std::to_string(functions) + " functions of " + std::to_string(statements) + " statements";
+            pilaf::CompileOptions options;
+            options.dumpConstraints = false;
+            auto start = Clock::now();
+            auto eager = pilaf::parse(src.c_str(), options);
+            report("lazy_parsing/eager", millisecondsSince(start), detail);
+
+            options.lazyBodies = true;
+            start = Clock::now();
+            auto lazy = pilaf::parse(src.c_str(), options);
+            report("lazy_parsing/lazy", millisecondsSince(start), detail);
+
+            options.signaturesOnly = true;
+            start = Clock::now();
+            auto checked = pilaf::analyze(src.c_str(), options);
+            report("lazy_parsing/check_signatures", millisecondsSince(start), checked ? detail : "(check failed)");
+        }
+    }
+
+    void parallelParsing()
+    {
+        const int functions = 4000;
+        const int statements = 20;
+        auto src = bodySource(functions, statements);
+        auto detail = std::to_string(src.size() / 1024) + " KiB";
+        for(size_t threads : {1, 2, 4, 8})
+        {
+            pilaf::CompileOptions options;
+            options.parseThreads = threads;
+            auto start = Clock::now();
+            auto ast = pilaf::parse(src.c_str(), options);
+            auto name = "parallel_parsing/" + std::to_string(threads) + "_threads";
+            //the sequential parser is the fallback whenever the pre-scan gives up, so make sure it was not taken
+            auto took = ast->parseThreads == threads ? detail : detail + " (parsed on " + std::to_string(ast->parseThreads) + " threads)";
+            report(name.c_str(), millisecondsSince(start), ast->declarations.size() == functions ? took : "(parse failed)");
+        }
+    }
+
+    const char* vmPrograms[][2] = {
+        {"fib", "infix (+) 6; infix (-) 6; infix (<) 4;\n"
+            "fn fib(n: Int): Int {\n    if (n < 2) return n;\n    return fib(n - 1) + fib(n - 2);\n}\n"
+            "fn main(): Int { return fib(30); }\n"},
+        {"nbody", "infix (+) 6; infix (-) 6; infix (*) 7; infix (/) 7; infix (<) 4;\n"
+            "struct Body { x: Double; y: Double; z: Double; vx: Double; vy: Double; vz: Double; mass: Double; }\n"
+            "fn sqrt(x: Double): Double;\n"
+            "fn advance(bodies: Body[], n: Int, dt: Double) {\n"
+            "    for (let i = 0; i < n; i = i + 1) {\n"
+            "        let a = bodies[i];\n"
+            "        for (let j = i + 1; j < n; j = j + 1) {\n"
+            "            let b = bodies[j];\n"
+            "            let dx = a.x - b.x;\n            let dy = a.y - b.y;\n            let dz = a.z - b.z;\n"
+            "            let d2 = dx * dx + dy * dy + dz * dz;\n"
+            "            let mag = dt / (d2 * sqrt(d2));\n"
+            "            a.vx = a.vx - dx * b.mass * mag;\n            a.vy = a.vy - dy * b.mass * mag;\n            a.vz = a.vz - dz * b.mass * mag;\n"
+            "            b.vx = b.vx + dx * a.mass * mag;\n            b.vy = b.vy + dy * a.mass * mag;\n            b.vz = b.vz + dz * a.mass * mag;\n"
+            "        }\n"
+            "    }\n"
+            "    for (let i = 0; i < n; i = i + 1) {\n"
+            "        let body = bodies[i];\n"
+            "        body.x = body.x + dt * body.vx;\n        body.y = body.y + dt * body.vy;\n        body.z = body.z + dt * body.vz;\n"
+            "    }\n"
+            "}\n"
+            "fn energy(bodies: Body[], n: Int): Double {\n"
+            "    let e = 0.0;\n"
+            "    for (let i = 0; i < n; i = i + 1) {\n"
+            "        let a = bodies[i];\n"
+            "        e = e + 0.5 * a.mass * (a.vx * a.vx + a.vy * a.vy + a.vz * a.vz);\n"
+            "        for (let j = i + 1; j < n; j = j + 1) {\n"
+            "            let b = bodies[j];\n"
+            "            let dx = a.x - b.x;\n            let dy = a.y - b.y;\n            let dz = a.z - b.z;\n"
+            "            e = e - a.mass * b.mass / sqrt(dx * dx + dy * dy + dz * dz);\n"
+            "        }\n"
+            "    }\n"
+            "    return e;\n"
+            "}\n"
+            "fn main(): Double {\n"
+            "    let bodies = [Body { x: 0.0, y: 0.0, z: 0.0, vx: 0.0, vy: 0.0, vz: 0.0, mass: 39.47 },\n"
+            "        Body { x: 4.84, y: 1.16, z: 0.10, vx: 0.61, vy: 2.81, vz: 0.02, mass: 0.037 },\n"
+            "        Body { x: 8.34, y: 4.12, z: 0.40, vx: 1.53, vy: 1.86, vz: 0.01, mass: 0.011 },\n"
+            "        Body { x: 12.89, y: 15.11, z: 0.22, vx: 1.08, vy: 0.86, vz: 0.01, mass: 0.0017 },\n"
+            "        Body { x: 15.37, y: 25.91, z: 0.17, vx: 0.97, vy: 0.59, vz: 0.03, mass: 0.002 }];\n"
+            "    for (let step = 0; step < 100000; step = step + 1) { advance(bodies, 5, 0.01); }\n"
+            "    return energy(bodies, 5);\n"
+            "}\n"},
+        {"sieve", "infix (+) 6; infix (*) 7; infix (<) 4; infix (<=) 4;\n"
+            "fn array(n: Int, value: a): a[];\n"
+            "fn sieve(n: Int): Int {\n"
+            "    let composite = array(n + 1, false);\n"
+            "    let count = 0;\n"
+            "    for (let i = 2; i <= n; i = i + 1) {\n"
+            "        if (composite[i]) continue;\n"
+            "        count = count + 1;\n"
+            "        for (let j = i * i; j <= n; j = j + i) { composite[j] = true; }\n"
+            "    }\n"
+            "    return count;\n"
+            "}\n"
+            "fn main(): Int {\n"
+            "    let count = 0;\n"
+            "    for (let round = 0; round < 20; round = round + 1) { count = sieve(1000000); }\n"
+            "    return count;\n"
+            "}\n"},
+    };
+
+    void interpreter()
+    {
+        for(auto& program : vmPrograms)
+        {
+            pilaf::CompileOptions options;
+            options.dumpConstraints = false;
+            auto module = pilaf::compileBytecode(program[1], options);
+            auto name = std::string("interpreter/") + program[0];
+            if(module == nullptr)
+            {
+                report(name.c_str(), 0, "(compile failed)");
+                continue;
+            }
+            pilaf::VM vm(*module);
+            pilaf::Value result;
+            auto start = Clock::now();
+            bool ok = vm.run(result);
+            auto ms = millisecondsSince(start);
+            report(name.c_str(), ms, ok ? pilaf::valueToString(result, *module) + ", " + pilaf::dispatchMode() + " dispatch" : vm.error());
+        }
+    }
+
+    //many small functions with branches and loops, so that phis and blocks are exercised
+    std::string loopSource(int functions)
+    {
+        std::string src = "infix (+) 6; infix (*) 7; infix (<) 4; infix (==) 3;\n";
+        for(int i = 0; i < functions; i++)
+        {
+            src.append("fn f").append(std::to_string(i)).append("(n: Int): Int {\n");
+            src.append("    let total = 0;\n    for (let i = 0; i < n; i = i + 1) {\n");
+            src.append("        if (i == 3) continue;\n        total = total + i * ").append(std::to_string(i)).append(";\n    }\n");
+            src.append("    return total;\n}\n");
+        }
+        return src;
+    }
+
+    void irFootprint()
+    {
+        std::vector<std::pair<std::string, std::string>> programs;
+        for(auto& program : vmPrograms) programs.emplace_back(program[0], program[1]);
+        programs.emplace_back("loops", loopSource(2000));
+        for(auto& program : programs)
+        {
+            auto name = "ir_footprint/" + program.first;
+            pilaf::DiagnosticEngine engine(program.second.c_str());
+            pilaf::CompileOptions options;
+            options.dumpConstraints = false;
+            options.diagnostics = &engine;
+            auto ast = pilaf::analyze(program.second.c_str(), options);
+            if(ast == nullptr)
+            {
+                report(name.c_str(), 0, "(compile failed)");
+                continue;
+            }
+            auto start = Clock::now();
+            auto module = pilaf::lowerProgram(ast, program.second.c_str(), engine);
+            auto ms = millisecondsSince(start);
+            if(module == nullptr)
+            {
+                report(name.c_str(), ms, "(lowering failed)");
+                continue;
+            }
+            size_t instructions = 0;
+            for(auto& f : module->functions) instructions += f.instructions.size();
+            auto bytes = module->footprint();
+            report(name.c_str(), ms, std::to_string(module->sourceNodes) + " nodes, " + std::to_string(instructions) + " instructions, "
+                + std::to_string(bytes / module->sourceNodes) + " bytes per node");
+        }
+    }
+
+    //a loop whose body mostly recomputes values that are known before it runs or do not change in it
+    const char* invariantSource =
+        "infix (+) 6; infix (-) 6; infix (*) 7; infix (<) 4;\n"
+        "struct Grid { width: Int; height: Int; scale: Int; }\n"
+        "fn weigh(g: Grid, n: Int): Int {\n"
+        "    let total = 0;\n"
+        "    for (let i = 0; i < n; i = i + 1) {\n"
+        "        let area = g.width * g.height;\n"
+        "        let day = 60 * 60 * 24;\n"
+        "        let bias = n * 2 - 1;\n"
+        "        total = total + i * g.scale + area - day + g.width * g.height - bias;\n"
+        "    }\n"
+        "    return total;\n"
+        "}\n"
+        "fn main(): Int { return weigh(Grid { width: 640, height: 480, scale: 3 }, 3000000); }\n";
+
+    //numeric kernels written with operators and class methods the program defines itself, which
+    //are only fast once those calls are inlined
+    const char* operatorPrograms[][2] = {
+        {"mandelbrot",
+            "infix (+) 6; infix (-) 6; infix (*) 7; infix (<) 4;\n"
+            "struct Complex { re: Double; im: Double; }\n"
+            "fn toDouble(x: Int): Double;\n"
+            "fn (+)(a: Complex, b: Complex): Complex { return Complex { re: a.re + b.re, im: a.im + b.im }; }\n"
+            "fn (*)(a: Complex, b: Complex): Complex { return Complex { re: a.re * b.re - a.im * b.im, im: a.re * b.im + a.im * b.re }; }\n"
+            "class Magnitude m { fn magnitude(x: m): Double; }\n"
+            "implement Magnitude Complex { fn magnitude(x: Complex): Double { return x.re * x.re + x.im * x.im; } }\n"
+            "fn norm(z: Complex): Double { return magnitude(z); }\n"
+            "fn escapes(c: Complex, limit: Int): Int {\n"
+            "    let z = Complex { re: 0.0, im: 0.0 };\n"
+            "    for (let i = 0; i < limit; i = i + 1) {\n"
+            "        z = z * z + c;\n"
+            "        if (4.0 < norm(z)) return i;\n"
+            "    }\n"
+            "    return limit;\n"
+            "}\n"
+            "fn main(): Int {\n"
+            "    let total = 0;\n"
+            "    for (let y = 0; y < 120; y = y + 1) {\n"
+            "        for (let x = 0; x < 160; x = x + 1) {\n"
+            "            let c = Complex { re: toDouble(x) * 0.01875 - 2.0, im: toDouble(y) * 0.01875 - 1.125 };\n"
+            "            total = total + escapes(c, 200);\n"
+            "        }\n"
+            "    }\n"
+            "    return total;\n"
+            "}\n"},
+        {"vectors",
+            "infix (+) 6; infix (-) 6; infix (*) 7; infix (<) 4;\n"
+            "struct Vec3 { x: Double; y: Double; z: Double; }\n"
+            "fn (+)(a: Vec3, b: Vec3): Vec3 { return Vec3 { x: a.x + b.x, y: a.y + b.y, z: a.z + b.z }; }\n"
+            "fn (*)(a: Vec3, b: Vec3): Vec3 { return Vec3 { x: a.x * b.x, y: a.y * b.y, z: a.z * b.z }; }\n"
+            "fn dot(a: Vec3, b: Vec3): Double { return a.x * b.x + a.y * b.y + a.z * b.z; }\n"
+            "fn main(): Double {\n"
+            "    let p = Vec3 { x: 0.0, y: 0.0, z: 0.0 };\n"
+            "    let v = Vec3 { x: 0.5, y: 0.25, z: 0.125 };\n"
+            "    let g = Vec3 { x: 0.0, y: 0.0 - 0.001, z: 0.0 };\n"
+            "    let dt = Vec3 { x: 0.01, y: 0.01, z: 0.01 };\n"
+            "    let e = 0.0;\n"
+            "    for (let i = 0; i < 1000000; i = i + 1) {\n"
+            "        v = v + g * dt;\n"
+            "        p = p + v * dt;\n"
+            "        e = e + dot(v, v);\n"
+            "    }\n"
+            "    return e + dot(p, p);\n"
+            "}\n"},
+    };
+
+    void optimizer()
+    {
+        std::vector<std::pair<std::string, std::string>> programs;
+        for(auto& program : vmPrograms) programs.emplace_back(program[0], program[1]);
+        programs.emplace_back("invariants", invariantSource);
+        for(auto& program : operatorPrograms) programs.emplace_back(program[0], program[1]);
+        for(auto& program : programs)
+        {
+            for(int level = 0; level <= 2; level++)
+            {
+                auto name = "optimizer/" + program.first + "/O" + std::to_string(level);
+                pilaf::CompileOptions options;
+                options.dumpConstraints = false;
+                options.optLevel = level;
+                auto module = pilaf::compileBytecode(program.second.c_str(), options);
+                if(module == nullptr)
+                {
+                    report(name.c_str(), 0, "(compile failed)");
+                    continue;
+                }
+                size_t instructions = 0;
+                for(auto& f : module->functions) instructions += f.code.size();
+                pilaf::VM vm(*module);
+                pilaf::Value result;
+                auto start = Clock::now();
+                bool ok = vm.run(result);
+                auto ms = millisecondsSince(start);
+                report(name.c_str(), ms, (ok ? pilaf::valueToString(result, *module) : vm.error()) + ", "
+                    + std::to_string(instructions) + " instructions");
+            }
+        }
+    }
+
+    //the same programs built ahead of time through C at -O2; the time is the executable's, apart
+    //from building it
+    void native()
+    {
+        std::vector<std::pair<std::string, std::string>> programs;
+        for(auto& program : vmPrograms) programs.emplace_back(program[0], program[1]);
+        for(auto& program : operatorPrograms) programs.emplace_back(program[0], program[1]);
+        auto exe = (std::filesystem::temp_directory_path() / "pilaf-bench-native").string();
+        for(auto& program : programs)
+        {
+            auto name = "native/" + program.first;
+            pilaf::CompileOptions options;
+            options.dumpConstraints = false;
+            options.optLevel = 2;
+            auto start = Clock::now();
+            if(pilaf::build(program.second, options, exe) != 0)
+            {
+                report(name.c_str(), 0, "(build failed)");
+                continue;
+            }
+            auto buildMs = millisecondsSince(start);
+            std::string output;
+            start = Clock::now();
+            auto pipe = popen(("'" + exe + "'").c_str(), "r");
+            char buffer[256];
+            size_t n;
+            while(pipe != nullptr && (n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) output.append(buffer, n);
+            bool ok = pipe != nullptr && pclose(pipe) == 0;
+            auto ms = millisecondsSince(start);
+            if(!output.empty() && output.back() == '\n') output.pop_back();
+            char built[32];
+            snprintf(built, sizeof(built), "%.0f", buildMs);
+            report(name.c_str(), ms, (ok ? output : "(failed)") + ", built in " + built + " ms");
+        }
+        std::filesystem::remove(exe);
+    }
+
+    //loops over Ints and Doubles only, which the JIT compiles whole
+    const char* scalarPrograms[][2] = {
+        {"collatz", "infix (+) 6; infix (*) 7; infix (/) 7; infix (%) 7; infix (<) 4; infix (==) 3;\n"
+            "fn steps(n: Int): Int {\n"
+            "    let m = n;\n"
+            "    let count = 0;\n"
+            "    while (1 < m) {\n"
+            "        if (m % 2 == 0) m = m / 2;\n"
+            "        else m = 3 * m + 1;\n"
+            "        count = count + 1;\n"
+            "    }\n"
+            "    return count;\n"
+            "}\n"
+            "fn main(): Int {\n"
+            "    let best = 0;\n"
+            "    let which = 0;\n"
+            "    for (let i = 1; i < 300000; i = i + 1) {\n"
+            "        let s = steps(i);\n"
+            "        if (best < s) {\n"
+            "            best = s;\n"
+            "            which = i;\n"
+            "        }\n"
+            "    }\n"
+            "    return which;\n"
+            "}\n"},
+        {"escape_time", "infix (+) 6; infix (-) 6; infix (*) 7; infix (<) 4;\n"
+            "fn toDouble(x: Int): Double;\n"
+            "fn escapes(cr: Double, ci: Double, limit: Int): Int {\n"
+            "    let zr = 0.0;\n"
+            "    let zi = 0.0;\n"
+            "    for (let i = 0; i < limit; i = i + 1) {\n"
+            "        let t = zr * zr - zi * zi + cr;\n"
+            "        zi = 2.0 * zr * zi + ci;\n"
+            "        zr = t;\n"
+            "        if (4.0 < zr * zr + zi * zi) return i;\n"
+            "    }\n"
+            "    return limit;\n"
+            "}\n"
+            "fn main(): Int {\n"
+            "    let total = 0;\n"
+            "    for (let y = 0; y < 120; y = y + 1) {\n"
+            "        for (let x = 0; x < 160; x = x + 1) {\n"
+            "            total = total + escapes(toDouble(x) * 0.01875 - 2.0, toDouble(y) * 0.01875 - 1.125, 200);\n"
+            "        }\n"
+            "    }\n"
+            "    return total;\n"
+            "}\n"},
+    };
+
+    //the interpreter at -O1, and again with functions compiled to machine code after 1000 calls. at
+    //-O2 the kernels would be inlined into main, which is only called once
+    void jit()
+    {
+        std::vector<std::pair<std::string, std::string>> programs;
+        programs.emplace_back(vmPrograms[0][0], vmPrograms[0][1]);
+        for(auto& program : scalarPrograms) programs.emplace_back(program[0], program[1]);
+        for(auto& program : programs)
+        {
+            pilaf::CompileOptions options;
+            options.dumpConstraints = false;
+            options.optLevel = 1;
+            auto module = pilaf::compileBytecode(program.second.c_str(), options);
+            for(uint32_t threshold : {0u, 1000u})
+            {
+                auto name = "jit/" + program.first + (threshold == 0 ? "/interpreted" : "/compiled");
+                if(module == nullptr)
+                {
+                    report(name.c_str(), 0, "(compile failed)");
+                    continue;
+                }
+                pilaf::VM vm(*module);
+                vm.setJitThreshold(threshold);
+                pilaf::Value result;
+                auto start = Clock::now();
+                bool ok = vm.run(result);
+                auto ms = millisecondsSince(start);
+                report(name.c_str(), ms, (ok ? pilaf::valueToString(result, *module) : vm.error()) + ", "
+                    + std::to_string(vm.compiledCalls()) + " calls to machine code");
+            }
+        }
+    }
+
+    //a toy machine dispatching on dense opcodes, and a classifier over ranges and union members,
+    //both of which compile to decision trees
+    const char* matchPrograms[][2] = {
+        {"dispatch", "infix (+) 6; infix (-) 6; infix (*) 7; infix (%) 7; infix (<) 4;\n"
+            "fn step(op: Int, acc: Int): Int {\n"
+            "    switch (op) {\n"
+            "        case 0: return acc + 1;\n"
+            "        case 1: return acc - 3;\n"
+            "        case 2: return acc * 2 % 1000003;\n"
+            "        case 3: return acc + 7;\n"
+            "        case 4: return acc * 3 % 1000003;\n"
+            "        case 5: return acc - 1;\n"
+            "        case 6: return acc + 11;\n"
+            "        case 7: return acc * 5 % 1000003;\n"
+            "        case _: return acc;\n"
+            "    }\n"
+            "    return acc;\n"
+            "}\n"
+            "fn main(): Int {\n"
+            "    let acc = 1;\n"
+            "    for (let i = 0; i < 2000000; i = i + 1) { acc = step(i * 7 % 9, acc); }\n"
+            "    return acc;\n"
+            "}\n"},
+        {"classify", "infix (+) 6; infix (-) 6; infix (*) 7; infix (%) 7; infix (<) 4;\n"
+            "union Token { Number(Int), Word(Int, Int), End }\n"
+            "fn weight(t: Token): Int {\n"
+            "    switch (t) {\n"
+            "        case Number(0...9): return 1;\n"
+            "        case Number(10..100): return 2;\n"
+            "        case Number(_): return 3;\n"
+            "        case Word(0, n): return n;\n"
+            "        case Word(_, 1): return 5;\n"
+            "        case Word(k, n): return k + n;\n"
+            "        case End: return 0;\n"
+            "    }\n"
+            "    return 0;\n"
+            "}\n"
+            "fn main(): Int {\n"
+            "    let total = 0;\n"
+            "    for (let i = 0; i < 1000000; i = i + 1) {\n"
+            "        total = total + weight(Number(i % 200)) + weight(Word(i % 3, i % 5));\n"
+            "    }\n"
+            "    return total + weight(End);\n"
+            "}\n"},
+    };
+
+    void match()
+    {
+        for(auto& program : matchPrograms)
+        {
+            pilaf::CompileOptions options;
+            options.dumpConstraints = false;
+            options.optLevel = 1;
+            auto name = std::string("match/") + program[0];
+            auto module = pilaf::compileBytecode(program[1], options);
+            if(module == nullptr)
+            {
+                report(name.c_str(), 0, "(compile failed)");
+                continue;
+            }
+            pilaf::VM vm(*module);
+            pilaf::Value result;
+            auto start = Clock::now();
+            bool ok = vm.run(result);
+            auto ms = millisecondsSince(start);
+            report(name.c_str(), ms, ok ? pilaf::valueToString(result, *module) : vm.error());
+        }
+    }
+
+    //a chain of records linked through a union with one empty member, built and walked natively
+    const char* layoutPrograms[][2] = {
+        {"chain", "infix (+) 6; infix (-) 6; infix (%) 7; infix (<) 4; infix (==) 3;\n"
+            "struct Cell { alive: Bool; value: Int; marked: Bool; next: Chain; }\n"
+            "union Chain { Link(Cell), Stop }\n"
+            "fn every(i: Int, n: Int): Bool {\n"
+            "    if (i % n == 0) return true;\n"
+            "    return false;\n"
+            "}\n"
+            "fn sum(c: Chain): Int {\n"
+            "    let total = 0;\n"
+            "    let at = c;\n"
+            "    while (true) {\n"
+            "        switch (at) {\n"
+            "            case Link(cell): {\n"
+            "                if (cell.alive) total = (total + cell.value) % 1000003;\n"
+            "                at = cell.next;\n"
+            "            }\n"
+            "            case Stop: return total;\n"
+            "        }\n"
+            "    }\n"
+            "    return 0;\n"
+            "}\n"
+            "fn main(): Int {\n"
+            "    let total = 0;\n"
+            "    for (let round = 0; round < 20; round = round + 1) {\n"
+            "        let c = Stop;\n"
+            "        for (let i = 0; i < 200000; i = i + 1) {\n"
+            "            c = Link(Cell { alive: every(i, 3), value: i + round, marked: false, next: c });\n"
+            "        }\n"
+            "        total = (total + sum(c)) % 1000003;\n"
+            "    }\n"
+            "    return total;\n"
+            "}\n"},
+    };
+
+    void layouts()
+    {
+        auto exe = (std::filesystem::temp_directory_path() / "pilaf-bench-layouts").string();
+        for(auto& program : layoutPrograms)
+        {
+            auto name = std::string("layouts/") + program[0];
+            pilaf::CompileOptions options;
+            options.dumpConstraints = false;
+            options.optLevel = 2;
+            auto module = pilaf::compileIr(program[1], options);
+            if(module == nullptr || pilaf::build(program[1], options, exe) != 0)
+            {
+                report(name.c_str(), 0, "(build failed)");
+                continue;
+            }
+            //bytes of data per record, against what declaration order with a stored tag would take
+            pilaf::LayoutEngine engine(*module);
+            uint32_t bytes = 0, declared = 0;
+            for(uint32_t l = 0; l < module->layouts.size(); l++)
+            {
+                auto& d = engine.ofLayout(l);
+                bytes += d.size;
+                //a union whose tag is in a niche would store it in another word of its alignment
+                if(module->layouts[l].isUnion) declared += d.dataful != pilaf::irNone ? d.size + d.align : d.size;
+                else declared += pilaf::LayoutEngine::place(d.kinds, true).size;
+            }
+            std::string output;
+            auto start = Clock::now();
+            auto pipe = popen(("'" + exe + "'").c_str(), "r");
+            char buffer[256];
+            size_t n;
+            while(pipe != nullptr && (n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) output.append(buffer, n);
+            bool ok = pipe != nullptr && pclose(pipe) == 0;
+            auto ms = millisecondsSince(start);
+            if(!output.empty() && output.back() == '\n') output.pop_back();
+            report(name.c_str(), ms, (ok ? output : "(failed)") + ", " + std::to_string(bytes) + " bytes of records, "
+                + std::to_string(declared) + " in declaration order");
+        }
+        std::filesystem::remove(exe);
+    }
+
+    //lambdas that capture a local, made once per iteration and passed to map and fold
+    const char* closurePrograms[][2] = {
+        {"map", "infix (+) 6; infix (*) 7; infix (%) 7; infix (<) 4;\n"
+            "fn array(n: Int, value: a): a[];\n"
+            "fn length(xs: a[]): Int;\n"
+            "fn map(f: Int -> Int, xs: Int[]) {\n"
+            "    for (let i = 0; i < length(xs); i = i + 1) { xs[i] = f(xs[i]); }\n"
+            "}\n"
+            "fn main(): Int {\n"
+            "    let xs = array(1000, 1);\n"
+            "    for (let round = 0; round < 2000; round = round + 1) {\n"
+            "        map(lambda(x: Int) { return (x * 3 + round) % 1000003; }, xs);\n"
+            "    }\n"
+            "    return xs[999];\n"
+            "}\n"},
+        {"fold", "infix (+) 6; infix (-) 6; infix (*) 7; infix (%) 7; infix (<) 4;\n"
+            "fn fold(f: Int -> Int -> Int, acc: Int, n: Int): Int {\n"
+            "    if (n < 1) return acc;\n"
+            "    return fold(f, f(acc, n), n - 1);\n"
+            "}\n"
+            "fn main(): Int {\n"
+            "    let total = 0;\n"
+            "    for (let i = 0; i < 200000; i = i + 1) {\n"
+            "        total = (total + fold(lambda(a: Int, x: Int) { return (a + x * i) % 1000003; }, 0, 8)) % 1000003;\n"
+            "    }\n"
+            "    return total;\n"
+            "}\n"},
+    };
+
+    void closures()
+    {
+        for(auto& program : closurePrograms)
+        {
+            //without optimization every closure is made on the heap
+            for(int level : {0, 2})
+            {
+                pilaf::CompileOptions options;
+                options.dumpConstraints = false;
+                options.optLevel = level;
+                auto name = std::string("closures/") + program[0] + "/O" + std::to_string(level);
+                auto module = pilaf::compileBytecode(program[1], options);
+                if(module == nullptr)
+                {
+                    report(name.c_str(), 0, "(compile failed)");
+                    continue;
+                }
+                pilaf::VM vm(*module);
+                pilaf::Value result;
+                auto start = Clock::now();
+                bool ok = vm.run(result);
+                auto ms = millisecondsSince(start);
+                report(name.c_str(), ms, ok ? pilaf::valueToString(result, *module) + ", " + std::to_string(vm.allocations()) + " heap objects" : vm.error());
+            }
+        }
+    }
+
+    //ten million calls deep in each function, which only runs when every call is a jump
+    const char* tailCallProgram = "infix (+) 6; infix (-) 6; infix (==) 3;\n"
+        "fn isEven(n: Int): Bool { if (n == 0) return true; return isOdd(n - 1); }\n"
+        "fn isOdd(n: Int): Bool { if (n == 0) return false; return isEven(n - 1); }\n"
+        "fn count(n: Int, acc: Int): Int { if (n == 0) return acc; return count(n - 1, acc + 1); }\n"
+        "fn main(): Int {\n"
+        "    if (isEven(10000000)) return count(10000000, 0);\n"
+        "    return 0;\n"
+        "}\n";
+
+    void tailCalls()
+    {
+        pilaf::CompileOptions options;
+        options.dumpConstraints = false;
+        options.optLevel = 2;
+        auto module = pilaf::compileBytecode(tailCallProgram, options);
+        if(module == nullptr)
+        {
+            report("tail_calls", 0, "(compile failed)");
+            return;
+        }
+        for(uint32_t threshold : {0u, 1u})
+        {
+            pilaf::VM vm(*module);
+            vm.setJitThreshold(threshold);
+            pilaf::Value result;
+            auto start = Clock::now();
+            bool ok = vm.run(result);
+            auto ms = millisecondsSince(start);
+            report(threshold == 0 ? "tail_calls/interpreter" : "tail_calls/jit", ms, ok ? pilaf::valueToString(result, *module) : vm.error());
+        }
+    }
+
+    struct Benchmark {
+        const char* name;
+        void(*run)();
+    };
+
+    const Benchmark benchmarks[] = {
+        {"module_cache", moduleCache},
+        {"instance_lookup", instanceLookup},
+        {"annotated_constraints", annotatedConstraints},
+        {"inferred_constraints", inferredConstraints},
+        {"generic_instantiation", genericInstantiation},
+        {"error_flag", errorFlag},
+        {"constraint_dump", constraintDump},
+        {"diagnostics", diagnostics},
+        {"error_recovery", errorRecovery},
+        {"lazy_parsing", lazyParsing},
+        {"parallel_parsing", parallelParsing},
+        {"interpreter", interpreter},
+        {"ir_footprint", irFootprint},
+        {"optimizer", optimizer},
+        {"native", native},
+        {"jit", jit},
+        {"match", match},
+        {"layouts", layouts},
+        {"closures", closures},
+        {"tail_calls", tailCalls},
+    };
+}
+
+int main(int argc, const char* argv[])
+{
+    const char* filter = argc > 1 ? argv[1] : "";
+    for(auto& b : benchmarks)
+    {
+        if(strstr(b.name, filter) != nullptr) b.run();
+    }
+    return 0;
+}
@@ -0,0 +1,190 @@
+#include <cinttypes>
+#include <cmath>
+#include <cstdlib>
+#include "bytecode.h"
+
+namespace pilaf {
+    const char* opcodeName(Opcode op)
+    {
+        static const char* const names[] = {
+            #define PILAF_OPCODE_NAME(name) #name,
+            PILAF_OPCODES(PILAF_OPCODE_NAME)
+            #undef PILAF_OPCODE_NAME
+        };
+        return op < OP_COUNT ? names[op] : "?";
+    }
+
+    //the shortest of %.15g and %.17g that reads back as the same number
+    static std::string numberToString(double d)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.15g", d);
+        if(strtod(buffer, nullptr) != d) snprintf(buffer, sizeof(buffer), "%.17g", d);
+        std::string result = buffer;
+        if(std::isfinite(d) && result.find_first_of(".e") == std::string::npos) result.append(".0");
+        return result;
+    }
+
+    static void appendValue(const Value& v, const Module& module, std::string& out, size_t depth)
+    {
+        //cyclic aggregates are cut off rather than printed forever
+        if(depth > 32)
+        {
+            out.append("...");
+            return;
+        }
+        switch(v.type)
+        {
+            case VAL_VOID: out.append("()"); break;
+            case VAL_BOOL: out.append(v.as.b ? "true" : "false"); break;
+            case VAL_INT: out.append(std::to_string(v.as.i)); break;
+            case VAL_FLOAT: out.append(numberToString(v.as.f)).append("f"); break;
+            case VAL_DOUBLE: out.append(numberToString(v.as.d)); break;
+            case VAL_CHAR:
+            {
+                if(v.as.c < 0x80) out.push_back((char)v.as.c);
+                else out.append("\\u").append(std::to_string(v.as.c));
+                break;
+            }
+            case VAL_FUNCTION:
+            {
+                out.append("<fn ");
+                out.append(v.as.function < module.functions.size() ? module.functions[v.as.function].name : "?");
+                out.append(">");
+                break;
+            }
+            case VAL_OBJECT:
+            {
+                auto o = v.as.object;
+                switch(o->type)
+                {
+                    case OBJ_STRING: out.append(static_cast<StringObject*>(o)->text); break;
+                    case OBJ_ARRAY:
+                    {
+                        auto& values = static_cast<ArrayObject*>(o)->values;
+                        out.push_back('[');
+                        for(size_t i = 0; i < values.size(); i++)
+                        {
+                            if(i != 0) out.append(", ");
+                            appendValue(values[i], module, out, depth + 1);
+                        }
+                        out.push_back(']');
+                        break;
+                    }
+                    case OBJ_RECORD:
+                    {
+                        auto record = static_cast<RecordObject*>(o);
+                        bool named = !record->layout->names.empty();
+                        if(named) out.append(record->layout->name).append(" { ");
+                        else out.push_back('(');
+                        for(size_t i = 0; i < record->fields.size(); i++)
+                        {
+                            if(i != 0) out.append(", ");
+                            if(named) out.append(symbolName(record->layout->names[i])).append(": ");
+                            appendValue(record->fields[i], module, out, depth + 1);
+                        }
+                        out.append(named ? " }" : ")");
+                        break;
+                    }
+                    case OBJ_CLOSURE:
+                    {
+                        auto function = static_cast<ClosureObject*>(o)->function;
+                        out.append("<fn ");
+                        out.append(function < module.functions.size() ? module.functions[function].name : "?");
+                        out.append(">");
+                        break;
+                    }
+                    case OBJ_VARIANT:
+                    {
+                        auto variant = static_cast<VariantObject*>(o);
+                        out.append(symbolName(variant->layout->names[variant->tag]));
+                        if(variant->layout->empty[variant->tag]) break;
+                        out.push_back('(');
+                        appendValue(variant->payload, module, out, depth + 1);
+                        out.push_back(')');
+                        break;
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    std::string valueToString(const Value& v, const Module& module)
+    {
+        std::string result;
+        appendValue(v, module, result, 0);
+        return result;
+    }
+
+    void disassemble(const Function& function, const Module& module, FILE* out)
+    {
+        fprintf(out, "fn %s: %u parameters, %u registers\n", function.name.c_str(), function.arity, function.registers);
+        for(size_t i = 0; i < function.code.size(); i++)
+        {
+            auto& in = function.code[i];
+            fprintf(out, "%6zu  %-14s", i, opcodeName(in.op));
+            switch(in.op)
+            {
+                case OP_LOADK:
+                {
+                    auto& k = module.constants[in.b];
+                    bool text = k.type == VAL_OBJECT && k.as.object->type == OBJ_STRING;
+                    fprintf(out, "r%u, k%u ; %s%s%s", in.a, in.b, text ? "\"" : "", valueToString(k, module).c_str(), text ? "\"" : "");
+                    break;
+                }
+                case OP_LOADVOID:
+                case OP_RETURN: fprintf(out, "r%u", in.a); break;
+                case OP_RETURNVOID: break;
+                case OP_GETGLOBAL:
+                case OP_SETGLOBAL: fprintf(out, "r%u, g%u ; %s", in.a, in.b, module.globals[in.b].c_str()); break;
+                case OP_FUNCTION: fprintf(out, "r%u, f%u ; %s", in.a, in.b, module.functions[in.b].name.c_str()); break;
+                case OP_CLOSURE: fprintf(out, "r%u, f%u, r%u ; %s", in.a, in.b, in.c, module.functions[in.b].name.c_str()); break;
+                case OP_LOCALCLOSURE: fprintf(out, "r%u, c%u, r%u ; %s", in.a, in.b, in.c, module.functions[function.closures[in.b]].name.c_str()); break;
+                case OP_MOVE:
+                case OP_NEG:
+                case OP_NOT:
+                case OP_TAG:
+                case OP_PAYLOAD: fprintf(out, "r%u, r%u", in.a, in.b); break;
+                case OP_JMP: fprintf(out, "-> %zd", (ptrdiff_t)i + 1 + jumpOffset(in)); break;
+                case OP_JMPIF:
+                case OP_JMPIFNOT: fprintf(out, "r%u -> %zd", in.a, (ptrdiff_t)i + 1 + jumpOffset(in)); break;
+                case OP_SWITCH:
+                {
+                    auto& table = function.tables[in.b];
+                    fprintf(out, "r%u, t%u ; [", in.a, in.b);
+                    for(size_t k = 0; k < table.offsets.size(); k++) fprintf(out, "%s%" PRId64 " -> %zd", k == 0 ? "" : ", ", table.low + (int64_t)k, (ptrdiff_t)i + 1 + table.offsets[k]);
+                    fprintf(out, "], else -> %zd", (ptrdiff_t)i + 1 + table.fallback);
+                    break;
+                }
+                case OP_CALL:
+                case OP_TAILCALL: fprintf(out, "r%u, f%u, %u ; %s", in.a, in.b, in.c, module.functions[in.b].name.c_str()); break;
+                case OP_CALLVALUE: fprintf(out, "r%u, r%u, %u", in.a, in.b, in.c); break;
+                case OP_CALLNATIVE: fprintf(out, "r%u, n%u, %u", in.a, in.b, in.c); break;
+                case OP_RECORD:
+                {
+                    auto& layout = module.layouts[in.b];
+                    fprintf(out, "r%u, l%u, r%u ; %s", in.a, in.b, in.c, layout.name.empty() ? "tuple" : layout.name.c_str());
+                    break;
+                }
+                case OP_GETFIELD:
+                case OP_ARRAY: fprintf(out, "r%u, r%u, %u", in.a, in.b, in.c); break;
+                case OP_GETFIELDNAMED: fprintf(out, "r%u, r%u, k%u ; %s", in.a, in.b, in.c, symbolName((Symbol)module.constants[in.c].as.i).c_str()); break;
+                case OP_SETFIELD: fprintf(out, "r%u, %u, r%u", in.a, in.b, in.c); break;
+                case OP_SETFIELDNAMED: fprintf(out, "r%u, k%u, r%u ; %s", in.a, in.b, in.c, symbolName((Symbol)module.constants[in.b].as.i).c_str()); break;
+                case OP_VARIANT: fprintf(out, "r%u, l%u, %u ; %s", in.a, in.b, in.c, symbolName(module.layouts[in.b].names[in.c]).c_str()); break;
+                default: fprintf(out, "r%u, r%u, r%u", in.a, in.b, in.c); break;
+            }
+            fprintf(out, "\n");
+        }
+    }
+
+    void disassemble(const Module& module, FILE* out)
+    {
+        for(auto& f : module.functions)
+        {
+            disassemble(f, module, out);
+            fprintf(out, "\n");
+        }
+    }
+}
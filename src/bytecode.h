@@ -0,0 +1,237 @@
+#ifndef bytecode_header
+#define bytecode_header
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "symbols.h"
+
+namespace pilaf {
+    //R is the current frame's registers, K the module's constants, G its globals and F its functions.
+    //calls use a register window: the callee's registers start right after R[a], where its result goes
+    #define PILAF_OPCODES(X) \
+        X(LOADK)       /* R[a] = K[b] */ \
+        X(LOADVOID)    /* R[a] = () */ \
+        X(MOVE)        /* R[a] = R[b] */ \
+        X(GETGLOBAL)   /* R[a] = G[b] */ \
+        X(SETGLOBAL)   /* G[b] = R[a] */ \
+        X(FUNCTION)    /* R[a] = F[b] as a value */ \
+        X(CLOSURE)     /* R[a] = F[b] capturing R[c] .. */ \
+        X(LOCALCLOSURE) /* R[a] = the frame's closure slot b, made for its function capturing R[c] .. */ \
+        X(ADD)         /* R[a] = R[b] + R[c] */ \
+        X(SUB)         \
+        X(MUL)         \
+        X(DIV)         \
+        X(MOD)         \
+        X(BAND)        \
+        X(BOR)         \
+        X(BXOR)        \
+        X(SHL)         \
+        X(SHR)         \
+        X(EQ)          /* R[a] = R[b] == R[c] */ \
+        X(NE)          \
+        X(LT)          \
+        X(LE)          \
+        X(NEG)         /* R[a] = -R[b] */ \
+        X(NOT)         /* R[a] = !R[b] */ \
+        X(JMP)         /* ip += offset */ \
+        X(JMPIF)       /* if R[a] then ip += offset */ \
+        X(JMPIFNOT)    /* if !R[a] then ip += offset */ \
+        X(SWITCH)      /* ip += the offset jump table b gives the Int or Char R[a] */ \
+        X(CALL)        /* R[a] = F[b](R[a+1] .. R[a+c]) */ \
+        X(CALLVALUE)   /* R[a] = R[b](R[a+1] .. R[a+c]) */ \
+        X(CALLNATIVE)  /* R[a] = native b(R[a+1] .. R[a+c]) */ \
+        X(TAILCALL)    /* return F[b](R[a+1] .. R[a+c]), in the frame of the caller */ \
+        X(RETURN)      /* return R[a] */ \
+        X(RETURNVOID)  \
+        X(RECORD)      /* R[a] = record of layout b holding R[c] .. */ \
+        X(GETFIELD)    /* R[a] = R[b].fields[c] */ \
+        X(GETFIELDNAMED) /* R[a] = R[b].(field named by symbol K[c]) */ \
+        X(SETFIELD)    /* R[a].fields[b] = R[c] */ \
+        X(SETFIELDNAMED) /* R[a].(field named by symbol K[b]) = R[c] */ \
+        X(ARRAY)       /* R[a] = [R[b] .. R[b+c-1]] */ \
+        X(GETINDEX)    /* R[a] = R[b][R[c]] */ \
+        X(SETINDEX)    /* R[a][R[b]] = R[c] */ \
+        X(VARIANT)     /* R[a] = member c of union layout b, carrying R[a] unless the member has no payload */ \
+        X(TAG)         /* R[a] = member index of variant R[b] */ \
+        X(PAYLOAD)     /* R[a] = payload of variant R[b] */
+
+    enum Opcode : uint8_t {
+        #define PILAF_OPCODE_ENUM(name) OP_##name,
+        PILAF_OPCODES(PILAF_OPCODE_ENUM)
+        #undef PILAF_OPCODE_ENUM
+        OP_COUNT
+    };
+
+    const char* opcodeName(Opcode op);
+
+    //marks an operand that names no register
+    const uint16_t noRegister = UINT16_MAX;
+
+    struct Instruction {
+        Opcode op;
+        uint16_t a;
+        uint16_t b;
+        uint16_t c;
+    };
+
+    //jumps keep their register in `a` and a signed offset from the next instruction in `b` and `c`
+    inline int32_t jumpOffset(const Instruction& i)
+    {
+        return (int32_t)((uint32_t)i.b | ((uint32_t)i.c << 16));
+    }
+    inline void setJumpOffset(Instruction& i, int32_t offset)
+    {
+        i.b = (uint16_t)((uint32_t)offset & 0xffff);
+        i.c = (uint16_t)((uint32_t)offset >> 16);
+    }
+
+    struct Object;
+    struct IrModule;
+
+    enum ValueType : uint8_t {
+        VAL_VOID,
+        VAL_BOOL,
+        VAL_INT,
+        VAL_FLOAT,
+        VAL_DOUBLE,
+        VAL_CHAR,
+        VAL_FUNCTION,
+        VAL_OBJECT
+    };
+
+    //values carry their own type: the typed AST does not record the type of every expression,
+    //so operators pick the operation for their operands when they run
+    struct Value {
+        ValueType type;
+        union {
+            bool b;
+            int64_t i;
+            float f;
+            double d;
+            uint32_t c;
+            uint32_t function;
+            Object* object;
+        } as;
+
+        static Value makeVoid() { Value v; v.type = VAL_VOID; v.as.i = 0; return v; }
+        static Value makeBool(bool b) { Value v; v.type = VAL_BOOL; v.as.i = 0; v.as.b = b; return v; }
+        static Value makeInt(int64_t i) { Value v; v.type = VAL_INT; v.as.i = i; return v; }
+        static Value makeFloat(float f) { Value v; v.type = VAL_FLOAT; v.as.i = 0; v.as.f = f; return v; }
+        static Value makeDouble(double d) { Value v; v.type = VAL_DOUBLE; v.as.d = d; return v; }
+        static Value makeChar(uint32_t c) { Value v; v.type = VAL_CHAR; v.as.i = 0; v.as.c = c; return v; }
+        static Value makeFunction(uint32_t f) { Value v; v.type = VAL_FUNCTION; v.as.i = 0; v.as.function = f; return v; }
+        static Value makeObject(Object* o) { Value v; v.type = VAL_OBJECT; v.as.object = o; return v; }
+    };
+
+    enum ObjectType : uint8_t {
+        OBJ_STRING,
+        OBJ_ARRAY,
+        OBJ_RECORD,
+        OBJ_VARIANT,
+        OBJ_CLOSURE
+    };
+
+    //heap values. aggregates are shared by reference and freed by the interpreter's collector
+    struct Object {
+        ObjectType type;
+        bool marked;
+        Object* next;
+        Object(ObjectType type) : type(type), marked(false), next(nullptr) {}
+        virtual ~Object() {}
+    };
+
+    struct StringObject : public Object {
+        std::string text;
+        StringObject(std::string text) : Object(OBJ_STRING), text(std::move(text)) {}
+    };
+
+    struct ArrayObject : public Object {
+        std::vector<Value> values;
+        ArrayObject() : Object(OBJ_ARRAY) {}
+    };
+
+    //field names of a struct, or member names of a union; tuples have a layout without names
+    struct Layout {
+        std::string name;
+        std::vector<Symbol> names;
+        //union members that take no payload
+        std::vector<bool> empty;
+        //number of fields of a record built with this layout
+        size_t size;
+    };
+
+    struct RecordObject : public Object {
+        const Layout* layout;
+        std::vector<Value> fields;
+        RecordObject(const Layout* layout) : Object(OBJ_RECORD), layout(layout), fields(layout->size) {}
+    };
+
+    struct VariantObject : public Object {
+        const Layout* layout;
+        uint32_t tag;
+        Value payload;
+        VariantObject(const Layout* layout, uint32_t tag, Value payload) : Object(OBJ_VARIANT), layout(layout), tag(tag), payload(payload) {}
+    };
+
+    //a function value with the values it captured, which calls pass after their own arguments.
+    //a closure that cannot outlive the call making it lives in a slot of that call's frame instead
+    //of the collected heap
+    struct ClosureObject : public Object {
+        uint32_t function;
+        std::vector<Value> captures;
+        ClosureObject(uint32_t function) : Object(OBJ_CLOSURE), function(function) {}
+    };
+
+    //where a switch goes for each value from `low` on, and for every other value, as offsets from
+    //the instruction after it
+    struct JumpTable {
+        int64_t low;
+        std::vector<int32_t> offsets;
+        int32_t fallback;
+    };
+
+    struct Function {
+        std::string name;
+        uint16_t arity;
+        //registers the function needs, parameters included
+        uint16_t registers;
+        std::vector<Instruction> code;
+        std::vector<JumpTable> tables;
+        //source line of every instruction, for runtime errors
+        std::vector<int> lines;
+        //functions inlined into this one and which of them every instruction came from, counting
+        //from 1; empty when nothing was inlined
+        std::vector<std::string> inlined;
+        std::vector<uint16_t> origins;
+        //the IR function this was generated from, for compiling it to machine code
+        uint32_t source;
+        //parameters at the end of the function's that its closures fill with their captured values
+        uint16_t captures = 0;
+        //function of each of the closure slots in the function's frames
+        std::vector<uint32_t> closures;
+    };
+
+    struct Module {
+        std::vector<Function> functions;
+        std::vector<Value> constants;
+        //string constants, which live as long as the module rather than in the collected heap
+        std::vector<std::unique_ptr<StringObject>> strings;
+        std::vector<Layout> layouts;
+        std::vector<std::string> globals;
+        //runs the top-level statements
+        uint32_t init;
+        //the program's `main`, when it declares one without parameters
+        int64_t main;
+        //the SSA form the module was generated from, when it is kept for the JIT
+        std::shared_ptr<const IrModule> ir;
+        Module() : init(0), main(-1) {}
+    };
+
+    std::string valueToString(const Value& v, const Module& module);
+    void disassemble(const Function& function, const Module& module, FILE* out);
+    void disassemble(const Module& module, FILE* out);
+}
+#endif
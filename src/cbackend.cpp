@@ -0,0 +1,1678 @@
+#include <cinttypes>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include "cbackend.h"
+#include "diagnostics.h"
+#include "layout.h"
+#include "vm.h"
+
+namespace pilaf {
+    //what every generated program starts with: tagged values, the objects the program allocates and
+    //the operations that are not expanded in place. objects are never freed
+    static const char* runtime = R"runtime(#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { PL_VOID, PL_BOOL, PL_INT, PL_FLOAT, PL_DOUBLE, PL_CHAR, PL_OBJECT, PL_ANY };
+enum { PL_STRING, PL_ARRAY, PL_RECORD, PL_VARIANT, PL_CLOSURE };
+enum { PL_ADD, PL_SUB, PL_MUL, PL_DIV, PL_MOD, PL_BAND, PL_BOR, PL_BXOR, PL_SHL, PL_SHR, PL_LT, PL_LE };
+
+typedef struct pl_layout pl_layout;
+typedef struct pl_object { uint32_t kind; const pl_layout* layout; } pl_object;
+typedef struct pl_value { uint32_t tag; union { bool b; int64_t i; float f; double d; uint32_t c; pl_object* o; } as; } pl_value;
+
+/* fields of a struct or tuple with where they are and how they are held, or members of a union
+   with where their payloads are. a union keeps its tag in tag_size bytes at tag_offset or, when
+   tag_size is 0, in the values from niche_start on that the payload of member dataful never holds */
+struct pl_layout {
+    const char* name;
+    uint32_t count;
+    const char* const* names;
+    const unsigned char* kinds;
+    const size_t* offsets;
+    const bool* empty;
+    size_t size;
+    size_t tag_offset;
+    uint32_t tag_size;
+    uint32_t dataful;
+    uint64_t niche_start;
+};
+
+typedef struct pl_string { pl_object h; int64_t length; const char* text; } pl_string;
+typedef struct pl_array { pl_object h; int64_t length; pl_value* items; } pl_array;
+/* a function value. code takes the arguments and then the values the closure captured, from env */
+typedef struct pl_closure { pl_object h; const char* name; uint32_t arity; pl_value (*code)(const pl_value*, const pl_value*); const pl_value* env; } pl_closure;
+
+static inline pl_value pl_void(void) { pl_value v = {PL_VOID, {.i = 0}}; return v; }
+static inline pl_value pl_bool(bool b) { pl_value v = {PL_BOOL, {.i = 0}}; v.as.b = b; return v; }
+static inline pl_value pl_int(int64_t i) { pl_value v = {PL_INT, {.i = i}}; return v; }
+static inline pl_value pl_float(float f) { pl_value v = {PL_FLOAT, {.i = 0}}; v.as.f = f; return v; }
+static inline pl_value pl_double(double d) { pl_value v = {PL_DOUBLE, {.d = d}}; return v; }
+static inline pl_value pl_char(uint32_t c) { pl_value v = {PL_CHAR, {.i = 0}}; v.as.c = c; return v; }
+static inline pl_value pl_obj(pl_object* o) { pl_value v = {o != NULL ? PL_OBJECT : PL_VOID, {.o = o}}; return v; }
+
+static _Noreturn void pl_fail(uint32_t line, const char* function, const char* format, ...)
+{
+    va_list args;
+    fflush(stdout);
+    if(line != 0) fprintf(stderr, "[line %" PRIu32 "] ", line);
+    fprintf(stderr, "runtime error in %s: ", function);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+    exit(70);
+}
+
+/* calls that may still be made before the program stops with a stack overflow, as many as the
+   interpreter allows. a call enters before it is made and gives the depth back once it returns */
+static uint32_t pl_depth = 1 << 16;
+
+static inline void pl_enter(uint32_t line, const char* function)
+{
+    if(pl_depth == 0) pl_fail(line, function, "stack overflow");
+    pl_depth--;
+}
+
+static void* pl_alloc(size_t size, uint32_t kind, const pl_layout* layout)
+{
+    pl_object* o = malloc(size);
+    if(o == NULL)
+    {
+        fflush(stdout);
+        fputs("out of memory\n", stderr);
+        exit(70);
+    }
+    o->kind = kind;
+    o->layout = layout;
+    return o;
+}
+
+static inline bool pl_is(pl_value v, uint32_t kind) { return v.tag == PL_OBJECT && v.as.o->kind == kind; }
+
+static inline int64_t pl_div(int64_t a, int64_t b, uint32_t line, const char* function)
+{
+    if(b == 0) pl_fail(line, function, "integer division by zero");
+    if(b == -1) return (int64_t)(0 - (uint64_t)a);
+    return a / b;
+}
+
+static inline int64_t pl_mod(int64_t a, int64_t b, uint32_t line, const char* function)
+{
+    if(b == 0) pl_fail(line, function, "integer division by zero");
+    if(b == -1) return 0;
+    return a % b;
+}
+
+static const char* const pl_operators[] = {"+", "-", "*", "/", "%", "&", "|", "^", "<<", ">>", "<", "<="};
+
+static pl_object* pl_concat(const pl_string* x, const pl_string* y)
+{
+    pl_string* s = pl_alloc(sizeof(pl_string), PL_STRING, NULL);
+    char* text = malloc((size_t)(x->length + y->length) + 1);
+    if(text == NULL) pl_fail(0, "?", "out of memory");
+    memcpy(text, x->text, (size_t)x->length);
+    memcpy(text + x->length, y->text, (size_t)y->length);
+    text[x->length + y->length] = '\0';
+    s->length = x->length + y->length;
+    s->text = text;
+    return &s->h;
+}
+
+static pl_value pl_arith(int op, pl_value x, pl_value y, uint32_t line, const char* function)
+{
+    if(x.tag != y.tag) pl_fail(line, function, "operands of '%s' have different types", pl_operators[op]);
+    switch(x.tag)
+    {
+        case PL_INT:
+        {
+            uint64_t a = (uint64_t)x.as.i, b = (uint64_t)y.as.i;
+            switch(op)
+            {
+                case PL_ADD: return pl_int((int64_t)(a + b));
+                case PL_SUB: return pl_int((int64_t)(a - b));
+                case PL_MUL: return pl_int((int64_t)(a * b));
+                case PL_DIV: return pl_int(pl_div(x.as.i, y.as.i, line, function));
+                case PL_MOD: return pl_int(pl_mod(x.as.i, y.as.i, line, function));
+                case PL_BAND: return pl_int((int64_t)(a & b));
+                case PL_BOR: return pl_int((int64_t)(a | b));
+                case PL_BXOR: return pl_int((int64_t)(a ^ b));
+                case PL_SHL: return pl_int((int64_t)(a << (b & 63)));
+                case PL_SHR: return pl_int(x.as.i >> (b & 63));
+            }
+            break;
+        }
+        case PL_DOUBLE:
+        {
+            switch(op)
+            {
+                case PL_ADD: return pl_double(x.as.d + y.as.d);
+                case PL_SUB: return pl_double(x.as.d - y.as.d);
+                case PL_MUL: return pl_double(x.as.d * y.as.d);
+                case PL_DIV: return pl_double(x.as.d / y.as.d);
+                case PL_MOD: return pl_double(fmod(x.as.d, y.as.d));
+            }
+            break;
+        }
+        case PL_FLOAT:
+        {
+            switch(op)
+            {
+                case PL_ADD: return pl_float(x.as.f + y.as.f);
+                case PL_SUB: return pl_float(x.as.f - y.as.f);
+                case PL_MUL: return pl_float(x.as.f * y.as.f);
+                case PL_DIV: return pl_float(x.as.f / y.as.f);
+                case PL_MOD: return pl_float(fmodf(x.as.f, y.as.f));
+            }
+            break;
+        }
+        case PL_OBJECT:
+        {
+            if(op == PL_ADD && pl_is(x, PL_STRING) && pl_is(y, PL_STRING)) return pl_obj(pl_concat((pl_string*)x.as.o, (pl_string*)y.as.o));
+            break;
+        }
+    }
+    pl_fail(line, function, "operands of '%s' must be numbers%s", pl_operators[op], op == PL_ADD ? " or strings" : "");
+}
+
+static int pl_compare_strings(const pl_string* x, const pl_string* y)
+{
+    size_t n = (size_t)(x->length < y->length ? x->length : y->length);
+    int order = memcmp(x->text, y->text, n);
+    if(order != 0) return order;
+    return x->length < y->length ? -1 : x->length > y->length;
+}
+
+static bool pl_order(int op, pl_value x, pl_value y, uint32_t line, const char* function)
+{
+    if(x.tag == y.tag)
+    {
+        switch(x.tag)
+        {
+            case PL_INT: return op == PL_LT ? x.as.i < y.as.i : x.as.i <= y.as.i;
+            case PL_DOUBLE: return op == PL_LT ? x.as.d < y.as.d : x.as.d <= y.as.d;
+            case PL_FLOAT: return op == PL_LT ? x.as.f < y.as.f : x.as.f <= y.as.f;
+            case PL_CHAR: return op == PL_LT ? x.as.c < y.as.c : x.as.c <= y.as.c;
+            case PL_OBJECT:
+            {
+                if(!pl_is(x, PL_STRING) || !pl_is(y, PL_STRING)) break;
+                int order = pl_compare_strings((pl_string*)x.as.o, (pl_string*)y.as.o);
+                return op == PL_LT ? order < 0 : order <= 0;
+            }
+        }
+    }
+    pl_fail(line, function, "operands of '%s' cannot be ordered", pl_operators[op]);
+}
+
+static pl_value pl_neg(pl_value x, uint32_t line, const char* function)
+{
+    if(x.tag == PL_INT) return pl_int((int64_t)(0 - (uint64_t)x.as.i));
+    if(x.tag == PL_DOUBLE) return pl_double(-x.as.d);
+    if(x.tag == PL_FLOAT) return pl_float(-x.as.f);
+    pl_fail(line, function, "operand of '-' must be a number");
+}
+
+static bool pl_not(pl_value x, uint32_t line, const char* function)
+{
+    if(x.tag != PL_BOOL) pl_fail(line, function, "operand of 'not' must be a Bool");
+    return !x.as.b;
+}
+
+static pl_value pl_load(const void* at, unsigned kind)
+{
+    switch(kind)
+    {
+        case PL_BOOL: return pl_bool(*(const bool*)at);
+        case PL_INT: return pl_int(*(const int64_t*)at);
+        case PL_FLOAT: return pl_float(*(const float*)at);
+        case PL_DOUBLE: return pl_double(*(const double*)at);
+        case PL_CHAR: return pl_char(*(const uint32_t*)at);
+        case PL_OBJECT: return pl_obj(*(pl_object* const*)at);
+        default: return *(const pl_value*)at;
+    }
+}
+
+static void pl_store(void* at, unsigned kind, pl_value v)
+{
+    switch(kind)
+    {
+        case PL_BOOL: *(bool*)at = v.as.b; break;
+        case PL_INT: *(int64_t*)at = v.as.i; break;
+        case PL_FLOAT: *(float*)at = v.as.f; break;
+        case PL_DOUBLE: *(double*)at = v.as.d; break;
+        case PL_CHAR: *(uint32_t*)at = v.as.c; break;
+        case PL_OBJECT: *(pl_object**)at = v.as.o; break;
+        default: *(pl_value*)at = v; break;
+    }
+}
+
+static inline pl_value pl_field(const pl_object* o, uint32_t i)
+{
+    return pl_load((const char*)o + o->layout->offsets[i], o->layout->kinds[i]);
+}
+
+static pl_object* pl_record(pl_value x, const char* message, uint32_t line, const char* function)
+{
+    if(!pl_is(x, PL_RECORD)) pl_fail(line, function, "%s", message);
+    return x.as.o;
+}
+
+static pl_value pl_getfield(pl_value x, uint32_t i, uint32_t line, const char* function)
+{
+    pl_object* o = pl_record(x, "field access on a value that is not a struct or tuple", line, function);
+    if(i >= o->layout->count) pl_fail(line, function, "field access out of range");
+    return pl_field(o, i);
+}
+
+static void pl_setfield(pl_value x, uint32_t i, pl_value v, uint32_t line, const char* function)
+{
+    pl_object* o = pl_record(x, "field assignment on a value that is not a struct or tuple", line, function);
+    if(i >= o->layout->count) pl_fail(line, function, "field assignment out of range");
+    pl_store((char*)o + o->layout->offsets[i], o->layout->kinds[i], v);
+}
+
+static uint32_t pl_named(pl_object* o, const char* name, uint32_t line, const char* function)
+{
+    for(uint32_t i = 0; o->layout->names != NULL && i < o->layout->count; i++)
+    {
+        if(strcmp(o->layout->names[i], name) == 0) return i;
+    }
+    pl_fail(line, function, "struct %s has no field %s", o->layout->name, name);
+}
+
+static pl_value pl_getnamed(pl_value x, const char* name, uint32_t line, const char* function)
+{
+    pl_object* o = pl_record(x, "field access on a value that is not a struct", line, function);
+    return pl_field(o, pl_named(o, name, line, function));
+}
+
+static void pl_setnamed(pl_value x, const char* name, pl_value v, uint32_t line, const char* function)
+{
+    pl_object* o = pl_record(x, "field assignment on a value that is not a struct", line, function);
+    uint32_t i = pl_named(o, name, line, function);
+    pl_store((char*)o + o->layout->offsets[i], o->layout->kinds[i], v);
+}
+
+static pl_object* pl_array_of(int64_t length, const pl_value* items)
+{
+    pl_array* a = pl_alloc(sizeof(pl_array), PL_ARRAY, NULL);
+    a->length = length;
+    a->items = malloc(sizeof(pl_value) * (size_t)(length > 0 ? length : 1));
+    if(a->items == NULL) pl_fail(0, "?", "out of memory");
+    if(items != NULL) memcpy(a->items, items, sizeof(pl_value) * (size_t)length);
+    return &a->h;
+}
+
+static pl_value pl_index(pl_value x, int64_t i, uint32_t line, const char* function)
+{
+    if(pl_is(x, PL_ARRAY))
+    {
+        pl_array* a = (pl_array*)x.as.o;
+        if(i < 0 || i >= a->length) pl_fail(line, function, "index %" PRId64 " out of bounds for an array of length %" PRId64, i, a->length);
+        return a->items[i];
+    }
+    if(pl_is(x, PL_STRING))
+    {
+        pl_string* s = (pl_string*)x.as.o;
+        if(i < 0 || i >= s->length) pl_fail(line, function, "index %" PRId64 " out of bounds for a string of length %" PRId64, i, s->length);
+        return pl_char((unsigned char)s->text[i]);
+    }
+    pl_fail(line, function, "indexed value is not an array");
+}
+
+static void pl_setindex(pl_value x, int64_t i, pl_value v, uint32_t line, const char* function)
+{
+    if(!pl_is(x, PL_ARRAY)) pl_fail(line, function, "indexed value is not an array");
+    pl_array* a = (pl_array*)x.as.o;
+    if(i < 0 || i >= a->length) pl_fail(line, function, "index %" PRId64 " out of bounds for an array of length %" PRId64, i, a->length);
+    a->items[i] = v;
+}
+
+/* the bits of a Bool, a Char, a pointer or the tag of a tagged value, which a union's tag can
+   share when the payload never has some of them */
+static uint64_t pl_niche(const void* at, unsigned kind)
+{
+    switch(kind)
+    {
+        case PL_BOOL: return *(const unsigned char*)at;
+        case PL_CHAR: return *(const uint32_t*)at;
+        case PL_OBJECT: return (uint64_t)(uintptr_t)*(pl_object* const*)at;
+        default: return ((const pl_value*)at)->tag;
+    }
+}
+
+static void pl_set_niche(void* at, unsigned kind, uint64_t bits)
+{
+    switch(kind)
+    {
+        case PL_BOOL: *(unsigned char*)at = (unsigned char)bits; break;
+        case PL_CHAR: *(uint32_t*)at = (uint32_t)bits; break;
+        case PL_OBJECT: *(pl_object**)at = (pl_object*)(uintptr_t)bits; break;
+        default: ((pl_value*)at)->tag = (uint32_t)bits; break;
+    }
+}
+
+static pl_object* pl_variant_of(const pl_layout* layout, int64_t tag, pl_value payload)
+{
+    pl_object* o = pl_alloc(layout->size, PL_VARIANT, layout);
+    char* data = (char*)o;
+    if(!layout->empty[tag]) pl_store(data + layout->offsets[tag], layout->kinds[tag], payload);
+    switch(layout->tag_size)
+    {
+        case 1: *(uint8_t*)(data + layout->tag_offset) = (uint8_t)tag; break;
+        case 2: *(uint16_t*)(data + layout->tag_offset) = (uint16_t)tag; break;
+        case 4: *(uint32_t*)(data + layout->tag_offset) = (uint32_t)tag; break;
+        default:
+        {
+            uint32_t d = layout->dataful;
+            if(layout->count > 1 && (uint32_t)tag != d) pl_set_niche(data + layout->offsets[d], layout->kinds[d], layout->niche_start + (uint64_t)((uint32_t)tag < d ? tag : tag - 1));
+            break;
+        }
+    }
+    return o;
+}
+
+static int64_t pl_variant_tag(const pl_object* o)
+{
+    const pl_layout* layout = o->layout;
+    const char* data = (const char*)o;
+    switch(layout->tag_size)
+    {
+        case 1: return *(const uint8_t*)(data + layout->tag_offset);
+        case 2: return *(const uint16_t*)(data + layout->tag_offset);
+        case 4: return *(const uint32_t*)(data + layout->tag_offset);
+    }
+    if(layout->count < 2) return 0;
+    uint32_t d = layout->dataful;
+    /* values below niche_start wrap around to ones no other member has */
+    uint64_t k = pl_niche(data + layout->offsets[d], layout->kinds[d]) - layout->niche_start;
+    if(k >= layout->count - 1) return d;
+    return k < d ? (int64_t)k : (int64_t)k + 1;
+}
+
+static pl_value pl_variant_payload(const pl_object* o)
+{
+    int64_t tag = pl_variant_tag(o);
+    if(o->layout->empty[tag]) return pl_void();
+    return pl_load((const char*)o + o->layout->offsets[tag], o->layout->kinds[tag]);
+}
+
+static pl_object* pl_union(pl_value x, uint32_t line, const char* function)
+{
+    if(!pl_is(x, PL_VARIANT)) pl_fail(line, function, "matched value is not a union");
+    return x.as.o;
+}
+
+static pl_value pl_call(pl_value callee, uint32_t count, const pl_value* args, uint32_t line, const char* function)
+{
+    if(!pl_is(callee, PL_CLOSURE)) pl_fail(line, function, "called value is not a function");
+    pl_closure* c = (pl_closure*)callee.as.o;
+    if(c->arity != count) pl_fail(line, function, "function value called with the wrong number of arguments");
+    pl_enter(line, function);
+    pl_value result = c->code(args, c->env);
+    pl_depth++;
+    return result;
+}
+
+/* a closure of the function that `proto` is for, with room for `count` captured values after it */
+static pl_closure* pl_closure_new(const pl_closure* proto, uint32_t count)
+{
+    pl_closure* c = pl_alloc(sizeof(pl_closure) + count * sizeof(pl_value), PL_CLOSURE, NULL);
+    c->name = proto->name;
+    c->arity = proto->arity;
+    c->code = proto->code;
+    c->env = (const pl_value*)(c + 1);
+    return c;
+}
+
+static bool pl_equal(pl_value x, pl_value y, size_t depth)
+{
+    if(x.tag != y.tag) return false;
+    switch(x.tag)
+    {
+        case PL_VOID: return true;
+        case PL_BOOL: return x.as.b == y.as.b;
+        case PL_INT: return x.as.i == y.as.i;
+        case PL_FLOAT: return x.as.f == y.as.f;
+        case PL_DOUBLE: return x.as.d == y.as.d;
+        case PL_CHAR: return x.as.c == y.as.c;
+    }
+    pl_object* a = x.as.o;
+    pl_object* b = y.as.o;
+    if(a == b) return true;
+    /* cyclic aggregates are only equal when they are the same object */
+    if(a->kind != b->kind || depth > 64) return false;
+    switch(a->kind)
+    {
+        case PL_STRING:
+        {
+            const pl_string* s = (const pl_string*)a;
+            const pl_string* t = (const pl_string*)b;
+            return s->length == t->length && memcmp(s->text, t->text, (size_t)s->length) == 0;
+        }
+        case PL_ARRAY:
+        {
+            const pl_array* u = (const pl_array*)a;
+            const pl_array* v = (const pl_array*)b;
+            if(u->length != v->length) return false;
+            for(int64_t i = 0; i < u->length; i++)
+            {
+                if(!pl_equal(u->items[i], v->items[i], depth + 1)) return false;
+            }
+            return true;
+        }
+        case PL_RECORD:
+        {
+            if(a->layout != b->layout) return false;
+            for(uint32_t i = 0; i < a->layout->count; i++)
+            {
+                if(!pl_equal(pl_field(a, i), pl_field(b, i), depth + 1)) return false;
+            }
+            return true;
+        }
+        case PL_VARIANT:
+        {
+            return a->layout == b->layout && pl_variant_tag(a) == pl_variant_tag(b) && pl_equal(pl_variant_payload(a), pl_variant_payload(b), depth + 1);
+        }
+    }
+    return false;
+}
+
+typedef struct pl_text { char* data; size_t length; size_t capacity; } pl_text;
+
+static void pl_put(pl_text* t, const char* s, size_t n)
+{
+    if(t->length + n + 1 > t->capacity)
+    {
+        size_t capacity = t->capacity * 2 > t->length + n + 1 ? t->capacity * 2 : t->length + n + 1;
+        char* data = realloc(t->data, capacity);
+        if(data == NULL) pl_fail(0, "?", "out of memory");
+        t->data = data;
+        t->capacity = capacity;
+    }
+    memcpy(t->data + t->length, s, n);
+    t->length += n;
+    t->data[t->length] = '\0';
+}
+
+static void pl_puts(pl_text* t, const char* s) { pl_put(t, s, strlen(s)); }
+
+static void pl_number(pl_text* t, double d)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.15g", d);
+    if(strtod(buffer, NULL) != d) snprintf(buffer, sizeof(buffer), "%.17g", d);
+    pl_puts(t, buffer);
+    if(isfinite(d) && strpbrk(buffer, ".e") == NULL) pl_puts(t, ".0");
+}
+
+static void pl_append(pl_text* t, pl_value v, size_t depth)
+{
+    char buffer[32];
+    /* cyclic aggregates are cut off rather than printed forever */
+    if(depth > 32)
+    {
+        pl_puts(t, "...");
+        return;
+    }
+    switch(v.tag)
+    {
+        case PL_VOID: pl_puts(t, "()"); return;
+        case PL_BOOL: pl_puts(t, v.as.b ? "true" : "false"); return;
+        case PL_INT: snprintf(buffer, sizeof(buffer), "%" PRId64, v.as.i); pl_puts(t, buffer); return;
+        case PL_FLOAT: pl_number(t, v.as.f); pl_puts(t, "f"); return;
+        case PL_DOUBLE: pl_number(t, v.as.d); return;
+        case PL_CHAR:
+        {
+            if(v.as.c < 0x80)
+            {
+                char c = (char)v.as.c;
+                pl_put(t, &c, 1);
+            }
+            else
+            {
+                snprintf(buffer, sizeof(buffer), "\\u%" PRIu32, v.as.c);
+                pl_puts(t, buffer);
+            }
+            return;
+        }
+    }
+    pl_object* o = v.as.o;
+    switch(o->kind)
+    {
+        case PL_STRING: pl_put(t, ((pl_string*)o)->text, (size_t)((pl_string*)o)->length); return;
+        case PL_ARRAY:
+        {
+            pl_array* a = (pl_array*)o;
+            pl_puts(t, "[");
+            for(int64_t i = 0; i < a->length; i++)
+            {
+                if(i != 0) pl_puts(t, ", ");
+                pl_append(t, a->items[i], depth + 1);
+            }
+            pl_puts(t, "]");
+            return;
+        }
+        case PL_RECORD:
+        {
+            bool named = o->layout->names != NULL;
+            if(named)
+            {
+                pl_puts(t, o->layout->name);
+                pl_puts(t, " { ");
+            }
+            else pl_puts(t, "(");
+            for(uint32_t i = 0; i < o->layout->count; i++)
+            {
+                if(i != 0) pl_puts(t, ", ");
+                if(named)
+                {
+                    pl_puts(t, o->layout->names[i]);
+                    pl_puts(t, ": ");
+                }
+                pl_append(t, pl_field(o, i), depth + 1);
+            }
+            pl_puts(t, named ? " }" : ")");
+            return;
+        }
+        case PL_VARIANT:
+        {
+            int64_t tag = pl_variant_tag(o);
+            pl_puts(t, o->layout->names[tag]);
+            if(o->layout->empty[tag]) return;
+            pl_puts(t, "(");
+            pl_append(t, pl_variant_payload(o), depth + 1);
+            pl_puts(t, ")");
+            return;
+        }
+        case PL_CLOSURE:
+        {
+            pl_puts(t, "<fn ");
+            pl_puts(t, ((pl_closure*)o)->name);
+            pl_puts(t, ">");
+            return;
+        }
+    }
+}
+
+static pl_value pl_print(pl_value v)
+{
+    pl_text t = {NULL, 0, 0};
+    pl_append(&t, v, 0);
+    pl_put(&t, "\n", 1);
+    fwrite(t.data, 1, t.length, stdout);
+    free(t.data);
+    return pl_void();
+}
+
+static pl_object* pl_array_new(pl_value size, pl_value value, uint32_t line, const char* function)
+{
+    if(size.tag != PL_INT || size.as.i < 0) pl_fail(line, function, "array size must be a non-negative Int");
+    pl_object* o = pl_array_of(size.as.i, NULL);
+    for(int64_t i = 0; i < size.as.i; i++) ((pl_array*)o)->items[i] = value;
+    return o;
+}
+
+static int64_t pl_length(pl_value x, uint32_t line, const char* function)
+{
+    if(pl_is(x, PL_ARRAY)) return ((pl_array*)x.as.o)->length;
+    if(pl_is(x, PL_STRING)) return ((pl_string*)x.as.o)->length;
+    pl_fail(line, function, "length of a value that is neither an array nor a string");
+}
+
+static pl_value pl_sqrt(pl_value x, uint32_t line, const char* function)
+{
+    if(x.tag == PL_DOUBLE) return pl_double(sqrt(x.as.d));
+    if(x.tag == PL_FLOAT) return pl_float(sqrtf(x.as.f));
+    pl_fail(line, function, "sqrt of a value that is not a Double or Float");
+}
+
+static double pl_to_double(pl_value x, uint32_t line, const char* function)
+{
+    switch(x.tag)
+    {
+        case PL_INT: return (double)x.as.i;
+        case PL_FLOAT: return x.as.f;
+        case PL_DOUBLE: return x.as.d;
+    }
+    pl_fail(line, function, "toDouble of a value that is not a number");
+}
+
+static int64_t pl_truncate(double d, uint32_t line, const char* function)
+{
+    /* out of range conversions would be undefined */
+    if(!(d > -9223372036854775808.0 && d < 9223372036854775808.0)) pl_fail(line, function, "toInt of a number outside the range of Int");
+    return (int64_t)d;
+}
+
+static int64_t pl_to_int(pl_value x, uint32_t line, const char* function)
+{
+    switch(x.tag)
+    {
+        case PL_INT: return x.as.i;
+        case PL_CHAR: return x.as.c;
+        case PL_FLOAT: return pl_truncate(x.as.f, line, function);
+        case PL_DOUBLE: return pl_truncate(x.as.d, line, function);
+    }
+    pl_fail(line, function, "toInt of a value that is not a number");
+}
+)runtime";
+
+    //how a value is held in C. the order matches the tags of the runtime, so a representation
+    //doubles as the kind of a field. NONE is only seen while representations are inferred
+    enum CRepr : uint8_t {
+        REPR_NONE,
+        REPR_BOOL,
+        REPR_INT,
+        REPR_FLOAT,
+        REPR_DOUBLE,
+        REPR_CHAR,
+        REPR_OBJECT,
+        REPR_VALUE
+    };
+    static_assert((int)REPR_BOOL == (int)SLOT_BOOL && (int)REPR_OBJECT == (int)SLOT_POINTER && (int)REPR_VALUE == (int)SLOT_VALUE, "a field's kind is its representation");
+
+    static const char* cType(CRepr r)
+    {
+        switch(r)
+        {
+            case REPR_BOOL: return "bool";
+            case REPR_INT: return "int64_t";
+            case REPR_FLOAT: return "float";
+            case REPR_DOUBLE: return "double";
+            case REPR_CHAR: return "uint32_t";
+            case REPR_OBJECT: return "pl_object*";
+            default: return "pl_value";
+        }
+    }
+
+    static const char* reprName(CRepr r)
+    {
+        switch(r)
+        {
+            case REPR_BOOL: return "Bool";
+            case REPR_INT: return "Int";
+            case REPR_FLOAT: return "Float";
+            case REPR_DOUBLE: return "Double";
+            case REPR_CHAR: return "Char";
+            case REPR_OBJECT: return "object";
+            default: return "any";
+        }
+    }
+
+    static CRepr join(CRepr x, CRepr y)
+    {
+        if(x == REPR_NONE) return y;
+        if(y == REPR_NONE || x == y) return x;
+        return REPR_VALUE;
+    }
+
+    static bool isNumber(CRepr r)
+    {
+        return r == REPR_INT || r == REPR_DOUBLE || r == REPR_FLOAT;
+    }
+
+    //the text of a C string literal holding `text`
+    static std::string quote(const std::string& text)
+    {
+        std::string out = "\"";
+        for(unsigned char c : text)
+        {
+            if(c == '"' || c == '\\' || c == '?')
+            {
+                out.push_back('\\');
+                out.push_back((char)c);
+            }
+            else if(c >= 0x20 && c < 0x7f) out.push_back((char)c);
+            else
+            {
+                char buffer[8];
+                snprintf(buffer, sizeof(buffer), "\\%03o", c);
+                out.append(buffer);
+            }
+        }
+        out.push_back('"');
+        return out;
+    }
+
+    static std::string number(uint32_t n)
+    {
+        return std::to_string(n);
+    }
+
+    struct CGenerator {
+        const IrModule& ir;
+        DiagnosticEngine& diagnostics;
+        bool failed;
+        uint32_t line;
+        //representation of every type of the module
+        std::vector<CRepr> typeReprs;
+        LayoutEngine layoutEngine;
+        //how every field of a struct or tuple is held
+        std::vector<std::vector<CRepr>> slots;
+        std::vector<CRepr> globals;
+        std::vector<bool> natives;
+
+        //a function instantiated for one representation of each of its parameters
+        struct Instance {
+            uint32_t function;
+            std::vector<CRepr> key;
+            CRepr result;
+        };
+        std::vector<Instance> instances;
+        std::map<std::pair<uint32_t, std::vector<CRepr>>, uint32_t> instanceIndex;
+        std::vector<uint32_t> pending;
+        //functions used as values, which get a closure object and a boxed entry point
+        std::vector<bool> closures;
+
+        std::string prototypes;
+        std::vector<std::string> definitions;
+        //the instances each one calls in tail position, itself aside, and the groups of those
+        //that reach each other through such calls, which share one C function to jump around in
+        std::vector<std::vector<uint32_t>> tailCalls;
+        std::vector<uint32_t> groups;
+        std::vector<std::vector<uint32_t>> groupMembers;
+        //set by a tail call that became a jump, after which the rest of its block is unreachable
+        bool jumped;
+
+        //the instance being generated, and what its names start with in the C function
+        uint32_t current;
+        std::string prefix;
+        const IrFunction* function;
+        std::vector<CRepr> key;
+        CRepr result;
+        std::vector<CRepr> repr;
+        std::string body;
+
+        CGenerator(const IrModule& ir, DiagnosticEngine& diagnostics)
+        : ir(ir), diagnostics(diagnostics), failed(false), line(0), layoutEngine(ir), current(0), function(nullptr), result(REPR_VALUE) {}
+
+        void unsupported(const char* message)
+        {
+            failed = true;
+            diagnostics.report(DIAG_UNSUPPORTED, SEVERITY_ERROR, nullptr, nullptr, message, {}, (int)line);
+        }
+
+        //scalars of a known type are held unboxed and structs, unions, strings, tuples, arrays and
+        //functions as pointers. type variables, Void and anything not known by name are tagged
+        CRepr reprOf(const std::shared_ptr<Ty>& t)
+        {
+            return (CRepr)layoutEngine.kindOf(t);
+        }
+
+        //the struct or tuple layout every value of type `type` has, or irNone
+        uint32_t recordLayout(uint32_t type)
+        {
+            auto layout = layoutEngine.layoutOf(type);
+            return layout == irNone || ir.layouts[layout].isUnion ? irNone : layout;
+        }
+
+        //the field `field` names in records of layout `layout`, or irNone
+        uint32_t fieldIndex(uint32_t layout, uint32_t field)
+        {
+            auto& f = ir.fields[field];
+            if(f.index != irNone) return f.index < slots[layout].size() ? f.index : irNone;
+            auto& names = ir.layouts[layout].names;
+            for(uint32_t k = 0; k < names.size(); k++)
+            {
+                if(names[k] == f.name) return k;
+            }
+            return irNone;
+        }
+
+        //the name runtime errors in instruction `i` give: the inlined function it came from, if any
+        std::string where(uint32_t i)
+        {
+            auto& name = !function->origins.empty() && function->origins[i] != 0 ? function->inlined[function->origins[i] - 1] : function->name;
+            return ", " + number(function->lines[i]) + ", " + quote(name);
+        }
+
+        CRepr resultOf(uint32_t f, const std::vector<CRepr>& key)
+        {
+            auto& callee = ir.functions[f];
+            auto r = typeReprs[callee.result];
+            if(r != REPR_VALUE || ir.types[callee.result]->type != Ty::TY_VAR) return r;
+            //a result of the same type variable as a parameter is held like that argument
+            for(size_t k = 0; k < callee.params.size(); k++)
+            {
+                if(callee.params[k] == callee.result) return key[k];
+            }
+            return REPR_VALUE;
+        }
+
+        //parameters of a known type take its representation and the others the argument's
+        bool keyOf(uint32_t call, std::vector<CRepr>& out)
+        {
+            auto& in = function->instructions[call];
+            auto& callee = ir.functions[in.c];
+            out.resize(in.b);
+            for(uint32_t k = 0; k < in.b; k++)
+            {
+                auto declared = k < callee.params.size() ? typeReprs[callee.params[k]] : REPR_VALUE;
+                out[k] = declared != REPR_VALUE ? declared : repr[function->operands[in.a + k]];
+                if(out[k] == REPR_NONE) return false;
+            }
+            return true;
+        }
+
+        //gives the function a closure object and an entry point taking tagged arguments
+        void useAsValue(uint32_t f)
+        {
+            if(closures[f]) return;
+            closures[f] = true;
+            instance(f, declaredKey(f));
+        }
+
+        std::vector<CRepr> declaredKey(uint32_t f)
+        {
+            std::vector<CRepr> out;
+            for(auto p : ir.functions[f].params) out.push_back(typeReprs[p]);
+            return out;
+        }
+
+        uint32_t instance(uint32_t f, const std::vector<CRepr>& key)
+        {
+            auto k = std::make_pair(f, key);
+            auto it = instanceIndex.find(k);
+            if(it != instanceIndex.end()) return it->second;
+            auto index = (uint32_t)instances.size();
+            instances.push_back(Instance{f, key, resultOf(f, key)});
+            instanceIndex.emplace(k, index);
+            pending.push_back(index);
+            definitions.emplace_back();
+            tailCalls.emplace_back();
+            groups.push_back(irNone);
+            std::string comment = " /* " + ir.functions[f].name + "(";
+            for(size_t p = 0; p < key.size(); p++) comment += (p != 0 ? ", " : "") + std::string(reprName(key[p]));
+            comment += ") */";
+            prototypes += signature(index) + ";" + comment + "\n";
+            return index;
+        }
+
+        std::string signature(uint32_t index)
+        {
+            auto& key = instances[index].key;
+            std::string out = "static " + std::string(cType(instances[index].result)) + " pl_f" + number(index) + "(";
+            for(size_t p = 0; p < key.size(); p++) out += (p != 0 ? ", " : "") + std::string(cType(key[p])) + " p" + number((uint32_t)p);
+            if(key.empty()) out += "void";
+            return out + ")";
+        }
+
+        //the names of an instance generated into the function of its group start with its index
+        std::string prefixOf(uint32_t index)
+        {
+            return groups[index] != irNone ? "i" + number(index) + "_" : "";
+        }
+
+        //representation the instruction computes its value in, from those of its operands
+        CRepr natural(uint32_t i)
+        {
+            auto& in = function->instructions[i];
+            switch(in.op)
+            {
+                case IR_CONST:
+                {
+                    switch(ir.constants[in.a].kind)
+                    {
+                        case CONST_BOOL: return REPR_BOOL;
+                        case CONST_INT: return REPR_INT;
+                        case CONST_FLOAT: return REPR_FLOAT;
+                        case CONST_DOUBLE: return REPR_DOUBLE;
+                        case CONST_CHAR: return REPR_CHAR;
+                        case CONST_STRING: return REPR_OBJECT;
+                        default: return REPR_VALUE;
+                    }
+                }
+                case IR_PARAM: return in.a < key.size() ? key[in.a] : REPR_VALUE;
+                case IR_PHI:
+                {
+                    auto r = REPR_NONE;
+                    for(uint32_t k = 0; k < in.b; k++) r = join(r, repr[function->operands[in.a + 2 * k + 1]]);
+                    return r;
+                }
+                case IR_GLOBAL: return globals[in.a];
+                case IR_FUNCTION:
+                case IR_CLOSURE:
+                case IR_LOCALCLOSURE:
+                case IR_RECORD:
+                case IR_ARRAY:
+                case IR_VARIANT: return REPR_OBJECT;
+                case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+                case IR_BAND: case IR_BOR: case IR_BXOR: case IR_SHL: case IR_SHR:
+                {
+                    auto x = repr[in.a], y = repr[in.b];
+                    if(x == REPR_NONE || y == REPR_NONE) return REPR_NONE;
+                    return typedArithmetic(in.op, x, y) ? x : REPR_VALUE;
+                }
+                case IR_EQ: case IR_NE: case IR_LT: case IR_LE:
+                case IR_NOT: return REPR_BOOL;
+                case IR_NEG:
+                {
+                    auto x = repr[in.a];
+                    return x == REPR_NONE || isNumber(x) ? x : REPR_VALUE;
+                }
+                case IR_CALL:
+                {
+                    if(ir.functions[in.c].external) return nativeRepr(i);
+                    std::vector<CRepr> k;
+                    if(!keyOf(i, k)) return REPR_NONE;
+                    return resultOf(in.c, k);
+                }
+                case IR_GETFIELD:
+                {
+                    auto layout = recordLayout(function->instructions[in.a].type);
+                    auto index = layout != irNone ? fieldIndex(layout, in.b) : irNone;
+                    return index != irNone ? slots[layout][index] : REPR_VALUE;
+                }
+                case IR_TAG: return REPR_INT;
+                default: return REPR_VALUE;
+            }
+        }
+
+        static bool typedArithmetic(IrOpcode op, CRepr x, CRepr y)
+        {
+            if(x != y || !isNumber(x)) return false;
+            return x == REPR_INT || op <= IR_MOD;
+        }
+
+        CRepr nativeRepr(uint32_t i)
+        {
+            auto& in = function->instructions[i];
+            auto& name = ir.functions[in.c].name;
+            auto x = in.b != 0 ? repr[function->operands[in.a]] : REPR_VALUE;
+            if(name == "array") return REPR_OBJECT;
+            if(name == "length" || name == "toInt") return REPR_INT;
+            if(name == "toDouble") return REPR_DOUBLE;
+            if(name == "sqrt")
+            {
+                if(x == REPR_NONE) return REPR_NONE;
+                return x == REPR_DOUBLE || x == REPR_FLOAT ? x : REPR_VALUE;
+            }
+            return REPR_VALUE;
+        }
+
+        //values whose type gives no representation take the one they are computed in, phis the
+        //join of their operands', until nothing changes. what is still unknown then is tagged
+        void inferReprs(const std::vector<uint32_t>& order)
+        {
+            repr.assign(function->instructions.size(), REPR_NONE);
+            bool settled = false;
+            for(;;)
+            {
+                bool changed = false;
+                for(auto b : order)
+                {
+                    for(auto i : function->blocks[b].instructions)
+                    {
+                        auto& in = function->instructions[i];
+                        if(!definesValue(in.op)) continue;
+                        auto r = typeReprs[in.type];
+                        if(r == REPR_VALUE) r = natural(i);
+                        r = join(repr[i], r);
+                        if(r == REPR_NONE && settled) r = REPR_VALUE;
+                        if(r != repr[i])
+                        {
+                            repr[i] = r;
+                            changed = true;
+                        }
+                    }
+                }
+                if(!changed)
+                {
+                    if(settled) break;
+                    settled = true;
+                }
+            }
+        }
+
+        std::string value(uint32_t v)
+        {
+            return prefix + "v" + number(v);
+        }
+
+        static std::string box(CRepr r)
+        {
+            switch(r)
+            {
+                case REPR_BOOL: return "pl_bool";
+                case REPR_INT: return "pl_int";
+                case REPR_FLOAT: return "pl_float";
+                case REPR_DOUBLE: return "pl_double";
+                case REPR_CHAR: return "pl_char";
+                case REPR_OBJECT: return "pl_obj";
+                default: return "";
+            }
+        }
+
+        static const char* member(CRepr r)
+        {
+            switch(r)
+            {
+                case REPR_BOOL: return "b";
+                case REPR_INT: return "i";
+                case REPR_FLOAT: return "f";
+                case REPR_DOUBLE: return "d";
+                case REPR_CHAR: return "c";
+                default: return "o";
+            }
+        }
+
+        //`expression`, held as `from`, held as `to`. unboxing trusts the type checker
+        static std::string convert(const std::string& expression, CRepr from, CRepr to)
+        {
+            if(from == to) return expression;
+            if(to == REPR_VALUE) return box(from) + "(" + expression + ")";
+            if(from == REPR_VALUE) return "(" + expression + ").as." + member(to);
+            return convert(convert(expression, from, REPR_VALUE), REPR_VALUE, to);
+        }
+
+        std::string operand(uint32_t v, CRepr to)
+        {
+            return convert(value(v), repr[v], to);
+        }
+
+        std::string constant(uint32_t index)
+        {
+            auto& k = ir.constants[index];
+            char buffer[64];
+            switch(k.kind)
+            {
+                case CONST_BOOL: return k.bits != 0 ? "true" : "false";
+                case CONST_INT:
+                {
+                    if((int64_t)k.bits == INT64_MIN) return "INT64_MIN";
+                    snprintf(buffer, sizeof(buffer), "INT64_C(%" PRId64 ")", (int64_t)k.bits);
+                    return buffer;
+                }
+                case CONST_CHAR: return "UINT32_C(" + std::to_string((uint32_t)k.bits) + ")";
+                case CONST_FLOAT:
+                {
+                    float f;
+                    auto bits = (uint32_t)k.bits;
+                    memcpy(&f, &bits, sizeof(f));
+                    if(std::isnan(f)) return "(float)NAN";
+                    if(std::isinf(f)) return f > 0 ? "(float)INFINITY" : "-(float)INFINITY";
+                    snprintf(buffer, sizeof(buffer), "%af", (double)f);
+                    return buffer;
+                }
+                case CONST_DOUBLE:
+                {
+                    double d;
+                    memcpy(&d, &k.bits, sizeof(d));
+                    if(std::isnan(d)) return "NAN";
+                    if(std::isinf(d)) return d > 0 ? "INFINITY" : "-INFINITY";
+                    snprintf(buffer, sizeof(buffer), "%a", d);
+                    return buffer;
+                }
+                case CONST_STRING: return "(pl_object*)&pl_s" + std::to_string(k.bits);
+                default: return "pl_void()";
+            }
+        }
+
+        void assign(uint32_t i, const std::string& expression, CRepr from)
+        {
+            body += "    " + value(i) + " = " + convert(expression, from, repr[i]) + ";\n";
+        }
+
+        //the copies the phis of `to` stand for on the edge from `from`. they happen at once, so
+        //with more than one they go through temporaries
+        std::string moves(uint32_t from, uint32_t to)
+        {
+            std::vector<std::pair<uint32_t, std::string>> copies;
+            for(auto i : function->blocks[to].instructions)
+            {
+                auto& in = function->instructions[i];
+                if(in.op != IR_PHI) break;
+                for(uint32_t k = 0; k < in.b; k++)
+                {
+                    if(function->operands[in.a + 2 * k] != from) continue;
+                    auto v = function->operands[in.a + 2 * k + 1];
+                    if(v != i) copies.emplace_back(i, operand(v, repr[i]));
+                }
+            }
+            if(copies.empty()) return "";
+            if(copies.size() == 1) return value(copies[0].first) + " = " + copies[0].second + "; ";
+            std::string out = "{ ";
+            for(size_t k = 0; k < copies.size(); k++) out += std::string(cType(repr[copies[k].first])) + " t" + number((uint32_t)k) + " = " + copies[k].second + "; ";
+            for(size_t k = 0; k < copies.size(); k++) out += value(copies[k].first) + " = t" + number((uint32_t)k) + "; ";
+            return out + "} ";
+        }
+
+        std::string jump(uint32_t from, uint32_t to)
+        {
+            return moves(from, to) + "goto " + prefix + "b" + number(to) + ";";
+        }
+
+        std::string arguments(uint32_t offset, uint32_t count)
+        {
+            if(count == 0) return "NULL";
+            std::string out = "(pl_value[]){";
+            for(uint32_t k = 0; k < count; k++) out += (k != 0 ? ", " : "") + operand(function->operands[offset + k], REPR_VALUE);
+            return out + "}";
+        }
+
+        void native(uint32_t i)
+        {
+            auto& in = function->instructions[i];
+            auto& name = ir.functions[in.c].name;
+            auto x = function->operands[in.a];
+            auto r = repr[x];
+            auto at = where(i);
+            if(name == "print") assign(i, "pl_print(" + operand(x, REPR_VALUE) + ")", REPR_VALUE);
+            else if(name == "array") assign(i, "pl_array_new(" + operand(x, REPR_VALUE) + ", " + operand(function->operands[in.a + 1], REPR_VALUE) + at + ")", REPR_OBJECT);
+            else if(name == "length") assign(i, "pl_length(" + operand(x, REPR_VALUE) + at + ")", REPR_INT);
+            else if(name == "sqrt")
+            {
+                if(r == REPR_DOUBLE) assign(i, "sqrt(" + value(x) + ")", r);
+                else if(r == REPR_FLOAT) assign(i, "sqrtf(" + value(x) + ")", r);
+                else assign(i, "pl_sqrt(" + value(x) + at + ")", REPR_VALUE);
+            }
+            else if(name == "toDouble")
+            {
+                if(r == REPR_INT || r == REPR_FLOAT || r == REPR_DOUBLE) assign(i, "(double)" + value(x), REPR_DOUBLE);
+                else assign(i, "pl_to_double(" + operand(x, REPR_VALUE) + at + ")", REPR_DOUBLE);
+            }
+            else if(name == "toInt")
+            {
+                if(r == REPR_INT || r == REPR_CHAR) assign(i, "(int64_t)" + value(x), REPR_INT);
+                else if(r == REPR_DOUBLE || r == REPR_FLOAT) assign(i, "pl_truncate(" + value(x) + at + ")", REPR_INT);
+                else assign(i, "pl_to_int(" + operand(x, REPR_VALUE) + at + ")", REPR_INT);
+            }
+        }
+
+        void arithmetic(uint32_t i)
+        {
+            auto& in = function->instructions[i];
+            auto x = repr[in.a], y = repr[in.b];
+            auto a = value(in.a), b = value(in.b);
+            if(!typedArithmetic(in.op, x, y))
+            {
+                assign(i, "pl_arith(" + number(in.op - IR_ADD) + ", " + operand(in.a, REPR_VALUE) + ", " + operand(in.b, REPR_VALUE) + where(i) + ")", REPR_VALUE);
+                return;
+            }
+            static const char* symbols[] = {"+", "-", "*", "/", "%", "&", "|", "^"};
+            if(x != REPR_INT)
+            {
+                if(in.op == IR_MOD) assign(i, std::string(x == REPR_FLOAT ? "fmodf(" : "fmod(") + a + ", " + b + ")", x);
+                else assign(i, a + " " + symbols[in.op - IR_ADD] + " " + b, x);
+                return;
+            }
+            //integers wrap around instead of overflowing
+            switch(in.op)
+            {
+                case IR_DIV: assign(i, "pl_div(" + a + ", " + b + where(i) + ")", x); return;
+                case IR_MOD: assign(i, "pl_mod(" + a + ", " + b + where(i) + ")", x); return;
+                case IR_SHL: assign(i, "(int64_t)((uint64_t)" + a + " << (" + b + " & 63))", x); return;
+                case IR_SHR: assign(i, a + " >> (" + b + " & 63)", x); return;
+                default: assign(i, "(int64_t)((uint64_t)" + a + " " + symbols[in.op - IR_ADD] + " (uint64_t)" + b + ")", x); return;
+            }
+        }
+
+        void comparison(uint32_t i)
+        {
+            auto& in = function->instructions[i];
+            auto x = repr[in.a], y = repr[in.b];
+            auto a = value(in.a), b = value(in.b);
+            bool scalar = x == y && x != REPR_OBJECT && x != REPR_VALUE;
+            switch(in.op)
+            {
+                case IR_EQ:
+                case IR_NE:
+                {
+                    if(scalar) assign(i, a + (in.op == IR_EQ ? " == " : " != ") + b, REPR_BOOL);
+                    else assign(i, std::string(in.op == IR_EQ ? "" : "!") + "pl_equal(" + operand(in.a, REPR_VALUE) + ", " + operand(in.b, REPR_VALUE) + ", 0)", REPR_BOOL);
+                    return;
+                }
+                default:
+                {
+                    if(scalar && x != REPR_BOOL) assign(i, a + (in.op == IR_LT ? " < " : " <= ") + b, REPR_BOOL);
+                    else assign(i, std::string("pl_order(") + (in.op == IR_LT ? "PL_LT" : "PL_LE") + ", " + operand(in.a, REPR_VALUE) + ", " + operand(in.b, REPR_VALUE) + where(i) + ")", REPR_BOOL);
+                    return;
+                }
+            }
+        }
+
+        void instruction(uint32_t i, uint32_t block)
+        {
+            auto& in = function->instructions[i];
+            switch(in.op)
+            {
+                case IR_PHI: return;
+                case IR_PARAM: assign(i, prefix + "p" + number(in.a), natural(i)); return;
+                case IR_CONST: assign(i, constant(in.a), natural(i)); return;
+                case IR_UNDEF: assign(i, "pl_void()", REPR_VALUE); return;
+                case IR_GLOBAL: assign(i, "pl_g" + number(in.a), globals[in.a]); return;
+                case IR_SETGLOBAL: body += "    pl_g" + number(in.a) + " = " + operand(in.b, globals[in.a]) + ";\n"; return;
+                case IR_FUNCTION:
+                {
+                    if(ir.functions[in.a].external)
+                    {
+                        unsupported(natives[in.a] ? "built-in functions can only be called directly" : "function is declared without a body");
+                        return;
+                    }
+                    useAsValue(in.a);
+                    assign(i, "(pl_object*)&pl_c" + number(in.a), REPR_OBJECT);
+                    return;
+                }
+                case IR_CLOSURE:
+                case IR_LOCALCLOSURE:
+                {
+                    //a closure that cannot outlive the call is kept in the C function's own variables
+                    useAsValue(in.c);
+                    auto proto = "pl_c" + number(in.c);
+                    if(in.op == IR_CLOSURE) body += "    { pl_closure* c = pl_closure_new(&" + proto + ", " + number(in.b) + "); pl_value* e = (pl_value*)(c + 1); ";
+                    else body += "    { pl_closure* c = &" + prefix + "l" + number(i) + "; pl_value* e = " + prefix + "e" + number(i) + "; *c = " + proto + "; c->env = e; ";
+                    for(uint32_t k = 0; k < in.b; k++) body += "e[" + number(k) + "] = " + operand(function->operands[in.a + k], REPR_VALUE) + "; ";
+                    body += value(i) + " = " + convert("&c->h", REPR_OBJECT, repr[i]) + "; }\n";
+                    return;
+                }
+                case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+                case IR_BAND: case IR_BOR: case IR_BXOR: case IR_SHL: case IR_SHR: arithmetic(i); return;
+                case IR_EQ: case IR_NE: case IR_LT: case IR_LE: comparison(i); return;
+                case IR_NEG:
+                {
+                    auto x = repr[in.a];
+                    if(x == REPR_INT) assign(i, "(int64_t)(0 - (uint64_t)" + value(in.a) + ")", x);
+                    else if(isNumber(x)) assign(i, "-" + value(in.a), x);
+                    else assign(i, "pl_neg(" + operand(in.a, REPR_VALUE) + where(i) + ")", REPR_VALUE);
+                    return;
+                }
+                case IR_NOT:
+                {
+                    if(repr[in.a] == REPR_BOOL) assign(i, "!" + value(in.a), REPR_BOOL);
+                    else assign(i, "pl_not(" + operand(in.a, REPR_VALUE) + where(i) + ")", REPR_BOOL);
+                    return;
+                }
+                case IR_CALL:
+                {
+                    if(ir.functions[in.c].external)
+                    {
+                        if(!natives[in.c]) unsupported("function is declared without a body");
+                        else native(i);
+                        return;
+                    }
+                    std::vector<CRepr> k;
+                    keyOf(i, k);
+                    auto callee = instance(in.c, k);
+                    if(isTailCall(*function, block, i))
+                    {
+                        //a tail call of the instance itself or of one in its group becomes a jump
+                        //to the callee's entry, with the arguments in its parameters
+                        if(callee == current || (groups[current] != irNone && groups[callee] == groups[current]))
+                        {
+                            auto callPrefix = prefixOf(callee);
+                            body += "    ";
+                            for(uint32_t n = 0; n < in.b; n++) body += callPrefix + "p" + number(n) + " = " + operand(function->operands[in.a + n], k[n]) + "; ";
+                            body += "goto " + callPrefix + "b0;\n";
+                            jumped = true;
+                            return;
+                        }
+                        if(std::find(tailCalls[current].begin(), tailCalls[current].end(), callee) == tailCalls[current].end()) tailCalls[current].push_back(callee);
+                    }
+                    std::string call = "pl_f" + number(callee) + "(";
+                    for(uint32_t n = 0; n < in.b; n++) call += (n != 0 ? ", " : "") + operand(function->operands[in.a + n], k[n]);
+                    body += "    pl_enter(" + where(i).substr(2) + ");\n";
+                    assign(i, call + ")", instances[callee].result);
+                    body += "    pl_depth++;\n";
+                    return;
+                }
+                case IR_CALLVALUE:
+                {
+                    auto callee = function->operands[in.a];
+                    assign(i, "pl_call(" + operand(callee, REPR_VALUE) + ", " + number(in.b - 1) + ", " + arguments(in.a + 1, in.b - 1) + where(i) + ")", REPR_VALUE);
+                    return;
+                }
+                case IR_RECORD:
+                {
+                    auto layout = in.c;
+                    auto type = "pl_r" + number(layout);
+                    body += "    { " + type + "* r = pl_alloc(sizeof(" + type + "), PL_RECORD, &pl_l" + number(layout) + "); ";
+                    for(uint32_t k = 0; k < in.b; k++) body += "r->f" + number(k) + " = " + operand(function->operands[in.a + k], slots[layout][k]) + "; ";
+                    body += value(i) + " = " + convert("&r->h", REPR_OBJECT, repr[i]) + "; }\n";
+                    return;
+                }
+                case IR_GETFIELD:
+                {
+                    auto layout = recordLayout(function->instructions[in.a].type);
+                    auto index = layout != irNone ? fieldIndex(layout, in.b) : irNone;
+                    if(index != irNone) assign(i, "((pl_r" + number(layout) + "*)" + operand(in.a, REPR_OBJECT) + ")->f" + number(index), slots[layout][index]);
+                    else if(ir.fields[in.b].index != irNone) assign(i, "pl_getfield(" + operand(in.a, REPR_VALUE) + ", " + number(ir.fields[in.b].index) + where(i) + ")", REPR_VALUE);
+                    else assign(i, "pl_getnamed(" + operand(in.a, REPR_VALUE) + ", " + quote(symbolName(ir.fields[in.b].name)) + where(i) + ")", REPR_VALUE);
+                    return;
+                }
+                case IR_SETFIELD:
+                {
+                    auto layout = recordLayout(function->instructions[in.a].type);
+                    auto index = layout != irNone ? fieldIndex(layout, in.b) : irNone;
+                    if(index != irNone) body += "    ((pl_r" + number(layout) + "*)" + operand(in.a, REPR_OBJECT) + ")->f" + number(index) + " = " + operand(in.c, slots[layout][index]) + ";\n";
+                    else if(ir.fields[in.b].index != irNone) body += "    pl_setfield(" + operand(in.a, REPR_VALUE) + ", " + number(ir.fields[in.b].index) + ", " + operand(in.c, REPR_VALUE) + where(i) + ");\n";
+                    else body += "    pl_setnamed(" + operand(in.a, REPR_VALUE) + ", " + quote(symbolName(ir.fields[in.b].name)) + ", " + operand(in.c, REPR_VALUE) + where(i) + ");\n";
+                    return;
+                }
+                case IR_ARRAY: assign(i, "pl_array_of(" + number(in.b) + ", " + arguments(in.a, in.b) + ")", REPR_OBJECT); return;
+                case IR_GETINDEX: assign(i, "pl_index(" + operand(in.a, REPR_VALUE) + ", " + operand(in.b, REPR_INT) + where(i) + ")", REPR_VALUE); return;
+                case IR_SETINDEX: body += "    pl_setindex(" + operand(in.a, REPR_VALUE) + ", " + operand(in.b, REPR_INT) + ", " + operand(in.c, REPR_VALUE) + where(i) + ");\n"; return;
+                case IR_VARIANT:
+                {
+                    auto payload = in.a != irNone ? operand(in.a, REPR_VALUE) : "pl_void()";
+                    assign(i, "pl_variant_of(&pl_l" + number(in.b) + ", " + number(in.c) + ", " + payload + ")", REPR_OBJECT);
+                    return;
+                }
+                case IR_TAG: assign(i, "pl_variant_tag(pl_union(" + operand(in.a, REPR_VALUE) + where(i) + "))", REPR_INT); return;
+                case IR_PAYLOAD: assign(i, "pl_variant_payload(pl_union(" + operand(in.a, REPR_VALUE) + where(i) + "))", REPR_VALUE); return;
+                case IR_JUMP: body += "    " + jump(block, in.a) + "\n"; return;
+                case IR_BRANCH:
+                {
+                    body += "    if(" + operand(in.a, REPR_BOOL) + ") { " + jump(block, in.b) + " }\n";
+                    body += "    " + jump(block, in.c) + "\n";
+                    return;
+                }
+                case IR_SWITCH:
+                {
+                    auto chars = in.c != 0 && ir.constants[function->operands[in.b + 1]].kind == CONST_CHAR;
+                    body += "    switch(" + operand(in.a, chars ? REPR_CHAR : REPR_INT) + ")\n    {\n";
+                    for(uint32_t k = 0; k < in.c; k++)
+                    {
+                        body += "        case " + constant(function->operands[in.b + 1 + 2 * k]) + ": { " + jump(block, function->operands[in.b + 2 + 2 * k]) + " }\n";
+                    }
+                    body += "        default: { " + jump(block, function->operands[in.b]) + " }\n    }\n";
+                    return;
+                }
+                case IR_RETURN:
+                {
+                    //a path that falls off the end of a function returns nothing
+                    if(in.a != irNone) body += "    return " + operand(in.a, result) + ";\n";
+                    else body += "    return " + convert("pl_void()", REPR_VALUE, result) + ";\n";
+                    return;
+                }
+                case IR_UNREACHABLE: body += "    return " + convert("pl_void()", REPR_VALUE, result) + ";\n"; return;
+                default: return;
+            }
+        }
+
+        //the variables of the instance go to `declarations` and its code to `body`. it returns
+        //values as `returned`, which is its own result unless it shares a group's function
+        void generateBody(uint32_t index, CRepr returned, std::string& declarations)
+        {
+            auto f = instances[index].function;
+            function = &ir.functions[f];
+            key = instances[index].key;
+            result = returned;
+            current = index;
+            prefix = prefixOf(index);
+            line = 0;
+            auto order = reversePostorder(*function);
+            inferReprs(order);
+            for(auto b : order)
+            {
+                for(auto i : function->blocks[b].instructions)
+                {
+                    auto& in = function->instructions[i];
+                    if(definesValue(in.op)) declarations += "    " + std::string(cType(repr[i])) + " " + value(i) + ";\n";
+                    if(in.op == IR_LOCALCLOSURE) declarations += "    pl_closure " + prefix + "l" + number(i) + "; pl_value " + prefix + "e" + number(i) + "[" + number(in.b) + "];\n";
+                }
+            }
+            for(auto b : order)
+            {
+                body += prefix + "b" + number(b) + ":\n";
+                jumped = false;
+                for(auto i : function->blocks[b].instructions)
+                {
+                    line = function->lines[i];
+                    instruction(i, b);
+                    if(jumped) break;
+                }
+            }
+        }
+
+        void generateInstance(uint32_t index)
+        {
+            std::string declarations;
+            body.clear();
+            generateBody(index, instances[index].result, declarations);
+            definitions[index] = signature(index) + "\n{\n" + declarations + body + "}\n\n";
+        }
+
+        //instances that reach each other through tail calls, found with Tarjan's algorithm, are
+        //generated again into one C function per group. there every one of them has its own
+        //variables, and the functions of the instances only enter it at theirs
+        void groupTailCalls()
+        {
+            auto count = (uint32_t)instances.size();
+            std::vector<uint32_t> index(count, irNone);
+            std::vector<uint32_t> low(count, 0);
+            std::vector<bool> onStack(count, false);
+            std::vector<uint32_t> stack;
+            //(instance, tail calls already visited)
+            std::vector<std::pair<uint32_t, size_t>> work;
+            uint32_t visited = 0;
+            for(uint32_t root = 0; root < count; root++)
+            {
+                if(index[root] != irNone) continue;
+                work.emplace_back(root, 0);
+                while(!work.empty())
+                {
+                    auto f = work.back().first;
+                    if(index[f] == irNone)
+                    {
+                        index[f] = low[f] = visited++;
+                        stack.push_back(f);
+                        onStack[f] = true;
+                    }
+                    auto& callees = tailCalls[f];
+                    if(work.back().second < callees.size())
+                    {
+                        auto g = callees[work.back().second++];
+                        if(index[g] == irNone) work.emplace_back(g, 0);
+                        else if(onStack[g]) low[f] = std::min(low[f], index[g]);
+                        continue;
+                    }
+                    work.pop_back();
+                    if(!work.empty()) low[work.back().first] = std::min(low[work.back().first], low[f]);
+                    if(low[f] != index[f]) continue;
+                    std::vector<uint32_t> members;
+                    while(true)
+                    {
+                        auto g = stack.back();
+                        stack.pop_back();
+                        onStack[g] = false;
+                        members.push_back(g);
+                        if(g == f) break;
+                    }
+                    if(members.size() < 2) continue;
+                    std::sort(members.begin(), members.end());
+                    for(auto m : members) groups[m] = (uint32_t)groupMembers.size();
+                    groupMembers.push_back(members);
+                }
+            }
+            for(uint32_t g = 0; g < groupMembers.size(); g++) generateGroup(g);
+        }
+
+        static std::string zero(CRepr r)
+        {
+            switch(r)
+            {
+                case REPR_BOOL: return "false";
+                case REPR_OBJECT: return "NULL";
+                case REPR_VALUE: return "pl_void()";
+                default: return "0";
+            }
+        }
+
+        //pl_gN(entry, parameters of every member) runs the member at `entry`. the function of each
+        //member passes its own parameters and zeros for the others'
+        void generateGroup(uint32_t g)
+        {
+            auto& members = groupMembers[g];
+            auto returned = instances[members[0]].result;
+            for(auto m : members) if(instances[m].result != returned) returned = REPR_VALUE;
+            std::string declarations, parameters, entries;
+            body.clear();
+            for(uint32_t k = 0; k < members.size(); k++)
+            {
+                auto m = members[k];
+                for(size_t p = 0; p < instances[m].key.size(); p++) parameters += ", " + std::string(cType(instances[m].key[p])) + " " + prefixOf(m) + "p" + number((uint32_t)p);
+                entries += "        case " + number(k) + ": goto " + prefixOf(m) + "b0;\n";
+                generateBody(m, returned, declarations);
+            }
+            auto name = "pl_g" + number(g);
+            auto header = "static " + std::string(cType(returned)) + " " + name + "(uint32_t entry" + parameters + ")";
+            prototypes += header + ";\n";
+            definitions.push_back(header + "\n{\n" + declarations + "    switch(entry)\n    {\n" + entries + "        default: break;\n    }\n" + body + "}\n\n");
+            for(uint32_t k = 0; k < members.size(); k++)
+            {
+                auto m = members[k];
+                std::string call = name + "(" + number(k);
+                for(auto other : members)
+                {
+                    for(size_t p = 0; p < instances[other].key.size(); p++) call += ", " + (other == m ? "p" + number((uint32_t)p) : zero(instances[other].key[p]));
+                }
+                call += ")";
+                definitions[m] = signature(m) + "\n{\n    return " + convert(call, returned, instances[m].result) + ";\n}\n\n";
+            }
+        }
+
+        //C structs and descriptors for every layout: records hold their fields in the struct, in the
+        //order the layout engine gives them, and unions their payloads and tag where it puts them
+        std::string layouts()
+        {
+            std::string out;
+            for(uint32_t l = 0; l < ir.layouts.size(); l++)
+            {
+                auto& layout = ir.layouts[l];
+                auto n = number(l);
+                auto count = layout.names.size();
+                //tuples print without the positional names the IR gives their fields
+                bool tuple = !layout.isUnion && layout.name.empty();
+                if(!tuple && count != 0)
+                {
+                    out += "static const char* const pl_n" + n + "[] = {";
+                    for(size_t k = 0; k < count; k++) out += (k != 0 ? ", " : "") + quote(symbolName(layout.names[k]));
+                    out += "};\n";
+                }
+                std::string names = !tuple && count != 0 ? "pl_n" + n : "NULL";
+                auto& data = layoutEngine.ofLayout(l);
+                if(layout.isUnion)
+                {
+                    out += "static const bool pl_e" + n + "[] = {";
+                    for(size_t k = 0; k < count; k++) out += (k != 0 ? ", " : "") + std::string(layout.empty[k] ? "true" : "false");
+                    if(count == 0) out += "false";
+                    out += "};\n";
+                    std::string kinds = "NULL", offsets = "NULL";
+                    if(count != 0)
+                    {
+                        out += "static const unsigned char pl_k" + n + "[] = {";
+                        for(size_t k = 0; k < count; k++) out += (k != 0 ? ", " : "") + number(data.kinds[k]);
+                        out += "};\n";
+                        out += "static const size_t pl_o" + n + "[] = {";
+                        for(size_t k = 0; k < count; k++) out += (k != 0 ? ", " : "") + std::string("sizeof(pl_object) + ") + number(data.offsets[k]);
+                        out += "};\n";
+                        kinds = "pl_k" + n;
+                        offsets = "pl_o" + n;
+                    }
+                    out += "static const pl_layout pl_l" + n + " = {" + quote(layout.name) + ", " + number((uint32_t)count) + ", " + names + ", " + kinds + ", " + offsets + ", pl_e" + n
+                        + ", sizeof(pl_object) + " + number(data.size) + ", sizeof(pl_object) + " + number(data.tagOffset) + ", " + number(data.tagSize) + ", "
+                        + number(data.dataful == irNone ? 0 : data.dataful) + ", " + std::to_string(data.nicheStart) + "u};\n";
+                    continue;
+                }
+                out += "typedef struct pl_r" + n + " { pl_object h;";
+                for(auto k : data.order) out += " " + std::string(cType(slots[l][k])) + " f" + number(k) + ";";
+                out += " } pl_r" + n + ";\n";
+                //the C compiler places the fields where the layout engine says they are
+                for(auto k : data.order) out += "_Static_assert(offsetof(pl_r" + n + ", f" + number(k) + ") == sizeof(pl_object) + " + number(data.offsets[k]) + ", \"layout of " + n + "\");\n";
+                std::string kinds = "NULL", offsets = "NULL";
+                if(!slots[l].empty())
+                {
+                    out += "static const unsigned char pl_k" + n + "[] = {";
+                    for(size_t k = 0; k < slots[l].size(); k++) out += (k != 0 ? ", " : "") + number(slots[l][k]);
+                    out += "};\n";
+                    out += "static const size_t pl_o" + n + "[] = {";
+                    for(size_t k = 0; k < slots[l].size(); k++) out += (k != 0 ? ", " : "") + std::string("offsetof(pl_r") + n + ", f" + number((uint32_t)k) + ")";
+                    out += "};\n";
+                    kinds = "pl_k" + n;
+                    offsets = "pl_o" + n;
+                }
+                out += "static const pl_layout pl_l" + n + " = {" + quote(layout.name) + ", " + number((uint32_t)slots[l].size()) + ", " + names + ", " + kinds + ", " + offsets + ", NULL, sizeof(pl_r" + n + "), 0, 0, 0, 0};\n";
+            }
+            return out;
+        }
+
+        bool generate(std::string& out)
+        {
+            for(auto& t : ir.types) typeReprs.push_back(reprOf(t));
+            slots.resize(ir.layouts.size());
+            for(uint32_t l = 0; l < ir.layouts.size(); l++)
+            {
+                if(ir.layouts[l].isUnion) continue;
+                for(auto kind : layoutEngine.ofLayout(l).kinds) slots[l].push_back((CRepr)kind);
+            }
+            for(auto& global : ir.globals) globals.push_back(typeReprs[global.type]);
+            for(auto& f : ir.functions) natives.push_back(f.external && findNative(f.name, f.params.size()) >= 0);
+            closures.assign(ir.functions.size(), false);
+
+            auto init = instance(ir.init, {});
+            auto main = ir.main != irNone ? instance(ir.main, {}) : irNone;
+            while(!pending.empty())
+            {
+                auto next = pending.back();
+                pending.pop_back();
+                generateInstance(next);
+            }
+            if(failed) return false;
+            groupTailCalls();
+            if(failed) return false;
+
+            out = runtime;
+            out += "\n";
+            out += layouts();
+            for(size_t s = 0; s < ir.strings.size(); s++)
+            {
+                out += "static pl_string pl_s" + std::to_string(s) + " = {{PL_STRING, NULL}, " + std::to_string(ir.strings[s].size()) + ", " + quote(ir.strings[s]) + "};\n";
+            }
+            for(uint32_t g = 0; g < ir.globals.size(); g++) out += "static " + std::string(cType(globals[g])) + " pl_g" + number(g) + "; /* " + ir.globals[g].name + " */\n";
+            out += "\n" + prototypes + "\n";
+            //a function used as a value is called through an entry point that takes tagged arguments
+            for(uint32_t f = 0; f < ir.functions.size(); f++)
+            {
+                if(!closures[f]) continue;
+                auto k = declaredKey(f);
+                auto callee = instanceIndex.at(std::make_pair(f, k));
+                auto arity = k.size() - ir.functions[f].captures;
+                std::string call = "pl_f" + number(callee) + "(";
+                for(size_t p = 0; p < k.size(); p++)
+                {
+                    auto from = p < arity ? "args[" + std::to_string(p) + "]" : "env[" + std::to_string(p - arity) + "]";
+                    call += (p != 0 ? ", " : "") + convert(from, REPR_VALUE, k[p]);
+                }
+                call += ")";
+                std::string unused = std::string(arity == 0 ? "(void)args; " : "") + (arity == k.size() ? "(void)env; " : "");
+                out += "static pl_value pl_t" + number(f) + "(const pl_value* args, const pl_value* env) { " + unused + "return " + convert(call, instances[callee].result, REPR_VALUE) + "; }\n";
+                out += "static pl_closure pl_c" + number(f) + " = {{PL_CLOSURE, NULL}, " + quote(ir.functions[f].name) + ", " + std::to_string(arity) + ", pl_t" + number(f) + ", NULL};\n";
+            }
+            out += "\n";
+            for(auto& definition : definitions) out += definition;
+            out += "int main(void)\n{\n";
+            out += "    pl_f" + number(init) + "();\n";
+            if(main != irNone)
+            {
+                out += "    pl_value result = " + convert("pl_f" + number(main) + "()", instances[main].result, REPR_VALUE) + ";\n";
+                out += "    if(result.tag != PL_VOID) pl_print(result);\n";
+            }
+            out += "    return 0;\n}\n";
+            return true;
+        }
+    };
+
+    bool generateC(const IrModule& ir, DiagnosticEngine& diagnostics, std::string& out)
+    {
+        CGenerator generator(ir, diagnostics);
+        return generator.generate(out);
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef cbackend_header
+#define cbackend_header
+
+#include <string>
+#include "ir.h"
+
+namespace pilaf {
+    //translates a module in SSA form to a self-contained C11 program whose main runs the top-level
+    //statements and then `main`, printing its result the way `pilaf run` does.
+    //functions are instantiated once per representation of their arguments: Int, Double, Float,
+    //Bool and Char values are held unboxed, aggregates, strings and functions as pointers, and
+    //values of a type that is not known statically in a tagged union. structs are C structs whose
+    //fields have the representation of their declared type; tuples, union payloads and array
+    //elements are tagged. built-in functions are expanded in place or call the runtime the program
+    //carries; using an external function that is not a built-in is reported to `diagnostics`.
+    //returns whether `out` holds the program
+    bool generateC(const IrModule& ir, DiagnosticEngine& diagnostics, std::string& out);
+}
+#endif
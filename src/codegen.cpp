@@ -0,0 +1,767 @@
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include "codegen.h"
+#include "diagnostics.h"
+#include "vm.h"
+
+namespace pilaf {
+    //entries a switch's jump table may have
+    static const uint64_t maxTableEntries = 1 << 16;
+
+    //positions a value is live at, inclusive, in the order the function's instructions are laid out
+    struct LiveRange {
+        uint32_t start;
+        uint32_t end;
+    };
+
+    //whether two lists of disjoint ranges sorted by start share a position
+    static bool overlaps(const std::vector<LiveRange>& x, const std::vector<LiveRange>& y)
+    {
+        size_t i = 0, j = 0;
+        while(i < x.size() && j < y.size())
+        {
+            if(x[i].end < y[j].start) i++;
+            else if(y[j].end < x[i].start) j++;
+            else return true;
+        }
+        return false;
+    }
+
+    static void mergeInto(std::vector<LiveRange>& into, const std::vector<LiveRange>& ranges)
+    {
+        auto middle = into.size();
+        into.insert(into.end(), ranges.begin(), ranges.end());
+        std::inplace_merge(into.begin(), into.begin() + middle, into.end(), [](const LiveRange& x, const LiveRange& y) { return x.start < y.start; });
+    }
+
+    struct Generator {
+        const IrModule& ir;
+        std::shared_ptr<Module> module;
+        DiagnosticEngine& diagnostics;
+        bool failed;
+        //bytecode function of every IR function, or irNone for external ones
+        std::vector<uint32_t> functions;
+        //built-in an external function binds to, or -1
+        std::vector<int> natives;
+        //bytecode constant of every IR constant and string, or noRegister before its first use
+        std::vector<uint16_t> constants;
+        std::vector<uint16_t> strings;
+        std::unordered_map<int64_t, uint16_t> ints;
+
+        //the function being generated
+        const IrFunction* function;
+        Function* out;
+        uint32_t line;
+        //which inlined function the instruction being generated came from, or 0
+        uint32_t origin;
+        //blocks in layout order, and where each block and instruction is in it. an instruction at
+        //position p reads its operands at p and writes its result at p + 1; copies for the phis of
+        //a block's successors read at the position after its terminator and write at the next
+        std::vector<uint32_t> order;
+        std::vector<uint32_t> blockStart;
+        std::vector<uint32_t> position;
+        std::vector<uint32_t> owner;
+        std::vector<std::vector<LiveRange>> ranges;
+        //values joined so they share a register, with the parameter register a class must use
+        std::vector<uint32_t> parent;
+        std::vector<uint32_t> members;
+        std::vector<uint32_t> precolor;
+        std::vector<uint32_t> reg;
+        //the register calls return to. arguments, fields and elements are passed in the ones after it
+        uint32_t window;
+        uint32_t scratch;
+        bool scratchUsed;
+        std::vector<size_t> blockCode;
+        std::vector<std::pair<size_t, uint32_t>> jumps;
+        //jump table entries that go straight to a block, filled in once the block is placed
+        struct TableJump {
+            uint32_t table;
+            //entry, or -1 for the table's fallback
+            int64_t entry;
+            uint32_t block;
+            size_t from;
+        };
+        std::vector<TableJump> tableJumps;
+
+        Generator(const IrModule& ir, DiagnosticEngine& diagnostics)
+        : ir(ir), module(std::make_shared<Module>()), diagnostics(diagnostics), failed(false), function(nullptr), out(nullptr), line(0), origin(0), window(0), scratch(0), scratchUsed(false) {}
+
+        void unsupported(const char* message)
+        {
+            failed = true;
+            diagnostics.report(DIAG_UNSUPPORTED, SEVERITY_ERROR, nullptr, nullptr, message, {}, (int)line);
+        }
+
+        size_t emit(Opcode op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0)
+        {
+            out->code.push_back(Instruction{op, (uint16_t)a, (uint16_t)b, (uint16_t)c});
+            out->lines.push_back((int)line);
+            if(!function->origins.empty()) out->origins.push_back((uint16_t)origin);
+            return out->code.size() - 1;
+        }
+
+        void jump(Opcode op, uint32_t condition, uint32_t block)
+        {
+            jumps.emplace_back(emit(op, condition), block);
+        }
+
+        uint16_t addConstant(Value v)
+        {
+            if(module->constants.size() >= noRegister)
+            {
+                if(!failed) unsupported("program has more constants than the bytecode can address");
+                return 0;
+            }
+            module->constants.push_back(v);
+            return (uint16_t)(module->constants.size() - 1);
+        }
+
+        uint16_t intConstant(int64_t i)
+        {
+            auto it = ints.find(i);
+            if(it != ints.end()) return it->second;
+            auto k = addConstant(Value::makeInt(i));
+            ints.emplace(i, k);
+            return k;
+        }
+
+        uint16_t constant(uint32_t index)
+        {
+            if(constants[index] != noRegister) return constants[index];
+            auto& k = ir.constants[index];
+            uint16_t result = 0;
+            switch(k.kind)
+            {
+                case CONST_INT: result = intConstant((int64_t)k.bits); break;
+                case CONST_BOOL: result = addConstant(Value::makeBool(k.bits != 0)); break;
+                case CONST_CHAR: result = addConstant(Value::makeChar((uint32_t)k.bits)); break;
+                case CONST_FLOAT:
+                {
+                    float f;
+                    auto bits = (uint32_t)k.bits;
+                    memcpy(&f, &bits, sizeof(f));
+                    result = addConstant(Value::makeFloat(f));
+                    break;
+                }
+                case CONST_DOUBLE:
+                {
+                    double d;
+                    memcpy(&d, &k.bits, sizeof(d));
+                    result = addConstant(Value::makeDouble(d));
+                    break;
+                }
+                case CONST_STRING:
+                {
+                    if(strings[k.bits] == noRegister)
+                    {
+                        module->strings.push_back(std::make_unique<StringObject>(ir.strings[k.bits]));
+                        strings[k.bits] = addConstant(Value::makeObject(module->strings.back().get()));
+                    }
+                    result = strings[k.bits];
+                    break;
+                }
+                case CONST_VOID: result = addConstant(Value::makeVoid()); break;
+            }
+            constants[index] = result;
+            return result;
+        }
+
+        uint32_t blockEnd(uint32_t b)
+        {
+            return position[function->blocks[b].instructions.back()] + 2;
+        }
+
+        uint32_t definedAt(uint32_t v)
+        {
+            auto& in = function->instructions[v];
+            if(in.op == IR_PARAM) return 0;
+            if(in.op == IR_PHI) return blockStart[owner[v]];
+            return position[v] + 1;
+        }
+
+        void number()
+        {
+            order = reversePostorder(*function);
+            blockStart.assign(function->blocks.size(), irNone);
+            position.assign(function->instructions.size(), irNone);
+            owner.assign(function->instructions.size(), irNone);
+            uint32_t k = 0;
+            for(auto b : order)
+            {
+                blockStart[b] = 4 * k;
+                for(auto i : function->blocks[b].instructions)
+                {
+                    position[i] = 4 * k + 2;
+                    owner[i] = b;
+                    k++;
+                }
+            }
+        }
+
+        //walks back from every use to the definition, so a value is live exactly where it has to be
+        void liveness()
+        {
+            auto count = function->instructions.size();
+            std::vector<std::vector<std::pair<uint32_t, uint32_t>>> uses(count);
+            for(auto b : order)
+            {
+                for(auto i : function->blocks[b].instructions)
+                {
+                    auto& in = function->instructions[i];
+                    if(in.op != IR_PHI)
+                    {
+                        forEachOperand(*function, i, [&](uint32_t v) { uses[v].emplace_back(b, position[i]); });
+                        continue;
+                    }
+                    for(uint32_t k = 0; k < in.b; k++)
+                    {
+                        auto from = function->operands[in.a + 2 * k];
+                        if(blockStart[from] != irNone) uses[function->operands[in.a + 2 * k + 1]].emplace_back(from, blockEnd(from) - 1);
+                    }
+                }
+            }
+            ranges.assign(count, {});
+            std::vector<uint32_t> stamp(function->blocks.size(), irNone);
+            std::vector<uint32_t> work;
+            for(uint32_t v = 0; v < count; v++)
+            {
+                if(position[v] == irNone || !definesValue(function->instructions[v].op)) continue;
+                auto d = owner[v];
+                auto def = definedAt(v);
+                auto& r = ranges[v];
+                r.push_back(LiveRange{def, def});
+                //a phi is also written on the edges into its block
+                auto& in = function->instructions[v];
+                if(in.op == IR_PHI)
+                {
+                    for(uint32_t k = 0; k < in.b; k++)
+                    {
+                        auto from = function->operands[in.a + 2 * k];
+                        if(blockStart[from] != irNone) r.push_back(LiveRange{blockEnd(from), blockEnd(from)});
+                    }
+                }
+                for(auto& use : uses[v])
+                {
+                    if(use.first == d)
+                    {
+                        r.push_back(LiveRange{def, use.second});
+                        continue;
+                    }
+                    r.push_back(LiveRange{blockStart[use.first], use.second});
+                    work.push_back(use.first);
+                    while(!work.empty())
+                    {
+                        auto x = work.back();
+                        work.pop_back();
+                        if(stamp[x] == v) continue;
+                        stamp[x] = v;
+                        for(auto p : function->blocks[x].predecessors)
+                        {
+                            if(blockStart[p] == irNone) continue;
+                            r.push_back(LiveRange{p == d ? def : blockStart[p], blockEnd(p)});
+                            if(p != d) work.push_back(p);
+                        }
+                    }
+                }
+                std::sort(r.begin(), r.end(), [](const LiveRange& x, const LiveRange& y) { return x.start < y.start; });
+                size_t kept = 0;
+                for(size_t k = 1; k < r.size(); k++)
+                {
+                    if(r[k].start <= r[kept].end + 1) r[kept].end = std::max(r[kept].end, r[k].end);
+                    else r[++kept] = r[k];
+                }
+                r.resize(kept + 1);
+            }
+        }
+
+        uint32_t find(uint32_t v)
+        {
+            while(parent[v] != v) v = parent[v] = parent[parent[v]];
+            return v;
+        }
+
+        //gives two values one register when they are never live at once, so no copy is needed
+        void join(uint32_t x, uint32_t y)
+        {
+            x = find(x);
+            y = find(y);
+            if(x == y) return;
+            if(precolor[x] != irNone && precolor[y] != irNone) return;
+            if(overlaps(ranges[x], ranges[y])) return;
+            if(precolor[x] == irNone) precolor[x] = precolor[y];
+            mergeInto(ranges[x], ranges[y]);
+            ranges[y].clear();
+            members[x] += members[y];
+            parent[y] = x;
+        }
+
+        void coalesce()
+        {
+            auto count = function->instructions.size();
+            parent.resize(count);
+            members.assign(count, 1);
+            precolor.assign(count, irNone);
+            for(uint32_t v = 0; v < count; v++)
+            {
+                parent[v] = v;
+                if(function->instructions[v].op == IR_PARAM) precolor[v] = function->instructions[v].a;
+            }
+            for(auto b : order)
+            {
+                for(auto i : function->blocks[b].instructions)
+                {
+                    auto& in = function->instructions[i];
+                    if(in.op == IR_PHI)
+                    {
+                        for(uint32_t k = 0; k < in.b; k++) join(i, function->operands[in.a + 2 * k + 1]);
+                    }
+                    //a variant is built in the register of its payload
+                    else if(in.op == IR_VARIANT && in.a != irNone) join(i, in.a);
+                }
+            }
+        }
+
+        static bool isRun(IrOpcode op)
+        {
+            return op == IR_CALL || op == IR_CALLVALUE || op == IR_RECORD || op == IR_ARRAY || op == IR_CLOSURE || op == IR_LOCALCLOSURE;
+        }
+
+        //values that live only from their definition to a call or aggregate right after it are put
+        //straight into the window, so no copy is needed: call results into its first register, and
+        //arguments, fields and elements into their slots. nothing may pass through the window
+        //between their definition and their use
+        std::vector<uint32_t> windowSlots(bool& windowed, uint32_t& runSize)
+        {
+            auto count = function->instructions.size();
+            std::vector<uint32_t> slot(count, irNone);
+            std::vector<uint32_t> runs;
+            //(user, slot) of the values used once as an argument, field or element
+            std::vector<std::pair<uint32_t, uint32_t>> passed(count, std::make_pair(irNone, irNone));
+            std::vector<uint32_t> uses(count, 0);
+            runSize = 0;
+            windowed = false;
+            for(auto b : order)
+            {
+                for(auto i : function->blocks[b].instructions)
+                {
+                    auto& in = function->instructions[i];
+                    forEachOperand(*function, i, [&](uint32_t v) { uses[v]++; });
+                    if(!isRun(in.op)) continue;
+                    runs.push_back(position[i]);
+                    windowed = true;
+                    uint32_t first = in.op == IR_CALLVALUE ? 1 : 0;
+                    runSize = std::max(runSize, in.b - first);
+                    for(uint32_t k = first; k < in.b; k++) passed[function->operands[in.a + k]] = std::make_pair(i, k - first);
+                }
+            }
+            for(uint32_t v = 0; v < count; v++)
+            {
+                if(position[v] == irNone || ranges[v].empty() || find(v) != v || members[v] != 1 || precolor[v] != irNone) continue;
+                auto start = ranges[v].front().start;
+                auto end = ranges[v].back().end;
+                auto next = std::upper_bound(runs.begin(), runs.end(), start);
+                if(next != runs.end() && *next < end) continue;
+                auto op = function->instructions[v].op;
+                if(op == IR_CALL || op == IR_CALLVALUE) slot[v] = 0;
+                else if(op != IR_PHI && uses[v] == 1 && passed[v].first != irNone && position[passed[v].first] == end) slot[v] = passed[v].second + 1;
+            }
+            return slot;
+        }
+
+        //linear scan: classes in the order they start take the lowest register free for all of their ranges
+        bool allocate()
+        {
+            auto count = function->instructions.size();
+            bool windowed;
+            uint32_t runSize;
+            auto slot = windowSlots(windowed, runSize);
+            std::vector<uint32_t> classes;
+            for(uint32_t v = 0; v < count; v++)
+            {
+                if(position[v] != irNone && !ranges[v].empty() && find(v) == v && slot[v] == irNone) classes.push_back(v);
+            }
+            std::stable_sort(classes.begin(), classes.end(), [&](uint32_t x, uint32_t y)
+            {
+                if((precolor[x] != irNone) != (precolor[y] != irNone)) return precolor[x] != irNone;
+                return ranges[x].front().start < ranges[y].front().start;
+            });
+            std::vector<std::vector<LiveRange>> occupied;
+            std::vector<uint32_t> assigned(count, irNone);
+            uint32_t used = (uint32_t)function->params.size();
+            for(auto c : classes)
+            {
+                auto r = precolor[c];
+                if(r == irNone)
+                {
+                    r = 0;
+                    while(r < occupied.size() && overlaps(occupied[r], ranges[c])) r++;
+                }
+                if(r >= occupied.size()) occupied.resize(r + 1);
+                mergeInto(occupied[r], ranges[c]);
+                assigned[c] = r;
+                used = std::max(used, r + 1);
+            }
+            window = used;
+            reg.assign(count, irNone);
+            for(uint32_t v = 0; v < count; v++)
+            {
+                if(position[v] == irNone || !definesValue(function->instructions[v].op)) continue;
+                reg[v] = slot[v] != irNone ? window + slot[v] : assigned[find(v)];
+            }
+            scratch = windowed ? window + 1 + runSize : window;
+            scratchUsed = false;
+            if(scratch + 1 >= noRegister)
+            {
+                unsupported("function needs more registers than the bytecode can address");
+                return false;
+            }
+            return true;
+        }
+
+        //copies for the phis of `to` on the edge from `from`, as (destination, source) pairs
+        std::vector<std::pair<uint32_t, uint32_t>> edgeMoves(uint32_t from, uint32_t to)
+        {
+            std::vector<std::pair<uint32_t, uint32_t>> moves;
+            for(auto i : function->blocks[to].instructions)
+            {
+                auto& in = function->instructions[i];
+                if(in.op != IR_PHI) break;
+                for(uint32_t k = 0; k < in.b; k++)
+                {
+                    if(function->operands[in.a + 2 * k] != from) continue;
+                    auto source = reg[function->operands[in.a + 2 * k + 1]];
+                    if(source != reg[i]) moves.emplace_back(reg[i], source);
+                }
+            }
+            return moves;
+        }
+
+        //the copies happen at once, so a register is only overwritten once nothing still reads it,
+        //and a cycle is broken by saving one register in the scratch one
+        void emitMoves(std::vector<std::pair<uint32_t, uint32_t>> moves)
+        {
+            while(!moves.empty())
+            {
+                bool progress = false;
+                for(size_t m = 0; m < moves.size(); m++)
+                {
+                    auto dst = moves[m].first;
+                    bool read = false;
+                    for(size_t n = 0; n < moves.size() && !read; n++) read = n != m && moves[n].second == dst;
+                    if(read) continue;
+                    emit(OP_MOVE, dst, moves[m].second);
+                    moves.erase(moves.begin() + m);
+                    progress = true;
+                    break;
+                }
+                if(progress) continue;
+                auto saved = moves[0].first;
+                emit(OP_MOVE, scratch, saved);
+                scratchUsed = true;
+                for(auto& m : moves)
+                {
+                    if(m.second == saved) m.second = scratch;
+                }
+            }
+        }
+
+        //copies values that are not already in their window slot there
+        void pass(uint32_t offset, uint32_t count)
+        {
+            for(uint32_t k = 0; k < count; k++)
+            {
+                auto source = reg[function->operands[offset + k]];
+                if(source != window + 1 + k) emit(OP_MOVE, window + 1 + k, source);
+            }
+        }
+
+        void result(uint32_t i)
+        {
+            if(reg[i] != window) emit(OP_MOVE, reg[i], window);
+        }
+
+        void branch(uint32_t block, const IrInstruction& in, uint32_t next)
+        {
+            auto ifTrue = edgeMoves(block, in.b);
+            auto ifFalse = edgeMoves(block, in.c);
+            auto condition = reg[in.a];
+            if(ifTrue.empty() && ifFalse.empty())
+            {
+                if(in.b == next) jump(OP_JMPIFNOT, condition, in.c);
+                else
+                {
+                    jump(OP_JMPIF, condition, in.b);
+                    if(in.c != next) jump(OP_JMP, 0, in.c);
+                }
+                return;
+            }
+            if(ifFalse.empty())
+            {
+                jump(OP_JMPIFNOT, condition, in.c);
+                emitMoves(ifTrue);
+                if(in.b != next) jump(OP_JMP, 0, in.b);
+                return;
+            }
+            if(ifTrue.empty())
+            {
+                jump(OP_JMPIF, condition, in.b);
+                emitMoves(ifFalse);
+                if(in.c != next) jump(OP_JMP, 0, in.c);
+                return;
+            }
+            //both edges need copies, so the true one gets its own stub
+            auto skip = emit(OP_JMPIFNOT, condition);
+            emitMoves(ifTrue);
+            jump(OP_JMP, 0, in.b);
+            setJumpOffset(out->code[skip], (int32_t)(out->code.size() - skip - 1));
+            emitMoves(ifFalse);
+            if(in.c != next) jump(OP_JMP, 0, in.c);
+        }
+
+        //a jump table over the values of the cases. blocks that need copies for their phis are
+        //entered through a stub after the switch that makes them
+        void switchOn(uint32_t block, const IrInstruction& in)
+        {
+            auto& operands = function->operands;
+            int64_t low = 0, high = -1;
+            for(uint32_t k = 0; k < in.c; k++)
+            {
+                auto v = (int64_t)ir.constants[operands[in.b + 1 + 2 * k]].bits;
+                if(k == 0 || v < low) low = v;
+                if(k == 0 || v > high) high = v;
+            }
+            if(in.c != 0 && (uint64_t)high - (uint64_t)low >= maxTableEntries)
+            {
+                unsupported("switch cases are too far apart for a jump table");
+                return;
+            }
+            auto table = (uint32_t)out->tables.size();
+            out->tables.push_back(JumpTable{low, std::vector<int32_t>(in.c != 0 ? (size_t)(high - low) + 1 : 0, 0), 0});
+            auto from = emit(OP_SWITCH, reg[in.a], table);
+            //where each target is entered, or SIZE_MAX for its own block
+            std::unordered_map<uint32_t, size_t> stubs;
+            auto target = [&](int64_t entry, uint32_t to)
+            {
+                auto it = stubs.find(to);
+                if(it == stubs.end())
+                {
+                    auto moves = edgeMoves(block, to);
+                    size_t at = SIZE_MAX;
+                    if(!moves.empty())
+                    {
+                        at = out->code.size();
+                        emitMoves(moves);
+                        jump(OP_JMP, 0, to);
+                    }
+                    it = stubs.emplace(to, at).first;
+                }
+                auto& t = out->tables[table];
+                if(it->second == SIZE_MAX) tableJumps.push_back(TableJump{table, entry, to, from});
+                else if(entry < 0) t.fallback = (int32_t)it->second - (int32_t)from - 1;
+                else t.offsets[entry] = (int32_t)it->second - (int32_t)from - 1;
+            };
+            target(-1, operands[in.b]);
+            std::vector<bool> covered(out->tables[table].offsets.size(), false);
+            for(uint32_t k = 0; k < in.c; k++)
+            {
+                auto entry = (int64_t)((uint64_t)ir.constants[operands[in.b + 1 + 2 * k]].bits - (uint64_t)low);
+                covered[entry] = true;
+                target(entry, operands[in.b + 2 + 2 * k]);
+            }
+            for(size_t entry = 0; entry < covered.size(); entry++)
+            {
+                if(!covered[entry]) target((int64_t)entry, operands[in.b]);
+            }
+        }
+
+        void instruction(uint32_t i, uint32_t block, uint32_t next)
+        {
+            auto& in = function->instructions[i];
+            switch(in.op)
+            {
+                case IR_PARAM:
+                case IR_PHI: return;
+                case IR_CONST:
+                {
+                    if(ir.constants[in.a].kind == CONST_VOID) emit(OP_LOADVOID, reg[i]);
+                    else emit(OP_LOADK, reg[i], constant(in.a));
+                    return;
+                }
+                case IR_UNDEF: emit(OP_LOADVOID, reg[i]); return;
+                case IR_GLOBAL: emit(OP_GETGLOBAL, reg[i], in.a); return;
+                case IR_SETGLOBAL: emit(OP_SETGLOBAL, reg[in.b], in.a); return;
+                case IR_FUNCTION:
+                {
+                    if(ir.functions[in.a].external) unsupported(natives[in.a] >= 0 ? "built-in functions can only be called directly" : "function is declared without a body");
+                    else emit(OP_FUNCTION, reg[i], functions[in.a]);
+                    return;
+                }
+                case IR_NEG:
+                case IR_NOT: emit((Opcode)(OP_NEG + (in.op - IR_NEG)), reg[i], reg[in.a]); return;
+                case IR_CALL:
+                {
+                    if(ir.functions[in.c].external)
+                    {
+                        if(natives[in.c] < 0)
+                        {
+                            unsupported("function is declared without a body");
+                            return;
+                        }
+                        pass(in.a, in.b);
+                        emit(OP_CALLNATIVE, window, (uint32_t)natives[in.c], in.b);
+                    }
+                    else if(isTailCall(*function, block, i))
+                    {
+                        //the callee returns for this function; the return after it is never reached
+                        pass(in.a, in.b);
+                        emit(OP_TAILCALL, window, functions[in.c], in.b);
+                        return;
+                    }
+                    else
+                    {
+                        pass(in.a, in.b);
+                        emit(OP_CALL, window, functions[in.c], in.b);
+                    }
+                    result(i);
+                    return;
+                }
+                case IR_CALLVALUE:
+                {
+                    pass(in.a + 1, in.b - 1);
+                    emit(OP_CALLVALUE, window, reg[function->operands[in.a]], in.b - 1);
+                    result(i);
+                    return;
+                }
+                case IR_RECORD: pass(in.a, in.b); emit(OP_RECORD, reg[i], in.c, window + 1); return;
+                case IR_CLOSURE: pass(in.a, in.b); emit(OP_CLOSURE, reg[i], functions[in.c], window + 1); return;
+                case IR_LOCALCLOSURE:
+                {
+                    //every closure the function makes in its frame has a slot of its own, which
+                    //each run of the instruction reuses
+                    pass(in.a, in.b);
+                    emit(OP_LOCALCLOSURE, reg[i], (uint32_t)out->closures.size(), window + 1);
+                    out->closures.push_back(functions[in.c]);
+                    return;
+                }
+                case IR_ARRAY: pass(in.a, in.b); emit(OP_ARRAY, reg[i], window + 1, in.b); return;
+                case IR_GETFIELD:
+                {
+                    auto& field = ir.fields[in.b];
+                    if(field.index != irNone) emit(OP_GETFIELD, reg[i], reg[in.a], field.index);
+                    else emit(OP_GETFIELDNAMED, reg[i], reg[in.a], intConstant(field.name));
+                    return;
+                }
+                case IR_SETFIELD:
+                {
+                    auto& field = ir.fields[in.b];
+                    if(field.index != irNone) emit(OP_SETFIELD, reg[in.a], field.index, reg[in.c]);
+                    else emit(OP_SETFIELDNAMED, reg[in.a], intConstant(field.name), reg[in.c]);
+                    return;
+                }
+                case IR_GETINDEX: emit(OP_GETINDEX, reg[i], reg[in.a], reg[in.b]); return;
+                case IR_SETINDEX: emit(OP_SETINDEX, reg[in.a], reg[in.b], reg[in.c]); return;
+                case IR_VARIANT:
+                {
+                    if(in.a != irNone && reg[in.a] != reg[i]) emit(OP_MOVE, reg[i], reg[in.a]);
+                    emit(OP_VARIANT, reg[i], in.b, in.c);
+                    return;
+                }
+                case IR_TAG: emit(OP_TAG, reg[i], reg[in.a]); return;
+                case IR_PAYLOAD: emit(OP_PAYLOAD, reg[i], reg[in.a]); return;
+                case IR_JUMP:
+                {
+                    emitMoves(edgeMoves(block, in.a));
+                    if(in.a != next) jump(OP_JMP, 0, in.a);
+                    return;
+                }
+                case IR_BRANCH: branch(block, in, next); return;
+                case IR_SWITCH: switchOn(block, in); return;
+                case IR_RETURN:
+                {
+                    if(in.a != irNone) emit(OP_RETURN, reg[in.a]);
+                    else emit(OP_RETURNVOID);
+                    return;
+                }
+                case IR_UNREACHABLE: emit(OP_RETURNVOID); return;
+                default: emit((Opcode)(OP_ADD + (in.op - IR_ADD)), reg[i], reg[in.a], reg[in.b]); return;
+            }
+        }
+
+        void generateFunction(uint32_t index)
+        {
+            function = &ir.functions[index];
+            out = &module->functions[functions[index]];
+            line = 0;
+            origin = 0;
+            out->inlined = function->inlined;
+            number();
+            liveness();
+            coalesce();
+            if(!allocate()) return;
+            blockCode.assign(function->blocks.size(), 0);
+            jumps.clear();
+            tableJumps.clear();
+            for(size_t n = 0; n < order.size(); n++)
+            {
+                auto b = order[n];
+                auto next = n + 1 < order.size() ? order[n + 1] : irNone;
+                blockCode[b] = out->code.size();
+                for(auto i : function->blocks[b].instructions)
+                {
+                    line = function->lines[i];
+                    if(!function->origins.empty()) origin = function->origins[i];
+                    instruction(i, b, next);
+                }
+            }
+            for(auto& j : jumps) setJumpOffset(out->code[j.first], (int32_t)blockCode[j.second] - (int32_t)j.first - 1);
+            for(auto& j : tableJumps)
+            {
+                auto offset = (int32_t)blockCode[j.block] - (int32_t)j.from - 1;
+                auto& table = out->tables[j.table];
+                if(j.entry < 0) table.fallback = offset;
+                else table.offsets[j.entry] = offset;
+            }
+            out->registers = (uint16_t)(scratchUsed ? scratch + 1 : scratch);
+        }
+
+        std::shared_ptr<Module> generate()
+        {
+            functions.assign(ir.functions.size(), irNone);
+            natives.assign(ir.functions.size(), -1);
+            for(uint32_t i = 0; i < ir.functions.size(); i++)
+            {
+                auto& f = ir.functions[i];
+                if(f.external)
+                {
+                    natives[i] = findNative(f.name, f.params.size());
+                    continue;
+                }
+                functions[i] = (uint32_t)module->functions.size();
+                module->functions.push_back(Function{f.name, (uint16_t)f.params.size(), (uint16_t)f.params.size(), {}, {}, {}, {}, {}, i, (uint16_t)f.captures, {}});
+            }
+            for(auto& layout : ir.layouts)
+            {
+                //tuples print without the positional names the IR gives their fields
+                bool tuple = !layout.isUnion && layout.name.empty();
+                module->layouts.push_back(Layout{layout.name, tuple ? std::vector<Symbol>() : layout.names, layout.empty, layout.isUnion ? 0 : layout.size});
+            }
+            for(auto& global : ir.globals) module->globals.push_back(global.name);
+            constants.assign(ir.constants.size(), noRegister);
+            strings.assign(ir.strings.size(), noRegister);
+            module->init = functions[ir.init];
+            if(ir.main != irNone) module->main = functions[ir.main];
+            for(uint32_t i = 0; i < ir.functions.size(); i++)
+            {
+                if(!ir.functions[i].external) generateFunction(i);
+            }
+            return failed ? nullptr : module;
+        }
+    };
+
+    std::shared_ptr<Module> generateBytecode(const IrModule& ir, DiagnosticEngine& diagnostics)
+    {
+        Generator generator(ir, diagnostics);
+        return generator.generate();
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef codegen_header
+#define codegen_header
+
+#include <memory>
+#include "bytecode.h"
+#include "ir.h"
+
+namespace pilaf {
+    //translates a module in SSA form to bytecode. blocks are laid out in reverse postorder and
+    //values get registers by linear scan over their live ranges, with phis sharing the register of
+    //their operands where the ranges allow; the copies phis stand for are made on the edges.
+    //external functions bind to the interpreter's built-in function of the same name and arity, if
+    //there is one; using one that is not a built-in is reported to `diagnostics` and makes the
+    //result null
+    std::shared_ptr<Module> generateBytecode(const IrModule& ir, DiagnosticEngine& diagnostics);
+}
+#endif
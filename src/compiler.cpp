@@ -1,10 +1,202 @@
+#include <chrono>
+#include <cstdlib>
+#include "cbackend.h"
+#include "codegen.h"
 #include "compiler.h"
+#include "diagnostics.h"
+#include "layout.h"
+#include "lower.h"
+#include "optimize.h"
 #include "semant.h"
+#include "vm.h"
 namespace pilaf {
-    bool compile(std::string src)
+    using Clock = std::chrono::steady_clock;
+
+    static double millisecondsSince(Clock::time_point start)
     {
-        std::shared_ptr<ProgramNode> ast = analyze(src.c_str());
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    //what each phase and optimization pass took, in the order they ran
+    static void printTimeReport(const std::vector<PassTiming>& timings)
+    {
+        double total = 0;
+        for(auto& t : timings) total += t.milliseconds;
+        fprintf(stderr, "time report:\n");
+        for(auto& t : timings) fprintf(stderr, "  %-14s %10.3f ms %5.1f%%\n", t.name, t.milliseconds, total > 0 ? 100 * t.milliseconds / total : 0.0);
+        fprintf(stderr, "  %-14s %10.3f ms\n", "total", total);
+    }
+
+    static std::shared_ptr<ProgramNode> analyzeTimed(const std::string& src, const CompileOptions& options, std::vector<PassTiming>& timings)
+    {
+        auto start = Clock::now();
+        auto ast = analyze(src.c_str(), options);
+        timings.push_back(PassTiming{"analysis", millisecondsSince(start)});
+        return ast;
+    }
+
+    bool compile(std::string src, const CompileOptions& options)
+    {
+        if(options.dumpIr || options.printLayouts || options.timeReport) return compileIr(src, options) != nullptr;
+        std::shared_ptr<ProgramNode> ast = analyze(src.c_str(), options);
         if(ast == nullptr) return false;
         else return true;
     }
-}
\ No newline at end of file
+
+    //lowers and optimizes an analyzed program, treating a module that fails verification as a compiler bug
+    static std::shared_ptr<IrModule> lower(std::shared_ptr<ProgramNode> ast, const std::string& src, DiagnosticEngine& diagnostics, const CompileOptions& options, std::vector<PassTiming>& timings)
+    {
+        auto start = Clock::now();
+        auto module = lowerProgram(ast, src.c_str(), diagnostics);
+        timings.push_back(PassTiming{"lowering", millisecondsSince(start)});
+        if(module == nullptr || diagnostics.errorCount() != 0) return nullptr;
+        optimizeIr(*module, options.optLevel, &timings);
+        start = Clock::now();
+        std::string error;
+        bool valid = verifyIr(*module, error);
+        timings.push_back(PassTiming{"verification", millisecondsSince(start)});
+        if(!valid)
+        {
+            fprintf(stderr, "internal error: invalid IR: %s\n", error.c_str());
+            dumpIr(*module, stderr);
+            return nullptr;
+        }
+        if(options.dumpIr) dumpIr(*module, stdout);
+        if(options.printLayouts) printLayouts(*module, stdout);
+        return module;
+    }
+
+    std::shared_ptr<IrModule> compileIr(std::string src, const CompileOptions& options)
+    {
+        DiagnosticEngine engine(src.c_str());
+        auto withEngine = options;
+        if(withEngine.diagnostics == nullptr) withEngine.diagnostics = &engine;
+        auto diagnostics = withEngine.diagnostics;
+        std::shared_ptr<IrModule> module = nullptr;
+        std::vector<PassTiming> timings;
+        auto ast = analyzeTimed(src, withEngine, timings);
+        if(ast != nullptr && diagnostics->errorCount() == 0)
+        {
+            module = lower(ast, src, *diagnostics, options, timings);
+            if(ast->context != nullptr) ast->context->options.diagnostics = nullptr;
+        }
+        if(options.diagnostics == nullptr) engine.render(stderr, options.diagnosticFormat, options.maxDiagnostics);
+        if(options.timeReport) printTimeReport(timings);
+        return module;
+    }
+
+    std::shared_ptr<Module> compileBytecode(std::string src, const CompileOptions& options)
+    {
+        //code generation reports into the same engine as analysis, so everything is rendered together
+        DiagnosticEngine engine(src.c_str());
+        auto withEngine = options;
+        if(withEngine.diagnostics == nullptr) withEngine.diagnostics = &engine;
+        auto diagnostics = withEngine.diagnostics;
+        std::shared_ptr<Module> module = nullptr;
+        std::vector<PassTiming> timings;
+        auto ast = analyzeTimed(src, withEngine, timings);
+        if(ast != nullptr && diagnostics->errorCount() == 0)
+        {
+            auto ir = lower(ast, src, *diagnostics, options, timings);
+            if(ir != nullptr)
+            {
+                auto start = Clock::now();
+                module = generateBytecode(*ir, *diagnostics);
+                timings.push_back(PassTiming{"codegen", millisecondsSince(start)});
+                if(module != nullptr) module->ir = ir;
+            }
+            if(ast->context != nullptr) ast->context->options.diagnostics = nullptr;
+            //a body parsed for the first time by lowering may still have had syntax errors
+            if(diagnostics->errorCount() != 0) module = nullptr;
+        }
+        if(options.diagnostics == nullptr) engine.render(stderr, options.diagnosticFormat, options.maxDiagnostics);
+        if(options.timeReport) printTimeReport(timings);
+        if(module != nullptr && options.dumpBytecode) disassemble(*module, stdout);
+        return module;
+    }
+
+    int run(std::string src, const CompileOptions& options)
+    {
+        auto module = compileBytecode(src, options);
+        if(module == nullptr) return 65;
+        VM vm(*module);
+        vm.setJitThreshold(options.jitThreshold);
+        Value result;
+        if(!vm.run(result))
+        {
+            fprintf(stderr, "%s\n", vm.error().c_str());
+            return 70;
+        }
+        if(result.type != VAL_VOID) printf("%s\n", valueToString(result, *module).c_str());
+        return 0;
+    }
+
+    //the text of `s` as one argument to the shell
+    static std::string shellQuote(const std::string& s)
+    {
+        std::string out = "'";
+        for(char c : s)
+        {
+            if(c == '\'') out.append("'\\''");
+            else out.push_back(c);
+        }
+        return out + "'";
+    }
+
+    int build(std::string src, const CompileOptions& options, const std::string& output)
+    {
+        DiagnosticEngine engine(src.c_str());
+        auto withEngine = options;
+        if(withEngine.diagnostics == nullptr) withEngine.diagnostics = &engine;
+        auto diagnostics = withEngine.diagnostics;
+        std::vector<PassTiming> timings;
+        std::string program;
+        bool generated = false;
+        auto ast = analyzeTimed(src, withEngine, timings);
+        if(ast != nullptr && diagnostics->errorCount() == 0)
+        {
+            auto ir = lower(ast, src, *diagnostics, options, timings);
+            if(ir != nullptr)
+            {
+                auto start = Clock::now();
+                generated = generateC(*ir, *diagnostics, program);
+                timings.push_back(PassTiming{"c emission", millisecondsSince(start)});
+            }
+            if(ast->context != nullptr) ast->context->options.diagnostics = nullptr;
+            if(diagnostics->errorCount() != 0) generated = false;
+        }
+        if(options.diagnostics == nullptr) engine.render(stderr, options.diagnosticFormat, options.maxDiagnostics);
+        if(!generated)
+        {
+            if(options.timeReport) printTimeReport(timings);
+            return 65;
+        }
+        bool direct = output.size() > 2 && output.compare(output.size() - 2, 2, ".c") == 0;
+        auto path = direct ? output : output + ".c";
+        FILE* file = fopen(path.c_str(), "wb");
+        bool written = file != nullptr && fwrite(program.data(), 1, program.size(), file) == program.size();
+        if(file != nullptr && fclose(file) != 0) written = false;
+        if(!written)
+        {
+            fprintf(stderr, "Could not write \"%s\".\n", path.c_str());
+            return 74;
+        }
+        int status = 0;
+        if(!direct)
+        {
+            //$CC may carry its own arguments, as it does for make
+            auto cc = getenv("CC");
+            auto command = std::string(cc != nullptr && *cc != '\0' ? cc : "cc") + " -std=c11 -O2 -o " + shellQuote(output) + " " + shellQuote(path) + " -lm";
+            auto start = Clock::now();
+            if(system(command.c_str()) != 0)
+            {
+                fprintf(stderr, "C compiler failed: %s\n", command.c_str());
+                status = 70;
+            }
+            timings.push_back(PassTiming{"cc", millisecondsSince(start)});
+            remove(path.c_str());
+        }
+        if(options.timeReport) printTimeReport(timings);
+        return status;
+    }
+}
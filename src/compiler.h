@@ -1,8 +1,25 @@
 #ifndef compiler_header
 #define compiler_header
+#include <memory>
 #include <string>
+#include "bytecode.h"
+#include "ir.h"
+#include "options.h"
 namespace pilaf {
-    bool compile(std::string src);
+    bool compile(std::string src, const CompileOptions& options = CompileOptions());
+    //analyzes `src`, lowers it to SSA form and optimizes it at options.optLevel; null if either
+    //step reported an error or the result does not verify
+    std::shared_ptr<IrModule> compileIr(std::string src, const CompileOptions& options = CompileOptions());
+    //analyzes `src` and generates bytecode from its optimized IR; null if any step reported an error
+    std::shared_ptr<Module> compileBytecode(std::string src, const CompileOptions& options = CompileOptions());
+    //compiles and runs `src`, printing main's result unless it is void. returns 0 on success,
+    //65 when the program does not compile and 70 when it fails at runtime
+    int run(std::string src, const CompileOptions& options = CompileOptions());
+    //compiles `src` ahead of time through C. an `output` ending in .c receives the C program;
+    //anything else is an executable made by the C compiler named by $CC, or cc. returns 0 on
+    //success, 65 when the program does not compile, 70 when the C compiler fails and 74 when
+    //the C program cannot be written
+    int build(std::string src, const CompileOptions& options, const std::string& output);
 }
 
-#endif
\ No newline at end of file
+#endif
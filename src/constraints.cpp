@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <unordered_map>
+#include "constraints.h"
+
+namespace pilaf {
+    //union-find over inference variables: each aliased variable points towards its representative
+    static std::unordered_map<std::string, std::shared_ptr<Ty>> aliases;
+    //aliased variables in the order they were unified
+    static std::vector<std::shared_ptr<Ty>> aliasOrder;
+    static ConstraintStats stats = {0, 0, 0};
+
+    static bool isInferenceVar(const std::shared_ptr<Ty>& t)
+    {
+        if(t->type != Ty::TY_VAR) return false;
+        auto& var = std::static_pointer_cast<TyVar>(t)->var;
+        return !var.empty() && var.front() == '\'';
+    }
+
+    static const std::string& varName(const std::shared_ptr<Ty>& t)
+    {
+        return std::static_pointer_cast<TyVar>(t)->var;
+    }
+
+    static std::shared_ptr<Ty> representative(std::shared_ptr<Ty> var)
+    {
+        auto root = var;
+        for(auto it = aliases.find(varName(root)); it != aliases.end(); it = aliases.find(varName(root)))
+        {
+            root = it->second;
+        }
+        while(var != root)
+        {
+            auto& parent = aliases[varName(var)];
+            var = parent;
+            parent = root;
+        }
+        return root;
+    }
+
+    static bool trivial(const std::shared_ptr<Ty>& a, const std::shared_ptr<Ty>& b)
+    {
+        if(a == b) return true;
+        if(a->type != b->type) return false;
+        if(a->type == Ty::TY_BASIC) return std::static_pointer_cast<TyBasic>(a)->id == std::static_pointer_cast<TyBasic>(b)->id;
+        if(a->type == Ty::TY_VAR) return varName(a) == varName(b);
+        return false;
+    }
+
+    void constrain(std::shared_ptr<ScopeNode> scope, std::shared_ptr<Ty> a, std::shared_ptr<Ty> b)
+    {
+        if(a == nullptr || b == nullptr || trivial(a, b))
+        {
+            stats.trivial++;
+            return;
+        }
+        if(isInferenceVar(a) && isInferenceVar(b))
+        {
+            auto ra = representative(a);
+            auto rb = representative(b);
+            if(ra != rb && varName(ra) != varName(rb))
+            {
+                aliases.emplace(varName(ra), rb);
+                aliasOrder.push_back(ra);
+            }
+            stats.aliased++;
+            return;
+        }
+        scope->constraints.emplace_back(a, b);
+    }
+
+    //`t` with every aliased variable replaced by its representative; unchanged subtrees are shared
+    static std::shared_ptr<Ty> canonical(const std::shared_ptr<Ty>& t)
+    {
+        return mapType(t, [](const std::shared_ptr<Ty>& leaf)
+        {
+            return isInferenceVar(leaf) ? representative(leaf) : leaf;
+        });
+    }
+
+    static void mix(size_t& h, size_t v)
+    {
+        h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    }
+
+    //mixes every node of `t` in prefix order, which together with the child counts determines its shape
+    static size_t hashType(const std::shared_ptr<Ty>& t)
+    {
+        size_t h = 0;
+        std::vector<const std::shared_ptr<Ty>*> pending = {&t};
+        while(!pending.empty())
+        {
+            auto& ty = *pending.back();
+            pending.pop_back();
+            mix(h, (size_t)ty->type);
+            switch(ty->type)
+            {
+                case Ty::TY_BASIC: mix(h, std::static_pointer_cast<TyBasic>(ty)->id); break;
+                case Ty::TY_VAR: mix(h, std::hash<std::string>()(varName(ty))); break;
+                default:
+                {
+                    auto arity = typeArity(*ty);
+                    mix(h, arity);
+                    for(size_t i = arity; i-- > 0;) pending.push_back(&typeChild(*ty, i));
+                    break;
+                }
+            }
+        }
+        return h;
+    }
+
+    std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> prepareConstraints(const std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>>& constraints, std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>>& substitutions)
+    {
+        for(auto& var : aliasOrder)
+        {
+            substitutions.emplace_back(var, representative(var));
+        }
+        std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> result;
+        //a == b and b == a are the same constraint, so the key does not depend on the order of the sides
+        std::unordered_multimap<size_t, size_t> seen;
+        for(auto& c : constraints)
+        {
+            auto a = aliases.empty() ? c.first : canonical(c.first);
+            auto b = aliases.empty() ? c.second : canonical(c.second);
+            if(trivial(a, b))
+            {
+                stats.trivial++;
+                continue;
+            }
+            auto ha = hashType(a);
+            auto hb = hashType(b);
+            auto key = std::min(ha, hb);
+            mix(key, std::max(ha, hb));
+            bool duplicate = false;
+            auto range = seen.equal_range(key);
+            for(auto it = range.first; it != range.second && !duplicate; it++)
+            {
+                auto& other = result[it->second];
+                duplicate = (typesEqual(other.first, a) && typesEqual(other.second, b)) || (typesEqual(other.first, b) && typesEqual(other.second, a));
+            }
+            if(duplicate)
+            {
+                stats.duplicates++;
+                continue;
+            }
+            seen.emplace(key, result.size());
+            result.emplace_back(a, b);
+        }
+        return result;
+    }
+
+    void resetConstraints()
+    {
+        aliases.clear();
+        aliasOrder.clear();
+        stats = {0, 0, 0};
+    }
+
+    const ConstraintStats& constraintStats()
+    {
+        return stats;
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef constraints_header
+#define constraints_header
+
+#include <deque>
+#include "parser.h"
+
+namespace pilaf {
+    struct ConstraintStats {
+        //both sides were already the same type
+        size_t trivial;
+        //two inference variables, unified as soon as they were generated
+        size_t aliased;
+        //identical to a constraint seen before, once aliases were applied
+        size_t duplicates;
+    };
+
+    //records `a == b` in `scope`. pairs that hold trivially are dropped, and a pair of
+    //inference variables is unified on the spot instead of being left to the solver
+    void constrain(std::shared_ptr<ScopeNode> scope, std::shared_ptr<Ty> a, std::shared_ptr<Ty> b);
+
+    //rewrites aliased variables in `constraints` to their representative and removes pairs
+    //that became trivial or repeat an earlier one. every alias is appended to `substitutions`
+    //as `variable => representative`, ahead of anything the solver produces
+    std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> prepareConstraints(const std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>>& constraints, std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>>& substitutions);
+
+    //forgets the aliases and counts of the previous analysis
+    void resetConstraints();
+    const ConstraintStats& constraintStats();
+}
+#endif
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cstring>
+#include "diagnostics.h"
+#include "parser.h"
+
+namespace pilaf {
+    DiagnosticEngine::DiagnosticEngine(const char* source)
+    : source(source), length(0), errors(0) {}
+
+    void DiagnosticEngine::report(DiagnosticCode code, Severity severity, const char* begin, const char* end, const char* message, std::vector<std::shared_ptr<Ty>> args, int line)
+    {
+        if(severity == SEVERITY_ERROR) errors++;
+        diagnostics.push_back(Diagnostic{code, severity, begin, end, line, message, std::move(args)});
+    }
+
+    bool DiagnosticEngine::inSource(const char* p) const
+    {
+        //the end of the source counts, so that errors at the end of input can be located
+        return source != nullptr && p != nullptr && p >= source && p <= source + length;
+    }
+
+    int DiagnosticEngine::lineOf(const Diagnostic& d)
+    {
+        if(!inSource(d.begin)) return d.line;
+        auto offset = (size_t)(d.begin - source);
+        return (int)(std::upper_bound(lineStarts.begin(), lineStarts.end(), offset) - lineStarts.begin());
+    }
+
+    size_t DiagnosticEngine::columnOf(const Diagnostic& d, int line)
+    {
+        if(!inSource(d.begin) || line <= 0) return 0;
+        return (size_t)(d.begin - source) - lineStarts[line - 1] + 1;
+    }
+
+    std::string DiagnosticEngine::format(const Diagnostic& d) const
+    {
+        std::string result;
+        size_t arg = 0;
+        for(const char* c = d.message; *c != '\0'; c++)
+        {
+            if(c[0] == '{' && c[1] == '}' && arg < d.args.size())
+            {
+                typeToString(d.args[arg++], result);
+                c++;
+            }
+            else result.push_back(*c);
+        }
+        return result;
+    }
+
+    static void appendJsonString(std::string& out, const char* begin, const char* end)
+    {
+        out.push_back('"');
+        for(auto c = begin; c != end; c++)
+        {
+            switch(*c)
+            {
+                case '"': out.append("\\\""); break;
+                case '\\': out.append("\\\\"); break;
+                case '\n': out.append("\\n"); break;
+                case '\t': out.append("\\t"); break;
+                case '\r': out.append("\\r"); break;
+                default:
+                {
+                    if((unsigned char)*c < 0x20)
+                    {
+                        char escaped[8];
+                        snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)*c);
+                        out.append(escaped);
+                    }
+                    else out.push_back(*c);
+                }
+            }
+        }
+        out.push_back('"');
+    }
+
+    static bool sameDiagnostic(const Diagnostic& a, const Diagnostic& b)
+    {
+        if(a.code != b.code || a.severity != b.severity || a.begin != b.begin || a.end != b.end || a.line != b.line) return false;
+        if(a.message != b.message && strcmp(a.message, b.message) != 0) return false;
+        if(a.args.size() != b.args.size()) return false;
+        for(size_t i = 0; i < a.args.size(); i++)
+        {
+            if(!typesEqual(a.args[i], b.args[i])) return false;
+        }
+        return true;
+    }
+
+    size_t DiagnosticEngine::render(FILE* out, DiagnosticFormat format, size_t limit)
+    {
+        if(lineStarts.empty())
+        {
+            lineStarts.push_back(0);
+            for(length = 0; source != nullptr && source[length] != '\0'; length++)
+            {
+                if(source[length] == '\n') lineStarts.push_back(length + 1);
+            }
+        }
+        struct Entry {
+            const Diagnostic* diagnostic;
+            int line;
+            size_t column;
+        };
+        std::vector<Entry> entries;
+        entries.reserve(diagnostics.size());
+        for(auto& d : diagnostics)
+        {
+            auto line = lineOf(d);
+            entries.push_back(Entry{&d, line, columnOf(d, line)});
+        }
+        //diagnostics without a location go last
+        std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b)
+        {
+            if((a.line == 0) != (b.line == 0)) return b.line == 0;
+            if(a.line != b.line) return a.line < b.line;
+            if(a.column != b.column) return a.column < b.column;
+            return a.diagnostic->code < b.diagnostic->code;
+        });
+        entries.erase(std::unique(entries.begin(), entries.end(), [](const Entry& a, const Entry& b)
+        {
+            return sameDiagnostic(*a.diagnostic, *b.diagnostic);
+        }), entries.end());
+
+        size_t emitted = std::min(limit, entries.size());
+        std::string text;
+        if(format == DIAGNOSTICS_JSON) text.append("{\"diagnostics\":[");
+        for(size_t i = 0; i < emitted; i++)
+        {
+            auto& d = *entries[i].diagnostic;
+            auto line = entries[i].line;
+            auto message = this->format(d);
+            const char* severity = d.severity == SEVERITY_ERROR ? "error" : "warning";
+            char code[16];
+            snprintf(code, sizeof(code), "E%04d", (int)d.code);
+            bool located = inSource(d.begin);
+            const char* lineStart = located ? source + lineStarts[line - 1] : nullptr;
+            const char* lineEnd = located ? strchr(lineStart, '\n') : nullptr;
+            if(located && lineEnd == nullptr) lineEnd = lineStart + strlen(lineStart);
+            if(format == DIAGNOSTICS_JSON)
+            {
+                if(i != 0) text.push_back(',');
+                text.append("{\"code\":\"").append(code).append("\",\"severity\":\"").append(severity).append("\"");
+                text.append(",\"line\":").append(std::to_string(line));
+                text.append(",\"column\":").append(std::to_string(entries[i].column));
+                text.append(",\"length\":").append(std::to_string(located && d.end > d.begin ? d.end - d.begin : 0));
+                text.append(",\"message\":");
+                appendJsonString(text, message.data(), message.data() + message.size());
+                text.push_back('}');
+                continue;
+            }
+            if(line != 0) text.append("[line ").append(std::to_string(line)).append("] ");
+            text.append(d.severity == SEVERITY_ERROR ? "Error" : "Warning");
+            if(located && *d.begin == '\0') text.append(" at end");
+            else if(d.begin != nullptr && d.end > d.begin && d.end - d.begin <= 40 && std::find(d.begin, d.end, '\n') == d.end)
+            {
+                text.append(" at '").append(d.begin, d.end).append("'");
+            }
+            text.append(": ").append(message).append("\n");
+            if(!located || lineStart == lineEnd) continue;
+            auto number = std::to_string(line);
+            text.append("    ").append(number).append(" | ").append(lineStart, lineEnd).append("\n");
+            text.append("    ").append(number.size(), ' ').append(" | ");
+            for(auto c = lineStart; c < d.begin; c++) text.push_back(*c == '\t' ? '\t' : ' ');
+            auto highlightEnd = std::min(std::max(d.end, d.begin + 1), lineEnd);
+            text.append(std::max<ptrdiff_t>(highlightEnd - d.begin, 1), '^').append("\n");
+        }
+        if(format == DIAGNOSTICS_JSON)
+        {
+            text.append("],\"omitted\":").append(std::to_string(entries.size() - emitted)).append("}\n");
+        }
+        else if(entries.size() > emitted)
+        {
+            text.append("... ").append(std::to_string(entries.size() - emitted)).append(" more diagnostics not shown\n");
+        }
+        fwrite(text.data(), 1, text.size(), out);
+        return emitted;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef diagnostics_header
+#define diagnostics_header
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include "options.h"
+
+namespace pilaf {
+    struct Ty;
+
+    enum DiagnosticCode {
+        DIAG_SYNTAX = 1,
+        DIAG_TYPE_MISMATCH,
+        DIAG_UNKNOWN_NAME,
+        DIAG_UNKNOWN_FIELD,
+        DIAG_INVALID_PATTERN,
+        DIAG_INVALID_INITIALIZER,
+        DIAG_INCONSISTENT_KINDS,
+        DIAG_OVERLAPPING_INSTANCE,
+        DIAG_NESTING_TOO_DEEP,
+        DIAG_UNSUPPORTED,
+        DIAG_NONEXHAUSTIVE_MATCH,
+        DIAG_REDUNDANT_CASE
+    };
+
+    enum Severity {
+        SEVERITY_ERROR,
+        SEVERITY_WARNING
+    };
+
+    //one recorded problem. `message` is a string literal that is only formatted when the
+    //diagnostic is rendered: each "{}" in it is replaced by the next type in `args`
+    struct Diagnostic {
+        DiagnosticCode code;
+        Severity severity;
+        //highlighted source text; null when the problem has no location in the source
+        const char* begin;
+        const char* end;
+        //line of `begin` when the reporter already knows it, 0 otherwise
+        int line;
+        const char* message;
+        std::vector<std::shared_ptr<Ty>> args;
+    };
+
+    //collects the diagnostics of one compilation. recording is cheap; locating, formatting
+    //and printing only happen in render(), and only for the diagnostics that are emitted.
+    class DiagnosticEngine {
+        const char* source;
+        size_t length;
+        std::vector<Diagnostic> diagnostics;
+        //offsets of the first character of every line, built on the first render
+        std::vector<size_t> lineStarts;
+        size_t errors;
+
+        bool inSource(const char* p) const;
+        int lineOf(const Diagnostic& d);
+        size_t columnOf(const Diagnostic& d, int line);
+        std::string format(const Diagnostic& d) const;
+    public:
+        explicit DiagnosticEngine(const char* source = nullptr);
+        void report(DiagnosticCode code, Severity severity, const char* begin, const char* end, const char* message, std::vector<std::shared_ptr<Ty>> args = {}, int line = 0);
+        size_t errorCount() const { return errors; }
+        const std::vector<Diagnostic>& all() const { return diagnostics; }
+        //sorts by position, drops repeats and writes at most `limit` diagnostics to `out`.
+        //returns how many were written
+        size_t render(FILE* out, DiagnosticFormat format, size_t limit);
+    };
+}
+#endif
@@ -0,0 +1,283 @@
+#include "instances.h"
+#include "parser.h"
+
+namespace pilaf {
+    static const TypeKey wildcardKey = {noSymbol, 0};
+
+    static void flatten(std::shared_ptr<Ty> t, std::vector<TypeKey>& out)
+    {
+        //a type still to be written, or with `head` set, the point between an application's
+        //head and its arguments
+        struct Pending {
+            std::shared_ptr<Ty> type;
+            size_t head;
+            uint32_t arguments;
+        };
+        const size_t noHead = SIZE_MAX;
+        std::vector<Pending> pending = {Pending{t, noHead, 0}};
+        while(!pending.empty())
+        {
+            auto next = std::move(pending.back());
+            pending.pop_back();
+            if(next.head != noHead)
+            {
+                if(out[next.head].symbol == noSymbol)
+                {
+                    //application of a type variable: nothing to discriminate on, so its arguments are dropped
+                    out.resize(next.head);
+                    out.push_back(wildcardKey);
+                    pending.resize(pending.size() - next.arguments);
+                }
+                else out[next.head].arity += next.arguments;
+                continue;
+            }
+            auto& t = next.type;
+            if(t == nullptr)
+            {
+                out.push_back(wildcardKey);
+                continue;
+            }
+            switch(t->type)
+            {
+                case Ty::TY_FUNCTION:
+                {
+                    static const Symbol arrow = intern("->");
+                    auto f = std::static_pointer_cast<TyFunc>(t);
+                    out.push_back(TypeKey{arrow, 2});
+                    pending.push_back(Pending{f->out, noHead, 0});
+                    pending.push_back(Pending{f->in, noHead, 0});
+                    break;
+                }
+                case Ty::TY_APPLICATION:
+                {
+                    auto app = std::static_pointer_cast<TyAppl>(t);
+                    for(auto it = app->vars.rbegin(); it != app->vars.rend(); it++) pending.push_back(Pending{*it, noHead, 0});
+                    pending.push_back(Pending{nullptr, out.size(), (uint32_t)app->vars.size()});
+                    pending.push_back(Pending{app->applied, noHead, 0});
+                    break;
+                }
+                case Ty::TY_TUPLE:
+                {
+                    static const Symbol tuple = intern("(,)");
+                    auto tup = std::static_pointer_cast<TyTuple>(t);
+                    out.push_back(TypeKey{tuple, (uint32_t)tup->types.size()});
+                    for(auto it = tup->types.rbegin(); it != tup->types.rend(); it++) pending.push_back(Pending{*it, noHead, 0});
+                    break;
+                }
+                case Ty::TY_ARRAY:
+                {
+                    static const Symbol array = intern("[]");
+                    out.push_back(TypeKey{array, 1});
+                    pending.push_back(Pending{std::static_pointer_cast<TyArray>(t)->arrayOf, noHead, 0});
+                    break;
+                }
+                case Ty::TY_POINTER:
+                {
+                    static const Symbol pointer = intern("*");
+                    out.push_back(TypeKey{pointer, 1});
+                    pending.push_back(Pending{std::static_pointer_cast<TyPointer>(t)->pointsTo, noHead, 0});
+                    break;
+                }
+                case Ty::TY_REFERENCE:
+                {
+                    static const Symbol reference = intern("&");
+                    out.push_back(TypeKey{reference, 1});
+                    pending.push_back(Pending{std::static_pointer_cast<TyRef>(t)->refTo, noHead, 0});
+                    break;
+                }
+                case Ty::TY_BASIC:
+                {
+                    out.push_back(TypeKey{std::static_pointer_cast<TyBasic>(t)->id, 0});
+                    break;
+                }
+                default:
+                {
+                    out.push_back(wildcardKey);
+                    break;
+                }
+            }
+        }
+    }
+
+    std::vector<TypeKey> flattenType(std::shared_ptr<Ty> t)
+    {
+        std::vector<TypeKey> result;
+        if(t != nullptr) flatten(t, result);
+        return result;
+    }
+
+    //index one past the subterm starting at `position`
+    static size_t skipSubterm(const std::vector<TypeKey>& keys, size_t position)
+    {
+        size_t remaining = 1;
+        while(remaining > 0 && position < keys.size())
+        {
+            remaining += keys[position].arity;
+            remaining--;
+            position++;
+        }
+        return position;
+    }
+
+    //whether every type matched by `specific` is matched by `general`
+    static bool generalizes(const std::vector<TypeKey>& general, const std::vector<TypeKey>& specific)
+    {
+        size_t i = 0, j = 0;
+        while(i < general.size() && j < specific.size())
+        {
+            if(general[i].symbol == noSymbol) j = skipSubterm(specific, j);
+            else if(general[i] == specific[j]) j++;
+            else return false;
+            i++;
+        }
+        return i == general.size() && j == specific.size();
+    }
+
+    static bool unifiable(const std::vector<TypeKey>& a, const std::vector<TypeKey>& b)
+    {
+        size_t i = 0, j = 0;
+        while(i < a.size() && j < b.size())
+        {
+            if(a[i].symbol == noSymbol)
+            {
+                j = skipSubterm(b, j);
+                i++;
+            }
+            else if(b[j].symbol == noSymbol)
+            {
+                i = skipSubterm(a, i);
+                j++;
+            }
+            else if(a[i] == b[j])
+            {
+                i++;
+                j++;
+            }
+            else return false;
+        }
+        return i == a.size() && j == b.size();
+    }
+
+    static uint64_t headKey(Symbol className, Symbol head)
+    {
+        return ((uint64_t)className << 32) | head;
+    }
+
+    static uint64_t childKey(TypeKey key)
+    {
+        return ((uint64_t)key.symbol << 32) | key.arity;
+    }
+
+    std::shared_ptr<FunctionDeclarationNode> Instance::method(Symbol name) const
+    {
+        auto it = methods.find(name);
+        return it == methods.end() ? nullptr : it->second;
+    }
+
+    std::shared_ptr<Instance> makeInstance(std::shared_ptr<ClassImplementationNode> impl)
+    {
+        auto instance = std::make_shared<Instance>();
+        instance->className = intern(std::string_view(impl->_class.start, impl->_class.length));
+        instance->implemented = impl->implemented;
+        instance->pattern = flattenType(impl->implemented);
+        instance->declaration = impl;
+        for(auto f : impl->functions)
+        {
+            auto fd = std::static_pointer_cast<FunctionDeclarationNode>(f);
+            instance->methods.emplace(intern(std::string_view(fd->identifier.start, fd->identifier.length)), fd);
+        }
+        return instance;
+    }
+
+    void InstanceTable::declareMethod(Symbol method, Symbol className)
+    {
+        methodClasses[method] = className;
+    }
+
+    Symbol InstanceTable::classOfMethod(Symbol method) const
+    {
+        auto it = methodClasses.find(method);
+        return it == methodClasses.end() ? noSymbol : it->second;
+    }
+
+    std::shared_ptr<Instance> InstanceTable::add(std::shared_ptr<Instance> instance)
+    {
+        if(instance->pattern.empty()) return nullptr;
+        auto& existing = byClass[instance->className];
+        for(auto e : existing)
+        {
+            //a more specific instance may refine a general one, but two instances that
+            //both apply to some type with neither more specific than the other conflict
+            if(e->pattern == instance->pattern) return e;
+            if(unifiable(e->pattern, instance->pattern)
+                && !generalizes(e->pattern, instance->pattern)
+                && !generalizes(instance->pattern, e->pattern)) return e;
+        }
+        existing.push_back(instance);
+
+        auto& root = heads[headKey(instance->className, instance->pattern[0].symbol)];
+        if(root == nullptr) root.reset(new TreeNode());
+        TreeNode* node = root.get();
+        for(auto key : instance->pattern)
+        {
+            auto& next = key.symbol == noSymbol ? node->wildcard : node->children[childKey(key)];
+            if(next == nullptr) next.reset(new TreeNode());
+            node = next.get();
+        }
+        node->instances.push_back(instance);
+        return nullptr;
+    }
+
+    void InstanceTable::match(const TreeNode* node, const std::vector<TypeKey>& query, size_t position, std::vector<std::shared_ptr<Instance>>& out) const
+    {
+        if(position == query.size())
+        {
+            out.insert(out.end(), node->instances.begin(), node->instances.end());
+            return;
+        }
+        //exact constructors before wildcards, so more specific instances come first
+        if(query[position].symbol != noSymbol)
+        {
+            auto child = node->children.find(childKey(query[position]));
+            if(child != node->children.end()) match(child->second.get(), query, position + 1, out);
+        }
+        if(node->wildcard != nullptr) match(node->wildcard.get(), query, skipSubterm(query, position), out);
+    }
+
+    std::vector<std::shared_ptr<Instance>> InstanceTable::lookup(Symbol className, std::shared_ptr<Ty> type) const
+    {
+        std::vector<std::shared_ptr<Instance>> result;
+        auto query = flattenType(type);
+        if(query.empty()) return result;
+        if(query[0].symbol != noSymbol)
+        {
+            auto head = heads.find(headKey(className, query[0].symbol));
+            if(head != heads.end()) match(head->second.get(), query, 0, result);
+        }
+        auto any = heads.find(headKey(className, noSymbol));
+        if(any != heads.end()) match(any->second.get(), query, 0, result);
+        return result;
+    }
+
+    std::shared_ptr<Instance> findInstance(std::shared_ptr<ScopeNode> scope, Symbol className, std::shared_ptr<Ty> type)
+    {
+        for(auto s = scope; s != nullptr; s = s->parentScope)
+        {
+            auto found = s->instances.lookup(className, type);
+            if(!found.empty()) return found.front();
+        }
+        return nullptr;
+    }
+
+    std::shared_ptr<FunctionDeclarationNode> resolveMethod(std::shared_ptr<ScopeNode> scope, Symbol method, std::shared_ptr<Ty> type)
+    {
+        Symbol className = noSymbol;
+        for(auto s = scope; s != nullptr && className == noSymbol; s = s->parentScope)
+        {
+            className = s->instances.classOfMethod(method);
+        }
+        if(className == noSymbol) return nullptr;
+        auto instance = findInstance(scope, className, type);
+        return instance == nullptr ? nullptr : instance->method(method);
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef instances_header
+#define instances_header
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "symbols.h"
+
+namespace pilaf {
+    struct Ty;
+    struct ScopeNode;
+    struct FunctionDeclarationNode;
+    struct ClassImplementationNode;
+
+    //one node of a type flattened in preorder: a constructor and its argument count,
+    //or a wildcard (symbol == noSymbol) standing for a whole subterm.
+    struct TypeKey {
+        Symbol symbol;
+        uint32_t arity;
+        bool operator==(const TypeKey& other) const { return symbol == other.symbol && arity == other.arity; }
+        bool operator<(const TypeKey& other) const { return symbol != other.symbol ? symbol < other.symbol : arity < other.arity; }
+    };
+
+    std::vector<TypeKey> flattenType(std::shared_ptr<Ty> t);
+
+    struct Instance {
+        Symbol className;
+        std::shared_ptr<Ty> implemented;
+        std::vector<TypeKey> pattern;
+        std::shared_ptr<ClassImplementationNode> declaration;
+        std::unordered_map<Symbol, std::shared_ptr<FunctionDeclarationNode>> methods;
+
+        std::shared_ptr<FunctionDeclarationNode> method(Symbol name) const;
+    };
+
+    std::shared_ptr<Instance> makeInstance(std::shared_ptr<ClassImplementationNode> impl);
+
+    //instances indexed by (class, head type constructor). instances sharing a head sit in a
+    //discrimination tree over the rest of the flattened instance type, so the most specific
+    //match is found without comparing type names.
+    class InstanceTable {
+        struct TreeNode {
+            std::unordered_map<uint64_t, std::unique_ptr<TreeNode>> children;
+            std::unique_ptr<TreeNode> wildcard;
+            std::vector<std::shared_ptr<Instance>> instances;
+        };
+        std::unordered_map<uint64_t, std::unique_ptr<TreeNode>> heads;
+        std::unordered_map<Symbol, std::vector<std::shared_ptr<Instance>>> byClass;
+        std::unordered_map<Symbol, Symbol> methodClasses;
+
+        void match(const TreeNode* node, const std::vector<TypeKey>& query, size_t position, std::vector<std::shared_ptr<Instance>>& out) const;
+    public:
+        void declareMethod(Symbol method, Symbol className);
+        Symbol classOfMethod(Symbol method) const;
+
+        //registers `instance`; on overlap with an existing instance, returns that instance instead
+        std::shared_ptr<Instance> add(std::shared_ptr<Instance> instance);
+
+        //matching instances of `className` for `type`, most specific first
+        std::vector<std::shared_ptr<Instance>> lookup(Symbol className, std::shared_ptr<Ty> type) const;
+    };
+
+    //searches `scope` and its parents for the most specific instance of `className` for `type`
+    std::shared_ptr<Instance> findInstance(std::shared_ptr<ScopeNode> scope, Symbol className, std::shared_ptr<Ty> type);
+
+    //the implementation of class method `method` used when the class is instantiated at `type`
+    std::shared_ptr<FunctionDeclarationNode> resolveMethod(std::shared_ptr<ScopeNode> scope, Symbol method, std::shared_ptr<Ty> type);
+}
+#endif
@@ -0,0 +1,733 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "interface.h"
+#include "semant.h"
+#include "kinds.h"
+
+namespace pilaf {
+    static const char interfaceMagic[4] = {'P', 'F', 'I', 3};
+
+    enum InterfaceDeclaration : uint8_t {
+        DECL_FUNCTION,
+        DECL_STRUCT,
+        DECL_UNION,
+        DECL_TYPEDEF,
+        DECL_CLASS,
+        DECL_IMPL,
+        DECL_VARIABLE,
+        DECL_MODULE
+    };
+
+    static const uint8_t noType = 0xFF;
+
+    uint64_t hashModuleSource(Token name, const char* start, const char* end, const ScopeNode* enclosing)
+    {
+        //FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](const char* s, const char* e)
+        {
+            for(; s != e; s++)
+            {
+                hash ^= (uint8_t)*s;
+                hash *= 1099511628211ull;
+            }
+        };
+        auto mixByte = [&mix](uint8_t b) { mix((const char*)&b, (const char*)&b + 1); };
+        mix(interfaceMagic, interfaceMagic + sizeof(interfaceMagic));
+        mix(name.start, name.start + name.length);
+        mix(start, end);
+        //the operators declared around the module decide how its expressions parse
+        std::vector<const std::pair<const std::string, ParseRule>*> operators;
+        for(auto s = enclosing; s != nullptr; s = s->parentScope.get())
+        {
+            operators.clear();
+            for(auto& rule : s->opRules) operators.push_back(&rule);
+            std::sort(operators.begin(), operators.end(), [](auto a, auto b) { return a->first < b->first; });
+            for(auto rule : operators)
+            {
+                mix(rule->first.data(), rule->first.data() + rule->first.size() + 1);
+                mixByte(rule->second.precedence);
+                mixByte((rule->second.prefix != nullptr) | (rule->second.infix != nullptr) << 1 | rule->second.isPostfix << 2);
+            }
+            mixByte(0xFF);
+        }
+        return hash;
+    }
+
+    static bool declares(const ScopeNode& s, const std::string& name)
+    {
+        return s.variables.count(name) || s.structs.count(name) || s.unions.count(name) || s.tyCons.count(name)
+            || s.typeAliases.count(name) || s.functions.count(name) || s.classes.count(name) || s.namespaces.count(name);
+    }
+
+    //true if a name used in the module is declared outside it. the key only covers the module's own text,
+    //so an interface that depends on its surroundings could go stale without the key changing
+    static bool referencesEnclosingScope(const ModuleDeclarationNode& module)
+    {
+        if(module.block == nullptr || module.block->start == nullptr || module.scope == nullptr) return true;
+        std::vector<const ScopeNode*> inner;
+        std::vector<const ScopeNode*> pending = {module.scope.get()};
+        while(!pending.empty())
+        {
+            auto s = pending.back();
+            pending.pop_back();
+            inner.push_back(s);
+            for(auto& child : s->childScopes)
+            {
+                if(auto c = child.lock()) pending.push_back(c.get());
+            }
+        }
+        auto lexer = initLexer(module.block->start);
+        std::string name;
+        for(auto t = scanToken(&lexer); t.type != TokenTypes::_EOF && t.start < module.block->end; t = scanToken(&lexer))
+        {
+            if(t.type != TokenTypes::IDENTIFIER && t.type != TokenTypes::TYPE && t.type != TokenTypes::OPERATOR) continue;
+            name.assign(t.start, t.length);
+            bool outer = false;
+            for(auto s = module.scope->parentScope.get(); s != nullptr && !outer; s = s->parentScope.get()) outer = declares(*s, name);
+            if(!outer) continue;
+            bool shadowed = false;
+            for(auto s : inner)
+            {
+                if((shadowed = declares(*s, name))) break;
+            }
+            if(!shadowed) return true;
+        }
+        return false;
+    }
+
+    std::string interfacePath(const std::string& directory, Token name)
+    {
+        auto path = directory;
+        if(!path.empty() && path.back() != '/' && path.back() != '\\') path.push_back('/');
+        path.append(name.start, name.length).append(".pfi");
+        return path;
+    }
+
+    struct InterfaceWriter {
+        std::string out;
+        std::string strings;
+        std::unordered_map<std::string, size_t> stringOffsets;
+        const std::unordered_map<std::string, std::shared_ptr<Ty>>* substitutions;
+        //names given to inference variables left unsolved in the current declaration
+        std::unordered_map<std::string, std::string> quantified;
+
+        void varint(uint64_t v)
+        {
+            while(v >= 0x80)
+            {
+                out.push_back((char)((v & 0x7F) | 0x80));
+                v >>= 7;
+            }
+            out.push_back((char)v);
+        }
+
+        void name(const std::string& s)
+        {
+            auto it = stringOffsets.find(s);
+            size_t offset;
+            if(it == stringOffsets.end())
+            {
+                offset = strings.size();
+                strings.append(s);
+                stringOffsets.emplace(s, offset);
+            }
+            else offset = it->second;
+            varint(offset);
+            varint(s.size());
+        }
+
+        void name(Token t) { name(tokenToString(t)); }
+
+        void kind(const Kind* k)
+        {
+            if(k == nullptr)
+            {
+                out.push_back((char)noType);
+                return;
+            }
+            out.push_back((char)k->type);
+            if(k->type == Kind::KIND_ARROW)
+            {
+                kind(k->from);
+                kind(k->to);
+            }
+        }
+
+        void type(std::shared_ptr<Ty> t)
+        {
+            //the result of a function type is written in a loop, so long `->` chains do not recurse
+            while(t != nullptr && t->type == Ty::TY_FUNCTION)
+            {
+                auto fn = std::static_pointer_cast<TyFunc>(t);
+                out.push_back((char)t->type);
+                type(fn->in);
+                t = fn->out;
+            }
+            if(t == nullptr)
+            {
+                out.push_back((char)noType);
+                return;
+            }
+            out.push_back((char)t->type);
+            switch(t->type)
+            {
+                case Ty::TY_APPLICATION:
+                {
+                    auto app = std::static_pointer_cast<TyAppl>(t);
+                    type(app->applied);
+                    varint(app->vars.size());
+                    for(auto v : app->vars) type(v);
+                    break;
+                }
+                case Ty::TY_VAR:
+                {
+                    auto var = std::static_pointer_cast<TyVar>(t);
+                    if(var->var.front() == '\'')
+                    {
+                        auto it = quantified.find(var->var);
+                        if(it == quantified.end())
+                        {
+                            it = quantified.emplace(var->var, std::string("_").append(std::to_string(quantified.size()))).first;
+                        }
+                        name(it->second);
+                    }
+                    else name(var->var);
+                    break;
+                }
+                case Ty::TY_BASIC:
+                {
+                    name(std::static_pointer_cast<TyBasic>(t)->t);
+                    break;
+                }
+                case Ty::TY_TUPLE:
+                {
+                    auto tuple = std::static_pointer_cast<TyTuple>(t);
+                    varint(tuple->types.size());
+                    for(auto ty : tuple->types) type(ty);
+                    break;
+                }
+                case Ty::TY_ARRAY:
+                {
+                    auto arr = std::static_pointer_cast<TyArray>(t);
+                    type(arr->arrayOf);
+                    out.push_back(arr->size.has_value() ? 1 : 0);
+                    if(arr->size.has_value()) varint(arr->size.value());
+                    break;
+                }
+                case Ty::TY_POINTER:
+                {
+                    type(std::static_pointer_cast<TyPointer>(t)->pointsTo);
+                    break;
+                }
+                case Ty::TY_REFERENCE:
+                {
+                    type(std::static_pointer_cast<TyRef>(t)->refTo);
+                    break;
+                }
+                default: break;
+            }
+        }
+
+        void solvedType(std::shared_ptr<Ty> t)
+        {
+            type(t == nullptr ? nullptr : applySubstitutions(t, *substitutions));
+        }
+
+        void function(std::shared_ptr<FunctionDeclarationNode> fd)
+        {
+            quantified.clear();
+            name(fd->identifier);
+            varint(fd->params.size());
+            for(auto& p : fd->params)
+            {
+                name(p.identifier);
+                solvedType(p.type);
+            }
+            solvedType(fd->returnType);
+        }
+
+        void declaration(std::shared_ptr<node> n)
+        {
+            if(n == nullptr) return;
+            quantified.clear();
+            switch(n->nodeType)
+            {
+                case NODE_FUNCTIONDECL:
+                {
+                    out.push_back(DECL_FUNCTION);
+                    function(std::static_pointer_cast<FunctionDeclarationNode>(n));
+                    break;
+                }
+                case NODE_STRUCTDECL:
+                {
+                    auto sd = std::static_pointer_cast<StructDeclarationNode>(n);
+                    out.push_back(DECL_STRUCT);
+                    type(sd->typeDefined);
+                    kind(sd->kind);
+                    out.push_back(sd->reprC ? 1 : 0);
+                    varint(sd->fields.size());
+                    for(auto& f : sd->fields)
+                    {
+                        name(f.identifier);
+                        type(f.type);
+                    }
+                    break;
+                }
+                case NODE_UNIONDECL:
+                {
+                    auto ud = std::static_pointer_cast<UnionDeclarationNode>(n);
+                    out.push_back(DECL_UNION);
+                    type(ud->typeDefined);
+                    kind(ud->kind);
+                    out.push_back(ud->reprC ? 1 : 0);
+                    varint(ud->members.size());
+                    for(auto& m : ud->members)
+                    {
+                        name(m.identifier);
+                        type(m.type);
+                    }
+                    break;
+                }
+                case NODE_TYPEDEF:
+                {
+                    auto td = std::static_pointer_cast<TypedefNode>(n);
+                    out.push_back(DECL_TYPEDEF);
+                    type(td->typeDefined);
+                    type(td->typeAliased);
+                    break;
+                }
+                case NODE_CLASSDECL:
+                {
+                    auto cd = std::static_pointer_cast<ClassDeclarationNode>(n);
+                    out.push_back(DECL_CLASS);
+                    name(cd->className);
+                    name(cd->typeName);
+                    kind(cd->kind);
+                    varint(cd->constraints.size());
+                    for(auto c : cd->constraints) type(c);
+                    varint(cd->functions.size());
+                    for(auto f : cd->functions) function(std::static_pointer_cast<FunctionDeclarationNode>(f));
+                    break;
+                }
+                case NODE_CLASSIMPL:
+                {
+                    auto ci = std::static_pointer_cast<ClassImplementationNode>(n);
+                    out.push_back(DECL_IMPL);
+                    name(ci->_class);
+                    type(ci->implemented);
+                    varint(ci->functions.size());
+                    for(auto f : ci->functions) function(std::static_pointer_cast<FunctionDeclarationNode>(f));
+                    break;
+                }
+                case NODE_VARIABLEDECL:
+                {
+                    auto vd = std::static_pointer_cast<VariableDeclarationNode>(n);
+                    out.push_back(DECL_VARIABLE);
+                    solvedType(vd->type);
+                    varint(vd->identifiers.size());
+                    for(auto& id : vd->identifiers)
+                    {
+                        name(id.first);
+                        solvedType(id.second);
+                    }
+                    break;
+                }
+                case NODE_MODULE:
+                {
+                    auto md = std::static_pointer_cast<ModuleDeclarationNode>(n);
+                    out.push_back(DECL_MODULE);
+                    name(md->name);
+                    module(md);
+                    break;
+                }
+                default: break;
+            }
+        }
+
+        void module(std::shared_ptr<ModuleDeclarationNode> md)
+        {
+            std::vector<std::shared_ptr<node>> exported;
+            auto block = std::static_pointer_cast<BlockStatementNode>(md->block);
+            for(auto dec : block->declarations)
+            {
+                switch(dec->nodeType)
+                {
+                    case NODE_FUNCTIONDECL:
+                    case NODE_STRUCTDECL:
+                    case NODE_UNIONDECL:
+                    case NODE_TYPEDEF:
+                    case NODE_CLASSDECL:
+                    case NODE_CLASSIMPL:
+                    case NODE_VARIABLEDECL:
+                    case NODE_MODULE:
+                        exported.push_back(dec);
+                        break;
+                    default: break;
+                }
+            }
+            varint(exported.size());
+            for(auto dec : exported) declaration(dec);
+        }
+    };
+
+    bool writeModuleInterface(const std::string& path, std::shared_ptr<ModuleDeclarationNode> module, const std::unordered_map<std::string, std::shared_ptr<Ty>>& substitutions)
+    {
+        if(referencesEnclosingScope(*module))
+        {
+            //drop any interface an earlier build left behind
+            remove(path.c_str());
+            return false;
+        }
+        InterfaceWriter w;
+        w.substitutions = &substitutions;
+        w.module(module);
+
+        FILE* file = fopen(path.c_str(), "wb");
+        if(file == nullptr) return false;
+        uint8_t hash[8];
+        for(int i = 0; i < 8; i++) hash[i] = (uint8_t)(module->contentHash >> (8 * i));
+        std::string header;
+        {
+            InterfaceWriter h;
+            h.varint(w.strings.size());
+            header = h.out;
+        }
+        bool ok = fwrite(interfaceMagic, 1, sizeof(interfaceMagic), file) == sizeof(interfaceMagic)
+            && fwrite(hash, 1, sizeof(hash), file) == sizeof(hash)
+            && fwrite(header.data(), 1, header.size(), file) == header.size()
+            && fwrite(w.strings.data(), 1, w.strings.size(), file) == w.strings.size()
+            && fwrite(w.out.data(), 1, w.out.size(), file) == w.out.size();
+        fclose(file);
+        return ok;
+    }
+
+    struct InterfaceReader {
+        const uint8_t* current;
+        const uint8_t* end;
+        const char* strings;
+        size_t stringsLength;
+        bool failed = false;
+
+        uint8_t byte()
+        {
+            if(current == end)
+            {
+                failed = true;
+                return 0;
+            }
+            return *current++;
+        }
+
+        uint64_t varint()
+        {
+            uint64_t result = 0;
+            int shift = 0;
+            while(!failed && shift < 64)
+            {
+                auto b = byte();
+                result |= (uint64_t)(b & 0x7F) << shift;
+                if((b & 0x80) == 0) break;
+                shift += 7;
+            }
+            return result;
+        }
+
+        Token name(TokenTypes tokenType = TokenTypes::IDENTIFIER)
+        {
+            auto offset = varint();
+            auto length = varint();
+            if(offset + length > stringsLength)
+            {
+                failed = true;
+                return Token{tokenType, strings, 0, 0};
+            }
+            return Token{tokenType, strings + offset, (int)length, 0};
+        }
+
+        const Kind* kind()
+        {
+            auto tag = byte();
+            if(failed || tag == noType) return nullptr;
+            switch(tag)
+            {
+                case Kind::KIND_STAR: return starKind();
+                case Kind::KIND_ARROW:
+                {
+                    auto from = kind();
+                    auto to = kind();
+                    if(failed || from == nullptr || to == nullptr)
+                    {
+                        failed = true;
+                        return nullptr;
+                    }
+                    return arrowKind(from, to);
+                }
+                default:
+                {
+                    failed = true;
+                    return nullptr;
+                }
+            }
+        }
+
+        std::shared_ptr<Ty> type()
+        {
+            std::vector<std::shared_ptr<Ty>> params;
+            auto tag = byte();
+            while(!failed && tag == Ty::TY_FUNCTION)
+            {
+                params.push_back(type());
+                tag = byte();
+            }
+            auto result = typeAfter(tag);
+            for(auto it = params.rbegin(); it != params.rend(); it++)
+            {
+                result = std::make_shared<TyFunc>(*it, result);
+            }
+            return result;
+        }
+
+        //the rest of a type that is not a function type, once its tag has been read
+        std::shared_ptr<Ty> typeAfter(uint8_t tag)
+        {
+            if(failed || tag == noType) return nullptr;
+            switch(tag)
+            {
+                case Ty::TY_APPLICATION:
+                {
+                    auto applied = type();
+                    std::vector<std::shared_ptr<Ty>> vars;
+                    auto count = varint();
+                    for(uint64_t i = 0; i < count && !failed; i++) vars.push_back(type());
+                    return std::make_shared<TyAppl>(applied, vars);
+                }
+                case Ty::TY_VAR: return std::make_shared<TyVar>(tokenToString(name()));
+                case Ty::TY_BASIC: return std::make_shared<TyBasic>(tokenToString(name()));
+                case Ty::TY_TUPLE:
+                {
+                    std::vector<std::shared_ptr<Ty>> types;
+                    auto count = varint();
+                    for(uint64_t i = 0; i < count && !failed; i++) types.push_back(type());
+                    return std::make_shared<TyTuple>(types);
+                }
+                case Ty::TY_ARRAY:
+                {
+                    auto arrayOf = type();
+                    std::optional<size_t> size = {};
+                    if(byte() != 0) size = varint();
+                    return std::make_shared<TyArray>(arrayOf, size);
+                }
+                case Ty::TY_POINTER: return std::make_shared<TyPointer>(type());
+                case Ty::TY_REFERENCE: return std::make_shared<TyRef>(type());
+                default:
+                {
+                    failed = true;
+                    return nullptr;
+                }
+            }
+        }
+
+        std::shared_ptr<FunctionDeclarationNode> function()
+        {
+            auto identifier = name();
+            std::vector<Parameter> params;
+            auto count = varint();
+            for(uint64_t i = 0; i < count && !failed; i++)
+            {
+                Parameter p;
+                p.identifier = name();
+                p.type = type();
+                params.push_back(p);
+            }
+            auto returnType = type();
+            return std::make_shared<FunctionDeclarationNode>(returnType, identifier, params, nullptr);
+        }
+
+        //decodes one declaration and registers it in `scope` the same way the parser would
+        std::shared_ptr<node> declaration(std::shared_ptr<ScopeNode> scope)
+        {
+            switch(byte())
+            {
+                case DECL_FUNCTION:
+                {
+                    auto fd = function();
+                    scope->functions.insert(std::make_pair(tokenToString(fd->identifier), fd));
+                    return fd;
+                }
+                case DECL_STRUCT:
+                {
+                    auto typeDefined = type();
+                    auto k = kind();
+                    bool reprC = byte() != 0;
+                    std::vector<Parameter> fields;
+                    auto count = varint();
+                    for(uint64_t i = 0; i < count && !failed; i++)
+                    {
+                        auto identifier = name();
+                        fields.push_back(Parameter{type(), identifier});
+                    }
+                    if(failed || typeDefined == nullptr) return nullptr;
+                    auto s = newScope(scope);
+                    scope->namespaces.emplace(declarationName(typeDefined), s);
+                    auto sd = std::make_shared<StructDeclarationNode>(typeDefined, fields, s);
+                    sd->kind = k;
+                    sd->reprC = reprC;
+                    declareStruct(scope, sd);
+                    return sd;
+                }
+                case DECL_UNION:
+                {
+                    auto typeDefined = type();
+                    auto k = kind();
+                    bool reprC = byte() != 0;
+                    if(failed || typeDefined == nullptr) return nullptr;
+                    auto s = newScope(scope);
+                    scope->namespaces.emplace(declarationName(typeDefined), s);
+                    std::vector<Parameter> members;
+                    auto count = varint();
+                    for(uint64_t i = 0; i < count && !failed; i++)
+                    {
+                        auto identifier = name(TokenTypes::TYPE);
+                        auto ptype = type();
+                        if(ptype == nullptr) s->tyCons.emplace(tokenToString(identifier), std::make_shared<TypeNode>(typeDefined));
+                        else s->tyCons.emplace(tokenToString(identifier), std::make_shared<TypeNode>(std::make_shared<TyFunc>(ptype, typeDefined)));
+                        members.push_back(Parameter{ptype, identifier});
+                    }
+                    auto ud = std::make_shared<UnionDeclarationNode>(typeDefined, members, s);
+                    ud->kind = k;
+                    ud->reprC = reprC;
+                    scope->unions.insert(std::make_pair(declarationName(typeDefined), ud));
+                    return ud;
+                }
+                case DECL_TYPEDEF:
+                {
+                    auto typeDefined = type();
+                    auto typeAliased = type();
+                    if(failed || typeDefined == nullptr) return nullptr;
+                    auto td = std::make_shared<TypedefNode>(typeDefined, typeAliased);
+                    scope->typeAliases.insert(std::make_pair(declarationName(typeDefined), td));
+                    return td;
+                }
+                case DECL_CLASS:
+                {
+                    auto className = name(TokenTypes::TYPE);
+                    auto typeName = name();
+                    auto k = kind();
+                    std::vector<std::shared_ptr<Ty>> constraints;
+                    auto count = varint();
+                    for(uint64_t i = 0; i < count && !failed; i++) constraints.push_back(type());
+                    std::vector<std::shared_ptr<node>> functions;
+                    auto s = newScope(scope);
+                    count = varint();
+                    for(uint64_t i = 0; i < count && !failed; i++)
+                    {
+                        auto fd = function();
+                        scope->functions.insert(std::make_pair(tokenToString(fd->identifier), fd));
+                        s->functions.emplace(tokenToString(fd->identifier), fd);
+                        scope->instances.declareMethod(intern(std::string_view(fd->identifier.start, fd->identifier.length)), intern(std::string_view(className.start, className.length)));
+                        functions.push_back(fd);
+                    }
+                    scope->namespaces.emplace(tokenToString(className), s);
+                    auto cd = std::make_shared<ClassDeclarationNode>(className, typeName, constraints, functions);
+                    cd->kind = k;
+                    scope->classes.insert(std::make_pair(tokenToString(className), cd));
+                    return cd;
+                }
+                case DECL_IMPL:
+                {
+                    auto _class = name(TokenTypes::TYPE);
+                    auto implemented = type();
+                    if(failed || implemented == nullptr) return nullptr;
+                    std::vector<std::shared_ptr<node>> functions;
+                    auto count = varint();
+                    for(uint64_t i = 0; i < count && !failed; i++)
+                    {
+                        auto fd = function();
+                        functions.push_back(fd);
+                    }
+                    auto ci = std::make_shared<ClassImplementationNode>(_class, implemented, functions);
+                    scope->instances.add(makeInstance(ci));
+                    return ci;
+                }
+                case DECL_VARIABLE:
+                {
+                    auto t = type();
+                    std::unordered_map<std::string, std::shared_ptr<Ty>> ids;
+                    Token first = {TokenTypes::IDENTIFIER, strings, 0, 0};
+                    auto count = varint();
+                    for(uint64_t i = 0; i < count && !failed; i++)
+                    {
+                        auto identifier = name();
+                        if(i == 0) first = identifier;
+                        ids.emplace(tokenToString(identifier), type());
+                    }
+                    if(failed) return nullptr;
+                    auto assigned = std::make_shared<VariableNode>(first);
+                    auto vd = std::make_shared<VariableDeclarationNode>(t, assigned, ids, nullptr);
+                    for(auto& id : ids) scope->variables.emplace(id.first, vd);
+                    return vd;
+                }
+                case DECL_MODULE:
+                {
+                    auto moduleName = name(TokenTypes::TYPE);
+                    auto s = newScope(scope);
+                    scope->childScopes.push_back(s);
+                    auto block = std::make_shared<BlockStatementNode>(module(s), s);
+                    scope->namespaces.emplace(tokenToString(moduleName), s);
+                    return std::make_shared<ModuleDeclarationNode>(moduleName, block, s);
+                }
+                default:
+                {
+                    failed = true;
+                    return nullptr;
+                }
+            }
+        }
+
+        std::vector<std::shared_ptr<node>> module(std::shared_ptr<ScopeNode> scope)
+        {
+            std::vector<std::shared_ptr<node>> declarations;
+            auto count = varint();
+            for(uint64_t i = 0; i < count && !failed; i++)
+            {
+                auto dec = declaration(scope);
+                if(dec != nullptr) declarations.push_back(dec);
+            }
+            return declarations;
+        }
+    };
+
+    std::shared_ptr<ModuleInterface> loadModuleInterface(const std::string& path, uint64_t contentHash, std::shared_ptr<ScopeNode> scope)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if(file == nullptr) return nullptr;
+        std::string data;
+        char buffer[4096];
+        size_t read;
+        while((read = fread(buffer, 1, sizeof(buffer), file)) > 0) data.append(buffer, read);
+        fclose(file);
+
+        const size_t headerSize = sizeof(interfaceMagic) + 8;
+        if(data.size() < headerSize || memcmp(data.data(), interfaceMagic, sizeof(interfaceMagic)) != 0) return nullptr;
+        uint64_t hash = 0;
+        for(int i = 0; i < 8; i++) hash |= (uint64_t)(uint8_t)data[sizeof(interfaceMagic) + i] << (8 * i);
+        if(hash != contentHash) return nullptr;
+
+        auto result = std::make_shared<ModuleInterface>();
+        result->contentHash = hash;
+        InterfaceReader r;
+        r.current = (const uint8_t*)data.data() + headerSize;
+        r.end = (const uint8_t*)data.data() + data.size();
+        auto stringsLength = r.varint();
+        if(r.failed || stringsLength > (size_t)(r.end - r.current)) return nullptr;
+        result->strings.assign((const char*)r.current, stringsLength);
+        r.current += stringsLength;
+        r.strings = result->strings.data();
+        r.stringsLength = result->strings.size();
+        result->declarations = r.module(scope);
+        if(r.failed) return nullptr;
+        return result;
+    }
+}
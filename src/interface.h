@@ -0,0 +1,29 @@
+#ifndef interface_header
+#define interface_header
+
+#include <unordered_map>
+#include "parser.h"
+
+namespace pilaf {
+    //a module's exported declarations, decoded from an on-disk interface file.
+    //tokens in the decoded declarations point into `strings`, so the interface
+    //must outlive them (ModuleDeclarationNode::interface keeps it alive).
+    struct ModuleInterface {
+        uint64_t contentHash;
+        std::string strings;
+        std::vector<std::shared_ptr<node>> declarations;
+    };
+
+    //keys an interface by the module's source and the operator table it was parsed under
+    uint64_t hashModuleSource(Token name, const char* start, const char* end, const ScopeNode* enclosing);
+
+    std::string interfacePath(const std::string& directory, Token name);
+
+    //returns nullptr if there is no interface at `path` or it was built from different source
+    std::shared_ptr<ModuleInterface> loadModuleInterface(const std::string& path, uint64_t contentHash, std::shared_ptr<ScopeNode> scope);
+
+    //`substitutions` is the solver's output as built by composeSubstitutions.
+    //refuses (returns false) modules that use declarations from their enclosing scope
+    bool writeModuleInterface(const std::string& path, std::shared_ptr<ModuleDeclarationNode> module, const std::unordered_map<std::string, std::shared_ptr<Ty>>& substitutions);
+}
+#endif
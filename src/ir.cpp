@@ -0,0 +1,650 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include "ir.h"
+
+namespace pilaf {
+    const char* irOpcodeName(IrOpcode op)
+    {
+        static const char* const names[] = {
+            #define PILAF_IR_OPCODE_NAME(name) #name,
+            PILAF_IR_OPCODES(PILAF_IR_OPCODE_NAME)
+            #undef PILAF_IR_OPCODE_NAME
+        };
+        return op < IR_COUNT ? names[op] : "?";
+    }
+
+    bool isTerminator(IrOpcode op)
+    {
+        return op == IR_JUMP || op == IR_BRANCH || op == IR_SWITCH || op == IR_RETURN || op == IR_UNREACHABLE;
+    }
+
+    bool definesValue(IrOpcode op)
+    {
+        return !isTerminator(op) && op != IR_SETGLOBAL && op != IR_SETFIELD && op != IR_SETINDEX;
+    }
+
+    uint32_t IrModule::type(const std::shared_ptr<Ty>& t)
+    {
+        static const auto voidType = std::make_shared<TyBasic>("Void");
+        auto& ty = t != nullptr ? t : voidType;
+        auto key = typeToString(ty);
+        auto it = typeIndex.find(key);
+        if(it != typeIndex.end()) return it->second;
+        types.push_back(ty);
+        typeIndex.emplace(std::move(key), (uint32_t)(types.size() - 1));
+        return (uint32_t)(types.size() - 1);
+    }
+
+    uint32_t IrModule::constant(IrConstantKind kind, uint64_t bits)
+    {
+        auto key = std::make_pair(kind, bits);
+        auto it = constantIndex.find(key);
+        if(it != constantIndex.end()) return it->second;
+        constants.push_back(IrConstant{kind, bits});
+        constantIndex.emplace(key, (uint32_t)(constants.size() - 1));
+        return (uint32_t)(constants.size() - 1);
+    }
+
+    template<typename T>
+    static size_t bytes(const std::vector<T>& v)
+    {
+        return v.capacity() * sizeof(T);
+    }
+
+    size_t IrModule::footprint() const
+    {
+        size_t total = sizeof(*this) + bytes(types) + bytes(constants) + bytes(layouts) + bytes(fields) + bytes(globals) + bytes(functions);
+        //the types themselves are shared with the syntax tree
+        for(auto& entry : typeIndex) total += sizeof(entry) + entry.first.capacity();
+        total += constantIndex.size() * (sizeof(std::pair<const std::pair<IrConstantKind, uint64_t>, uint32_t>) + 4 * sizeof(void*));
+        for(auto& s : strings) total += sizeof(s) + s.capacity();
+        for(auto& layout : layouts) total += layout.name.capacity() + bytes(layout.names) + layout.empty.capacity() / 8 + bytes(layout.types) + bytes(layout.params);
+        for(auto& f : functions)
+        {
+            total += f.name.capacity() + bytes(f.params) + bytes(f.instructions) + bytes(f.lines) + bytes(f.inlined) + bytes(f.origins) + bytes(f.operands) + bytes(f.blocks);
+            for(auto& name : f.inlined) total += name.capacity();
+            for(auto& b : f.blocks) total += bytes(b.instructions) + bytes(b.predecessors);
+        }
+        return total;
+    }
+
+    uint32_t addInstruction(IrFunction& function, const IrInstruction& instruction, uint32_t line)
+    {
+        function.instructions.push_back(instruction);
+        function.lines.push_back(line);
+        if(!function.origins.empty()) function.origins.push_back(0);
+        return (uint32_t)(function.instructions.size() - 1);
+    }
+
+    void replaceUses(IrFunction& function, const std::vector<uint32_t>& replacement)
+    {
+        auto find = [&](uint32_t v)
+        {
+            while(v < replacement.size() && replacement[v] != irNone) v = replacement[v];
+            return v;
+        };
+        for(auto& block : function.blocks)
+        {
+            for(auto i : block.instructions) forEachOperand(function, i, [&](uint32_t& operand) { operand = find(operand); });
+        }
+    }
+
+    void removeEdge(IrFunction& function, uint32_t from, uint32_t to)
+    {
+        auto& block = function.blocks[to];
+        auto& preds = block.predecessors;
+        auto it = std::find(preds.begin(), preds.end(), from);
+        if(it == preds.end()) return;
+        preds.erase(it);
+        for(auto i : block.instructions)
+        {
+            auto& in = function.instructions[i];
+            if(in.op != IR_PHI) break;
+            uint32_t kept = 0;
+            for(uint32_t k = 0; k < in.b; k++)
+            {
+                if(function.operands[in.a + 2 * k] == from) continue;
+                function.operands[in.a + 2 * kept] = function.operands[in.a + 2 * k];
+                function.operands[in.a + 2 * kept + 1] = function.operands[in.a + 2 * k + 1];
+                kept++;
+            }
+            in.b = kept;
+        }
+    }
+
+    void removeUnreachableBlocks(IrFunction& function)
+    {
+        if(function.blocks.empty()) return;
+        std::vector<bool> reachable(function.blocks.size(), false);
+        for(auto b : reversePostorder(function)) reachable[b] = true;
+        std::vector<uint32_t> renumbered(function.blocks.size(), irNone);
+        uint32_t count = 0;
+        std::vector<uint32_t> next;
+        for(uint32_t b = 0; b < function.blocks.size(); b++)
+        {
+            if(!reachable[b])
+            {
+                auto n = successors(function, b, next);
+                for(size_t i = 0; i < n; i++) removeEdge(function, b, next[i]);
+                continue;
+            }
+            renumbered[b] = count++;
+        }
+        if(count == function.blocks.size()) return;
+        std::vector<IrBlock> kept;
+        kept.reserve(count);
+        for(uint32_t b = 0; b < function.blocks.size(); b++)
+        {
+            if(reachable[b]) kept.push_back(std::move(function.blocks[b]));
+        }
+        for(auto& block : kept)
+        {
+            for(auto& p : block.predecessors) p = renumbered[p];
+            for(auto i : block.instructions)
+            {
+                auto& in = function.instructions[i];
+                switch(in.op)
+                {
+                    case IR_JUMP: in.a = renumbered[in.a]; break;
+                    case IR_BRANCH: in.b = renumbered[in.b]; in.c = renumbered[in.c]; break;
+                    case IR_SWITCH:
+                    {
+                        function.operands[in.b] = renumbered[function.operands[in.b]];
+                        for(uint32_t k = 0; k < in.c; k++) function.operands[in.b + 2 + 2 * k] = renumbered[function.operands[in.b + 2 + 2 * k]];
+                        break;
+                    }
+                    case IR_PHI: for(uint32_t k = 0; k < in.b; k++) function.operands[in.a + 2 * k] = renumbered[function.operands[in.a + 2 * k]]; break;
+                    default: break;
+                }
+            }
+        }
+        function.blocks = std::move(kept);
+    }
+
+    size_t successors(const IrFunction& function, uint32_t block, std::vector<uint32_t>& out)
+    {
+        out.clear();
+        auto& b = function.blocks[block];
+        if(b.instructions.empty()) return 0;
+        auto& in = function.instructions[b.instructions.back()];
+        switch(in.op)
+        {
+            case IR_JUMP: out.push_back(in.a); break;
+            case IR_BRANCH:
+            {
+                out.push_back(in.b);
+                if(in.c != in.b) out.push_back(in.c);
+                break;
+            }
+            case IR_SWITCH:
+            {
+                //cases that share a block are one edge
+                out.push_back(function.operands[in.b]);
+                for(uint32_t k = 0; k < in.c; k++)
+                {
+                    auto target = function.operands[in.b + 2 + 2 * k];
+                    if(std::find(out.begin(), out.end(), target) == out.end()) out.push_back(target);
+                }
+                break;
+            }
+            default: break;
+        }
+        return out.size();
+    }
+
+    bool isTailCall(const IrFunction& function, uint32_t block, uint32_t call)
+    {
+        auto& instructions = function.blocks[block].instructions;
+        if(function.instructions[call].op != IR_CALL || instructions.size() < 2 || instructions[instructions.size() - 2] != call) return false;
+        auto& next = function.instructions[instructions.back()];
+        if(next.op == IR_RETURN) return next.a == call;
+        if(next.op != IR_JUMP) return false;
+        //the result may reach the return through a phi of the block jumped to
+        auto returned = call;
+        for(auto i : function.blocks[next.a].instructions)
+        {
+            auto& in = function.instructions[i];
+            if(in.op == IR_RETURN) return in.a == returned;
+            if(in.op != IR_PHI) return false;
+            for(uint32_t k = 0; k < in.b; k++)
+            {
+                if(function.operands[in.a + 2 * k] == block && function.operands[in.a + 2 * k + 1] == call) returned = i;
+            }
+        }
+        return false;
+    }
+
+    std::vector<uint32_t> reversePostorder(const IrFunction& function)
+    {
+        std::vector<uint32_t> order;
+        if(function.blocks.empty()) return order;
+        std::vector<bool> visited(function.blocks.size(), false);
+        //(block, successors already pushed)
+        std::vector<std::pair<uint32_t, size_t>> stack = {{0, 0}};
+        visited[0] = true;
+        std::vector<uint32_t> next;
+        while(!stack.empty())
+        {
+            auto& top = stack.back();
+            auto count = successors(function, top.first, next);
+            if(top.second < count)
+            {
+                auto s = next[top.second++];
+                if(s < visited.size() && !visited[s])
+                {
+                    visited[s] = true;
+                    stack.emplace_back(s, 0);
+                }
+                continue;
+            }
+            order.push_back(top.first);
+            stack.pop_back();
+        }
+        std::reverse(order.begin(), order.end());
+        return order;
+    }
+
+    //Cooper, Harvey and Kennedy's iterative algorithm over the reverse postorder
+    std::vector<uint32_t> dominators(const IrFunction& function)
+    {
+        std::vector<uint32_t> idom(function.blocks.size(), irNone);
+        auto order = reversePostorder(function);
+        if(order.empty()) return idom;
+        std::vector<uint32_t> position(function.blocks.size(), irNone);
+        for(size_t i = 0; i < order.size(); i++) position[order[i]] = (uint32_t)i;
+        idom[0] = 0;
+        bool changed = true;
+        while(changed)
+        {
+            changed = false;
+            for(size_t i = 1; i < order.size(); i++)
+            {
+                auto b = order[i];
+                uint32_t chosen = irNone;
+                for(auto p : function.blocks[b].predecessors)
+                {
+                    if(idom[p] == irNone) continue;
+                    if(chosen == irNone)
+                    {
+                        chosen = p;
+                        continue;
+                    }
+                    auto x = p;
+                    auto y = chosen;
+                    while(x != y)
+                    {
+                        while(position[x] > position[y]) x = idom[x];
+                        while(position[y] > position[x]) y = idom[y];
+                    }
+                    chosen = x;
+                }
+                if(chosen != idom[b])
+                {
+                    idom[b] = chosen;
+                    changed = true;
+                }
+            }
+        }
+        return idom;
+    }
+
+    static bool dominates(const std::vector<uint32_t>& idom, uint32_t a, uint32_t b)
+    {
+        while(b != a)
+        {
+            if(b == 0 || idom[b] == irNone) return false;
+            b = idom[b];
+        }
+        return true;
+    }
+
+    struct Verifier {
+        const IrModule& module;
+        const IrFunction& function;
+        std::string& error;
+        //block holding each instruction and its position there
+        std::vector<uint32_t> owner;
+        std::vector<uint32_t> position;
+        std::vector<uint32_t> idom;
+
+        bool fail(uint32_t block, uint32_t instruction, const std::string& what)
+        {
+            error = "fn " + function.name;
+            if(block != irNone) error.append(", b").append(std::to_string(block));
+            if(instruction != irNone) error.append(", %").append(std::to_string(instruction));
+            error.append(": ").append(what);
+            return false;
+        }
+
+        bool value(uint32_t block, uint32_t instruction, uint32_t operand, uint32_t from)
+        {
+            if(operand >= function.instructions.size() || owner[operand] == irNone) return fail(block, instruction, "operand %" + std::to_string(operand) + " is not an instruction of the function");
+            if(!definesValue(function.instructions[operand].op)) return fail(block, instruction, "operand %" + std::to_string(operand) + " has no value");
+            //uses in unreachable code are not checked for dominance
+            if(idom[from] == irNone) return true;
+            auto def = owner[operand];
+            //a phi's value only has to be available at the end of the predecessor it comes from
+            bool phi = function.instructions[instruction].op == IR_PHI;
+            bool ok = phi || def != block ? dominates(idom, def, from) : position[operand] < position[instruction];
+            if(!ok) return fail(block, instruction, "%" + std::to_string(operand) + " does not dominate its use");
+            return true;
+        }
+
+        bool run()
+        {
+            auto count = function.instructions.size();
+            owner.assign(count, irNone);
+            position.assign(count, irNone);
+            if(function.external) return function.blocks.empty() || fail(irNone, irNone, "external function has blocks");
+            if(function.lines.size() != count) return fail(irNone, irNone, "instructions and their lines differ in number");
+            if(!function.origins.empty() && function.origins.size() != count) return fail(irNone, irNone, "instructions and their origins differ in number");
+            if(function.blocks.empty()) return fail(irNone, irNone, "function has no entry block");
+            for(uint32_t b = 0; b < function.blocks.size(); b++)
+            {
+                auto& block = function.blocks[b];
+                if(block.instructions.empty()) return fail(b, irNone, "block is empty");
+                for(uint32_t i = 0; i < block.instructions.size(); i++)
+                {
+                    auto in = block.instructions[i];
+                    if(in >= count) return fail(b, in, "instruction is out of range");
+                    if(owner[in] != irNone) return fail(b, in, "instruction is in more than one place");
+                    owner[in] = b;
+                    position[in] = i;
+                    auto op = function.instructions[in].op;
+                    if(op == IR_SWITCH && (size_t)function.instructions[in].b + 1 + 2 * (size_t)function.instructions[in].c > function.operands.size()) return fail(b, in, "operands are out of range");
+                    if(isTerminator(op) != (i + 1 == block.instructions.size())) return fail(b, in, isTerminator(op) ? "terminator before the end of the block" : "block does not end with a terminator");
+                    if(op == IR_PHI && i != 0 && function.instructions[block.instructions[i - 1]].op != IR_PHI) return fail(b, in, "phi after the start of the block");
+                }
+            }
+
+            //predecessor lists must be exactly the blocks that jump here
+            std::vector<std::vector<uint32_t>> expected(function.blocks.size());
+            std::vector<uint32_t> next;
+            for(uint32_t b = 0; b < function.blocks.size(); b++)
+            {
+                auto n = successors(function, b, next);
+                for(size_t i = 0; i < n; i++)
+                {
+                    if(next[i] >= function.blocks.size()) return fail(b, function.blocks[b].instructions.back(), "jump to a block that does not exist");
+                    expected[next[i]].push_back(b);
+                }
+            }
+            for(uint32_t b = 0; b < function.blocks.size(); b++)
+            {
+                auto actual = function.blocks[b].predecessors;
+                std::sort(actual.begin(), actual.end());
+                std::sort(expected[b].begin(), expected[b].end());
+                if(actual != expected[b]) return fail(b, irNone, "predecessors do not match the jumps to the block");
+            }
+            if(!function.blocks[0].predecessors.empty()) return fail(0, irNone, "the entry block has predecessors");
+
+            idom = dominators(function);
+            for(uint32_t b = 0; b < function.blocks.size(); b++)
+            {
+                for(auto i : function.blocks[b].instructions)
+                {
+                    if(!instruction(b, i)) return false;
+                }
+            }
+            return true;
+        }
+
+        bool instruction(uint32_t b, uint32_t i)
+        {
+            auto& in = function.instructions[i];
+            if(in.op >= IR_COUNT) return fail(b, i, "unknown opcode");
+            if(in.type >= module.types.size()) return fail(b, i, "type is out of range");
+            switch(in.op)
+            {
+                case IR_CONST: if(in.a >= module.constants.size()) return fail(b, i, "constant is out of range"); break;
+                case IR_PARAM: if(in.a >= function.params.size()) return fail(b, i, "parameter is out of range"); break;
+                case IR_GLOBAL:
+                case IR_SETGLOBAL: if(in.a >= module.globals.size()) return fail(b, i, "global is out of range"); break;
+                case IR_FUNCTION: if(in.a >= module.functions.size()) return fail(b, i, "function is out of range"); break;
+                case IR_CLOSURE:
+                case IR_LOCALCLOSURE:
+                {
+                    if(in.c >= module.functions.size()) return fail(b, i, "function is out of range");
+                    if(module.functions[in.c].captures != in.b) return fail(b, i, "closure captures " + std::to_string(in.b) + " values for a function taking " + std::to_string(module.functions[in.c].captures));
+                    break;
+                }
+                case IR_CALL:
+                {
+                    if(in.c >= module.functions.size()) return fail(b, i, "function is out of range");
+                    if(module.functions[in.c].params.size() != in.b) return fail(b, i, "call passes " + std::to_string(in.b) + " arguments to a function of " + std::to_string(module.functions[in.c].params.size()));
+                    break;
+                }
+                case IR_CALLVALUE: if(in.b == 0) return fail(b, i, "call has no callee"); break;
+                case IR_RECORD:
+                {
+                    if(in.c >= module.layouts.size() || module.layouts[in.c].isUnion) return fail(b, i, "record layout is out of range");
+                    if(module.layouts[in.c].size != in.b) return fail(b, i, "record does not fill its layout");
+                    break;
+                }
+                case IR_GETFIELD:
+                case IR_SETFIELD: if(in.b >= module.fields.size()) return fail(b, i, "field is out of range"); break;
+                case IR_VARIANT:
+                {
+                    if(in.b >= module.layouts.size() || !module.layouts[in.b].isUnion || in.c >= module.layouts[in.b].names.size()) return fail(b, i, "union member is out of range");
+                    if((in.a == irNone) != module.layouts[in.b].empty[in.c]) return fail(b, i, "union member payload does not match its declaration");
+                    break;
+                }
+                case IR_SWITCH:
+                {
+                    for(uint32_t k = 0; k < in.c; k++)
+                    {
+                        auto constant = function.operands[in.b + 1 + 2 * k];
+                        if(constant >= module.constants.size()) return fail(b, i, "constant is out of range");
+                        auto kind = module.constants[constant].kind;
+                        if(kind != CONST_INT && kind != CONST_CHAR) return fail(b, i, "switch case is not an Int or Char");
+                        for(uint32_t j = 0; j < k; j++)
+                        {
+                            if(module.constants[function.operands[in.b + 1 + 2 * j]].bits == module.constants[constant].bits) return fail(b, i, "switch has two cases for one value");
+                        }
+                    }
+                    break;
+                }
+                case IR_PHI:
+                {
+                    auto& preds = function.blocks[b].predecessors;
+                    if(in.b != preds.size()) return fail(b, i, "phi does not have one entry per predecessor");
+                    if((size_t)in.a + 2 * (size_t)in.b > function.operands.size()) return fail(b, i, "operands are out of range");
+                    for(uint32_t k = 0; k < in.b; k++)
+                    {
+                        auto from = function.operands[in.a + 2 * k];
+                        if(std::find(preds.begin(), preds.end(), from) == preds.end()) return fail(b, i, "phi entry for b" + std::to_string(from) + ", which is not a predecessor");
+                        for(uint32_t j = 0; j < k; j++)
+                        {
+                            if(function.operands[in.a + 2 * j] == from) return fail(b, i, "phi has two entries for b" + std::to_string(from));
+                        }
+                        if(!value(b, i, function.operands[in.a + 2 * k + 1], from)) return false;
+                    }
+                    return true;
+                }
+                default: break;
+            }
+            if((in.op == IR_CALL || in.op == IR_CALLVALUE || in.op == IR_RECORD || in.op == IR_ARRAY || in.op == IR_CLOSURE || in.op == IR_LOCALCLOSURE) && (size_t)in.a + in.b > function.operands.size())
+            {
+                return fail(b, i, "operands are out of range");
+            }
+            bool ok = true;
+            forEachOperand(function, i, [&](uint32_t operand)
+            {
+                if(ok) ok = value(b, i, operand, b);
+            });
+            return ok;
+        }
+    };
+
+    bool verifyIr(const IrModule& module, std::string& error)
+    {
+        if(module.init >= module.functions.size())
+        {
+            error = "module has no init function";
+            return false;
+        }
+        for(auto& f : module.functions)
+        {
+            Verifier verifier{module, f, error, {}, {}, {}};
+            if(!verifier.run()) return false;
+        }
+        return true;
+    }
+
+    static void printConstant(const IrModule& module, const IrConstant& k, FILE* out)
+    {
+        switch(k.kind)
+        {
+            case CONST_VOID: fprintf(out, "()"); break;
+            case CONST_BOOL: fprintf(out, "%s", k.bits ? "true" : "false"); break;
+            case CONST_INT: fprintf(out, "%" PRId64, (int64_t)k.bits); break;
+            case CONST_FLOAT:
+            {
+                float f;
+                uint32_t bits = (uint32_t)k.bits;
+                memcpy(&f, &bits, sizeof(f));
+                fprintf(out, "%.9gf", f);
+                break;
+            }
+            case CONST_DOUBLE:
+            {
+                double d;
+                memcpy(&d, &k.bits, sizeof(d));
+                fprintf(out, "%.17g", d);
+                break;
+            }
+            case CONST_CHAR: fprintf(out, "'\\u%04" PRIx64 "'", k.bits); break;
+            case CONST_STRING:
+            {
+                fputc('"', out);
+                for(char c : module.strings[k.bits])
+                {
+                    if(c == '"' || c == '\\') fprintf(out, "\\%c", c);
+                    else if(c == '\n') fprintf(out, "\\n");
+                    else if((unsigned char)c < 0x20) fprintf(out, "\\x%02x", (unsigned char)c);
+                    else fputc(c, out);
+                }
+                fputc('"', out);
+                break;
+            }
+        }
+    }
+
+    static void printValues(const IrFunction& function, uint32_t offset, uint32_t count, FILE* out)
+    {
+        for(uint32_t i = 0; i < count; i++) fprintf(out, "%s%%%u", i == 0 ? "" : ", ", function.operands[offset + i]);
+    }
+
+    static const char* fieldName(const IrModule& module, uint32_t field)
+    {
+        return symbolName(module.fields[field].name).c_str();
+    }
+
+    void dumpIr(const IrFunction& function, const IrModule& module, FILE* out)
+    {
+        fprintf(out, "%s %s(", function.external ? "extern" : "fn", function.name.c_str());
+        for(size_t i = 0; i < function.params.size(); i++) fprintf(out, "%s%s", i == 0 ? "" : ", ", typeToString(module.types[function.params[i]]).c_str());
+        fprintf(out, "): %s\n", typeToString(module.types[function.result]).c_str());
+        for(uint32_t b = 0; b < function.blocks.size(); b++)
+        {
+            auto& block = function.blocks[b];
+            fprintf(out, "b%u:", b);
+            if(!block.predecessors.empty())
+            {
+                fprintf(out, " ; preds");
+                for(auto p : block.predecessors) fprintf(out, " b%u", p);
+            }
+            fprintf(out, "\n");
+            for(auto i : block.instructions)
+            {
+                auto& in = function.instructions[i];
+                fprintf(out, "    ");
+                if(definesValue(in.op)) fprintf(out, "%%%u: %s = ", i, typeToString(module.types[in.type]).c_str());
+                std::string name = irOpcodeName(in.op);
+                std::transform(name.begin(), name.end(), name.begin(), [](char c) { return (char)tolower(c); });
+                fprintf(out, "%s", name.c_str());
+                switch(in.op)
+                {
+                    case IR_CONST: fprintf(out, " "); printConstant(module, module.constants[in.a], out); break;
+                    case IR_UNDEF:
+                    case IR_UNREACHABLE: break;
+                    case IR_PARAM: fprintf(out, " %u", in.a); break;
+                    case IR_PHI:
+                    {
+                        for(uint32_t k = 0; k < in.b; k++) fprintf(out, "%s[b%u: %%%u]", k == 0 ? " " : ", ", function.operands[in.a + 2 * k], function.operands[in.a + 2 * k + 1]);
+                        break;
+                    }
+                    case IR_GLOBAL: fprintf(out, " @%s", module.globals[in.a].name.c_str()); break;
+                    case IR_SETGLOBAL: fprintf(out, " @%s, %%%u", module.globals[in.a].name.c_str(), in.b); break;
+                    case IR_FUNCTION: fprintf(out, " %s", module.functions[in.a].name.c_str()); break;
+                    case IR_NEG:
+                    case IR_NOT:
+                    case IR_TAG:
+                    case IR_PAYLOAD: fprintf(out, " %%%u", in.a); break;
+                    case IR_CALL:
+                    {
+                        fprintf(out, " %s(", module.functions[in.c].name.c_str());
+                        printValues(function, in.a, in.b, out);
+                        fprintf(out, isTailCall(function, b, i) ? ") ; tail" : ")");
+                        break;
+                    }
+                    case IR_CALLVALUE:
+                    {
+                        fprintf(out, " %%%u(", function.operands[in.a]);
+                        printValues(function, in.a + 1, in.b - 1, out);
+                        fprintf(out, ")");
+                        break;
+                    }
+                    case IR_RECORD:
+                    {
+                        auto& layout = module.layouts[in.c];
+                        fprintf(out, " %s{", layout.name.empty() ? "" : (layout.name + " ").c_str());
+                        printValues(function, in.a, in.b, out);
+                        fprintf(out, "}");
+                        break;
+                    }
+                    case IR_ARRAY: fprintf(out, " ["); printValues(function, in.a, in.b, out); fprintf(out, "]"); break;
+                    case IR_CLOSURE:
+                    case IR_LOCALCLOSURE: fprintf(out, " %s[", module.functions[in.c].name.c_str()); printValues(function, in.a, in.b, out); fprintf(out, "]"); break;
+                    case IR_GETFIELD: fprintf(out, " %%%u.%s", in.a, fieldName(module, in.b)); break;
+                    case IR_SETFIELD: fprintf(out, " %%%u.%s, %%%u", in.a, fieldName(module, in.b), in.c); break;
+                    case IR_GETINDEX: fprintf(out, " %%%u[%%%u]", in.a, in.b); break;
+                    case IR_SETINDEX: fprintf(out, " %%%u[%%%u], %%%u", in.a, in.b, in.c); break;
+                    case IR_VARIANT:
+                    {
+                        fprintf(out, " %s", symbolName(module.layouts[in.b].names[in.c]).c_str());
+                        if(in.a != irNone) fprintf(out, "(%%%u)", in.a);
+                        break;
+                    }
+                    case IR_JUMP: fprintf(out, " b%u", in.a); break;
+                    case IR_BRANCH: fprintf(out, " %%%u, b%u, b%u", in.a, in.b, in.c); break;
+                    case IR_SWITCH:
+                    {
+                        fprintf(out, " %%%u, b%u [", in.a, function.operands[in.b]);
+                        for(uint32_t k = 0; k < in.c; k++)
+                        {
+                            if(k != 0) fprintf(out, ", ");
+                            printConstant(module, module.constants[function.operands[in.b + 1 + 2 * k]], out);
+                            fprintf(out, ": b%u", function.operands[in.b + 2 + 2 * k]);
+                        }
+                        fprintf(out, "]");
+                        break;
+                    }
+                    case IR_RETURN: if(in.a != irNone) fprintf(out, " %%%u", in.a); break;
+                    default: fprintf(out, " %%%u, %%%u", in.a, in.b); break;
+                }
+                fprintf(out, "\n");
+            }
+        }
+    }
+
+    void dumpIr(const IrModule& module, FILE* out)
+    {
+        for(size_t i = 0; i < module.functions.size(); i++)
+        {
+            if(i != 0) fprintf(out, "\n");
+            dumpIr(module.functions[i], module, out);
+        }
+    }
+}
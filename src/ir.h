@@ -0,0 +1,233 @@
+#ifndef ir_header
+#define ir_header
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "parser.h"
+
+namespace pilaf {
+    //operands, blocks, functions and table entries are 32-bit indices; irNone marks an absent one
+    const uint32_t irNone = UINT32_MAX;
+
+    //a, b and c name the instruction's operand slots. "values" are an (offset, count) run of
+    //the function's operand pool; a phi's run holds a (block, value) pair per predecessor
+    #define PILAF_IR_OPCODES(X) \
+        X(CONST)        /* a: constant */ \
+        X(UNDEF)        /* a variable read before any write */ \
+        X(PARAM)        /* a: parameter index */ \
+        X(PHI)          /* a, b: (block, value) pairs */ \
+        X(GLOBAL)       /* a: global */ \
+        X(SETGLOBAL)    /* a: global, b: value */ \
+        X(FUNCTION)     /* a: function, as a value */ \
+        X(CLOSURE)      /* a, b: captured values, c: function taking them after its own parameters */ \
+        X(LOCALCLOSURE) /* as CLOSURE, for a closure that cannot outlive the call that makes it */ \
+        X(ADD) X(SUB) X(MUL) X(DIV) X(MOD) \
+        X(BAND) X(BOR) X(BXOR) X(SHL) X(SHR) \
+        X(EQ) X(NE) X(LT) X(LE) /* a, b: operands */ \
+        X(NEG) X(NOT)   /* a: operand */ \
+        X(CALL)         /* a, b: arguments, c: function */ \
+        X(CALLVALUE)    /* a, b: the callee followed by its arguments */ \
+        X(RECORD)       /* a, b: fields in layout order, c: layout */ \
+        X(GETFIELD)     /* a: record, b: field */ \
+        X(SETFIELD)     /* a: record, b: field, c: value */ \
+        X(ARRAY)        /* a, b: elements */ \
+        X(GETINDEX)     /* a: array, b: index */ \
+        X(SETINDEX)     /* a: array, b: index, c: value */ \
+        X(VARIANT)      /* a: payload or irNone, b: layout, c: tag */ \
+        X(TAG)          /* a: variant */ \
+        X(PAYLOAD)      /* a: variant */ \
+        X(JUMP)         /* a: block */ \
+        X(BRANCH)       /* a: Bool condition, b: block if true, c: block if false */ \
+        X(SWITCH)       /* a: Int or Char value, b: default block then (constant, block) pairs, c: pairs */ \
+        X(RETURN)       /* a: value or irNone */ \
+        X(UNREACHABLE)
+
+    enum IrOpcode : uint8_t {
+        #define PILAF_IR_OPCODE_ENUM(name) IR_##name,
+        PILAF_IR_OPCODES(PILAF_IR_OPCODE_ENUM)
+        #undef PILAF_IR_OPCODE_ENUM
+        IR_COUNT
+    };
+
+    const char* irOpcodeName(IrOpcode op);
+    bool isTerminator(IrOpcode op);
+    //false for instructions that are only run for their effect, whose index names no value
+    bool definesValue(IrOpcode op);
+
+    //an instruction and the value it defines share an index, so there is no separate value table
+    struct IrInstruction {
+        IrOpcode op;
+        //index into the module's types; Void for instructions without a result
+        uint32_t type;
+        uint32_t a;
+        uint32_t b;
+        uint32_t c;
+    };
+    static_assert(sizeof(IrInstruction) == 20, "instructions are kept to five words");
+
+    struct IrBlock {
+        //phis first and the terminator last, in execution order
+        std::vector<uint32_t> instructions;
+        std::vector<uint32_t> predecessors;
+    };
+
+    struct IrFunction {
+        std::string name;
+        std::vector<uint32_t> params;
+        //the last `captures` parameters are the values a lambda captured, which its closure supplies
+        uint32_t captures = 0;
+        uint32_t result;
+        //declared without a body; calls go to a built-in or another unit
+        bool external;
+        std::vector<IrInstruction> instructions;
+        //source line of every instruction, for runtime errors; 0 when unknown
+        std::vector<uint32_t> lines;
+        //functions inlined into this one, and which of them every instruction came from, counting
+        //from 1 with 0 for the function's own. origins stays empty until something is inlined
+        std::vector<std::string> inlined;
+        std::vector<uint32_t> origins;
+        std::vector<uint32_t> operands;
+        //blocks[0] is the entry
+        std::vector<IrBlock> blocks;
+    };
+
+    enum IrConstantKind : uint8_t {
+        CONST_VOID,
+        CONST_BOOL,
+        CONST_INT,
+        CONST_FLOAT,
+        CONST_DOUBLE,
+        CONST_CHAR,
+        //bits index the module's strings
+        CONST_STRING
+    };
+
+    struct IrConstant {
+        IrConstantKind kind;
+        //the integer, or the float or double's bit pattern
+        uint64_t bits;
+    };
+
+    //fields of a struct or tuple, or members of a union
+    struct IrLayout {
+        //empty for tuples
+        std::string name;
+        std::vector<Symbol> names;
+        //for unions, which members carry no value
+        std::vector<bool> empty;
+        //declared type of every field or member, in the declaration's own type variables; Void for
+        //members without a value. empty for tuples, whose fields can hold anything
+        std::vector<uint32_t> types;
+        size_t size;
+        bool isUnion;
+        //the declaration's type variables, in the order its type takes them
+        std::vector<uint32_t> params;
+        //repr(C): fields stay in declaration order and a union's tag is always stored
+        bool declaredOrder;
+    };
+
+    struct IrField {
+        Symbol name;
+        //position in the record, or irNone when it depends on which struct the record is
+        uint32_t index;
+    };
+
+    struct IrGlobal {
+        std::string name;
+        uint32_t type;
+    };
+
+    struct IrModule {
+        std::vector<std::shared_ptr<Ty>> types;
+        std::unordered_map<std::string, uint32_t> typeIndex;
+        std::vector<IrConstant> constants;
+        std::map<std::pair<IrConstantKind, uint64_t>, uint32_t> constantIndex;
+        std::vector<std::string> strings;
+        std::vector<IrLayout> layouts;
+        std::vector<IrField> fields;
+        std::vector<IrGlobal> globals;
+        std::vector<IrFunction> functions;
+        //runs the top-level statements
+        uint32_t init = 0;
+        uint32_t main = irNone;
+        //syntax tree nodes lowered into this module, for measuring its footprint
+        size_t sourceNodes = 0;
+
+        //index of `t`; structurally equal types share one
+        uint32_t type(const std::shared_ptr<Ty>& t);
+        //index of the constant; equal ones share one, so passes can make new constants freely
+        uint32_t constant(IrConstantKind kind, uint64_t bits);
+        //bytes held by the module's tables and functions
+        size_t footprint() const;
+    };
+
+    //calls `visit` on every operand slot of the instruction that holds a value, so that passes can
+    //read or rewrite them in place. a phi's blocks are skipped
+    template<typename Function, typename Visit>
+    void forEachOperand(Function& function, uint32_t instruction, Visit visit)
+    {
+        auto& in = function.instructions[instruction];
+        switch(in.op)
+        {
+            case IR_PHI: for(uint32_t i = 0; i < in.b; i++) visit(function.operands[in.a + 2 * i + 1]); break;
+            case IR_CALL:
+            case IR_CALLVALUE:
+            case IR_RECORD:
+            case IR_ARRAY:
+            case IR_CLOSURE:
+            case IR_LOCALCLOSURE: for(uint32_t i = 0; i < in.b; i++) visit(function.operands[in.a + i]); break;
+            case IR_SETGLOBAL: visit(in.b); break;
+            case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+            case IR_BAND: case IR_BOR: case IR_BXOR: case IR_SHL: case IR_SHR:
+            case IR_EQ: case IR_NE: case IR_LT: case IR_LE:
+            case IR_GETINDEX: visit(in.a); visit(in.b); break;
+            case IR_NEG:
+            case IR_NOT:
+            case IR_GETFIELD:
+            case IR_TAG:
+            case IR_PAYLOAD:
+            case IR_BRANCH:
+            case IR_SWITCH: visit(in.a); break;
+            case IR_SETFIELD: visit(in.a); visit(in.c); break;
+            case IR_SETINDEX: visit(in.a); visit(in.b); visit(in.c); break;
+            case IR_VARIANT:
+            case IR_RETURN: if(in.a != irNone) visit(in.a); break;
+            default: break;
+        }
+    }
+
+    //appends an instruction to the function without placing it in a block
+    uint32_t addInstruction(IrFunction& function, const IrInstruction& instruction, uint32_t line);
+    //rewrites every use of a value whose entry in `replacement` is not irNone. replacements may
+    //chain, and values that are replaced are not removed from their blocks
+    void replaceUses(IrFunction& function, const std::vector<uint32_t>& replacement);
+    //drops `from` from the predecessors of `to` and from the phis there
+    void removeEdge(IrFunction& function, uint32_t from, uint32_t to);
+    //deletes blocks that cannot be reached from the entry and renumbers the rest in order
+    void removeUnreachableBlocks(IrFunction& function);
+
+    //blocks the terminator of `block` can jump to, each once; returns how many were written to `out`
+    size_t successors(const IrFunction& function, uint32_t block, std::vector<uint32_t>& out);
+    //blocks reachable from the entry, each after all of its predecessors outside loops
+    std::vector<uint32_t> reversePostorder(const IrFunction& function);
+    //immediate dominator of every block; the entry's is itself and unreachable blocks' irNone
+    std::vector<uint32_t> dominators(const IrFunction& function);
+    //whether the direct call `call` in `block` is a tail call: the function returns its result and
+    //does nothing else after it, there or in a block it jumps to that only returns. lowering
+    //emits `return f(x)` in this shape, and the backends compile such calls as jumps
+    bool isTailCall(const IrFunction& function, uint32_t block, uint32_t call);
+
+    //checks the structural and SSA invariants of every function: one terminator per block,
+    //phis first with one entry per predecessor, predecessor lists that match the terminators,
+    //operands in range and every use dominated by its definition. `error` describes the first
+    //violation found
+    bool verifyIr(const IrModule& module, std::string& error);
+    void dumpIr(const IrFunction& function, const IrModule& module, FILE* out);
+    void dumpIr(const IrModule& module, FILE* out);
+}
+#endif
@@ -0,0 +1,1212 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include "jit.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <cmath>
+#include <sys/mman.h>
+#define PILAF_JIT
+#endif
+
+namespace pilaf {
+    //calls compiled code may nest; the interpreter never asks for more than its own frame limit
+    static const size_t maxDepth = 1 << 16;
+    //bytes a compiled function's frame may take, return address included, so that the deepest
+    //recursion fits the stack compiled code runs on
+    static const int32_t maxFrameBytes = 1024;
+    static const size_t jitStackSize = maxDepth * maxFrameBytes + (1 << 16);
+
+    //the kind of values of type `t`, or false when machine code does not handle them
+    static bool kindOf(const std::shared_ptr<Ty>& t, JitKind& kind)
+    {
+        if(t->type != Ty::TY_BASIC) return false;
+        auto& name = static_cast<TyBasic*>(t.get())->t;
+        if(name == "Int") kind = JIT_INT;
+        else if(name == "Bool") kind = JIT_BOOL;
+        else if(name == "Double") kind = JIT_DOUBLE;
+        else return false;
+        return true;
+    }
+
+    //built-ins that compiled code computes in place
+    enum JitNative {
+        JIT_NOT_NATIVE,
+        JIT_SQRT,
+        JIT_TO_DOUBLE,
+        JIT_TO_INT
+    };
+
+    static JitNative nativeOf(const IrFunction& f)
+    {
+        if(!f.external || f.params.size() != 1) return JIT_NOT_NATIVE;
+        if(f.name == "sqrt") return JIT_SQRT;
+        if(f.name == "toDouble") return JIT_TO_DOUBLE;
+        if(f.name == "toInt") return JIT_TO_INT;
+        return JIT_NOT_NATIVE;
+    }
+
+    //whether the arguments fit the registers the calling convention passes them in
+    static bool fitsRegisters(const std::vector<JitKind>& kinds)
+    {
+        size_t doubles = std::count(kinds.begin(), kinds.end(), JIT_DOUBLE);
+        return kinds.size() - doubles <= 6 && doubles <= 8;
+    }
+
+    //functions stop qualifying when something they call does not
+    static void propagateIneligibility(const IrModule& ir, std::vector<bool>& eligible)
+    {
+        for(bool changed = true; changed;)
+        {
+            changed = false;
+            for(uint32_t f = 0; f < ir.functions.size(); f++)
+            {
+                if(!eligible[f]) continue;
+                for(auto& in : ir.functions[f].instructions)
+                {
+                    if(in.op != IR_CALL || ir.functions[in.c].external || eligible[in.c]) continue;
+                    eligible[f] = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    Jit::Jit(const IrModule& ir)
+    : ir(ir), stack(nullptr), stackSize(0), context{0, 0, 0}
+    {
+        auto count = ir.functions.size();
+        kinds.resize(count);
+        results.assign(count, JIT_INT);
+        code.assign(count, nullptr);
+        stubs.assign(count, nullptr);
+        eligible.assign(count, false);
+        for(uint32_t f = 0; f < count; f++) eligible[f] = qualifiesAlone(f);
+        propagateIneligibility(ir, eligible);
+    }
+
+    bool Jit::supported()
+    {
+    #ifdef PILAF_JIT
+        return true;
+    #else
+        return false;
+    #endif
+    }
+
+    bool Jit::qualifiesAlone(uint32_t index)
+    {
+        if(!supported()) return false;
+        auto& f = ir.functions[index];
+        if(f.external || f.blocks.empty()) return false;
+        for(auto p : f.params)
+        {
+            JitKind k;
+            if(!kindOf(ir.types[p], k)) return false;
+            kinds[index].push_back(k);
+        }
+        if(!fitsRegisters(kinds[index]) || !kindOf(ir.types[f.result], results[index])) return false;
+        //-1 for values machine code does not handle
+        auto kind = [&](uint32_t v)
+        {
+            JitKind k;
+            return kindOf(ir.types[f.instructions[v].type], k) ? (int)k : -1;
+        };
+        for(auto b : reversePostorder(f))
+        {
+            for(auto i : f.blocks[b].instructions)
+            {
+                auto& in = f.instructions[i];
+                JitKind k = JIT_INT;
+                if(definesValue(in.op) && !kindOf(ir.types[in.type], k)) return false;
+                switch(in.op)
+                {
+                    case IR_CONST:
+                    {
+                        auto c = ir.constants[in.a].kind;
+                        if(!(c == CONST_INT && k == JIT_INT) && !(c == CONST_BOOL && k == JIT_BOOL) && !(c == CONST_DOUBLE && k == JIT_DOUBLE)) return false;
+                        break;
+                    }
+                    case IR_PARAM: break;
+                    case IR_PHI:
+                    {
+                        for(uint32_t p = 0; p < in.b; p++) if(kind(f.operands[in.a + 2 * p + 1]) != k) return false;
+                        break;
+                    }
+                    case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+                    {
+                        if(k == JIT_BOOL || kind(in.a) != k || kind(in.b) != k) return false;
+                        break;
+                    }
+                    case IR_BAND: case IR_BOR: case IR_BXOR: case IR_SHL: case IR_SHR:
+                    {
+                        if(k != JIT_INT || kind(in.a) != k || kind(in.b) != k) return false;
+                        break;
+                    }
+                    case IR_EQ: case IR_NE:
+                    {
+                        if(k != JIT_BOOL || kind(in.a) < 0 || kind(in.a) != kind(in.b)) return false;
+                        break;
+                    }
+                    case IR_LT: case IR_LE:
+                    {
+                        if(k != JIT_BOOL || kind(in.a) < 0 || kind(in.a) != kind(in.b) || kind(in.a) == JIT_BOOL) return false;
+                        break;
+                    }
+                    case IR_NEG:
+                    {
+                        if(k == JIT_BOOL || kind(in.a) != k) return false;
+                        break;
+                    }
+                    case IR_NOT:
+                    {
+                        if(k != JIT_BOOL || kind(in.a) != k) return false;
+                        break;
+                    }
+                    case IR_CALL:
+                    {
+                        auto& callee = ir.functions[in.c];
+                        if(callee.external)
+                        {
+                            auto native = nativeOf(callee);
+                            if(native == JIT_NOT_NATIVE || in.b != 1) return false;
+                            auto arg = kind(f.operands[in.a]);
+                            if(arg < 0 || arg == JIT_BOOL || k != (native == JIT_TO_INT ? JIT_INT : JIT_DOUBLE)) return false;
+                            if(native == JIT_SQRT && arg != JIT_DOUBLE) return false;
+                            break;
+                        }
+                        if(in.b != callee.params.size()) return false;
+                        std::vector<JitKind> args;
+                        for(uint32_t p = 0; p < in.b; p++)
+                        {
+                            JitKind expected;
+                            if(!kindOf(ir.types[callee.params[p]], expected) || kind(f.operands[in.a + p]) != expected) return false;
+                            args.push_back(expected);
+                        }
+                        if(!fitsRegisters(args)) return false;
+                        break;
+                    }
+                    case IR_JUMP: break;
+                    case IR_BRANCH:
+                    {
+                        if(kind(in.a) != JIT_BOOL) return false;
+                        break;
+                    }
+                    case IR_SWITCH:
+                    {
+                        if(kind(in.a) != JIT_INT) return false;
+                        break;
+                    }
+                    case IR_RETURN:
+                    {
+                        if(in.a == irNone || kind(in.a) != results[index]) return false;
+                        break;
+                    }
+                    default: return false;
+                }
+            }
+        }
+        return true;
+    }
+
+#ifdef PILAF_JIT
+    enum Register : uint8_t { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+    //low nibble of the jcc and setcc opcodes
+    enum Condition : uint8_t {
+        CC_B = 2,
+        CC_AE = 3,
+        CC_E = 4,
+        CC_NE = 5,
+        CC_A = 7,
+        CC_P = 10,
+        CC_NP = 11,
+        CC_L = 12,
+        CC_LE = 14
+    };
+
+    //encodes the few x86-64 instructions the compiler needs. every operation is 64 bits wide and
+    //memory operands are [base + disp32]. branches return where their rel32 is, for patch()
+    struct Assembler {
+        std::vector<uint8_t> code;
+
+        void byte(uint8_t b) { code.push_back(b); }
+        void dword(uint32_t d) { for(int k = 0; k < 4; k++) byte((uint8_t)(d >> (8 * k))); }
+        void qword(uint64_t q) { for(int k = 0; k < 8; k++) byte((uint8_t)(q >> (8 * k))); }
+        void rex(bool wide, unsigned reg, unsigned base)
+        {
+            uint8_t r = 0x40 | (wide ? 8 : 0) | ((reg >> 3) & 1) << 2 | ((base >> 3) & 1);
+            if(r != 0x40) byte(r);
+        }
+        void direct(unsigned reg, unsigned rm) { byte(0xc0 | (reg & 7) << 3 | (rm & 7)); }
+        void memory(unsigned reg, unsigned base, int32_t disp)
+        {
+            byte(0x80 | (reg & 7) << 3 | (base & 7));
+            if((base & 7) == RSP) byte(0x24);
+            dword((uint32_t)disp);
+        }
+
+        void mov(Register dst, Register src)
+        {
+            if(dst == src) return;
+            rex(true, src, dst);
+            byte(0x89);
+            direct(src, dst);
+        }
+        void movImm(Register dst, uint64_t imm)
+        {
+            rex(true, 0, dst);
+            if((int64_t)imm == (int32_t)imm)
+            {
+                byte(0xc7);
+                direct(0, dst);
+                dword((uint32_t)imm);
+            }
+            else
+            {
+                byte(0xb8 + (dst & 7));
+                qword(imm);
+            }
+        }
+        void load(Register dst, Register base, int32_t disp) { rex(true, dst, base); byte(0x8b); memory(dst, base, disp); }
+        void store(Register base, int32_t disp, Register src) { rex(true, src, base); byte(0x89); memory(src, base, disp); }
+        void lea(Register dst, Register base, int32_t disp) { rex(true, dst, base); byte(0x8d); memory(dst, base, disp); }
+        //op is the r/m, reg form: 0x01 add, 0x09 or, 0x21 and, 0x29 sub, 0x31 xor, 0x39 cmp, 0x85 test
+        void alu(uint8_t op, Register dst, Register src) { rex(true, src, dst); byte(op); direct(src, dst); }
+        //ext is the /digit of the immediate group: 0 add, 5 sub, 6 xor, 7 cmp
+        void aluImm(unsigned ext, Register dst, int32_t imm)
+        {
+            rex(true, 0, dst);
+            if(imm == (int8_t)imm)
+            {
+                byte(0x83);
+                direct(ext, dst);
+                byte((uint8_t)imm);
+            }
+            else
+            {
+                byte(0x81);
+                direct(ext, dst);
+                dword((uint32_t)imm);
+            }
+        }
+        void aluMemory(unsigned ext, Register base, int32_t disp, int8_t imm) { rex(true, 0, base); byte(0x83); memory(ext, base, disp); byte((uint8_t)imm); }
+        void imul(Register dst, Register src) { rex(true, dst, src); byte(0x0f); byte(0xaf); direct(dst, src); }
+        //ext 3 is neg and 7 idiv
+        void unary(unsigned ext, Register r) { rex(true, 0, r); byte(0xf7); direct(ext, r); }
+        //by cl; ext 4 is shl and 7 sar
+        void shift(unsigned ext, Register r) { rex(true, 0, r); byte(0xd3); direct(ext, r); }
+        void cqo() { byte(0x48); byte(0x99); }
+        //al = condition, then rax = al
+        void setcc(Condition cc) { byte(0x0f); byte(0x90 + cc); byte(0xc0); }
+        void setccCl(Condition cc) { byte(0x0f); byte(0x90 + cc); byte(0xc1); }
+        void andAlCl() { byte(0x20); byte(0xc8); }
+        void orAlCl() { byte(0x08); byte(0xc8); }
+        void zeroExtendAl() { byte(0x0f); byte(0xb6); byte(0xc0); }
+        void storeByte(Register base, int32_t disp, uint8_t imm) { rex(false, 0, base); byte(0xc6); memory(0, base, disp); byte(imm); }
+        void storeDword(Register base, int32_t disp, uint32_t imm) { rex(false, 0, base); byte(0xc7); memory(0, base, disp); dword(imm); }
+        void compareByte(Register base, int32_t disp, uint8_t imm) { rex(false, 0, base); byte(0x80); memory(7, base, disp); byte(imm); }
+        void push(Register r) { if(r >= R8) byte(0x41); byte(0x50 + (r & 7)); }
+        void pop(Register r) { if(r >= R8) byte(0x41); byte(0x58 + (r & 7)); }
+        void ret() { byte(0xc3); }
+        size_t jump() { byte(0xe9); dword(0); return code.size() - 4; }
+        size_t jumpIf(Condition cc) { byte(0x0f); byte(0x80 + cc); dword(0); return code.size() - 4; }
+        size_t call() { byte(0xe8); dword(0); return code.size() - 4; }
+        void callAbsolute(const void* target) { movImm(RAX, (uint64_t)(uintptr_t)target); byte(0xff); byte(0xd0); }
+        void jumpAbsolute(const void* target) { movImm(RAX, (uint64_t)(uintptr_t)target); byte(0xff); byte(0xe0); }
+        void patch(size_t at, size_t target)
+        {
+            auto rel = (int32_t)((int64_t)target - (int64_t)(at + 4));
+            memcpy(&code[at], &rel, 4);
+        }
+
+        //scalar double operations. op is 0x10 movsd, 0x51 sqrtsd, 0x58 addsd, 0x59 mulsd, 0x5c subsd
+        //and 0x5e divsd
+        void sse(uint8_t prefix, bool wide, uint8_t op, unsigned reg, unsigned rm) { byte(prefix); rex(wide, reg, rm); byte(0x0f); byte(op); direct(reg, rm); }
+        void sseMemory(uint8_t op, unsigned reg, Register base, int32_t disp) { byte(0xf2); rex(false, reg, base); byte(0x0f); byte(op); memory(reg, base, disp); }
+        void movsd(unsigned dst, unsigned src) { if(dst != src) sse(0xf2, false, 0x10, dst, src); }
+        void loadsd(unsigned dst, Register base, int32_t disp) { sseMemory(0x10, dst, base, disp); }
+        void storesd(Register base, int32_t disp, unsigned src) { sseMemory(0x11, src, base, disp); }
+        void arithsd(uint8_t op, unsigned dst, unsigned src) { sse(0xf2, false, op, dst, src); }
+        void ucomisd(unsigned x, unsigned y) { sse(0x66, false, 0x2e, x, y); }
+        void cvtsi2sd(unsigned dst, Register src) { sse(0xf2, true, 0x2a, dst, src); }
+        void cvttsd2si(Register dst, unsigned src) { sse(0xf2, true, 0x2c, dst, src); }
+        void movqToXmm(unsigned dst, Register src) { sse(0x66, true, 0x6e, dst, src); }
+        void movqFromXmm(Register dst, unsigned src) { sse(0x66, true, 0x7e, src, dst); }
+        //flips the sign bit
+        void flipSign(Register r) { rex(true, 0, r); byte(0x0f); byte(0xba); direct(7, r); byte(63); }
+    };
+
+    //a value's location: general register loc, xmm register loc - xmmBase or stack slot loc - slotBase
+    static const int32_t xmmBase = 16;
+    static const int32_t slotBase = 32;
+    static bool isGpr(int32_t loc) { return loc < xmmBase; }
+    static bool isXmm(int32_t loc) { return loc >= xmmBase && loc < slotBase; }
+
+    //rax, rcx, rdx, r11, xmm14 and xmm15 are scratch; rbp holds the frame
+    static const Register callerSaved[] = {RSI, RDI, R8, R9, R10};
+    static const Register calleeSaved[] = {RBX, R12, R13, R14, R15};
+    static const Register intArgs[] = {RDI, RSI, RDX, RCX, R8, R9};
+    static const unsigned xmmRegisters = 14;
+
+    //compiles the functions of one batch into the same code buffer
+    struct JitCompiler {
+        Jit& jit;
+        Assembler& a;
+        //where each function of the batch starts, and calls to them to patch once all are placed
+        std::vector<size_t>& starts;
+        std::vector<std::pair<size_t, uint32_t>>& calls;
+
+        const IrFunction* function = nullptr;
+        std::vector<uint32_t> order;
+        std::vector<int32_t> locations;
+        std::vector<Register> saved;
+        int32_t savedBytes = 0;
+        int32_t frameBytes = 0;
+        uint32_t staging = 0;
+        std::vector<size_t> labels;
+        //(rel32, block) jumps, jumps to the epilogue, and (rel32, site) failed checks
+        std::vector<std::pair<size_t, uint32_t>> jumps;
+        std::vector<size_t> exits;
+        std::vector<std::pair<size_t, uint32_t>> failures;
+
+        JitCompiler(Jit& jit, Assembler& a, std::vector<size_t>& starts, std::vector<std::pair<size_t, uint32_t>>& calls)
+        : jit(jit), a(a), starts(starts), calls(calls) {}
+
+        bool isDouble(uint32_t v) { JitKind k = JIT_INT; kindOf(jit.ir.types[function->instructions[v].type], k); return k == JIT_DOUBLE; }
+        bool isRealCall(const IrInstruction& in)
+        {
+            if(in.op == IR_CALL) return !jit.ir.functions[in.c].external;
+            return in.op == IR_MOD && isDouble(in.a);
+        }
+
+        //one interval per value, from its definition to its last use, covering the blocks it is live through
+        bool allocate()
+        {
+            auto& f = *function;
+            order = reversePostorder(f);
+            auto count = f.instructions.size();
+            std::vector<uint32_t> position(count, irNone);
+            std::vector<uint32_t> blockStart(f.blocks.size(), 0), blockEnd(f.blocks.size(), 0);
+            uint32_t pos = 0;
+            for(auto b : order)
+            {
+                blockStart[b] = pos;
+                for(auto i : f.blocks[b].instructions)
+                {
+                    position[i] = pos;
+                    pos += 2;
+                }
+                blockEnd[b] = pos - 1;
+            }
+
+            std::vector<std::vector<bool>> liveIn(f.blocks.size(), std::vector<bool>(count, false));
+            std::vector<std::vector<bool>> liveOut = liveIn;
+            std::vector<uint32_t> next;
+            for(bool changed = true; changed;)
+            {
+                changed = false;
+                for(auto b = order.rbegin(); b != order.rend(); ++b)
+                {
+                    std::vector<bool> live(count, false);
+                    auto n = successors(f, *b, next);
+                    for(size_t s = 0; s < n; s++)
+                    {
+                        for(size_t v = 0; v < count; v++) if(liveIn[next[s]][v]) live[v] = true;
+                        for(auto i : f.blocks[next[s]].instructions)
+                        {
+                            auto& in = f.instructions[i];
+                            if(in.op != IR_PHI) break;
+                            for(uint32_t p = 0; p < in.b; p++) if(f.operands[in.a + 2 * p] == *b) live[f.operands[in.a + 2 * p + 1]] = true;
+                        }
+                    }
+                    if(live != liveOut[*b])
+                    {
+                        liveOut[*b] = live;
+                        changed = true;
+                    }
+                    auto& instructions = f.blocks[*b].instructions;
+                    for(auto i = instructions.rbegin(); i != instructions.rend(); ++i)
+                    {
+                        live[*i] = false;
+                        if(f.instructions[*i].op == IR_PHI) continue;
+                        forEachOperand(f, *i, [&](const uint32_t& v) { live[v] = true; });
+                    }
+                    if(live != liveIn[*b])
+                    {
+                        liveIn[*b] = live;
+                        changed = true;
+                    }
+                }
+            }
+
+            std::vector<uint32_t> start(count, irNone), end(count, 0);
+            auto extend = [&](uint32_t v, uint32_t at)
+            {
+                if(start[v] == irNone || at < start[v]) start[v] = at;
+                if(at > end[v]) end[v] = at;
+            };
+            std::vector<uint32_t> callPositions;
+            for(auto b : order)
+            {
+                for(auto i : f.blocks[b].instructions)
+                {
+                    auto& in = f.instructions[i];
+                    if(definesValue(in.op)) extend(i, in.op == IR_PARAM ? 0 : in.op == IR_PHI ? blockStart[b] : position[i]);
+                    if(isRealCall(in)) callPositions.push_back(position[i]);
+                    if(in.op == IR_CALL && !jit.ir.functions[in.c].external) staging = std::max(staging, in.b);
+                    if(in.op == IR_PHI)
+                    {
+                        for(uint32_t p = 0; p < in.b; p++)
+                        {
+                            auto from = f.operands[in.a + 2 * p];
+                            if(position[f.operands[in.a + 2 * p + 1]] != irNone && !f.blocks[from].instructions.empty() && position[f.blocks[from].instructions.back()] != irNone)
+                            {
+                                extend(f.operands[in.a + 2 * p + 1], blockEnd[from]);
+                            }
+                        }
+                    }
+                    else forEachOperand(f, i, [&](const uint32_t& v) { extend(v, position[i]); });
+                }
+                for(size_t v = 0; v < count; v++)
+                {
+                    if(liveIn[b][v]) extend((uint32_t)v, blockStart[b]);
+                    if(liveOut[b][v]) extend((uint32_t)v, blockEnd[b]);
+                }
+            }
+
+            struct Interval {
+                uint32_t value;
+                uint32_t start;
+                uint32_t end;
+                bool crosses;
+                bool isDouble;
+            };
+            std::vector<Interval> intervals;
+            for(uint32_t v = 0; v < count; v++)
+            {
+                if(start[v] == irNone || !definesValue(f.instructions[v].op)) continue;
+                auto call = std::upper_bound(callPositions.begin(), callPositions.end(), start[v]);
+                bool crosses = call != callPositions.end() && *call < end[v];
+                intervals.push_back(Interval{v, start[v], end[v], crosses, isDouble(v)});
+            }
+            std::stable_sort(intervals.begin(), intervals.end(), [](const Interval& x, const Interval& y) { return x.start < y.start; });
+
+            locations.assign(count, -1);
+            std::vector<bool> taken(slotBase, false);
+            std::vector<uint32_t> freeSlots;
+            uint32_t slots = 0;
+            std::vector<const Interval*> active;
+            std::vector<bool> usedSaved(16, false);
+            auto spill = [&](uint32_t v)
+            {
+                uint32_t slot;
+                if(!freeSlots.empty())
+                {
+                    slot = freeSlots.back();
+                    freeSlots.pop_back();
+                }
+                else slot = slots++;
+                locations[v] = slotBase + (int32_t)slot;
+            };
+            auto acceptable = [](const Interval& i, int32_t loc)
+            {
+                if(i.isDouble) return isXmm(loc);
+                if(!isGpr(loc)) return false;
+                return !i.crosses || std::find(std::begin(calleeSaved), std::end(calleeSaved), (Register)loc) != std::end(calleeSaved);
+            };
+            for(auto& interval : intervals)
+            {
+                for(size_t k = 0; k < active.size();)
+                {
+                    if(active[k]->end >= interval.start)
+                    {
+                        k++;
+                        continue;
+                    }
+                    auto loc = locations[active[k]->value];
+                    if(loc >= slotBase) freeSlots.push_back((uint32_t)(loc - slotBase));
+                    else taken[loc] = false;
+                    active.erase(active.begin() + k);
+                }
+                int32_t chosen = -1;
+                if(interval.isDouble)
+                {
+                    if(!interval.crosses) for(unsigned x = 0; x < xmmRegisters && chosen < 0; x++) if(!taken[xmmBase + x]) chosen = xmmBase + (int32_t)x;
+                }
+                else
+                {
+                    if(!interval.crosses) for(auto r : callerSaved) if(chosen < 0 && !taken[r]) chosen = r;
+                    for(auto r : calleeSaved) if(chosen < 0 && !taken[r]) chosen = r;
+                }
+                if(chosen < 0 && !(interval.isDouble && interval.crosses))
+                {
+                    //take the register of the interval that ends last when that is later than this one
+                    const Interval* victim = nullptr;
+                    for(auto other : active)
+                    {
+                        auto loc = locations[other->value];
+                        if(loc < slotBase && acceptable(interval, loc) && other->end > interval.end && (victim == nullptr || other->end > victim->end)) victim = other;
+                    }
+                    if(victim != nullptr)
+                    {
+                        chosen = locations[victim->value];
+                        spill(victim->value);
+                    }
+                }
+                if(chosen < 0) spill(interval.value);
+                else
+                {
+                    locations[interval.value] = chosen;
+                    taken[chosen] = true;
+                    if(isGpr(chosen)) usedSaved[chosen] = true;
+                }
+                active.push_back(&interval);
+            }
+
+            saved.clear();
+            for(auto r : calleeSaved) if(usedSaved[r]) saved.push_back(r);
+            savedBytes = 8 * (int32_t)saved.size();
+            frameBytes = 8 * (int32_t)(slots + staging);
+            if((savedBytes + frameBytes) % 16 != 0) frameBytes += 8;
+            //return address and rbp
+            return savedBytes + frameBytes + 16 <= maxFrameBytes;
+        }
+
+        int32_t slotOffset(int32_t loc) { return -(savedBytes + 8 * (loc - slotBase + 1)); }
+
+        //copies between any two locations; r11 carries stack to stack copies
+        void move(int32_t dst, int32_t src)
+        {
+            if(dst == src) return;
+            if(isGpr(dst))
+            {
+                if(isGpr(src)) a.mov((Register)dst, (Register)src);
+                else if(isXmm(src)) a.movqFromXmm((Register)dst, src - xmmBase);
+                else a.load((Register)dst, RBP, slotOffset(src));
+            }
+            else if(isXmm(dst))
+            {
+                if(isGpr(src)) a.movqToXmm(dst - xmmBase, (Register)src);
+                else if(isXmm(src)) a.movsd(dst - xmmBase, src - xmmBase);
+                else a.loadsd(dst - xmmBase, RBP, slotOffset(src));
+            }
+            else
+            {
+                if(isGpr(src)) a.store(RBP, slotOffset(dst), (Register)src);
+                else if(isXmm(src)) a.storesd(RBP, slotOffset(dst), src - xmmBase);
+                else
+                {
+                    a.load(R11, RBP, slotOffset(src));
+                    a.store(RBP, slotOffset(dst), R11);
+                }
+            }
+        }
+
+        //(destination, source) copies that happen at once. a cycle is broken by parking one
+        //destination in rax or xmm14 before it is overwritten
+        void parallelMove(std::vector<std::pair<int32_t, int32_t>> moves)
+        {
+            moves.erase(std::remove_if(moves.begin(), moves.end(), [](const std::pair<int32_t, int32_t>& m) { return m.first == m.second; }), moves.end());
+            while(!moves.empty())
+            {
+                bool progress = false;
+                for(size_t k = 0; k < moves.size(); k++)
+                {
+                    auto dst = moves[k].first;
+                    bool read = false;
+                    for(size_t j = 0; j < moves.size(); j++) if(j != k && moves[j].second == dst) read = true;
+                    if(read) continue;
+                    move(dst, moves[k].second);
+                    moves.erase(moves.begin() + k);
+                    progress = true;
+                    break;
+                }
+                if(progress) continue;
+                auto parked = moves[0].first;
+                int32_t scratch = isXmm(parked) ? xmmBase + 14 : RAX;
+                move(scratch, parked);
+                for(auto& m : moves) if(m.second == parked) m.second = scratch;
+            }
+        }
+
+        //the value in a general register: its own, or `scratch` after loading it
+        Register gpr(uint32_t v, Register scratch)
+        {
+            auto loc = locations[v];
+            if(isGpr(loc)) return (Register)loc;
+            move(scratch, loc);
+            return scratch;
+        }
+        unsigned xmm(uint32_t v, unsigned scratch)
+        {
+            auto loc = locations[v];
+            if(isXmm(loc)) return (unsigned)(loc - xmmBase);
+            move(xmmBase + (int32_t)scratch, loc);
+            return scratch;
+        }
+        //where to compute a value: its own register unless that is `avoid` or it lives on the stack
+        Register target(uint32_t v, Register avoid)
+        {
+            auto loc = locations[v];
+            return isGpr(loc) && loc != avoid ? (Register)loc : RAX;
+        }
+
+        uint32_t site(uint32_t instruction, const char* what)
+        {
+            auto& f = *function;
+            auto origin = instruction < f.origins.size() ? f.origins[instruction] : 0;
+            auto line = instruction < f.lines.size() ? f.lines[instruction] : 0;
+            jit.sites.push_back(Jit::Site{origin != 0 ? f.inlined[origin - 1] : f.name, line, what});
+            return (uint32_t)jit.sites.size() - 1;
+        }
+        void failIf(Condition cc, uint32_t instruction, const char* what)
+        {
+            failures.push_back(std::make_pair(a.jumpIf(cc), site(instruction, what)));
+        }
+
+        std::vector<std::pair<int32_t, int32_t>> edge(uint32_t from, uint32_t to)
+        {
+            auto& f = *function;
+            std::vector<std::pair<int32_t, int32_t>> moves;
+            for(auto i : f.blocks[to].instructions)
+            {
+                auto& in = f.instructions[i];
+                if(in.op != IR_PHI) break;
+                for(uint32_t p = 0; p < in.b; p++)
+                {
+                    if(f.operands[in.a + 2 * p] == from) moves.push_back(std::make_pair(locations[i], locations[f.operands[in.a + 2 * p + 1]]));
+                }
+            }
+            return moves;
+        }
+        void jumpTo(uint32_t block, uint32_t next)
+        {
+            if(block != next) jumps.push_back(std::make_pair(a.jump(), block));
+        }
+
+        void binary(uint32_t i, const IrInstruction& in)
+        {
+            if(isDouble(in.a))
+            {
+                auto x = xmm(in.a, 14);
+                auto y = xmm(in.b, 15);
+                switch(in.op)
+                {
+                    case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV:
+                    {
+                        static const uint8_t ops[] = {0x58, 0x5c, 0x59, 0x5e};
+                        a.movsd(14, x);
+                        a.arithsd(ops[in.op - IR_ADD], 14, y);
+                        move(locations[i], xmmBase + 14);
+                        return;
+                    }
+                    case IR_MOD:
+                    {
+                        a.movsd(14, x);
+                        a.movsd(15, y);
+                        a.movsd(0, 14);
+                        a.movsd(1, 15);
+                        a.callAbsolute((const void*)static_cast<double (*)(double, double)>(std::fmod));
+                        move(locations[i], xmmBase);
+                        return;
+                    }
+                    //unordered comparisons are false, and not equal
+                    case IR_EQ:
+                    case IR_NE:
+                    {
+                        a.ucomisd(x, y);
+                        a.setcc(in.op == IR_EQ ? CC_E : CC_NE);
+                        a.setccCl(in.op == IR_EQ ? CC_NP : CC_P);
+                        if(in.op == IR_EQ) a.andAlCl();
+                        else a.orAlCl();
+                        break;
+                    }
+                    case IR_LT:
+                    case IR_LE:
+                    {
+                        a.ucomisd(y, x);
+                        a.setcc(in.op == IR_LT ? CC_A : CC_AE);
+                        break;
+                    }
+                    default: break;
+                }
+                a.zeroExtendAl();
+                move(locations[i], RAX);
+                return;
+            }
+            switch(in.op)
+            {
+                case IR_DIV:
+                case IR_MOD:
+                {
+                    a.mov(RCX, gpr(in.b, RCX));
+                    a.alu(0x85, RCX, RCX);
+                    failIf(CC_E, i, "integer division by zero");
+                    a.mov(RAX, gpr(in.a, RAX));
+                    //the one quotient that overflows wraps around, as it does in the interpreter
+                    a.aluImm(7, RCX, -1);
+                    auto divide = a.jumpIf(CC_NE);
+                    if(in.op == IR_DIV) a.unary(3, RAX);
+                    else a.movImm(RAX, 0);
+                    auto done = a.jump();
+                    a.patch(divide, a.code.size());
+                    a.cqo();
+                    a.unary(7, RCX);
+                    if(in.op == IR_MOD) a.mov(RAX, RDX);
+                    a.patch(done, a.code.size());
+                    move(locations[i], RAX);
+                    return;
+                }
+                case IR_SHL:
+                case IR_SHR:
+                {
+                    a.mov(RCX, gpr(in.b, RCX));
+                    a.mov(RAX, gpr(in.a, RAX));
+                    a.shift(in.op == IR_SHL ? 4 : 7, RAX);
+                    move(locations[i], RAX);
+                    return;
+                }
+                case IR_EQ: case IR_NE: case IR_LT: case IR_LE:
+                {
+                    static const Condition conditions[] = {CC_E, CC_NE, CC_L, CC_LE};
+                    a.alu(0x39, gpr(in.a, RAX), gpr(in.b, RCX));
+                    a.setcc(conditions[in.op - IR_EQ]);
+                    a.zeroExtendAl();
+                    move(locations[i], RAX);
+                    return;
+                }
+                default:
+                {
+                    auto x = gpr(in.a, RAX);
+                    auto y = gpr(in.b, RCX);
+                    auto d = target(i, y);
+                    a.mov(d, x);
+                    switch(in.op)
+                    {
+                        case IR_ADD: a.alu(0x01, d, y); break;
+                        case IR_SUB: a.alu(0x29, d, y); break;
+                        case IR_MUL: a.imul(d, y); break;
+                        case IR_BAND: a.alu(0x21, d, y); break;
+                        case IR_BOR: a.alu(0x09, d, y); break;
+                        default: a.alu(0x31, d, y); break;
+                    }
+                    move(locations[i], d);
+                    return;
+                }
+            }
+        }
+
+        void native(uint32_t i, const IrInstruction& in)
+        {
+            auto arg = function->operands[in.a];
+            switch(nativeOf(jit.ir.functions[in.c]))
+            {
+                case JIT_SQRT:
+                {
+                    a.arithsd(0x51, 14, xmm(arg, 14));
+                    move(locations[i], xmmBase + 14);
+                    break;
+                }
+                case JIT_TO_DOUBLE:
+                {
+                    if(isDouble(arg)) move(locations[i], locations[arg]);
+                    else
+                    {
+                        a.cvtsi2sd(14, gpr(arg, RAX));
+                        move(locations[i], xmmBase + 14);
+                    }
+                    break;
+                }
+                default:
+                {
+                    if(!isDouble(arg))
+                    {
+                        move(locations[i], locations[arg]);
+                        break;
+                    }
+                    //the conversion gives the smallest Int for anything out of range, which is
+                    //itself out of range for the interpreter
+                    a.cvttsd2si(RAX, xmm(arg, 14));
+                    a.movImm(RCX, (uint64_t)INT64_MIN);
+                    a.alu(0x39, RAX, RCX);
+                    failIf(CC_E, i, "toInt of a number outside the range of Int");
+                    move(locations[i], RAX);
+                    break;
+                }
+            }
+        }
+
+        //the arguments go through the staging slots at the bottom of the frame, so that none is
+        //overwritten before it is read
+        void stage(const IrInstruction& in)
+        {
+            auto& f = *function;
+            for(uint32_t k = 0; k < in.b; k++)
+            {
+                auto arg = f.operands[in.a + k];
+                if(isDouble(arg)) a.storesd(RSP, 8 * (int32_t)k, xmm(arg, 14));
+                else a.store(RSP, 8 * (int32_t)k, gpr(arg, RAX));
+            }
+        }
+        void loadArguments(const IrInstruction& in)
+        {
+            size_t ints = 0, doubles = 0;
+            for(uint32_t k = 0; k < in.b; k++)
+            {
+                if(isDouble(function->operands[in.a + k])) a.loadsd((unsigned)doubles++, RSP, 8 * (int32_t)k);
+                else a.load(intArgs[ints++], RSP, 8 * (int32_t)k);
+            }
+        }
+        void leave()
+        {
+            a.lea(RSP, RBP, -savedBytes);
+            for(auto r = saved.rbegin(); r != saved.rend(); ++r) a.pop(*r);
+            a.pop(RBP);
+        }
+
+        //the frame is gone before the jump, and the callee returns to this function's caller
+        void tailCall(const IrInstruction& in)
+        {
+            stage(in);
+            loadArguments(in);
+            leave();
+            if(starts[in.c] != SIZE_MAX || jit.code[in.c] == nullptr) calls.push_back(std::make_pair(a.jump(), in.c));
+            else a.jumpAbsolute(jit.code[in.c]);
+        }
+
+        void call(uint32_t i, const IrInstruction& in)
+        {
+            stage(in);
+            auto context = (uint64_t)(uintptr_t)&jit.context;
+            a.movImm(R11, context);
+            a.aluMemory(5, R11, offsetof(Jit::Context, depth), 1);
+            failIf(CC_E, i, "stack overflow");
+            loadArguments(in);
+            if(starts[in.c] != SIZE_MAX || jit.code[in.c] == nullptr) calls.push_back(std::make_pair(a.call(), in.c));
+            else a.callAbsolute(jit.code[in.c]);
+            a.movImm(R11, context);
+            a.aluMemory(0, R11, offsetof(Jit::Context, depth), 1);
+            a.compareByte(R11, offsetof(Jit::Context, failed), 0);
+            exits.push_back(a.jumpIf(CC_NE));
+            move(locations[i], isDouble(i) ? xmmBase : RAX);
+        }
+
+        bool compile(uint32_t index)
+        {
+            function = &jit.ir.functions[index];
+            auto& f = *function;
+            if(!allocate()) return false;
+            starts[index] = a.code.size();
+            a.push(RBP);
+            a.mov(RBP, RSP);
+            for(auto r : saved) a.push(r);
+            if(frameBytes != 0) a.aluImm(5, RSP, frameBytes);
+            std::vector<std::pair<int32_t, int32_t>> params;
+            auto& kinds = jit.kinds[index];
+            std::vector<int32_t> incoming;
+            size_t ints = 0, doubles = 0;
+            for(auto k : kinds) incoming.push_back(k == JIT_DOUBLE ? xmmBase + (int32_t)doubles++ : intArgs[ints++]);
+            for(auto b : order)
+            {
+                for(auto i : f.blocks[b].instructions)
+                {
+                    auto& in = f.instructions[i];
+                    if(in.op == IR_PARAM) params.push_back(std::make_pair(locations[i], incoming[in.a]));
+                }
+            }
+            parallelMove(params);
+
+            labels.assign(f.blocks.size(), 0);
+            for(size_t k = 0; k < order.size(); k++)
+            {
+                auto b = order[k];
+                auto next = k + 1 < order.size() ? order[k + 1] : irNone;
+                labels[b] = a.code.size();
+                for(auto i : f.blocks[b].instructions)
+                {
+                    auto& in = f.instructions[i];
+                    switch(in.op)
+                    {
+                        case IR_PARAM:
+                        case IR_PHI: break;
+                        case IR_CONST:
+                        {
+                            auto& c = jit.ir.constants[in.a];
+                            if(isXmm(locations[i]))
+                            {
+                                a.movImm(RAX, c.bits);
+                                move(locations[i], RAX);
+                            }
+                            else
+                            {
+                                auto d = target(i, RAX);
+                                a.movImm(d, c.bits);
+                                move(locations[i], d);
+                            }
+                            break;
+                        }
+                        case IR_NEG:
+                        {
+                            if(isDouble(i))
+                            {
+                                a.movqFromXmm(RAX, xmm(in.a, 14));
+                                a.flipSign(RAX);
+                                move(locations[i], RAX);
+                            }
+                            else
+                            {
+                                auto d = target(i, RAX);
+                                a.mov(d, gpr(in.a, RAX));
+                                a.unary(3, d);
+                                move(locations[i], d);
+                            }
+                            break;
+                        }
+                        case IR_NOT:
+                        {
+                            auto d = target(i, RAX);
+                            a.mov(d, gpr(in.a, RAX));
+                            a.aluImm(6, d, 1);
+                            move(locations[i], d);
+                            break;
+                        }
+                        case IR_CALL:
+                        {
+                            if(jit.ir.functions[in.c].external) native(i, in);
+                            else if(isTailCall(f, b, i)) tailCall(in);
+                            else call(i, in);
+                            break;
+                        }
+                        case IR_JUMP:
+                        {
+                            parallelMove(edge(b, in.a));
+                            jumpTo(in.a, next);
+                            break;
+                        }
+                        case IR_BRANCH:
+                        {
+                            auto condition = gpr(in.a, RAX);
+                            a.alu(0x85, condition, condition);
+                            auto onTrue = edge(b, in.b);
+                            auto onFalse = edge(b, in.c);
+                            if(onFalse.empty())
+                            {
+                                jumps.push_back(std::make_pair(a.jumpIf(CC_E), in.c));
+                                parallelMove(onTrue);
+                                jumpTo(in.b, next);
+                            }
+                            else if(onTrue.empty())
+                            {
+                                jumps.push_back(std::make_pair(a.jumpIf(CC_NE), in.b));
+                                parallelMove(onFalse);
+                                jumpTo(in.c, next);
+                            }
+                            else
+                            {
+                                auto otherwise = a.jumpIf(CC_E);
+                                parallelMove(onTrue);
+                                jumpTo(in.b, irNone);
+                                a.patch(otherwise, a.code.size());
+                                parallelMove(onFalse);
+                                jumpTo(in.c, next);
+                            }
+                            break;
+                        }
+                        case IR_SWITCH:
+                        {
+                            //a compare per case, the case's copies for its phis behind it
+                            auto value = gpr(in.a, RAX);
+                            for(uint32_t k = 0; k < in.c; k++)
+                            {
+                                auto bits = jit.ir.constants[f.operands[in.b + 1 + 2 * k]].bits;
+                                auto target = f.operands[in.b + 2 + 2 * k];
+                                if((int64_t)bits == (int32_t)bits) a.aluImm(7, value, (int32_t)bits);
+                                else
+                                {
+                                    a.movImm(RCX, bits);
+                                    a.alu(0x39, value, RCX);
+                                }
+                                auto moves = edge(b, target);
+                                if(moves.empty())
+                                {
+                                    jumps.push_back(std::make_pair(a.jumpIf(CC_E), target));
+                                    continue;
+                                }
+                                auto otherwise = a.jumpIf(CC_NE);
+                                parallelMove(moves);
+                                jumpTo(target, irNone);
+                                a.patch(otherwise, a.code.size());
+                            }
+                            parallelMove(edge(b, f.operands[in.b]));
+                            jumpTo(f.operands[in.b], next);
+                            break;
+                        }
+                        case IR_RETURN:
+                        {
+                            move(isDouble(in.a) ? xmmBase : RAX, locations[in.a]);
+                            if(next != irNone) exits.push_back(a.jump());
+                            break;
+                        }
+                        default: binary(i, in); break;
+                    }
+                }
+            }
+
+            //failed checks and calls leave through the epilogue too, with whatever is in rax
+            auto epilogue = a.code.size();
+            leave();
+            a.ret();
+            for(auto& failure : failures)
+            {
+                a.patch(failure.first, a.code.size());
+                a.movImm(R11, (uint64_t)(uintptr_t)&jit.context);
+                a.storeDword(R11, offsetof(Jit::Context, site), failure.second);
+                a.storeByte(R11, offsetof(Jit::Context, failed), 1);
+                exits.push_back(a.jump());
+            }
+            for(auto at : exits) a.patch(at, epilogue);
+            for(auto& j : jumps) a.patch(j.first, labels[j.second]);
+            return true;
+        }
+
+        //uint64_t stub(const uint64_t* args, void* stack) switches to `stack`, calls the function
+        //with the arguments in their registers and returns the bits of its result
+        void stub(uint32_t index)
+        {
+            a.push(RBP);
+            a.mov(RBP, RSP);
+            a.push(RBX);
+            a.push(R12);
+            a.mov(RBX, RSP);
+            a.mov(RSP, RSI);
+            a.mov(R11, RDI);
+            size_t ints = 0, doubles = 0;
+            auto& kinds = jit.kinds[index];
+            for(size_t k = 0; k < kinds.size(); k++)
+            {
+                if(kinds[k] == JIT_DOUBLE) a.loadsd((unsigned)doubles++, R11, 8 * (int32_t)k);
+                else a.load(intArgs[ints++], R11, 8 * (int32_t)k);
+            }
+            if(starts[index] != SIZE_MAX) calls.push_back(std::make_pair(a.call(), index));
+            else a.callAbsolute(jit.code[index]);
+            if(jit.results[index] == JIT_DOUBLE) a.movqFromXmm(RAX, 0);
+            a.mov(RSP, RBX);
+            a.pop(R12);
+            a.pop(RBX);
+            a.pop(RBP);
+            a.ret();
+        }
+    };
+#endif
+
+    Jit::~Jit()
+    {
+    #ifdef PILAF_JIT
+        for(auto& region : regions) munmap(region.first, region.second);
+        if(stack != nullptr) munmap(stack, stackSize);
+    #endif
+    }
+
+    bool Jit::compile(uint32_t function)
+    {
+        if(!qualifies(function)) return false;
+        if(compiled(function)) return true;
+    #ifdef PILAF_JIT
+        if(stack == nullptr)
+        {
+            //only the pages the recursion reaches are ever backed
+            auto mapped = mmap(nullptr, jitStackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if(mapped == MAP_FAILED) return false;
+            stack = mapped;
+            stackSize = jitStackSize;
+        }
+        //everything the function reaches that is not compiled yet goes in the same batch
+        std::vector<uint32_t> batch{function};
+        std::vector<bool> seen(ir.functions.size(), false);
+        seen[function] = true;
+        for(size_t k = 0; k < batch.size(); k++)
+        {
+            for(auto& in : ir.functions[batch[k]].instructions)
+            {
+                if(in.op != IR_CALL || ir.functions[in.c].external || seen[in.c] || compiled(in.c)) continue;
+                seen[in.c] = true;
+                batch.push_back(in.c);
+            }
+        }
+        Assembler a;
+        std::vector<size_t> starts(ir.functions.size(), SIZE_MAX);
+        std::vector<std::pair<size_t, uint32_t>> calls;
+        auto siteCount = sites.size();
+        for(auto f : batch)
+        {
+            JitCompiler compiler(*this, a, starts, calls);
+            if(!compiler.compile(f))
+            {
+                //a frame too big for the stack rules the function out, and its callers with it
+                eligible[f] = false;
+                propagateIneligibility(ir, eligible);
+                sites.resize(siteCount);
+                return false;
+            }
+        }
+        std::vector<size_t> stubStarts;
+        for(auto f : batch)
+        {
+            stubStarts.push_back(a.code.size());
+            JitCompiler(*this, a, starts, calls).stub(f);
+        }
+        for(auto& c : calls) a.patch(c.first, starts[c.second]);
+
+        size_t size = (a.code.size() + 4095) & ~(size_t)4095;
+        auto mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(mapped == MAP_FAILED)
+        {
+            sites.resize(siteCount);
+            return false;
+        }
+        memcpy(mapped, a.code.data(), a.code.size());
+        //never writable and executable at once
+        if(mprotect(mapped, size, PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(mapped, size);
+            sites.resize(siteCount);
+            return false;
+        }
+        regions.push_back(std::make_pair(mapped, size));
+        auto base = static_cast<const uint8_t*>(mapped);
+        for(size_t k = 0; k < batch.size(); k++)
+        {
+            code[batch[k]] = base + starts[batch[k]];
+            stubs[batch[k]] = base + stubStarts[k];
+        }
+        return true;
+    #else
+        return false;
+    #endif
+    }
+
+    bool Jit::call(uint32_t function, const uint64_t* args, size_t depth, uint64_t& result)
+    {
+    #ifdef PILAF_JIT
+        context.depth = (int64_t)std::min(depth, maxDepth);
+        context.failed = 0;
+        auto entry = reinterpret_cast<uint64_t (*)(const uint64_t*, void*)>(const_cast<uint8_t*>(stubs[function]));
+        result = entry(args, static_cast<uint8_t*>(stack) + stackSize);
+        if(context.failed == 0) return true;
+        auto& site = sites[context.site];
+        message.clear();
+        if(site.line != 0) message.append("[line ").append(std::to_string(site.line)).append("] ");
+        message.append("runtime error in ").append(site.function).append(": ").append(site.what);
+        return false;
+    #else
+        (void)function;
+        (void)args;
+        (void)depth;
+        (void)result;
+        message = "machine code is not supported on this platform";
+        return false;
+    #endif
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef jit_header
+#define jit_header
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ir.h"
+
+namespace pilaf {
+    //how a value crosses between the interpreter and machine code: as a 64-bit integer, a 0 or 1,
+    //or the bits of a double
+    enum JitKind : uint8_t {
+        JIT_INT,
+        JIT_BOOL,
+        JIT_DOUBLE
+    };
+
+    //compiles functions of a module's SSA form to x86-64 machine code. a function qualifies when
+    //its parameters, its result and every value it computes are Ints, Bools or Doubles, and every
+    //function it calls qualifies too or is sqrt, toDouble or toInt; anything else stays in the
+    //interpreter. values get registers from a linear scan over each function, and compiled
+    //functions call each other and the C library with the System V calling convention, on a stack
+    //of their own. only x86-64 Linux builds generate code; elsewhere nothing qualifies
+    class Jit {
+    public:
+        //what compiled code reports through when it fails
+        struct Context {
+            //calls that may still be nested before the stack overflows
+            int64_t depth;
+            uint8_t failed;
+            uint32_t site;
+        };
+
+        explicit Jit(const IrModule& ir);
+        ~Jit();
+        Jit(const Jit&) = delete;
+        Jit& operator=(const Jit&) = delete;
+
+        static bool supported();
+        bool qualifies(uint32_t function) const { return function < eligible.size() && eligible[function]; }
+        bool compiled(uint32_t function) const { return function < stubs.size() && stubs[function] != nullptr; }
+        //compiles `function` together with the functions it calls that are not compiled yet.
+        //false when it does not qualify
+        bool compile(uint32_t function);
+        const std::vector<JitKind>& params(uint32_t function) const { return kinds[function]; }
+        JitKind result(uint32_t function) const { return results[function]; }
+        //runs a compiled function on the bits of its arguments. `depth` counts the function itself,
+        //so it may nest depth - 1 calls. on a runtime error error() says what went wrong and where,
+        //the way the interpreter would
+        bool call(uint32_t function, const uint64_t* args, size_t depth, uint64_t& result);
+        const std::string& error() const { return message; }
+
+    private:
+        //a check in compiled code that can fail, reported as the instruction it was generated for
+        struct Site {
+            std::string function;
+            uint32_t line;
+            const char* what;
+        };
+
+        const IrModule& ir;
+        std::vector<bool> eligible;
+        std::vector<std::vector<JitKind>> kinds;
+        std::vector<JitKind> results;
+        //where every compiled function starts, and the stub the interpreter enters it through
+        std::vector<const uint8_t*> code;
+        std::vector<const uint8_t*> stubs;
+        std::vector<Site> sites;
+        //mappings holding the generated code
+        std::vector<std::pair<void*, size_t>> regions;
+        void* stack;
+        size_t stackSize;
+        Context context;
+        std::string message;
+
+        bool qualifiesAlone(uint32_t function);
+        friend struct JitCompiler;
+    };
+}
+#endif
@@ -0,0 +1,223 @@
+#include <map>
+#include <mutex>
+#include "kinds.h"
+
+namespace pilaf {
+    const Kind* starKind()
+    {
+        static const Kind star = {Kind::KIND_STAR, nullptr, nullptr};
+        return &star;
+    }
+
+    const Kind* arrowKind(const Kind* from, const Kind* to)
+    {
+        static std::map<std::pair<const Kind*, const Kind*>, std::unique_ptr<Kind>> arrows;
+        //cached module interfaces are decoded on the parser's worker threads
+        static std::mutex arrowLock;
+        std::lock_guard<std::mutex> lock(arrowLock);
+        auto& k = arrows[std::make_pair(from, to)];
+        if(k == nullptr) k.reset(new Kind{Kind::KIND_ARROW, from, to});
+        return k.get();
+    }
+
+    std::string kindToString(const Kind* kind)
+    {
+        if(kind == nullptr) return "";
+        if(kind->type == Kind::KIND_STAR) return "*";
+        auto from = kindToString(kind->from);
+        if(kind->from->type == Kind::KIND_ARROW) from = "(" + from + ")";
+        return from + " -> " + kindToString(kind->to);
+    }
+
+    KindSolver::KindSolver(std::shared_ptr<ScopeNode> scope)
+    : scope(scope), valid(true) {}
+
+    int KindSolver::fresh()
+    {
+        int t = (int)terms.size();
+        terms.push_back(Term{Term::TERM_VAR, t, -1, -1});
+        return t;
+    }
+
+    int KindSolver::star()
+    {
+        int t = (int)terms.size();
+        terms.push_back(Term{Term::TERM_STAR, t, -1, -1});
+        return t;
+    }
+
+    int KindSolver::arrow(int from, int to)
+    {
+        int t = (int)terms.size();
+        terms.push_back(Term{Term::TERM_ARROW, t, from, to});
+        return t;
+    }
+
+    int KindSolver::instantiate(const Kind* kind)
+    {
+        if(kind->type == Kind::KIND_STAR) return star();
+        auto from = instantiate(kind->from);
+        auto to = instantiate(kind->to);
+        return arrow(from, to);
+    }
+
+    int KindSolver::find(int t)
+    {
+        int root = t;
+        while(terms[root].parent != root) root = terms[root].parent;
+        while(terms[t].parent != root)
+        {
+            int next = terms[t].parent;
+            terms[t].parent = root;
+            t = next;
+        }
+        return root;
+    }
+
+    bool KindSolver::occurs(int var, int t)
+    {
+        t = find(t);
+        if(t == var) return true;
+        if(terms[t].type != Term::TERM_ARROW) return false;
+        return occurs(var, terms[t].from) || occurs(var, terms[t].to);
+    }
+
+    bool KindSolver::unify(int a, int b)
+    {
+        a = find(a);
+        b = find(b);
+        if(a == b) return true;
+        if(terms[a].type == Term::TERM_VAR)
+        {
+            if(occurs(a, b)) return false;
+            terms[a].parent = b;
+            return true;
+        }
+        if(terms[b].type == Term::TERM_VAR)
+        {
+            if(occurs(b, a)) return false;
+            terms[b].parent = a;
+            return true;
+        }
+        if(terms[a].type != terms[b].type) return false;
+        if(terms[a].type == Term::TERM_STAR) return true;
+        terms[b].parent = a;
+        return unify(terms[a].from, terms[b].from) && unify(terms[a].to, terms[b].to);
+    }
+
+    int KindSolver::nameKind(Symbol name)
+    {
+        auto it = names.find(name);
+        if(it != names.end()) return it->second;
+        //a struct or union declared earlier already knows its kind
+        const Kind* known = nullptr;
+        auto& text = symbolName(name);
+        for(auto s = scope; s != nullptr && known == nullptr; s = s->parentScope)
+        {
+            auto st = s->structs.find(text);
+            if(st != s->structs.end()) known = st->second->kind;
+            auto un = s->unions.find(text);
+            if(known == nullptr && un != s->unions.end()) known = un->second->kind;
+        }
+        int t = known != nullptr ? instantiate(known) : fresh();
+        names.emplace(name, t);
+        return t;
+    }
+
+    int KindSolver::kindOf(std::shared_ptr<Ty> t)
+    {
+        //functions, arrays, pointers and references are of kind * whatever they hold, so chains
+        //of them are followed in a loop rather than recursed into
+        bool chained = false;
+        for(; t != nullptr; chained = true)
+        {
+            if(t->type == Ty::TY_FUNCTION)
+            {
+                auto f = std::static_pointer_cast<TyFunc>(t);
+                valid &= unify(kindOf(f->in), star());
+                t = f->out;
+            }
+            else if(t->type == Ty::TY_ARRAY) t = std::static_pointer_cast<TyArray>(t)->arrayOf;
+            else if(t->type == Ty::TY_POINTER) t = std::static_pointer_cast<TyPointer>(t)->pointsTo;
+            else if(t->type == Ty::TY_REFERENCE) t = std::static_pointer_cast<TyRef>(t)->refTo;
+            else break;
+        }
+        int k;
+        switch(t == nullptr ? Ty::TY_CONSTRAINTS : t->type)
+        {
+            case Ty::TY_APPLICATION:
+            {
+                auto app = std::static_pointer_cast<TyAppl>(t);
+                k = kindOf(app->applied);
+                for(auto v : app->vars)
+                {
+                    int result = fresh();
+                    valid &= unify(k, arrow(kindOf(v), result));
+                    k = result;
+                }
+                break;
+            }
+            case Ty::TY_TUPLE:
+            {
+                auto tuple = std::static_pointer_cast<TyTuple>(t);
+                for(auto ty : tuple->types)
+                {
+                    valid &= unify(kindOf(ty), star());
+                }
+                k = star();
+                break;
+            }
+            case Ty::TY_BASIC: k = nameKind(std::static_pointer_cast<TyBasic>(t)->id); break;
+            case Ty::TY_VAR:
+            {
+                //inference variables are never interned and are not shared between declarations
+                auto id = std::static_pointer_cast<TyVar>(t)->id;
+                k = id != noSymbol ? nameKind(id) : fresh();
+                break;
+            }
+            default: k = fresh(); break;
+        }
+        if(chained) valid &= unify(k, star());
+        return chained ? star() : k;
+    }
+
+    const Kind* KindSolver::resolve(int t)
+    {
+        t = find(t);
+        switch(terms[t].type)
+        {
+            case Term::TERM_ARROW:
+            {
+                auto from = resolve(terms[t].from);
+                auto to = resolve(terms[t].to);
+                return arrowKind(from, to);
+            }
+            default: return starKind();
+        }
+    }
+
+    void KindSolver::bind(Symbol name)
+    {
+        names[name] = fresh();
+    }
+
+    void KindSolver::constrain(std::shared_ptr<Ty> t)
+    {
+        if(t == nullptr) return;
+        valid &= unify(kindOf(t), star());
+    }
+
+    const Kind* KindSolver::solve(Symbol name)
+    {
+        if(!valid) return nullptr;
+        return resolve(nameKind(name));
+    }
+
+    const Kind* KindSolver::kindOfType(std::shared_ptr<Ty> t)
+    {
+        if(t == nullptr) return nullptr;
+        int k = kindOf(t);
+        if(!valid) return nullptr;
+        return resolve(k);
+    }
+}
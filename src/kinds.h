@@ -0,0 +1,62 @@
+#ifndef kinds_header
+#define kinds_header
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "parser.h"
+
+namespace pilaf {
+    //kinds are interned: two kinds are equal exactly when their pointers are equal.
+    struct Kind {
+        enum KindType {
+            KIND_STAR,
+            KIND_ARROW
+        };
+        KindType type;
+        const Kind* from;
+        const Kind* to;
+    };
+
+    const Kind* starKind();
+    const Kind* arrowKind(const Kind* from, const Kind* to);
+    std::string kindToString(const Kind* kind);
+
+    //infers the kinds of the type names used by one declaration. every type handed to
+    //constrain() must have kind *; names are unified through a union-find over kind
+    //terms, and names already kinded in `scope` contribute their cached kind.
+    class KindSolver {
+        struct Term {
+            enum TermType { TERM_VAR, TERM_STAR, TERM_ARROW };
+            TermType type;
+            int parent;
+            int from;
+            int to;
+        };
+        std::vector<Term> terms;
+        //kind terms of the type names seen so far, by interned name
+        std::unordered_map<Symbol, int> names;
+        std::shared_ptr<ScopeNode> scope;
+        bool valid;
+
+        int fresh();
+        int star();
+        int arrow(int from, int to);
+        int instantiate(const Kind* kind);
+        int find(int t);
+        bool occurs(int var, int t);
+        bool unify(int a, int b);
+        int nameKind(Symbol name);
+        int kindOf(std::shared_ptr<Ty> t);
+        const Kind* resolve(int t);
+    public:
+        KindSolver(std::shared_ptr<ScopeNode> scope);
+        //binds `name` locally, so that it shadows any declaration of the same name in scope
+        void bind(Symbol name);
+        void constrain(std::shared_ptr<Ty> t);
+        //unconstrained kind variables default to *. returns nullptr if the constraints are inconsistent
+        const Kind* solve(Symbol name);
+        const Kind* kindOfType(std::shared_ptr<Ty> t);
+    };
+}
+#endif
@@ -0,0 +1,272 @@
+#include <algorithm>
+#include "layout.h"
+
+namespace pilaf {
+    static uint32_t roundUp(uint32_t n, uint32_t align)
+    {
+        return (n + align - 1) / align * align;
+    }
+
+    static uint32_t alignOf(SlotKind kind)
+    {
+        return std::max(1u, std::min(LayoutEngine::sizeOf(kind), 8u));
+    }
+
+    //the values a slot never holds, starting at `start`: a Bool is 0 or 1, a Char at most
+    //0x10FFFF, a pointer never null and the tag of a tagged value one of the runtime's 8. false
+    //when every bit pattern is a value
+    static bool niche(SlotKind kind, uint64_t& start, uint64_t& count)
+    {
+        switch(kind)
+        {
+            case SLOT_BOOL: start = 2; count = 254; return true;
+            case SLOT_CHAR: start = 0x110000; count = 0x100000000ull - 0x110000; return true;
+            case SLOT_POINTER: start = 0; count = 1; return true;
+            case SLOT_VALUE: start = 8; count = 0x100000000ull - 8; return true;
+            default: return false;
+        }
+    }
+
+    static const char* kindName(SlotKind kind)
+    {
+        switch(kind)
+        {
+            case SLOT_BOOL: return "Bool";
+            case SLOT_INT: return "Int";
+            case SLOT_FLOAT: return "Float";
+            case SLOT_DOUBLE: return "Double";
+            case SLOT_CHAR: return "Char";
+            case SLOT_POINTER: return "pointer";
+            case SLOT_VALUE: return "tagged value";
+            default: return "nothing";
+        }
+    }
+
+    LayoutEngine::LayoutEngine(const IrModule& module)
+    : module(module), declared(module.layouts.size())
+    {
+        for(uint32_t l = 0; l < module.layouts.size(); l++)
+        {
+            auto& layout = module.layouts[l];
+            if(!layout.name.empty()) named.emplace(layout.name, l);
+            else if(!layout.isUnion) tuples.emplace(layout.size, l);
+        }
+    }
+
+    uint32_t LayoutEngine::sizeOf(SlotKind kind)
+    {
+        switch(kind)
+        {
+            case SLOT_BOOL: return 1;
+            case SLOT_FLOAT:
+            case SLOT_CHAR: return 4;
+            case SLOT_INT:
+            case SLOT_DOUBLE:
+            case SLOT_POINTER: return 8;
+            case SLOT_VALUE: return 16;
+            default: return 0;
+        }
+    }
+
+    SlotKind LayoutEngine::kindOf(const std::shared_ptr<Ty>& t) const
+    {
+        switch(t->type)
+        {
+            case Ty::TY_BASIC:
+            {
+                auto& name = static_cast<TyBasic*>(t.get())->t;
+                if(name == "Int") return SLOT_INT;
+                if(name == "Double") return SLOT_DOUBLE;
+                if(name == "Float") return SLOT_FLOAT;
+                if(name == "Bool") return SLOT_BOOL;
+                if(name == "Char") return SLOT_CHAR;
+                if(name == "String" || named.count(name) != 0) return SLOT_POINTER;
+                return SLOT_VALUE;
+            }
+            case Ty::TY_APPLICATION:
+            {
+                auto& applied = static_cast<TyAppl*>(t.get())->applied;
+                if(applied->type == Ty::TY_BASIC && named.count(static_cast<TyBasic*>(applied.get())->t) != 0) return SLOT_POINTER;
+                return SLOT_VALUE;
+            }
+            case Ty::TY_FUNCTION:
+            case Ty::TY_TUPLE:
+            case Ty::TY_ARRAY: return SLOT_POINTER;
+            default: return SLOT_VALUE;
+        }
+    }
+
+    uint32_t LayoutEngine::layoutOf(uint32_t type) const
+    {
+        auto& t = module.types[type];
+        if(t->type == Ty::TY_TUPLE)
+        {
+            auto it = tuples.find(static_cast<TyTuple*>(t.get())->types.size());
+            return it == tuples.end() ? irNone : it->second;
+        }
+        const Ty* head = t.get();
+        if(t->type == Ty::TY_APPLICATION) head = static_cast<TyAppl*>(t.get())->applied.get();
+        if(head->type != Ty::TY_BASIC) return irNone;
+        auto it = named.find(static_cast<const TyBasic*>(head)->t);
+        return it == named.end() ? irNone : it->second;
+    }
+
+    DataLayout LayoutEngine::place(const std::vector<SlotKind>& kinds, bool declaredOrder)
+    {
+        DataLayout d{0, 1, kinds, std::vector<uint32_t>(kinds.size(), 0), {}, 0, 0, irNone, 0};
+        for(uint32_t k = 0; k < kinds.size(); k++) d.order.push_back(k);
+        if(!declaredOrder) std::stable_sort(d.order.begin(), d.order.end(), [&](uint32_t x, uint32_t y) { return alignOf(kinds[x]) > alignOf(kinds[y]); });
+        uint32_t offset = 0;
+        for(auto k : d.order)
+        {
+            offset = roundUp(offset, alignOf(kinds[k]));
+            d.offsets[k] = offset;
+            offset += sizeOf(kinds[k]);
+            d.align = std::max(d.align, alignOf(kinds[k]));
+        }
+        d.size = roundUp(offset, d.align);
+        return d;
+    }
+
+    DataLayout LayoutEngine::compute(const IrLayout& layout, const std::vector<SlotKind>& kinds) const
+    {
+        if(!layout.isUnion) return place(kinds, layout.declaredOrder);
+        auto members = (uint32_t)kinds.size();
+        DataLayout d{0, 1, kinds, std::vector<uint32_t>(members, 0), {}, 0, 0, irNone, 0};
+        uint32_t largest = 0, valued = 0, dataful = irNone;
+        for(uint32_t k = 0; k < members; k++)
+        {
+            d.order.push_back(k);
+            largest = std::max(largest, sizeOf(kinds[k]));
+            d.align = std::max(d.align, alignOf(kinds[k]));
+            if(sizeOf(kinds[k]) == 0) continue;
+            valued++;
+            dataful = k;
+        }
+        if(layout.declaredOrder)
+        {
+            //as C would have it: an int tag, then a union of the payloads
+            d.tagSize = 4;
+            d.align = std::max(d.align, 4u);
+            auto payload = roundUp(4, d.align);
+            for(auto& offset : d.offsets) offset = payload;
+            d.size = roundUp(payload + largest, d.align);
+            return d;
+        }
+        uint64_t start = 0, count = 0;
+        if(members <= 1 || (valued == 1 && niche(kinds[dataful], start, count) && count >= members - 1))
+        {
+            if(members > 1)
+            {
+                d.dataful = dataful;
+                d.nicheStart = start;
+            }
+            d.size = roundUp(largest, d.align);
+            return d;
+        }
+        d.tagSize = members <= 0x100 ? 1 : members <= 0x10000 ? 2 : 4;
+        d.tagOffset = roundUp(largest, d.tagSize);
+        d.align = std::max(d.align, d.tagSize);
+        d.size = roundUp(d.tagOffset + d.tagSize, d.align);
+        return d;
+    }
+
+    const DataLayout& LayoutEngine::ofLayout(uint32_t l)
+    {
+        if(declared[l] != nullptr) return *declared[l];
+        auto& layout = module.layouts[l];
+        std::vector<SlotKind> kinds;
+        for(size_t k = 0; k < layout.size; k++)
+        {
+            if(layout.isUnion && layout.empty[k]) kinds.push_back(SLOT_VOID);
+            else kinds.push_back(k < layout.types.size() ? kindOf(module.types[layout.types[k]]) : SLOT_VALUE);
+        }
+        declared[l] = std::make_unique<DataLayout>(compute(layout, kinds));
+        return *declared[l];
+    }
+
+    const DataLayout* LayoutEngine::ofType(uint32_t type)
+    {
+        auto it = instances.find(type);
+        if(it != instances.end()) return it->second.get();
+        auto l = layoutOf(type);
+        if(l == irNone) return nullptr;
+        auto& t = module.types[type];
+        auto& layout = module.layouts[l];
+        std::vector<SlotKind> kinds;
+        if(t->type == Ty::TY_TUPLE)
+        {
+            for(auto& field : static_cast<TyTuple*>(t.get())->types) kinds.push_back(kindOf(field));
+        }
+        else
+        {
+            //a field whose declared type is a parameter takes the kind of the argument
+            const std::vector<std::shared_ptr<Ty>>* args = t->type == Ty::TY_APPLICATION ? &static_cast<TyAppl*>(t.get())->vars : nullptr;
+            for(size_t k = 0; k < layout.size; k++)
+            {
+                if(layout.isUnion && layout.empty[k])
+                {
+                    kinds.push_back(SLOT_VOID);
+                    continue;
+                }
+                auto& declaredType = module.types[layout.types[k]];
+                auto kind = kindOf(declaredType);
+                for(size_t p = 0; args != nullptr && declaredType->type == Ty::TY_VAR && p < layout.params.size() && p < args->size(); p++)
+                {
+                    auto& param = module.types[layout.params[p]];
+                    if(param->type == Ty::TY_VAR && static_cast<TyVar*>(param.get())->var == static_cast<TyVar*>(declaredType.get())->var) kind = kindOf((*args)[p]);
+                }
+                kinds.push_back(kind);
+            }
+        }
+        auto& slot = instances[type];
+        slot = std::make_unique<DataLayout>(compute(layout, kinds));
+        return slot.get();
+    }
+
+    void printLayouts(const IrModule& module, FILE* out)
+    {
+        LayoutEngine engine(module);
+        for(uint32_t l = 0; l < module.layouts.size(); l++)
+        {
+            auto& layout = module.layouts[l];
+            auto& d = engine.ofLayout(l);
+            std::string name = layout.name.empty() ? "tuple of " + std::to_string(layout.size) : (layout.isUnion ? "union " : "struct ") + layout.name;
+            for(auto p : layout.params) name += " " + typeToString(module.types[p]);
+            fprintf(out, "%s: %u byte%s, align %u", name.c_str(), d.size, d.size == 1 ? "" : "s", d.align);
+            if(layout.declaredOrder) fprintf(out, ", repr(C)");
+            if(layout.isUnion)
+            {
+                if(d.tagSize != 0) fprintf(out, ", tag at %u (%u byte%s)", d.tagOffset, d.tagSize, d.tagSize == 1 ? "" : "s");
+                else if(d.dataful != irNone) fprintf(out, ", tag in the unused values of %s", symbolName(layout.names[d.dataful]).c_str());
+            }
+            else if(!layout.declaredOrder)
+            {
+                auto unordered = LayoutEngine::place(d.kinds, true).size;
+                if(unordered > d.size) fprintf(out, ", %u bytes smaller than in declaration order", unordered - d.size);
+            }
+            fprintf(out, "\n");
+            uint32_t used = 0;
+            for(auto k : d.order)
+            {
+                auto size = LayoutEngine::sizeOf(d.kinds[k]);
+                used += size;
+                std::string field = layout.name.empty() ? std::to_string(k) : symbolName(layout.names[k]);
+                if(size == 0)
+                {
+                    fprintf(out, "          %s\n", field.c_str());
+                    continue;
+                }
+                std::string type = k < layout.types.size() ? typeToString(module.types[layout.types[k]]) : "a";
+                fprintf(out, "  %6u  %s: %s, %s of %u byte%s\n", d.offsets[k], field.c_str(), type.c_str(), kindName(d.kinds[k]), size, size == 1 ? "" : "s");
+            }
+            if(!layout.isUnion && d.size > used) fprintf(out, "          %u bytes of padding\n", d.size - used);
+            for(uint32_t t = 0; t < module.types.size(); t++)
+            {
+                if(engine.layoutOf(t) != l) continue;
+                auto instance = engine.ofType(t);
+                if(instance->size != d.size) fprintf(out, "  as %s: %u byte%s, align %u\n", typeToString(module.types[t]).c_str(), instance->size, instance->size == 1 ? "" : "s", instance->align);
+            }
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef layout_header
+#define layout_header
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "ir.h"
+
+namespace pilaf {
+    //how a field is held in native code: scalars unboxed, aggregates, strings, arrays and functions
+    //as pointers, and anything whose type is not known statically as a tagged value. the order
+    //matches the C backend's representations and the tags of its runtime
+    enum SlotKind : uint8_t {
+        SLOT_VOID,
+        SLOT_BOOL,
+        SLOT_INT,
+        SLOT_FLOAT,
+        SLOT_DOUBLE,
+        SLOT_CHAR,
+        SLOT_POINTER,
+        SLOT_VALUE
+    };
+
+    //sizes and offsets of the data of a struct, tuple or union, after the header every object has.
+    //the target is a 64-bit one, whose tagged values take 16 bytes
+    struct DataLayout {
+        uint32_t size;
+        uint32_t align;
+        //of every field, or of every member's payload, in declaration order. an empty member's
+        //kind is SLOT_VOID
+        std::vector<SlotKind> kinds;
+        std::vector<uint32_t> offsets;
+        //fields by offset
+        std::vector<uint32_t> order;
+        //where a union's tag is stored, in tagSize bytes; tagSize is 0 when it is not stored
+        uint32_t tagOffset;
+        uint32_t tagSize;
+        //when the tag is not stored but a union has more than one member, the payload of member
+        //`dataful` tells them apart: the values from nicheStart on that the payload never holds
+        //stand for the other members, in order. irNone otherwise
+        uint32_t dataful;
+        uint64_t nicheStart;
+    };
+
+    //computes the layouts of a module's structs, unions and tuples. fields are placed by
+    //decreasing alignment, so that they leave as little padding as they can, unless the
+    //declaration is repr(C); a union with a single member that has a value keeps the tag in the
+    //bits that value cannot have when there are enough of them, as with a pointer and one empty
+    //member, and otherwise stores it after the largest payload
+    class LayoutEngine {
+    public:
+        explicit LayoutEngine(const IrModule& module);
+
+        //the layout of declaration or tuple `layout` as code shared by all its instances sees it,
+        //with type parameters and the fields of tuples held as tagged values
+        const DataLayout& ofLayout(uint32_t layout);
+        //the layout of values of type `type`, with its arguments in place of the parameters of its
+        //declaration. null for types that are not structs, unions or tuples
+        const DataLayout* ofType(uint32_t type);
+        //the IrLayout values of `type` have, or irNone
+        uint32_t layoutOf(uint32_t type) const;
+        SlotKind kindOf(const std::shared_ptr<Ty>& t) const;
+
+        static uint32_t sizeOf(SlotKind kind);
+        //the fields in declaration order, each aligned as C aligns it
+        static DataLayout place(const std::vector<SlotKind>& kinds, bool declaredOrder);
+
+    private:
+        const IrModule& module;
+        std::unordered_map<std::string, uint32_t> named;
+        std::unordered_map<size_t, uint32_t> tuples;
+        std::vector<std::unique_ptr<DataLayout>> declared;
+        std::unordered_map<uint32_t, std::unique_ptr<DataLayout>> instances;
+
+        DataLayout compute(const IrLayout& layout, const std::vector<SlotKind>& kinds) const;
+    };
+
+    //prints the layout of every struct, union and tuple of the module, then the size of every
+    //instance of a generic one whose arguments make it smaller or larger
+    void printLayouts(const IrModule& module, FILE* out);
+}
+#endif
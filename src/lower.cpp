@@ -0,0 +1,1927 @@
+#include <algorithm>
+#include <cstring>
+#include "lower.h"
+#include "match.h"
+#include "semant.h"
+#include "specialize.h"
+
+namespace pilaf {
+    //a switch's decision tree may have this many nodes, and 16 more for every case
+    static const size_t maxMatchNodes = 256;
+    //a test on an Int or Char becomes a jump table when it has this many ways out, over at most
+    //this many values of which 40% or more do not go to the fallback
+    static const size_t minTableCases = 4;
+    static const uint64_t maxTableSpan = 256;
+
+    //SSA is built directly from the syntax tree, following Braun et al., "Simple and Efficient
+    //Construction of Static Single Assignment Form": a variable read looks for the value written
+    //in the current block and otherwise asks its predecessors, placing a phi where they may
+    //disagree. blocks whose predecessors are not all known yet get incomplete phis that are
+    //filled in once the block is sealed, and phis that turn out to be trivial are removed at the end
+    struct Lowering {
+        struct Local {
+            std::string name;
+            uint32_t variable;
+        };
+
+        struct Loop {
+            uint32_t breakTarget;
+            uint32_t continueTarget;
+        };
+
+        struct FunctionState {
+            uint32_t index;
+            //innermost last; blocks drop theirs when they end
+            std::vector<Local> locals;
+            std::vector<Loop> loops;
+            //block being appended to, or irNone once control cannot reach the code being lowered
+            uint32_t block;
+            std::vector<uint32_t> variableTypes;
+            //value of each variable at the end of each block it was written or read in
+            std::vector<std::unordered_map<uint32_t, uint32_t>> definitions;
+            std::vector<bool> sealed;
+            //(variable, phi) pairs waiting for their block to be sealed
+            std::vector<std::vector<std::pair<uint32_t, uint32_t>>> incomplete;
+            //the function a lambda is made in, whose locals it can capture
+            FunctionState* outer = nullptr;
+            //locals of `outer` the lambda captured, and the values they have where it is made
+            std::vector<Local> captured;
+            std::vector<uint32_t> captures;
+        };
+
+        enum ReferenceKind {
+            REF_NONE,
+            REF_LOCAL,
+            REF_GLOBAL,
+            REF_FUNCTION,
+            //a class method whose instance is not known statically
+            REF_METHOD,
+            REF_CONSTRUCTOR,
+            //a local of an enclosing function that is not a lambda's
+            REF_CAPTURED
+        };
+
+        struct Reference {
+            ReferenceKind kind;
+            //variable, global, function or union layout
+            uint32_t index;
+            uint32_t tag;
+            std::shared_ptr<UnionDeclarationNode> ud;
+        };
+
+        std::shared_ptr<ProgramNode> program;
+        std::shared_ptr<IrModule> module;
+        const char* source;
+        std::vector<size_t> lineStarts;
+        DiagnosticEngine& diagnostics;
+        bool failed;
+        FunctionState* state;
+        std::shared_ptr<ScopeNode> scope;
+        //line of the statement being lowered, which its instructions are attributed to
+        uint32_t line;
+        std::unordered_map<const FunctionDeclarationNode*, uint32_t> functions;
+        std::unordered_map<const ScopeNode*, std::unordered_map<std::string, uint32_t>> globals;
+        std::unordered_map<const node*, uint32_t> layouts;
+        std::unordered_map<size_t, uint32_t> tupleLayouts;
+        std::unordered_map<Symbol, size_t> fieldOwners;
+        std::map<std::pair<Symbol, uint32_t>, uint32_t> fieldRefs;
+        std::unordered_map<std::string, uint32_t> strings;
+        std::unordered_map<std::string, size_t> names;
+        std::unordered_map<std::string, std::shared_ptr<Ty>> substitutions;
+        std::unordered_map<const Ty*, std::shared_ptr<Ty>> solvedTypes;
+        //functions whose bodies still have to be lowered, with the scope they are declared in
+        std::vector<std::pair<std::shared_ptr<FunctionDeclarationNode>, std::shared_ptr<ScopeNode>>> bodies;
+        uint32_t voidType, boolType, intType, floatType, doubleType, charType, stringType, unknownType;
+
+        Lowering(std::shared_ptr<ProgramNode> program, const char* source, DiagnosticEngine& diagnostics)
+        : program(program), module(std::make_shared<IrModule>()), source(source), diagnostics(diagnostics), failed(false), state(nullptr), scope(nullptr), line(0),
+          substitutions(composeSubstitutions(program->substitutions))
+        {
+            lineStarts.push_back(0);
+            for(size_t i = 0; source != nullptr && source[i] != '\0'; i++)
+            {
+                if(source[i] == '\n') lineStarts.push_back(i + 1);
+            }
+            voidType = module->type(std::make_shared<TyBasic>("Void"));
+            boolType = module->type(std::make_shared<TyBasic>("Bool"));
+            intType = module->type(std::make_shared<TyBasic>("Int"));
+            floatType = module->type(std::make_shared<TyBasic>("Float"));
+            doubleType = module->type(std::make_shared<TyBasic>("Double"));
+            charType = module->type(std::make_shared<TyBasic>("Char"));
+            stringType = module->type(std::make_shared<TyBasic>("String"));
+            //what lowering cannot tell is typed as an unconstrained variable
+            unknownType = module->type(newGenericType());
+        }
+
+        uint32_t lineOf(const char* p)
+        {
+            if(source == nullptr || p == nullptr || p < source || p > source + lineStarts.back() + strlen(source + lineStarts.back())) return 0;
+            return (uint32_t)(std::upper_bound(lineStarts.begin(), lineStarts.end(), (size_t)(p - source)) - lineStarts.begin());
+        }
+
+        void unsupported(const node* n, const char* message)
+        {
+            failed = true;
+            diagnostics.report(DIAG_UNSUPPORTED, SEVERITY_ERROR, n ? n->start : nullptr, n ? n->end : nullptr, message, {}, (int)line);
+        }
+
+        void unsupported(const std::shared_ptr<node>& n, const char* message)
+        {
+            unsupported(n.get(), message);
+        }
+
+        //types
+
+        std::shared_ptr<Ty> solved(const std::shared_ptr<Ty>& t)
+        {
+            if(t == nullptr) return nullptr;
+            auto it = solvedTypes.find(t.get());
+            if(it != solvedTypes.end()) return it->second;
+            auto result = applySubstitutions(t, substitutions);
+            solvedTypes.emplace(t.get(), result);
+            return result;
+        }
+
+        uint32_t typeIndex(const std::shared_ptr<Ty>& t)
+        {
+            return t != nullptr ? module->type(solved(t)) : unknownType;
+        }
+
+        const std::shared_ptr<Ty>& typeOf(uint32_t value)
+        {
+            return module->types[function().instructions[value].type];
+        }
+
+        //the result of applying a function of type `t` to `count` arguments
+        uint32_t resultType(std::shared_ptr<Ty> t, size_t count)
+        {
+            for(size_t i = 0; i < count; i++)
+            {
+                if(t == nullptr || t->type != Ty::TY_FUNCTION) return unknownType;
+                t = std::static_pointer_cast<TyFunc>(t)->out;
+            }
+            return t != nullptr ? module->type(t) : unknownType;
+        }
+
+        static bool isBuiltinType(const std::shared_ptr<Ty>& t)
+        {
+            if(t->type != Ty::TY_BASIC) return false;
+            auto& name = std::static_pointer_cast<TyBasic>(t)->t;
+            return name == "Int" || name == "Float" || name == "Double" || name == "Char" || name == "Bool" || name == "String";
+        }
+
+        std::shared_ptr<StructDeclarationNode> findStruct(const std::string& name, std::shared_ptr<ScopeNode> s)
+        {
+            for(; s != nullptr; s = s->parentScope)
+            {
+                auto it = s->structs.find(name);
+                if(it != s->structs.end()) return it->second;
+            }
+            return nullptr;
+        }
+
+        //the struct a record of type `t` is, when its type says so
+        std::shared_ptr<StructDeclarationNode> structOf(const std::shared_ptr<Ty>& t)
+        {
+            auto named = t;
+            if(named->type == Ty::TY_APPLICATION) named = std::static_pointer_cast<TyAppl>(named)->applied;
+            if(named->type != Ty::TY_BASIC) return nullptr;
+            return findStruct(std::static_pointer_cast<TyBasic>(named)->t, scope);
+        }
+
+        //`fieldType` of `sd` with the struct's parameters bound to the arguments in `record`
+        std::shared_ptr<Ty> instantiate(const std::shared_ptr<StructDeclarationNode>& sd, const std::shared_ptr<Ty>& record, const std::shared_ptr<Ty>& fieldType)
+        {
+            if(sd->typeDefined->type != Ty::TY_APPLICATION || record->type != Ty::TY_APPLICATION) return fieldType;
+            auto& params = std::static_pointer_cast<TyAppl>(sd->typeDefined)->vars;
+            auto& args = std::static_pointer_cast<TyAppl>(record)->vars;
+            if(params.size() != args.size()) return fieldType;
+            return mapType(fieldType, [&](const std::shared_ptr<Ty>& leaf)
+            {
+                if(leaf->type != Ty::TY_VAR) return leaf;
+                for(size_t i = 0; i < params.size(); i++)
+                {
+                    if(params[i]->type == Ty::TY_VAR && typesEqual(params[i], leaf)) return args[i];
+                }
+                return leaf;
+            });
+        }
+
+        //tables
+
+        uint32_t constant(IrConstantKind kind, uint64_t bits)
+        {
+            return module->constant(kind, bits);
+        }
+
+        uint32_t stringConstant(const std::string& text)
+        {
+            auto it = strings.find(text);
+            if(it != strings.end()) return constant(CONST_STRING, it->second);
+            module->strings.push_back(text);
+            strings.emplace(text, module->strings.size() - 1);
+            return constant(CONST_STRING, module->strings.size() - 1);
+        }
+
+        uint32_t field(Symbol name, uint32_t index)
+        {
+            auto key = std::make_pair(name, index);
+            auto it = fieldRefs.find(key);
+            if(it != fieldRefs.end()) return it->second;
+            module->fields.push_back(IrField{name, index});
+            auto ref = (uint32_t)(module->fields.size() - 1);
+            fieldRefs.emplace(key, ref);
+            return ref;
+        }
+
+        uint32_t tupleLayout(size_t size)
+        {
+            auto it = tupleLayouts.find(size);
+            if(it != tupleLayouts.end()) return it->second;
+            IrLayout layout{"", {}, {}, {}, size, false, {}, false};
+            for(size_t i = 0; i < size; i++) layout.names.push_back(intern(std::to_string(i)));
+            module->layouts.push_back(std::move(layout));
+            auto index = (uint32_t)(module->layouts.size() - 1);
+            tupleLayouts.emplace(size, index);
+            return index;
+        }
+
+        std::vector<uint32_t> declarationParams(const std::shared_ptr<Ty>& typeDefined)
+        {
+            std::vector<uint32_t> params;
+            if(typeDefined->type != Ty::TY_APPLICATION) return params;
+            for(auto& v : std::static_pointer_cast<TyAppl>(typeDefined)->vars) params.push_back(module->type(v));
+            return params;
+        }
+
+        uint32_t layoutOf(const std::shared_ptr<StructDeclarationNode>& sd)
+        {
+            auto it = layouts.find(sd.get());
+            if(it != layouts.end()) return it->second;
+            IrLayout layout{declarationName(sd->typeDefined), {}, {}, {}, sd->fields.size(), false, declarationParams(sd->typeDefined), sd->reprC};
+            for(auto& f : sd->fields)
+            {
+                layout.names.push_back(intern(std::string_view(f.identifier.start, f.identifier.length)));
+                layout.types.push_back(module->type(f.type));
+            }
+            module->layouts.push_back(std::move(layout));
+            auto index = (uint32_t)(module->layouts.size() - 1);
+            layouts.emplace(sd.get(), index);
+            return index;
+        }
+
+        uint32_t layoutOf(const std::shared_ptr<UnionDeclarationNode>& ud)
+        {
+            auto it = layouts.find(ud.get());
+            if(it != layouts.end()) return it->second;
+            IrLayout layout{declarationName(ud->typeDefined), {}, {}, {}, ud->members.size(), true, declarationParams(ud->typeDefined), ud->reprC};
+            for(auto& m : ud->members)
+            {
+                layout.names.push_back(intern(std::string_view(m.identifier.start, m.identifier.length)));
+                layout.empty.push_back(m.type == nullptr);
+                layout.types.push_back(m.type == nullptr ? voidType : module->type(m.type));
+            }
+            module->layouts.push_back(std::move(layout));
+            auto index = (uint32_t)(module->layouts.size() - 1);
+            layouts.emplace(ud.get(), index);
+            return index;
+        }
+
+        //names are made unique, so that a backend can use them as symbols
+        std::string uniqueName(const std::string& name)
+        {
+            auto& uses = names[name];
+            return uses++ == 0 ? name : name + "." + std::to_string(uses);
+        }
+
+        uint32_t addFunction(const std::string& name, std::vector<uint32_t> params, uint32_t result, bool external)
+        {
+            IrFunction f;
+            f.name = external ? name : uniqueName(name);
+            f.params = std::move(params);
+            f.result = result;
+            f.external = external;
+            module->functions.push_back(std::move(f));
+            return (uint32_t)(module->functions.size() - 1);
+        }
+
+        uint32_t addFunction(const std::shared_ptr<FunctionDeclarationNode>& fd, const std::string& name, bool external)
+        {
+            std::vector<uint32_t> params;
+            for(auto& p : fd->params) if(p.identifier.length != 0) params.push_back(typeIndex(p.type));
+            return addFunction(name, std::move(params), typeIndex(fd->returnType), external);
+        }
+
+        //assigns functions and globals their indices, so that code can refer to them before they are lowered
+        void declare(const std::shared_ptr<node>& n, const std::shared_ptr<ScopeNode>& s, bool global, const std::string& prefix)
+        {
+            if(n == nullptr) return;
+            switch(n->nodeType)
+            {
+                case NODE_MODULE:
+                {
+                    auto md = std::static_pointer_cast<ModuleDeclarationNode>(n);
+                    if(md->block == nullptr || md->block->nodeType != NODE_BLOCK) break;
+                    auto block = std::static_pointer_cast<BlockStatementNode>(md->block);
+                    auto inner = prefix + tokenToString(md->name) + ".";
+                    for(auto& dec : block->declarations) declare(dec, block->scope, true, inner);
+                    break;
+                }
+                case NODE_BLOCK:
+                {
+                    auto block = std::static_pointer_cast<BlockStatementNode>(n);
+                    for(auto& dec : block->declarations) declare(dec, block->scope, false, prefix);
+                    break;
+                }
+                case NODE_FUNCTIONDECL:
+                {
+                    auto fd = std::static_pointer_cast<FunctionDeclarationNode>(n);
+                    if(functions.count(fd.get()) != 0) break;
+                    auto& body = functionBody(*fd);
+                    //a function without a body keeps the name it is declared with, which is what it binds to
+                    functions.emplace(fd.get(), addFunction(fd, body == nullptr ? tokenToString(fd->identifier) : prefix + tokenToString(fd->identifier), body == nullptr));
+                    if(body == nullptr) break;
+                    bodies.emplace_back(fd, s);
+                    declare(body, s, false, prefix);
+                    break;
+                }
+                case NODE_CLASSIMPL:
+                {
+                    auto impl = std::static_pointer_cast<ClassImplementationNode>(n);
+                    auto inner = prefix + tokenToString(impl->_class) + "[" + typeToString(impl->implemented) + "].";
+                    for(auto& f : impl->functions) declare(f, s, false, inner);
+                    break;
+                }
+                case NODE_STRUCTDECL:
+                {
+                    auto sd = std::static_pointer_cast<StructDeclarationNode>(n);
+                    for(auto& f : sd->fields) fieldOwners[intern(std::string_view(f.identifier.start, f.identifier.length))]++;
+                    break;
+                }
+                case NODE_VARIABLEDECL:
+                {
+                    if(!global) break;
+                    auto vd = std::static_pointer_cast<VariableDeclarationNode>(n);
+                    auto& names = globals[s.get()];
+                    for(auto& id : vd->identifiers)
+                    {
+                        if(names.count(id.first) != 0) continue;
+                        names.emplace(id.first, (uint32_t)module->globals.size());
+                        module->globals.push_back(IrGlobal{prefix + id.first, typeIndex(id.second)});
+                    }
+                    break;
+                }
+                case NODE_IF:
+                {
+                    auto _if = std::static_pointer_cast<IfStatementNode>(n);
+                    declare(_if->thenStmt, s, false, prefix);
+                    declare(_if->elseStmt, s, false, prefix);
+                    break;
+                }
+                case NODE_WHILE: declare(std::static_pointer_cast<WhileStatementNode>(n)->loopStmt, s, false, prefix); break;
+                case NODE_FOR: declare(std::static_pointer_cast<ForStatementNode>(n)->loopStmt, s, false, prefix); break;
+                case NODE_SWITCH:
+                {
+                    for(auto& c : std::static_pointer_cast<SwitchStatementNode>(n)->cases)
+                    {
+                        auto _case = std::static_pointer_cast<CaseNode>(c);
+                        declare(_case->caseStmt, _case->scope, false, prefix);
+                    }
+                    break;
+                }
+                default: break;
+            }
+        }
+
+        //blocks and instructions
+
+        IrFunction& function() { return module->functions[state->index]; }
+
+        uint32_t newBlock(bool sealed)
+        {
+            auto& f = function();
+            f.blocks.emplace_back();
+            state->sealed.push_back(sealed);
+            state->incomplete.emplace_back();
+            return (uint32_t)(f.blocks.size() - 1);
+        }
+
+        //continues in `block`; code after a block nothing jumps to is never reached
+        void enter(uint32_t block)
+        {
+            state->block = block == 0 || !function().blocks[block].predecessors.empty() ? block : irNone;
+        }
+
+        bool reachable() const { return state->block != irNone; }
+
+        uint32_t instruction(IrOpcode op, uint32_t type, uint32_t a = irNone, uint32_t b = irNone, uint32_t c = irNone)
+        {
+            return addInstruction(function(), IrInstruction{op, type, a, b, c}, line);
+        }
+
+        uint32_t emit(IrOpcode op, uint32_t type, uint32_t a = irNone, uint32_t b = irNone, uint32_t c = irNone)
+        {
+            auto i = instruction(op, type, a, b, c);
+            function().blocks[state->block].instructions.push_back(i);
+            return i;
+        }
+
+        //an instruction whose operands are a run of values
+        uint32_t emit(IrOpcode op, uint32_t type, const std::vector<uint32_t>& values, uint32_t c = irNone)
+        {
+            auto& f = function();
+            auto offset = (uint32_t)f.operands.size();
+            f.operands.insert(f.operands.end(), values.begin(), values.end());
+            return emit(op, type, offset, (uint32_t)values.size(), c);
+        }
+
+        void jump(uint32_t target)
+        {
+            emit(IR_JUMP, voidType, target);
+            function().blocks[target].predecessors.push_back(state->block);
+            state->block = irNone;
+        }
+
+        void branch(uint32_t condition, uint32_t ifTrue, uint32_t ifFalse)
+        {
+            emit(IR_BRANCH, voidType, condition, ifTrue, ifFalse);
+            function().blocks[ifTrue].predecessors.push_back(state->block);
+            function().blocks[ifFalse].predecessors.push_back(state->block);
+            state->block = irNone;
+        }
+
+        //continues in a new block when `condition` holds, and goes to `fail` otherwise
+        void test(uint32_t condition, uint32_t fail, const std::shared_ptr<node>& n)
+        {
+            if(fail == irNone)
+            {
+                unsupported(n, "variable declaration cannot assign to a refutable pattern");
+                return;
+            }
+            auto next = newBlock(true);
+            branch(condition, next, fail);
+            enter(next);
+        }
+
+        //variables
+
+        uint32_t newVariable(const std::string& name, uint32_t type)
+        {
+            state->variableTypes.push_back(type);
+            state->definitions.emplace_back();
+            auto variable = (uint32_t)(state->variableTypes.size() - 1);
+            state->locals.push_back(Local{name, variable});
+            return variable;
+        }
+
+        void write(uint32_t variable, uint32_t block, uint32_t value)
+        {
+            state->definitions[variable][block] = value;
+        }
+
+        //an instruction placed after the phis at the start of `block`
+        uint32_t prepend(uint32_t block, IrOpcode op, uint32_t type)
+        {
+            auto i = instruction(op, type);
+            auto& list = function().blocks[block].instructions;
+            auto at = list.begin();
+            while(at != list.end() && function().instructions[*at].op == IR_PHI) at++;
+            list.insert(at, i);
+            return i;
+        }
+
+        //a local by name, or irNone. a lambda captures the locals of the functions it is made in by
+        //value: each becomes a parameter after its own, which the closure passes along
+        uint32_t local(const std::string& name)
+        {
+            for(auto it = state->locals.rbegin(); it != state->locals.rend(); it++)
+            {
+                if(it->name == name) return it->variable;
+            }
+            for(auto& c : state->captured)
+            {
+                if(c.name == name) return c.variable;
+            }
+            auto inner = state;
+            if(inner->outer == nullptr) return irNone;
+            state = inner->outer;
+            auto variable = local(name);
+            uint32_t value = irNone;
+            uint32_t type = unknownType;
+            if(variable != irNone && reachable())
+            {
+                value = read(variable, state->block);
+                type = state->variableTypes[variable];
+            }
+            state = inner;
+            if(value == irNone) return irNone;
+            auto& f = function();
+            auto param = prepend(0, IR_PARAM, type);
+            f.instructions[param].a = (uint32_t)f.params.size();
+            f.params.push_back(type);
+            f.captures++;
+            state->captures.push_back(value);
+            state->variableTypes.push_back(type);
+            state->definitions.emplace_back();
+            variable = (uint32_t)(state->variableTypes.size() - 1);
+            state->captured.push_back(Local{name, variable});
+            write(variable, 0, param);
+            return variable;
+        }
+
+        bool isCaptured(uint32_t variable) const
+        {
+            for(auto& c : state->captured)
+            {
+                if(c.variable == variable) return true;
+            }
+            return false;
+        }
+
+        uint32_t read(uint32_t variable, uint32_t block)
+        {
+            auto& defs = state->definitions[variable];
+            auto it = defs.find(block);
+            if(it != defs.end()) return it->second;
+            auto type = state->variableTypes[variable];
+            auto& preds = function().blocks[block].predecessors;
+            uint32_t value;
+            if(!state->sealed[block])
+            {
+                value = prepend(block, IR_PHI, type);
+                state->incomplete[block].emplace_back(variable, value);
+            }
+            else if(preds.size() == 1) value = read(variable, preds[0]);
+            else if(preds.empty()) value = prepend(block, IR_UNDEF, type);
+            else
+            {
+                //written before its operands are read, so that a loop back to this block finds it
+                value = prepend(block, IR_PHI, type);
+                write(variable, block, value);
+                addPhiOperands(variable, value, block);
+            }
+            write(variable, block, value);
+            return value;
+        }
+
+        void addPhiOperands(uint32_t variable, uint32_t phi, uint32_t block)
+        {
+            std::vector<uint32_t> entries;
+            auto preds = function().blocks[block].predecessors;
+            for(auto p : preds)
+            {
+                entries.push_back(p);
+                entries.push_back(read(variable, p));
+            }
+            auto& f = function();
+            f.instructions[phi].a = (uint32_t)f.operands.size();
+            f.instructions[phi].b = (uint32_t)preds.size();
+            f.operands.insert(f.operands.end(), entries.begin(), entries.end());
+        }
+
+        //called once every predecessor of `block` is known
+        void seal(uint32_t block)
+        {
+            if(state->sealed[block]) return;
+            auto pending = std::move(state->incomplete[block]);
+            state->incomplete[block].clear();
+            for(auto& p : pending) addPhiOperands(p.first, p.second, block);
+            state->sealed[block] = true;
+        }
+
+        //removes phis whose entries are all the same value or the phi itself, drops blocks nothing
+        //jumps to and renumbers the rest
+        void finish()
+        {
+            auto& f = function();
+            std::vector<uint32_t> replacement(f.instructions.size(), irNone);
+            auto find = [&](uint32_t v)
+            {
+                while(replacement[v] != irNone) v = replacement[v];
+                return v;
+            };
+            bool changed = true;
+            while(changed)
+            {
+                changed = false;
+                for(auto& block : f.blocks)
+                {
+                    for(auto i : block.instructions)
+                    {
+                        auto& in = f.instructions[i];
+                        if(in.op != IR_PHI) break;
+                        if(replacement[i] != irNone) continue;
+                        uint32_t same = irNone;
+                        bool trivial = true;
+                        for(uint32_t k = 0; k < in.b && trivial; k++)
+                        {
+                            auto v = find(f.operands[in.a + 2 * k + 1]);
+                            if(v == i || v == same) continue;
+                            if(same != irNone) trivial = false;
+                            same = v;
+                        }
+                        if(!trivial) continue;
+                        //a phi that only refers to itself is never given a value
+                        if(same == irNone) same = prepend(0, IR_UNDEF, in.type);
+                        if(replacement.size() < f.instructions.size()) replacement.resize(f.instructions.size(), irNone);
+                        replacement[i] = same;
+                        changed = true;
+                    }
+                }
+            }
+            for(auto& block : f.blocks)
+            {
+                block.instructions.erase(std::remove_if(block.instructions.begin(), block.instructions.end(), [&](uint32_t i) { return replacement[i] != irNone; }), block.instructions.end());
+            }
+            replaceUses(f, replacement);
+            //blocks nothing jumps to were never appended to, since code is only lowered while reachable
+            removeUnreachableBlocks(f);
+        }
+
+        //names
+
+        bool findConstructor(const std::string& name, std::shared_ptr<ScopeNode> s, Reference& ref)
+        {
+            for(; s != nullptr; s = s->parentScope)
+            {
+                auto search = [&](const std::shared_ptr<ScopeNode>& in, bool own)
+                {
+                    if(in == nullptr) return false;
+                    for(auto& u : in->unions)
+                    {
+                        if(own && u.second->scope != s) continue;
+                        auto& members = u.second->members;
+                        for(size_t i = 0; i < members.size(); i++)
+                        {
+                            if(tokenToString(members[i].identifier) != name) continue;
+                            ref = Reference{REF_CONSTRUCTOR, layoutOf(u.second), (uint32_t)i, u.second};
+                            return true;
+                        }
+                    }
+                    return false;
+                };
+                //members are found from the scope a union is declared in, or from its own, as in Shape.Circle
+                if(search(s, false) || search(s->parentScope, true)) return true;
+            }
+            return false;
+        }
+
+        Reference resolve(const std::string& name, std::shared_ptr<ScopeNode> s, bool qualified)
+        {
+            Reference ref{REF_NONE, 0, 0, nullptr};
+            if(!qualified)
+            {
+                auto variable = local(name);
+                if(variable != irNone) return Reference{REF_LOCAL, variable, 0, nullptr};
+            }
+            if(!name.empty() && name[0] >= 'A' && name[0] <= 'Z')
+            {
+                findConstructor(name, s, ref);
+                return ref;
+            }
+            for(; s != nullptr; s = s->parentScope)
+            {
+                auto g = globals.find(s.get());
+                if(g != globals.end())
+                {
+                    auto it = g->second.find(name);
+                    if(it != g->second.end()) return Reference{REF_GLOBAL, it->second, 0, nullptr};
+                }
+                if(s->variables.count(name) != 0) return Reference{REF_CAPTURED, 0, 0, nullptr};
+                auto f = s->functions.find(name);
+                if(f != s->functions.end())
+                {
+                    auto index = functions.find(f->second.get());
+                    if(index != functions.end()) return Reference{REF_FUNCTION, index->second, 0, nullptr};
+                    return Reference{REF_METHOD, 0, 0, nullptr};
+                }
+            }
+            return ref;
+        }
+
+        Reference resolve(const std::shared_ptr<node>& n, std::shared_ptr<ScopeNode> s, bool qualified)
+        {
+            switch(n->nodeType)
+            {
+                case NODE_IDENTIFIER: return resolve(tokenToString(std::static_pointer_cast<VariableNode>(n)->variable), s, qualified);
+                case NODE_TYPE:
+                {
+                    Reference ref{REF_NONE, 0, 0, nullptr};
+                    findConstructor(declarationName(std::static_pointer_cast<TypeNode>(n)->type), s, ref);
+                    return ref;
+                }
+                case NODE_NAMESPACE:
+                {
+                    auto ns = std::static_pointer_cast<NamespaceNode>(n);
+                    auto inner = getNamespaceScope(ns->name, s);
+                    if(inner != nullptr) return resolve(ns->expr, inner, true);
+                    break;
+                }
+                default: break;
+            }
+            return Reference{REF_NONE, 0, 0, nullptr};
+        }
+
+        static bool isName(const std::shared_ptr<node>& n)
+        {
+            return n->nodeType == NODE_IDENTIFIER || n->nodeType == NODE_TYPE || n->nodeType == NODE_NAMESPACE;
+        }
+
+        //reports a name that has no value here, and stands in for it so that lowering can go on
+        uint32_t unresolved(const std::shared_ptr<node>& n, const Reference& ref)
+        {
+            switch(ref.kind)
+            {
+                case REF_CAPTURED: unsupported(n, "functions and lambdas cannot capture local variables of an enclosing function yet"); break;
+                case REF_METHOD: unsupported(n, "class method call whose instance is not known statically"); break;
+                default: unsupported(n, "name has no value at runtime"); break;
+            }
+            return emit(IR_UNDEF, unknownType);
+        }
+
+        //literals
+
+        static int64_t integerLiteral(const Token& t)
+        {
+            std::string text(t.start, t.length);
+            bool negative = !text.empty() && text[0] == '-';
+            const char* digits = text.c_str() + (negative ? 1 : 0);
+            uint64_t value = 0;
+            switch(t.type)
+            {
+                case TokenTypes::HEX_INT: value = strtoull(digits, nullptr, 16); break;
+                case TokenTypes::OCT_INT: value = strtoull(digits, nullptr, 8); break;
+                case TokenTypes::BIN_INT: value = strtoull(digits + 2, nullptr, 2); break;
+                default: value = strtoull(digits, nullptr, 10); break;
+            }
+            return negative ? (int64_t)(0 - value) : (int64_t)value;
+        }
+
+        //backslash escapes are resolved here, since the lexer keeps string tokens as written
+        static std::string stringLiteral(const Token& t)
+        {
+            std::string result;
+            for(int i = 1; i + 1 < t.length; i++)
+            {
+                char c = t.start[i];
+                if(c == '\\' && i + 2 < t.length)
+                {
+                    c = t.start[++i];
+                    switch(c)
+                    {
+                        case 'n': c = '\n'; break;
+                        case 't': c = '\t'; break;
+                        case 'r': c = '\r'; break;
+                        case '0': c = '\0'; break;
+                        default: break;
+                    }
+                }
+                result.push_back(c);
+            }
+            return result;
+        }
+
+        uint32_t literal(const std::shared_ptr<LiteralNode>& lit)
+        {
+            auto& t = lit->value;
+            switch(t.type)
+            {
+                case TokenTypes::_TRUE: return emit(IR_CONST, boolType, constant(CONST_BOOL, 1));
+                case TokenTypes::_FALSE: return emit(IR_CONST, boolType, constant(CONST_BOOL, 0));
+                case TokenTypes::INT:
+                case TokenTypes::HEX_INT:
+                case TokenTypes::OCT_INT:
+                case TokenTypes::BIN_INT: return emit(IR_CONST, intType, constant(CONST_INT, (uint64_t)integerLiteral(t)));
+                case TokenTypes::DOUBLE:
+                {
+                    double d = strtod(std::string(t.start, t.length).c_str(), nullptr);
+                    uint64_t bits;
+                    memcpy(&bits, &d, sizeof(d));
+                    return emit(IR_CONST, doubleType, constant(CONST_DOUBLE, bits));
+                }
+                case TokenTypes::FLOAT:
+                {
+                    float f = strtof(std::string(t.start, t.length).c_str(), nullptr);
+                    uint32_t bits;
+                    memcpy(&bits, &f, sizeof(f));
+                    return emit(IR_CONST, floatType, constant(CONST_FLOAT, bits));
+                }
+                case TokenTypes::STRING: return emit(IR_CONST, stringType, stringConstant(stringLiteral(t)));
+                case TokenTypes::CHAR:
+                {
+                    if(t.length < 3) break;
+                    return emit(IR_CONST, charType, constant(CONST_CHAR, (unsigned char)t.start[1]));
+                }
+                default: break;
+            }
+            unsupported(lit, "literal cannot be lowered");
+            return emit(IR_UNDEF, unknownType);
+        }
+
+        //expressions
+
+        uint32_t call(uint32_t callee, const std::vector<std::shared_ptr<node>>& args, const std::shared_ptr<node>& n, uint32_t type)
+        {
+            if(args.size() != module->functions[callee].params.size())
+            {
+                unsupported(n, "partial application cannot be lowered yet");
+                return emit(IR_UNDEF, unknownType);
+            }
+            std::vector<uint32_t> values;
+            for(auto& arg : args) values.push_back(expression(arg));
+            return emit(IR_CALL, type, values, callee);
+        }
+
+        uint32_t functionCall(const std::shared_ptr<FunctionCallNode>& fc)
+        {
+            for(auto& arg : fc->args)
+            {
+                if(arg->nodeType != NODE_PLACEHOLDER) continue;
+                unsupported(arg, "partial application cannot be lowered yet");
+                return emit(IR_UNDEF, unknownType);
+            }
+            auto type = resultType(solved(fc->calleeType), std::max<size_t>(fc->args.size(), 1));
+            if(fc->target != nullptr)
+            {
+                auto it = functions.find(fc->target->function.get());
+                if(it == functions.end())
+                {
+                    unsupported(fc, "class method implementation has no body");
+                    return emit(IR_UNDEF, unknownType);
+                }
+                if(fc->calleeType == nullptr) type = module->functions[it->second].result;
+                return call(it->second, fc->args, fc, type);
+            }
+            if(isName(fc->called))
+            {
+                auto ref = resolve(fc->called, scope, false);
+                switch(ref.kind)
+                {
+                    case REF_FUNCTION:
+                    {
+                        if(fc->calleeType == nullptr) type = module->functions[ref.index].result;
+                        return call(ref.index, fc->args, fc, type);
+                    }
+                    case REF_CONSTRUCTOR:
+                    {
+                        if(module->layouts[ref.index].empty[ref.tag] || fc->args.empty())
+                        {
+                            unsupported(fc, "union member called with the wrong number of values");
+                            return emit(IR_UNDEF, unknownType);
+                        }
+                        uint32_t payload;
+                        //several values are carried as one tuple
+                        if(fc->args.size() == 1) payload = expression(fc->args[0]);
+                        else
+                        {
+                            std::vector<uint32_t> values;
+                            std::vector<std::shared_ptr<Ty>> types;
+                            for(auto& arg : fc->args)
+                            {
+                                values.push_back(expression(arg));
+                                types.push_back(typeOf(values.back()));
+                            }
+                            payload = emit(IR_RECORD, module->type(std::make_shared<TyTuple>(types)), values, tupleLayout(values.size()));
+                        }
+                        return emit(IR_VARIANT, typeIndex(ref.ud->typeDefined), payload, ref.index, ref.tag);
+                    }
+                    case REF_LOCAL:
+                    case REF_GLOBAL: break;
+                    default:
+                    {
+                        unresolved(fc->called, ref);
+                        return emit(IR_UNDEF, unknownType);
+                    }
+                }
+            }
+            std::vector<uint32_t> values = {expression(fc->called)};
+            if(fc->calleeType == nullptr) type = resultType(typeOf(values[0]), std::max<size_t>(fc->args.size(), 1));
+            for(auto& arg : fc->args) values.push_back(expression(arg));
+            return emit(IR_CALLVALUE, type, values);
+        }
+
+        uint32_t lambda(const std::shared_ptr<LambdaNode>& l)
+        {
+            std::vector<uint32_t> params;
+            std::shared_ptr<Ty> type = solved(l->returnType);
+            for(auto it = l->params.rbegin(); it != l->params.rend(); it++)
+            {
+                params.insert(params.begin(), typeIndex(it->type));
+                type = std::make_shared<TyFunc>(solved(it->type), type);
+            }
+            if(l->params.empty()) type = std::make_shared<TyFunc>(std::make_shared<TyBasic>("Void"), type);
+            auto index = addFunction("lambda", params, typeIndex(l->returnType), false);
+            auto saved = state;
+            auto savedLine = line;
+            FunctionState inner{index, {}, {}, irNone, {}, {}, {}, {}, saved, {}, {}};
+            state = &inner;
+            enter(newBlock(true));
+            for(size_t i = 0; i < l->params.size(); i++)
+            {
+                auto variable = newVariable(tokenToString(l->params[i].identifier), params[i]);
+                write(variable, state->block, emit(IR_PARAM, params[i], (uint32_t)i));
+            }
+            statement(l->body);
+            if(reachable()) emit(IR_RETURN, voidType);
+            finish();
+            state = saved;
+            line = savedLine;
+            if(inner.captures.empty()) return emit(IR_FUNCTION, module->type(type), index);
+            return emit(IR_CLOSURE, module->type(type), inner.captures, index);
+        }
+
+        uint32_t fieldRef(const std::shared_ptr<Ty>& record, const Token& name, std::shared_ptr<Ty>& type)
+        {
+            auto symbol = intern(std::string_view(name.start, name.length));
+            auto sd = structOf(record);
+            //without a known record type, the field's only owner decides
+            if(sd == nullptr && fieldOwners[symbol] == 1)
+            {
+                for(auto s = scope; s != nullptr && sd == nullptr; s = s->parentScope)
+                {
+                    auto it = s->fieldOwners.find(symbol);
+                    if(it != s->fieldOwners.end()) sd = it->second.front();
+                }
+            }
+            auto info = sd != nullptr ? sd->field(symbol) : nullptr;
+            if(info == nullptr)
+            {
+                type = module->types[unknownType];
+                return field(symbol, irNone);
+            }
+            type = instantiate(sd, record, solved(info->type));
+            return field(symbol, (uint32_t)info->index);
+        }
+
+        static bool binaryOpcode(const std::string& op, IrOpcode& opcode, bool& swap)
+        {
+            static const std::unordered_map<std::string, std::pair<IrOpcode, bool>> ops = {
+                {"+", {IR_ADD, false}}, {"-", {IR_SUB, false}}, {"*", {IR_MUL, false}}, {"/", {IR_DIV, false}}, {"%", {IR_MOD, false}},
+                {"&", {IR_BAND, false}}, {"|", {IR_BOR, false}}, {"^", {IR_BXOR, false}}, {"<<", {IR_SHL, false}}, {">>", {IR_SHR, false}},
+                {"==", {IR_EQ, false}}, {"!=", {IR_NE, false}}, {"<", {IR_LT, false}}, {"<=", {IR_LE, false}},
+                {">", {IR_LT, true}}, {">=", {IR_LE, true}},
+            };
+            auto it = ops.find(op);
+            if(it == ops.end()) return false;
+            opcode = it->second.first;
+            swap = it->second.second;
+            return true;
+        }
+
+        //each link of an operator chain takes the link below it as its left operand, so the chain
+        //is lowered in a loop up from its leftmost operand
+        uint32_t binary(const std::shared_ptr<node>& n)
+        {
+            std::vector<BinaryNode*> spine;
+            auto value = expression(binarySpine(n, spine));
+            module->sourceNodes += spine.size() - 1;
+            for(auto bn : spine) value = binary(*bn, value);
+            return value;
+        }
+
+        uint32_t binary(const BinaryNode& bn, uint32_t left)
+        {
+            auto op = tokenToString(bn.op);
+            if(op == "and" || op == "&&" || op == "or" || op == "||")
+            {
+                bool isAnd = op == "and" || op == "&&";
+                auto right = newBlock(true);
+                auto join = newBlock(false);
+                if(isAnd) branch(left, right, join);
+                else branch(left, join, right);
+                enter(right);
+                auto value = expression(bn.expression2);
+                auto end = state->block;
+                jump(join);
+                seal(join);
+                enter(join);
+                auto& preds = function().blocks[join].predecessors;
+                std::vector<uint32_t> entries;
+                for(auto p : preds)
+                {
+                    entries.push_back(p);
+                    entries.push_back(p == end ? value : left);
+                }
+                auto phi = prepend(join, IR_PHI, boolType);
+                auto& f = function();
+                f.instructions[phi].a = (uint32_t)f.operands.size();
+                f.instructions[phi].b = (uint32_t)preds.size();
+                f.operands.insert(f.operands.end(), entries.begin(), entries.end());
+                return phi;
+            }
+            auto x = left;
+            auto y = expression(bn.expression2);
+            auto& type = typeOf(x);
+            IrOpcode opcode;
+            bool swap;
+            bool builtin = binaryOpcode(op, opcode, swap);
+            //an operator the program declares as a function, unless it applies to a built-in type
+            auto declared = resolve("(" + op + ")", scope, true);
+            if(declared.kind == REF_FUNCTION && (!builtin || !isBuiltinType(type)) && module->functions[declared.index].params.size() == 2)
+            {
+                return emit(IR_CALL, module->functions[declared.index].result, {x, y}, declared.index);
+            }
+            if(!builtin)
+            {
+                unsupported(&bn, "operator has no built-in meaning");
+                return emit(IR_UNDEF, unknownType);
+            }
+            if(swap) std::swap(x, y);
+            bool comparison = opcode == IR_EQ || opcode == IR_NE || opcode == IR_LT || opcode == IR_LE;
+            return emit(opcode, comparison ? boolType : module->type(type), x, y);
+        }
+
+        uint32_t unary(const std::shared_ptr<UnaryNode>& un)
+        {
+            auto op = tokenToString(un->op);
+            auto x = expression(un->expression);
+            auto declared = resolve("(" + op + ")", scope, true);
+            if(declared.kind == REF_FUNCTION && !isBuiltinType(typeOf(x)) && module->functions[declared.index].params.size() == 1)
+            {
+                return emit(IR_CALL, module->functions[declared.index].result, std::vector<uint32_t>{x}, declared.index);
+            }
+            if(op == "-") return emit(IR_NEG, function().instructions[x].type, x);
+            if(op == "!" || op == "not") return emit(IR_NOT, boolType, x);
+            unsupported(un, "operator has no built-in meaning");
+            return emit(IR_UNDEF, unknownType);
+        }
+
+        void assign(const std::shared_ptr<node>& target, uint32_t value)
+        {
+            switch(target->nodeType)
+            {
+                case NODE_IDENTIFIER:
+                case NODE_NAMESPACE:
+                {
+                    auto ref = resolve(target, scope, false);
+                    if(ref.kind == REF_LOCAL && isCaptured(ref.index)) unsupported(target, "lambdas cannot assign to a variable they capture");
+                    else if(ref.kind == REF_LOCAL) write(ref.index, state->block, value);
+                    else if(ref.kind == REF_GLOBAL) emit(IR_SETGLOBAL, voidType, ref.index, value);
+                    else unresolved(target, ref);
+                    break;
+                }
+                case NODE_FIELDCALL:
+                {
+                    auto fieldCall = std::static_pointer_cast<FieldCallNode>(target);
+                    auto record = expression(fieldCall->expr);
+                    std::shared_ptr<Ty> type;
+                    emit(IR_SETFIELD, voidType, record, fieldRef(typeOf(record), fieldCall->field, type), value);
+                    break;
+                }
+                case NODE_ARRAYINDEX:
+                {
+                    auto index = std::static_pointer_cast<ArrayIndexNode>(target);
+                    auto array = expression(index->array);
+                    emit(IR_SETINDEX, voidType, array, expression(index->index), value);
+                    break;
+                }
+                default: unsupported(target, "value cannot be assigned to"); break;
+            }
+        }
+
+        uint32_t expression(const std::shared_ptr<node>& n)
+        {
+            module->sourceNodes++;
+            switch(n->nodeType)
+            {
+                case NODE_LITERAL: return literal(std::static_pointer_cast<LiteralNode>(n));
+                case NODE_IDENTIFIER:
+                case NODE_TYPE:
+                case NODE_NAMESPACE:
+                {
+                    auto ref = resolve(n, scope, false);
+                    switch(ref.kind)
+                    {
+                        case REF_LOCAL: return read(ref.index, state->block);
+                        case REF_GLOBAL: return emit(IR_GLOBAL, module->globals[ref.index].type, ref.index);
+                        case REF_FUNCTION:
+                        {
+                            auto& f = module->functions[ref.index];
+                            std::shared_ptr<Ty> type = module->types[f.result];
+                            for(auto it = f.params.rbegin(); it != f.params.rend(); it++) type = std::make_shared<TyFunc>(module->types[*it], type);
+                            if(f.params.empty()) type = std::make_shared<TyFunc>(module->types[voidType], type);
+                            return emit(IR_FUNCTION, module->type(type), ref.index);
+                        }
+                        case REF_CONSTRUCTOR:
+                        {
+                            if(module->layouts[ref.index].empty[ref.tag]) return emit(IR_VARIANT, typeIndex(ref.ud->typeDefined), irNone, ref.index, ref.tag);
+                            unsupported(n, "union members that carry a value can only be called");
+                            return emit(IR_UNDEF, unknownType);
+                        }
+                        default: return unresolved(n, ref);
+                    }
+                }
+                case NODE_BINARY: return binary(n);
+                case NODE_UNARY: return unary(std::static_pointer_cast<UnaryNode>(n));
+                case NODE_ASSIGNMENT:
+                {
+                    auto an = std::static_pointer_cast<AssignmentNode>(n);
+                    auto value = expression(an->assignment);
+                    assign(an->variable, value);
+                    return value;
+                }
+                case NODE_FUNCTIONCALL: return functionCall(std::static_pointer_cast<FunctionCallNode>(n));
+                case NODE_FIELDCALL:
+                {
+                    auto fieldCall = std::static_pointer_cast<FieldCallNode>(n);
+                    auto record = expression(fieldCall->expr);
+                    std::shared_ptr<Ty> type;
+                    auto ref = fieldRef(typeOf(record), fieldCall->field, type);
+                    return emit(IR_GETFIELD, module->type(type), record, ref);
+                }
+                case NODE_ARRAYINDEX:
+                {
+                    auto index = std::static_pointer_cast<ArrayIndexNode>(n);
+                    auto array = expression(index->array);
+                    auto i = expression(index->index);
+                    auto& type = typeOf(array);
+                    auto element = type->type == Ty::TY_ARRAY ? module->type(std::static_pointer_cast<TyArray>(type)->arrayOf) : unknownType;
+                    return emit(IR_GETINDEX, element, array, i);
+                }
+                case NODE_ARRAYCONSTRUCTOR:
+                {
+                    auto array = std::static_pointer_cast<ArrayConstructorNode>(n);
+                    std::vector<uint32_t> values;
+                    for(auto& v : array->values)
+                    {
+                        if(v->nodeType == NODE_ELLIPSE)
+                        {
+                            unsupported(v, "remainder patterns cannot be lowered yet");
+                            continue;
+                        }
+                        values.push_back(expression(v));
+                    }
+                    auto element = values.empty() ? module->types[unknownType] : typeOf(values[0]);
+                    return emit(IR_ARRAY, module->type(std::make_shared<TyArray>(element, std::optional<size_t>())), values);
+                }
+                case NODE_TUPLE:
+                {
+                    auto tuple = std::static_pointer_cast<TupleConstructorNode>(n);
+                    std::vector<uint32_t> values;
+                    std::vector<std::shared_ptr<Ty>> types;
+                    for(auto& v : tuple->values)
+                    {
+                        values.push_back(expression(v));
+                        types.push_back(typeOf(values.back()));
+                    }
+                    return emit(IR_RECORD, module->type(std::make_shared<TyTuple>(types)), values, tupleLayout(values.size()));
+                }
+                case NODE_LISTINIT:
+                {
+                    auto init = std::static_pointer_cast<ListInitNode>(n);
+                    auto s = scope;
+                    auto typeExpr = init->type;
+                    while(typeExpr != nullptr && typeExpr->nodeType == NODE_NAMESPACE)
+                    {
+                        auto ns = std::static_pointer_cast<NamespaceNode>(typeExpr);
+                        s = getNamespaceScope(ns->name, s);
+                        typeExpr = ns->expr;
+                    }
+                    std::shared_ptr<StructDeclarationNode> sd = nullptr;
+                    if(typeExpr != nullptr && typeExpr->nodeType == NODE_TYPE) sd = findStruct(declarationName(std::static_pointer_cast<TypeNode>(typeExpr)->type), s);
+                    if(sd == nullptr || sd->fields.size() != init->values.size())
+                    {
+                        unsupported(n, "struct initializer cannot be lowered");
+                        return emit(IR_UNDEF, unknownType);
+                    }
+                    //values are computed in source order and stored in field order
+                    std::vector<uint32_t> values(sd->fields.size(), irNone);
+                    bool named = init->fieldNames.size() == init->values.size();
+                    for(size_t i = 0; i < init->values.size(); i++)
+                    {
+                        auto index = i;
+                        if(named) index = sd->field(intern(std::string_view(init->fieldNames[i].start, init->fieldNames[i].length)))->index;
+                        values[index] = expression(init->values[i]);
+                    }
+                    return emit(IR_RECORD, typeIndex(sd->typeDefined), values, layoutOf(sd));
+                }
+                case NODE_LAMBDA: return lambda(std::static_pointer_cast<LambdaNode>(n));
+                default:
+                {
+                    unsupported(n, "expression cannot be lowered yet");
+                    return emit(IR_UNDEF, unknownType);
+                }
+            }
+        }
+
+        //patterns
+
+        //type of field `index` of a tuple of type `tuple`
+        uint32_t fieldType(uint32_t tuple, size_t index)
+        {
+            auto& t = module->types[tuple];
+            return t->type == Ty::TY_TUPLE && index < std::static_pointer_cast<TyTuple>(t)->types.size() ? module->type(std::static_pointer_cast<TyTuple>(t)->types[index]) : unknownType;
+        }
+
+        uint32_t tupleField(uint32_t tuple, size_t index)
+        {
+            return emit(IR_GETFIELD, fieldType(function().instructions[tuple].type, index), tuple, field(intern(std::to_string(index)), (uint32_t)index));
+        }
+
+        //binds the names `p` introduces and tests that `value` matches it, going to `fail` when it
+        //does not; irNone for a pattern that must not be refutable
+        void pattern(const std::shared_ptr<node>& p, uint32_t value, uint32_t fail)
+        {
+            module->sourceNodes++;
+            if(!reachable()) return;
+            switch(p->nodeType)
+            {
+                case NODE_PLACEHOLDER: break;
+                case NODE_IDENTIFIER:
+                {
+                    auto variable = newVariable(tokenToString(std::static_pointer_cast<VariableNode>(p)->variable), function().instructions[value].type);
+                    write(variable, state->block, value);
+                    break;
+                }
+                case NODE_LITERAL:
+                {
+                    auto k = literal(std::static_pointer_cast<LiteralNode>(p));
+                    test(emit(IR_EQ, boolType, value, k), fail, p);
+                    break;
+                }
+                case NODE_TYPE:
+                case NODE_NAMESPACE:
+                case NODE_FUNCTIONCALL:
+                {
+                    auto fc = p->nodeType == NODE_FUNCTIONCALL ? std::static_pointer_cast<FunctionCallNode>(p) : nullptr;
+                    auto ref = resolve(fc != nullptr ? fc->called : p, scope, true);
+                    if(ref.kind != REF_CONSTRUCTOR)
+                    {
+                        unsupported(p, "pattern is not a union member");
+                        break;
+                    }
+                    auto tag = emit(IR_TAG, intType, value);
+                    auto k = emit(IR_CONST, intType, constant(CONST_INT, ref.tag));
+                    test(emit(IR_EQ, boolType, tag, k), fail, p);
+                    if(fc == nullptr || fc->args.empty() || !reachable()) break;
+                    auto& member = ref.ud->members[ref.tag];
+                    auto payload = emit(IR_PAYLOAD, typeIndex(member.type), value);
+                    if(fc->args.size() == 1)
+                    {
+                        pattern(fc->args[0], payload, fail);
+                        break;
+                    }
+                    for(size_t i = 0; i < fc->args.size(); i++) pattern(fc->args[i], tupleField(payload, i), fail);
+                    break;
+                }
+                case NODE_TUPLE:
+                {
+                    auto tuple = std::static_pointer_cast<TupleConstructorNode>(p);
+                    for(size_t i = 0; i < tuple->values.size(); i++) pattern(tuple->values[i], tupleField(value, i), fail);
+                    break;
+                }
+                case NODE_RANGE:
+                {
+                    auto range = std::static_pointer_cast<RangePatternNode>(p);
+                    auto low = expression(range->expression1);
+                    auto high = expression(range->expression2);
+                    test(emit(IR_LE, boolType, low, value), fail, p);
+                    if(reachable()) test(emit(range->isInclusive ? IR_LE : IR_LT, boolType, value, high), fail, p);
+                    break;
+                }
+                default: unsupported(p, "pattern cannot be lowered yet"); break;
+            }
+        }
+
+        //a literal as a pattern: a range of one Int, Char or Bool, or a String to compare with
+        bool literalPattern(const std::shared_ptr<LiteralNode>& lit, MatchPattern& out)
+        {
+            auto& t = lit->value;
+            out.kind = MATCH_RANGE;
+            switch(t.type)
+            {
+                case TokenTypes::_TRUE:
+                case TokenTypes::_FALSE: out.bounds = CONST_BOOL; out.low = t.type == TokenTypes::_TRUE ? 1 : 0; break;
+                case TokenTypes::INT:
+                case TokenTypes::HEX_INT:
+                case TokenTypes::OCT_INT:
+                case TokenTypes::BIN_INT: out.bounds = CONST_INT; out.low = integerLiteral(t); break;
+                case TokenTypes::CHAR:
+                {
+                    if(t.length < 3) return false;
+                    out.bounds = CONST_CHAR;
+                    out.low = (unsigned char)t.start[1];
+                    break;
+                }
+                case TokenTypes::STRING:
+                {
+                    out.kind = MATCH_EQUAL;
+                    out.constant = stringConstant(stringLiteral(t));
+                    return true;
+                }
+                //doubles compare equal without being the same constant, as 0.0 and -0.0 do
+                default: return false;
+            }
+            out.high = out.low;
+            return true;
+        }
+
+        //what `p` tests of a value of type `type`, for the match compiler. false for a pattern it
+        //cannot take, such as a range whose bounds are not literals
+        bool normalize(const std::shared_ptr<node>& p, uint32_t type, MatchPattern& out)
+        {
+            module->sourceNodes++;
+            out = MatchPattern{MATCH_ANY, type, 0, 0, 0, 0, CONST_INT, 0, {}};
+            switch(p->nodeType)
+            {
+                case NODE_PLACEHOLDER:
+                case NODE_IDENTIFIER: return true;
+                case NODE_LITERAL: return literalPattern(std::static_pointer_cast<LiteralNode>(p), out);
+                case NODE_RANGE:
+                {
+                    auto range = std::static_pointer_cast<RangePatternNode>(p);
+                    if(range->expression1 == nullptr || range->expression1->nodeType != NODE_LITERAL) return false;
+                    if(range->expression2 == nullptr || range->expression2->nodeType != NODE_LITERAL) return false;
+                    MatchPattern high{MATCH_ANY, type, 0, 0, 0, 0, CONST_INT, 0, {}};
+                    if(!literalPattern(std::static_pointer_cast<LiteralNode>(range->expression1), out) || !literalPattern(std::static_pointer_cast<LiteralNode>(range->expression2), high)) return false;
+                    if(out.kind != MATCH_RANGE || high.kind != MATCH_RANGE || out.bounds != high.bounds) return false;
+                    out.high = high.low;
+                    if(!range->isInclusive)
+                    {
+                        //an exclusive range can be empty even at the bottom of Int
+                        if(out.high == INT64_MIN) out.low = 0, out.high = -1;
+                        else out.high--;
+                    }
+                    return true;
+                }
+                case NODE_TYPE:
+                case NODE_NAMESPACE:
+                case NODE_FUNCTIONCALL:
+                {
+                    auto fc = p->nodeType == NODE_FUNCTIONCALL ? std::static_pointer_cast<FunctionCallNode>(p) : nullptr;
+                    auto ref = resolve(fc != nullptr ? fc->called : p, scope, true);
+                    if(ref.kind != REF_CONSTRUCTOR) return false;
+                    out.kind = MATCH_MEMBER;
+                    out.tag = ref.tag;
+                    out.members = (uint32_t)ref.ud->members.size();
+                    if(fc == nullptr || fc->args.empty()) return true;
+                    auto payloadType = typeIndex(ref.ud->members[ref.tag].type);
+                    out.fields.emplace_back();
+                    auto& payload = out.fields.back();
+                    if(fc->args.size() == 1) return normalize(fc->args[0], payloadType, payload);
+                    payload = MatchPattern{MATCH_TUPLE, payloadType, 0, 0, 0, 0, CONST_INT, 0, std::vector<MatchPattern>(fc->args.size())};
+                    for(size_t i = 0; i < fc->args.size(); i++)
+                    {
+                        if(!normalize(fc->args[i], fieldType(payloadType, i), payload.fields[i])) return false;
+                    }
+                    return true;
+                }
+                case NODE_TUPLE:
+                {
+                    auto tuple = std::static_pointer_cast<TupleConstructorNode>(p);
+                    out.kind = MATCH_TUPLE;
+                    out.fields.resize(tuple->values.size());
+                    for(size_t i = 0; i < tuple->values.size(); i++)
+                    {
+                        if(!normalize(tuple->values[i], fieldType(type, i), out.fields[i])) return false;
+                    }
+                    return true;
+                }
+                default: return false;
+            }
+        }
+
+        static bool bindsNames(const std::shared_ptr<node>& p)
+        {
+            switch(p->nodeType)
+            {
+                case NODE_IDENTIFIER: return true;
+                case NODE_FUNCTIONCALL:
+                {
+                    auto& args = std::static_pointer_cast<FunctionCallNode>(p)->args;
+                    return std::any_of(args.begin(), args.end(), bindsNames);
+                }
+                case NODE_TUPLE:
+                {
+                    auto& values = std::static_pointer_cast<TupleConstructorNode>(p)->values;
+                    return std::any_of(values.begin(), values.end(), bindsNames);
+                }
+                default: return false;
+            }
+        }
+
+        //binds the names `p` introduces to the parts of `value`, which is known to match it
+        void bind(const std::shared_ptr<node>& p, uint32_t value)
+        {
+            if(!bindsNames(p)) return;
+            switch(p->nodeType)
+            {
+                case NODE_IDENTIFIER:
+                {
+                    auto variable = newVariable(tokenToString(std::static_pointer_cast<VariableNode>(p)->variable), function().instructions[value].type);
+                    write(variable, state->block, value);
+                    break;
+                }
+                case NODE_FUNCTIONCALL:
+                {
+                    auto fc = std::static_pointer_cast<FunctionCallNode>(p);
+                    auto ref = resolve(fc->called, scope, true);
+                    auto payload = emit(IR_PAYLOAD, typeIndex(ref.ud->members[ref.tag].type), value);
+                    if(fc->args.size() == 1) bind(fc->args[0], payload);
+                    else for(size_t i = 0; i < fc->args.size(); i++) bind(fc->args[i], tupleField(payload, i));
+                    break;
+                }
+                case NODE_TUPLE:
+                {
+                    auto tuple = std::static_pointer_cast<TupleConstructorNode>(p);
+                    for(size_t i = 0; i < tuple->values.size(); i++) bind(tuple->values[i], tupleField(value, i));
+                    break;
+                }
+                default: break;
+            }
+        }
+
+        //ends the block in a switch on an Int or Char over (constant, block) cases
+        void switchTo(uint32_t value, const std::vector<std::pair<uint32_t, uint32_t>>& cases, uint32_t fallback)
+        {
+            auto& f = function();
+            auto offset = (uint32_t)f.operands.size();
+            f.operands.push_back(fallback);
+            for(auto& c : cases)
+            {
+                f.operands.push_back(c.first);
+                f.operands.push_back(c.second);
+            }
+            emit(IR_SWITCH, voidType, value, offset, (uint32_t)cases.size());
+            std::vector<uint32_t> next;
+            successors(f, state->block, next);
+            for(auto s : next) f.blocks[s].predecessors.push_back(state->block);
+            state->block = irNone;
+        }
+
+        void branchTo(uint32_t condition, uint32_t ifTrue, uint32_t ifFalse)
+        {
+            if(ifTrue == ifFalse) jump(ifTrue);
+            else branch(condition, ifTrue, ifFalse);
+        }
+
+        //a decision tree being lowered: the blocks of the cases' bodies and the end of the switch,
+        //and the value of every occurrence the path to the current node has computed
+        struct Decision {
+            const MatchTree& tree;
+            const std::vector<uint32_t>& bodies;
+            uint32_t end;
+        };
+
+        uint32_t occurrence(const Decision& d, uint32_t o, std::vector<uint32_t>& values)
+        {
+            if(values[o] != irNone) return values[o];
+            auto& occ = d.tree.occurrences[o];
+            auto parent = occurrence(d, occ.parent, values);
+            if(occ.step == MATCH_MEMBER) values[o] = emit(IR_PAYLOAD, occ.type, parent);
+            else values[o] = emit(IR_GETFIELD, occ.type, parent, field(intern(std::to_string(occ.index)), occ.index));
+            return values[o];
+        }
+
+        //the block that runs `node`: the body of a case, the end of the switch, or a new block for a
+        //test, which is lowered after the node that goes to it
+        uint32_t entry(const Decision& d, uint32_t node, std::vector<std::pair<uint32_t, uint32_t>>& pending)
+        {
+            auto& n = d.tree.nodes[node];
+            if(n.kind == MATCH_LEAF) return d.bodies[n.target];
+            if(n.kind == MATCH_FAIL) return d.end;
+            for(auto& p : pending)
+            {
+                if(p.first == node) return p.second;
+            }
+            pending.emplace_back(node, newBlock(false));
+            return pending.back().second;
+        }
+
+        //a binary search over the ranges segments[first, last) of a value's node, which turns into
+        //a jump table where the values that do not go to the fallback are dense enough
+        void search(const Decision& d, const std::vector<MatchEdge>& segments, size_t first, size_t last, uint32_t fallback, uint32_t value, IrConstantKind bounds, std::vector<std::pair<uint32_t, uint32_t>>& pending)
+        {
+            if(last - first == 1)
+            {
+                jump(entry(d, segments[first].node, pending));
+                return;
+            }
+            auto low = first, high = last - 1;
+            while(low < high && segments[low].node == fallback) low++;
+            while(high > low && segments[high].node == fallback) high--;
+            uint64_t span = (uint64_t)segments[high].high - (uint64_t)segments[low].low + 1;
+            uint64_t covered = 0;
+            size_t cases = 0;
+            for(auto k = low; k <= high; k++)
+            {
+                if(segments[k].node == fallback) continue;
+                covered += (uint64_t)segments[k].high - (uint64_t)segments[k].low + 1;
+                cases++;
+            }
+            if(fallback != irNone && cases >= minTableCases && span <= maxTableSpan && covered * 10 >= span * 4)
+            {
+                std::vector<std::pair<uint32_t, uint32_t>> table;
+                for(auto k = low; k <= high; k++)
+                {
+                    if(segments[k].node == fallback) continue;
+                    auto target = entry(d, segments[k].node, pending);
+                    for(auto v = segments[k].low;; v++)
+                    {
+                        table.emplace_back(constant(bounds, (uint64_t)v), target);
+                        if(v == segments[k].high) break;
+                    }
+                }
+                switchTo(value, table, entry(d, fallback, pending));
+                return;
+            }
+            auto middle = (first + last) / 2;
+            auto bound = emit(IR_CONST, function().instructions[value].type, constant(bounds, (uint64_t)segments[middle].low));
+            auto below = emit(IR_LT, boolType, value, bound);
+            auto left = middle - first == 1 ? entry(d, segments[first].node, pending) : newBlock(true);
+            auto right = last - middle == 1 ? entry(d, segments[middle].node, pending) : newBlock(true);
+            branch(below, left, right);
+            if(middle - first > 1)
+            {
+                enter(left);
+                search(d, segments, first, middle, fallback, value, bounds, pending);
+            }
+            if(last - middle > 1)
+            {
+                enter(right);
+                search(d, segments, middle, last, fallback, value, bounds, pending);
+            }
+        }
+
+        void decide(const Decision& d, uint32_t node, std::vector<uint32_t> values)
+        {
+            auto& n = d.tree.nodes[node];
+            std::vector<std::pair<uint32_t, uint32_t>> pending;
+            switch(n.kind)
+            {
+                case MATCH_LEAF:
+                case MATCH_FAIL: jump(entry(d, node, pending)); return;
+                case MATCH_TAG:
+                {
+                    auto tag = emit(IR_TAG, intType, occurrence(d, n.occurrence, values));
+                    //when every member has an edge, the last one is taken by default
+                    auto edges = n.edges.size();
+                    auto fallback = n.fallback;
+                    if(fallback == irNone) fallback = n.edges[--edges].node;
+                    std::vector<std::pair<uint32_t, uint32_t>> cases;
+                    for(size_t k = 0; k < edges; k++) cases.emplace_back(constant(CONST_INT, (uint64_t)n.edges[k].low), entry(d, n.edges[k].node, pending));
+                    if(cases.empty()) jump(entry(d, fallback, pending));
+                    else switchTo(tag, cases, entry(d, fallback, pending));
+                    break;
+                }
+                case MATCH_VALUE:
+                {
+                    auto value = occurrence(d, n.occurrence, values);
+                    int64_t lowest = INT64_MIN, highest = INT64_MAX;
+                    if(n.bounds == CONST_BOOL) lowest = 0, highest = 1;
+                    else if(n.bounds == CONST_CHAR) lowest = 0, highest = UINT32_MAX;
+                    //every value, in ranges that go to the fallback between the edges
+                    std::vector<MatchEdge> segments;
+                    auto add = [&](int64_t low, int64_t high, uint32_t to)
+                    {
+                        if(!segments.empty() && segments.back().node == to) segments.back().high = high;
+                        else segments.push_back(MatchEdge{low, high, to});
+                    };
+                    auto next = lowest;
+                    bool done = false;
+                    for(auto& e : n.edges)
+                    {
+                        if(e.low > next) add(next, e.low - 1, n.fallback);
+                        add(e.low, e.high, e.node);
+                        done = e.high == highest;
+                        if(!done) next = e.high + 1;
+                    }
+                    if(!done) add(next, highest, n.fallback);
+                    if(n.bounds == CONST_BOOL && segments.size() == 2) branchTo(value, entry(d, segments[1].node, pending), entry(d, segments[0].node, pending));
+                    else search(d, segments, 0, segments.size(), n.fallback, value, n.bounds, pending);
+                    break;
+                }
+                case MATCH_CONSTANT:
+                {
+                    auto value = occurrence(d, n.occurrence, values);
+                    for(size_t k = 0; k < n.edges.size(); k++)
+                    {
+                        auto k_ = emit(IR_CONST, function().instructions[value].type, (uint32_t)n.edges[k].low);
+                        auto last = k + 1 == n.edges.size();
+                        auto otherwise = last ? entry(d, n.fallback, pending) : newBlock(true);
+                        branchTo(emit(IR_EQ, boolType, value, k_), entry(d, n.edges[k].node, pending), otherwise);
+                        if(!last) enter(otherwise);
+                    }
+                    break;
+                }
+            }
+            for(auto& p : pending)
+            {
+                seal(p.second);
+                enter(p.second);
+                decide(d, p.first, values);
+            }
+        }
+
+        //lowers a switch to the decision tree of its cases and reports the cases no value reaches
+        //and the values no case matches. when the tree makes more tests than trying the cases one
+        //after another, which can test a value more than once but never copies a test, the switch
+        //is left to switchCases. false when it is, or when the cases have patterns the match
+        //compiler cannot take
+        bool matchCases(const std::shared_ptr<SwitchStatementNode>& _switch, uint32_t value)
+        {
+            auto counted = module->sourceNodes;
+            auto type = function().instructions[value].type;
+            std::vector<MatchPattern> cases(_switch->cases.size());
+            bool normalized = true;
+            auto savedScope = scope;
+            for(size_t i = 0; i < cases.size() && normalized; i++)
+            {
+                scope = std::static_pointer_cast<CaseNode>(_switch->cases[i])->scope;
+                normalized = normalize(std::static_pointer_cast<CaseNode>(_switch->cases[i])->caseExpr, type, cases[i]);
+            }
+            scope = savedScope;
+            MatchTree tree;
+            if(!normalized || !compileMatch(cases, type, maxMatchNodes + 16 * cases.size(), tree))
+            {
+                module->sourceNodes = counted;
+                return false;
+            }
+            for(size_t i = 0; i < cases.size(); i++)
+            {
+                auto& c = std::static_pointer_cast<CaseNode>(_switch->cases[i])->caseExpr;
+                if(!tree.reached[i]) diagnostics.report(DIAG_REDUNDANT_CASE, SEVERITY_WARNING, c->start, c->end, "case is never reached: the cases before it match everything it does", {}, (int)lineOf(c->start));
+            }
+            if(!tree.exhaustive) diagnostics.report(DIAG_NONEXHAUSTIVE_MATCH, SEVERITY_WARNING, _switch->switchExpr->start, _switch->switchExpr->end, "switch has no case for some values of type {}", {typeOf(value)}, (int)line);
+            if(tree.tests > tree.sequentialTests)
+            {
+                module->sourceNodes = counted;
+                return false;
+            }
+
+            std::vector<uint32_t> bodies;
+            for(size_t i = 0; i < cases.size(); i++) bodies.push_back(newBlock(false));
+            auto end = newBlock(false);
+            std::vector<uint32_t> values(tree.occurrences.size(), irNone);
+            values[0] = value;
+            decide(Decision{tree, bodies, end}, tree.root, values);
+            for(size_t i = 0; i < cases.size(); i++)
+            {
+                seal(bodies[i]);
+                enter(bodies[i]);
+                if(!reachable()) continue;
+                auto _case = std::static_pointer_cast<CaseNode>(_switch->cases[i]);
+                auto savedLocals = state->locals.size();
+                line = lineOf(_case->start);
+                scope = _case->scope;
+                bind(_case->caseExpr, value);
+                statement(_case->caseStmt);
+                if(reachable()) jump(end);
+                scope = savedScope;
+                state->locals.resize(savedLocals);
+            }
+            seal(end);
+            enter(end);
+            return true;
+        }
+
+        //tests the cases one after another, going on to the next when a test fails
+        void switchCases(const std::shared_ptr<SwitchStatementNode>& _switch, uint32_t value)
+        {
+            auto end = newBlock(false);
+            for(auto& c : _switch->cases)
+            {
+                if(!reachable()) break;
+                auto _case = std::static_pointer_cast<CaseNode>(c);
+                auto savedScope = scope;
+                auto savedLocals = state->locals.size();
+                auto fail = newBlock(false);
+                line = lineOf(c->start);
+                scope = _case->scope;
+                pattern(_case->caseExpr, value, fail);
+                statement(_case->caseStmt);
+                if(reachable()) jump(end);
+                seal(fail);
+                enter(fail);
+                scope = savedScope;
+                state->locals.resize(savedLocals);
+            }
+            if(reachable()) jump(end);
+            seal(end);
+            enter(end);
+        }
+
+        //statements
+
+        void block(const std::shared_ptr<BlockStatementNode>& b)
+        {
+            auto savedScope = scope;
+            auto savedLocals = state->locals.size();
+            scope = b->scope;
+            for(auto& dec : b->declarations) statement(dec);
+            scope = savedScope;
+            state->locals.resize(savedLocals);
+        }
+
+        void variable(const std::shared_ptr<VariableDeclarationNode>& vd)
+        {
+            uint32_t value;
+            if(vd->value != nullptr) value = expression(vd->value);
+            else value = emit(IR_UNDEF, typeIndex(vd->type));
+            if(vd->assigned->nodeType == NODE_IDENTIFIER)
+            {
+                auto name = tokenToString(std::static_pointer_cast<VariableNode>(vd->assigned)->variable);
+                auto g = globals.find(scope.get());
+                if(g != globals.end() && g->second.count(name) != 0)
+                {
+                    emit(IR_SETGLOBAL, voidType, g->second.at(name), value);
+                    return;
+                }
+                //the declared type, unless the value says more
+                auto declared = vd->identifiers.count(name) != 0 ? typeIndex(vd->identifiers.at(name)) : unknownType;
+                auto& declaredType = module->types[declared];
+                auto type = declaredType->type == Ty::TY_VAR ? function().instructions[value].type : declared;
+                write(newVariable(name, type), state->block, value);
+                return;
+            }
+            pattern(vd->assigned, value, irNone);
+        }
+
+        void statement(const std::shared_ptr<node>& n)
+        {
+            if(n == nullptr || !reachable()) return;
+            module->sourceNodes++;
+            line = lineOf(n->start);
+            switch(n->nodeType)
+            {
+                case NODE_FUNCTIONDECL:
+                case NODE_STRUCTDECL:
+                case NODE_UNIONDECL:
+                case NODE_TYPEDEF:
+                case NODE_CLASSDECL:
+                case NODE_CLASSIMPL:
+                    break;
+                case NODE_MODULE:
+                {
+                    auto md = std::static_pointer_cast<ModuleDeclarationNode>(n);
+                    if(md->interface == nullptr && md->block != nullptr && md->block->nodeType == NODE_BLOCK) block(std::static_pointer_cast<BlockStatementNode>(md->block));
+                    break;
+                }
+                case NODE_BLOCK: block(std::static_pointer_cast<BlockStatementNode>(n)); break;
+                case NODE_VARIABLEDECL: variable(std::static_pointer_cast<VariableDeclarationNode>(n)); break;
+                case NODE_IF:
+                {
+                    auto _if = std::static_pointer_cast<IfStatementNode>(n);
+                    auto condition = expression(_if->branchExpr);
+                    auto thenBlock = newBlock(true);
+                    auto elseBlock = _if->elseStmt != nullptr ? newBlock(true) : irNone;
+                    auto join = newBlock(false);
+                    branch(condition, thenBlock, elseBlock != irNone ? elseBlock : join);
+                    enter(thenBlock);
+                    statement(_if->thenStmt);
+                    if(reachable()) jump(join);
+                    if(elseBlock != irNone)
+                    {
+                        enter(elseBlock);
+                        statement(_if->elseStmt);
+                        if(reachable()) jump(join);
+                    }
+                    seal(join);
+                    enter(join);
+                    break;
+                }
+                case NODE_WHILE:
+                {
+                    auto _while = std::static_pointer_cast<WhileStatementNode>(n);
+                    auto header = newBlock(false);
+                    auto body = newBlock(true);
+                    auto exit = newBlock(false);
+                    jump(header);
+                    enter(header);
+                    branch(expression(_while->loopExpr), body, exit);
+                    enter(body);
+                    state->loops.push_back(Loop{exit, header});
+                    statement(_while->loopStmt);
+                    state->loops.pop_back();
+                    if(reachable()) jump(header);
+                    seal(header);
+                    seal(exit);
+                    enter(exit);
+                    break;
+                }
+                case NODE_FOR:
+                {
+                    auto _for = std::static_pointer_cast<ForStatementNode>(n);
+                    auto savedLocals = state->locals.size();
+                    if(_for->initExpr != nullptr)
+                    {
+                        if(_for->initExpr->nodeType == NODE_VARIABLEDECL) statement(_for->initExpr);
+                        else expression(_for->initExpr);
+                    }
+                    auto header = newBlock(false);
+                    auto body = newBlock(true);
+                    auto increment = newBlock(false);
+                    auto exit = newBlock(false);
+                    jump(header);
+                    enter(header);
+                    if(_for->condExpr != nullptr) branch(expression(_for->condExpr), body, exit);
+                    else jump(body);
+                    enter(body);
+                    state->loops.push_back(Loop{exit, increment});
+                    statement(_for->loopStmt);
+                    state->loops.pop_back();
+                    if(reachable()) jump(increment);
+                    seal(increment);
+                    enter(increment);
+                    if(reachable())
+                    {
+                        line = lineOf(n->start);
+                        if(_for->incrementExpr != nullptr) expression(_for->incrementExpr);
+                        jump(header);
+                    }
+                    seal(header);
+                    seal(exit);
+                    enter(exit);
+                    state->locals.resize(savedLocals);
+                    break;
+                }
+                case NODE_SWITCH:
+                {
+                    auto _switch = std::static_pointer_cast<SwitchStatementNode>(n);
+                    auto value = expression(_switch->switchExpr);
+                    if(reachable() && !matchCases(_switch, value)) switchCases(_switch, value);
+                    break;
+                }
+                case NODE_RETURN:
+                {
+                    auto ret = std::static_pointer_cast<ReturnStatementNode>(n);
+                    if(state->index == module->init)
+                    {
+                        unsupported(n, "return outside of a function");
+                        break;
+                    }
+                    //a call returned here comes right before the return, which makes it a tail call
+                    emit(IR_RETURN, voidType, ret->returnExpr != nullptr ? expression(ret->returnExpr) : irNone);
+                    state->block = irNone;
+                    break;
+                }
+                case NODE_BREAK:
+                case NODE_CONTINUE:
+                {
+                    if(state->loops.empty())
+                    {
+                        unsupported(n, n->nodeType == NODE_BREAK ? "break outside of a loop" : "continue outside of a loop");
+                        break;
+                    }
+                    auto& loop = state->loops.back();
+                    jump(n->nodeType == NODE_BREAK ? loop.breakTarget : loop.continueTarget);
+                    break;
+                }
+                default: expression(n); break;
+            }
+        }
+
+        void lowerFunction(const std::shared_ptr<FunctionDeclarationNode>& fd, const std::shared_ptr<ScopeNode>& declaredIn)
+        {
+            FunctionState fs{functions.at(fd.get()), {}, {}, irNone, {}, {}, {}, {}, nullptr, {}, {}};
+            state = &fs;
+            scope = declaredIn;
+            line = lineOf(fd->start);
+            enter(newBlock(true));
+            auto& params = function().params;
+            uint32_t index = 0;
+            for(auto& p : fd->params)
+            {
+                if(p.identifier.length == 0) continue;
+                auto type = params[index];
+                auto variable = newVariable(tokenToString(p.identifier), type);
+                write(variable, state->block, emit(IR_PARAM, type, index++));
+            }
+            statement(fd->body);
+            if(reachable()) emit(IR_RETURN, voidType);
+            finish();
+            state = nullptr;
+        }
+
+        std::shared_ptr<IrModule> lower()
+        {
+            module->init = addFunction("<toplevel>", {}, voidType, false);
+            for(auto& dec : program->declarations) declare(dec, program->globalScope, true, "");
+
+            FunctionState toplevel{module->init, {}, {}, irNone, {}, {}, {}, {}, nullptr, {}, {}};
+            state = &toplevel;
+            scope = program->globalScope;
+            enter(newBlock(true));
+            for(auto& dec : program->declarations) statement(dec);
+            if(reachable()) emit(IR_RETURN, voidType);
+            finish();
+            state = nullptr;
+
+            for(size_t i = 0; i < bodies.size(); i++) lowerFunction(bodies[i].first, bodies[i].second);
+
+            auto main = program->globalScope->functions.find("main");
+            if(main != program->globalScope->functions.end())
+            {
+                auto index = functions.find(main->second.get());
+                if(index != functions.end() && !module->functions[index->second].external && module->functions[index->second].params.empty()) module->main = index->second;
+            }
+            return failed ? nullptr : module;
+        }
+    };
+
+    std::shared_ptr<IrModule> lowerProgram(std::shared_ptr<ProgramNode> program, const char* source, DiagnosticEngine& diagnostics)
+    {
+        Lowering lowering(program, source, diagnostics);
+        return lowering.lower();
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef lower_header
+#define lower_header
+
+#include <memory>
+#include "ir.h"
+#include "parser.h"
+
+namespace pilaf {
+    //lowers an analyzed program to SSA form. local variables become values joined by phis, so
+    //only globals, fields and array elements live in memory; every value is typed with the solved
+    //type of the expression it came from. top-level statements become the module's init function,
+    //and functions declared without a body become external ones under their declared name.
+    //instructions remember the line of `source` they came from. code the IR cannot express yet
+    //is reported to `diagnostics` and makes the result null
+    std::shared_ptr<IrModule> lowerProgram(std::shared_ptr<ProgramNode> program, const char* source, DiagnosticEngine& diagnostics);
+}
+#endif
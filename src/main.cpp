@@ -1,8 +1,10 @@
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
 
 #include "compiler.h"
 namespace pilaf {
-	static void repl()
+	static void repl(const CompileOptions& options)
 	{
 		std::cout << "To execute your code, type '-eval' on a new line after the end of your block.\n";
 		std::string source;
@@ -21,7 +23,7 @@ namespace pilaf {
 			std::getline(std::cin, line);
 			if(line.compare("-eval") == 0)
 			{
-				bool result = compile(source);
+				bool result = compile(source, options);
 				std::cout << "\n" << (result ? "COMPILE_SUCCESS" : "COMPILE_FAILURE") << std::endl;
 				source.clear();
 				std::cout << "> ";
@@ -67,28 +69,139 @@ namespace pilaf {
 		return buffer;
 	}
 
-	static void runFile(const char* path)
+	static void runFile(const char* path, const CompileOptions& options)
 	{
 		char* source = readFile(path);
-		bool result = compile(source);
+		bool result = compile(source, options);
 		printf("%s", result ? "COMPILE_SUCCESS" : "COMPILE_FAILURE");
 		free(source);
 	}
+
+	static int executeFile(const char* path, const CompileOptions& options)
+	{
+		char* source = readFile(path);
+		int status = run(source, options);
+		free(source);
+		return status;
+	}
+
+	static int buildFile(const char* path, const CompileOptions& options, const char* output)
+	{
+		char* source = readFile(path);
+		int status = build(source, options, output);
+		free(source);
+		return status;
+	}
+}
+
+static void usage()
+{
+	fprintf(stderr, "Usage: pilaf [--cache-dir dir] [--diagnostics text|json] [--max-diagnostics n] [--max-nesting-depth n] [--lazy-bodies] [--check-signatures] [--parse-threads n] [--dump-ir] [--print-layouts] [-O0|-O1|-O2] [--time-report] [path] \n");
+	fprintf(stderr, "       pilaf run [--dump-bytecode] [--dump-ir] [--print-layouts] [-O0|-O1|-O2] [--jit-threshold n] [--time-report] [options] file\n");
+	fprintf(stderr, "       pilaf build [-o output[.c]] [--dump-ir] [--print-layouts] [-O0|-O1|-O2] [--time-report] [options] file\n");
+	exit(64);
 }
 
 int main(int argc, const char* argv[])
 {
-	if(argc == 1)
+	pilaf::CompileOptions options;
+	const char* path = nullptr;
+	bool execute = argc > 1 && strcmp(argv[1], "run") == 0;
+	bool compileAhead = argc > 1 && strcmp(argv[1], "build") == 0;
+	const char* output = "a.out";
+	//running or building a program prints what it prints, not the inference trace
+	if(execute || compileAhead) options.dumpConstraints = false;
+	for(int i = execute || compileAhead ? 2 : 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--cache-dir") == 0)
+		{
+			if(i + 1 == argc) usage();
+			options.interfaceCacheDir = argv[++i];
+		}
+		else if(strcmp(argv[i], "--diagnostics") == 0)
+		{
+			if(i + 1 == argc) usage();
+			i++;
+			if(strcmp(argv[i], "json") == 0) options.diagnosticFormat = pilaf::DIAGNOSTICS_JSON;
+			else if(strcmp(argv[i], "text") == 0) options.diagnosticFormat = pilaf::DIAGNOSTICS_TEXT;
+			else usage();
+		}
+		else if(strcmp(argv[i], "--max-diagnostics") == 0)
+		{
+			if(i + 1 == argc) usage();
+			options.maxDiagnostics = strtoul(argv[++i], nullptr, 10);
+		}
+		else if(strcmp(argv[i], "--max-nesting-depth") == 0)
+		{
+			if(i + 1 == argc) usage();
+			options.maxNestingDepth = strtoul(argv[++i], nullptr, 10);
+		}
+		else if(strcmp(argv[i], "--lazy-bodies") == 0)
+		{
+			options.lazyBodies = true;
+		}
+		else if(strcmp(argv[i], "--check-signatures") == 0)
+		{
+			options.signaturesOnly = true;
+		}
+		else if(strcmp(argv[i], "--parse-threads") == 0)
+		{
+			if(i + 1 == argc) usage();
+			options.parseThreads = strtoul(argv[++i], nullptr, 10);
+		}
+		else if(strcmp(argv[i], "--dump-bytecode") == 0 && execute)
+		{
+			options.dumpBytecode = true;
+		}
+		else if(strcmp(argv[i], "--jit-threshold") == 0 && execute)
+		{
+			if(i + 1 == argc) usage();
+			options.jitThreshold = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		}
+		else if(strcmp(argv[i], "-o") == 0 && compileAhead)
+		{
+			if(i + 1 == argc) usage();
+			output = argv[++i];
+		}
+		else if(strcmp(argv[i], "--dump-ir") == 0)
+		{
+			options.dumpIr = true;
+		}
+		else if(strcmp(argv[i], "--print-layouts") == 0)
+		{
+			options.printLayouts = true;
+		}
+		else if(strncmp(argv[i], "-O", 2) == 0 && argv[i][2] >= '0' && argv[i][2] <= '2' && argv[i][3] == '\0')
+		{
+			options.optLevel = argv[i][2] - '0';
+		}
+		else if(strcmp(argv[i], "--time-report") == 0)
+		{
+			options.timeReport = true;
+		}
+		else if(argv[i][0] != '-' && path == nullptr)
+		{
+			path = argv[i];
+		}
+		else usage();
+	}
+	if(execute)
 	{
-		pilaf::repl();
+		if(path == nullptr) usage();
+		return pilaf::executeFile(path, options);
 	}
-	else if (argc == 2)
+	if(compileAhead)
 	{
-		pilaf::runFile(argv[1]);
+		if(path == nullptr) usage();
+		return pilaf::buildFile(path, options, output);
 	}
-	else{
-		fprintf(stderr, "Usage: ctc [path] \n");
-		exit(64);
+	if(path == nullptr)
+	{
+		pilaf::repl(options);
+	}
+	else
+	{
+		pilaf::runFile(path, options);
 	}
 	return (0);
 }
\ No newline at end of file
@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include "match.h"
+
+namespace pilaf {
+    static const MatchPattern anything{MATCH_ANY, 0, 0, 0, 0, 0, CONST_INT, 0, {}};
+
+    //what is left to test of a case: a pattern for every occurrence the matrix has a column for
+    struct MatchRow {
+        std::vector<const MatchPattern*> patterns;
+        uint32_t action;
+    };
+
+    struct MatchCompiler {
+        MatchTree& tree;
+        size_t limit;
+        bool overflow;
+        uint32_t fail;
+        std::vector<uint32_t> leaves;
+        std::map<std::tuple<uint32_t, MatchPatternKind, uint32_t>, uint32_t> parts;
+
+        MatchCompiler(MatchTree& tree, size_t limit, size_t cases)
+        : tree(tree), limit(limit), overflow(false), fail(irNone), leaves(cases, irNone) {}
+
+        uint32_t add(MatchNode node)
+        {
+            if(tree.nodes.size() >= limit) overflow = true;
+            tree.nodes.push_back(std::move(node));
+            return (uint32_t)(tree.nodes.size() - 1);
+        }
+
+        uint32_t leaf(uint32_t action)
+        {
+            if(leaves[action] == irNone)
+            {
+                leaves[action] = add(MatchNode{MATCH_LEAF, irNone, CONST_INT, {}, irNone, action});
+                tree.reached[action] = true;
+            }
+            return leaves[action];
+        }
+
+        uint32_t failure()
+        {
+            if(fail == irNone) fail = add(MatchNode{MATCH_FAIL, irNone, CONST_INT, {}, irNone, irNone});
+            tree.exhaustive = false;
+            return fail;
+        }
+
+        //the payload of a member or a field of a tuple, shared by every path that looks at it
+        uint32_t part(uint32_t parent, MatchPatternKind step, uint32_t index, uint32_t type)
+        {
+            auto key = std::make_tuple(parent, step, index);
+            auto it = parts.find(key);
+            if(it != parts.end()) return it->second;
+            tree.occurrences.push_back(MatchOccurrence{parent, step, index, type});
+            auto occurrence = (uint32_t)(tree.occurrences.size() - 1);
+            parts.emplace(key, occurrence);
+            return occurrence;
+        }
+
+        //the rows that can match when the value in `column` passes a test, with the column replaced
+        //by `arity` columns for its parts. `fields` says whether a pattern other than a wildcard
+        //passes, and which patterns it has for the parts; wildcards match whatever the parts are
+        template<typename Fields>
+        static std::vector<MatchRow> specialize(const std::vector<MatchRow>& rows, size_t column, size_t arity, Fields fields)
+        {
+            std::vector<MatchRow> result;
+            for(auto& row : rows)
+            {
+                auto p = row.patterns[column];
+                const std::vector<MatchPattern>* parts = nullptr;
+                if(p->kind != MATCH_ANY && !fields(*p, parts)) continue;
+                MatchRow specialized{std::vector<const MatchPattern*>(row.patterns.begin(), row.patterns.begin() + column), row.action};
+                for(size_t k = 0; k < arity; k++) specialized.patterns.push_back(parts != nullptr && k < parts->size() ? &(*parts)[k] : &anything);
+                specialized.patterns.insert(specialized.patterns.end(), row.patterns.begin() + column + 1, row.patterns.end());
+                result.push_back(std::move(specialized));
+            }
+            return result;
+        }
+
+        //the rows that match whatever is in `column`, without it
+        static std::vector<MatchRow> otherwise(const std::vector<MatchRow>& rows, size_t column)
+        {
+            return specialize(rows, column, 0, [](const MatchPattern&, const std::vector<MatchPattern>*&) { return false; });
+        }
+
+        static std::vector<uint32_t> replace(const std::vector<uint32_t>& columns, size_t column, const std::vector<uint32_t>& parts)
+        {
+            std::vector<uint32_t> result(columns.begin(), columns.begin() + column);
+            result.insert(result.end(), parts.begin(), parts.end());
+            result.insert(result.end(), columns.begin() + column + 1, columns.end());
+            return result;
+        }
+
+        uint32_t build(const std::vector<MatchRow>& rows, const std::vector<uint32_t>& columns)
+        {
+            if(overflow) return 0;
+            if(rows.empty()) return failure();
+            //the first case decides what to test next: the first of its columns that is not a wildcard
+            size_t column = 0;
+            auto& first = rows[0].patterns;
+            while(column < columns.size() && first[column]->kind == MATCH_ANY) column++;
+            if(column == columns.size()) return leaf(rows[0].action);
+            auto& head = *first[column];
+            switch(head.kind)
+            {
+                case MATCH_TUPLE: return tuple(rows, columns, column, head);
+                case MATCH_MEMBER: return members(rows, columns, column, head);
+                case MATCH_RANGE: return ranges(rows, columns, column, head);
+                default: return constants(rows, columns, column);
+            }
+        }
+
+        //a tuple always matches its shape, so its fields become columns of their own
+        uint32_t tuple(const std::vector<MatchRow>& rows, const std::vector<uint32_t>& columns, size_t column, const MatchPattern& head)
+        {
+            std::vector<uint32_t> fields;
+            for(uint32_t k = 0; k < head.fields.size(); k++) fields.push_back(part(columns[column], MATCH_TUPLE, k, head.fields[k].type));
+            auto inner = specialize(rows, column, fields.size(), [](const MatchPattern& p, const std::vector<MatchPattern>*& parts)
+            {
+                parts = &p.fields;
+                return true;
+            });
+            return build(inner, replace(columns, column, fields));
+        }
+
+        uint32_t members(const std::vector<MatchRow>& rows, const std::vector<uint32_t>& columns, size_t column, const MatchPattern& head)
+        {
+            std::vector<uint32_t> tags;
+            for(auto& row : rows)
+            {
+                auto p = row.patterns[column];
+                if(p->kind == MATCH_MEMBER && std::find(tags.begin(), tags.end(), p->tag) == tags.end()) tags.push_back(p->tag);
+            }
+            std::sort(tags.begin(), tags.end());
+            MatchNode node{MATCH_TAG, columns[column], CONST_INT, {}, irNone, irNone};
+            for(auto tag : tags)
+            {
+                //the payload gets a column when some case looks at it
+                const MatchPattern* payload = nullptr;
+                for(auto& row : rows)
+                {
+                    auto p = row.patterns[column];
+                    if(p->kind != MATCH_MEMBER || p->tag != tag || p->fields.empty()) continue;
+                    payload = &p->fields[0];
+                    break;
+                }
+                std::vector<uint32_t> parts;
+                if(payload != nullptr) parts.push_back(part(columns[column], MATCH_MEMBER, tag, payload->type));
+                auto inner = specialize(rows, column, parts.size(), [&](const MatchPattern& p, const std::vector<MatchPattern>*& fields)
+                {
+                    fields = &p.fields;
+                    return p.tag == tag;
+                });
+                node.edges.push_back(MatchEdge{tag, tag, build(inner, replace(columns, column, parts))});
+            }
+            if(tags.size() < head.members) node.fallback = build(otherwise(rows, column), replace(columns, column, {}));
+            return add(std::move(node));
+        }
+
+        //the ranges of all the cases cut the values into intervals that every case takes whole or
+        //not at all, and each interval some case takes gets an edge
+        uint32_t ranges(const std::vector<MatchRow>& rows, const std::vector<uint32_t>& columns, size_t column, const MatchPattern& head)
+        {
+            int64_t lowest = INT64_MIN, highest = INT64_MAX;
+            if(head.bounds == CONST_BOOL) lowest = 0, highest = 1;
+            else if(head.bounds == CONST_CHAR) lowest = 0, highest = UINT32_MAX;
+            std::vector<int64_t> starts;
+            for(auto& row : rows)
+            {
+                auto p = row.patterns[column];
+                if(p->kind != MATCH_RANGE || p->low > p->high) continue;
+                starts.push_back(p->low);
+                if(p->high < highest) starts.push_back(p->high + 1);
+            }
+            std::sort(starts.begin(), starts.end());
+            starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+            MatchNode node{MATCH_VALUE, columns[column], head.bounds, {}, irNone, irNone};
+            bool gaps = starts.empty() || starts[0] > lowest;
+            auto without = replace(columns, column, {});
+            for(size_t i = 0; i < starts.size(); i++)
+            {
+                auto low = starts[i];
+                auto high = i + 1 < starts.size() ? starts[i + 1] - 1 : highest;
+                bool taken = false;
+                auto inner = specialize(rows, column, 0, [&](const MatchPattern& p, const std::vector<MatchPattern>*&)
+                {
+                    bool in = p.low <= low && low <= p.high;
+                    taken = taken || in;
+                    return in;
+                });
+                if(!taken)
+                {
+                    gaps = true;
+                    continue;
+                }
+                auto child = build(inner, without);
+                //neighbours that end up in the same place are one edge
+                if(!node.edges.empty() && node.edges.back().node == child && node.edges.back().high + 1 == low) node.edges.back().high = high;
+                else node.edges.push_back(MatchEdge{low, high, child});
+            }
+            if(gaps) node.fallback = build(otherwise(rows, column), without);
+            return add(std::move(node));
+        }
+
+        uint32_t constants(const std::vector<MatchRow>& rows, const std::vector<uint32_t>& columns, size_t column)
+        {
+            std::vector<uint32_t> seen;
+            for(auto& row : rows)
+            {
+                auto p = row.patterns[column];
+                if(p->kind == MATCH_EQUAL && std::find(seen.begin(), seen.end(), p->constant) == seen.end()) seen.push_back(p->constant);
+            }
+            MatchNode node{MATCH_CONSTANT, columns[column], CONST_INT, {}, irNone, irNone};
+            auto without = replace(columns, column, {});
+            for(auto constant : seen)
+            {
+                auto inner = specialize(rows, column, 0, [&](const MatchPattern& p, const std::vector<MatchPattern>*&) { return p.constant == constant; });
+                node.edges.push_back(MatchEdge{constant, constant, build(inner, without)});
+            }
+            node.fallback = build(otherwise(rows, column), without);
+            return add(std::move(node));
+        }
+    };
+
+    static size_t sequentialTests(const MatchPattern& p)
+    {
+        size_t tests = 0;
+        switch(p.kind)
+        {
+            case MATCH_MEMBER: tests = 1; break;
+            case MATCH_RANGE: tests = p.low == p.high ? 1 : 2; break;
+            case MATCH_EQUAL: tests = 1; break;
+            default: break;
+        }
+        for(auto& field : p.fields) tests += sequentialTests(field);
+        return tests;
+    }
+
+    bool compileMatch(const std::vector<MatchPattern>& cases, uint32_t type, size_t limit, MatchTree& tree)
+    {
+        tree = MatchTree{{MatchOccurrence{irNone, MATCH_ANY, 0, type}}, {}, irNone, true, std::vector<bool>(cases.size(), false), 0, 0};
+        MatchCompiler compiler(tree, limit, cases.size());
+        std::vector<MatchRow> rows;
+        for(uint32_t i = 0; i < cases.size(); i++)
+        {
+            rows.push_back(MatchRow{{&cases[i]}, i});
+            tree.sequentialTests += sequentialTests(cases[i]);
+        }
+        tree.root = compiler.build(rows, {0});
+        if(compiler.overflow) return false;
+        //a node with n ways out takes n - 1 two-way tests to pick one
+        for(auto& node : tree.nodes)
+        {
+            auto ways = node.edges.size() + (node.fallback != irNone ? 1 : 0);
+            if(ways > 1) tree.tests += ways - 1;
+        }
+        return true;
+    }
+}
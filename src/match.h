@@ -0,0 +1,97 @@
+#ifndef match_header
+#define match_header
+
+#include <cstdint>
+#include <vector>
+#include "ir.h"
+
+namespace pilaf {
+    //what a case of a switch tests, with names and syntax gone
+    enum MatchPatternKind : uint8_t {
+        //anything, bound to a name or not
+        MATCH_ANY,
+        //a union member; its payload's pattern is the only field, when the case looks at it
+        MATCH_MEMBER,
+        MATCH_TUPLE,
+        //an Int, Char or Bool from `low` to `high` inclusive; a literal is a range of one value
+        MATCH_RANGE,
+        //a value that can only be compared for equality, such as a String, equal to `constant`
+        MATCH_EQUAL
+    };
+
+    struct MatchPattern {
+        MatchPatternKind kind;
+        //type of the value the pattern is matched against
+        uint32_t type;
+        //the member, and how many the union has
+        uint32_t tag;
+        uint32_t members;
+        int64_t low;
+        int64_t high;
+        //what the bounds of a range are: CONST_INT, CONST_CHAR or CONST_BOOL
+        IrConstantKind bounds;
+        uint32_t constant;
+        std::vector<MatchPattern> fields;
+    };
+
+    //a value the tree looks at: the switch's value, or part of another occurrence
+    struct MatchOccurrence {
+        //irNone for the switch's value
+        uint32_t parent;
+        //MATCH_MEMBER for the payload of the parent, MATCH_TUPLE for its field `index`
+        MatchPatternKind step;
+        uint32_t index;
+        uint32_t type;
+    };
+
+    enum MatchNodeKind : uint8_t {
+        //the case `target` is the first to match
+        MATCH_LEAF,
+        //no case matches
+        MATCH_FAIL,
+        //goes by the member a union value is
+        MATCH_TAG,
+        //goes by the range an Int, Char or Bool is in
+        MATCH_VALUE,
+        //goes by the constant a value equals
+        MATCH_CONSTANT
+    };
+
+    struct MatchEdge {
+        //the member, the values, or in `low` the constant
+        int64_t low;
+        int64_t high;
+        uint32_t node;
+    };
+
+    struct MatchNode {
+        MatchNodeKind kind;
+        uint32_t occurrence;
+        IrConstantKind bounds;
+        //sorted and disjoint
+        std::vector<MatchEdge> edges;
+        //where values no edge takes go, or irNone when the edges take every value
+        uint32_t fallback;
+        uint32_t target;
+    };
+
+    //a decision tree: every value is tested at most once on the way from the root to a leaf.
+    //leaves and the failure node are shared, everything else has one parent
+    struct MatchTree {
+        std::vector<MatchOccurrence> occurrences;
+        std::vector<MatchNode> nodes;
+        uint32_t root;
+        //whether every value matches some case, and which cases some value reaches first
+        bool exhaustive;
+        std::vector<bool> reached;
+        //branches the tree makes, against those of testing the cases one after another
+        size_t tests;
+        size_t sequentialTests;
+    };
+
+    //compiles the patterns of a switch's cases, in order, to a decision tree, following Maranget,
+    //"Compiling Pattern Matching to Good Decision Trees". false when the tree would need more than
+    //`limit` nodes
+    bool compileMatch(const std::vector<MatchPattern>& cases, uint32_t type, size_t limit, MatchTree& tree);
+}
+#endif
@@ -0,0 +1,1618 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include "optimize.h"
+
+namespace pilaf {
+    static const std::string& basicName(const IrModule& module, uint32_t type)
+    {
+        static const std::string none;
+        auto& t = module.types[type];
+        return t != nullptr && t->type == Ty::TY_BASIC ? std::static_pointer_cast<TyBasic>(t)->t : none;
+    }
+
+    static bool isArithmetic(IrOpcode op)
+    {
+        return op >= IR_ADD && op <= IR_SHR;
+    }
+
+    static bool isComparison(IrOpcode op)
+    {
+        return op >= IR_EQ && op <= IR_LE;
+    }
+
+    //whether running the instruction can stop the program with a runtime error. the interpreter
+    //checks operand types as it goes, so operators are only safe on the types it knows them for
+    static bool mayTrap(const IrModule& module, const IrFunction& function, const IrInstruction& in)
+    {
+        switch(in.op)
+        {
+            case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+            case IR_BAND: case IR_BOR: case IR_BXOR: case IR_SHL: case IR_SHR:
+            case IR_LT: case IR_LE: case IR_NEG:
+            {
+                auto& name = basicName(module, function.instructions[in.a].type);
+                bool isFloat = name == "Double" || name == "Float";
+                if(in.op == IR_DIV || in.op == IR_MOD) return !isFloat;
+                if(in.op >= IR_BAND && in.op <= IR_SHR) return name != "Int";
+                if(in.op == IR_LT || in.op == IR_LE) return !isFloat && name != "Int" && name != "Char" && name != "String";
+                return !isFloat && name != "Int" && !(in.op == IR_ADD && name == "String");
+            }
+            case IR_NOT: return basicName(module, function.instructions[in.a].type) != "Bool";
+            case IR_GETFIELD: return module.fields[in.b].index == irNone;
+            case IR_GETINDEX:
+            case IR_SETINDEX:
+            case IR_CALL:
+            case IR_CALLVALUE: return true;
+            default: return false;
+        }
+    }
+
+    //computes a value from its operands alone, without reading memory or having an effect
+    static bool isPure(IrOpcode op)
+    {
+        return op == IR_CONST || op == IR_FUNCTION || isArithmetic(op) || isComparison(op) || op == IR_NEG || op == IR_NOT || op == IR_TAG || op == IR_PAYLOAD;
+    }
+
+    static bool dominates(const std::vector<uint32_t>& idom, uint32_t a, uint32_t b)
+    {
+        while(b != a)
+        {
+            if(b == 0 || idom[b] == irNone) return false;
+            b = idom[b];
+        }
+        return true;
+    }
+
+    //block of every instruction placed in one
+    static std::vector<uint32_t> owners(const IrFunction& function)
+    {
+        std::vector<uint32_t> owner(function.instructions.size(), irNone);
+        for(uint32_t b = 0; b < function.blocks.size(); b++)
+        {
+            for(auto i : function.blocks[b].instructions) owner[i] = b;
+        }
+        return owner;
+    }
+
+    //points the terminator of `block` at `to` wherever it jumped to `from`
+    static void retarget(IrFunction& function, uint32_t block, uint32_t from, uint32_t to)
+    {
+        auto& in = function.instructions[function.blocks[block].instructions.back()];
+        if(in.op == IR_JUMP && in.a == from) in.a = to;
+        if(in.op == IR_BRANCH)
+        {
+            if(in.b == from) in.b = to;
+            if(in.c == from) in.c = to;
+        }
+        if(in.op == IR_SWITCH)
+        {
+            if(function.operands[in.b] == from) function.operands[in.b] = to;
+            for(uint32_t k = 0; k < in.c; k++)
+            {
+                if(function.operands[in.b + 2 + 2 * k] == from) function.operands[in.b + 2 + 2 * k] = to;
+            }
+        }
+    }
+
+    //the block a switch goes to for `value`
+    static uint32_t switchTarget(const IrModule& module, const IrFunction& function, const IrInstruction& in, uint64_t value)
+    {
+        for(uint32_t k = 0; k < in.c; k++)
+        {
+            if(module.constants[function.operands[in.b + 1 + 2 * k]].bits == value) return function.operands[in.b + 2 + 2 * k];
+        }
+        return function.operands[in.b];
+    }
+
+    //turns the switch ending `block` into a jump to `taken`, dropping its other edges
+    static void foldSwitch(IrFunction& function, uint32_t block, uint32_t taken)
+    {
+        std::vector<uint32_t> next;
+        successors(function, block, next);
+        auto& in = function.instructions[function.blocks[block].instructions.back()];
+        in = IrInstruction{IR_JUMP, in.type, taken, 0, 0};
+        for(auto other : next)
+        {
+            if(other != taken) removeEdge(function, block, other);
+        }
+    }
+
+    //renames the predecessor `from` of `block` to `to`, in its list and its phis
+    static void renamePredecessor(IrFunction& function, uint32_t block, uint32_t from, uint32_t to)
+    {
+        auto& b = function.blocks[block];
+        std::replace(b.predecessors.begin(), b.predecessors.end(), from, to);
+        for(auto i : b.instructions)
+        {
+            auto& in = function.instructions[i];
+            if(in.op != IR_PHI) break;
+            for(uint32_t k = 0; k < in.b; k++)
+            {
+                if(function.operands[in.a + 2 * k] == from) function.operands[in.a + 2 * k] = to;
+            }
+        }
+    }
+
+    //constant folding, with exactly the interpreter's semantics
+
+    static double toDouble(const IrConstant& k)
+    {
+        double d;
+        memcpy(&d, &k.bits, sizeof(d));
+        return d;
+    }
+
+    static float toFloat(const IrConstant& k)
+    {
+        float f;
+        auto bits = (uint32_t)k.bits;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    static IrConstant makeDouble(double d)
+    {
+        IrConstant k{CONST_DOUBLE, 0};
+        memcpy(&k.bits, &d, sizeof(d));
+        return k;
+    }
+
+    static IrConstant makeFloat(float f)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(f));
+        return IrConstant{CONST_FLOAT, bits};
+    }
+
+    static bool foldUnary(IrOpcode op, const IrConstant& x, IrConstant& result)
+    {
+        if(op == IR_NOT)
+        {
+            if(x.kind != CONST_BOOL) return false;
+            result = IrConstant{CONST_BOOL, x.bits == 0 ? 1u : 0u};
+            return true;
+        }
+        switch(x.kind)
+        {
+            case CONST_INT: result = IrConstant{CONST_INT, 0 - x.bits}; return true;
+            case CONST_DOUBLE: result = makeDouble(-toDouble(x)); return true;
+            case CONST_FLOAT: result = makeFloat(-toFloat(x)); return true;
+            default: return false;
+        }
+    }
+
+    static bool foldBinary(const IrModule& module, IrOpcode op, const IrConstant& x, const IrConstant& y, IrConstant& result)
+    {
+        if(x.kind != y.kind) return false;
+        if(op == IR_EQ || op == IR_NE)
+        {
+            bool equal;
+            switch(x.kind)
+            {
+                case CONST_DOUBLE: equal = toDouble(x) == toDouble(y); break;
+                case CONST_FLOAT: equal = toFloat(x) == toFloat(y); break;
+                case CONST_STRING: equal = module.strings[x.bits] == module.strings[y.bits]; break;
+                default: equal = x.bits == y.bits; break;
+            }
+            result = IrConstant{CONST_BOOL, equal == (op == IR_EQ) ? 1u : 0u};
+            return true;
+        }
+        if(op == IR_LT || op == IR_LE)
+        {
+            int order;
+            switch(x.kind)
+            {
+                case CONST_INT: order = (int64_t)x.bits < (int64_t)y.bits ? -1 : x.bits == y.bits ? 0 : 1; break;
+                case CONST_CHAR: order = x.bits < y.bits ? -1 : x.bits == y.bits ? 0 : 1; break;
+                case CONST_STRING: order = module.strings[x.bits].compare(module.strings[y.bits]); break;
+                case CONST_DOUBLE:
+                {
+                    auto a = toDouble(x), b = toDouble(y);
+                    result = IrConstant{CONST_BOOL, (op == IR_LT ? a < b : a <= b) ? 1u : 0u};
+                    return true;
+                }
+                case CONST_FLOAT:
+                {
+                    auto a = toFloat(x), b = toFloat(y);
+                    result = IrConstant{CONST_BOOL, (op == IR_LT ? a < b : a <= b) ? 1u : 0u};
+                    return true;
+                }
+                default: return false;
+            }
+            result = IrConstant{CONST_BOOL, (op == IR_LT ? order < 0 : order <= 0) ? 1u : 0u};
+            return true;
+        }
+        switch(x.kind)
+        {
+            case CONST_INT:
+            {
+                auto a = x.bits;
+                auto b = y.bits;
+                switch(op)
+                {
+                    case IR_ADD: result = IrConstant{CONST_INT, a + b}; return true;
+                    case IR_SUB: result = IrConstant{CONST_INT, a - b}; return true;
+                    case IR_MUL: result = IrConstant{CONST_INT, a * b}; return true;
+                    case IR_DIV:
+                    case IR_MOD:
+                    {
+                        //division by zero is left to fail when it runs
+                        if(b == 0) return false;
+                        if((int64_t)b == -1) result = IrConstant{CONST_INT, op == IR_DIV ? 0 - a : 0};
+                        else result = IrConstant{CONST_INT, (uint64_t)(op == IR_DIV ? (int64_t)a / (int64_t)b : (int64_t)a % (int64_t)b)};
+                        return true;
+                    }
+                    case IR_BAND: result = IrConstant{CONST_INT, a & b}; return true;
+                    case IR_BOR: result = IrConstant{CONST_INT, a | b}; return true;
+                    case IR_BXOR: result = IrConstant{CONST_INT, a ^ b}; return true;
+                    case IR_SHL: result = IrConstant{CONST_INT, a << (b & 63)}; return true;
+                    case IR_SHR: result = IrConstant{CONST_INT, (uint64_t)((int64_t)a >> (b & 63))}; return true;
+                    default: return false;
+                }
+            }
+            case CONST_DOUBLE:
+            {
+                auto a = toDouble(x), b = toDouble(y);
+                switch(op)
+                {
+                    case IR_ADD: result = makeDouble(a + b); return true;
+                    case IR_SUB: result = makeDouble(a - b); return true;
+                    case IR_MUL: result = makeDouble(a * b); return true;
+                    case IR_DIV: result = makeDouble(a / b); return true;
+                    case IR_MOD: result = makeDouble(std::fmod(a, b)); return true;
+                    default: return false;
+                }
+            }
+            case CONST_FLOAT:
+            {
+                auto a = toFloat(x), b = toFloat(y);
+                switch(op)
+                {
+                    case IR_ADD: result = makeFloat(a + b); return true;
+                    case IR_SUB: result = makeFloat(a - b); return true;
+                    case IR_MUL: result = makeFloat(a * b); return true;
+                    case IR_DIV: result = makeFloat(a / b); return true;
+                    case IR_MOD: result = makeFloat(std::fmod(a, b)); return true;
+                    default: return false;
+                }
+            }
+            //string concatenation would need a new string at runtime anyway
+            default: return false;
+        }
+    }
+
+    //Wegman and Zadeck's algorithm: values start unknown and only ever move down the lattice to
+    //a constant and then to varying, and only blocks reached by an executable edge are evaluated
+    struct ConstantPropagation {
+        enum CellState : uint8_t {
+            CELL_UNKNOWN,
+            CELL_CONSTANT,
+            CELL_VARYING
+        };
+
+        struct Cell {
+            CellState state;
+            IrConstant constant;
+        };
+
+        IrModule& module;
+        IrFunction& function;
+        std::vector<Cell> cells;
+        std::vector<uint32_t> owner;
+        std::vector<std::vector<uint32_t>> users;
+        std::vector<bool> executable;
+        std::unordered_set<uint64_t> edges;
+        std::vector<std::pair<uint32_t, uint32_t>> flowWork;
+        std::vector<uint32_t> valueWork;
+
+        ConstantPropagation(IrModule& module, IrFunction& function) : module(module), function(function) {}
+
+        static uint64_t edgeKey(uint32_t from, uint32_t to)
+        {
+            return (uint64_t)from << 32 | to;
+        }
+
+        void markEdge(uint32_t from, uint32_t to)
+        {
+            if(edges.insert(edgeKey(from, to)).second) flowWork.emplace_back(from, to);
+        }
+
+        void update(uint32_t i, const Cell& cell)
+        {
+            auto& old = cells[i];
+            if(old.state == cell.state && (cell.state != CELL_CONSTANT || (old.constant.kind == cell.constant.kind && old.constant.bits == cell.constant.bits))) return;
+            old = cell;
+            valueWork.push_back(i);
+        }
+
+        static Cell meet(const Cell& x, const Cell& y)
+        {
+            if(x.state == CELL_UNKNOWN) return y;
+            if(y.state == CELL_UNKNOWN) return x;
+            if(x.state == CELL_VARYING || y.state == CELL_VARYING) return Cell{CELL_VARYING, {}};
+            if(x.constant.kind == y.constant.kind && x.constant.bits == y.constant.bits) return x;
+            return Cell{CELL_VARYING, {}};
+        }
+
+        void visit(uint32_t i)
+        {
+            auto& in = function.instructions[i];
+            auto block = owner[i];
+            switch(in.op)
+            {
+                case IR_PHI:
+                {
+                    Cell result{CELL_UNKNOWN, {}};
+                    for(uint32_t k = 0; k < in.b; k++)
+                    {
+                        if(edges.count(edgeKey(function.operands[in.a + 2 * k], block)) == 0) continue;
+                        result = meet(result, cells[function.operands[in.a + 2 * k + 1]]);
+                    }
+                    update(i, result);
+                    return;
+                }
+                case IR_CONST: update(i, Cell{CELL_CONSTANT, module.constants[in.a]}); return;
+                case IR_NEG:
+                case IR_NOT:
+                {
+                    auto& x = cells[in.a];
+                    if(x.state == CELL_UNKNOWN) return;
+                    IrConstant k;
+                    if(x.state == CELL_CONSTANT && foldUnary(in.op, x.constant, k)) update(i, Cell{CELL_CONSTANT, k});
+                    else update(i, Cell{CELL_VARYING, {}});
+                    return;
+                }
+                case IR_JUMP: markEdge(block, in.a); return;
+                case IR_BRANCH:
+                {
+                    auto& c = cells[in.a];
+                    if(c.state == CELL_UNKNOWN) return;
+                    if(c.state == CELL_CONSTANT && c.constant.kind == CONST_BOOL) markEdge(block, c.constant.bits != 0 ? in.b : in.c);
+                    else
+                    {
+                        markEdge(block, in.b);
+                        markEdge(block, in.c);
+                    }
+                    return;
+                }
+                case IR_SWITCH:
+                {
+                    auto& c = cells[in.a];
+                    if(c.state == CELL_UNKNOWN) return;
+                    if(c.state == CELL_CONSTANT) markEdge(block, switchTarget(module, function, in, c.constant.bits));
+                    else
+                    {
+                        std::vector<uint32_t> next;
+                        successors(function, block, next);
+                        for(auto s : next) markEdge(block, s);
+                    }
+                    return;
+                }
+                default: break;
+            }
+            if(isArithmetic(in.op) || isComparison(in.op))
+            {
+                auto& x = cells[in.a];
+                auto& y = cells[in.b];
+                if(x.state == CELL_VARYING || y.state == CELL_VARYING) update(i, Cell{CELL_VARYING, {}});
+                else if(x.state == CELL_CONSTANT && y.state == CELL_CONSTANT)
+                {
+                    IrConstant k;
+                    if(foldBinary(module, in.op, x.constant, y.constant, k)) update(i, Cell{CELL_CONSTANT, k});
+                    else update(i, Cell{CELL_VARYING, {}});
+                }
+                return;
+            }
+            if(definesValue(in.op)) update(i, Cell{CELL_VARYING, {}});
+        }
+
+        void solve()
+        {
+            executable.assign(function.blocks.size(), false);
+            executable[0] = true;
+            for(auto i : function.blocks[0].instructions) visit(i);
+            while(!flowWork.empty() || !valueWork.empty())
+            {
+                while(!valueWork.empty())
+                {
+                    auto v = valueWork.back();
+                    valueWork.pop_back();
+                    for(auto u : users[v])
+                    {
+                        if(executable[owner[u]]) visit(u);
+                    }
+                }
+                if(flowWork.empty()) continue;
+                auto edge = flowWork.back();
+                flowWork.pop_back();
+                auto& to = function.blocks[edge.second];
+                if(!executable[edge.second])
+                {
+                    executable[edge.second] = true;
+                    for(auto i : to.instructions) visit(i);
+                }
+                else
+                {
+                    for(auto i : to.instructions)
+                    {
+                        if(function.instructions[i].op != IR_PHI) break;
+                        visit(i);
+                    }
+                }
+            }
+        }
+
+        bool run()
+        {
+            auto count = function.instructions.size();
+            cells.assign(count, Cell{CELL_UNKNOWN, {}});
+            owner = owners(function);
+            users.assign(count, {});
+            for(auto& block : function.blocks)
+            {
+                for(auto i : block.instructions) forEachOperand(function, i, [&](uint32_t operand) { users[operand].push_back(i); });
+            }
+            solve();
+
+            bool changed = false;
+            bool unreachable = false;
+            for(uint32_t b = 0; b < function.blocks.size(); b++)
+            {
+                if(!executable[b])
+                {
+                    unreachable = true;
+                    continue;
+                }
+                auto& block = function.blocks[b];
+                bool folded = false;
+                for(auto i : block.instructions)
+                {
+                    auto& in = function.instructions[i];
+                    if(in.op == IR_CONST || !definesValue(in.op) || cells[i].state != CELL_CONSTANT) continue;
+                    in = IrInstruction{IR_CONST, in.type, module.constant(cells[i].constant.kind, cells[i].constant.bits), 0, 0};
+                    folded = true;
+                }
+                //phis that became constants move below the ones that are left
+                if(folded) std::stable_partition(block.instructions.begin(), block.instructions.end(), [&](uint32_t i) { return function.instructions[i].op == IR_PHI; });
+                changed = changed || folded;
+                auto& last = function.instructions[block.instructions.back()];
+                if(last.op == IR_BRANCH && cells[last.a].state == CELL_CONSTANT)
+                {
+                    auto taken = cells[last.a].constant.bits != 0 ? last.b : last.c;
+                    auto other = taken == last.b ? last.c : last.b;
+                    last = IrInstruction{IR_JUMP, last.type, taken, 0, 0};
+                    if(other != taken) removeEdge(function, b, other);
+                    changed = true;
+                }
+                else if(last.op == IR_SWITCH && cells[last.a].state == CELL_CONSTANT)
+                {
+                    foldSwitch(function, b, switchTarget(module, function, last, cells[last.a].constant.bits));
+                    changed = true;
+                }
+            }
+            if(unreachable)
+            {
+                removeUnreachableBlocks(function);
+                changed = true;
+            }
+            return changed;
+        }
+    };
+
+    bool propagateConstants(IrModule& module, IrFunction& function)
+    {
+        ConstantPropagation propagation(module, function);
+        return propagation.run();
+    }
+
+    bool eliminateDeadCode(IrModule& module, IrFunction& function)
+    {
+        std::vector<bool> live(function.instructions.size(), false);
+        std::vector<uint32_t> work;
+        for(auto& block : function.blocks)
+        {
+            for(auto i : block.instructions)
+            {
+                auto& in = function.instructions[i];
+                if(!definesValue(in.op) || in.op == IR_CALL || in.op == IR_CALLVALUE || mayTrap(module, function, in))
+                {
+                    live[i] = true;
+                    work.push_back(i);
+                }
+            }
+        }
+        while(!work.empty())
+        {
+            auto i = work.back();
+            work.pop_back();
+            forEachOperand(function, i, [&](uint32_t operand)
+            {
+                if(live[operand]) return;
+                live[operand] = true;
+                work.push_back(operand);
+            });
+        }
+        bool changed = false;
+        for(auto& block : function.blocks)
+        {
+            auto end = std::remove_if(block.instructions.begin(), block.instructions.end(), [&](uint32_t i) { return !live[i]; });
+            if(end == block.instructions.end()) continue;
+            block.instructions.erase(end, block.instructions.end());
+            changed = true;
+        }
+        return changed;
+    }
+
+    //values are numbered in a preorder walk of the dominator tree, so an expression seen before is
+    //available wherever the walk is below the place it was seen. loads are only reused within a
+    //block, up to a store that may change them or a call, and so are the fields of records built
+    //in the block
+    struct ValueNumbering {
+        struct KeyHash {
+            size_t operator()(const std::vector<uint32_t>& key) const
+            {
+                size_t h = 14695981039346656037ull;
+                for(auto w : key) h = (h ^ w) * 1099511628211ull;
+                return h;
+            }
+        };
+
+        //a load of a field or element, or a record built in the block, and the value it is known to
+        //produce
+        struct Load {
+            IrOpcode op;
+            uint32_t base;
+            //field or index value
+            uint32_t at;
+            uint32_t value;
+        };
+
+        IrModule& module;
+        IrFunction& function;
+        std::unordered_map<std::vector<uint32_t>, uint32_t, KeyHash> table;
+        //entries to restore when the walk leaves a subtree: the key and what it mapped to before
+        std::vector<std::pair<std::vector<uint32_t>, uint32_t>> undo;
+        std::vector<uint32_t> replacement;
+        std::vector<Load> loads;
+
+        ValueNumbering(IrModule& module, IrFunction& function) : module(module), function(function) {}
+
+        uint32_t find(uint32_t v)
+        {
+            while(replacement[v] != irNone) v = replacement[v];
+            return v;
+        }
+
+        bool isCommutative(const IrInstruction& in)
+        {
+            if(in.op == IR_MUL || in.op == IR_BAND || in.op == IR_BOR || in.op == IR_BXOR || in.op == IR_EQ || in.op == IR_NE) return true;
+            //adding strings concatenates them
+            if(in.op != IR_ADD) return false;
+            auto& name = basicName(module, in.type);
+            return name == "Int" || name == "Double" || name == "Float";
+        }
+
+        bool key(uint32_t i, uint32_t block, std::vector<uint32_t>& out)
+        {
+            auto& in = function.instructions[i];
+            out.clear();
+            out.push_back(in.op);
+            out.push_back(in.type);
+            if(in.op == IR_PHI)
+            {
+                out.push_back(block);
+                std::vector<std::pair<uint32_t, uint32_t>> entries;
+                for(uint32_t k = 0; k < in.b; k++) entries.emplace_back(function.operands[in.a + 2 * k], find(function.operands[in.a + 2 * k + 1]));
+                std::sort(entries.begin(), entries.end());
+                for(auto& e : entries)
+                {
+                    out.push_back(e.first);
+                    out.push_back(e.second);
+                }
+                return true;
+            }
+            if(!isPure(in.op)) return false;
+            if(in.op == IR_CONST || in.op == IR_FUNCTION)
+            {
+                out.push_back(in.a);
+                return true;
+            }
+            auto a = find(in.a);
+            out.push_back(a);
+            if(isArithmetic(in.op) || isComparison(in.op))
+            {
+                auto b = find(in.b);
+                if(isCommutative(in) && b < a) std::swap(out.back(), b);
+                out.push_back(b);
+            }
+            return true;
+        }
+
+        void forget(IrOpcode op, Symbol field)
+        {
+            loads.erase(std::remove_if(loads.begin(), loads.end(), [&](const Load& load)
+            {
+                if(load.op != op) return false;
+                return op != IR_GETFIELD || module.fields[load.at].name == field;
+            }), loads.end());
+        }
+
+        //reuses a load seen earlier in the block; returns the value it is known to produce or irNone
+        uint32_t load(uint32_t i)
+        {
+            auto& in = function.instructions[i];
+            switch(in.op)
+            {
+                case IR_GETFIELD:
+                case IR_GETINDEX:
+                {
+                    auto base = find(in.a);
+                    auto at = in.op == IR_GETFIELD ? in.b : find(in.b);
+                    for(auto& load : loads)
+                    {
+                        if(load.op == in.op && load.base == base && load.at == at && function.instructions[load.value].type == in.type) return load.value;
+                        if(load.op != IR_RECORD || load.base != base || in.op != IR_GETFIELD) continue;
+                        auto& field = module.fields[in.b];
+                        auto& record = function.instructions[base];
+                        if(field.index >= record.b || module.layouts[record.c].names[field.index] != field.name) continue;
+                        auto value = find(function.operands[record.a + field.index]);
+                        if(function.instructions[value].type == in.type) return value;
+                    }
+                    loads.push_back(Load{in.op, base, at, i});
+                    return irNone;
+                }
+                case IR_RECORD:
+                {
+                    //the fields of a record built in the block are what it was built from
+                    loads.push_back(Load{IR_RECORD, i, irNone, i});
+                    return irNone;
+                }
+                case IR_SETFIELD:
+                {
+                    forget(IR_GETFIELD, module.fields[in.b].name);
+                    forget(IR_RECORD, noSymbol);
+                    loads.push_back(Load{IR_GETFIELD, find(in.a), in.b, find(in.c)});
+                    return irNone;
+                }
+                case IR_SETINDEX:
+                {
+                    forget(IR_GETINDEX, noSymbol);
+                    loads.push_back(Load{IR_GETINDEX, find(in.a), find(in.b), find(in.c)});
+                    return irNone;
+                }
+                case IR_CALL:
+                case IR_CALLVALUE: loads.clear(); return irNone;
+                default: return irNone;
+            }
+        }
+
+        bool visit(uint32_t b)
+        {
+            bool changed = false;
+            loads.clear();
+            std::vector<uint32_t> k;
+            auto& instructions = function.blocks[b].instructions;
+            for(size_t n = 0; n < instructions.size();)
+            {
+                auto i = instructions[n];
+                auto same = load(i);
+                if(same == irNone && key(i, b, k))
+                {
+                    auto it = table.find(k);
+                    if(it == table.end())
+                    {
+                        undo.emplace_back(k, irNone);
+                        table.emplace(k, i);
+                    }
+                    else same = it->second;
+                }
+                if(same == irNone)
+                {
+                    n++;
+                    continue;
+                }
+                replacement[i] = same;
+                instructions.erase(instructions.begin() + n);
+                changed = true;
+            }
+            return changed;
+        }
+
+        bool run()
+        {
+            replacement.assign(function.instructions.size(), irNone);
+            auto idom = dominators(function);
+            std::vector<std::vector<uint32_t>> children(function.blocks.size());
+            for(uint32_t b = 1; b < function.blocks.size(); b++)
+            {
+                if(idom[b] != irNone) children[idom[b]].push_back(b);
+            }
+            bool changed = false;
+            //(block, undo depth when it was entered); the depth is irNone until it is visited
+            std::vector<std::pair<uint32_t, size_t>> stack = {{0, SIZE_MAX}};
+            while(!stack.empty())
+            {
+                auto& top = stack.back();
+                if(top.second != SIZE_MAX)
+                {
+                    while(undo.size() > top.second)
+                    {
+                        table.erase(undo.back().first);
+                        undo.pop_back();
+                    }
+                    stack.pop_back();
+                    continue;
+                }
+                top.second = undo.size();
+                auto b = top.first;
+                if(visit(b)) changed = true;
+                for(auto c : children[b]) stack.emplace_back(c, SIZE_MAX);
+            }
+            if(changed) replaceUses(function, replacement);
+            return changed;
+        }
+    };
+
+    bool numberValues(IrModule& module, IrFunction& function)
+    {
+        ValueNumbering numbering(module, function);
+        return numbering.run();
+    }
+
+    struct LoopHoisting {
+        struct Loop {
+            uint32_t header;
+            //blocks of the loop, by index
+            std::vector<bool> body;
+            size_t size;
+        };
+
+        IrModule& module;
+        IrFunction& function;
+        std::vector<Loop> loops;
+        std::vector<uint32_t> owner;
+
+        LoopHoisting(IrModule& module, IrFunction& function) : module(module), function(function) {}
+
+        void findLoops()
+        {
+            auto idom = dominators(function);
+            std::unordered_map<uint32_t, size_t> byHeader;
+            std::vector<uint32_t> next;
+            for(uint32_t b = 0; b < function.blocks.size(); b++)
+            {
+                auto n = successors(function, b, next);
+                for(size_t s = 0; s < n; s++)
+                {
+                    auto header = next[s];
+                    if(idom[b] == irNone || !dominates(idom, header, b)) continue;
+                    auto it = byHeader.find(header);
+                    if(it == byHeader.end())
+                    {
+                        it = byHeader.emplace(header, loops.size()).first;
+                        loops.push_back(Loop{header, std::vector<bool>(function.blocks.size(), false), 1});
+                        loops.back().body[header] = true;
+                    }
+                    //everything that reaches the back edge without passing the header
+                    auto& loop = loops[it->second];
+                    std::vector<uint32_t> work = {b};
+                    while(!work.empty())
+                    {
+                        auto x = work.back();
+                        work.pop_back();
+                        if(loop.body[x]) continue;
+                        loop.body[x] = true;
+                        loop.size++;
+                        for(auto p : function.blocks[x].predecessors) work.push_back(p);
+                    }
+                }
+            }
+            //inner loops first, so what leaves them can keep going out of the loops around them
+            std::stable_sort(loops.begin(), loops.end(), [](const Loop& x, const Loop& y) { return x.size < y.size; });
+        }
+
+        //the block that enters the loop and nothing else, made by splitting the entering edge if
+        //needed; irNone when the loop is entered from more than one place
+        uint32_t preheader(size_t index)
+        {
+            auto header = loops[index].header;
+            uint32_t outside = irNone;
+            for(auto p : function.blocks[header].predecessors)
+            {
+                if(loops[index].body[p]) continue;
+                if(outside != irNone) return irNone;
+                outside = p;
+            }
+            if(outside == irNone) return irNone;
+            auto& last = function.instructions[function.blocks[outside].instructions.back()];
+            if(last.op == IR_JUMP) return outside;
+            auto created = (uint32_t)function.blocks.size();
+            auto jump = addInstruction(function, IrInstruction{IR_JUMP, last.type, header, 0, 0}, function.lines[function.blocks[outside].instructions.back()]);
+            retarget(function, outside, header, created);
+            function.blocks.push_back(IrBlock{{jump}, {outside}});
+            renamePredecessor(function, header, outside, created);
+            owner.resize(function.instructions.size(), irNone);
+            owner[jump] = created;
+            //the new block belongs to every loop around this one
+            for(auto& loop : loops)
+            {
+                loop.body.push_back(loop.body[header] && loop.header != header);
+                if(loop.body.back()) loop.size++;
+            }
+            return created;
+        }
+
+        bool hoistable(uint32_t i, const Loop& loop)
+        {
+            auto& in = function.instructions[i];
+            if(!isPure(in.op) || mayTrap(module, function, in)) return false;
+            bool invariant = true;
+            forEachOperand(function, i, [&](uint32_t operand)
+            {
+                if(owner[operand] != irNone && loop.body[owner[operand]]) invariant = false;
+            });
+            return invariant;
+        }
+
+        bool run()
+        {
+            findLoops();
+            if(loops.empty()) return false;
+            owner = owners(function);
+            bool changed = false;
+            for(size_t l = 0; l < loops.size(); l++)
+            {
+                auto target = preheader(l);
+                if(target == irNone) continue;
+                auto& loop = loops[l];
+                //in reverse postorder, an invariant's operands are hoisted before it is looked at
+                for(auto b : reversePostorder(function))
+                {
+                    if(!loop.body[b]) continue;
+                    auto& instructions = function.blocks[b].instructions;
+                    for(size_t n = 0; n < instructions.size();)
+                    {
+                        auto i = instructions[n];
+                        if(!hoistable(i, loop))
+                        {
+                            n++;
+                            continue;
+                        }
+                        instructions.erase(instructions.begin() + n);
+                        auto& into = function.blocks[target].instructions;
+                        into.insert(into.end() - 1, i);
+                        owner[i] = target;
+                        changed = true;
+                    }
+                }
+            }
+            return changed;
+        }
+    };
+
+    bool hoistLoopInvariants(IrModule& module, IrFunction& function)
+    {
+        LoopHoisting hoisting(module, function);
+        return hoisting.run();
+    }
+
+    struct CfgSimplifier {
+        IrModule& module;
+        IrFunction& function;
+        std::vector<uint32_t> replacement;
+
+        CfgSimplifier(IrModule& module, IrFunction& function) : module(module), function(function) {}
+
+        uint32_t find(uint32_t v)
+        {
+            while(replacement[v] != irNone) v = replacement[v];
+            return v;
+        }
+
+        //branches and switches on constants, and to the same block either way, become jumps
+        bool foldBranches()
+        {
+            bool changed = false;
+            std::vector<uint32_t> next;
+            for(uint32_t b = 0; b < function.blocks.size(); b++)
+            {
+                auto& in = function.instructions[function.blocks[b].instructions.back()];
+                if(in.op == IR_SWITCH)
+                {
+                    auto& value = function.instructions[find(in.a)];
+                    if(value.op == IR_CONST) foldSwitch(function, b, switchTarget(module, function, in, module.constants[value.a].bits));
+                    else if(successors(function, b, next) == 1) foldSwitch(function, b, next[0]);
+                    else continue;
+                    changed = true;
+                    continue;
+                }
+                if(in.op != IR_BRANCH) continue;
+                auto& condition = function.instructions[find(in.a)];
+                uint32_t taken;
+                if(in.b == in.c) taken = in.b;
+                else if(condition.op == IR_CONST && module.constants[condition.a].kind == CONST_BOOL) taken = module.constants[condition.a].bits != 0 ? in.b : in.c;
+                else continue;
+                auto other = taken == in.b ? in.c : in.b;
+                in = IrInstruction{IR_JUMP, in.type, taken, 0, 0};
+                if(other != taken) removeEdge(function, b, other);
+                changed = true;
+            }
+            return changed;
+        }
+
+        //appends a block to its only predecessor when that predecessor always jumps to it
+        bool mergeBlocks()
+        {
+            bool changed = false;
+            for(auto b : reversePostorder(function))
+            {
+                while(true)
+                {
+                    auto& block = function.blocks[b];
+                    if(block.instructions.empty()) break;
+                    auto& last = function.instructions[block.instructions.back()];
+                    if(last.op != IR_JUMP) break;
+                    auto s = last.a;
+                    auto& next = function.blocks[s];
+                    if(s == b || s == 0 || next.predecessors.size() != 1) break;
+                    block.instructions.pop_back();
+                    for(auto i : next.instructions)
+                    {
+                        auto& in = function.instructions[i];
+                        if(in.op == IR_PHI) replacement[i] = function.operands[in.a + 1];
+                        else block.instructions.push_back(i);
+                    }
+                    next.instructions.clear();
+                    next.predecessors.clear();
+                    std::vector<uint32_t> after;
+                    auto n = successors(function, b, after);
+                    for(size_t k = 0; k < n; k++) renamePredecessor(function, after[k], s, b);
+                    changed = true;
+                }
+            }
+            return changed;
+        }
+
+        //sends the predecessors of a block that only jumps on straight to where it jumps
+        bool threadJumps()
+        {
+            bool changed = false;
+            for(uint32_t e = 1; e < function.blocks.size(); e++)
+            {
+                auto& empty = function.blocks[e];
+                if(empty.instructions.size() != 1 || empty.predecessors.empty()) continue;
+                auto& jump = function.instructions[empty.instructions[0]];
+                if(jump.op != IR_JUMP || jump.a == e) continue;
+                auto t = jump.a;
+                auto& target = function.blocks[t];
+                bool shared = false;
+                for(auto p : empty.predecessors)
+                {
+                    if(p == e || std::find(target.predecessors.begin(), target.predecessors.end(), p) != target.predecessors.end()) shared = true;
+                }
+                if(shared) continue;
+                auto preds = empty.predecessors;
+                for(auto p : preds) retarget(function, p, e, t);
+                target.predecessors.erase(std::find(target.predecessors.begin(), target.predecessors.end(), e));
+                target.predecessors.insert(target.predecessors.end(), preds.begin(), preds.end());
+                //each phi gets the value that came through the empty block once per new predecessor
+                for(auto i : target.instructions)
+                {
+                    auto& in = function.instructions[i];
+                    if(in.op != IR_PHI) break;
+                    auto offset = (uint32_t)function.operands.size();
+                    uint32_t through = irNone;
+                    for(uint32_t k = 0; k < in.b; k++)
+                    {
+                        auto from = function.operands[in.a + 2 * k];
+                        auto value = function.operands[in.a + 2 * k + 1];
+                        if(from == e)
+                        {
+                            through = value;
+                            continue;
+                        }
+                        function.operands.push_back(from);
+                        function.operands.push_back(value);
+                    }
+                    for(auto p : preds)
+                    {
+                        function.operands.push_back(p);
+                        function.operands.push_back(through);
+                    }
+                    in.a = offset;
+                    in.b = (uint32_t)(function.operands.size() - offset) / 2;
+                }
+                empty.predecessors.clear();
+                changed = true;
+            }
+            return changed;
+        }
+
+        //phis whose entries are all one value, or the phi itself
+        bool removeTrivialPhis()
+        {
+            bool changed = false;
+            bool again = true;
+            while(again)
+            {
+                again = false;
+                for(auto& block : function.blocks)
+                {
+                    for(size_t n = 0; n < block.instructions.size();)
+                    {
+                        auto i = block.instructions[n];
+                        auto& in = function.instructions[i];
+                        if(in.op != IR_PHI) break;
+                        uint32_t same = irNone;
+                        bool trivial = true;
+                        for(uint32_t k = 0; k < in.b && trivial; k++)
+                        {
+                            auto v = find(function.operands[in.a + 2 * k + 1]);
+                            if(v == i || v == same) continue;
+                            if(same != irNone) trivial = false;
+                            same = v;
+                        }
+                        if(!trivial || same == irNone)
+                        {
+                            n++;
+                            continue;
+                        }
+                        replacement[i] = same;
+                        block.instructions.erase(block.instructions.begin() + n);
+                        changed = again = true;
+                    }
+                }
+            }
+            return changed;
+        }
+
+        bool run()
+        {
+            replacement.assign(function.instructions.size(), irNone);
+            bool changed = false;
+            while(true)
+            {
+                bool round = foldBranches();
+                if(mergeBlocks()) round = true;
+                if(threadJumps()) round = true;
+                if(removeTrivialPhis()) round = true;
+                if(!round) break;
+                replaceUses(function, replacement);
+                removeUnreachableBlocks(function);
+                changed = true;
+            }
+            return changed;
+        }
+    };
+
+    bool simplifyCfg(IrModule& module, IrFunction& function)
+    {
+        CfgSimplifier simplifier(module, function);
+        return simplifier.run();
+    }
+
+    CallGraph buildCallGraph(const IrModule& module)
+    {
+        CallGraph graph;
+        auto count = module.functions.size();
+        graph.callees.resize(count);
+        graph.sites.assign(count, 0);
+        for(uint32_t f = 0; f < count; f++)
+        {
+            auto& function = module.functions[f];
+            auto& callees = graph.callees[f];
+            for(auto& block : function.blocks)
+            {
+                for(auto i : block.instructions)
+                {
+                    auto& in = function.instructions[i];
+                    //a function used as a value is ordered like a callee, so that it is optimized
+                    //before a call of the value is made direct and inlined
+                    if(in.op == IR_FUNCTION) callees.push_back(in.a);
+                    else if(in.op == IR_CLOSURE || in.op == IR_LOCALCLOSURE) callees.push_back(in.c);
+                    if(in.op != IR_CALL) continue;
+                    graph.sites[in.c]++;
+                    callees.push_back(in.c);
+                }
+            }
+            std::sort(callees.begin(), callees.end());
+            callees.erase(std::unique(callees.begin(), callees.end()), callees.end());
+        }
+
+        //Tarjan's algorithm, which finishes a component after every component it calls into
+        graph.component.assign(count, irNone);
+        std::vector<uint32_t> index(count, irNone);
+        std::vector<uint32_t> low(count, 0);
+        std::vector<bool> onStack(count, false);
+        std::vector<uint32_t> stack;
+        //(function, callees already visited)
+        std::vector<std::pair<uint32_t, size_t>> work;
+        uint32_t visited = 0;
+        uint32_t components = 0;
+        for(uint32_t root = 0; root < count; root++)
+        {
+            if(index[root] != irNone) continue;
+            work.emplace_back(root, 0);
+            while(!work.empty())
+            {
+                auto f = work.back().first;
+                if(index[f] == irNone)
+                {
+                    index[f] = low[f] = visited++;
+                    stack.push_back(f);
+                    onStack[f] = true;
+                }
+                auto& callees = graph.callees[f];
+                if(work.back().second < callees.size())
+                {
+                    auto g = callees[work.back().second++];
+                    if(index[g] == irNone) work.emplace_back(g, 0);
+                    else if(onStack[g]) low[f] = std::min(low[f], index[g]);
+                    continue;
+                }
+                work.pop_back();
+                if(!work.empty()) low[work.back().first] = std::min(low[work.back().first], low[f]);
+                if(low[f] != index[f]) continue;
+                while(true)
+                {
+                    auto g = stack.back();
+                    stack.pop_back();
+                    onStack[g] = false;
+                    graph.component[g] = components;
+                    graph.bottomUp.push_back(g);
+                    if(g == f) break;
+                }
+                components++;
+            }
+        }
+        return graph;
+    }
+
+    //instructions the function adds where it is inlined, counting the copies into the registers
+    //of calls and aggregates. constants, parameters and phis mostly end up costing nothing
+    static uint32_t inlineCost(const IrFunction& function)
+    {
+        uint32_t cost = 0;
+        for(auto& block : function.blocks)
+        {
+            for(auto i : block.instructions)
+            {
+                auto& in = function.instructions[i];
+                switch(in.op)
+                {
+                    case IR_CONST:
+                    case IR_PARAM:
+                    case IR_PHI:
+                    case IR_JUMP: break;
+                    case IR_CALL:
+                    case IR_CALLVALUE:
+                    case IR_RECORD:
+                    case IR_ARRAY:
+                    case IR_CLOSURE:
+                    case IR_LOCALCLOSURE: cost += 1 + in.b; break;
+                    default: cost++; break;
+                }
+            }
+        }
+        return cost;
+    }
+
+    //an operator the program defines, such as `(+)` or `Num[V].(*)`
+    static bool isOperatorFunction(const std::string& name)
+    {
+        auto open = name.rfind('(');
+        return open != std::string::npos && (open == 0 || name[open - 1] == '.') && name.back() == ')';
+    }
+
+    //how many loops each block is in
+    static std::vector<uint32_t> loopDepths(const IrFunction& function)
+    {
+        std::vector<uint32_t> depth(function.blocks.size(), 0);
+        auto idom = dominators(function);
+        std::unordered_map<uint32_t, std::vector<bool>> loops;
+        std::vector<uint32_t> next;
+        for(uint32_t b = 0; b < function.blocks.size(); b++)
+        {
+            auto n = successors(function, b, next);
+            for(size_t s = 0; s < n; s++)
+            {
+                auto header = next[s];
+                if(idom[b] == irNone || !dominates(idom, header, b)) continue;
+                auto& body = loops.emplace(header, std::vector<bool>(function.blocks.size(), false)).first->second;
+                body[header] = true;
+                std::vector<uint32_t> work = {b};
+                while(!work.empty())
+                {
+                    auto x = work.back();
+                    work.pop_back();
+                    if(body[x]) continue;
+                    body[x] = true;
+                    for(auto p : function.blocks[x].predecessors) work.push_back(p);
+                }
+            }
+        }
+        for(auto& loop : loops)
+        {
+            for(uint32_t b = 0; b < function.blocks.size(); b++)
+            {
+                if(loop.second[b]) depth[b]++;
+            }
+        }
+        return depth;
+    }
+
+    //calls are replaced by a copy of the callee's blocks between the two halves of the block they
+    //were in, with the callee's returns jumping to the second half
+    struct Inliner {
+        //what a callee may cost at a call outside any loop, doubled for each loop around the call
+        //up to two, and once more when the call is the callee's only one
+        static const uint32_t budget = 40;
+        //past this size a caller only takes inlines that do not make it bigger
+        static const uint32_t growthLimit = 4000;
+
+        IrModule& module;
+        IrFunction& function;
+        uint32_t caller;
+        const CallGraph& graph;
+        int level;
+        std::vector<uint32_t> replacement;
+        //loop depth of every block, and whether it is the caller's own rather than inlined code
+        std::vector<uint32_t> depth;
+        std::vector<bool> own;
+        uint32_t size;
+
+        Inliner(IrModule& module, uint32_t caller, const CallGraph& graph, int level)
+        : module(module), function(module.functions[caller]), caller(caller), graph(graph), level(level), size(0) {}
+
+        bool worthInlining(const IrInstruction& call, uint32_t block)
+        {
+            auto& callee = module.functions[call.c];
+            //the recursion guard: nothing is inlined into a function it can be called from
+            if(callee.external || callee.blocks.empty() || graph.component[call.c] == graph.component[caller]) return false;
+            if(isOperatorFunction(callee.name) && callee.blocks.size() == 1) return true;
+            auto cost = inlineCost(callee);
+            //the arguments, the call and the return are saved
+            if(cost <= call.b + 2) return true;
+            if(level < 2 || size > growthLimit) return false;
+            auto limit = budget << std::min<uint32_t>(depth[block], 2);
+            if(graph.sites[call.c] == 1) limit += budget;
+            return cost <= limit;
+        }
+
+        uint32_t copyOperands(const IrFunction& callee, uint32_t at, uint32_t count)
+        {
+            auto start = (uint32_t)function.operands.size();
+            function.operands.insert(function.operands.end(), callee.operands.begin() + at, callee.operands.begin() + at + count);
+            return start;
+        }
+
+        //a call of a function value made in the caller becomes a call of its function, which is
+        //passed what the closure captured after the arguments
+        bool devirtualize(uint32_t i)
+        {
+            auto& in = function.instructions[i];
+            if(in.op != IR_CALLVALUE) return false;
+            //the value may come from a call that was inlined already
+            auto value = function.operands[in.a];
+            while(value < replacement.size() && replacement[value] != irNone) value = replacement[value];
+            auto& callee = function.instructions[value];
+            uint32_t target;
+            if(callee.op == IR_FUNCTION) target = callee.a;
+            else if(callee.op == IR_CLOSURE || callee.op == IR_LOCALCLOSURE) target = callee.c;
+            else return false;
+            auto captures = callee.op == IR_FUNCTION ? 0 : callee.b;
+            auto& f = module.functions[target];
+            if(f.external || f.params.size() != in.b - 1 + captures) return false;
+            std::vector<uint32_t> args(function.operands.begin() + in.a + 1, function.operands.begin() + in.a + in.b);
+            args.insert(args.end(), function.operands.begin() + callee.a, function.operands.begin() + callee.a + captures);
+            in.op = IR_CALL;
+            in.a = (uint32_t)function.operands.size();
+            in.b = (uint32_t)args.size();
+            in.c = target;
+            function.operands.insert(function.operands.end(), args.begin(), args.end());
+            return true;
+        }
+
+        //index in the caller's list of inlined functions, counting from 1
+        uint32_t origin(const std::string& name)
+        {
+            auto it = std::find(function.inlined.begin(), function.inlined.end(), name);
+            if(it != function.inlined.end()) return (uint32_t)(it - function.inlined.begin()) + 1;
+            function.inlined.push_back(name);
+            return (uint32_t)function.inlined.size();
+        }
+
+        void inlineCall(uint32_t block, size_t position)
+        {
+            auto call = function.blocks[block].instructions[position];
+            auto in = function.instructions[call];
+            auto line = function.lines[call];
+            auto& callee = module.functions[in.c];
+            size += inlineCost(callee);
+
+            //the rest of the block goes on after the callee returns
+            auto rest = (uint32_t)function.blocks.size();
+            IrBlock after;
+            auto& instructions = function.blocks[block].instructions;
+            after.instructions.assign(instructions.begin() + position + 1, instructions.end());
+            instructions.resize(position);
+            function.blocks.push_back(std::move(after));
+            depth.push_back(depth[block]);
+            own.push_back(own[block]);
+            std::vector<uint32_t> next;
+            auto n = successors(function, rest, next);
+            for(size_t s = 0; s < n; s++) renamePredecessor(function, next[s], block, rest);
+
+            if(function.origins.empty()) function.origins.assign(function.instructions.size(), 0);
+            std::vector<uint32_t> origins = {origin(callee.name)};
+            for(auto& name : callee.inlined) origins.push_back(origin(name));
+
+            auto base = (uint32_t)function.blocks.size();
+            function.blocks.resize(base + callee.blocks.size());
+            depth.resize(function.blocks.size(), 0);
+            own.resize(function.blocks.size(), false);
+            std::vector<uint32_t> value(callee.instructions.size(), irNone);
+            //(block, callee value or irNone) for every return
+            std::vector<std::pair<uint32_t, uint32_t>> returns;
+            for(uint32_t b = 0; b < callee.blocks.size(); b++)
+            {
+                for(auto p : callee.blocks[b].predecessors) function.blocks[base + b].predecessors.push_back(base + p);
+                for(auto i : callee.blocks[b].instructions)
+                {
+                    auto copy = callee.instructions[i];
+                    switch(copy.op)
+                    {
+                        case IR_PARAM:
+                        {
+                            value[i] = function.operands[in.a + copy.a];
+                            continue;
+                        }
+                        case IR_PHI:
+                        {
+                            copy.a = copyOperands(callee, copy.a, 2 * copy.b);
+                            for(uint32_t k = 0; k < copy.b; k++) function.operands[copy.a + 2 * k] += base;
+                            break;
+                        }
+                        case IR_CALL:
+                        case IR_CALLVALUE:
+                        case IR_RECORD:
+                        case IR_ARRAY:
+                        case IR_CLOSURE:
+                        case IR_LOCALCLOSURE: copy.a = copyOperands(callee, copy.a, copy.b); break;
+                        case IR_JUMP: copy.a += base; break;
+                        case IR_BRANCH: copy.b += base; copy.c += base; break;
+                        case IR_SWITCH:
+                        {
+                            copy.b = copyOperands(callee, copy.b, 1 + 2 * copy.c);
+                            function.operands[copy.b] += base;
+                            for(uint32_t k = 0; k < copy.c; k++) function.operands[copy.b + 2 + 2 * k] += base;
+                            break;
+                        }
+                        case IR_RETURN:
+                        {
+                            returns.emplace_back(base + b, copy.a);
+                            copy = IrInstruction{IR_JUMP, copy.type, rest, 0, 0};
+                            break;
+                        }
+                        default: break;
+                    }
+                    value[i] = addInstruction(function, copy, callee.lines[i]);
+                    function.origins.back() = origins[callee.origins.empty() ? 0 : callee.origins[i]];
+                    function.blocks[base + b].instructions.push_back(value[i]);
+                }
+            }
+            for(auto& b : callee.blocks)
+            {
+                for(auto i : b.instructions)
+                {
+                    if(callee.instructions[i].op == IR_PARAM) continue;
+                    forEachOperand(function, value[i], [&](uint32_t& operand) { operand = value[operand]; });
+                }
+            }
+
+            //a return without a value gives the call a Void constant
+            uint32_t none = irNone;
+            for(auto& r : returns)
+            {
+                if(r.second != irNone)
+                {
+                    r.second = value[r.second];
+                    continue;
+                }
+                if(none == irNone)
+                {
+                    none = addInstruction(function, IrInstruction{IR_CONST, in.type, module.constant(CONST_VOID, 0), 0, 0}, line);
+                    function.blocks[block].instructions.push_back(none);
+                }
+                r.second = none;
+            }
+            auto jump = addInstruction(function, IrInstruction{IR_JUMP, module.type(nullptr), base, 0, 0}, line);
+            function.blocks[block].instructions.push_back(jump);
+            function.blocks[base].predecessors.push_back(block);
+            for(auto& r : returns) function.blocks[rest].predecessors.push_back(r.first);
+            //calls made direct in inlined code are newer than the table
+            replacement.resize(function.instructions.size(), irNone);
+            if(returns.size() == 1) replacement[call] = returns[0].second;
+            else if(returns.size() > 1)
+            {
+                auto phi = addInstruction(function, IrInstruction{IR_PHI, in.type, (uint32_t)function.operands.size(), (uint32_t)returns.size(), 0}, line);
+                for(auto& r : returns)
+                {
+                    function.operands.push_back(r.first);
+                    function.operands.push_back(r.second);
+                }
+                auto& first = function.blocks[rest].instructions;
+                first.insert(first.begin(), phi);
+                replacement[call] = phi;
+            }
+        }
+
+        bool run()
+        {
+            depth = loopDepths(function);
+            own.assign(function.blocks.size(), true);
+            size = inlineCost(function);
+            replacement.assign(function.instructions.size(), irNone);
+            bool changed = false;
+            //the second half of a split block is scanned like any other block of the caller; what
+            //was inlined has already had its own calls considered, except those that only became
+            //direct once the function values they call were known
+            for(uint32_t b = 0; b < function.blocks.size(); b++)
+            {
+                auto& instructions = function.blocks[b].instructions;
+                for(size_t n = 0; n < instructions.size(); n++)
+                {
+                    bool direct = devirtualize(instructions[n]);
+                    changed |= direct;
+                    auto& in = function.instructions[instructions[n]];
+                    if(in.op != IR_CALL || (!own[b] && !direct) || !worthInlining(in, b)) continue;
+                    inlineCall(b, n);
+                    changed = true;
+                    break;
+                }
+            }
+            if(!changed) return false;
+            replacement.resize(function.instructions.size(), irNone);
+            replaceUses(function, replacement);
+            removeUnreachableBlocks(function);
+            return true;
+        }
+    };
+
+    bool inlineCalls(IrModule& module, uint32_t caller, const CallGraph& graph, int level)
+    {
+        Inliner inliner(module, caller, graph, level);
+        return inliner.run();
+    }
+
+    //marks the values of `function` that a use lets outlive the call: anything but being called
+    //or passed to a parameter that does not escape itself. a tail call takes over the frame, so
+    //only the caller's own parameters may be passed to it
+    static void escapingValues(const IrFunction& function, const std::vector<std::vector<bool>>& params, std::vector<bool>& escaping)
+    {
+        escaping.assign(function.instructions.size(), false);
+        for(uint32_t b = 0; b < function.blocks.size(); b++)
+        {
+            for(auto i : function.blocks[b].instructions)
+            {
+                auto& in = function.instructions[i];
+                if(in.op == IR_CALLVALUE)
+                {
+                    for(uint32_t k = 1; k < in.b; k++) escaping[function.operands[in.a + k]] = true;
+                }
+                else if(in.op == IR_CALL)
+                {
+                    bool tail = isTailCall(function, b, i);
+                    for(uint32_t k = 0; k < in.b; k++)
+                    {
+                        auto arg = function.operands[in.a + k];
+                        if(params[in.c][k] || (tail && function.instructions[arg].op != IR_PARAM)) escaping[arg] = true;
+                    }
+                }
+                else forEachOperand(function, i, [&](uint32_t operand) { escaping[operand] = true; });
+            }
+        }
+    }
+
+    bool localizeClosures(IrModule& module)
+    {
+        //which parameters of every function escape, found optimistically: only the parameters of
+        //functions without a body escape to begin with, and the others until nothing changes
+        auto count = module.functions.size();
+        std::vector<std::vector<bool>> params(count);
+        for(size_t f = 0; f < count; f++) params[f].assign(module.functions[f].params.size(), module.functions[f].external);
+        std::vector<bool> escaping;
+        bool changed = true;
+        while(changed)
+        {
+            changed = false;
+            for(size_t f = 0; f < count; f++)
+            {
+                auto& function = module.functions[f];
+                if(function.external) continue;
+                escapingValues(function, params, escaping);
+                for(auto& block : function.blocks)
+                {
+                    for(auto i : block.instructions)
+                    {
+                        auto& in = function.instructions[i];
+                        if(in.op != IR_PARAM || !escaping[i] || params[f][in.a]) continue;
+                        params[f][in.a] = true;
+                        changed = true;
+                    }
+                }
+            }
+        }
+        bool localized = false;
+        for(auto& function : module.functions)
+        {
+            if(function.external) continue;
+            escapingValues(function, params, escaping);
+            for(auto& block : function.blocks)
+            {
+                for(auto i : block.instructions)
+                {
+                    auto& in = function.instructions[i];
+                    if(in.op != IR_CLOSURE || escaping[i]) continue;
+                    in.op = IR_LOCALCLOSURE;
+                    localized = true;
+                }
+            }
+        }
+        return localized;
+    }
+
+    struct Pass {
+        const char* name;
+        bool (*run)(IrModule&, IrFunction&);
+    };
+
+    static const Pass simplifyCfgPass{"simplifycfg", simplifyCfg};
+    static const Pass constantsPass{"sccp", propagateConstants};
+    static const Pass valuesPass{"gvn", numberValues};
+    static const Pass invariantsPass{"licm", hoistLoopInvariants};
+    static const Pass deadCodePass{"dce", eliminateDeadCode};
+
+    void optimizeIr(IrModule& module, int level, std::vector<PassTiming>* timings)
+    {
+        static const std::vector<const Pass*> pipelines[] = {
+            {},
+            {&simplifyCfgPass, &constantsPass, &deadCodePass, &simplifyCfgPass},
+            {&simplifyCfgPass, &constantsPass, &valuesPass, &invariantsPass, &deadCodePass, &simplifyCfgPass},
+        };
+        using Clock = std::chrono::steady_clock;
+        if(level <= 0) return;
+        auto& pipeline = pipelines[std::min(level, 2)];
+        //inlining comes first, and the time of every pass is added up over the functions
+        std::vector<std::chrono::duration<double, std::milli>> elapsed(pipeline.size() + 1);
+        auto start = Clock::now();
+        auto graph = buildCallGraph(module);
+        elapsed[0] += Clock::now() - start;
+        //callees are optimized before calls to them are inlined, so what they cost is known
+        for(auto f : graph.bottomUp)
+        {
+            auto& function = module.functions[f];
+            if(function.external) continue;
+            start = Clock::now();
+            inlineCalls(module, f, graph, level);
+            elapsed[0] += Clock::now() - start;
+            for(size_t p = 0; p < pipeline.size(); p++)
+            {
+                start = Clock::now();
+                pipeline[p]->run(module, function);
+                elapsed[p + 1] += Clock::now() - start;
+            }
+        }
+        start = Clock::now();
+        localizeClosures(module);
+        std::chrono::duration<double, std::milli> escape = Clock::now() - start;
+        if(timings == nullptr) return;
+        timings->push_back(PassTiming{"inline", elapsed[0].count()});
+        for(size_t p = 0; p < pipeline.size(); p++) timings->push_back(PassTiming{pipeline[p]->name, elapsed[p + 1].count()});
+        timings->push_back(PassTiming{"escape", escape.count()});
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef optimize_header
+#define optimize_header
+
+#include <vector>
+#include "ir.h"
+
+namespace pilaf {
+    //time one pass took over every function of a module
+    struct PassTiming {
+        const char* name;
+        double milliseconds;
+    };
+
+    //direct calls between a module's functions
+    struct CallGraph {
+        //functions each one calls or uses as a value, without repeats
+        std::vector<std::vector<uint32_t>> callees;
+        //how many calls there are to each function
+        std::vector<uint32_t> sites;
+        //functions that can reach each other through calls share a component
+        std::vector<uint32_t> component;
+        //every function, after the functions it calls outside its component
+        std::vector<uint32_t> bottomUp;
+    };
+
+    CallGraph buildCallGraph(const IrModule& module);
+
+    //runs the passes of optimization level `level` over every function with a body, callees before
+    //their callers. level 0 runs none, level 1 inlines operators, simplifies the control flow,
+    //folds constants and removes dead code, and level 2 also inlines small functions, removes
+    //redundant computations and hoists loop invariants. what each pass took is appended to
+    //`timings` when it is not null
+    void optimizeIr(IrModule& module, int level, std::vector<PassTiming>* timings = nullptr);
+
+    //the passes themselves. each returns whether it changed the function, which stays valid SSA
+
+    //merges blocks into their only predecessor, threads jumps through empty blocks, folds branches
+    //on constants and removes trivial phis and unreachable blocks
+    bool simplifyCfg(IrModule& module, IrFunction& function);
+    //sparse conditional constant propagation: folds what is constant along the paths that can run
+    //and removes the branches that cannot be taken
+    bool propagateConstants(IrModule& module, IrFunction& function);
+    //global value numbering over the dominator tree, plus reuse of loads within a block
+    bool numberValues(IrModule& module, IrFunction& function);
+    //moves computations whose operands do not change in a loop to before it
+    bool hoistLoopInvariants(IrModule& module, IrFunction& function);
+    //removes instructions whose values are unused and that cannot fail or have an effect
+    bool eliminateDeadCode(IrModule& module, IrFunction& function);
+    //replaces calls made by `caller` with the body of the function called. operators defined by
+    //the program with a single block, and functions no bigger than the call, are always inlined;
+    //at level 2 so are functions whose size fits a budget that grows with the loops around the
+    //call. functions in the caller's component never are, so recursion cannot unroll. calls of a
+    //function value the caller makes itself become direct calls first, and are inlined the same way
+    bool inlineCalls(IrModule& module, uint32_t caller, const CallGraph& graph, int level);
+    //escape analysis: a closure that is only called, or passed to parameters that are only called,
+    //cannot outlive the call that makes it, and is made in that call's frame instead of the heap
+    bool localizeClosures(IrModule& module);
+}
+#endif
@@ -0,0 +1,52 @@
+#ifndef options_header
+#define options_header
+
+#include <cstdint>
+#include <string>
+
+namespace pilaf {
+    class DiagnosticEngine;
+
+    enum DiagnosticFormat {
+        DIAGNOSTICS_TEXT,
+        DIAGNOSTICS_JSON
+    };
+
+    struct CompileOptions {
+        //directory holding serialized module interfaces; empty disables the cache
+        std::string interfaceCacheDir;
+        bool dumpConstraints = true;
+        DiagnosticFormat diagnosticFormat = DIAGNOSTICS_TEXT;
+        //at most this many diagnostics are rendered; the rest are only counted
+        size_t maxDiagnostics = 100;
+        //deepest nesting of expressions, statements, patterns and types the parser accepts. every
+        //pass over the syntax tree recurses once per level, so this is what keeps them on the stack
+        size_t maxNestingDepth = 256;
+        //skip function bodies while parsing; each is parsed the first time a pass needs it
+        bool lazyBodies = false;
+        //check declarations and signatures without parsing or inferring any function body
+        bool signaturesOnly = false;
+        //threads that parse top-level declarations of a large source in parallel; 0 uses one per core
+        //and 1 always parses on the calling thread
+        size_t parseThreads = 0;
+        //print the bytecode of every function before running a program
+        bool dumpBytecode = false;
+        //print the SSA form of every function once a program has been analyzed
+        bool dumpIr = false;
+        //print the size, alignment and field offsets native code gives every struct, union and tuple
+        bool printLayouts = false;
+        //which passes run on the IR: none at 0, operator inlining, constant propagation, dead code
+        //elimination and control flow simplification at 1, and inlining of small functions, value
+        //numbering and loop-invariant code motion too at 2. used by both run and build
+        int optLevel = 0;
+        //calls after which `pilaf run` compiles a function to machine code, where it qualifies and
+        //the platform is supported; 0 interprets everything
+        uint32_t jitThreshold = 1000;
+        //print how long each phase of the compilation and each optimization pass took to stderr
+        bool timeReport = false;
+        //collects diagnostics for the caller to inspect or render. when null, a compilation
+        //renders its own diagnostics to stderr once it is done
+        DiagnosticEngine* diagnostics = nullptr;
+    };
+}
+#endif
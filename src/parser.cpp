@@ -1,13 +1,31 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstring>
 #include <cstdio>
+#include <thread>
 #include <utility>
 #include "parser.h"
+#include "interface.h"
 
 namespace pilaf {
+    //set while a range of top-level declarations is parsed on its own thread, into a scope standing
+    //in for the global one. what it records is moved to the global scope once every range is parsed
+    struct RangeParse {
+        ScopeNode* scope;
+        //scopes opened directly in `scope`, which are reparented to the global scope
+        std::vector<std::shared_ptr<ScopeNode>> children;
+        //inference variables are named after the parse, in source order, so that their names do
+        //not depend on which thread got to them first
+        std::vector<std::shared_ptr<TyVar>> generics;
+    };
+    static thread_local RangeParse* rangeParse = nullptr;
+
     std::shared_ptr<ScopeNode> newScope(std::shared_ptr<ScopeNode> parent)
     {
-        return std::make_shared<ScopeNode>(parent);
+        auto s = std::make_shared<ScopeNode>(parent);
+        if(rangeParse != nullptr && parent.get() == rangeParse->scope) rangeParse->children.push_back(s);
+        return s;
     }
 
     std::shared_ptr<ScopeNode> getNamespaceScope(Token name, std::shared_ptr<ScopeNode> scope)
@@ -27,146 +45,279 @@ namespace pilaf {
         return nullptr;
     }
 
-    std::shared_ptr<Ty> generic(std::shared_ptr<Ty> type, std::unordered_map<std::string, std::shared_ptr<Ty>>& replaced)
+    std::shared_ptr<Ty> TypeVarMap::find(Symbol var) const
     {
-        switch(type->type)
+        for(size_t i = 0; i < count && i < inlineCapacity; i++)
+        {
+            if(entries()[i].first == var) return entries()[i].second;
+        }
+        for(auto& entry : overflow)
+        {
+            if(entry.first == var) return entry.second;
+        }
+        return nullptr;
+    }
+
+    void TypeVarMap::insert(Symbol var, std::shared_ptr<Ty> type)
+    {
+        if(count < inlineCapacity) new(entries() + count) Entry(var, type);
+        else overflow.emplace_back(var, type);
+        count++;
+    }
+
+    void TypeVarMap::clear()
+    {
+        for(size_t i = 0; i < count && i < inlineCapacity; i++) entries()[i].~Entry();
+        overflow.clear();
+        count = 0;
+    }
+
+    void releaseType(std::shared_ptr<Ty>& child)
+    {
+        //children freed by the loop below are queued here instead of being freed where they are
+        //dropped. the queue keeps its capacity, so freeing a type allocates nothing
+        static thread_local std::vector<std::shared_ptr<Ty>> dying;
+        static thread_local bool draining = false;
+        if(child == nullptr || child.use_count() != 1) return;
+        if(child->type == Ty::TY_BASIC || child->type == Ty::TY_VAR) return;
+        dying.push_back(std::move(child));
+        if(draining) return;
+        draining = true;
+        while(!dying.empty())
+        {
+            auto last = std::move(dying.back());
+            dying.pop_back();
+            last.reset();
+        }
+        draining = false;
+    }
+
+    BinaryNode::~BinaryNode()
+    {
+        //unlinks the left spine one node at a time, so a long chain is not freed by nested destructors
+        auto left = std::move(expression1);
+        while(left != nullptr && left.use_count() == 1 && left->nodeType == NODE_BINARY)
+        {
+            auto next = std::move(static_cast<BinaryNode*>(left.get())->expression1);
+            left = std::move(next);
+        }
+    }
+
+    std::shared_ptr<node> binarySpine(const std::shared_ptr<node>& n, std::vector<BinaryNode*>& spine)
+    {
+        spine.clear();
+        auto left = n;
+        while(left != nullptr && left->nodeType == NODE_BINARY)
+        {
+            spine.push_back(static_cast<BinaryNode*>(left.get()));
+            left = spine.back()->expression1;
+        }
+        std::reverse(spine.begin(), spine.end());
+        return left;
+    }
+
+    static bool isCompositeType(const std::shared_ptr<Ty>& t)
+    {
+        switch(t->type)
         {
-            case Ty::TY_VAR:
-            {
-                auto t = typeToString(type);
-                if(t.front() == '\'') return type;
-                if(replaced.find(t) != replaced.end())
-                {
-                    return replaced.at(t);
-                }
-                else 
-                {
-                    auto ty = newGenericType();
-                    replaced.emplace(t, ty);
-                    return ty;
-                }
-            }
-            case Ty::TY_BASIC:
-            {
-                return type;
-            }
-            case Ty::TY_ARRAY:
-            {
-                auto arr = std::static_pointer_cast<TyArray>(type);
-                auto arrayOf = generic(arr->arrayOf, replaced);
-                return std::make_shared<TyArray>(arrayOf, arr->size);
-            }
-            case Ty::TY_POINTER:
-            {
-                auto ptr = std::static_pointer_cast<TyPointer>(type);
-                auto pointsTo = generic(ptr->pointsTo, replaced);
-                return std::make_shared<TyPointer>(pointsTo);
-            }
             case Ty::TY_FUNCTION:
-            {
-                auto fn = std::static_pointer_cast<TyFunc>(type);
-                auto in = generic(fn->in, replaced);
-                auto out = generic(fn->out, replaced);
-                return std::make_shared<TyFunc>(in, out);
-            }
-            case Ty::TY_TUPLE:
-            {
-                auto tp = std::static_pointer_cast<TyTuple>(type);
-                std::vector<std::shared_ptr<Ty>> types;
-                for(auto ty : tp->types)
-                {
-                    types.push_back(generic(ty, replaced));
-                }
-                return std::make_shared<TyTuple>(types);
-            }
             case Ty::TY_APPLICATION:
-            {
-                auto app = std::static_pointer_cast<TyAppl>(type);
-                auto applied = generic(app->applied, replaced);
-                std::vector<std::shared_ptr<Ty>> vars;
-                for(auto var : app->vars)
-                {
-                    vars.push_back(generic(var, replaced));
-                }
-                return std::make_shared<TyAppl>(applied, vars);
-            }
+            case Ty::TY_TUPLE:
+            case Ty::TY_ARRAY:
+            case Ty::TY_POINTER:
+            case Ty::TY_REFERENCE:
+                return true;
+            default:
+                return false;
         }
     }
 
-    std::unordered_map<std::string, std::shared_ptr<Ty>> genericMap(std::shared_ptr<Ty> type, std::unordered_map<std::string, std::shared_ptr<Ty>> replaced)
+    size_t typeArity(const Ty& t)
     {
-        switch(type->type)
+        switch(t.type)
         {
-            case Ty::TY_VAR:
-            {
-                auto t = typeToString(type);
-                if(t.front() == '\'') return replaced;
-                if(replaced.find(t) != replaced.end())
-                {
-                    return replaced;
-                }
-                else 
-                {
-                    auto ty = newGenericType();
-                    replaced.emplace(t, ty);
-                    return replaced;
-                }
-            }
-            case Ty::TY_BASIC:
-            {
-                return replaced;
-            }
+            case Ty::TY_FUNCTION: return 2;
+            case Ty::TY_APPLICATION: return 1 + static_cast<const TyAppl&>(t).vars.size();
+            case Ty::TY_TUPLE: return static_cast<const TyTuple&>(t).types.size();
             case Ty::TY_ARRAY:
-            {
-                auto arr = std::static_pointer_cast<TyArray>(type);
-                
-                return genericMap(arr->arrayOf, replaced);
-            }
             case Ty::TY_POINTER:
-            {
-                auto ptr = std::static_pointer_cast<TyPointer>(type);
-                return genericMap(ptr->pointsTo, replaced);
-            }
-            case Ty::TY_FUNCTION:
-            {
-                auto fn = std::static_pointer_cast<TyFunc>(type);
-                auto in = genericMap(fn->in, replaced);
-                auto out = genericMap(fn->out, in);
-                return out;
-            }
-            case Ty::TY_TUPLE:
-            {
-                auto tp = std::static_pointer_cast<TyTuple>(type);
-                auto result = replaced;
-                for(auto ty : tp->types)
+            case Ty::TY_REFERENCE:
+                return 1;
+            default: return 0;
+        }
+    }
+
+    const std::shared_ptr<Ty>& typeChild(const Ty& t, size_t i)
+    {
+        switch(t.type)
+        {
+            case Ty::TY_FUNCTION: return i == 0 ? static_cast<const TyFunc&>(t).in : static_cast<const TyFunc&>(t).out;
+            case Ty::TY_APPLICATION: return i == 0 ? static_cast<const TyAppl&>(t).applied : static_cast<const TyAppl&>(t).vars[i - 1];
+            case Ty::TY_TUPLE: return static_cast<const TyTuple&>(t).types[i];
+            case Ty::TY_ARRAY: return static_cast<const TyArray&>(t).arrayOf;
+            case Ty::TY_POINTER: return static_cast<const TyPointer&>(t).pointsTo;
+            default: return static_cast<const TyRef&>(t).refTo;
+        }
+    }
+
+    //a copy of the composite type `t` with its children replaced by typeArity(t) types from `children`
+    static std::shared_ptr<Ty> withChildren(const std::shared_ptr<Ty>& t, const std::shared_ptr<Ty>* children)
+    {
+        switch(t->type)
+        {
+            case Ty::TY_FUNCTION: return std::make_shared<TyFunc>(children[0], children[1]);
+            case Ty::TY_APPLICATION: return std::make_shared<TyAppl>(children[0], std::vector<std::shared_ptr<Ty>>(children + 1, children + typeArity(*t)));
+            case Ty::TY_TUPLE: return std::make_shared<TyTuple>(std::vector<std::shared_ptr<Ty>>(children, children + typeArity(*t)));
+            case Ty::TY_ARRAY: return std::make_shared<TyArray>(children[0], std::static_pointer_cast<TyArray>(t)->size);
+            case Ty::TY_POINTER: return std::make_shared<TyPointer>(children[0]);
+            case Ty::TY_REFERENCE: return std::make_shared<TyRef>(children[0]);
+            default: return t;
+        }
+    }
+
+    //working storage for mapType. each thread keeps one set and reuses its capacity, so walking a
+    //type allocates nothing but the types it rebuilds
+    struct MapFrame {
+        const std::shared_ptr<Ty>* type;
+        size_t next;
+        size_t arity;
+        //where the rebuilt children of this type start in `results`. children are only
+        //copied there once one of them changes, so unchanged types cost no copies at all
+        size_t results;
+        bool changed;
+    };
+    struct MapScratch {
+        std::vector<MapFrame> stack;
+        std::vector<std::shared_ptr<Ty>> results;
+        //only types with several owners can be reached twice
+        std::unordered_map<const Ty*, std::shared_ptr<Ty>> rebuilt;
+        bool busy = false;
+    };
+
+    template<typename Leaf>
+    static std::shared_ptr<Ty> mapComposite(const std::shared_ptr<Ty>& t, Leaf& leaf)
+    {
+        static thread_local MapScratch shared;
+        //a leaf function that maps another type gets storage of its own
+        MapScratch nested;
+        auto& scratch = shared.busy ? nested : shared;
+        scratch.busy = true;
+        auto& stack = scratch.stack;
+        auto& results = scratch.results;
+        auto& rebuilt = scratch.rebuilt;
+        //frames point into `t`, which the caller keeps alive, so walking it copies no pointers
+        stack.push_back(MapFrame{&t, 0, typeArity(*t), 0, false});
+        auto accept = [&](MapFrame& frame, std::shared_ptr<Ty> child)
+        {
+            auto& type = **frame.type;
+            auto index = frame.next - 1;
+            if(!frame.changed)
+            {
+                if(child == typeChild(type, index)) return;
+                frame.changed = true;
+                for(size_t i = 0; i < index; i++) results.push_back(typeChild(type, i));
+            }
+            results.push_back(std::move(child));
+        };
+        while(true)
+        {
+            auto& top = stack.back();
+            auto& type = *top.type;
+            if(top.next < top.arity)
+            {
+                auto& child = typeChild(*type, top.next++);
+                if(child == nullptr) accept(top, nullptr);
+                else if(!isCompositeType(child)) accept(top, leaf(child));
+                else
                 {
-                    result = genericMap(ty, result);
+                    auto found = child.use_count() > 1 && !rebuilt.empty() ? rebuilt.find(child.get()) : rebuilt.end();
+                    if(found != rebuilt.end()) accept(top, found->second);
+                    else stack.push_back(MapFrame{&child, 0, typeArity(*child), results.size(), false});
                 }
-                return result;
+                continue;
             }
-            case Ty::TY_APPLICATION:
+            //counted before `done` becomes another owner of an unchanged type
+            bool reachable = stack.size() > 1 && type.use_count() > 1;
+            auto done = top.changed ? withChildren(type, results.data() + top.results) : type;
+            results.resize(top.results);
+            if(reachable) rebuilt.emplace(type.get(), done);
+            stack.pop_back();
+            if(stack.empty())
             {
-                auto app = std::static_pointer_cast<TyAppl>(type);
-                auto applied = genericMap(app->applied, replaced);
-                for(auto var : app->vars)
-                {
-                    applied = genericMap(var, applied);
-                }
-                return applied;
+                rebuilt.clear();
+                scratch.busy = false;
+                return done;
             }
+            accept(stack.back(), std::move(done));
         }
     }
 
-    std::string declarationName(std::shared_ptr<Ty> type)
+    std::shared_ptr<Ty> mapType(const std::shared_ptr<Ty>& t, const std::function<std::shared_ptr<Ty>(const std::shared_ptr<Ty>&)>& leaf)
     {
+        if(t == nullptr) return nullptr;
+        if(!isCompositeType(t)) return leaf(t);
+        return mapComposite(t, leaf);
+    }
+
+    static bool isQuantified(const std::shared_ptr<Ty>& t)
+    {
+        return t->type == Ty::TY_VAR && std::static_pointer_cast<TyVar>(t)->id != noSymbol;
+    }
+
+    //whether the composite type `t` mentions a quantified variable
+    static bool hasQuantified(const std::shared_ptr<Ty>& t)
+    {
+        static thread_local std::vector<const Ty*> pending;
+        pending.clear();
+        pending.push_back(t.get());
+        while(!pending.empty())
+        {
+            auto type = pending.back();
+            pending.pop_back();
+            for(size_t i = 0, arity = typeArity(*type); i < arity; i++)
+            {
+                auto& child = typeChild(*type, i);
+                if(child == nullptr) continue;
+                if(isCompositeType(child)) pending.push_back(child.get());
+                else if(isQuantified(child)) return true;
+            }
+        }
+        return false;
+    }
+
+    std::shared_ptr<Ty> generic(std::shared_ptr<Ty> type, TypeVarMap& replaced)
+    {
+        auto instantiate = [&](const std::shared_ptr<Ty>& t) -> std::shared_ptr<Ty>
+        {
+            if(!isQuantified(t)) return t;
+            auto id = std::static_pointer_cast<TyVar>(t)->id;
+            auto found = replaced.find(id);
+            if(found != nullptr) return found;
+            auto ty = newGenericType();
+            replaced.insert(id, ty);
+            return ty;
+        };
+        if(type == nullptr) return nullptr;
+        if(!isCompositeType(type)) return instantiate(type);
+        //monotypes, the common case, are returned without being rebuilt
+        if(!hasQuantified(type)) return type;
+        return mapComposite(type, instantiate);
+    }
+
+    const std::string& declarationName(std::shared_ptr<Ty> type)
+    {
+        static const std::string none;
+        if(type == nullptr) return none;
         switch(type->type)
         {
             case Ty::TY_BASIC:
-                return typeToString(type);
+                return std::static_pointer_cast<TyBasic>(type)->t;
+            case Ty::TY_VAR:
+                return std::static_pointer_cast<TyVar>(type)->var;
             case Ty::TY_APPLICATION:
             {
                 auto app = std::static_pointer_cast<TyAppl>(type);
-                return typeToString(app->applied);
+                return declarationName(app->applied);
             }
             case Ty::TY_POINTER:
             {
@@ -179,7 +330,24 @@ namespace pilaf {
                 return declarationName(arr->arrayOf);
             }
             default:
-                return "";
+                return none;
+        }
+    }
+
+    void StructDeclarationNode::buildFieldTable()
+    {
+        for(size_t i = 0; i < fields.size(); i++)
+        {
+            fieldTable.emplace(intern(std::string_view(fields[i].identifier.start, fields[i].identifier.length)), FieldInfo{i, fields[i].type});
+        }
+    }
+
+    void declareStruct(std::shared_ptr<ScopeNode> scope, std::shared_ptr<StructDeclarationNode> sd)
+    {
+        scope->structs.insert(std::make_pair(declarationName(sd->typeDefined), sd));
+        for(auto& f : sd->fieldTable)
+        {
+            scope->fieldOwners[f.first].push_back(sd);
         }
     }
 
@@ -237,7 +405,7 @@ namespace pilaf {
                     result &= tokencmp(pa.identifier, pb.identifier);
                 }
                 result &= typesEqual(fa->returnType, fb->returnType);
-                result &= compareAST(fa->body, fb->body);
+                result &= compareAST(functionBody(*fa), functionBody(*fb));
                 return result;
             } 
             case NodeType::NODE_VARIABLEDECL: return false; //unimplemented
@@ -302,9 +470,14 @@ namespace pilaf {
                 return compareAST(aa->variable, ab->variable) && compareAST(aa->assignment, ab->assignment);
             }
             case NodeType::NODE_BINARY: {
-                auto ba = std::static_pointer_cast<BinaryNode>(a);
-                auto bb = std::static_pointer_cast<BinaryNode>(b);
-                return tokencmp(ba->op, bb->op) && compareAST(ba->expression1, bb->expression1) && compareAST(ba->expression2, bb->expression2);
+                std::vector<BinaryNode*> sa;
+                std::vector<BinaryNode*> sb;
+                if(!compareAST(binarySpine(a, sa), binarySpine(b, sb)) || sa.size() != sb.size()) return false;
+                for(size_t i = 0; i < sa.size(); i++)
+                {
+                    if(!tokencmp(sa[i]->op, sb[i]->op) || !compareAST(sa[i]->expression2, sb[i]->expression2)) return false;
+                }
+                return true;
             } 
             case NodeType::NODE_UNARY: 
             {
@@ -340,165 +513,224 @@ namespace pilaf {
     
     bool typesEqual(std::shared_ptr<Ty> a, std::shared_ptr<Ty> b)
     {
-        if(a == nullptr || b == nullptr) 
+        std::vector<std::pair<const Ty*, const Ty*>> pending;
+        const Ty* x = a.get();
+        const Ty* y = b.get();
+        while(true)
         {
-            if(a == nullptr && b == nullptr) return true;
-            else return false;
-        }
-        if(a->type != b->type) return false;
-        switch(a->type)
-        {
-            case Ty::TY_FUNCTION:
+            if(x != y)
             {
-                auto fa = std::static_pointer_cast<TyFunc>(a);
-                auto fb = std::static_pointer_cast<TyFunc>(b);
-                return typesEqual(fa->in, fb->in) && typesEqual(fa->out, fb->out);
-            }
-            case Ty::TY_APPLICATION:
-            {
-                auto aa = std::static_pointer_cast<TyAppl>(a);
-                auto ab = std::static_pointer_cast<TyAppl>(b);
-                bool vars = true;
-                if(aa->vars.size() != ab->vars.size())
+                if(x == nullptr || y == nullptr || x->type != y->type) return false;
+                switch(x->type)
                 {
-                    vars = false;
-                }
-                else
-                {
-                    for(auto i = 0; i < aa->vars.size(); i++)
+                    case Ty::TY_VAR:
+                    {
+                        if(static_cast<const TyVar*>(x)->var != static_cast<const TyVar*>(y)->var) return false;
+                        break;
+                    }
+                    case Ty::TY_BASIC:
                     {
-                        vars &= typesEqual(aa->vars[i], ab->vars[i]);
+                        if(static_cast<const TyBasic*>(x)->id != static_cast<const TyBasic*>(y)->id) return false;
+                        break;
                     }
+                    case Ty::TY_ARRAY:
+                    {
+                        if(static_cast<const TyArray*>(x)->size != static_cast<const TyArray*>(y)->size) return false;
+                        break;
+                    }
+                    case Ty::TY_FUNCTION:
+                    case Ty::TY_APPLICATION:
+                    case Ty::TY_TUPLE:
+                    case Ty::TY_POINTER:
+                    case Ty::TY_REFERENCE:
+                        break;
+                    //TY_ARRAYCON,
+                    //TY_FUNCTIONCON,
+                    //TY_TUPLECON,
+                    default: return false;
                 }
-                return  vars && typesEqual(aa->applied, ab->applied);
-            }
-            case Ty::TY_VAR:
-            {
-                auto va = std::static_pointer_cast<TyVar>(a);
-                auto vb = std::static_pointer_cast<TyVar>(b);
-                return va->var.compare(vb->var) == 0;
-            }
-            case Ty::TY_TUPLE:
-            {
-                auto ta = std::static_pointer_cast<TyTuple>(a);
-                auto tb = std::static_pointer_cast<TyTuple>(b);
-                if(ta->types.size() != tb->types.size()) return false;
-                bool result = true;
-                for(size_t i = 0; i < ta->types.size(); i++)
+                auto arity = typeArity(*x);
+                if(arity != typeArity(*y)) return false;
+                for(size_t i = arity; i-- > 0;)
                 {
-                    result &= typesEqual(ta->types[i], tb->types[i]);
+                    pending.emplace_back(typeChild(*x, i).get(), typeChild(*y, i).get());
                 }
-                return result;
-            }
-            case Ty::TY_ARRAY:
-            {
-                auto aa = std::static_pointer_cast<TyArray>(a);
-                auto ab = std::static_pointer_cast<TyArray>(b);
-                return typesEqual(aa->arrayOf, ab->arrayOf) && (aa->size == ab->size);
-            }
-            case Ty::TY_POINTER:
-            {
-                auto pa = std::static_pointer_cast<TyPointer>(a);
-                auto pb = std::static_pointer_cast<TyPointer>(b);
-                return typesEqual(pa->pointsTo, pa->pointsTo);
-            }
-            //TY_ARRAYCON,
-            //TY_FUNCTIONCON,
-            //TY_TUPLECON,
-            case Ty::TY_BASIC:
-            {
-                auto ba = std::static_pointer_cast<TyBasic>(a);
-                auto bb = std::static_pointer_cast<TyBasic>(a);
-                return ba->t.compare(bb->t) == 0;
             }
+            if(pending.empty()) return true;
+            x = pending.back().first;
+            y = pending.back().second;
+            pending.pop_back();
         }
-        return false;
     }
     
-    std::string typeToString(std::shared_ptr<Ty> t)
+    //appends `t` to `out`. with a printer, composite types printed before are copied from its cache
+    static void renderType(const std::shared_ptr<Ty>& t, std::string& out, TypePrinter* printer)
     {
         //does not account for precedence of types, array should wrap functions, pointers; pointers should wrap functions
-        if(t == nullptr) return "";
+        if(t == nullptr) return;
         switch(t->type)
         {
-            case Ty::TY_FUNCTION:
-            {
-                auto ft = std::static_pointer_cast<TyFunc>(t);
-                auto in = typeToString(ft->in);
-                auto out = typeToString(ft->out);
-                if(ft->in->type == Ty::TY_FUNCTION)
+            case Ty::TY_VAR: out.append(std::static_pointer_cast<TyVar>(t)->var); return;
+            case Ty::TY_BASIC: out.append(std::static_pointer_cast<TyBasic>(t)->t); return;
+            default: break;
+        }
+        struct Piece {
+            //points into `t`; written as `text` when null
+            const std::shared_ptr<Ty>* type;
+            const char* text;
+            //where the rendering of `type` starts, once all of its parts have been queued
+            size_t begin;
+        };
+        std::vector<Piece> pending = {Piece{&t, nullptr, SIZE_MAX}};
+        std::vector<Piece> pieces;
+        while(!pending.empty())
+        {
+            auto piece = pending.back();
+            pending.pop_back();
+            if(piece.type == nullptr)
+            {
+                out.append(piece.text);
+                continue;
+            }
+            auto& ty = *piece.type;
+            if(ty == nullptr) continue;
+            if(piece.begin != SIZE_MAX)
+            {
+                //everything inside `ty` has been written; what is left is its suffix
+                if(ty->type == Ty::TY_ARRAY)
                 {
-                    in = std::string("(").append(in).append(")");
+                    auto at = std::static_pointer_cast<TyArray>(ty);
+                    out.push_back('[');
+                    if(at->size.has_value()) out.append(std::to_string(at->size.value()));
+                    out.push_back(']');
                 }
-
-                auto result = in;
-                result.append(" -> ").append(out);
-                return result;
-            }
-            case Ty::TY_APPLICATION:
-            {
-                auto at = std::static_pointer_cast<TyAppl>(t);
-                auto applied = typeToString(at->applied);
-                auto result = applied;
-                for(auto v : at->vars)
+                else if(ty->type == Ty::TY_POINTER) out.push_back('*');
+                else if(ty->type == Ty::TY_REFERENCE) out.push_back('&');
+                if(printer != nullptr) printer->remember(ty, out, piece.begin);
+                continue;
+            }
+            if(printer != nullptr && isCompositeType(ty) && printer->recall(ty, out)) continue;
+            pieces.clear();
+            auto child = [&](const std::shared_ptr<Ty>& c)
+            {
+                pieces.push_back(Piece{&c, nullptr, SIZE_MAX});
+            };
+            auto text = [&](const char* s)
+            {
+                pieces.push_back(Piece{nullptr, s, SIZE_MAX});
+            };
+            auto wrapped = [&](const std::shared_ptr<Ty>& c, bool parenthesize)
+            {
+                if(parenthesize) text("(");
+                child(c);
+                if(parenthesize) text(")");
+            };
+            switch(ty->type)
+            {
+                case Ty::TY_FUNCTION:
                 {
-                    result.append(" ").append(typeToString(v));
+                    auto ft = std::static_pointer_cast<TyFunc>(ty);
+                    wrapped(ft->in, ft->in->type == Ty::TY_FUNCTION);
+                    text(" -> ");
+                    child(ft->out);
+                    break;
                 }
-                return result;
-            }
-            case Ty::TY_VAR:
-            {
-                auto vt = std::static_pointer_cast<TyVar>(t);
-                return vt->var;
-            }
-            case Ty::TY_BASIC:
-            {
-                auto bt = std::static_pointer_cast<TyBasic>(t);
-                return bt->t;
-            }
-            case Ty::TY_TUPLE:
-            {
-                auto tt = std::static_pointer_cast<TyTuple>(t);
-                auto result = std::string("( ");
-                bool first = true;
-                for(auto _t : tt->types)
+                case Ty::TY_APPLICATION:
                 {
-                    if(!first) result.append(", ");
-                    first = false;
-                    result.append(typeToString(_t));
+                    auto at = std::static_pointer_cast<TyAppl>(ty);
+                    child(at->applied);
+                    for(auto& v : at->vars)
+                    {
+                        text(" ");
+                        child(v);
+                    }
+                    break;
                 }
-                result.append(")");
-                return result;
-            }
-            case Ty::TY_ARRAY:
-            {
-                auto at = std::static_pointer_cast<TyArray>(t);
-                auto result = typeToString(at->arrayOf);
-                if(at->arrayOf->type == Ty::TY_FUNCTION || at->type == Ty::TY_POINTER)
+                case Ty::TY_VAR:
                 {
-                    result = std::string("(").append(result).append(")");
+                    out.append(std::static_pointer_cast<TyVar>(ty)->var);
+                    continue;
                 }
-                result.append("[");
-                if(at->size.has_value())
+                case Ty::TY_BASIC:
                 {
-                    result.append(std::to_string(at->size.value()));
+                    out.append(std::static_pointer_cast<TyBasic>(ty)->t);
+                    continue;
                 }
-                result.append("]");
-                return result;
-            }
-            case Ty::TY_POINTER:
-            {
-                auto pt = std::static_pointer_cast<TyPointer>(t);
-                auto result = typeToString(pt->pointsTo);
-                if(pt->pointsTo->type == Ty::TY_FUNCTION)
+                case Ty::TY_TUPLE:
                 {
-                    result = std::string("(").append(result).append(")");
+                    auto tt = std::static_pointer_cast<TyTuple>(ty);
+                    text("( ");
+                    bool first = true;
+                    for(auto& _t : tt->types)
+                    {
+                        if(!first) text(", ");
+                        first = false;
+                        child(_t);
+                    }
+                    text(")");
+                    break;
+                }
+                case Ty::TY_ARRAY:
+                {
+                    auto at = std::static_pointer_cast<TyArray>(ty);
+                    wrapped(at->arrayOf, at->arrayOf->type == Ty::TY_FUNCTION || at->arrayOf->type == Ty::TY_POINTER);
+                    break;
+                }
+                case Ty::TY_POINTER:
+                {
+                    auto pt = std::static_pointer_cast<TyPointer>(ty);
+                    wrapped(pt->pointsTo, pt->pointsTo->type == Ty::TY_FUNCTION);
+                    break;
+                }
+                case Ty::TY_REFERENCE:
+                {
+                    auto rt = std::static_pointer_cast<TyRef>(ty);
+                    wrapped(rt->refTo, rt->refTo->type == Ty::TY_FUNCTION);
+                    break;
+                }
+                default:
+                {
+                    out.append("invalid!");
+                    continue;
                 }
-                result.append("*");
-                return result;
             }
+            pending.push_back(Piece{piece.type, nullptr, out.size()});
+            pending.insert(pending.end(), pieces.rbegin(), pieces.rend());
         }
-        return "invalid!";
+    }
+
+    bool TypePrinter::recall(const std::shared_ptr<Ty>& t, std::string& out) const
+    {
+        auto it = cached.find(t.get());
+        if(it == cached.end()) return false;
+        out.append(cache, it->second.first, it->second.second);
+        return true;
+    }
+
+    void TypePrinter::remember(const std::shared_ptr<Ty>& t, const std::string& out, size_t begin)
+    {
+        //only types met a second time are worth keeping
+        if(seen.insert(t.get()).second) return;
+        cached.emplace(t.get(), std::make_pair(cache.size(), out.size() - begin));
+        cache.append(out, begin, std::string::npos);
+        pinned.push_back(t);
+    }
+
+    void TypePrinter::print(const std::shared_ptr<Ty>& t, std::string& out)
+    {
+        renderType(t, out, this);
+    }
+
+    void typeToString(const std::shared_ptr<Ty>& t, std::string& out)
+    {
+        renderType(t, out, nullptr);
+    }
+
+    std::string typeToString(std::shared_ptr<Ty> t)
+    {
+        std::string result;
+        renderType(t, result, nullptr);
+        return result;
     }
     
     std::shared_ptr<node>expression(Parser *parser, std::shared_ptr<ScopeNode> scope);
@@ -584,26 +816,23 @@ namespace pilaf {
         {TokenTypes::UNDERSCORE, {placeholder, nullptr, PRECEDENCE_NONE, false}}
     };
 
-    static void errorAt(Parser *parser, Token *token, const char *msg)
+    static void errorAt(Parser *parser, Token *token, const char *msg, DiagnosticCode code = DIAG_SYNTAX)
     {
         if (parser->panicMode)
             return;
         parser->panicMode = true;
-        fprintf(stderr, "[line %d] Error", token->line);
-    
-        if (token->type == TokenTypes::_EOF)
-        {
-            fprintf(stderr, " at end");
-        }
-        else if (token->type == TokenTypes::_ERROR)
-        {
-        }
+        //error tokens carry the lexer's message instead of source text
+        if (token->type == TokenTypes::_ERROR)
+            parser->diagnostics->report(code, SEVERITY_ERROR, nullptr, nullptr, msg, {}, token->line);
         else
-        {
-            fprintf(stderr, " at '%.*s'", token->length, token->start);
-        }
+            parser->diagnostics->report(code, SEVERITY_ERROR, token->start, token->start + token->length, msg, {}, token->line);
+        parser->hadError = true;
+    }
     
-        fprintf(stderr, ": %s\n", msg);
+    //reports a problem in otherwise well-formed syntax, so parsing carries on without resynchronizing
+    static void semanticErrorAt(Parser *parser, Token *token, DiagnosticCode code, const char *msg)
+    {
+        parser->diagnostics->report(code, SEVERITY_ERROR, token->start, token->start + token->length, msg, {}, token->line);
         parser->hadError = true;
     }
     
@@ -622,6 +851,20 @@ namespace pilaf {
         errorAt(parser, &parser->previous, msg);
     }
     
+    //one level of nesting, held for as long as a rule that may recurse is running. input nested
+    //past options.maxNestingDepth is reported instead of parsed, so that neither the parser nor the
+    //passes walking its output can run out of stack. operator chains grow without recursing and are
+    //not counted; passes walk them with binarySpine
+    struct Nesting {
+        Parser *parser;
+        bool exceeded;
+        Nesting(Parser *parser) :parser(parser), exceeded(++parser->depth > parser->options->maxNestingDepth)
+        {
+            if(exceeded) errorAt(parser, &parser->current, "nested too deeply!", DIAG_NESTING_TOO_DEEP);
+        }
+        ~Nesting() { parser->depth--; }
+    };
+    
     static void advance(Parser *parser)
     {
         parser->previous = parser->current;
@@ -636,6 +879,13 @@ namespace pilaf {
         }
     }
     
+    //whether a list that ends at `close` has more items. a syntax error or the end of input
+    //also ends it, leaving recovery to the enclosing declaration
+    static bool continueUntil(Parser *parser, TokenTypes close)
+    {
+        return parser->current.type != close && parser->current.type != TokenTypes::_EOF && !parser->panicMode;
+    }
+    
     static void consume(Parser *parser, TokenTypes type, const char *message)
     {
         if (parser->current.type == type)
@@ -656,7 +906,7 @@ namespace pilaf {
     //this function generates strings to represnet arbitrary generic types, 
     //using the form "a", "b"... "z", "aa", "ab"...
     //returns the shortest unused string, and then generates the next one.
-    std::shared_ptr<Ty> newGenericType()
+    static std::string nextGenericName()
     {
         static std::vector<uint8_t> v = {0};
         bool incremented = false;
@@ -668,6 +918,7 @@ namespace pilaf {
             var.push_back('a' + i);
         }
     
+        //counts in base 26; a carry resets the letters it passes, or the name would keep growing
         for(auto it = v.rbegin(); it != v.rend(); it++)
         {
             if(*it != 25)
@@ -676,14 +927,35 @@ namespace pilaf {
                 incremented = true;
                 break;
             }
+            *it = 0;
         }
         if (incremented == false)
         {
-            std::fill(v.begin(), v.end(), 0);
             v.push_back(0);
         }
-        auto result = std::make_shared<TyVar>(var);
-        return result;
+        return var;
+    }
+
+    std::shared_ptr<Ty> newGenericType()
+    {
+        if(rangeParse != nullptr)
+        {
+            auto result = std::make_shared<TyVar>("'");
+            rangeParse->generics.push_back(result);
+            return result;
+        }
+        return std::make_shared<TyVar>(nextGenericName());
+    }
+    
+    std::shared_ptr<Ty> errorType()
+    {
+        return std::make_shared<TyBasic>("<error>");
+    }
+
+    bool isErrorType(const std::shared_ptr<Ty>& t)
+    {
+        static const Symbol errorSymbol = intern("<error>");
+        return t != nullptr && t->type == Ty::TY_BASIC && std::static_pointer_cast<TyBasic>(t)->id == errorSymbol;
     }
     
     static bool is_function_token(Token t)
@@ -732,11 +1004,14 @@ namespace pilaf {
                     return t;
                 }
         }
+        errorAtCurrent(parser, "expected a type!");
         return nullptr;
     }
     
     std::shared_ptr<Ty> paren_type(Parser* parser)
     {
+        Nesting nesting(parser);
+        if(nesting.exceeded) return nullptr;
         if(parser->current.type == TokenTypes::PAREN)
         {
             advance(parser);
@@ -750,7 +1025,7 @@ namespace pilaf {
             {
                 std::vector<std::shared_ptr<Ty>> types;
                 types.push_back(t);
-                while(parser->current.type != TokenTypes::CLOSE_PAREN)
+                while (continueUntil(parser, TokenTypes::CLOSE_PAREN))
                 {
                     consume(parser, TokenTypes::COMMA, "expected ',' between tuple types!");
                     types.push_back(resolve_type_nogeneric(parser));
@@ -772,7 +1047,7 @@ namespace pilaf {
         if(is_function_token(parser->current))
         {
             std::vector<std::shared_ptr<Ty>> vars;
-            while((is_function_token(parser->current)))
+            while(is_function_token(parser->current) && !parser->panicMode)
             {
                 vars.push_back(paren_type(parser));
             }
@@ -864,13 +1139,20 @@ namespace pilaf {
     
     std::shared_ptr<Ty> function_type(Parser* parser)
     {
-        auto in = array_or_pointer_type(parser);
-        if(parser->current.type == TokenTypes::ARROW)
+        //`->` is right associative: the parameters are collected first and the type is built from the last one back
+        std::vector<std::shared_ptr<Ty>> params;
+        auto result = array_or_pointer_type(parser);
+        while(parser->current.type == TokenTypes::ARROW)
         {
             advance(parser);
-            return std::make_shared<TyFunc>(in, resolve_type_nogeneric(parser));
+            params.push_back(result);
+            result = array_or_pointer_type(parser);
         }
-        else return in;
+        for(auto it = params.rbegin(); it != params.rend(); it++)
+        {
+            result = std::make_shared<TyFunc>(*it, result);
+        }
+        return result;
     }
     
     std::shared_ptr<Ty> resolve_type_nogeneric(Parser *parser)
@@ -891,6 +1173,8 @@ namespace pilaf {
 
     std::shared_ptr<node> parsePattern(Parser *parser, std::shared_ptr<ScopeNode> scope)
     {
+        Nesting nesting(parser);
+        if(nesting.exceeded) return nullptr;
         advance(parser);
         if(patternRules.find(parser->previous.type) == patternRules.end()) return nullptr;
         ParseRule *p = &patternRules.at(parser->previous.type);
@@ -901,7 +1185,7 @@ namespace pilaf {
         }
         std::shared_ptr<node> result = p->prefix(parser, scope);
         
-        while(patternRules.find(parser->current.type) != patternRules.end() && patternRules.at(parser->current.type).precedence != PRECEDENCE_NONE)
+        while(!parser->panicMode && patternRules.find(parser->current.type) != patternRules.end() && patternRules.at(parser->current.type).precedence != PRECEDENCE_NONE)
         {
             advance(parser);
             p = &patternRules.at(parser->previous.type);
@@ -943,7 +1227,7 @@ namespace pilaf {
                 advance(parser);
                 std::vector<std::shared_ptr<node>> values;
                 values.push_back(expr);
-                while(parser->current.type != TokenTypes::CLOSE_PAREN)
+                while (continueUntil(parser, TokenTypes::CLOSE_PAREN))
                 {
                     values.push_back(parsePattern(parser, scope));
                     if(parser->current.type != TokenTypes::CLOSE_PAREN)
@@ -963,7 +1247,7 @@ namespace pilaf {
         auto start = parser->previous.start;
         bool hasEllipse = false;
         std::vector<std::shared_ptr<node>> values;
-        while (parser->current.type != TokenTypes::CLOSE_BRACKET)
+        while (continueUntil(parser, TokenTypes::CLOSE_BRACKET))
         {
             values.push_back(parsePattern(parser, scope));
             if (parser->current.type != TokenTypes::CLOSE_BRACKET)
@@ -981,7 +1265,7 @@ namespace pilaf {
         auto start = expression1->start;
         auto called = expression1;
         std::vector<std::shared_ptr<node>> args;
-        while (parser->current.type != TokenTypes::CLOSE_PAREN)
+        while (continueUntil(parser, TokenTypes::CLOSE_PAREN))
         {
             args.push_back(parsePattern(parser, scope));
             if (parser->current.type != TokenTypes::CLOSE_PAREN)
@@ -997,6 +1281,7 @@ namespace pilaf {
 
     std::unordered_map<std::string, std::shared_ptr<Ty>> getIdentifiers(std::shared_ptr<node> n)
     {
+        if(n == nullptr) return {};
         switch(n->nodeType)
         {
             case NODE_IDENTIFIER:
@@ -1084,13 +1369,76 @@ namespace pilaf {
         }
     }
     
+    //scans ahead from the '{' at parser->current to its matching '}' without consuming any tokens.
+    //on success, `lexer` is positioned just past the '}' and `close` holds it.
+    static bool findMatchingBrace(Parser *parser, Lexer *lexer, Token *close)
+    {
+        int depth = 1;
+        *lexer = parser->lexer;
+        Token t = parser->next;
+        while(true)
+        {
+            switch(t.type)
+            {
+                case TokenTypes::BRACE: depth++; break;
+                case TokenTypes::CLOSE_BRACE:
+                {
+                    if(--depth == 0)
+                    {
+                        *close = t;
+                        return true;
+                    }
+                    break;
+                }
+                case TokenTypes::_EOF: return false;
+                default: break;
+            }
+            t = scanToken(lexer);
+        }
+    }
+
+    //resumes parsing after a token range found by findMatchingBrace
+    static void skipTo(Parser *parser, Lexer lexer, Token close)
+    {
+        parser->lexer = lexer;
+        parser->next = close;
+        advance(parser);
+        advance(parser);
+    }
+
     static std::shared_ptr<node> module_decl(Parser *parser, std::shared_ptr<ScopeNode> scope)
     {
         auto start = parser->previous.start;
         consume(parser, TokenTypes::TYPE, "expected module name!");
         auto name = parser->previous;
+        uint64_t hash = 0;
+        if(!parser->options->interfaceCacheDir.empty() && parser->current.type == TokenTypes::BRACE)
+        {
+            Lexer lexer;
+            Token close;
+            if(findMatchingBrace(parser, &lexer, &close))
+            {
+                auto blockStart = parser->current.start;
+                auto end = close.start + close.length;
+                hash = hashModuleSource(name, blockStart, end, scope.get());
+                auto s = newScope(scope);
+                auto interface = loadModuleInterface(interfacePath(parser->options->interfaceCacheDir, name), hash, s);
+                if(interface != nullptr)
+                {
+                    skipTo(parser, lexer, close);
+                    scope->childScopes.push_back(s);
+                    auto block = std::make_shared<BlockStatementNode>(interface->declarations, s, blockStart, end);
+                    auto result = std::make_shared<ModuleDeclarationNode>(name, block, s, start, end);
+                    result->contentHash = hash;
+                    result->interface = interface;
+                    scope->namespaces.emplace(tokenToString(name), s);
+                    return result;
+                }
+            }
+        }
         std::shared_ptr<BlockStatementNode> block = std::static_pointer_cast<BlockStatementNode>(block_stmt(parser, scope));
         auto result = std::make_shared<ModuleDeclarationNode>(name, block, block->scope, start, block->end);
+        result->contentHash = hash;
         scope->namespaces.emplace(tokenToString(name), block->scope);
         return result;
     }
@@ -1100,6 +1448,7 @@ namespace pilaf {
         auto start = parser->previous.start;
         std::shared_ptr<Ty> type = nullptr;
         auto assigned = parsePattern(parser, scope);
+        if(parser->panicMode) return nullptr;
         std::unordered_map<std::string, std::shared_ptr<Ty>> ids = getIdentifiers(assigned);
         
         std::shared_ptr<node> value = nullptr;
@@ -1127,7 +1476,7 @@ namespace pilaf {
         bool isPrefix = false;
         bool isInfix = false;
         bool isPostfix = false;
-        while(parser->current.type != TokenTypes::IDENTIFIER)
+        while (continueUntil(parser, TokenTypes::IDENTIFIER))
         {
             switch(parser->current.type)
             {
@@ -1158,6 +1507,22 @@ namespace pilaf {
         consume(parser, TokenTypes::SEMICOLON, "expected ';' after operator declaration!");
     }
     
+    //binds the parameters in the scope of a function's body
+    static void declareParameters(const std::shared_ptr<node>& body, const std::vector<Parameter>& params)
+    {
+        if(body == nullptr || body->nodeType != NODE_BLOCK) return;
+        std::shared_ptr<ScopeNode> s = std::static_pointer_cast<BlockStatementNode>(body)->scope;
+        for(size_t i = 0; i < params.size(); i++)
+        {
+            auto assigned = std::make_shared<VariableNode>(params[i].identifier);
+            auto type = params[i].type;
+            std::unordered_map<std::string, std::shared_ptr<Ty>> ids = {{tokenToString(params[i].identifier), params[i].type}};
+            auto value = std::make_shared<PlaceholderNode>();
+            auto vd = std::make_shared<VariableDeclarationNode>(type, assigned, ids, value);
+            s->variables.insert(std::make_pair(tokenToString(params[i].identifier), vd));
+        }
+    }
+
     static std::shared_ptr<node> func_decl(Parser *parser, std::shared_ptr<ScopeNode>scope, std::shared_ptr<Ty> isImplOf)
     {
         auto start = parser->previous.start;
@@ -1166,7 +1531,7 @@ namespace pilaf {
         auto fn = scope->functions.find(tokenToString(identifier));
         if (fn != scope->functions.end())
         {
-            if (fn->second->body != nullptr) 
+            if (fn->second->body != nullptr || fn->second->deferred != nullptr) 
             {
                 errorAtCurrent(parser, "redefinition of existing function!");
                 return nullptr;
@@ -1176,7 +1541,7 @@ namespace pilaf {
         advance(parser);
         consume(parser, TokenTypes::PAREN, "expected '(' before parameter list!");
         std::vector<Parameter> params;
-        while (parser->current.type != TokenTypes::CLOSE_PAREN)
+        while (continueUntil(parser, TokenTypes::CLOSE_PAREN))
         {
             Parameter p;
             p.identifier = parser->current;
@@ -1193,6 +1558,8 @@ namespace pilaf {
             params.push_back(p);
             if (parser->current.type == TokenTypes::COMMA)
                 advance(parser);
+            else if (parser->current.type != TokenTypes::CLOSE_PAREN)
+                errorAtCurrent(parser, "expected ',' or ')' after parameter!");
         }
         if(params.size() == 0)
         {
@@ -1209,61 +1576,94 @@ namespace pilaf {
             returnType = resolve_type_nogeneric(parser);
         }
         std::shared_ptr<node> body = nullptr;
-        if (parser->current.type == TokenTypes::BRACE)
+        std::shared_ptr<DeferredBody> deferred = nullptr;
+        Lexer lexer;
+        Token close;
+        //a body is only skipped once its braces are known to match, so its errors stay inside it
+        if (parser->current.type == TokenTypes::BRACE && parser->context != nullptr && findMatchingBrace(parser, &lexer, &close))
+        {
+            deferred = std::make_shared<DeferredBody>(DeferredBody{parser->context, parser->lexer, parser->current, parser->next, parser->depth, scope});
+            skipTo(parser, lexer, close);
+        }
+        else if (parser->current.type == TokenTypes::BRACE)
         {
             body = block_stmt(parser, scope);
-            std::shared_ptr<ScopeNode> s = std::static_pointer_cast<BlockStatementNode>(body)->scope;
-            for(size_t i = 0; i < params.size(); i++)
-            {
-                
-                auto assigned = std::make_shared<VariableNode>(params[i].identifier);
-                auto type = params[i].type;
-                std::unordered_map<std::string, std::shared_ptr<Ty>> ids = {{tokenToString(params[i].identifier), params[i].type}};
-                auto value = std::make_shared<PlaceholderNode>();
-                auto vd = std::make_shared<VariableDeclarationNode>(type, assigned, ids, value);
-                s->variables.insert(std::make_pair(tokenToString(params[i].identifier), vd));
-            }
+            declareParameters(body, params);
         }
         else
         {
             consume(parser, TokenTypes::SEMICOLON, "expected '{' or ';' after function parameters!");
         }
 
+        if(parser->panicMode) return nullptr;
         auto end = parser->previous.start + parser->previous.length;
         auto result = std::make_shared<FunctionDeclarationNode>(returnType, identifier, params, body, start, end);
+        result->deferred = deferred;
     
+        //implementations are registered with their instance by impl_decl
         if(isImplOf == nullptr) 
         {
             scope->functions.insert(std::make_pair(tokenToString(identifier), result));
         }
-        else 
-        {
-            if(scope->functionImpls.find(tokenToString(identifier)) == scope->functionImpls.end())
-            {
-                scope->functionImpls.insert(std::make_pair(tokenToString(identifier), std::unordered_map<std::string, std::shared_ptr<FunctionDeclarationNode>>()));
-            }
-    
-            auto impls = scope->functionImpls.at(tokenToString(identifier));
-    
-            if(impls.find(typeToString(isImplOf)) == impls.end())
-            {
-                impls.insert(std::make_pair(typeToString(isImplOf), result));
-            }
-            //error?
-        }
         return std::static_pointer_cast<node>(result);
     }
     
+    const std::shared_ptr<node>& functionBody(FunctionDeclarationNode& fd)
+    {
+        if(fd.deferred == nullptr) return fd.body;
+        auto deferred = std::move(fd.deferred);
+        auto scope = deferred->scope.lock();
+        if(scope == nullptr) return fd.body;
+        auto& context = *deferred->context;
+        DiagnosticEngine diagnostics(context.source);
+        Parser parser;
+        parser.lexer = deferred->lexer;
+        parser.previous = deferred->open;
+        parser.current = deferred->open;
+        parser.next = deferred->next;
+        parser.hadError = false;
+        parser.panicMode = false;
+        parser.depth = deferred->depth;
+        parser.options = &context.options;
+        parser.diagnostics = context.options.diagnostics != nullptr ? context.options.diagnostics : &diagnostics;
+        parser.context = deferred->context;
+        auto body = block_stmt(&parser, scope);
+        if(parser.panicMode || body == nullptr)
+        {
+            auto end = parser.previous.start + parser.previous.length;
+            body = std::make_shared<ErrorNode>(deferred->open.start, end > deferred->open.start ? end : deferred->open.start);
+        }
+        declareParameters(body, fd.params);
+        fd.body = body;
+        fd.adopt(body);
+        if(parser.diagnostics == &diagnostics) diagnostics.render(stderr, context.options.diagnosticFormat, context.options.maxDiagnostics);
+        return fd.body;
+    }
+
+    //`repr(C)` before the name of a struct or union keeps its fields in the order they are written
+    static bool reprC(Parser *parser)
+    {
+        if(parser->current.type != TokenTypes::IDENTIFIER || tokenToString(parser->current) != "repr" || parser->next.type != TokenTypes::PAREN) return false;
+        advance(parser);
+        advance(parser);
+        if((parser->current.type == TokenTypes::TYPE || parser->current.type == TokenTypes::IDENTIFIER) && tokenToString(parser->current) == "C") advance(parser);
+        else errorAtCurrent(parser, "expected 'C' in repr(...)!");
+        consume(parser, TokenTypes::CLOSE_PAREN, "expected ')' after repr(C!");
+        return true;
+    }
+
     static std::shared_ptr<node> _struct(Parser *parser, std::shared_ptr<ScopeNode> scope)
     {
         auto start = parser->previous.start;
         auto nodeType = NODE_STRUCTDECL;
+        auto declaredOrder = reprC(parser);
         auto typeDefined = resolve_type_nogeneric(parser);
+        if(parser->panicMode) return nullptr;
         auto s = newScope(scope);
         scope->namespaces.emplace(declarationName(typeDefined), s);
         consume(parser, TokenTypes::BRACE, "expected '{' after type name!");
         std::vector<Parameter> fields;
-        while (parser->current.type != TokenTypes::CLOSE_BRACE)
+        while (continueUntil(parser, TokenTypes::CLOSE_BRACE))
         {
             auto pidentifier = parser->current;
             advance(parser);
@@ -1282,11 +1682,11 @@ namespace pilaf {
             consume(parser, TokenTypes::SEMICOLON, "expected ';' after field!");
         }
         consume(parser, TokenTypes::CLOSE_BRACE, "expected '}' after struct or union declaration!");
+        if(parser->panicMode) return nullptr;
         auto end = parser->previous.start + parser->previous.length;
         auto result = std::make_shared<StructDeclarationNode>(typeDefined, fields, s, start, end);
-        {    
-            scope->structs.insert(std::make_pair(declarationName(typeDefined), result));
-        }
+        result->reprC = declaredOrder;
+        declareStruct(scope, result);
         return std::static_pointer_cast<node>(result);
     }
     
@@ -1294,12 +1694,14 @@ static std::shared_ptr<node> _union(Parser *parser, std::shared_ptr<ScopeNode> s
     {
         auto start = parser->previous.start;
         auto nodeType = NODE_UNIONDECL;
+        auto declaredOrder = reprC(parser);
         auto typeDefined = resolve_type_nogeneric(parser);
         consume(parser, TokenTypes::BRACE, "expected '{' after type name!");
+        if(parser->panicMode) return nullptr;
         auto s = newScope(scope);
         scope->namespaces.emplace(declarationName(typeDefined), s);
         std::vector<Parameter> fields;
-        while (parser->current.type != TokenTypes::CLOSE_BRACE)
+        while (continueUntil(parser, TokenTypes::CLOSE_BRACE))
         {
             auto pidentifier = parser->current;
             advance(parser);
@@ -1321,8 +1723,10 @@ static std::shared_ptr<node> _union(Parser *parser, std::shared_ptr<ScopeNode> s
             if(parser->current.type != TokenTypes::CLOSE_BRACE) consume(parser, TokenTypes::COMMA, "expected ',' after union member!");
         }
         consume(parser, TokenTypes::CLOSE_BRACE, "expected '}' after union declaration!");
+        if(parser->panicMode) return nullptr;
         auto end = parser->previous.start + parser->previous.length;
         auto result = std::make_shared<UnionDeclarationNode>(typeDefined, fields, s, start, end);
+        result->reprC = declaredOrder;
         scope->unions.insert(std::make_pair(declarationName(typeDefined), result));
         return std::static_pointer_cast<node>(result);
     }
@@ -1355,7 +1759,7 @@ static std::shared_ptr<node> _union(Parser *parser, std::shared_ptr<ScopeNode> s
         if (parser->current.type == TokenTypes::COLON)
         {
             advance(parser);
-            while (parser->current.type != TokenTypes::BRACE)
+            while (continueUntil(parser, TokenTypes::BRACE))
             {
                 auto constraint = resolve_type(parser);
                 constraints.push_back(constraint);
@@ -1368,17 +1772,20 @@ static std::shared_ptr<node> _union(Parser *parser, std::shared_ptr<ScopeNode> s
     
         consume(parser, TokenTypes::BRACE, "expected '{' after class declaration!");
         std::vector<std::shared_ptr<node>> functions;
-        while (parser->current.type != TokenTypes::CLOSE_BRACE)
+        while (continueUntil(parser, TokenTypes::CLOSE_BRACE))
         {
             consume(parser, TokenTypes::FN, "expected function declaration!");
             std::shared_ptr<node> func = func_decl(parser, scope, nullptr);
             functions.push_back(func);
         }
+        if(parser->panicMode) return nullptr;
         auto s = newScope(scope);
+        auto classSymbol = intern(std::string_view(className.start, className.length));
         for(auto f : functions)
         {
             auto fd = std::static_pointer_cast<FunctionDeclarationNode>(f);
             s->functions.emplace(tokenToString(fd->identifier), fd);
+            scope->instances.declareMethod(intern(std::string_view(fd->identifier.start, fd->identifier.length)), classSymbol);
         }
         scope->namespaces.emplace(tokenToString(className), s);
         consume(parser, TokenTypes::CLOSE_BRACE, "expected '}' after function declarations!");
@@ -1398,15 +1805,20 @@ static std::shared_ptr<node> _union(Parser *parser, std::shared_ptr<ScopeNode> s
         auto implemented = resolve_type(parser);
         consume(parser, TokenTypes::BRACE, "expected '{' before function definitions!");
         std::vector<std::shared_ptr<node>> functions;
-        while(parser->current.type != TokenTypes::CLOSE_BRACE)
+        while (continueUntil(parser, TokenTypes::CLOSE_BRACE))
         {
             consume(parser, TokenTypes::FN, "expected function declaration in class implementation!");
             auto fd = func_decl(parser, scope, implemented);
             functions.push_back(fd);
         }
         consume(parser, TokenTypes::CLOSE_BRACE, "expected '}' after function definitions!");
+        if(parser->panicMode) return nullptr;
         auto end = parser->previous.start + parser->previous.length;
         auto result = std::make_shared<ClassImplementationNode>(_class, implemented, functions, start, end);
+        if(implemented != nullptr && scope->instances.add(makeInstance(result)) != nullptr)
+        {
+            semanticErrorAt(parser, &_class, DIAG_OVERLAPPING_INSTANCE, "overlapping instance declaration!");
+        }
         return std::static_pointer_cast<node>(result);
     }
     
@@ -1461,9 +1873,66 @@ static std::shared_ptr<node> _union(Parser *parser, std::shared_ptr<ScopeNode> s
         }
     }
     
+    //skips past a syntax error to the next token that can start a declaration. braces opened
+    //while skipping are skipped with their contents; inside a block, the block's own closing
+    //brace is left for it to consume
+    static void synchronize(Parser *parser, bool inBlock)
+    {
+        parser->panicMode = false;
+        size_t depth = 0;
+        while (continueUntil(parser, TokenTypes::_EOF))
+        {
+            if (depth == 0)
+            {
+                if (parser->previous.type == TokenTypes::SEMICOLON) return;
+                switch (parser->current.type)
+                {
+                    case TokenTypes::LET:
+                    case TokenTypes::FN:
+                    case TokenTypes::STRUCT:
+                    case TokenTypes::UNION:
+                    case TokenTypes::TYPEDEF:
+                    case TokenTypes::MODULE:
+                    case TokenTypes::CLASS:
+                    case TokenTypes::IMPLEMENT:
+                    case TokenTypes::IF:
+                    case TokenTypes::FOR:
+                    case TokenTypes::WHILE:
+                    case TokenTypes::SWITCH:
+                    case TokenTypes::RETURN:
+                        return;
+                    case TokenTypes::CLOSE_BRACE:
+                        if (inBlock) return;
+                        break;
+                    default:
+                        break;
+                }
+            }
+            if (parser->current.type == TokenTypes::BRACE) depth++;
+            else if (parser->current.type == TokenTypes::CLOSE_BRACE && depth > 0) depth--;
+            advance(parser);
+        }
+    }
+
+    //parses a declaration in a block or at the top level. one with a syntax error is replaced
+    //by an ErrorNode covering everything skipped, and parsing resumes after it
+    static std::shared_ptr<node> recoverable_decl(Parser *parser, std::shared_ptr<ScopeNode> scope, bool inBlock)
+    {
+        auto start = parser->current.start;
+        auto dec = declaration(parser, scope);
+        if (!parser->panicMode) return dec;
+        synchronize(parser, inBlock);
+        //a declaration that failed on its first token would be retried forever
+        if (parser->current.start == start && parser->current.type != TokenTypes::_EOF) advance(parser);
+        auto end = parser->previous.start + parser->previous.length;
+        return std::make_shared<ErrorNode>(start, end > start ? end : start);
+    }
+
     static std::shared_ptr<node> switch_stmt(Parser *parser, std::shared_ptr<ScopeNode> scope)
     {
-        auto start = parser->previous.start;
+        Nesting nesting(parser);
+        if(nesting.exceeded) return nullptr;
+        auto start = parser->current.start;
         advance(parser);
         consume(parser, TokenTypes::PAREN, "expected '(' after 'switch!'");
         auto switchExpr = expression(parser, scope);
@@ -1501,7 +1970,9 @@ static std::shared_ptr<node> _union(Parser *parser, std::shared_ptr<ScopeNode> s
     
     static std::shared_ptr<node> for_stmt(Parser *parser, std::shared_ptr<ScopeNode>scope)
     {
-        auto start = parser->previous.start;
+        Nesting nesting(parser);
+        if(nesting.exceeded) return nullptr;
+        auto start = parser->current.start;
         advance(parser);
         std::shared_ptr<node> initExpr = nullptr;
         std::shared_ptr<node> condExpr = nullptr;
@@ -1513,14 +1984,17 @@ static std::shared_ptr<node> _union(Parser *parser, std::shared_ptr<ScopeNode> s
             switch(parser->current.type)
             {
                 case TokenTypes::LET:
+                    //the declaration consumes its own ';'
+                    advance(parser);
                     initExpr = var_decl(parser, scope);
                     break;
                 default:
                     initExpr = expression(parser, scope);
+                    consume(parser, TokenTypes::SEMICOLON, "expected ';' after declaration/expression!");
                     break;
             }
         }
-        consume(parser, TokenTypes::SEMICOLON, "expected ';' after declaration/expression!");
+        else advance(parser);
         if (parser->current.type != TokenTypes::SEMICOLON)
         {
             condExpr = expression(parser, scope);
@@ -1539,7 +2013,9 @@ static std::shared_ptr<node> _union(Parser *parser, std::shared_ptr<ScopeNode> s
     
     static std::shared_ptr<node> if_stmt(Parser *parser, std::shared_ptr<ScopeNode>scope)
     {
-        auto start = parser->previous.start;
+        Nesting nesting(parser);
+        if(nesting.exceeded) return nullptr;
+        auto start = parser->current.start;
         advance(parser);
         consume(parser, TokenTypes::PAREN, "expected '(' after 'if!'");
         auto branchExpr = expression(parser, scope);
@@ -1562,7 +2038,9 @@ static std::shared_ptr<node> _union(Parser *parser, std::shared_ptr<ScopeNode> s
     
     static std::shared_ptr<node> while_stmt(Parser *parser, std::shared_ptr<ScopeNode>scope)
     {
-        auto start = parser->previous.start;
+        Nesting nesting(parser);
+        if(nesting.exceeded) return nullptr;
+        auto start = parser->current.start;
         advance(parser);
         consume(parser, TokenTypes::PAREN, "expected '(' after 'while!'");
         auto loopExpr = expression(parser, scope);
@@ -1575,15 +2053,17 @@ static std::shared_ptr<node> _union(Parser *parser, std::shared_ptr<ScopeNode> s
     
     std::shared_ptr<node> block_stmt(Parser *parser, std::shared_ptr<ScopeNode>scope)
     {
+        Nesting nesting(parser);
+        if(nesting.exceeded) return nullptr;
         advance(parser);
         auto start = parser->previous.start;
         std::shared_ptr<ScopeNode> next = newScope(scope);
         scope->childScopes.push_back(next);
         scope = next;
         std::vector<std::shared_ptr<node>> declarations;
-        while (parser->current.type != TokenTypes::CLOSE_BRACE)
+        while (continueUntil(parser, TokenTypes::CLOSE_BRACE))
         {
-            auto dec = declaration(parser, scope);
+            auto dec = recoverable_decl(parser, scope, true);
             if(dec != nullptr) declarations.push_back(dec);
         }
         consume(parser, TokenTypes::CLOSE_BRACE, "expect '}' at end of block!");
@@ -1594,7 +2074,7 @@ static std::shared_ptr<node> _union(Parser *parser, std::shared_ptr<ScopeNode> s
     
     static std::shared_ptr<node> return_stmt(Parser *parser, std::shared_ptr<ScopeNode> scope)
     {
-        auto start = parser->previous.start;
+        auto start = parser->current.start;
         advance(parser);
         auto returnExpr = expression(parser, scope);
         consume(parser, TokenTypes::SEMICOLON, "expected ';' after return expression!");
@@ -1666,6 +2146,8 @@ static uint8_t getOperatorPrecedence(Token op, std::shared_ptr<ScopeNode> scope)
     
     static std::shared_ptr<node> parsePrecedence(Parser *parser, uint8_t prec, std::shared_ptr<ScopeNode> scope)
     {
+        Nesting nesting(parser);
+        if(nesting.exceeded) return nullptr;
         advance(parser);
         if(rules.find(parser->previous.type) != rules.end())
         {
@@ -1678,7 +2160,7 @@ static uint8_t getOperatorPrecedence(Token op, std::shared_ptr<ScopeNode> scope)
 
             std::shared_ptr<node> result = p->prefix(parser, scope);
 
-            while (rules.find(parser->current.type) != rules.end() && prec <= (parser->current.type == TokenTypes::OPERATOR ? getOperatorPrecedence(parser->current, scope) : getRule(parser->current.type)->precedence))
+            while (!parser->panicMode && rules.find(parser->current.type) != rules.end() && prec <= (parser->current.type == TokenTypes::OPERATOR ? getOperatorPrecedence(parser->current, scope) : getRule(parser->current.type)->precedence))
             {
                 advance(parser);
                 p = getRule(parser->previous.type);
@@ -1696,7 +2178,7 @@ static uint8_t getOperatorPrecedence(Token op, std::shared_ptr<ScopeNode> scope)
                     }
                 }
                 result = p->infix(parser, scope, result);
-            }
+                }
             return result;
         }
         error(parser, "expected an expression!");
@@ -1747,7 +2229,7 @@ static uint8_t getOperatorPrecedence(Token op, std::shared_ptr<ScopeNode> scope)
         auto start = expression1->start;
         std::vector<Token> fieldNames;
         std::vector<std::shared_ptr<node>> values;
-        while(parser->current.type != TokenTypes::CLOSE_BRACE)
+        while (continueUntil(parser, TokenTypes::CLOSE_BRACE))
         {
             auto temp = expression(parser, scope);
             if(parser->current.type == TokenTypes::COLON)
@@ -1789,12 +2271,20 @@ static uint8_t getOperatorPrecedence(Token op, std::shared_ptr<ScopeNode> scope)
         auto returnType = newGenericType();
         consume(parser, TokenTypes::PAREN, "expected '(' before lambda arguments!");
         std::vector<Parameter> params;
-        while(parser->current.type != TokenTypes::CLOSE_PAREN)
+        while (continueUntil(parser, TokenTypes::CLOSE_PAREN))
         {
             Parameter p;
-            p.type = resolve_type(parser);
             p.identifier = parser->current;
-            advance(parser);
+            consume(parser, TokenTypes::IDENTIFIER, "expected a name for the lambda argument!");
+            if(parser->current.type == TokenTypes::COLON)
+            {
+                advance(parser);
+                p.type = resolve_type_nogeneric(parser);
+            }
+            else
+            {
+                p.type = newGenericType();
+            }
             params.push_back(p);
             if (parser->current.type == TokenTypes::COMMA)
                 advance(parser);
@@ -1828,7 +2318,7 @@ static uint8_t getOperatorPrecedence(Token op, std::shared_ptr<ScopeNode> scope)
                 advance(parser);
                 std::vector<std::shared_ptr<node>> values;
                 values.push_back(expr);
-                while(parser->current.type != TokenTypes::CLOSE_PAREN)
+                while (continueUntil(parser, TokenTypes::CLOSE_PAREN))
                 {
                     values.push_back(expression(parser, scope));
                     if(parser->current.type != TokenTypes::CLOSE_PAREN)
@@ -1921,7 +2411,7 @@ static uint8_t getOperatorPrecedence(Token op, std::shared_ptr<ScopeNode> scope)
     {
         auto start = parser->previous.start;
         std::vector<std::shared_ptr<node>> values;
-        while (parser->current.type != TokenTypes::CLOSE_BRACKET)
+        while (continueUntil(parser, TokenTypes::CLOSE_BRACKET))
         {
             values.push_back(expression(parser, scope));
             if (parser->current.type != TokenTypes::CLOSE_BRACKET)
@@ -1940,7 +2430,7 @@ static uint8_t getOperatorPrecedence(Token op, std::shared_ptr<ScopeNode> scope)
         auto start = expression1->start;
         auto called = expression1;
         std::vector<std::shared_ptr<node>> args;
-        while (parser->current.type != TokenTypes::CLOSE_PAREN)
+        while (continueUntil(parser, TokenTypes::CLOSE_PAREN))
         {
             args.push_back(expression(parser, scope));
             if (parser->current.type != TokenTypes::CLOSE_PAREN)
@@ -2020,7 +2510,7 @@ static uint8_t getOperatorPrecedence(Token op, std::shared_ptr<ScopeNode> scope)
                     printf("%s %.*s", typeToString(n->params[i].type).c_str(), n->params[i].identifier.length, n->params[i].identifier.start);
                 }
                 printf("\n");
-                if (n->body != nullptr)
+                if (functionBody(*n) != nullptr)
                 {
                     printf("Body:\n");
                     printNodes(n->body, depth + 1);
@@ -2251,10 +2741,21 @@ static uint8_t getOperatorPrecedence(Token op, std::shared_ptr<ScopeNode> scope)
             }
             case NODE_BINARY:
             {
-                auto n = std::static_pointer_cast<BinaryNode>(start);
-                printf("Type: Binary Operation; Operator: %.*s.\n", n->op.length, n->op.start);
-                printNodes(n->expression1, depth + 1);
-                printNodes(n->expression2, depth + 1);
+                //the chain's links are printed down its left spine, then their right operands back up it
+                std::vector<BinaryNode*> spine;
+                auto left = binarySpine(start, spine);
+                int links = (int)spine.size();
+                for(int i = links - 1; i >= 0; i--)
+                {
+                    if(i != links - 1)
+                    {
+                        printf(">");
+                        for(int j = 0; j < depth + links - 1 - i; j++) printf("  ");
+                    }
+                    printf("Type: Binary Operation; Operator: %.*s.\n", spine[i]->op.length, spine[i]->op.start);
+                }
+                printNodes(left, depth + links);
+                for(int i = 0; i < links; i++) printNodes(spine[i]->expression2, depth + links - i);
                 break;
             }
             case NODE_ASSIGNMENT:
@@ -2311,13 +2812,292 @@ static uint8_t getOperatorPrecedence(Token op, std::shared_ptr<ScopeNode> scope)
         }
     }
     
-    std::shared_ptr<ProgramNode> parse(const char* src)
+    //sources smaller than this are parsed on one thread; splitting them costs more than it saves
+    static const size_t parallelParseMinimum = 64 * 1024;
+
+    //a run of top-level declarations, parsed on its own into a scope standing in for the global one
+    struct DeclarationRange {
+        //positioned just before the range's first token
+        Lexer lexer;
+        //first token of the next range; null for the last one
+        const char* end;
+        std::shared_ptr<ScopeNode> scope;
+        std::vector<std::shared_ptr<node>> declarations;
+        RangeParse recorded;
+        Token last;
+        bool parsed;
+    };
+
+    //splits `src` into ranges of top-level declarations without parsing it. a range may only start at
+    //a declaration keyword outside of any brackets that follows a ';' or '}'. operator declarations
+    //at the top level are returned as well, since they change how every range after them parses.
+    //fails on a lexical error or unbalanced brackets, which the sequential parse reports
+    static bool prescan(const char* src, size_t ranges, std::vector<DeclarationRange>& result, std::vector<std::pair<Lexer, const char*>>& operators)
+    {
+        std::vector<std::pair<Lexer, const char*>> starts;
+        Lexer lexer = initLexer(src);
+        size_t depth = 0;
+        TokenTypes previous = TokenTypes::SEMICOLON;
+        while(true)
+        {
+            Lexer before = lexer;
+            Token t = scanToken(&lexer);
+            switch(t.type)
+            {
+                case TokenTypes::_EOF: break;
+                case TokenTypes::_ERROR: return false;
+                case TokenTypes::PAREN:
+                case TokenTypes::BRACE:
+                case TokenTypes::BRACKET: depth++; break;
+                case TokenTypes::CLOSE_PAREN:
+                case TokenTypes::CLOSE_BRACE:
+                case TokenTypes::CLOSE_BRACKET:
+                {
+                    if(depth == 0) return false;
+                    depth--;
+                    break;
+                }
+                case TokenTypes::PREFIX:
+                case TokenTypes::INFIX:
+                case TokenTypes::POSTFIX:
+                case TokenTypes::LET:
+                case TokenTypes::FN:
+                case TokenTypes::STRUCT:
+                case TokenTypes::UNION:
+                case TokenTypes::TYPEDEF:
+                case TokenTypes::MODULE:
+                case TokenTypes::CLASS:
+                case TokenTypes::IMPLEMENT:
+                {
+                    if(depth != 0 || (previous != TokenTypes::SEMICOLON && previous != TokenTypes::CLOSE_BRACE)) break;
+                    if(t.type == TokenTypes::PREFIX || t.type == TokenTypes::INFIX || t.type == TokenTypes::POSTFIX) operators.emplace_back(before, t.start);
+                    if(t.start != src) starts.emplace_back(before, t.start);
+                    break;
+                }
+                default: break;
+            }
+            if(t.type == TokenTypes::_EOF) break;
+            previous = t.type;
+        }
+        if(depth != 0 || starts.empty()) return false;
+
+        //ranges of about equal length, each starting at the first declaration past its share
+        size_t length = lexer.current - src;
+        result.push_back(DeclarationRange{initLexer(src), nullptr, nullptr, {}, {}, {}, false});
+        auto next = starts.begin();
+        for(size_t i = 1; i < ranges && next != starts.end(); i++)
+        {
+            auto target = src + length * i / ranges;
+            next = std::lower_bound(next, starts.end(), target, [](const std::pair<Lexer, const char*>& s, const char* p) { return s.second < p; });
+            if(next == starts.end()) break;
+            result.back().end = next->second;
+            result.push_back(DeclarationRange{next->first, nullptr, nullptr, {}, {}, {}, false});
+            next++;
+        }
+        return result.size() > 1;
+    }
+
+    static void startParser(Parser& parser, Lexer lexer, const CompileOptions& options, DiagnosticEngine* diagnostics, std::shared_ptr<ParseContext> context)
+    {
+        parser.lexer = lexer;
+        parser.hadError = false;
+        parser.panicMode = false;
+        parser.depth = 0;
+        parser.options = &options;
+        parser.diagnostics = diagnostics;
+        parser.context = context;
+        advance(&parser);
+        advance(&parser);
+    }
+
+    //parses one range and checks that it ended exactly where the next one begins
+    static void parseRange(const char* src, const CompileOptions& options, std::shared_ptr<ParseContext> context, DeclarationRange& range)
+    {
+        DiagnosticEngine diagnostics(src);
+        Parser parser;
+        range.recorded.scope = range.scope.get();
+        rangeParse = &range.recorded;
+        startParser(parser, range.lexer, options, &diagnostics, context);
+        while(parser.current.type != TokenTypes::_EOF && (range.end == nullptr || parser.current.start < range.end))
+        {
+            auto dec = recoverable_decl(&parser, range.scope, false);
+            if(dec != nullptr) range.declarations.push_back(dec);
+        }
+        rangeParse = nullptr;
+        range.last = parser.previous;
+        bool ended = range.end == nullptr ? parser.current.type == TokenTypes::_EOF : parser.current.start == range.end;
+        range.parsed = ended && !parser.hadError && diagnostics.all().empty();
+    }
+
+    //whether a function declared in a range would redefine one that an earlier range gave a body
+    static bool redefinesFunction(const ScopeNode& global, const std::shared_ptr<node>& dec)
+    {
+        auto defined = [&](const std::shared_ptr<node>& f)
+        {
+            auto fd = std::static_pointer_cast<FunctionDeclarationNode>(f);
+            auto it = global.functions.find(tokenToString(fd->identifier));
+            return it != global.functions.end() && (it->second->body != nullptr || it->second->deferred != nullptr);
+        };
+        switch(dec->nodeType)
+        {
+            case NODE_FUNCTIONDECL: return defined(dec);
+            case NODE_CLASSDECL: return std::any_of(std::static_pointer_cast<ClassDeclarationNode>(dec)->functions.begin(), std::static_pointer_cast<ClassDeclarationNode>(dec)->functions.end(), defined);
+            case NODE_CLASSIMPL: return std::any_of(std::static_pointer_cast<ClassImplementationNode>(dec)->functions.begin(), std::static_pointer_cast<ClassImplementationNode>(dec)->functions.end(), defined);
+            default: return false;
+        }
+    }
+
+    //moves what a range declared into the global scope, as if it had been parsed there. fails
+    //where the sequential parse would have reported an error across ranges
+    static bool mergeRange(ProgramNode& ast, DeclarationRange& range)
+    {
+        auto& global = *ast.globalScope;
+        auto& scope = *range.scope;
+        for(auto& dec : range.declarations)
+        {
+            if(redefinesFunction(global, dec)) return false;
+        }
+        //instances and class methods are registered again, in declaration order, with the global table
+        for(auto& dec : range.declarations)
+        {
+            if(dec->nodeType == NODE_CLASSIMPL)
+            {
+                auto impl = std::static_pointer_cast<ClassImplementationNode>(dec);
+                if(impl->implemented != nullptr && global.instances.add(makeInstance(impl)) != nullptr) return false;
+            }
+            else if(dec->nodeType == NODE_CLASSDECL)
+            {
+                auto cd = std::static_pointer_cast<ClassDeclarationNode>(dec);
+                auto classSymbol = intern(std::string_view(cd->className.start, cd->className.length));
+                for(auto& f : cd->functions)
+                {
+                    auto fd = std::static_pointer_cast<FunctionDeclarationNode>(f);
+                    global.instances.declareMethod(intern(std::string_view(fd->identifier.start, fd->identifier.length)), classSymbol);
+                }
+            }
+        }
+        //names an earlier range declared keep their first declaration, as they would in one scope
+        global.opRules.merge(scope.opRules);
+        global.variables.merge(scope.variables);
+        global.structs.merge(scope.structs);
+        global.unions.merge(scope.unions);
+        global.tyCons.merge(scope.tyCons);
+        global.typeAliases.merge(scope.typeAliases);
+        global.functions.merge(scope.functions);
+        global.classes.merge(scope.classes);
+        global.namespaces.merge(scope.namespaces);
+        for(auto& owners : scope.fieldOwners)
+        {
+            auto& merged = global.fieldOwners[owners.first];
+            merged.insert(merged.end(), owners.second.begin(), owners.second.end());
+        }
+        global.childScopes.insert(global.childScopes.end(), scope.childScopes.begin(), scope.childScopes.end());
+        for(auto& child : range.recorded.children) child->parentScope = ast.globalScope;
+
+        auto retarget = [&](const std::shared_ptr<node>& f)
+        {
+            auto fd = std::static_pointer_cast<FunctionDeclarationNode>(f);
+            if(fd->deferred != nullptr) fd->deferred->scope = ast.globalScope;
+        };
+        for(auto& dec : range.declarations)
+        {
+            if(dec->nodeType == NODE_FUNCTIONDECL) retarget(dec);
+            else if(dec->nodeType == NODE_CLASSDECL) for(auto& f : std::static_pointer_cast<ClassDeclarationNode>(dec)->functions) retarget(f);
+            else if(dec->nodeType == NODE_CLASSIMPL) for(auto& f : std::static_pointer_cast<ClassImplementationNode>(dec)->functions) retarget(f);
+            ast.declarations.push_back(dec);
+        }
+        return true;
+    }
+
+    //parses the top-level declarations of `src` on several threads and merges them in source order.
+    //returns null whenever the result could differ from a sequential parse (any syntax error, a
+    //declaration crossing a range boundary, a conflict between ranges), leaving that parse to report it
+    static std::shared_ptr<ProgramNode> parseParallel(const char* src, const CompileOptions& options, std::shared_ptr<ParseContext> context, size_t threads)
+    {
+        std::vector<DeclarationRange> ranges;
+        std::vector<std::pair<Lexer, const char*>> operators;
+        //more ranges than threads, so that a thread that finishes early can take another
+        if(!prescan(src, threads * 4, ranges, operators)) return nullptr;
+
+        //each range sees the operators declared before it, and declares its own as it is parsed
+        std::unordered_map<std::string, ParseRule> declared;
+        auto op = operators.begin();
+        for(auto& range : ranges)
+        {
+            range.scope = std::make_shared<ScopeNode>(nullptr);
+            range.scope->opRules = declared;
+            for(; op != operators.end() && (range.end == nullptr || op->second < range.end); op++)
+            {
+                DiagnosticEngine diagnostics(src);
+                Parser parser;
+                startParser(parser, op->first, options, &diagnostics, nullptr);
+                auto scope = std::make_shared<ScopeNode>(nullptr);
+                op_decl(&parser, scope);
+                if(parser.hadError) return nullptr;
+                declared.merge(scope->opRules);
+            }
+        }
+
+        std::atomic<size_t> next(0);
+        auto work = [&]()
+        {
+            for(size_t i = next++; i < ranges.size(); i = next++)
+            {
+                try
+                {
+                    parseRange(src, options, context, ranges[i]);
+                }
+                catch(...)
+                {
+                    rangeParse = nullptr;
+                    ranges[i].parsed = false;
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for(size_t i = 1; i < std::min(threads, ranges.size()); i++) workers.emplace_back(work);
+        work();
+        for(auto& worker : workers) worker.join();
+
+        auto ast = std::make_shared<ProgramNode>();
+        ast->start = src;
+        ast->nodeType = NODE_PROGRAM;
+        ast->globalScope = newScope(nullptr);
+        ast->context = context;
+        for(auto& range : ranges)
+        {
+            if(!range.parsed || !mergeRange(*ast, range)) return nullptr;
+        }
+        for(auto& range : ranges)
+        {
+            for(auto& var : range.recorded.generics) var->var = nextGenericName();
+        }
+        ast->end = ranges.back().last.start + ranges.back().last.length;
+        ast->parseThreads = std::min(threads, ranges.size());
+        return ast;
+    }
+
+    std::shared_ptr<ProgramNode> parse(const char* src, const CompileOptions& options)
     {
         Lexer lexer = initLexer(src);
         Parser parser;
         parser.lexer = lexer;
         parser.hadError = false;
         parser.panicMode = false;
+        parser.depth = 0;
+        parser.options = &options;
+        DiagnosticEngine diagnostics(src);
+        parser.diagnostics = options.diagnostics != nullptr ? options.diagnostics : &diagnostics;
+        if(options.lazyBodies || options.signaturesOnly)
+        {
+            parser.context = std::make_shared<ParseContext>(ParseContext{src, options});
+        }
+        size_t threads = options.parseThreads != 0 ? options.parseThreads : std::thread::hardware_concurrency();
+        if(threads > 1 && strlen(src) >= parallelParseMinimum)
+        {
+            auto ast = parseParallel(src, options, parser.context, threads);
+            if(ast != nullptr) return ast;
+        }
         advance(&parser);
         advance(&parser);
     
@@ -2325,9 +3105,10 @@ static uint8_t getOperatorPrecedence(Token op, std::shared_ptr<ScopeNode> scope)
         ast->start = src;
         ast->nodeType = NODE_PROGRAM;
         ast->globalScope = newScope(nullptr);
+        ast->context = parser.context;
         while (parser.current.type != TokenTypes::_EOF)
         {
-            auto dec = declaration(&parser, ast->globalScope);
+            auto dec = recoverable_decl(&parser, ast->globalScope, false);
             if(dec != nullptr)
             {
                 ast->declarations.push_back(dec);
@@ -2335,12 +3116,10 @@ static uint8_t getOperatorPrecedence(Token op, std::shared_ptr<ScopeNode> scope)
         }
         ast->end = parser.previous.start + parser.previous.length;
         ast->hadError = parser.hadError;
-        if (!ast->hadError)
-        {
-            //printNodes(std::static_pointer_cast<node>(ast), 0);
-            //printf("%.*s\n", ast->end - ast->start, ast->start);
-            return ast;
-        }
-        return nullptr;
+        ast->containsError = parser.hadError;
+        if (parser.diagnostics == &diagnostics) diagnostics.render(stderr, options.diagnosticFormat, options.maxDiagnostics);
+        //printNodes(std::static_pointer_cast<node>(ast), 0);
+        //printf("%.*s\n", ast->end - ast->start, ast->start);
+        return ast;
     }
 }
\ No newline at end of file
@@ -1,14 +1,27 @@
 #ifndef parser_header
 #define parser_header
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <deque>
 #include <optional>
 #include "lexer.h"
+#include "options.h"
+#include "diagnostics.h"
+#include "instances.h"
 
 namespace pilaf {
+    //what a body skipped by a lazy parse still needs from that parse when it is parsed later
+    struct ParseContext {
+        const char* source;
+        //diagnostics is null unless the caller collects them, since the parse's own engine is gone by then
+        CompileOptions options;
+    };
+
     struct Parser {
         Lexer lexer;
         Token next;
@@ -16,6 +29,12 @@ namespace pilaf {
         Token previous;
         bool hadError;
         bool panicMode;
+        //how many expressions, statements, patterns and types are being parsed inside each other
+        size_t depth;
+        const CompileOptions* options;
+        DiagnosticEngine* diagnostics;
+        //set when function bodies are skipped and parsed on demand
+        std::shared_ptr<ParseContext> context;
     };
     
     enum Precedence
@@ -40,6 +59,9 @@ namespace pilaf {
     
     struct node;
     struct ScopeNode;
+    struct Kind;
+    struct Specialization;
+    struct ModuleInterface;
     
     struct ParseRule
     {
@@ -97,10 +119,22 @@ namespace pilaf {
         NodeType nodeType;
         const char* start;
         const char* end;
+        //set when this node or one below it failed to parse. nodes are built bottom-up, so each
+        //constructor only has to look at its direct children
+        bool containsError;
     
-        virtual bool hasError() {return false;}
+        bool hasError() const { return containsError; }
+        void adopt(const std::shared_ptr<node>& child)
+        {
+            if(child == nullptr) return;
+            if(child->containsError) containsError = true;
+        }
+        void adopt(const std::vector<std::shared_ptr<node>>& children)
+        {
+            for(auto& child : children) adopt(child);
+        }
         node(NodeType n, const char* s = nullptr, const char* e = nullptr)
-            :nodeType(n), start(s), end(e) {}
+            :nodeType(n), start(s), end(e), containsError(n == NODE_ERROR) {}
     };
     
     struct Ty {
@@ -125,12 +159,17 @@ namespace pilaf {
         Ty(TyNodeType t, const char* start, const char* end)
         :type(t), start(start), end(end) {};
     };
+
+    //drops a child of a type that is being destroyed. freeing a deep type would otherwise
+    //recurse once per level, so children whose last owner is going away are freed in a loop
+    void releaseType(std::shared_ptr<Ty>& child);
     
     struct TyFunc : public Ty {
         std::shared_ptr<Ty> in;
         std::shared_ptr<Ty> out;
         TyFunc(std::shared_ptr<Ty> in, std::shared_ptr<Ty> out, const char* s = nullptr, const char* e = nullptr)
         : in(in), out(out), Ty(Ty::TY_FUNCTION, s, e) {}
+        ~TyFunc() { releaseType(in); releaseType(out); }
     };
     
     struct TyAppl : public Ty {
@@ -138,24 +177,30 @@ namespace pilaf {
         std::vector<std::shared_ptr<Ty>> vars;
         TyAppl(std::shared_ptr<Ty> applied, std::vector<std::shared_ptr<Ty>> vars, const char* s = nullptr, const char* e = nullptr)
         : applied(applied), vars(vars), Ty(Ty::TY_APPLICATION, s, e) {}
+        ~TyAppl() { releaseType(applied); for(auto& v : vars) releaseType(v); }
     };
     
     struct TyVar : public Ty {
         std::string var;
+        //interned name of a quantified variable; inference variables ('-prefixed) are never interned
+        Symbol id;
         TyVar(std::string var, const char* s = nullptr, const char* e = nullptr)
-        : var(var), Ty(Ty::TY_VAR, s, e) {}
+        : var(var), id(var.empty() || var.front() == '\'' ? noSymbol : intern(var)), Ty(Ty::TY_VAR, s, e) {}
     };
     
     struct TyBasic : public Ty {
         std::string t;
+        //interned name, so that equal basic types compare without touching their strings
+        Symbol id;
         TyBasic(std::string t, const char* s = nullptr, const char* e = nullptr)
-        : t(t), Ty(Ty::TY_BASIC, s, e) {}
+        : t(t), id(intern(t)), Ty(Ty::TY_BASIC, s, e) {}
     };
     
     struct TyTuple : public Ty {
         std::vector<std::shared_ptr<Ty>> types;
         TyTuple(std::vector<std::shared_ptr<Ty>> types, const char* s = nullptr, const char* e = nullptr)
         : types(types), Ty(Ty::TY_TUPLE, s, e) {}
+        ~TyTuple() { for(auto& t : types) releaseType(t); }
     };
     
     struct TyArray : public Ty {
@@ -163,6 +208,7 @@ namespace pilaf {
         std::optional<size_t> size;
         TyArray(std::shared_ptr<Ty> arrayOf, std::optional<size_t> size, const char* s = nullptr, const char* e = nullptr)
         : arrayOf(arrayOf), size(size), Ty(Ty::TY_ARRAY, s, e) {}
+        ~TyArray() { releaseType(arrayOf); }
     };
 
     struct TyPointer : public Ty
@@ -170,6 +216,7 @@ namespace pilaf {
         std::shared_ptr<Ty> pointsTo;
         TyPointer(std::shared_ptr<Ty> pointsTo, const char* s = nullptr, const char* e = nullptr)
         : pointsTo(pointsTo), Ty(Ty::TY_POINTER, s, e) {}
+        ~TyPointer() { releaseType(pointsTo); }
     };
 
     struct TyRef : public Ty
@@ -177,6 +224,7 @@ namespace pilaf {
         std::shared_ptr<Ty> refTo;
         TyRef(std::shared_ptr<Ty> refTo, const char* s = nullptr, const char* e = nullptr)
         : refTo(refTo), Ty(Ty::TY_REFERENCE, s, e) {}
+        ~TyRef() { releaseType(refTo); }
     };
     
     struct Parameter {
@@ -188,10 +236,6 @@ namespace pilaf {
     std::shared_ptr<Ty> typeDefined;
     std::shared_ptr<Ty> typeAliased;
 
-    virtual bool hasError()
-    {
-        return false;
-    }
     TypedefNode(std::shared_ptr<Ty> td, std::shared_ptr<Ty> ta, const char* s = nullptr, const char* e = nullptr)
         :typeDefined(td), typeAliased(ta), node(NodeType::NODE_TYPEDEF, s, e) {}
     };
@@ -201,52 +245,70 @@ namespace pilaf {
         Token name;
         std::shared_ptr<node> block;
         std::shared_ptr<ScopeNode> scope;
-        virtual bool hasError()
-        {
-            return block->hasError();
-        }
+        uint64_t contentHash;
+        //set when the module was loaded from a cached interface instead of parsed;
+        //owns the storage that the declarations' tokens point into
+        std::shared_ptr<ModuleInterface> interface;
         ModuleDeclarationNode(Token name, std::shared_ptr<node> block, std::shared_ptr<ScopeNode> scope, const char* s = nullptr, const char* e = nullptr)
-        : name(name), block(block), scope(scope), node(NODE_MODULE, s, e) {}
+        : name(name), block(block), scope(scope), contentHash(0), interface(nullptr), node(NODE_MODULE, s, e) { adopt(block); }
     };
     
+    //where a field sits in memory is decided by the LayoutEngine once the struct is instantiated
+    struct FieldInfo {
+        size_t index;
+        std::shared_ptr<Ty> type;
+    };
+
     struct StructDeclarationNode : public node {
     std::shared_ptr<Ty>  typeDefined;
-    std::shared_ptr<Ty> kind;
+    const Kind* kind;
     std::vector<Parameter> fields;
+    //fields by name, built once when the declaration is created
+    std::unordered_map<Symbol, FieldInfo> fieldTable;
     std::shared_ptr<ScopeNode> scope;
-    virtual bool hasError()
+    //declared repr(C), which keeps the fields in the order they are written
+    bool reprC = false;
+    const FieldInfo* field(Symbol name) const
     {
-        return false;
+        auto it = fieldTable.find(name);
+        return it == fieldTable.end() ? nullptr : &it->second;
     }
+    void buildFieldTable();
     StructDeclarationNode(std::shared_ptr<Ty> t, std::vector<Parameter>f, std::shared_ptr<ScopeNode> scope, const char* s = nullptr, const char* e = nullptr)
-        :typeDefined(t), kind(nullptr), fields(f), scope(scope), node(NodeType::NODE_STRUCTDECL, s, e) {}
+        :typeDefined(t), kind(nullptr), fields(f), scope(scope), node(NodeType::NODE_STRUCTDECL, s, e) { buildFieldTable(); }
     };
 
     struct UnionDeclarationNode : public node {
     std::shared_ptr<Ty>  typeDefined;
-    std::shared_ptr<Ty> kind;
+    const Kind* kind;
     std::vector<Parameter> members;
     std::shared_ptr<ScopeNode> scope;
-    virtual bool hasError()
-    {
-        return false;
-    }
+    bool reprC = false;
     UnionDeclarationNode(std::shared_ptr<Ty> t, std::vector<Parameter>m, std::shared_ptr<ScopeNode> scope, const char* s = nullptr, const char* e = nullptr)
         :typeDefined(t), kind(nullptr), members(m), scope(scope), node(NodeType::NODE_UNIONDECL, s, e) {}
     };
     
+    //a function body skipped by a lazy parse: the parser state at its '{', to resume from later
+    struct DeferredBody {
+        std::shared_ptr<ParseContext> context;
+        Lexer lexer;
+        Token open;
+        Token next;
+        size_t depth;
+        //weak like ScopeNode::childScopes, since the scope owns the function
+        std::weak_ptr<ScopeNode> scope;
+    };
+
     struct FunctionDeclarationNode : public node {
         std::shared_ptr<Ty> returnType;
         Token identifier;
         std::vector<Parameter> params;
+        //null until a skipped body is parsed; use functionBody() unless skipped bodies should stay unparsed
         std::shared_ptr<node> body;
-        virtual bool hasError()
-        {
-            return body? body->hasError() : false;
-        }
+        std::shared_ptr<DeferredBody> deferred;
 
         FunctionDeclarationNode(std::shared_ptr<Ty> rt, Token id, std::vector<Parameter> p, std::shared_ptr<node> b, const char* s = nullptr, const char* e = nullptr)
-            :returnType(rt), identifier(id), params(p), body(b), node(NodeType::NODE_FUNCTIONDECL, s, e) {}  
+            :returnType(rt), identifier(id), params(p), body(b), node(NodeType::NODE_FUNCTIONDECL, s, e) { adopt(body); }
     };
     
     struct VariableDeclarationNode : public node {
@@ -254,12 +316,8 @@ namespace pilaf {
         std::shared_ptr<node> assigned;
         std::unordered_map<std::string, std::shared_ptr<Ty>> identifiers;
         std::shared_ptr<node> value;
-        virtual bool hasError()
-        {
-            return value? value->hasError() : false;
-        }
         VariableDeclarationNode(std::shared_ptr<Ty>t, std::shared_ptr<node> assigned, std::unordered_map<std::string, std::shared_ptr<Ty>> ids, std::shared_ptr<node>v, const char* s = nullptr, const char* e = nullptr)
-            :type(t), assigned(assigned), identifiers(ids), value(v), node(NodeType::NODE_VARIABLEDECL, s, e) {}
+            :type(t), assigned(assigned), identifiers(ids), value(v), node(NodeType::NODE_VARIABLEDECL, s, e) { adopt(assigned); adopt(value); }
     };
     
     struct RangePatternNode : public node 
@@ -267,75 +325,45 @@ namespace pilaf {
         std::shared_ptr<node> expression1;
         std::shared_ptr<node> expression2;
         bool isInclusive;
-        virtual bool hasError()
-        {
-            return expression1->hasError() || expression2->hasError();
-        }
         RangePatternNode(std::shared_ptr<node> e1, std::shared_ptr<node> e2, bool inc, const char* s = nullptr, const char* e = nullptr)
-        : expression1(e1), expression2(e2), isInclusive(inc) ,node(NodeType::NODE_RANGE, s, e){}
+        : expression1(e1), expression2(e2), isInclusive(inc) ,node(NodeType::NODE_RANGE, s, e){ adopt(expression1); adopt(expression2); }
     };
 
     struct EllipsePatternNode : public node 
     {
         std::shared_ptr<node> expr;
         EllipsePatternNode (std::shared_ptr<node> expr, const char* s = nullptr, const char* e = nullptr)
-        :expr(expr), node(NodeType::NODE_ELLIPSE, s, e) {}
+        :expr(expr), node(NodeType::NODE_ELLIPSE, s, e) { adopt(this->expr); }
     };
 
     struct ClassDeclarationNode : public node 
     {
         Token className;
         Token typeName;
-        std::shared_ptr<Ty> kind;
+        const Kind* kind;
         std::vector<std::shared_ptr<Ty>> constraints;
         std::vector<std::shared_ptr<node>> functions;
-        virtual bool hasError()
-        {
-            bool result = false;
-            for(auto f : functions)
-            {
-                result |= f->hasError();
-            }
-            return result;
-        }
         ClassDeclarationNode(Token cn, Token tn, std::vector<std::shared_ptr<Ty>> c, std::vector<std::shared_ptr<node>> f, const char* s = nullptr, const char* e = nullptr)
-            :className(cn), typeName(tn), constraints(c), functions(f), node(NodeType::NODE_CLASSDECL, s, e) {}
+            :className(cn), typeName(tn), kind(nullptr), constraints(c), functions(f), node(NodeType::NODE_CLASSDECL, s, e) { adopt(functions); }
     };
     
     struct ClassImplementationNode : public node {
         Token _class;
         std::shared_ptr<Ty> implemented;
         std::vector<std::shared_ptr<node>> functions;
-        virtual bool hasError()
-        {
-            bool result = false;
-            for(auto f : functions)
-            {
-                result |= f->hasError();
-            }
-            return result;
-        }
         ClassImplementationNode(Token c, std::shared_ptr<Ty> i, std::vector<std::shared_ptr<node>> f, const char* s = nullptr, const char* e = nullptr)
-            :_class(c), implemented(i), functions(f), node(NodeType::NODE_CLASSIMPL, s, e){}
+            :_class(c), implemented(i), functions(f), node(NodeType::NODE_CLASSIMPL, s, e){ adopt(functions); }
     };
 
     struct NamespaceNode : public node {
         Token name;
         std::shared_ptr<node> expr;
-        virtual bool hasError()
-        {
-            return expr->hasError();
-        }
         NamespaceNode(Token name, std::shared_ptr<node> expr, const char* s = nullptr, const char* e = nullptr)
-            :name(name), expr(expr), node(NodeType::NODE_NAMESPACE, s, e) {};
+            :name(name), expr(expr), node(NodeType::NODE_NAMESPACE, s, e) { adopt(this->expr); }
     };
 
     struct TypeNode : public node {
         std::shared_ptr<Ty> type;
-        virtual bool hasError()
-        {
-            return false;
-        }
         TypeNode(std::shared_ptr<Ty>t, const char* s = nullptr, const char* e = nullptr)
             :type(t), node(NodeType::NODE_TYPE, s, e) {};
     };
@@ -347,20 +375,16 @@ namespace pilaf {
         std::unordered_map<std::string, std::shared_ptr<VariableDeclarationNode>> variables;
         std::unordered_map<std::string, std::shared_ptr<StructDeclarationNode>> structs;
         std::unordered_map<std::string, std::shared_ptr<UnionDeclarationNode>> unions;
-        std::unordered_multimap<std::string, std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> fields;
+        //structs declared in this scope by the names of their fields, for inferring a record from a field access
+        std::unordered_map<Symbol, std::vector<std::shared_ptr<StructDeclarationNode>>> fieldOwners;
         std::unordered_map<std::string, std::shared_ptr<TypeNode>> tyCons;
         std::unordered_map<std::string, std::shared_ptr<TypedefNode>> typeAliases;
         std::unordered_map<std::string, std::shared_ptr<FunctionDeclarationNode>> functions;
         std::unordered_map<std::string, std::shared_ptr<ClassDeclarationNode>> classes;
-        std::unordered_map<std::string, std::shared_ptr<node>> classImpls;
-        std::unordered_map<std::string, std::unordered_map<std::string, std::shared_ptr<FunctionDeclarationNode>>> functionImpls;
+        InstanceTable instances;
         std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> constraints;
         std::unordered_map<std::shared_ptr<Ty>, std::shared_ptr<node>> nodeTVars;
         std::unordered_map<std::string, std::shared_ptr<ScopeNode>> namespaces;
-        virtual bool hasError()
-        {
-            return false;
-        }
         ScopeNode(std::shared_ptr<ScopeNode> parent = nullptr) 
             :parentScope(parent), node(NodeType::NODE_SCOPE) {}
     };
@@ -368,38 +392,34 @@ namespace pilaf {
     struct ProgramNode : public node {
         std::vector<std::shared_ptr<node>> declarations;
         std::shared_ptr<ScopeNode> globalScope;
+        std::vector<std::shared_ptr<Specialization>> specializations;
+        //the solver's substitutions, in the order applySubstitutions expects; empty until analyze succeeds
+        std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> substitutions;
+        //constraints handed to the solver by analyze
+        size_t constraintCount;
+        //constraints dropped or unified before reaching the solver
+        size_t constraintsEliminated;
         bool hadError;
-        virtual bool hasError()
-        {
-            return hadError;
-        }
-        ProgramNode() :hadError(false), globalScope(nullptr), node(NodeType::NODE_PROGRAM) {}
+        //shared with the function bodies this parse skipped; null when none were
+        std::shared_ptr<ParseContext> context;
+        //threads the declarations were parsed on; 1 unless the parallel parser ran
+        size_t parseThreads;
+        ProgramNode() :hadError(false), globalScope(nullptr), constraintCount(0), constraintsEliminated(0), parseThreads(1), node(NodeType::NODE_PROGRAM) {}
     };
     
     struct IfStatementNode : public node {
         std::shared_ptr<node> branchExpr;
         std::shared_ptr<node> thenStmt;
         std::shared_ptr<node> elseStmt;
-        virtual bool hasError()
-        {
-            return branchExpr? branchExpr->hasError() : false ||
-            thenStmt->hasError() ||
-            elseStmt? elseStmt->hasError() : false;
-        }
         IfStatementNode(std::shared_ptr<node> b, std::shared_ptr<node> t, std::shared_ptr<node> els, const char* s = nullptr, const char* e = nullptr)
-            :branchExpr(b), thenStmt(t), elseStmt(els), node(NodeType::NODE_IF, s, e) {}
+            :branchExpr(b), thenStmt(t), elseStmt(els), node(NodeType::NODE_IF, s, e) { adopt(branchExpr); adopt(thenStmt); adopt(elseStmt); }
     };
     
     struct WhileStatementNode : public node {
         std::shared_ptr<node> loopExpr;
         std::shared_ptr<node> loopStmt;
-        virtual bool hasError()
-        {
-            return loopExpr? loopExpr->hasError() : false ||
-            loopStmt? loopStmt->hasError() : false;
-        }
         WhileStatementNode(std::shared_ptr<node> le, std::shared_ptr<node> ls, const char* s = nullptr, const char* e = nullptr)
-            :loopExpr(le), loopStmt(ls), node(NodeType::NODE_WHILE, s, e) {}
+            :loopExpr(le), loopStmt(ls), node(NodeType::NODE_WHILE, s, e) { adopt(loopExpr); adopt(loopStmt); }
     };
     
     struct ForStatementNode : public node {
@@ -407,238 +427,132 @@ namespace pilaf {
         std::shared_ptr<node> condExpr;
         std::shared_ptr<node> incrementExpr;
         std::shared_ptr<node> loopStmt;
-        virtual bool hasError()
-        {
-            return initExpr? initExpr->hasError() : false ||
-            condExpr? condExpr->hasError() : false ||
-            incrementExpr? incrementExpr->hasError() : false ||
-            loopStmt? loopStmt->hasError() : false;
-        }
         ForStatementNode(std::shared_ptr<node> init, std::shared_ptr<node> cond, std::shared_ptr<node> incr, std::shared_ptr<node>loop, const char* s = nullptr, const char* e = nullptr)
-            :initExpr(init), condExpr(cond), incrementExpr(incr), loopStmt(loop), node(NodeType::NODE_FOR, s, e) {}
+            :initExpr(init), condExpr(cond), incrementExpr(incr), loopStmt(loop), node(NodeType::NODE_FOR, s, e) { adopt(initExpr); adopt(condExpr); adopt(incrementExpr); adopt(loopStmt); }
     };
     
     struct CaseNode : public node {
         std::shared_ptr<node> caseExpr;
         std::shared_ptr<node> caseStmt;
         std::shared_ptr<ScopeNode> scope;
-        virtual bool hasError()
-        {
-            return caseExpr? caseExpr->hasError() : false ||
-            caseStmt? caseStmt->hasError() : false;
-        }
         CaseNode(std::shared_ptr<node>ce, std::shared_ptr<node>cs, std::shared_ptr<ScopeNode> scope, const char* s = nullptr, const char* e = nullptr)
-            :caseExpr(ce), caseStmt(cs), scope(scope), node(NodeType::NODE_CASE, s, e) {}
+            :caseExpr(ce), caseStmt(cs), scope(scope), node(NodeType::NODE_CASE, s, e) { adopt(caseExpr); adopt(caseStmt); }
     };
     
     struct SwitchStatementNode : public node {
         std::shared_ptr<node> switchExpr;
         std::vector<std::shared_ptr<node>> cases;
-        virtual bool hasError()
-        {
-            bool result = switchExpr? switchExpr->hasError() : false;
-            for(auto _case : cases)
-            {
-                result |= _case->hasError();
-            }
-            return result;
-        }
         SwitchStatementNode(std::shared_ptr<node>se, std::vector<std::shared_ptr<node>>cases, const char* s = nullptr, const char* e = nullptr)
-            :switchExpr(se), cases(cases), node(NodeType::NODE_SWITCH, s, e) {}
+            :switchExpr(se), cases(cases), node(NodeType::NODE_SWITCH, s, e) { adopt(switchExpr); adopt(this->cases); }
     };
     
     struct ReturnStatementNode : public node { 
         std::shared_ptr<node> returnExpr;
-        virtual bool hasError()
-        {
-            return returnExpr? returnExpr->hasError() : false;
-        }
         ReturnStatementNode(std::shared_ptr<node> re, const char* s = nullptr, const char* e = nullptr)
-            :returnExpr(re), node(NodeType::NODE_RETURN, s, e) {}
+            :returnExpr(re), node(NodeType::NODE_RETURN, s, e) { adopt(returnExpr); }
     };
     
     struct BlockStatementNode : public node {  
         std::shared_ptr<ScopeNode> scope;
         std::vector<std::shared_ptr<node>> declarations;
-        virtual bool hasError()
-        {
-            bool result = false;
-            for(auto dec : declarations)
-            {
-                result |= dec->hasError();
-            }
-            return result;
-        }
         BlockStatementNode(std::vector<std::shared_ptr<node>> declarations, std::shared_ptr<ScopeNode> scope, const char* s = nullptr, const char* e = nullptr)
-            :declarations(declarations), scope(scope), node(NodeType::NODE_BLOCK, s, e) {};
+            :declarations(declarations), scope(scope), node(NodeType::NODE_BLOCK, s, e) { adopt(this->declarations); }
     };
     
     struct ArrayIndexNode : public node {  
         std::shared_ptr<node> array;
         std::shared_ptr<node> index;
-        virtual bool hasError()
-        {
-            return array? array->hasError() : false || index? index->hasError() : false;
-        }
         ArrayIndexNode(std::shared_ptr<node>a, std::shared_ptr<node>i, const char* s = nullptr, const char* e = nullptr)
-            :array(a), index(i), node(NodeType::NODE_ARRAYINDEX, s, e) {}
+            :array(a), index(i), node(NodeType::NODE_ARRAYINDEX, s, e) { adopt(array); adopt(index); }
     };
     
     struct FunctionCallNode : public node {
         std::shared_ptr<node> called;
         std::vector<std::shared_ptr<node>> args;
-        virtual bool hasError()
-        {
-            bool result = false;
-            result |= called? called->hasError() : false;
-            for(auto arg : args)
-            {
-                result |= arg->hasError();
-            }
-            return result;
-        }
+        //the callee's type instantiated at this call, recorded by typeInf
+        std::shared_ptr<Ty> calleeType;
+        //set by specializeCalls when the call statically resolves to a class method implementation
+        std::shared_ptr<Specialization> target;
         FunctionCallNode(std::shared_ptr<node>c, std::vector<std::shared_ptr<node>>a, const char* s = nullptr, const char* e = nullptr)
-            :called(c), args(a), node(NodeType::NODE_FUNCTIONCALL, s, e) {}
+            :called(c), args(a), calleeType(nullptr), target(nullptr), node(NodeType::NODE_FUNCTIONCALL, s, e) { adopt(called); adopt(args); }
     };
     
     struct ArrayConstructorNode : public node {
         std::vector<std::shared_ptr<node>> values;
-        virtual bool hasError()
-        {
-            bool result = false;
-            for(auto value : values)
-            {
-                result |= value->hasError();
-            }
-            return result;
-        }
         ArrayConstructorNode(std::vector<std::shared_ptr<node>>v, const char* s = nullptr, const char* e = nullptr)
-            :values(v), node(NodeType::NODE_ARRAYCONSTRUCTOR, s, e) {}
+            :values(v), node(NodeType::NODE_ARRAYCONSTRUCTOR, s, e) { adopt(values); }
     };
     
     struct FieldCallNode : public node {
         std::shared_ptr<node> expr;
         Token field;
-        virtual bool hasError()
-        {
-            return expr? expr->hasError() : false;
-        }
         FieldCallNode(std::shared_ptr<node>ex, Token f, const char* s = nullptr, const char* e = nullptr)
-            :expr(ex), field(f), node(NodeType::NODE_FIELDCALL, s, e) {}
+            :expr(ex), field(f), node(NodeType::NODE_FIELDCALL, s, e) { adopt(expr); }
     };
     
     struct LambdaNode : public node {
         std::shared_ptr<Ty> returnType;
         std::vector<Parameter> params;
         std::shared_ptr<node> body;
-        virtual bool hasError()
-        {
-            return body? body->hasError() : false;
-        }
         LambdaNode(std::shared_ptr<Ty> rt, std::vector<Parameter> p, std::shared_ptr<node> b, const char* s = nullptr, const char* e = nullptr)
-            :returnType(rt), params(p), body(b), node(NodeType::NODE_LAMBDA, s, e) {}
+            :returnType(rt), params(p), body(b), node(NodeType::NODE_LAMBDA, s, e) { adopt(body); }
     };
     
     struct AssignmentNode : public node {
         std::shared_ptr<node> variable;
         std::shared_ptr<node> assignment;
-        virtual bool hasError()
-        {
-            return variable? variable->hasError() : false || assignment? assignment->hasError() : false;
-        }
         AssignmentNode(std::shared_ptr<node>v, std::shared_ptr<node>a, const char* s = nullptr, const char* e = nullptr)
-            :variable(v), assignment(a), node(NodeType::NODE_ASSIGNMENT, s, e) {}
+            :variable(v), assignment(a), node(NodeType::NODE_ASSIGNMENT, s, e) { adopt(variable); adopt(assignment); }
     };
     
     struct BinaryNode : public node {
         std::shared_ptr<node> expression1;
         Token op;
         std::shared_ptr<node> expression2;
-        virtual bool hasError()
-        {
-            return expression1? expression1->hasError() : false || expression2? expression2->hasError() : false;
-        }
         BinaryNode(std::shared_ptr<node>e1, Token o, std::shared_ptr<node>e2, const char* s = nullptr, const char* e = nullptr)
-            :expression1(e1), op(o), expression2(e2), node(NodeType::NODE_BINARY, s, e) {}
+            :expression1(e1), op(o), expression2(e2), node(NodeType::NODE_BINARY, s, e) { adopt(expression1); adopt(expression2); }
+        ~BinaryNode();
     };
     
     struct UnaryNode : public node {
         Token op;
         std::shared_ptr<node> expression;
-        virtual bool hasError()
-        {
-            return expression? expression->hasError() : false;
-        }
         UnaryNode(Token o, std::shared_ptr<node>ex, const char* s = nullptr, const char* e = nullptr)
-            :op(o), expression(ex), node(NodeType::NODE_UNARY, s, e) {}
+            :op(o), expression(ex), node(NodeType::NODE_UNARY, s, e) { adopt(expression); }
     };
     
     struct VariableNode : public node {
         Token variable;
-        virtual bool hasError()
-        {
-            return false;
-        }
         VariableNode(Token v, const char* s = nullptr, const char* e = nullptr)
             :variable(v), node(NodeType::NODE_IDENTIFIER, s, e) {}
     };
     
     struct LiteralNode : public node {
         Token value;
-        virtual bool hasError()
-        {
-            return false;
-        }
         LiteralNode(Token v, const char* s = nullptr, const char* e = nullptr)
             :value(v), node(NodeType::NODE_LITERAL, s, e) {}
     };
     
     struct TupleConstructorNode : public node {
         std::vector<std::shared_ptr<node>> values;
-        virtual bool hasError()
-        {
-            bool result = false;
-            for(auto value : values)
-            {
-                result |= value->hasError();
-            }
-            return result;
-        }
         TupleConstructorNode(std::vector<std::shared_ptr<node>>v, const char* s = nullptr, const char* e = nullptr)
-            :values(v), node(NodeType::NODE_TUPLE, s, e){}
+            :values(v), node(NodeType::NODE_TUPLE, s, e){ adopt(values); }
     };
     
     struct ListInitNode : public node {
         std::shared_ptr<node> type;
         std::vector<Token> fieldNames;
         std::vector<std::shared_ptr<node>> values;
-        virtual bool hasError()
-        {
-            bool result = false;
-            for(auto value : values)
-            {
-                result |= value->hasError();
-            }
-            return result;
-        }
         ListInitNode(std::shared_ptr<node>t, std::vector<Token>fn, std::vector<std::shared_ptr<node>>v, const char* s = nullptr, const char* e = nullptr)
-            :type(t), fieldNames(fn), values(v), node(NodeType::NODE_LISTINIT, s, e) {}
+            :type(t), fieldNames(fn), values(v), node(NodeType::NODE_LISTINIT, s, e) { adopt(type); adopt(values); }
     };
     
     struct ErrorNode : public node {
-        virtual bool hasError()
-        {
-            return true;
-        }
         ErrorNode(const char* s = nullptr, const char* e = nullptr)
             :node(NodeType::NODE_ERROR, s, e) {}
     };
     
     struct PlaceholderNode : public node {
-        virtual bool hasError()
-        {
-            return false;
-        }
         PlaceholderNode(const char* s = nullptr, const char* e = nullptr)
             :node(NodeType::NODE_PLACEHOLDER, s, e) {}
     }; 
@@ -650,22 +564,92 @@ namespace pilaf {
     void printNodes(std::shared_ptr<node> start, int depth);
     
     bool typesEqual(std::shared_ptr<Ty> a, std::shared_ptr<Ty> b);
+
+    //types are walked with explicit stacks rather than recursion, since inference can build
+    //types far deeper than anything written in the source.
+    //number of types directly inside `t`; none for basic types and variables
+    size_t typeArity(const Ty& t);
+    //the `i`th type directly inside `t`, in the order they are written
+    const std::shared_ptr<Ty>& typeChild(const Ty& t, size_t i);
+    //rebuilds `t` bottom-up with `leaf` applied to each type without children. subtrees that do not
+    //change are shared with `t`, and a subtree reached along several paths is only rebuilt once
+    std::shared_ptr<Ty> mapType(const std::shared_ptr<Ty>& t, const std::function<std::shared_ptr<Ty>(const std::shared_ptr<Ty>&)>& leaf);
     
     bool hasError(std::shared_ptr<node>);
+
+    //left associative operator chains are as tall as they are long, so passes over the tree walk
+    //their left spine in a loop rather than recursing down it. fills `spine` with the chain's
+    //binary nodes from the innermost out and returns its leftmost operand
+    std::shared_ptr<node> binarySpine(const std::shared_ptr<node>& n, std::vector<BinaryNode*>& spine);
+    //calls `visit` on each operand of the chain rooted at `n`, left to right
+    template<typename Visit> void forEachOperand(const std::shared_ptr<node>& n, Visit&& visit)
+    {
+        std::vector<BinaryNode*> spine;
+        visit(binarySpine(n, spine));
+        for(auto bn : spine) visit(bn->expression2);
+    }
     
+    //renders types for output only; semantic code compares types and their symbols instead.
+    //composite types printed more than once are copied from a cache rather than walked again,
+    //and are kept alive by the printer so that their addresses stay unique keys
+    class TypePrinter {
+        std::unordered_map<const Ty*, std::pair<size_t, size_t>> cached;
+        std::unordered_set<const Ty*> seen;
+        std::string cache;
+        std::vector<std::shared_ptr<Ty>> pinned;
+    public:
+        void print(const std::shared_ptr<Ty>& t, std::string& out);
+        //appends the cached rendering of `t`, if there is one
+        bool recall(const std::shared_ptr<Ty>& t, std::string& out) const;
+        //notes that out[begin..] renders `t`, and caches it the second time `t` is printed
+        void remember(const std::shared_ptr<Ty>& t, const std::string& out, size_t begin);
+    };
+    void typeToString(const std::shared_ptr<Ty>& t, std::string& out);
     std::string typeToString(std::shared_ptr<Ty> t);
     
     std::shared_ptr<Ty> newGenericType();
+
+    //type of code that already failed to parse or typecheck. it unifies with any type without
+    //reporting anything, so each mistake is reported once instead of at every use
+    std::shared_ptr<Ty> errorType();
+    bool isErrorType(const std::shared_ptr<Ty>& t);
     
-    std::shared_ptr<ProgramNode> parse(const char* src);
+    std::shared_ptr<ProgramNode> parse(const char* src, const CompileOptions& options = CompileOptions());
     
     bool compareAST(std::shared_ptr<node> a, std::shared_ptr<node> b);
 
-    std::string declarationName(std::shared_ptr<Ty> type);
+    //the body of `fd`, parsing it first if a lazy parse skipped it. null for declarations without one
+    const std::shared_ptr<node>& functionBody(FunctionDeclarationNode& fd);
 
-    std::shared_ptr<Ty> generic(std::shared_ptr<Ty> type, std::unordered_map<std::string, std::shared_ptr<Ty>>& replaced);
+    const std::string& declarationName(std::shared_ptr<Ty> type);
+    //adds a struct to the scope it is declared in and to that scope's field index
+    void declareStruct(std::shared_ptr<ScopeNode> scope, std::shared_ptr<StructDeclarationNode> sd);
+
+    //quantified variable -> inference variable for one instantiation. a flat map keeping its
+    //first entries inline, so instantiating a typical signature does not allocate for the map.
+    class TypeVarMap {
+        typedef std::pair<Symbol, std::shared_ptr<Ty>> Entry;
+        static const size_t inlineCapacity = 8;
+        //entries are constructed in place on insert, so an unused map costs nothing to create
+        alignas(Entry) unsigned char storage[inlineCapacity * sizeof(Entry)];
+        std::vector<Entry> overflow;
+        size_t count = 0;
+        Entry* entries() { return reinterpret_cast<Entry*>(storage); }
+        const Entry* entries() const { return reinterpret_cast<const Entry*>(storage); }
+    public:
+        TypeVarMap() {}
+        TypeVarMap(const TypeVarMap&) = delete;
+        TypeVarMap& operator=(const TypeVarMap&) = delete;
+        ~TypeVarMap() { clear(); }
+        std::shared_ptr<Ty> find(Symbol var) const;
+        void insert(Symbol var, std::shared_ptr<Ty> type);
+        size_t size() const { return count; }
+        void clear();
+    };
 
-    std::unordered_map<std::string, std::shared_ptr<Ty>> genericMap(std::shared_ptr<Ty> type, std::unordered_map<std::string, std::shared_ptr<Ty>> replaced);
+    //replaces the quantified variables of `type` with inference variables, sharing every
+    //subtree that contains none; a type without quantified variables is returned as is.
+    std::shared_ptr<Ty> generic(std::shared_ptr<Ty> type, TypeVarMap& replaced);
 
     bool isRefutable(std::shared_ptr<node> n);
     
@@ -7,205 +7,15 @@
 #include <deque>
 #include <unordered_set>
 #include "semant.h"
+#include "interface.h"
+#include "kinds.h"
+#include "specialize.h"
+#include "constraints.h"
 #include <algorithm>
 
 //TODO: arrayIndex is an evil hack and should be replaced by defining a ([]) operator
 namespace pilaf {
 
-    bool stringInType(std::string s, std::shared_ptr<Ty> t)
-    {
-        switch(t->type)
-        {
-            case Ty::TY_FUNCTION:
-            {
-                auto f = std::static_pointer_cast<TyFunc>(t);
-                return stringInType(s, f->in) || stringInType(s, f->out);
-            }
-            case Ty::TY_APPLICATION:
-            {
-                auto app = std::static_pointer_cast<TyAppl>(t);
-                bool b = stringInType(s, app->applied);
-                for(auto v : app->vars)
-                {
-                    b |= stringInType(s, v);
-                }
-                return b;
-            }
-            case Ty::TY_ARRAY:
-            {
-                auto arr = std::static_pointer_cast<TyArray>(t);
-                return stringInType(s, arr->arrayOf);
-            }
-            case Ty::TY_POINTER:
-            {
-                auto ptr = std::static_pointer_cast<TyPointer>(t);
-                return stringInType(s, ptr->pointsTo);
-            }
-            case Ty::TY_TUPLE:
-            {
-                auto tuple = std::static_pointer_cast<TyTuple>(t);
-                bool b = false;
-                for(auto t : tuple->types)
-                {
-                    b |= stringInType(s, t);
-                }
-                return b;
-            }
-            case Ty::TY_BASIC:
-            {
-                auto basic = std::static_pointer_cast<TyBasic>(t);
-                return s.compare(basic->t) == 0;
-            }
-            case Ty::TY_VAR:
-            {
-                auto var = std::static_pointer_cast<TyVar>(t);
-                return s.compare(var->var) == 0;
-            }
-            default: return false;
-        }
-    }
-
-    std::shared_ptr<Ty> applyRewrites(std::shared_ptr<Ty> t, std::unordered_multimap<std::string, std::shared_ptr<Ty>> rewrites)
-    {
-        switch(t->type)
-        {
-            case Ty::TY_FUNCTION:
-            {
-                auto f = std::static_pointer_cast<TyFunc>(t);
-                auto in = applyRewrites(f->in, rewrites);
-                auto out = applyRewrites(f->out, rewrites);
-                return std::make_shared<TyFunc>(in, out);
-            }
-            case Ty::TY_ARRAY:
-            {
-                auto arr = std::static_pointer_cast<TyArray>(t);
-                auto arrayOf = applyRewrites(arr->arrayOf, rewrites);
-                return std::make_shared<TyArray>(arrayOf, arr->size);
-            }
-            case Ty::TY_POINTER:
-            {
-                auto ptr = std::static_pointer_cast<TyPointer>(t);
-                auto pointsTo = applyRewrites(ptr->pointsTo, rewrites);
-                return std::make_shared<TyPointer>(pointsTo);
-            }
-            case Ty::TY_APPLICATION:
-            {
-                auto app = std::static_pointer_cast<TyAppl>(t);
-                auto applied = applyRewrites(app->applied, rewrites);
-                std::vector<std::shared_ptr<Ty>> vars;
-                for(auto v : app->vars)
-                {
-                    vars.push_back(applyRewrites(v, rewrites));
-                }
-                return std::make_shared<TyAppl>(applied, vars);
-            }
-            case Ty::TY_BASIC:
-            {
-                //TODO: replace with lookup of type
-                auto basic = std::static_pointer_cast<TyBasic>(t);
-                if(rewrites.count(basic->t) > 0)
-                {
-                    auto t = rewrites.equal_range(basic->t);
-                    return t.first->second;
-                }
-                else return std::make_shared<TyBasic>("*");
-            }
-            case Ty::TY_VAR:
-            {
-                auto var = std::static_pointer_cast<TyVar>(t);
-                if(rewrites.count(var->var) > 0)
-                {
-                    auto t = rewrites.equal_range(var->var);
-                    return t.first->second;
-                }
-                else return std::make_shared<TyBasic>("*");
-            }
-        }
-    }
-
-    std::pair<bool, std::shared_ptr<Ty>> solveKinds(std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> constraints, std::string name)
-    {
-        std::unordered_multimap<std::string, std::shared_ptr<Ty>> result;
-        bool isValid = true;
-        auto star = std::make_shared<TyBasic>("*");
-
-        while(constraints.size() != 0)
-        {
-            auto constraint = constraints.front();
-            constraints.pop_front();
-            switch(constraint.first->type)
-            {
-                case Ty::TY_FUNCTION:
-                {
-                    auto f = std::static_pointer_cast<TyFunc>(constraint.first);
-                    constraints.push_back(std::make_pair(f->in, star));
-                    constraints.push_back(std::make_pair(f->out, star));
-                    break;
-                }
-                case Ty::TY_ARRAY:
-                {
-                    auto arr = std::static_pointer_cast<TyArray>(constraint.first);
-                    constraints.push_back(std::make_pair(arr->arrayOf, star));
-                    break;
-                }
-                case Ty::TY_POINTER:
-                {
-                    auto ptr = std::static_pointer_cast<TyPointer>(constraint.first);
-                    constraints.push_back(std::make_pair(ptr->pointsTo, star));
-                    break;
-                }
-                case Ty::TY_TUPLE:
-                {
-                    auto tuple = std::static_pointer_cast<TyTuple>(constraint.first);
-                    for(auto t : tuple->types)
-                    {
-                        constraints.push_back(std::make_pair(t, star));
-                    }
-                    break;
-                }
-                case Ty::TY_APPLICATION:
-                {
-                    auto app = std::static_pointer_cast<TyAppl>(constraint.first);
-                    std::shared_ptr<Ty> t = star;
-                    
-                    for(auto it = app->vars.rbegin(); it != app->vars.rend(); it++)
-                    {
-                        t = std::make_shared<TyFunc>(*it, t);
-                    }
-                    constraints.push_back(std::make_pair(app->applied, t));
-                    break;
-                }
-                case Ty::TY_BASIC:
-                case Ty::TY_VAR:
-                {
-                    result.emplace(typeToString(constraint.first), constraint.second);
-                    break;
-                }
-            }
-        }
-        
-        for(auto constraint : result)
-        {
-            isValid &= !stringInType(constraint.first, constraint.second);
-        }
-        if(isValid)
-        {
-            for(auto& constraint : result)
-            {
-                constraint.second = applyRewrites(constraint.second, result);
-            }
-            
-            for(auto constraint : result)
-            {
-               if(constraint.first.compare(name) == 0)
-               {
-                return std::make_pair(isValid, constraint.second);
-               }
-            }
-        }
-        return std::make_pair(false, nullptr);
-    }
-
     void ImplKinds(std::shared_ptr<node> n, std::shared_ptr<ScopeNode> currentScope)
     {
         assert(n != nullptr);
@@ -216,47 +26,23 @@ namespace pilaf {
             {
                 auto ci = std::static_pointer_cast<ClassImplementationNode>(n);
                 std::shared_ptr<ClassDeclarationNode> c = nullptr;
-                std::shared_ptr<StructDeclarationNode> r = nullptr;
-                std::shared_ptr<UnionDeclarationNode> u = nullptr;
-                auto s = currentScope;
-                while((c == nullptr || r == nullptr || u == nullptr) && s != nullptr)
+                for(auto s = currentScope; c == nullptr && s != nullptr; s = s->parentScope)
                 {
                     if(s->classes.find(tokenToString(ci->_class)) != s->classes.end())
                     {
                         c = s->classes.at(tokenToString(ci->_class));
                     }
-                    if(s->structs.find(typeToString(ci->implemented)) != s->structs.end())
-                    {
-                        r = s->structs.at(typeToString(ci->implemented));
-                    }
-                    if(s->unions.find(typeToString(ci->implemented)) != s->unions.end())
-                    {
-                        u = s->unions.at(typeToString(ci->implemented));
-                    }
-                    s = s->parentScope;
-                }
-                if((r == nullptr && u == nullptr) || c == nullptr)
-                {
-                    system("pause");
-                    assert(false);
                 }
-                if(u == nullptr)
+                if(c == nullptr)
                 {
-                    if(!typesEqual(c->kind, r->kind))
-                    {
-                        //error
-                        system("pause");
-                        assert(false);
-                    }
+                    error(DIAG_UNKNOWN_NAME, std::string_view(ci->_class.start, ci->_class.length), "could not find class!");
+                    break;
                 }
-                if(r == nullptr)
+                //the implemented type may be a builtin or a partially applied constructor, so infer its kind
+                KindSolver kinds(currentScope);
+                if(kinds.kindOfType(ci->implemented) != c->kind)
                 {
-                    if(!typesEqual(c->kind, u->kind))
-                    {
-                        //error
-                        system("pause");
-                        assert(false);
-                    }
+                    error(DIAG_INCONSISTENT_KINDS, std::string_view(ci->start, ci->end - ci->start), "implemented type does not have the kind of the class's type variable!");
                 }
                 break;
             }
@@ -275,7 +61,7 @@ namespace pilaf {
             case NODE_VARIABLEDECL:
             {
                 auto vd = std::static_pointer_cast<VariableDeclarationNode>(n);
-                ImplKinds(vd->value, currentScope);
+                if(vd->value) ImplKinds(vd->value, currentScope);
                 break;
             }
             case NODE_BLOCK:
@@ -385,9 +171,7 @@ namespace pilaf {
             }
             case NODE_BINARY:
             {
-                auto bn = std::static_pointer_cast<BinaryNode>(n);
-                ImplKinds(bn->expression1, currentScope);
-                ImplKinds(bn->expression2, currentScope);
+                forEachOperand(n, [&](const std::shared_ptr<node>& operand) { ImplKinds(operand, currentScope); });
                 break;
             }
             case NODE_UNARY:
@@ -415,20 +199,17 @@ namespace pilaf {
                 auto sd = std::static_pointer_cast<StructDeclarationNode>(n);
                 if(sd->kind == nullptr)
                 {
-                    std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> kinds;
-                    auto star = std::make_shared<TyBasic>("*");
-                    kinds.push_back(std::make_pair(sd->typeDefined, star));
+                    KindSolver kinds(currentScope);
+                    auto name = intern(declarationName(sd->typeDefined));
+                    kinds.bind(name);
+                    kinds.constrain(sd->typeDefined);
                     for(auto f : sd->fields)
                     {
-                        kinds.push_back(std::make_pair(f.type, star));
+                        kinds.constrain(f.type);
                     }
 
-                    auto result = solveKinds(kinds, declarationName(sd->typeDefined));
-                    if(result.first)
-                    {
-                        sd->kind = result.second;
-                    }
-                    else error(0, std::string_view(sd->start, sd->end - sd->start), /*todo: figure out what goes here*/std::string_view(sd->start, sd->end - sd->start), "inconsistent types in struct!");
+                    sd->kind = kinds.solve(name);
+                    if(sd->kind == nullptr) error(DIAG_INCONSISTENT_KINDS, std::string_view(sd->start, sd->end - sd->start), "inconsistent types in struct!");
                 }
                 break;
             }
@@ -437,20 +218,17 @@ namespace pilaf {
                 auto ud = std::static_pointer_cast<UnionDeclarationNode>(n);
                 if(ud->kind == nullptr)
                 {
-                    std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> kinds;
-                    auto star = std::make_shared<TyBasic>("*");
-                    kinds.push_back(std::make_pair(ud->typeDefined, star));
+                    KindSolver kinds(currentScope);
+                    auto name = intern(declarationName(ud->typeDefined));
+                    kinds.bind(name);
+                    kinds.constrain(ud->typeDefined);
                     for(auto f : ud->members)
                     {
-                        if(f.type != nullptr) kinds.push_back(std::make_pair(f.type, star));
+                        kinds.constrain(f.type);
                     }
 
-                    auto result = solveKinds(kinds, declarationName(ud->typeDefined));
-                    if(result.first)
-                    {
-                        ud->kind = result.second;
-                    }
-                    else error(0, std::string_view(ud->start, ud->end - ud->start), /*todo: figure out what goes here*/std::string_view(ud->start, ud->end - ud->start), "inconsistent types in union!");
+                    ud->kind = kinds.solve(name);
+                    if(ud->kind == nullptr) error(DIAG_INCONSISTENT_KINDS, std::string_view(ud->start, ud->end - ud->start), "inconsistent types in union!");
                     
                 }
                 break;
@@ -568,9 +346,7 @@ namespace pilaf {
             }
             case NODE_BINARY:
             {
-                auto bn = std::static_pointer_cast<BinaryNode>(n);
-                RecordKinds(bn->expression1, currentScope);
-                RecordKinds(bn->expression2, currentScope);
+                forEachOperand(n, [&](const std::shared_ptr<node>& operand) { RecordKinds(operand, currentScope); });
                 break;
             }
             case NODE_UNARY:
@@ -601,23 +377,18 @@ namespace pilaf {
                         system("pause");
                         assert(false);
                     }
-                    auto fd = std::static_pointer_cast<FunctionDeclarationNode>(f);
-                    std::shared_ptr<Ty> functionType = functionTypeFromFunction(fd);
-                    std::vector<int> argCounts;
-                    
-                    std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> kinds;
-                    auto star = std::make_shared<TyBasic>("*");
+                }
+                //the class variable's kind depends on every member signature, so solve once per class
+                if(classdecl->kind == nullptr)
+                {
+                    KindSolver kinds(currentScope);
+                    auto name = intern(std::string_view(classdecl->typeName.start, classdecl->typeName.length));
+                    kinds.bind(name);
                     for(auto f : classdecl->functions)
                     {
-                        kinds.push_back(std::make_pair(functionTypeFromFunction(std::static_pointer_cast<FunctionDeclarationNode>(f)), star));
-                    }
-
-                    auto result = solveKinds(kinds, tokenToString(classdecl->typeName));
-                    if(result.first)
-                    {
-                        classdecl->kind = result.second;
+                        kinds.constrain(functionTypeFromFunction(std::static_pointer_cast<FunctionDeclarationNode>(f)));
                     }
-                    //else error
+                    classdecl->kind = kinds.solve(name);
                 }
                 break;
             }
@@ -743,9 +514,7 @@ namespace pilaf {
             }
             case NODE_BINARY:
             {
-                auto bn = std::static_pointer_cast<BinaryNode>(n);
-                ResolveTypeclasses(bn->expression1, currentScope);
-                ResolveTypeclasses(bn->expression2, currentScope);
+                forEachOperand(n, [&](const std::shared_ptr<node>& operand) { ResolveTypeclasses(operand, currentScope); });
                 break;
             }
             case NODE_UNARY:
@@ -759,20 +528,57 @@ namespace pilaf {
         }
     }
     
-    void printConstraints(std::weak_ptr<ScopeNode> scope)
+    //dumps are assembled in one buffer and written out in large blocks
+    static void flushDump(std::string& buffer, FILE* out, bool force)
+    {
+        if(!force && buffer.size() < (1 << 16)) return;
+        fwrite(buffer.data(), 1, buffer.size(), out);
+        buffer.clear();
+    }
+
+    static void printConstraints(std::weak_ptr<ScopeNode> scope, TypePrinter& printer, std::string& buffer, FILE* out)
     {
         if(auto shared = scope.lock())
         {
-            for(auto c : shared->constraints)
+            for(auto& c : shared->constraints)
             {
-                std::cout << "Constraint: " << typeToString(c.first) << " == " << typeToString(c.second) << "\n";
+                buffer.append("Constraint: ");
+                printer.print(c.first, buffer);
+                buffer.append(" == ");
+                printer.print(c.second, buffer);
+                buffer.push_back('\n');
+                flushDump(buffer, out, false);
             }
             for(auto child : shared->childScopes)
             {
-                printConstraints(child);
+                printConstraints(child, printer, buffer, out);
             }
         }
     }
+
+    void printConstraints(std::shared_ptr<ScopeNode> scope, FILE* out)
+    {
+        TypePrinter printer;
+        std::string buffer;
+        printConstraints(scope, printer, buffer, out);
+        flushDump(buffer, out, true);
+    }
+
+    void printSubstitutions(const std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>>& substitutions, FILE* out)
+    {
+        TypePrinter printer;
+        std::string buffer;
+        for(auto& substitution : substitutions)
+        {
+            buffer.append("Substitution: ");
+            printer.print(substitution.first, buffer);
+            buffer.append(" => ");
+            printer.print(substitution.second, buffer);
+            buffer.push_back('\n');
+            flushDump(buffer, out, false);
+        }
+        flushDump(buffer, out, true);
+    }
     
     std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> flattenConstraints(std::shared_ptr<ScopeNode> scope)
     {
@@ -789,78 +595,132 @@ namespace pilaf {
     
     std::shared_ptr<Ty> replaceInType(std::shared_ptr<Ty> t, std::shared_ptr<Ty> replacing, std::shared_ptr<Ty> replaced)
     {
-        switch(t->type)
+        return mapType(t, [&](const std::shared_ptr<Ty>& leaf)
         {
-            case Ty::TY_APPLICATION:
-            {
-                auto app = std::static_pointer_cast<TyAppl>(t);
-                auto applied = replaceInType(app->applied, replacing, replaced);
-                assert(app->vars.size() != 0);
-                std::vector<std::shared_ptr<Ty>> vars;
-                for(auto i = 0; i < app->vars.size(); i++)
-                {
-                    vars.push_back(replaceInType(app->vars[i], replacing, replaced));
-                }
-                return std::make_shared<TyAppl>(applied, vars);
-            }
-            case Ty::TY_FUNCTION:
-            {
-                auto fn = std::static_pointer_cast<TyFunc>(t);
-                auto in = replaceInType(fn->in, replacing, replaced);
-                auto out = replaceInType(fn->out, replacing, replaced);
-                return std::make_shared<TyFunc>(in, out);
-            }
-            case Ty::TY_ARRAY:
-            {
-                auto arr = std::static_pointer_cast<TyArray>(t);
-                auto arrayOf = replaceInType(arr->arrayOf, replacing, replaced);
-                return std::make_shared<TyArray>(arrayOf, arr->size);
-            }
-            case Ty::TY_POINTER:
-            {
-                auto ptr = std::static_pointer_cast<TyPointer>(t);
-                auto pointsTo = replaceInType(ptr->pointsTo, replacing, replaced);
-                return std::make_shared<TyPointer>(pointsTo);
-            }
-            case Ty::TY_TUPLE:
-            {
-                auto tuple = std::static_pointer_cast<TyTuple>(t);
-                std::vector<std::shared_ptr<Ty>> types;
-                for(auto t : tuple->types)
-                {
-                    types.push_back(replaceInType(t, replacing, replaced));
-                }
-                return std::make_shared<TyTuple>(types);
-            }
-            case Ty::TY_BASIC:
-            case Ty::TY_VAR:
+            return typesEqual(leaf, replaced) ? replacing : leaf;
+        });
+    }
+    
+    //substitutions are produced in solving order, so applying them in sequence
+    //also resolves any variables introduced by earlier replacements
+    std::shared_ptr<Ty> applySubstitutions(std::shared_ptr<Ty> t, const std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>>& substitutions)
+    {
+        for(auto& substitution : substitutions)
+        {
+            t = replaceInType(t, substitution.second, substitution.first);
+        }
+        return t;
+    }
+
+    std::shared_ptr<Ty> applySubstitutions(std::shared_ptr<Ty> t, const std::unordered_map<std::string, std::shared_ptr<Ty>>& composed)
+    {
+        return mapType(t, [&](const std::shared_ptr<Ty>& leaf)
+        {
+            if(leaf->type != Ty::TY_VAR) return leaf;
+            auto it = composed.find(std::static_pointer_cast<TyVar>(leaf)->var);
+            return it == composed.end() ? leaf : it->second;
+        });
+    }
+
+    //built from the last substitution back, so that every entry already has the later ones applied
+    std::unordered_map<std::string, std::shared_ptr<Ty>> composeSubstitutions(const std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>>& substitutions)
+    {
+        std::unordered_map<std::string, std::shared_ptr<Ty>> composed;
+        for(auto it = substitutions.rbegin(); it != substitutions.rend(); it++)
+        {
+            if(it->first->type != Ty::TY_VAR) continue;
+            composed[std::static_pointer_cast<TyVar>(it->first)->var] = applySubstitutions(it->second, composed);
+        }
+        return composed;
+    }
+
+    //a constraint still to be solved, with the index of the given constraint it was derived from
+    struct PendingConstraint {
+        std::shared_ptr<Ty> first;
+        std::shared_ptr<Ty> second;
+        size_t root;
+    };
+
+    static void collectInferenceVars(const std::shared_ptr<Ty>& t, std::vector<std::shared_ptr<Ty>>& vars)
+    {
+        std::vector<const std::shared_ptr<Ty>*> pending = {&t};
+        while(!pending.empty())
+        {
+            auto& ty = *pending.back();
+            pending.pop_back();
+            if(ty == nullptr) continue;
+            if(ty->type == Ty::TY_VAR)
             {
-                if(typesEqual(t, replaced))
-                {
-                    return replacing;
-                }
-                else return t;
+                auto& var = std::static_pointer_cast<TyVar>(ty)->var;
+                if(!var.empty() && var.front() == '\'') vars.push_back(ty);
             }
-            default:
+            for(size_t i = typeArity(*ty); i-- > 0;) pending.push_back(&typeChild(*ty, i));
+        }
+    }
+
+    static void bindVariable(std::shared_ptr<Ty> replaced, std::shared_ptr<Ty> replacing, std::deque<PendingConstraint>& pending, std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>>& result)
+    {
+        result.push_back(std::make_pair(replaced, replacing));
+        for(auto& constraint : pending)
+        {
+            constraint.first = replaceInType(constraint.first, replacing, replaced);
+            constraint.second = replaceInType(constraint.second, replacing, replaced);
+        }
+    }
+
+    //reports a constraint that cannot hold, then drops everything else derived from the same given
+    //constraint and binds the variables still free in it to the error type. constraints that do not
+    //involve those variables are solved as usual, so independent errors are each reported once
+    static void conflict(const PendingConstraint& failed, const std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>>& given, std::deque<PendingConstraint>& pending, std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>>& result)
+    {
+        std::shared_ptr<Ty> located = nullptr;
+        for(auto& t : {failed.first, failed.second, given[failed.root].first, given[failed.root].second})
+        {
+            if(located == nullptr && t->start != nullptr) located = t;
+        }
+        auto highlighted = located == nullptr ? std::string_view() : std::string_view(located->start, located->end - located->start);
+        error(DIAG_TYPE_MISMATCH, highlighted, "type {} is not equal to {}!", {failed.first, failed.second});
+
+        std::vector<std::shared_ptr<Ty>> poisoned;
+        collectInferenceVars(failed.first, poisoned);
+        collectInferenceVars(failed.second, poisoned);
+        std::deque<PendingConstraint> remaining;
+        for(auto& constraint : pending)
+        {
+            if(constraint.root != failed.root)
             {
-                system("pause");
-                return nullptr;
+                remaining.push_back(std::move(constraint));
+                continue;
             }
+            collectInferenceVars(constraint.first, poisoned);
+            collectInferenceVars(constraint.second, poisoned);
+        }
+        pending = std::move(remaining);
+        std::unordered_set<std::string> bound;
+        for(auto& var : poisoned)
+        {
+            if(bound.insert(std::static_pointer_cast<TyVar>(var)->var).second) bindVariable(var, errorType(), pending, result);
         }
     }
-    
+
     std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> resolveConstraints(std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> constraints)
     {
         std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> result;
-        while(constraints.size() > 0)
+        std::deque<PendingConstraint> pending;
+        for(size_t i = 0; i < constraints.size(); i++)
         {
-            auto constraint = constraints.front();
-            constraints.pop_front();
+            pending.push_back(PendingConstraint{constraints[i].first, constraints[i].second, i});
+        }
+        while(pending.size() > 0)
+        {
+            auto constraint = pending.front();
+            pending.pop_front();
+            auto root = constraint.root;
             if(typesEqual(constraint.first, constraint.second)) continue;
+            bool poisoned = isErrorType(constraint.first) || isErrorType(constraint.second);
             if(constraint.first->type == Ty::TY_BASIC && constraint.second->type == Ty::TY_BASIC)
             {
-                printf("error: type %s is not equal to %s!", typeToString(constraint.first).c_str(), typeToString(constraint.second).c_str());
-                return {};
+                if(!poisoned) conflict(constraint, constraints, pending, result);
             }
             else if(constraint.first->type == Ty::TY_APPLICATION && constraint.second->type == Ty::TY_APPLICATION)
             {
@@ -868,25 +728,29 @@ namespace pilaf {
                 auto c2 = std::static_pointer_cast<TyAppl>(constraint.second);
                 assert(c1->vars.size() != 0);
                 assert(c2->vars.size() != 0);
+                if(c1->vars.size() != c2->vars.size())
+                {
+                    conflict(constraint, constraints, pending, result);
+                    continue;
+                }
                 auto t1 = c1->applied;
                 auto t2 = c2->applied;
-                constraints.push_front(std::make_pair(t1, t2));
-                assert(c1->vars.size() == c2->vars.size());
+                pending.push_front(PendingConstraint{t1, t2, root});
                 for(auto i = 0; i < c1->vars.size(); i++)
                 {
                     t1 = c1->vars[i];
                     t2 = c2->vars[i];
-                    constraints.push_front(std::make_pair(t1, t2));
+                    pending.push_front(PendingConstraint{t1, t2, root});
                 }
             }
             else if (isFunctionType(constraint.first) && isFunctionType(constraint.second))
             {
                 auto t1 = firstParameterFromFunctionType(constraint.first);
                 auto t2 = firstParameterFromFunctionType(constraint.second);
-                constraints.push_front(std::make_pair(t1, t2));
+                pending.push_front(PendingConstraint{t1, t2, root});
                 t1 = std::static_pointer_cast<TyFunc>(constraint.first)->out;
                 t2 = std::static_pointer_cast<TyFunc>(constraint.second)->out;
-                constraints.push_front(std::make_pair(t1, t2));
+                pending.push_front(PendingConstraint{t1, t2, root});
             }
             else if (constraint.first->type == Ty::TY_TUPLE && constraint.second->type == Ty::TY_TUPLE)
             {
@@ -894,12 +758,12 @@ namespace pilaf {
                 auto t2 = std::static_pointer_cast<TyTuple>(constraint.second);
                 if(t1->types.size() != t2->types.size())
                 {
-                    //error
-                    system("pause");
+                    conflict(constraint, constraints, pending, result);
+                    continue;
                 }
                 for(size_t i = 0; i < t1->types.size(); i++)
                 {
-                    constraints.push_front(std::make_pair(t1->types[i], t2->types[i]));
+                    pending.push_front(PendingConstraint{t1->types[i], t2->types[i], root});
                 }
             }
             else if (constraint.first->type == Ty::TY_ARRAY && constraint.second->type == Ty::TY_ARRAY)
@@ -908,10 +772,22 @@ namespace pilaf {
                 auto t2 = std::static_pointer_cast<TyArray>(constraint.second);
                 if(t1->size.has_value() && t2->size.has_value() && t1->size.value() != t2->size.value())
                 {
-                    //error
-                    system("pause");
+                    conflict(constraint, constraints, pending, result);
+                    continue;
                 }
-                constraints.push_front(std::make_pair(t1->arrayOf, t2->arrayOf));
+                pending.push_front(PendingConstraint{t1->arrayOf, t2->arrayOf, root});
+            }
+            else if (constraint.first->type == Ty::TY_POINTER && constraint.second->type == Ty::TY_POINTER)
+            {
+                auto t1 = std::static_pointer_cast<TyPointer>(constraint.first);
+                auto t2 = std::static_pointer_cast<TyPointer>(constraint.second);
+                pending.push_front(PendingConstraint{t1->pointsTo, t2->pointsTo, root});
+            }
+            else if (constraint.first->type == Ty::TY_REFERENCE && constraint.second->type == Ty::TY_REFERENCE)
+            {
+                auto t1 = std::static_pointer_cast<TyRef>(constraint.first);
+                auto t2 = std::static_pointer_cast<TyRef>(constraint.second);
+                pending.push_front(PendingConstraint{t1->refTo, t2->refTo, root});
             }
             else
             {
@@ -928,48 +804,42 @@ namespace pilaf {
                     replacing = t1;
                     replaced = t2;
                 }
-                result.push_back(std::make_pair(replaced, replacing));
-                std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> newConstraints;
-                for(auto constraint : constraints)
+                //the error type stands in for any type, but never becomes one itself
+                if(poisoned && replaced->type != Ty::TY_VAR) continue;
+                //named types may still be bound to their definition, but two different shapes never match
+                if(replaced->type != Ty::TY_VAR && replaced->type != Ty::TY_BASIC && replacing->type != Ty::TY_BASIC)
                 {
-                    auto first = replaceInType(constraint.first, replacing, replaced);
-                    auto second = replaceInType(constraint.second, replacing, replaced);
-                    newConstraints.push_back(std::make_pair(first, second));
+                    conflict(constraint, constraints, pending, result);
+                    continue;
                 }
-
-                constraints = std::move(newConstraints);
+                bindVariable(replaced, replacing, pending, result);
             }
         }
         return result;
     }
     
     
-    std::shared_ptr<ProgramNode> analyze(const char *src)
+    static std::shared_ptr<ProgramNode> analyzeProgram(const char *src, const CompileOptions& options)
     {
-        //std::string blah = std::string("blah\nblah\nblah\nblah error blah\nblah");
-        //puts(blah.c_str());
-        //printf("-----\n");
-        //error(1, {blah.c_str(), blah.c_str() + 35}, {blah.c_str() + 20, blah.c_str() + 25}, "this is an error message!");
-    
-        std::shared_ptr<ProgramNode> ast = parse(src);
+        resetConstraints();
+        clearErrors();
+        std::shared_ptr<ProgramNode> ast = parse(src, options);
         if(ast == nullptr) return nullptr;
-        if(ast->hadError) return nullptr;
         
+        //declarations that failed to parse are ErrorNodes by now, so everything else is still checked
         for (auto dec : ast->declarations)
         {
             typeInf(dec, ast->globalScope);
         }
-        if(!ast->hadError && !hadError())
-        {
-            printConstraints(ast->globalScope);
-            auto constraints = flattenConstraints(ast->globalScope);
-            auto substitutions = resolveConstraints(constraints);
-            if(substitutions.empty() && !constraints.empty()) ast->hadError = true;
-            for(auto substitution : substitutions)
-            {
-                std::cout << "Substitution: " << typeToString(substitution.first) << " => " << typeToString(substitution.second) << "\n";
-            }
-        }
+        std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> substitutions;
+        if(options.dumpConstraints) printConstraints(ast->globalScope, stdout);
+        auto constraints = prepareConstraints(flattenConstraints(ast->globalScope), substitutions);
+        ast->constraintCount = constraints.size();
+        auto& stats = constraintStats();
+        ast->constraintsEliminated = stats.trivial + stats.aliased + stats.duplicates;
+        auto solved = resolveConstraints(constraints);
+        substitutions.insert(substitutions.end(), solved.begin(), solved.end());
+        if(options.dumpConstraints) printSubstitutions(substitutions, stdout);
         for (auto dec : ast->declarations)
         {
             RecordKinds(dec, ast->globalScope);
@@ -985,9 +855,49 @@ namespace pilaf {
 
         if(!ast->hadError && !hadError())
         {
+            //without bodies there are no calls to specialize, and no solved signatures worth caching
+            if(options.signaturesOnly) return ast;
+            specializeCalls(ast, substitutions);
+            ast->substitutions = std::move(substitutions);
+            if(!options.interfaceCacheDir.empty())
+            {
+                std::optional<std::unordered_map<std::string, std::shared_ptr<Ty>>> composed;
+                for(auto dec : ast->declarations)
+                {
+                    if(dec->nodeType != NODE_MODULE) continue;
+                    auto md = std::static_pointer_cast<ModuleDeclarationNode>(dec);
+                    if(md->interface == nullptr && md->contentHash != 0)
+                    {
+                        if(!composed) composed = composeSubstitutions(ast->substitutions);
+                        writeModuleInterface(interfacePath(options.interfaceCacheDir, md->name), md, *composed);
+                    }
+                }
+            }
             return ast;
         }
 
         return nullptr;
     }
+
+    std::shared_ptr<ProgramNode> analyze(const char *src, const CompileOptions& options)
+    {
+        if(options.diagnostics != nullptr)
+        {
+            setDiagnostics(options.diagnostics);
+            auto ast = analyzeProgram(src, options);
+            setDiagnostics(nullptr);
+            return ast;
+        }
+        //nobody is collecting diagnostics, so they are rendered once the whole program has been seen
+        DiagnosticEngine engine(src);
+        auto withEngine = options;
+        withEngine.diagnostics = &engine;
+        setDiagnostics(&engine);
+        auto ast = analyzeProgram(src, withEngine);
+        setDiagnostics(nullptr);
+        //bodies that are still skipped render their own diagnostics once this engine is gone
+        if(ast != nullptr && ast->context != nullptr) ast->context->options.diagnostics = nullptr;
+        engine.render(stderr, options.diagnosticFormat, options.maxDiagnostics);
+        return ast;
+    }
 }
\ No newline at end of file
@@ -1,8 +1,26 @@
 #ifndef semant_header
 #define semant_header
+#include <cstdio>
+#include <deque>
+#include <unordered_map>
 #include "typecheck.h"
 
 namespace pilaf {
-    std::shared_ptr<ProgramNode> analyze(const char* src);
+    std::shared_ptr<Ty> applySubstitutions(std::shared_ptr<Ty> t, const std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>>& substitutions);
+
+    //the substitutions folded into one final type per variable. applying the table costs one walk
+    //of the type instead of one per substitution, for passes that resolve many types
+    std::unordered_map<std::string, std::shared_ptr<Ty>> composeSubstitutions(const std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>>& substitutions);
+    std::shared_ptr<Ty> applySubstitutions(std::shared_ptr<Ty> t, const std::unordered_map<std::string, std::shared_ptr<Ty>>& composed);
+
+    //solves `constraints` into substitutions in solving order. a constraint that cannot hold is
+    //reported, and the variables it still mentions are bound to the error type
+    std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> resolveConstraints(std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>> constraints);
+
+    //write the constraints of `scope` and its children, or a substitution list, one per line
+    void printConstraints(std::shared_ptr<ScopeNode> scope, FILE* out);
+    void printSubstitutions(const std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>>& substitutions, FILE* out);
+
+    std::shared_ptr<ProgramNode> analyze(const char* src, const CompileOptions& options = CompileOptions());
 }
 #endif
\ No newline at end of file
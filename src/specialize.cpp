@@ -0,0 +1,271 @@
+#include "specialize.h"
+#include "semant.h"
+
+namespace pilaf {
+    //matches `pattern`'s quantified variables against a fully known type
+    static bool bindType(std::shared_ptr<Ty> pattern, std::shared_ptr<Ty> concrete, std::map<Symbol, std::shared_ptr<Ty>>& bindings)
+    {
+        std::vector<std::pair<const std::shared_ptr<Ty>*, const std::shared_ptr<Ty>*>> pending = {{&pattern, &concrete}};
+        while(!pending.empty())
+        {
+            auto& p = *pending.back().first;
+            auto& c = *pending.back().second;
+            pending.pop_back();
+            if(p == nullptr || c == nullptr)
+            {
+                if(p != c) return false;
+                continue;
+            }
+            if(c->type == Ty::TY_VAR) return false;
+            switch(p->type)
+            {
+                case Ty::TY_VAR:
+                {
+                    auto var = std::static_pointer_cast<TyVar>(p)->id;
+                    if(var == noSymbol) return false;
+                    auto it = bindings.find(var);
+                    if(it == bindings.end()) bindings.emplace(var, c);
+                    else if(!typesEqual(it->second, c)) return false;
+                    continue;
+                }
+                case Ty::TY_BASIC:
+                {
+                    if(c->type != Ty::TY_BASIC || std::static_pointer_cast<TyBasic>(p)->t != std::static_pointer_cast<TyBasic>(c)->t) return false;
+                    continue;
+                }
+                case Ty::TY_FUNCTION:
+                case Ty::TY_APPLICATION:
+                case Ty::TY_TUPLE:
+                case Ty::TY_ARRAY:
+                case Ty::TY_POINTER:
+                case Ty::TY_REFERENCE:
+                {
+                    auto arity = typeArity(*p);
+                    if(c->type != p->type || typeArity(*c) != arity) return false;
+                    for(size_t i = arity; i-- > 0;)
+                    {
+                        pending.emplace_back(&typeChild(*p, i), &typeChild(*c, i));
+                    }
+                    continue;
+                }
+                default: return false;
+            }
+        }
+        return true;
+    }
+
+    struct Specializer {
+        //the solver's substitutions composed into one map, so each call site is resolved in a single pass
+        const std::unordered_map<std::string, std::shared_ptr<Ty>> substitutions;
+        std::vector<std::shared_ptr<Specialization>>& specializations;
+        //keyed by the implementation and its type arguments flattened in variable order
+        std::map<std::pair<const FunctionDeclarationNode*, std::vector<TypeKey>>, std::shared_ptr<Specialization>> cache;
+
+        void call(std::shared_ptr<FunctionCallNode> fc, std::shared_ptr<ScopeNode> scope)
+        {
+            if(fc->calleeType == nullptr || fc->called == nullptr || fc->called->nodeType != NODE_IDENTIFIER) return;
+            auto identifier = std::static_pointer_cast<VariableNode>(fc->called)->variable;
+            auto method = intern(std::string_view(identifier.start, identifier.length));
+            Symbol className = noSymbol;
+            std::shared_ptr<ClassDeclarationNode> classdecl = nullptr;
+            for(auto s = scope; s != nullptr && classdecl == nullptr; s = s->parentScope)
+            {
+                if(className == noSymbol) className = s->instances.classOfMethod(method);
+                if(className == noSymbol) continue;
+                auto it = s->classes.find(symbolName(className));
+                if(it != s->classes.end()) classdecl = it->second;
+            }
+            if(classdecl == nullptr) return;
+
+            std::shared_ptr<FunctionDeclarationNode> declared = nullptr;
+            for(auto f : classdecl->functions)
+            {
+                auto fd = std::static_pointer_cast<FunctionDeclarationNode>(f);
+                if(tokenToString(fd->identifier) == tokenToString(identifier)) declared = fd;
+            }
+            if(declared == nullptr) return;
+
+            //the instance is statically known when the class variable is bound to a closed type
+            auto concrete = applySubstitutions(fc->calleeType, substitutions);
+            std::map<Symbol, std::shared_ptr<Ty>> classBindings;
+            if(!bindType(functionTypeFromFunction(declared), concrete, classBindings)) return;
+            auto instanceType = classBindings.find(intern(std::string_view(classdecl->typeName.start, classdecl->typeName.length)));
+            if(instanceType == classBindings.end()) return;
+
+            auto instance = findInstance(scope, className, instanceType->second);
+            if(instance == nullptr) return;
+            auto implementation = instance->method(method);
+            if(implementation == nullptr) return;
+            std::map<Symbol, std::shared_ptr<Ty>> typeArguments;
+            if(!bindType(functionTypeFromFunction(implementation), concrete, typeArguments)) return;
+
+            std::vector<TypeKey> key;
+            for(auto& arg : typeArguments)
+            {
+                auto flattened = flattenType(arg.second);
+                key.insert(key.end(), flattened.begin(), flattened.end());
+            }
+            auto& specialization = cache[std::make_pair(implementation.get(), std::move(key))];
+            if(specialization == nullptr)
+            {
+                specialization = std::make_shared<Specialization>();
+                specialization->function = implementation;
+                specialization->typeArguments = typeArguments;
+                specialization->name = symbolName(className) + "." + tokenToString(identifier) + "[" + typeToString(instanceType->second) + "]";
+                specializations.push_back(specialization);
+            }
+            fc->target = specialization;
+        }
+
+        void walk(std::shared_ptr<node> n, std::shared_ptr<ScopeNode> scope)
+        {
+            if(n == nullptr) return;
+            switch(n->nodeType)
+            {
+                case NODE_MODULE:
+                {
+                    auto md = std::static_pointer_cast<ModuleDeclarationNode>(n);
+                    walk(md->block, md->scope);
+                    break;
+                }
+                case NODE_BLOCK:
+                {
+                    auto block = std::static_pointer_cast<BlockStatementNode>(n);
+                    for(auto dec : block->declarations) walk(dec, block->scope);
+                    break;
+                }
+                case NODE_FUNCTIONDECL:
+                {
+                    walk(std::static_pointer_cast<FunctionDeclarationNode>(n)->body, scope);
+                    break;
+                }
+                case NODE_CLASSIMPL:
+                {
+                    for(auto f : std::static_pointer_cast<ClassImplementationNode>(n)->functions) walk(f, scope);
+                    break;
+                }
+                case NODE_VARIABLEDECL:
+                {
+                    walk(std::static_pointer_cast<VariableDeclarationNode>(n)->value, scope);
+                    break;
+                }
+                case NODE_IF:
+                {
+                    auto _if = std::static_pointer_cast<IfStatementNode>(n);
+                    walk(_if->branchExpr, scope);
+                    walk(_if->thenStmt, scope);
+                    walk(_if->elseStmt, scope);
+                    break;
+                }
+                case NODE_FOR:
+                {
+                    auto _for = std::static_pointer_cast<ForStatementNode>(n);
+                    walk(_for->initExpr, scope);
+                    walk(_for->condExpr, scope);
+                    walk(_for->incrementExpr, scope);
+                    walk(_for->loopStmt, scope);
+                    break;
+                }
+                case NODE_WHILE:
+                {
+                    auto _while = std::static_pointer_cast<WhileStatementNode>(n);
+                    walk(_while->loopExpr, scope);
+                    walk(_while->loopStmt, scope);
+                    break;
+                }
+                case NODE_SWITCH:
+                {
+                    auto _switch = std::static_pointer_cast<SwitchStatementNode>(n);
+                    walk(_switch->switchExpr, scope);
+                    for(auto c : _switch->cases) walk(c, scope);
+                    break;
+                }
+                case NODE_CASE:
+                {
+                    auto _case = std::static_pointer_cast<CaseNode>(n);
+                    walk(_case->caseStmt, _case->scope != nullptr ? _case->scope : scope);
+                    break;
+                }
+                case NODE_RETURN:
+                {
+                    walk(std::static_pointer_cast<ReturnStatementNode>(n)->returnExpr, scope);
+                    break;
+                }
+                case NODE_ASSIGNMENT:
+                {
+                    auto an = std::static_pointer_cast<AssignmentNode>(n);
+                    walk(an->variable, scope);
+                    walk(an->assignment, scope);
+                    break;
+                }
+                case NODE_BINARY:
+                {
+                    forEachOperand(n, [&](const std::shared_ptr<node>& operand) { walk(operand, scope); });
+                    break;
+                }
+                case NODE_UNARY:
+                {
+                    walk(std::static_pointer_cast<UnaryNode>(n)->expression, scope);
+                    break;
+                }
+                case NODE_FUNCTIONCALL:
+                {
+                    auto fc = std::static_pointer_cast<FunctionCallNode>(n);
+                    walk(fc->called, scope);
+                    for(auto arg : fc->args) walk(arg, scope);
+                    call(fc, scope);
+                    break;
+                }
+                case NODE_FIELDCALL:
+                {
+                    walk(std::static_pointer_cast<FieldCallNode>(n)->expr, scope);
+                    break;
+                }
+                case NODE_ARRAYCONSTRUCTOR:
+                {
+                    for(auto v : std::static_pointer_cast<ArrayConstructorNode>(n)->values) walk(v, scope);
+                    break;
+                }
+                case NODE_TUPLE:
+                {
+                    for(auto v : std::static_pointer_cast<TupleConstructorNode>(n)->values) walk(v, scope);
+                    break;
+                }
+                case NODE_LISTINIT:
+                {
+                    for(auto v : std::static_pointer_cast<ListInitNode>(n)->values) walk(v, scope);
+                    break;
+                }
+                case NODE_ARRAYINDEX:
+                {
+                    auto index = std::static_pointer_cast<ArrayIndexNode>(n);
+                    walk(index->array, scope);
+                    walk(index->index, scope);
+                    break;
+                }
+                case NODE_NAMESPACE:
+                {
+                    auto ns = std::static_pointer_cast<NamespaceNode>(n);
+                    auto s = getNamespaceScope(ns->name, scope);
+                    walk(ns->expr, s != nullptr ? s : scope);
+                    break;
+                }
+                case NODE_LAMBDA:
+                {
+                    walk(std::static_pointer_cast<LambdaNode>(n)->body, scope);
+                    break;
+                }
+                default: break;
+            }
+        }
+    };
+
+    void specializeCalls(std::shared_ptr<ProgramNode> program, const std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>>& substitutions)
+    {
+        Specializer specializer{composeSubstitutions(substitutions), program->specializations, {}};
+        for(auto dec : program->declarations)
+        {
+            specializer.walk(dec, program->globalScope);
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef specialize_header
+#define specialize_header
+
+#include <deque>
+#include <map>
+#include "parser.h"
+
+namespace pilaf {
+    //a class method implementation instantiated at concrete types. call sites whose
+    //instance is statically known point at one of these instead of the class method,
+    //so a backend can emit a direct call without passing a dictionary.
+    struct Specialization {
+        std::shared_ptr<FunctionDeclarationNode> function;
+        //bindings for the implementation's own type variables, by their interned names
+        std::map<Symbol, std::shared_ptr<Ty>> typeArguments;
+        //unique name a backend can emit the specialized body under, e.g. Show.show[List Int]
+        std::string name;
+    };
+
+    //binds every class method call in `program` whose instance type is known after
+    //`substitutions` to its implementation. specializations are deduplicated by
+    //(function, type arguments) and collected in program->specializations.
+    void specializeCalls(std::shared_ptr<ProgramNode> program, const std::deque<std::pair<std::shared_ptr<Ty>, std::shared_ptr<Ty>>>& substitutions);
+}
+#endif
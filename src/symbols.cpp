@@ -0,0 +1,29 @@
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include "symbols.h"
+
+namespace pilaf {
+    //names live in a deque so the string_views used as keys stay valid as it grows
+    static std::deque<std::string> symbolNames;
+    static std::unordered_map<std::string_view, Symbol> symbolTable;
+    //declarations may be parsed on several threads at once
+    static std::mutex symbolLock;
+
+    Symbol intern(std::string_view name)
+    {
+        std::lock_guard<std::mutex> lock(symbolLock);
+        auto it = symbolTable.find(name);
+        if(it != symbolTable.end()) return it->second;
+        Symbol s = (Symbol)symbolNames.size();
+        symbolNames.emplace_back(name);
+        symbolTable.emplace(symbolNames.back(), s);
+        return s;
+    }
+
+    const std::string& symbolName(Symbol symbol)
+    {
+        std::lock_guard<std::mutex> lock(symbolLock);
+        return symbolNames.at(symbol);
+    }
+}
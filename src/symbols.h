@@ -0,0 +1,16 @@
+#ifndef symbols_header
+#define symbols_header
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace pilaf {
+    //interned identifier; equal names intern to the same symbol
+    typedef uint32_t Symbol;
+    static const Symbol noSymbol = UINT32_MAX;
+
+    Symbol intern(std::string_view name);
+    const std::string& symbolName(Symbol symbol);
+}
+#endif
@@ -1,9 +1,13 @@
 #include "typecheck.h"
+#include "constraints.h"
 #include <cassert>
 #include <iostream>
 namespace pilaf
 {
     static bool typecheckError = false;
+    //return type of the enclosing function when it is annotated with a monotype; returns are checked against it
+    static std::shared_ptr<Ty> expectedReturnType = nullptr;
+    static DiagnosticEngine* diagnostics = nullptr;
     //expects that the first argument is a basic type, second argument is an applied type
 
     std::shared_ptr<ScopeNode> namespaceScope(std::shared_ptr<node> expr, std::shared_ptr<ScopeNode> currentScope)
@@ -44,58 +48,27 @@ namespace pilaf
     }
 
     bool hadError() { return typecheckError; }
+
+    void clearErrors() { typecheckError = false; }
     
-    void error(size_t line, std::string_view printable, std::string_view highlighted, const char* msg)
+    void setDiagnostics(DiagnosticEngine* engine)
+    {
+        diagnostics = engine;
+    }
+
+    void error(DiagnosticCode code, std::string_view highlighted, const char* msg, std::vector<std::shared_ptr<Ty>> args)
     {
         typecheckError = true;
-        size_t column = 0;
-        std::cerr << msg << '\n';
-        auto pos = printable.find(highlighted);
-        if(pos == std::string::npos) return;
-        std::cerr << printable.substr(0, pos);
-        auto last = printable.substr(0, pos).rfind("\n");
-        if(last == std::string::npos) last = 0;
-        auto distance = pos - last;
-        auto substr = highlighted;
-        bool errOnNext = false;
-        while(substr.size() != 0)
+        auto begin = highlighted.data();
+        auto end = begin == nullptr ? nullptr : begin + highlighted.size();
+        if(diagnostics != nullptr)
         {
-            auto pos2 = substr.find('\n');
-            if(pos2 == std::string::npos) 
-            {
-                std::cerr << substr;
-                substr = "";
-                errOnNext = true;
-            }
-            else
-            {
-                std::cerr << substr.substr(0, pos2+1);
-                substr = substr.substr(pos2+1);
-                std::cerr << std::string(distance, ' ') << std::string(pos2, '^') << '\n';
-                distance = 0;
-            }
+            diagnostics->report(code, SEVERITY_ERROR, begin, end, msg, std::move(args));
+            return;
         }
-        auto pos3 = printable.rfind(highlighted);
-        auto rest = printable.substr(pos3 + highlighted.length());
-        while(rest.size() != 0 && errOnNext == true)
-        {
-            auto pos2 = rest.find('\n');
-            if(pos2 == std::string::npos)
-            {
-                std::cerr << rest << '\n';
-                rest = "";
-                std::cerr << std::string(distance, ' ') << std::string(highlighted.rfind("\n") == std::string::npos ? highlighted.length() : highlighted.length() - (highlighted.rfind("\n") + 1), '^') << '\n';
-                errOnNext = false;
-            }
-            else
-            {
-                std::cerr << rest.substr(0, pos2) << '\n';
-                std::cerr << std::string(distance, ' ') << std::string(highlighted.rfind("\n") == std::string::npos ? highlighted.length() : highlighted.length() - (highlighted.rfind("\n") + 1), '^');
-                rest = rest.substr(pos2);
-                errOnNext = false;
-            }
-        }
-        std::cerr << rest;
+        DiagnosticEngine immediate;
+        immediate.report(code, SEVERITY_ERROR, begin, end, msg, std::move(args));
+        immediate.render(stderr, DIAGNOSTICS_TEXT, 1);
     }
     
     std::vector<std::shared_ptr<Ty>> functionTypeSplit(std::shared_ptr<Ty> type)
@@ -218,6 +191,238 @@ namespace pilaf
         return fn->in;
     }
 
+    bool isMonotype(std::shared_ptr<Ty> t)
+    {
+        std::vector<const Ty*> pending = {t.get()};
+        while(!pending.empty())
+        {
+            auto ty = pending.back();
+            pending.pop_back();
+            if(ty == nullptr) return false;
+            switch(ty->type)
+            {
+                case Ty::TY_VAR: return false;
+                case Ty::TY_BASIC: break;
+                case Ty::TY_FUNCTION:
+                case Ty::TY_APPLICATION:
+                case Ty::TY_TUPLE:
+                case Ty::TY_ARRAY:
+                case Ty::TY_POINTER:
+                case Ty::TY_REFERENCE:
+                {
+                    for(size_t i = 0; i < typeArity(*ty); i++) pending.push_back(typeChild(*ty, i).get());
+                    break;
+                }
+                default: return false;
+            }
+        }
+        return true;
+    }
+
+    static std::shared_ptr<StructDeclarationNode> findStruct(std::shared_ptr<node> typeExpr, std::shared_ptr<Ty> namedType, std::shared_ptr<ScopeNode> currentScope)
+    {
+        if(namedType == nullptr) return nullptr;
+        auto scope = namespaceScope(typeExpr, currentScope);
+        if(scope == nullptr) scope = currentScope;
+        auto name = declarationName(namedType);
+        for(; scope != nullptr; scope = scope->parentScope)
+        {
+            auto it = scope->structs.find(name);
+            if(it != scope->structs.end()) return it->second;
+        }
+        return nullptr;
+    }
+
+    //the struct a field is projected from: the record's own declaration when its type is known,
+    //otherwise the only struct in scope that declares a field of that name
+    static std::shared_ptr<StructDeclarationNode> fieldOwner(std::shared_ptr<Ty> record, Symbol field, std::shared_ptr<ScopeNode> currentScope, bool& declared)
+    {
+        declared = false;
+        if(record->type == Ty::TY_BASIC || record->type == Ty::TY_APPLICATION)
+        {
+            auto name = declarationName(record);
+            for(auto scope = currentScope; scope != nullptr; scope = scope->parentScope)
+            {
+                auto it = scope->structs.find(name);
+                if(it == scope->structs.end()) continue;
+                declared = it->second->field(field) != nullptr;
+                return declared ? it->second : nullptr;
+            }
+            return nullptr;
+        }
+        std::shared_ptr<StructDeclarationNode> owner = nullptr;
+        for(auto scope = currentScope; scope != nullptr; scope = scope->parentScope)
+        {
+            auto it = scope->fieldOwners.find(field);
+            if(it == scope->fieldOwners.end()) continue;
+            declared = true;
+            if(owner != nullptr || it->second.size() > 1) return nullptr;
+            owner = it->second.front();
+        }
+        return owner;
+    }
+
+    //field types in the order of an initializer's values: by name when every value is named, otherwise by position
+    static bool initializedFields(std::shared_ptr<StructDeclarationNode> sd, std::shared_ptr<ListInitNode> init, std::vector<std::shared_ptr<Ty>>& types)
+    {
+        if(sd->fields.size() != init->values.size()) return false;
+        if(init->fieldNames.size() != init->values.size())
+        {
+            if(!init->fieldNames.empty()) return false;
+            for(auto& f : sd->fields) types.push_back(f.type);
+            return true;
+        }
+        std::vector<bool> seen(sd->fields.size(), false);
+        for(auto& name : init->fieldNames)
+        {
+            auto info = sd->field(intern(std::string_view(name.start, name.length)));
+            if(info == nullptr || seen[info->index]) return false;
+            seen[info->index] = true;
+            types.push_back(info->type);
+        }
+        return true;
+    }
+
+    //a call can be checked against the callee's parameters when the callee is a known function of enough arguments
+    static bool canCheckCall(std::shared_ptr<Ty> funcType, const std::vector<std::shared_ptr<node>>& args)
+    {
+        if(funcType == nullptr || !isMonotype(funcType)) return false;
+        auto remaining = funcType;
+        for(auto arg : args)
+        {
+            if(remaining->type != Ty::TY_FUNCTION || arg->nodeType == NODE_PLACEHOLDER) return false;
+            remaining = std::static_pointer_cast<TyFunc>(remaining)->out;
+        }
+        return true;
+    }
+
+    //compares a synthesized type against the expected monotype, falling back to a constraint if it is not yet known
+    static std::shared_ptr<Ty> expectType(std::shared_ptr<node> n, std::shared_ptr<Ty> expected, std::shared_ptr<Ty> actual, std::shared_ptr<ScopeNode> currentScope)
+    {
+        if(actual == nullptr) return expected;
+        if(isErrorType(actual) || isErrorType(expected)) return expected;
+        if(isMonotype(actual))
+        {
+            if(!typesEqual(expected, actual))
+            {
+                error(DIAG_TYPE_MISMATCH, std::string_view(n->start, n->end - n->start), "type mismatch: expected {}, found {}!", {expected, actual});
+            }
+            return expected;
+        }
+        TypeVarMap map1;
+        TypeVarMap map2;
+        constrain(currentScope, generic(expected, map1), generic(actual, map2));
+        return expected;
+    }
+
+    std::shared_ptr<Ty> typeCheck(std::shared_ptr<node> n, std::shared_ptr<Ty> expected, std::shared_ptr<ScopeNode> currentScope)
+    {
+        assert(n != nullptr);
+        assert(currentScope != nullptr);
+        if(!isMonotype(expected))
+        {
+            auto t = typeInf(n, currentScope);
+            if(expected != nullptr && t != nullptr)
+            {
+                TypeVarMap map1;
+                TypeVarMap map2;
+                constrain(currentScope, generic(expected, map1), generic(t, map2));
+            }
+            return t;
+        }
+        switch(n->nodeType)
+        {
+            case NODE_BINARY:
+            {
+                //operands and result share a type
+                forEachOperand(n, [&](const std::shared_ptr<node>& operand) { typeCheck(operand, expected, currentScope); });
+                return expected;
+            }
+            case NODE_UNARY:
+            {
+                auto un = std::static_pointer_cast<UnaryNode>(n);
+                typeCheck(un->expression, expected, currentScope);
+                return expected;
+            }
+            case NODE_TUPLE:
+            {
+                auto tuple = std::static_pointer_cast<TupleConstructorNode>(n);
+                if(expected->type != Ty::TY_TUPLE || std::static_pointer_cast<TyTuple>(expected)->types.size() != tuple->values.size()) break;
+                auto types = std::static_pointer_cast<TyTuple>(expected)->types;
+                for(size_t i = 0; i < types.size(); i++)
+                {
+                    typeCheck(tuple->values[i], types[i], currentScope);
+                }
+                currentScope->nodeTVars.insert(std::make_pair(expected, n));
+                return expected;
+            }
+            case NODE_ARRAYCONSTRUCTOR:
+            {
+                auto arr = std::static_pointer_cast<ArrayConstructorNode>(n);
+                if(expected->type != Ty::TY_ARRAY) break;
+                bool hasEllipse = false;
+                for(auto v : arr->values) hasEllipse |= v->nodeType == NODE_ELLIPSE;
+                if(hasEllipse) break;
+                auto elementType = std::static_pointer_cast<TyArray>(expected)->arrayOf;
+                for(auto v : arr->values)
+                {
+                    typeCheck(v, elementType, currentScope);
+                }
+                return expected;
+            }
+            case NODE_LAMBDA:
+            {
+                auto l = std::static_pointer_cast<LambdaNode>(n);
+                auto remaining = expected;
+                for(auto& p : l->params)
+                {
+                    if(remaining->type != Ty::TY_FUNCTION) break;
+                    auto fn = std::static_pointer_cast<TyFunc>(remaining);
+                    if(p.type != nullptr && !typesEqual(p.type, fn->in))
+                    {
+                        if(isMonotype(p.type))
+                        {
+                            error(DIAG_TYPE_MISMATCH, std::string_view(p.identifier.start, p.identifier.length), "lambda parameter has type {}, expected {}!", {p.type, fn->in});
+                        }
+                        else
+                        {
+                            TypeVarMap map1;
+                            TypeVarMap map2;
+                            constrain(currentScope, generic(fn->in, map1), generic(p.type, map2));
+                        }
+                    }
+                    remaining = fn->out;
+                }
+                //the body's returns are checked against what remains of the expected type
+                l->returnType = remaining;
+                auto saved = expectedReturnType;
+                expectedReturnType = remaining;
+                typeInf(l->body, currentScope);
+                expectedReturnType = saved;
+                currentScope->nodeTVars.insert(std::make_pair(expected, n));
+                return expected;
+            }
+            case NODE_LISTINIT:
+            {
+                auto init = std::static_pointer_cast<ListInitNode>(n);
+                if(!init->type) break;
+                auto namedType = typeInf(init->type, currentScope);
+                if(!isMonotype(namedType) || !typesEqual(namedType, expected)) break;
+                auto sd = findStruct(init->type, namedType, currentScope);
+                std::vector<std::shared_ptr<Ty>> fieldTypes;
+                if(sd == nullptr || !isMonotype(sd->typeDefined) || !initializedFields(sd, init, fieldTypes)) break;
+                for(size_t i = 0; i < fieldTypes.size(); i++)
+                {
+                    typeCheck(init->values[i], fieldTypes[i], currentScope);
+                }
+                return expected;
+            }
+            default: break;
+        }
+        //literals, identifiers, field accesses and checked calls synthesize their type without constraints
+        return expectType(n, expected, typeInf(n, currentScope), currentScope);
+    }
+
     std::shared_ptr<Ty> typeInf(std::shared_ptr<node> n, std::shared_ptr<ScopeNode> currentScope)
     {
         assert(n != nullptr);
@@ -227,14 +432,16 @@ namespace pilaf
             case NODE_TYPEDEF:
             {
                 auto td = std::static_pointer_cast<TypedefNode>(n);
-                std::unordered_map<std::string, std::shared_ptr<Ty>> map1;
-                std::unordered_map<std::string, std::shared_ptr<Ty>> map2;
-                currentScope->constraints.push_back(std::make_pair(generic(td->typeDefined, map1), generic(td->typeAliased, map2)));
+                TypeVarMap map1;
+                TypeVarMap map2;
+                constrain(currentScope, generic(td->typeDefined, map1), generic(td->typeAliased, map2));
                 return td->typeDefined;
             }
             case NODE_MODULE:
             {
                 auto md = std::static_pointer_cast<ModuleDeclarationNode>(n);
+                //interface-loaded modules carry solved signatures and have no bodies to infer
+                if(md->interface != nullptr) return nullptr;
                 if(md->block)
                 {
                     auto blockType = typeInf(md->block, md->scope);
@@ -250,22 +457,34 @@ namespace pilaf
             case NODE_FUNCTIONDECL:
             {
                 auto fd = std::static_pointer_cast<FunctionDeclarationNode>(n);
+                bool deferred = fd->deferred != nullptr;
+                //a signatures-only check leaves skipped bodies unparsed, so an unannotated return type stays unknown
+                bool skipped = deferred && fd->deferred->context->options.signaturesOnly;
+                if(skipped && fd->returnType == nullptr) fd->returnType = newGenericType();
                 currentScope->nodeTVars.insert(std::make_pair(functionTypeFromFunction(fd), fd));
+                if(skipped) return functionTypeFromFunction(fd);
+                //the program was already parsed without errors, so syntax errors found now must fail it
+                if(deferred && functionBody(*fd) != nullptr && fd->body->containsError) typecheckError = true;
                 if(fd->body) 
                 {
+                    //an annotated return type is pushed down into the returns rather than solved for
+                    auto saved = expectedReturnType;
+                    expectedReturnType = isMonotype(fd->returnType) ? fd->returnType : nullptr;
+                    bool checked = expectedReturnType != nullptr;
                     auto bodyType = typeInf(fd->body, currentScope);
-                    std::unordered_map<std::string, std::shared_ptr<Ty>> map1;
-                    std::unordered_map<std::string, std::shared_ptr<Ty>> map2;
+                    expectedReturnType = saved;
+                    TypeVarMap map1;
+                    TypeVarMap map2;
                     if(fd->returnType == nullptr) fd->returnType = bodyType;
-                    else currentScope->constraints.push_back(std::make_pair(generic(fd->returnType, map1), generic(bodyType, map2)));
+                    else if(!checked) constrain(currentScope, generic(fd->returnType, map1), generic(bodyType, map2));
                 }
                 return functionTypeFromFunction(fd);
             }
             case NODE_VARIABLEDECL:
             {
                 auto vd = std::static_pointer_cast<VariableDeclarationNode>(n);
-                if(isRefutable(vd->assigned)) error(0, std::string_view(vd->start, vd->end - vd->start), std::string_view(vd->assigned->start, vd->assigned->end - vd->assigned->start), "variable declaration cannot assign to a refutable pattern!");
-                if(vd->identifiers.empty()) error(0, std::string_view(vd->start, vd->end - vd->start), std::string_view(vd->assigned->start, vd->assigned->end - vd->assigned->start), "variable declaration must have an identifier to assign to!");
+                if(isRefutable(vd->assigned)) error(DIAG_INVALID_PATTERN, std::string_view(vd->assigned->start, vd->assigned->end - vd->assigned->start), "variable declaration cannot assign to a refutable pattern!");
+                if(vd->identifiers.empty()) error(DIAG_INVALID_PATTERN, std::string_view(vd->assigned->start, vd->assigned->end - vd->assigned->start), "variable declaration must have an identifier to assign to!");
                 for(auto id : vd->identifiers)
                 {
                     auto s = currentScope;
@@ -279,19 +498,27 @@ namespace pilaf
                     }
                     if(s == nullptr) currentScope->variables.insert(std::make_pair(id.first, vd));
                 }
+                if(isMonotype(vd->type) && vd->assigned->nodeType == NODE_IDENTIFIER)
+                {
+                    //an annotated binding takes its annotation directly; the value is checked against it
+                    for(auto& id : vd->identifiers) id.second = vd->type;
+                    currentScope->nodeTVars.insert(std::make_pair(vd->type, vd));
+                    if(vd->value) typeCheck(vd->value, vd->type, currentScope);
+                    return vd->type;
+                }
                 auto assignedType = typeInf(vd->assigned, currentScope);
                 {
-                    std::unordered_map<std::string, std::shared_ptr<Ty>> map1;
-                    std::unordered_map<std::string, std::shared_ptr<Ty>> map2;
-                    currentScope->constraints.push_back(std::make_pair(generic(vd->type, map1), generic(assignedType, map2)));
+                    TypeVarMap map1;
+                    TypeVarMap map2;
+                    constrain(currentScope, generic(vd->type, map1), generic(assignedType, map2));
                 }
                 currentScope->nodeTVars.insert(std::make_pair(vd->type, vd));
                 if(vd->value)
                 {
                     auto valueType = typeInf(vd->value, currentScope);
-                    std::unordered_map<std::string, std::shared_ptr<Ty>> map1;
-                    std::unordered_map<std::string, std::shared_ptr<Ty>> map2;
-                    if(valueType != nullptr) currentScope->constraints.push_back(std::make_pair(generic(vd->type, map1), generic(valueType, map2)));
+                    TypeVarMap map1;
+                    TypeVarMap map2;
+                    if(valueType != nullptr) constrain(currentScope, generic(vd->type, map1), generic(valueType, map2));
                 }
                 return vd->type;
             }
@@ -321,12 +548,12 @@ namespace pilaf
                 if(_if->thenStmt) t1 = typeInf(_if->thenStmt, currentScope);
                 if(_if->elseStmt) t2 = typeInf(_if->elseStmt, currentScope);
                 if(t1 == nullptr) return t2;
-                else if (t2 == nullptr) return t1;
+                else if (t2 == nullptr || t1 == t2) return t1;
                 else 
                 {
-                    std::unordered_map<std::string, std::shared_ptr<Ty>> map1;
-                    std::unordered_map<std::string, std::shared_ptr<Ty>> map2;
-                    currentScope->constraints.push_back(std::make_pair(generic(t1, map1), generic(t2, map2)));
+                    TypeVarMap map1;
+                    TypeVarMap map2;
+                    constrain(currentScope, generic(t1, map1), generic(t2, map2));
                     return t1;
                 }
             }
@@ -357,9 +584,10 @@ namespace pilaf
                     caseRets.pop_back();
                     for(auto c : caseRets)
                     {
-                        std::unordered_map<std::string, std::shared_ptr<Ty>> map1;
-                        std::unordered_map<std::string, std::shared_ptr<Ty>> map2;
-                        currentScope->constraints.push_back(std::make_pair(generic(t1, map1), generic(c, map2)));
+                        if(c == t1) continue;
+                        TypeVarMap map1;
+                        TypeVarMap map2;
+                        constrain(currentScope, generic(t1, map1), generic(c, map2));
                     }
                     return t1;
                 }
@@ -375,7 +603,11 @@ namespace pilaf
             case NODE_RETURN:
             {
                 auto ret = std::static_pointer_cast<ReturnStatementNode>(n);
-                if(ret->returnExpr) return typeInf(ret->returnExpr, currentScope);
+                if(ret->returnExpr)
+                {
+                    if(expectedReturnType != nullptr) return typeCheck(ret->returnExpr, expectedReturnType, currentScope);
+                    return typeInf(ret->returnExpr, currentScope);
+                }
                 else {
                     auto t = std::make_shared<TyBasic>("Void");
                     return t;
@@ -417,9 +649,11 @@ namespace pilaf
                 {
                     for(size_t i = 1; i < returnTypes.size(); i++)
                     {
-                        std::unordered_map<std::string, std::shared_ptr<Ty>> map1;
-                        std::unordered_map<std::string, std::shared_ptr<Ty>> map2;
-                        b->scope->constraints.push_back(std::make_pair(generic(returnTypes[i-1], map1), generic(returnTypes[i], map2)));
+                        //checked returns all yield the expected type itself
+                        if(returnTypes[i-1] == returnTypes[i]) continue;
+                        TypeVarMap map1;
+                        TypeVarMap map2;
+                        constrain(b->scope, generic(returnTypes[i-1], map1), generic(returnTypes[i], map2));
                     }
                 }
                 if(returnTypes.size() > 0) return returnTypes[0];
@@ -430,20 +664,24 @@ namespace pilaf
                 auto an = std::static_pointer_cast<AssignmentNode>(n);
                 std::shared_ptr<Ty> t1 = typeInf(an->variable, currentScope);
                 std::shared_ptr<Ty> t2 = typeInf(an->assignment, currentScope);
-                std::unordered_map<std::string, std::shared_ptr<Ty>> map1;
-                std::unordered_map<std::string, std::shared_ptr<Ty>> map2;
-                currentScope->constraints.push_back(std::make_pair(generic(t1, map1), generic(t2, map2)));
+                TypeVarMap map1;
+                TypeVarMap map2;
+                constrain(currentScope, generic(t1, map1), generic(t2, map2));
                 return t1;
             }
             case NODE_BINARY:
             {
                 //TODO: treat operators like functions and add constraints for operator types
-                auto bn = std::static_pointer_cast<BinaryNode>(n);
-                std::shared_ptr<Ty> t1 = typeInf(bn->expression1, currentScope);
-                std::shared_ptr<Ty> t2 = typeInf(bn->expression2, currentScope);
-                std::unordered_map<std::string, std::shared_ptr<Ty>> map1;
-                std::unordered_map<std::string, std::shared_ptr<Ty>> map2;
-                currentScope->constraints.push_back(std::make_pair(generic(t1, map1), generic(t2, map2)));
+                std::vector<BinaryNode*> spine;
+                auto left = binarySpine(n, spine);
+                std::shared_ptr<Ty> t1 = typeInf(left, currentScope);
+                for(auto bn : spine)
+                {
+                    std::shared_ptr<Ty> t2 = typeInf(bn->expression2, currentScope);
+                    TypeVarMap map1;
+                    TypeVarMap map2;
+                    constrain(currentScope, generic(t1, map1), generic(t2, map2));
+                }
                 return t1;
             }
             case NODE_UNARY:
@@ -457,8 +695,21 @@ namespace pilaf
             {
                 //TODO: add support for type constructors
                 auto fc = std::static_pointer_cast<FunctionCallNode>(n);
-                std::shared_ptr<Ty> returnType = newGenericType();
                 std::shared_ptr<Ty> funcType = typeInf(fc->called, currentScope);
+                if(canCheckCall(funcType, fc->args))
+                {
+                    //arguments to a monomorphic callee are checked against its parameters
+                    fc->calleeType = funcType;
+                    auto remaining = funcType;
+                    for(auto arg : fc->args)
+                    {
+                        auto fn = std::static_pointer_cast<TyFunc>(remaining);
+                        typeCheck(arg, fn->in, currentScope);
+                        remaining = fn->out;
+                    }
+                    return remaining;
+                }
+                std::shared_ptr<Ty> returnType = newGenericType();
                 std::shared_ptr<Ty> result = returnType;
                 std::vector<std::shared_ptr<Ty>> argTypes;
                 for(auto arg : fc->args)
@@ -481,9 +732,10 @@ namespace pilaf
                     //    closureType = newClosure;
                     //}
                 }
-                std::unordered_map<std::string, std::shared_ptr<Ty>> map1;
-                std::unordered_map<std::string, std::shared_ptr<Ty>> map2;
-                currentScope->constraints.push_back(std::make_pair(generic(funcType, map1), generic(closureType, map2)));
+                TypeVarMap map1;
+                TypeVarMap map2;
+                fc->calleeType = generic(funcType, map1);
+                constrain(currentScope, fc->calleeType, generic(closureType, map2));
     
                 return result;
             }
@@ -491,20 +743,24 @@ namespace pilaf
             {
                 auto field = std::static_pointer_cast<FieldCallNode>(n);
                 std::shared_ptr<Ty> t1 = typeInf(field->expr, currentScope);
-                if(currentScope->fields.find(tokenToString(field->field)) != currentScope->fields.end())
+                if(t1 == nullptr) return newGenericType();
+                //fields are reached through pointers and references as well
+                if(t1->type == Ty::TY_POINTER) t1 = std::static_pointer_cast<TyPointer>(t1)->pointsTo;
+                else if(t1->type == Ty::TY_REFERENCE) t1 = std::static_pointer_cast<TyRef>(t1)->refTo;
+                auto name = intern(std::string_view(field->field.start, field->field.length));
+                bool declared;
+                auto sd = fieldOwner(t1, name, currentScope, declared);
+                if(!declared)
                 {
-                    auto range = currentScope->fields.equal_range(tokenToString(field->field));
-                    for(auto it = range.first; it != range.second; it++)
-                    {
-                        if(typesEqual(it->second.first, t1))
-                        {
-                            return it->second.second;
-                        }
-                    }
-                    error(field->field.line, std::string_view(field->start, field->end - field->start), std::string_view(field->field.start, field->field.length), "Field name could not be found for type!");
+                    error(DIAG_UNKNOWN_FIELD, std::string_view(field->field.start, field->field.length), "Field name could not be found for type!");
+                    return newGenericType();
                 }
-                
-                return newGenericType();
+                //several structs declare the field and the record is not known yet
+                if(sd == nullptr) return newGenericType();
+                TypeVarMap map;
+                auto record = generic(sd->typeDefined, map);
+                constrain(currentScope, t1, record);
+                return generic(sd->field(name)->type, map);
             }
             case NODE_ARRAYCONSTRUCTOR:
             {
@@ -518,9 +774,9 @@ namespace pilaf
                         std::shared_ptr<Ty> curr = typeInf(v, currentScope);
                         if(previous != nullptr)
                         {
-                            std::unordered_map<std::string, std::shared_ptr<Ty>> map1;
-                            std::unordered_map<std::string, std::shared_ptr<Ty>> map2;
-                            currentScope->constraints.emplace_back(generic(previous, map1), generic(curr, map2));
+                            TypeVarMap map1;
+                            TypeVarMap map2;
+                            constrain(currentScope, generic(previous, map1), generic(curr, map2));
                         }
                         previous = curr;
                     }
@@ -528,13 +784,13 @@ namespace pilaf
                     {
                         if(hasEllipse)
                         {
-                            error(0, std::string_view(arr->start, arr->end - arr->start), std::string_view(v->start, v->end - v->start), "array pattern can contain only one remainder pattern!");
+                            error(DIAG_INVALID_PATTERN, std::string_view(v->start, v->end - v->start), "array pattern can contain only one remainder pattern!");
                         }
                         else hasEllipse = true;
                         std::shared_ptr<Ty> curr = typeInf(v, currentScope);
-                        std::unordered_map<std::string, std::shared_ptr<Ty>> map1;
-                        std::unordered_map<std::string, std::shared_ptr<Ty>> map2;
-                        currentScope->constraints.emplace_back(generic(std::make_shared<TyArray>(previous, std::optional<size_t>()), map1), generic(curr, map2));
+                        TypeVarMap map1;
+                        TypeVarMap map2;
+                        constrain(currentScope, generic(std::make_shared<TyArray>(previous, std::optional<size_t>()), map1), generic(curr, map2));
                     }
                 }
                 auto result = std::make_shared<TyArray>(previous, std::optional<size_t>());
@@ -546,8 +802,8 @@ namespace pilaf
                 auto scope = getNamespaceScope(ns->name, currentScope);
                 if(scope != nullptr) return typeInf(ns->expr, scope);
                 else {
-                    error(ns->name.line, std::string_view(ns->start, ns->end - ns->start), std::string_view(ns->name.start, ns->name.length), "Invalid namespace name!");
-                    return nullptr;
+                    error(DIAG_UNKNOWN_NAME, std::string_view(ns->name.start, ns->name.length), "Invalid namespace name!");
+                    return errorType();
                 }
             }
             case NODE_ELLIPSE:
@@ -560,9 +816,9 @@ namespace pilaf
                 auto range = std::static_pointer_cast<RangePatternNode>(n);
                 std::shared_ptr<Ty> t1 = typeInf(range->expression1, currentScope);
                 std::shared_ptr<Ty> t2 = typeInf(range->expression2, currentScope);
-                std::unordered_map<std::string, std::shared_ptr<Ty>> map1;
-                std::unordered_map<std::string, std::shared_ptr<Ty>> map2;
-                currentScope->constraints.push_back(std::make_pair(generic(t1, map1), generic(t2, map2)));
+                TypeVarMap map1;
+                TypeVarMap map2;
+                constrain(currentScope, generic(t1, map1), generic(t2, map2));
                 return t1;
             }
             case NODE_ARRAYINDEX:
@@ -571,9 +827,9 @@ namespace pilaf
                 auto arrayType = typeInf(index->array, currentScope);
                 std::shared_ptr<Ty> indexedType = newGenericType();
                 auto next = std::make_shared<TyArray>(indexedType, std::make_optional<size_t>());
-                std::unordered_map<std::string, std::shared_ptr<Ty>> map1;
-                std::unordered_map<std::string, std::shared_ptr<Ty>> map2;
-                currentScope->constraints.emplace_back(generic(next, map1), generic(arrayType, map2));
+                TypeVarMap map1;
+                TypeVarMap map2;
+                constrain(currentScope, generic(next, map1), generic(arrayType, map2));
                 return indexedType;
             }
             case NODE_IDENTIFIER:
@@ -606,16 +862,19 @@ namespace pilaf
                         }
                     }
                 }
-                error(var->variable.line, std::string_view(var->start, var->end - var->start), std::string_view(var->start, var->end - var->start), "could not find identifier!");
-                return nullptr;
+                error(DIAG_UNKNOWN_NAME, std::string_view(var->start, var->end - var->start), "could not find identifier!");
+                return errorType();
             }
             case NODE_LAMBDA:
             {
                 auto l = std::static_pointer_cast<LambdaNode>(n);
+                auto saved = expectedReturnType;
+                expectedReturnType = nullptr;
                 auto ret = typeInf(l->body, currentScope);
-                std::unordered_map<std::string, std::shared_ptr<Ty>> map1;
-                std::unordered_map<std::string, std::shared_ptr<Ty>> map2;
-                currentScope->constraints.push_back(std::make_pair(generic(ret, map1), generic(l->returnType, map2)));
+                expectedReturnType = saved;
+                TypeVarMap map1;
+                TypeVarMap map2;
+                constrain(currentScope, generic(ret, map1), generic(l->returnType, map2));
                 std::shared_ptr<Ty> result = nullptr;
                 for(auto it = l->params.begin(); it != l->params.end(); it++)
                 {
@@ -697,47 +956,33 @@ namespace pilaf
                 if(init->type)
                 {
                     auto namedType = typeInf(init->type, currentScope);                    
-                    auto scope = namespaceScope(init->type, currentScope);
-                    if(scope == nullptr) scope = currentScope;
-                    std::shared_ptr<StructDeclarationNode> sd = nullptr;
-                    while(scope != nullptr)
-                    {
-                        if(scope->structs.find(declarationName(namedType)) != scope->structs.end())
-                        {
-                            sd = scope->structs.at(declarationName(namedType));
-                            break;
-                        }
-                        else scope = scope->parentScope;
-                    }
+                    auto sd = findStruct(init->type, namedType, currentScope);
                     if(sd == nullptr)
                     {
-                        error(0, std::string_view(init->start, init->end - init->start), std::string_view(init->type->start, init->type->end - init->type->start), "Could not find struct type!");
-                        return nullptr;
+                        error(DIAG_UNKNOWN_NAME, std::string_view(init->type->start, init->type->end - init->type->start), "Could not find struct type!");
+                        return errorType();
                     }
                     else
                     {
-                        if(sd->fields.size() != init->values.size()) 
+                        std::vector<std::shared_ptr<Ty>> fieldTypes;
+                        if(!initializedFields(sd, init, fieldTypes))
                         {
-                            error(0, std::string_view(init->start, init->end - init->start), std::string_view(init->start, init->end - init->start), "too few/many values to initialize struct!");
-                            return nullptr;
+                            error(DIAG_INVALID_INITIALIZER, std::string_view(init->start, init->end - init->start), "initializer does not match the struct's fields!");
+                            return errorType();
                         }
-                        //TODO: account for type parameters in struct somehow
-                        for(auto i = 0; i < sd->fields.size(); i++)
+                        //one instantiation for every field, so the struct's type parameters are shared between them
+                        TypeVarMap map;
+                        for(size_t i = 0; i < fieldTypes.size(); i++)
                         {
-                            auto field = sd->fields[i];
-                            auto value = init->values[i];
-                            std::unordered_map<std::string, std::shared_ptr<Ty>> map1;
-                            map1 = genericMap(sd->typeDefined, map1);
-                            std::unordered_map<std::string, std::shared_ptr<Ty>> map2;
-                            currentScope->constraints.push_back(std::make_pair(generic(field.type, map1), generic(typeInf(value, currentScope), map2)));
-                            return generic(sd->typeDefined, map1);
+                            constrain(currentScope, generic(fieldTypes[i], map), typeInf(init->values[i], currentScope));
                         }
+                        return generic(sd->typeDefined, map);
                     }
                 }
                 else
                 {
-                    error(0, std::string_view(init->start, init->end - init->start), std::string_view(init->start, init->end - init->start), "struct initialization must have a type name!");
-                    return nullptr;
+                    error(DIAG_INVALID_INITIALIZER, std::string_view(init->start, init->end - init->start), "struct initialization must have a type name!");
+                    return errorType();
                 }
                 break;
             }
@@ -758,6 +1003,11 @@ namespace pilaf
                 auto result = std::make_shared<TyBasic>("%Void");
                 return result;
             }
+            case NODE_ERROR:
+            {
+                //the parser has already reported this code
+                return errorType();
+            }
             default:
             {
                 system("pause");
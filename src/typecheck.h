@@ -1,11 +1,23 @@
+#ifndef typecheck_header
+#define typecheck_header
+
 #include "parser.h"
 #include <cassert>
 namespace pilaf
 {
-    void error(size_t line, std::string_view printable, std::string_view highlighted, const char* msg);
+    //records an error on `highlighted`. `msg` must outlive the compilation; each "{}" in it is
+    //replaced by the next type in `args` when the diagnostic is rendered
+    void error(DiagnosticCode code, std::string_view highlighted, const char* msg, std::vector<std::shared_ptr<Ty>> args = {});
+    //engine that error() records into; without one, errors are rendered as they are reported
+    void setDiagnostics(DiagnosticEngine* engine);
 
     std::shared_ptr<Ty> typeInf(std::shared_ptr<node> n, std::shared_ptr<ScopeNode> currentScope);
 
+    //checking mode: pushes a known expected type into `n`, emitting constraints only where inference is still needed
+    std::shared_ptr<Ty> typeCheck(std::shared_ptr<node> n, std::shared_ptr<Ty> expected, std::shared_ptr<ScopeNode> currentScope);
+
+    bool isMonotype(std::shared_ptr<Ty> type);
+
     bool isFunctionType(std::shared_ptr<Ty> type);
 
     std::shared_ptr<Ty> returnTypeFromFunctionType(std::shared_ptr<Ty> type);
@@ -15,4 +27,7 @@ namespace pilaf
     std::shared_ptr<Ty> firstParameterFromFunctionType(std::shared_ptr<Ty> type);
     
     bool hadError();
-}
\ No newline at end of file
+    //forgets the errors of the previous analysis
+    void clearErrors();
+}
+#endif
@@ -0,0 +1,924 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "jit.h"
+#include "vm.h"
+
+#if defined(__GNUC__) && !defined(PILAF_SWITCH_DISPATCH)
+#define PILAF_COMPUTED_GOTO
+#endif
+
+namespace pilaf {
+    enum NativeFunction {
+        NATIVE_PRINT,
+        NATIVE_ARRAY,
+        NATIVE_LENGTH,
+        NATIVE_SQRT,
+        NATIVE_TO_DOUBLE,
+        NATIVE_TO_INT
+    };
+
+    static const struct {
+        const char* name;
+        size_t arity;
+    } natives[] = {
+        {"print", 1},
+        {"array", 2},
+        {"length", 1},
+        {"sqrt", 1},
+        {"toDouble", 1},
+        {"toInt", 1},
+    };
+
+    int findNative(const std::string& name, size_t arity)
+    {
+        for(size_t i = 0; i < sizeof(natives) / sizeof(natives[0]); i++)
+        {
+            if(name == natives[i].name && arity == natives[i].arity) return (int)i;
+        }
+        return -1;
+    }
+
+    const char* dispatchMode()
+    {
+    #ifdef PILAF_COMPUTED_GOTO
+        return "computed-goto";
+    #else
+        return "switch";
+    #endif
+    }
+
+    //registers shared by every frame, and the deepest the calls may nest
+    static const size_t stackSize = 1 << 20;
+    static const size_t maxFrames = 1 << 16;
+    static const size_t firstCollection = 1 << 16;
+
+    static bool isObject(const Value& v, ObjectType type)
+    {
+        return v.type == VAL_OBJECT && v.as.object->type == type;
+    }
+
+    //primitives and strings compare by value, aggregates by their contents
+    static bool valuesEqual(const Value& x, const Value& y, size_t depth)
+    {
+        if(x.type != y.type) return false;
+        switch(x.type)
+        {
+            case VAL_VOID: return true;
+            case VAL_BOOL: return x.as.b == y.as.b;
+            case VAL_INT: return x.as.i == y.as.i;
+            case VAL_FLOAT: return x.as.f == y.as.f;
+            case VAL_DOUBLE: return x.as.d == y.as.d;
+            case VAL_CHAR: return x.as.c == y.as.c;
+            case VAL_FUNCTION: return x.as.function == y.as.function;
+            case VAL_OBJECT:
+            {
+                auto a = x.as.object;
+                auto b = y.as.object;
+                if(a == b) return true;
+                //cyclic aggregates are only equal when they are the same object
+                if(a->type != b->type || depth > 64) return false;
+                switch(a->type)
+                {
+                    case OBJ_STRING: return static_cast<StringObject*>(a)->text == static_cast<StringObject*>(b)->text;
+                    case OBJ_ARRAY:
+                    {
+                        auto& u = static_cast<ArrayObject*>(a)->values;
+                        auto& v = static_cast<ArrayObject*>(b)->values;
+                        if(u.size() != v.size()) return false;
+                        for(size_t i = 0; i < u.size(); i++)
+                        {
+                            if(!valuesEqual(u[i], v[i], depth + 1)) return false;
+                        }
+                        return true;
+                    }
+                    case OBJ_RECORD:
+                    {
+                        auto r = static_cast<RecordObject*>(a);
+                        auto s = static_cast<RecordObject*>(b);
+                        if(r->layout != s->layout) return false;
+                        for(size_t i = 0; i < r->fields.size(); i++)
+                        {
+                            if(!valuesEqual(r->fields[i], s->fields[i], depth + 1)) return false;
+                        }
+                        return true;
+                    }
+                    case OBJ_VARIANT:
+                    {
+                        auto v = static_cast<VariantObject*>(a);
+                        auto w = static_cast<VariantObject*>(b);
+                        return v->layout == w->layout && v->tag == w->tag && valuesEqual(v->payload, w->payload, depth + 1);
+                    }
+                    //closures are only equal when they are the same object
+                    case OBJ_CLOSURE: return false;
+                }
+            }
+        }
+        return false;
+    }
+
+    static const char* operatorText(Opcode op)
+    {
+        switch(op)
+        {
+            case OP_ADD: return "+";
+            case OP_SUB: return "-";
+            case OP_MUL: return "*";
+            case OP_DIV: return "/";
+            case OP_MOD: return "%";
+            case OP_BAND: return "&";
+            case OP_BOR: return "|";
+            case OP_BXOR: return "^";
+            case OP_SHL: return "<<";
+            case OP_SHR: return ">>";
+            case OP_LT: return "<";
+            case OP_LE: return "<=";
+            default: return opcodeName(op);
+        }
+    }
+
+    VM::VM(const Module& module, FILE* out)
+    : module(module), out(out), stack(new Value[stackSize]), stackEnd(stack.get() + stackSize), stackUsed(stack.get()),
+      objects(nullptr), objectCount(0), allocationCount(0), nextCollection(firstCollection), collectionCount(0), jitThreshold(0), compiledCallCount(0)
+    {
+        globals.assign(module.globals.size(), Value::makeVoid());
+    }
+
+    VM::~VM()
+    {
+        while(objects != nullptr)
+        {
+            auto next = objects->next;
+            delete objects;
+            objects = next;
+        }
+    }
+
+    void VM::track(Object* object, Value* top)
+    {
+        if(objectCount >= nextCollection) collect(top);
+        object->next = objects;
+        objects = object;
+        objectCount++;
+        allocationCount++;
+    }
+
+    void VM::collect(Value* top)
+    {
+        collectionCount++;
+        //a caller's registers can reach above the frame that is running
+        for(auto& frame : frames)
+        {
+            auto frameTop = frame.base + frame.function->registers;
+            if(frameTop > top) top = frameTop;
+        }
+        std::vector<Object*> gray;
+        auto markValue = [&gray](const Value& v)
+        {
+            if(v.type != VAL_OBJECT || v.as.object->marked) return;
+            v.as.object->marked = true;
+            gray.push_back(v.as.object);
+        };
+        for(auto v = stack.get(); v < top; v++) markValue(*v);
+        for(auto& v : globals) markValue(v);
+        while(!gray.empty())
+        {
+            auto o = gray.back();
+            gray.pop_back();
+            switch(o->type)
+            {
+                case OBJ_STRING: break;
+                case OBJ_ARRAY: for(auto& v : static_cast<ArrayObject*>(o)->values) markValue(v); break;
+                case OBJ_RECORD: for(auto& v : static_cast<RecordObject*>(o)->fields) markValue(v); break;
+                case OBJ_VARIANT: markValue(static_cast<VariantObject*>(o)->payload); break;
+                case OBJ_CLOSURE: for(auto& v : static_cast<ClosureObject*>(o)->captures) markValue(v); break;
+            }
+        }
+        //dead registers above the live frames may point at objects freed below
+        for(auto v = top; v < stackUsed; v++) *v = Value::makeVoid();
+        Object** link = &objects;
+        objectCount = 0;
+        while(*link != nullptr)
+        {
+            auto o = *link;
+            if(o->marked)
+            {
+                o->marked = false;
+                link = &o->next;
+                objectCount++;
+            }
+            else
+            {
+                *link = o->next;
+                delete o;
+            }
+        }
+        //closures in frame slots are not swept, so their marks are cleared here
+        for(auto& c : localClosures)
+        {
+            if(c != nullptr) c->marked = false;
+        }
+        nextCollection = std::max(firstCollection, objectCount * 2);
+    }
+
+    void VM::fail(const Function* function, const Instruction* ip, const std::string& what)
+    {
+        size_t at = ip - function->code.data() - 1;
+        message.clear();
+        if(at < function->lines.size() && function->lines[at] != 0)
+        {
+            message.append("[line ").append(std::to_string(function->lines[at])).append("] ");
+        }
+        //an error in code inlined from another function is reported as that function's
+        auto& name = at < function->origins.size() && function->origins[at] != 0 ? function->inlined[function->origins[at] - 1] : function->name;
+        message.append("runtime error in ").append(name).append(": ").append(what);
+        frames.clear();
+    }
+
+    void VM::setJitThreshold(uint32_t calls)
+    {
+        jitThreshold = 0;
+        jit = nullptr;
+        if(calls == 0 || !Jit::supported() || module.ir == nullptr) return;
+        jit.reset(new Jit(*module.ir));
+        jitThreshold = calls;
+        jitCalls.assign(module.functions.size(), 0);
+    }
+
+    int VM::runCompiled(uint16_t function, Value* window)
+    {
+        auto source = module.functions[function].source;
+        if(!jit->compile(source))
+        {
+            jitCalls[function] = INT64_MIN;
+            return 0;
+        }
+        //the interpreter reports this overflow itself
+        if(frames.size() == maxFrames) return 0;
+        auto& kinds = jit->params(source);
+        uint64_t args[16];
+        for(size_t k = 0; k < kinds.size(); k++)
+        {
+            auto& v = window[1 + k];
+            switch(kinds[k])
+            {
+                case JIT_INT: if(v.type != VAL_INT) return 0; args[k] = (uint64_t)v.as.i; break;
+                case JIT_BOOL: if(v.type != VAL_BOOL) return 0; args[k] = v.as.b ? 1 : 0; break;
+                case JIT_DOUBLE: if(v.type != VAL_DOUBLE) return 0; memcpy(&args[k], &v.as.d, sizeof(double)); break;
+            }
+        }
+        uint64_t bits;
+        compiledCallCount++;
+        if(!jit->call(source, args, maxFrames - frames.size(), bits))
+        {
+            message = jit->error();
+            frames.clear();
+            return -1;
+        }
+        switch(jit->result(source))
+        {
+            case JIT_INT: window[0] = Value::makeInt((int64_t)bits); break;
+            case JIT_BOOL: window[0] = Value::makeBool(bits != 0); break;
+            case JIT_DOUBLE:
+            {
+                double d;
+                memcpy(&d, &bits, sizeof(double));
+                window[0] = Value::makeDouble(d);
+                break;
+            }
+        }
+        return 1;
+    }
+
+    bool VM::arithmetic(Opcode op, const Value& x, const Value& y, Value& result, Value* top)
+    {
+        if(x.type != y.type)
+        {
+            message = std::string("operands of '") + operatorText(op) + "' have different types";
+            return false;
+        }
+        switch(x.type)
+        {
+            case VAL_INT:
+            {
+                //integers wrap around instead of overflowing
+                auto a = (uint64_t)x.as.i;
+                auto b = (uint64_t)y.as.i;
+                switch(op)
+                {
+                    case OP_ADD: result = Value::makeInt((int64_t)(a + b)); return true;
+                    case OP_SUB: result = Value::makeInt((int64_t)(a - b)); return true;
+                    case OP_MUL: result = Value::makeInt((int64_t)(a * b)); return true;
+                    case OP_DIV:
+                    case OP_MOD:
+                    {
+                        if(y.as.i == 0)
+                        {
+                            message = "integer division by zero";
+                            return false;
+                        }
+                        if(y.as.i == -1) result = Value::makeInt(op == OP_DIV ? (int64_t)(0 - a) : 0);
+                        else result = Value::makeInt(op == OP_DIV ? x.as.i / y.as.i : x.as.i % y.as.i);
+                        return true;
+                    }
+                    case OP_BAND: result = Value::makeInt((int64_t)(a & b)); return true;
+                    case OP_BOR: result = Value::makeInt((int64_t)(a | b)); return true;
+                    case OP_BXOR: result = Value::makeInt((int64_t)(a ^ b)); return true;
+                    case OP_SHL: result = Value::makeInt((int64_t)(a << (b & 63))); return true;
+                    case OP_SHR: result = Value::makeInt(x.as.i >> (b & 63)); return true;
+                    default: break;
+                }
+                break;
+            }
+            case VAL_DOUBLE:
+            {
+                switch(op)
+                {
+                    case OP_ADD: result = Value::makeDouble(x.as.d + y.as.d); return true;
+                    case OP_SUB: result = Value::makeDouble(x.as.d - y.as.d); return true;
+                    case OP_MUL: result = Value::makeDouble(x.as.d * y.as.d); return true;
+                    case OP_DIV: result = Value::makeDouble(x.as.d / y.as.d); return true;
+                    case OP_MOD: result = Value::makeDouble(std::fmod(x.as.d, y.as.d)); return true;
+                    default: break;
+                }
+                break;
+            }
+            case VAL_FLOAT:
+            {
+                switch(op)
+                {
+                    case OP_ADD: result = Value::makeFloat(x.as.f + y.as.f); return true;
+                    case OP_SUB: result = Value::makeFloat(x.as.f - y.as.f); return true;
+                    case OP_MUL: result = Value::makeFloat(x.as.f * y.as.f); return true;
+                    case OP_DIV: result = Value::makeFloat(x.as.f / y.as.f); return true;
+                    case OP_MOD: result = Value::makeFloat(std::fmod(x.as.f, y.as.f)); return true;
+                    default: break;
+                }
+                break;
+            }
+            case VAL_OBJECT:
+            {
+                if(op == OP_ADD && isObject(x, OBJ_STRING) && isObject(y, OBJ_STRING))
+                {
+                    auto s = new StringObject(static_cast<StringObject*>(x.as.object)->text + static_cast<StringObject*>(y.as.object)->text);
+                    track(s, top);
+                    result = Value::makeObject(s);
+                    return true;
+                }
+                break;
+            }
+            default: break;
+        }
+        message = std::string("operands of '") + operatorText(op) + "' must be numbers";
+        if(op == OP_ADD) message.append(" or strings");
+        return false;
+    }
+
+    bool VM::compare(Opcode op, const Value& x, const Value& y, bool& result)
+    {
+        if(x.type == y.type)
+        {
+            switch(x.type)
+            {
+                case VAL_INT: result = op == OP_LT ? x.as.i < y.as.i : x.as.i <= y.as.i; return true;
+                case VAL_DOUBLE: result = op == OP_LT ? x.as.d < y.as.d : x.as.d <= y.as.d; return true;
+                case VAL_FLOAT: result = op == OP_LT ? x.as.f < y.as.f : x.as.f <= y.as.f; return true;
+                case VAL_CHAR: result = op == OP_LT ? x.as.c < y.as.c : x.as.c <= y.as.c; return true;
+                case VAL_OBJECT:
+                {
+                    if(!isObject(x, OBJ_STRING) || !isObject(y, OBJ_STRING)) break;
+                    auto order = static_cast<StringObject*>(x.as.object)->text.compare(static_cast<StringObject*>(y.as.object)->text);
+                    result = op == OP_LT ? order < 0 : order <= 0;
+                    return true;
+                }
+                default: break;
+            }
+        }
+        message = std::string("operands of '") + operatorText(op) + "' cannot be ordered";
+        return false;
+    }
+
+    bool VM::callNative(uint16_t native, Value* args, Value& result, Value* top)
+    {
+        switch(native)
+        {
+            case NATIVE_PRINT:
+            {
+                auto text = valueToString(args[0], module);
+                text.push_back('\n');
+                fwrite(text.data(), 1, text.size(), out);
+                result = Value::makeVoid();
+                return true;
+            }
+            case NATIVE_ARRAY:
+            {
+                if(args[0].type != VAL_INT || args[0].as.i < 0)
+                {
+                    message = "array size must be a non-negative Int";
+                    return false;
+                }
+                auto array = new ArrayObject();
+                array->values.assign((size_t)args[0].as.i, args[1]);
+                track(array, top);
+                result = Value::makeObject(array);
+                return true;
+            }
+            case NATIVE_LENGTH:
+            {
+                if(isObject(args[0], OBJ_ARRAY)) result = Value::makeInt((int64_t)static_cast<ArrayObject*>(args[0].as.object)->values.size());
+                else if(isObject(args[0], OBJ_STRING)) result = Value::makeInt((int64_t)static_cast<StringObject*>(args[0].as.object)->text.size());
+                else
+                {
+                    message = "length of a value that is neither an array nor a string";
+                    return false;
+                }
+                return true;
+            }
+            case NATIVE_SQRT:
+            {
+                if(args[0].type == VAL_DOUBLE) result = Value::makeDouble(std::sqrt(args[0].as.d));
+                else if(args[0].type == VAL_FLOAT) result = Value::makeFloat(std::sqrt(args[0].as.f));
+                else
+                {
+                    message = "sqrt of a value that is not a Double or Float";
+                    return false;
+                }
+                return true;
+            }
+            case NATIVE_TO_DOUBLE:
+            {
+                switch(args[0].type)
+                {
+                    case VAL_INT: result = Value::makeDouble((double)args[0].as.i); return true;
+                    case VAL_FLOAT: result = Value::makeDouble(args[0].as.f); return true;
+                    case VAL_DOUBLE: result = args[0]; return true;
+                    default: message = "toDouble of a value that is not a number"; return false;
+                }
+            }
+            case NATIVE_TO_INT:
+            {
+                double d;
+                switch(args[0].type)
+                {
+                    case VAL_INT: result = args[0]; return true;
+                    case VAL_CHAR: result = Value::makeInt(args[0].as.c); return true;
+                    case VAL_FLOAT: d = args[0].as.f; break;
+                    case VAL_DOUBLE: d = args[0].as.d; break;
+                    default: message = "toInt of a value that is not a number"; return false;
+                }
+                //out of range conversions would be undefined
+                if(!(d > -9223372036854775808.0 && d < 9223372036854775808.0))
+                {
+                    message = "toInt of a number outside the range of Int";
+                    return false;
+                }
+                result = Value::makeInt((int64_t)d);
+                return true;
+            }
+        }
+        message = "unknown native function";
+        return false;
+    }
+
+    bool VM::run(Value& result)
+    {
+        if(!call(module.init, {}, result)) return false;
+        result = Value::makeVoid();
+        if(module.main >= 0) return call((uint32_t)module.main, {}, result);
+        return true;
+    }
+
+    bool VM::call(uint32_t function, const std::vector<Value>& args, Value& result)
+    {
+        if(function >= module.functions.size())
+        {
+            message = "call of an unknown function";
+            return false;
+        }
+        auto& f = module.functions[function];
+        if(args.size() != f.arity)
+        {
+            message = "call of " + f.name + " with the wrong number of arguments";
+            return false;
+        }
+        //slot 0 receives the result, as the register before a callee's window does
+        auto base = stack.get() + 1;
+        if(base + f.registers > stackEnd)
+        {
+            message = "stack overflow";
+            return false;
+        }
+        for(auto v = stackUsed; v < base + f.registers; v++) *v = Value::makeVoid();
+        if(base + f.registers > stackUsed) stackUsed = base + f.registers;
+        std::copy(args.begin(), args.end(), base);
+        frames.clear();
+        frames.reserve(maxFrames);
+        frames.push_back(CallFrame{&f, nullptr, base, 0});
+        return execute(result);
+    }
+
+    bool VM::execute(Value& result)
+    {
+        const Function* fn = frames.back().function;
+        Value* base = frames.back().base;
+        const Instruction* ip = fn->code.data();
+        const Value* constants = module.constants.data();
+        Instruction in;
+        std::string what;
+
+    #define TOP (base + fn->registers)
+    #define THROW(text) do { what = (text); goto fault; } while(0)
+    #define FAULT() do { what = message; goto fault; } while(0)
+
+    #ifdef PILAF_COMPUTED_GOTO
+        static const void* const labels[] = {
+            #define PILAF_OPCODE_LABEL(name) &&op_##name,
+            PILAF_OPCODES(PILAF_OPCODE_LABEL)
+            #undef PILAF_OPCODE_LABEL
+        };
+        #define CASE(name) op_##name:
+        #define DISPATCH() do { in = *ip++; goto *labels[in.op]; } while(0)
+        DISPATCH();
+    #else
+        #define CASE(name) case OP_##name:
+        #define DISPATCH() continue
+        for(;;)
+        {
+            in = *ip++;
+            switch(in.op)
+            {
+    #endif
+        CASE(LOADK)
+        {
+            base[in.a] = constants[in.b];
+            DISPATCH();
+        }
+        CASE(LOADVOID)
+        {
+            base[in.a] = Value::makeVoid();
+            DISPATCH();
+        }
+        CASE(MOVE)
+        {
+            base[in.a] = base[in.b];
+            DISPATCH();
+        }
+        CASE(GETGLOBAL)
+        {
+            base[in.a] = globals[in.b];
+            DISPATCH();
+        }
+        CASE(SETGLOBAL)
+        {
+            globals[in.b] = base[in.a];
+            DISPATCH();
+        }
+        CASE(FUNCTION)
+        {
+            base[in.a] = Value::makeFunction(in.b);
+            DISPATCH();
+        }
+        CASE(CLOSURE)
+        {
+            auto closure = new ClosureObject(in.b);
+            track(closure, TOP);
+            closure->captures.assign(base + in.c, base + in.c + module.functions[in.b].captures);
+            base[in.a] = Value::makeObject(closure);
+            DISPATCH();
+        }
+        CASE(LOCALCLOSURE)
+        {
+            auto slot = frames.back().closures + in.b;
+            if(slot >= localClosures.size()) localClosures.resize(slot + 1);
+            auto function = fn->closures[in.b];
+            auto& closure = localClosures[slot];
+            if(closure == nullptr) closure.reset(new ClosureObject(function));
+            closure->function = function;
+            closure->captures.assign(base + in.c, base + in.c + module.functions[function].captures);
+            base[in.a] = Value::makeObject(closure.get());
+            DISPATCH();
+        }
+    //the common operand types are handled inline, everything else by arithmetic()
+    #define ARITHMETIC(name, intOp, floatOp) \
+        CASE(name) \
+        { \
+            const Value& x = base[in.b]; \
+            const Value& y = base[in.c]; \
+            if(x.type == VAL_INT && y.type == VAL_INT) base[in.a] = Value::makeInt((int64_t)((uint64_t)x.as.i intOp (uint64_t)y.as.i)); \
+            else if(x.type == VAL_DOUBLE && y.type == VAL_DOUBLE) base[in.a] = Value::makeDouble(x.as.d floatOp y.as.d); \
+            else if(!arithmetic(OP_##name, x, y, base[in.a], TOP)) FAULT(); \
+            DISPATCH(); \
+        }
+        ARITHMETIC(ADD, +, +)
+        ARITHMETIC(SUB, -, -)
+        ARITHMETIC(MUL, *, *)
+    #undef ARITHMETIC
+        CASE(DIV)
+        CASE(MOD)
+        CASE(BAND)
+        CASE(BOR)
+        CASE(BXOR)
+        CASE(SHL)
+        CASE(SHR)
+        {
+            if(!arithmetic(in.op, base[in.b], base[in.c], base[in.a], TOP)) FAULT();
+            DISPATCH();
+        }
+        CASE(EQ)
+        {
+            base[in.a] = Value::makeBool(valuesEqual(base[in.b], base[in.c], 0));
+            DISPATCH();
+        }
+        CASE(NE)
+        {
+            base[in.a] = Value::makeBool(!valuesEqual(base[in.b], base[in.c], 0));
+            DISPATCH();
+        }
+        CASE(LT)
+        {
+            const Value& x = base[in.b];
+            const Value& y = base[in.c];
+            bool r;
+            if(x.type == VAL_INT && y.type == VAL_INT) r = x.as.i < y.as.i;
+            else if(x.type == VAL_DOUBLE && y.type == VAL_DOUBLE) r = x.as.d < y.as.d;
+            else if(!compare(OP_LT, x, y, r)) FAULT();
+            base[in.a] = Value::makeBool(r);
+            DISPATCH();
+        }
+        CASE(LE)
+        {
+            const Value& x = base[in.b];
+            const Value& y = base[in.c];
+            bool r;
+            if(x.type == VAL_INT && y.type == VAL_INT) r = x.as.i <= y.as.i;
+            else if(x.type == VAL_DOUBLE && y.type == VAL_DOUBLE) r = x.as.d <= y.as.d;
+            else if(!compare(OP_LE, x, y, r)) FAULT();
+            base[in.a] = Value::makeBool(r);
+            DISPATCH();
+        }
+        CASE(NEG)
+        {
+            const Value& x = base[in.b];
+            if(x.type == VAL_INT) base[in.a] = Value::makeInt((int64_t)(0 - (uint64_t)x.as.i));
+            else if(x.type == VAL_DOUBLE) base[in.a] = Value::makeDouble(-x.as.d);
+            else if(x.type == VAL_FLOAT) base[in.a] = Value::makeFloat(-x.as.f);
+            else THROW("operand of '-' must be a number");
+            DISPATCH();
+        }
+        CASE(NOT)
+        {
+            if(base[in.b].type != VAL_BOOL) THROW("operand of 'not' must be a Bool");
+            base[in.a] = Value::makeBool(!base[in.b].as.b);
+            DISPATCH();
+        }
+        CASE(JMP)
+        {
+            ip += jumpOffset(in);
+            DISPATCH();
+        }
+        CASE(JMPIF)
+        {
+            const Value& x = base[in.a];
+            if(x.type != VAL_BOOL) THROW("condition must be a Bool");
+            if(x.as.b) ip += jumpOffset(in);
+            DISPATCH();
+        }
+        CASE(JMPIFNOT)
+        {
+            const Value& x = base[in.a];
+            if(x.type != VAL_BOOL) THROW("condition must be a Bool");
+            if(!x.as.b) ip += jumpOffset(in);
+            DISPATCH();
+        }
+        CASE(SWITCH)
+        {
+            const Value& x = base[in.a];
+            int64_t key;
+            if(x.type == VAL_INT) key = x.as.i;
+            else if(x.type == VAL_CHAR) key = x.as.c;
+            else THROW("switch value must be an Int or Char");
+            auto& table = fn->tables[in.b];
+            auto k = (uint64_t)key - (uint64_t)table.low;
+            ip += k < table.offsets.size() ? table.offsets[k] : table.fallback;
+            DISPATCH();
+        }
+        CASE(CALLVALUE)
+        {
+            const Value& callee = base[in.b];
+            if(isObject(callee, OBJ_CLOSURE))
+            {
+                //the captured values follow the arguments in the callee's registers
+                auto closure = static_cast<ClosureObject*>(callee.as.object);
+                if(module.functions[closure->function].arity != in.c + closure->captures.size()) THROW("function value called with the wrong number of arguments");
+                Value* captures = base + in.a + 1 + in.c;
+                if(captures + closure->captures.size() > stackEnd) THROW("stack overflow");
+                for(; stackUsed < captures; stackUsed++) *stackUsed = Value::makeVoid();
+                std::copy(closure->captures.begin(), closure->captures.end(), captures);
+                if(captures + closure->captures.size() > stackUsed) stackUsed = captures + closure->captures.size();
+                in.b = (uint16_t)closure->function;
+            }
+            else
+            {
+                if(callee.type != VAL_FUNCTION) THROW("called value is not a function");
+                if(module.functions[callee.as.function].arity != in.c) THROW("function value called with the wrong number of arguments");
+                in.b = (uint16_t)callee.as.function;
+            }
+        }
+        //a function value continues as a direct call
+        CASE(CALL)
+        {
+            if(jitThreshold != 0 && ++jitCalls[in.b] >= jitThreshold)
+            {
+                auto ran = runCompiled(in.b, base + in.a);
+                if(ran > 0) DISPATCH();
+                if(ran < 0) return false;
+            }
+            const Function* callee = &module.functions[in.b];
+            Value* callBase = base + in.a + 1;
+            Value* callTop = callBase + callee->registers;
+            if(callTop > stackEnd || frames.size() == maxFrames) THROW("stack overflow");
+            //registers the stack has never reached hold garbage that the collector must not see
+            for(; stackUsed < callTop; stackUsed++) *stackUsed = Value::makeVoid();
+            frames.back().ip = ip;
+            frames.push_back(CallFrame{callee, nullptr, callBase, frames.back().closures + fn->closures.size()});
+            fn = callee;
+            base = callBase;
+            ip = callee->code.data();
+            DISPATCH();
+        }
+        CASE(CALLNATIVE)
+        {
+            if(!callNative(in.b, base + in.a + 1, base[in.a], TOP)) FAULT();
+            DISPATCH();
+        }
+        CASE(TAILCALL)
+        {
+            //the callee takes over the frame, so a chain of tail calls runs in constant stack
+            int ran = 0;
+            if(jitThreshold != 0 && ++jitCalls[in.b] >= jitThreshold) ran = runCompiled(in.b, base + in.a);
+            if(ran < 0) return false;
+            if(ran == 0)
+            {
+                const Function* callee = &module.functions[in.b];
+                Value* callTop = base + callee->registers;
+                if(callTop > stackEnd) THROW("stack overflow");
+                std::copy(base + in.a + 1, base + in.a + 1 + in.c, base);
+                for(; stackUsed < callTop; stackUsed++) *stackUsed = Value::makeVoid();
+                frames.back().function = callee;
+                fn = callee;
+                ip = callee->code.data();
+                DISPATCH();
+            }
+        }
+        //compiled code that ran a tail call left its result in the window, returned from there
+        CASE(RETURN)
+        {
+            base[-1] = base[in.a];
+            frames.pop_back();
+            if(frames.empty())
+            {
+                result = base[-1];
+                return true;
+            }
+            fn = frames.back().function;
+            base = frames.back().base;
+            ip = frames.back().ip;
+            DISPATCH();
+        }
+        CASE(RETURNVOID)
+        {
+            base[-1] = Value::makeVoid();
+            frames.pop_back();
+            if(frames.empty())
+            {
+                result = base[-1];
+                return true;
+            }
+            fn = frames.back().function;
+            base = frames.back().base;
+            ip = frames.back().ip;
+            DISPATCH();
+        }
+        CASE(RECORD)
+        {
+            auto record = new RecordObject(&module.layouts[in.b]);
+            track(record, TOP);
+            std::copy(base + in.c, base + in.c + record->fields.size(), record->fields.begin());
+            base[in.a] = Value::makeObject(record);
+            DISPATCH();
+        }
+        CASE(GETFIELD)
+        {
+            const Value& x = base[in.b];
+            if(!isObject(x, OBJ_RECORD)) THROW("field access on a value that is not a struct or tuple");
+            auto record = static_cast<RecordObject*>(x.as.object);
+            if(in.c >= record->fields.size()) THROW("field access out of range");
+            base[in.a] = record->fields[in.c];
+            DISPATCH();
+        }
+        CASE(GETFIELDNAMED)
+        {
+            const Value& x = base[in.b];
+            if(!isObject(x, OBJ_RECORD)) THROW("field access on a value that is not a struct");
+            auto record = static_cast<RecordObject*>(x.as.object);
+            auto& names = record->layout->names;
+            auto field = std::find(names.begin(), names.end(), (Symbol)constants[in.c].as.i);
+            if(field == names.end()) THROW("struct " + record->layout->name + " has no field " + symbolName((Symbol)constants[in.c].as.i));
+            base[in.a] = record->fields[field - names.begin()];
+            DISPATCH();
+        }
+        CASE(SETFIELD)
+        {
+            const Value& x = base[in.a];
+            if(!isObject(x, OBJ_RECORD)) THROW("field assignment on a value that is not a struct or tuple");
+            auto record = static_cast<RecordObject*>(x.as.object);
+            if(in.b >= record->fields.size()) THROW("field assignment out of range");
+            record->fields[in.b] = base[in.c];
+            DISPATCH();
+        }
+        CASE(SETFIELDNAMED)
+        {
+            const Value& x = base[in.a];
+            if(!isObject(x, OBJ_RECORD)) THROW("field assignment on a value that is not a struct");
+            auto record = static_cast<RecordObject*>(x.as.object);
+            auto& names = record->layout->names;
+            auto field = std::find(names.begin(), names.end(), (Symbol)constants[in.b].as.i);
+            if(field == names.end()) THROW("struct " + record->layout->name + " has no field " + symbolName((Symbol)constants[in.b].as.i));
+            record->fields[field - names.begin()] = base[in.c];
+            DISPATCH();
+        }
+        CASE(ARRAY)
+        {
+            auto array = new ArrayObject();
+            track(array, TOP);
+            array->values.assign(base + in.b, base + in.b + in.c);
+            base[in.a] = Value::makeObject(array);
+            DISPATCH();
+        }
+        CASE(GETINDEX)
+        {
+            const Value& x = base[in.b];
+            const Value& i = base[in.c];
+            if(i.type != VAL_INT) THROW("index must be an Int");
+            if(isObject(x, OBJ_ARRAY))
+            {
+                auto& values = static_cast<ArrayObject*>(x.as.object)->values;
+                if(i.as.i < 0 || (uint64_t)i.as.i >= values.size()) THROW("index " + std::to_string(i.as.i) + " out of bounds for an array of length " + std::to_string(values.size()));
+                base[in.a] = values[i.as.i];
+            }
+            else if(isObject(x, OBJ_STRING))
+            {
+                auto& text = static_cast<StringObject*>(x.as.object)->text;
+                if(i.as.i < 0 || (uint64_t)i.as.i >= text.size()) THROW("index " + std::to_string(i.as.i) + " out of bounds for a string of length " + std::to_string(text.size()));
+                base[in.a] = Value::makeChar((unsigned char)text[i.as.i]);
+            }
+            else THROW("indexed value is not an array");
+            DISPATCH();
+        }
+        CASE(SETINDEX)
+        {
+            const Value& x = base[in.a];
+            const Value& i = base[in.b];
+            if(i.type != VAL_INT) THROW("index must be an Int");
+            if(!isObject(x, OBJ_ARRAY)) THROW("indexed value is not an array");
+            auto& values = static_cast<ArrayObject*>(x.as.object)->values;
+            if(i.as.i < 0 || (uint64_t)i.as.i >= values.size()) THROW("index " + std::to_string(i.as.i) + " out of bounds for an array of length " + std::to_string(values.size()));
+            values[i.as.i] = base[in.c];
+            DISPATCH();
+        }
+        CASE(VARIANT)
+        {
+            auto layout = &module.layouts[in.b];
+            auto variant = new VariantObject(layout, in.c, layout->empty[in.c] ? Value::makeVoid() : base[in.a]);
+            track(variant, TOP);
+            base[in.a] = Value::makeObject(variant);
+            DISPATCH();
+        }
+        CASE(TAG)
+        {
+            if(!isObject(base[in.b], OBJ_VARIANT)) THROW("matched value is not a union");
+            base[in.a] = Value::makeInt(static_cast<VariantObject*>(base[in.b].as.object)->tag);
+            DISPATCH();
+        }
+        CASE(PAYLOAD)
+        {
+            if(!isObject(base[in.b], OBJ_VARIANT)) THROW("matched value is not a union");
+            base[in.a] = static_cast<VariantObject*>(base[in.b].as.object)->payload;
+            DISPATCH();
+        }
+    #ifndef PILAF_COMPUTED_GOTO
+                default: THROW("invalid instruction");
+            }
+        }
+    #endif
+    fault:
+        fail(fn, ip, what);
+        return false;
+
+    #undef CASE
+    #undef DISPATCH
+    #undef TOP
+    #undef THROW
+    #undef FAULT
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef vm_header
+#define vm_header
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "bytecode.h"
+
+namespace pilaf {
+    //index of the built-in function that a declaration without a body binds to, or -1.
+    //built-ins are print, array(n, value), length, sqrt, toDouble and toInt
+    int findNative(const std::string& name, size_t arity);
+
+    //"computed-goto" or "switch": how this build of the interpreter dispatches instructions.
+    //threaded dispatch is used wherever the compiler supports labels as values, unless
+    //PILAF_SWITCH_DISPATCH is defined
+    const char* dispatchMode();
+
+    class Jit;
+
+    //executes a module. registers live on one stack shared by all frames, and heap objects
+    //are freed by a mark-and-sweep collector whose roots are that stack and the globals
+    class VM {
+        struct CallFrame {
+            const Function* function;
+            //where the frame resumes once the function it called returns
+            const Instruction* ip;
+            Value* base;
+            //the frame's first slot in localClosures
+            size_t closures;
+        };
+
+        const Module& module;
+        FILE* out;
+        std::unique_ptr<Value[]> stack;
+        Value* stackEnd;
+        //every slot below this has been written, so the collector can read it
+        Value* stackUsed;
+        std::vector<CallFrame> frames;
+        std::vector<Value> globals;
+        Object* objects;
+        size_t objectCount;
+        size_t allocationCount;
+        //slots of the closures that frames make for themselves, allocated once and reused by every
+        //frame that is as deep in the stack
+        std::vector<std::unique_ptr<ClosureObject>> localClosures;
+        size_t nextCollection;
+        size_t collectionCount;
+        std::string message;
+        //functions are compiled to machine code once they have been called jitThreshold times
+        //while interpreted; a function that cannot be compiled has its count set so low it never
+        //gets there again
+        std::unique_ptr<Jit> jit;
+        uint32_t jitThreshold;
+        std::vector<int64_t> jitCalls;
+        size_t compiledCallCount;
+
+        bool execute(Value& result);
+        //called before every allocation; collects once enough objects were allocated since the last time
+        void track(Object* object, Value* top);
+        void collect(Value* top);
+        bool arithmetic(Opcode op, const Value& x, const Value& y, Value& result, Value* top);
+        bool compare(Opcode op, const Value& x, const Value& y, bool& result);
+        bool callNative(uint16_t native, Value* args, Value& result, Value* top);
+        void fail(const Function* function, const Instruction* ip, const std::string& what);
+        //runs a call through machine code: 1 when it did, 0 when the interpreter should run it
+        //instead, and -1 when it failed
+        int runCompiled(uint16_t function, Value* window);
+    public:
+        explicit VM(const Module& module, FILE* out = stdout);
+        ~VM();
+        VM(const VM&) = delete;
+        VM& operator=(const VM&) = delete;
+
+        //runs the top-level statements, then `main` if the module has one. `result` is main's
+        //result, or void without a main. on failure error() says what went wrong and where
+        bool run(Value& result);
+        //calls one of the module's functions. the top-level statements should have run first
+        bool call(uint32_t function, const std::vector<Value>& args, Value& result);
+        const std::string& error() const { return message; }
+        size_t collections() const { return collectionCount; }
+        //objects put in the collected heap so far
+        size_t allocations() const { return allocationCount; }
+        //compiles functions that qualify to machine code once they have been called `calls` times.
+        //0, the default, interprets everything. has no effect where the JIT is not supported or
+        //the module kept no IR
+        void setJitThreshold(uint32_t calls);
+        //calls the interpreter handed to machine code, including those that failed
+        size_t compiledCalls() const { return compiledCallCount; }
+    };
+}
+#endif
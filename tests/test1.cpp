@@ -1,4 +1,18 @@
+#include <filesystem>
+#include <fstream>
+#include <sys/wait.h>
 #include "semant.h"
+#include "kinds.h"
+#include "instances.h"
+#include "specialize.h"
+#include "typecheck.h"
+#include "constraints.h"
+#include "compiler.h"
+#include "optimize.h"
+#include "jit.h"
+#include "layout.h"
+#include "match.h"
+#include "vm.h"
 #define BOOST_TEST_MODULE pilaf_test
 #include <boost/test/included/unit_test.hpp>
 BOOST_AUTO_TEST_SUITE(lexical_test);
@@ -220,4 +234,1328 @@ BOOST_AUTO_TEST_CASE(parser_test_unions)
     //auto result = pilaf::parse("union Nbool { False, True } let x = True;");
     
 }
-BOOST_AUTO_TEST_SUITE_END();
\ No newline at end of file
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(interface_test);
+BOOST_AUTO_TEST_CASE(interface_test_roundtrip)
+{
+    auto dir = std::filesystem::temp_directory_path() / "pilaf-test-interfaces";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.interfaceCacheDir = dir.string();
+    const char* src = "module Lib { struct repr(C) Point { x: Int; y: Int; } fn first(x: Int, y: Double): Int { return x; } let v = 3; }\n"
+                      "let a = Lib.first(1, 2.0);";
+    auto cold = pilaf::analyze(src, options);
+    BOOST_REQUIRE(cold != nullptr);
+    BOOST_CHECK(std::static_pointer_cast<pilaf::ModuleDeclarationNode>(cold->declarations[0])->interface == nullptr);
+    BOOST_CHECK(std::filesystem::exists(dir / "Lib.pfi"));
+
+    auto warm = pilaf::analyze(src, options);
+    BOOST_REQUIRE(warm != nullptr);
+    auto md = std::static_pointer_cast<pilaf::ModuleDeclarationNode>(warm->declarations[0]);
+    BOOST_CHECK(md->interface != nullptr);
+    BOOST_REQUIRE(md->scope->structs.count("Point") == 1);
+    BOOST_CHECK(md->scope->structs.at("Point")->reprC);
+    BOOST_REQUIRE(md->scope->functions.count("first") == 1);
+    auto first = md->scope->functions.at("first");
+    BOOST_CHECK(first->body == nullptr);
+    BOOST_CHECK(pilaf::typeToString(pilaf::functionTypeFromFunction(first)) == "Int -> Double -> Int");
+    BOOST_CHECK(pilaf::typeToString(md->scope->variables.at("v")->identifiers.at("v")) == "Int");
+
+    //editing the module body invalidates its interface
+    const char* edited = "module Lib { fn first(x: Int): Int { return x; } }\nlet a = Lib.first(1);";
+    auto reparsed = pilaf::analyze(edited, options);
+    BOOST_REQUIRE(reparsed != nullptr);
+    BOOST_CHECK(std::static_pointer_cast<pilaf::ModuleDeclarationNode>(reparsed->declarations[0])->interface == nullptr);
+
+    //so does changing an operator declared around it
+    const char* ops = "infix ($) 2;\nmodule Ops { fn id(x: Int): Int { return x; } }\nlet b = Ops.id(1);";
+    BOOST_REQUIRE(pilaf::analyze(ops, options) != nullptr);
+    auto opsWarm = pilaf::analyze(ops, options);
+    BOOST_REQUIRE(opsWarm != nullptr);
+    BOOST_CHECK(std::static_pointer_cast<pilaf::ModuleDeclarationNode>(opsWarm->declarations[0])->interface != nullptr);
+    const char* opsEdited = "infix ($) 3;\nmodule Ops { fn id(x: Int): Int { return x; } }\nlet b = Ops.id(1);";
+    auto opsReparsed = pilaf::analyze(opsEdited, options);
+    BOOST_REQUIRE(opsReparsed != nullptr);
+    BOOST_CHECK(std::static_pointer_cast<pilaf::ModuleDeclarationNode>(opsReparsed->declarations[0])->interface == nullptr);
+
+    //a module that uses an outer declaration is never cached, since editing that declaration would not change its key
+    const char* outer = "struct Outer { x: Int; }\nmodule Uses { fn get(o: Outer): Int { return o.x; } }";
+    BOOST_REQUIRE(pilaf::analyze(outer, options) != nullptr);
+    BOOST_CHECK(!std::filesystem::exists(dir / "Uses.pfi"));
+    std::filesystem::remove_all(dir);
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(kind_test);
+BOOST_AUTO_TEST_CASE(kind_test_declarations)
+{
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    const char* src = "union Maybe a { Nothing, Just(a) }\n"
+                      "struct Pair a b { first: a; second: b; }\n"
+                      "struct Boxed { value: Maybe Int; }\n"
+                      "class Functor f { fn fmap(g: a -> b, x: f a): f b; }\n"
+                      "implement Functor Maybe { fn fmap(g: a -> b, x: Maybe a): Maybe b { return Nothing; } }\n"
+                      "let x = 1;";
+    auto program = pilaf::analyze(src, options);
+    BOOST_REQUIRE(program != nullptr);
+    auto maybe = program->globalScope->unions.at("Maybe")->kind;
+    auto pair = program->globalScope->structs.at("Pair")->kind;
+    auto functor = program->globalScope->classes.at("Functor")->kind;
+    auto star = pilaf::starKind();
+    BOOST_CHECK(pilaf::kindToString(maybe) == "* -> *");
+    BOOST_CHECK(pilaf::kindToString(pair) == "* -> * -> *");
+    BOOST_CHECK(program->globalScope->structs.at("Boxed")->kind == star);
+    //interned: structurally equal kinds share a pointer
+    BOOST_CHECK(maybe == functor);
+    BOOST_CHECK(pair == pilaf::arrowKind(star, pilaf::arrowKind(star, star)));
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(instance_test);
+BOOST_AUTO_TEST_CASE(instance_test_most_specific)
+{
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    const char* src = "struct List a { head: a; }\n"
+                      "class Show s { fn show(x: s): Int; }\n"
+                      "implement Show Int { fn show(x: Int): Int { return 1; } }\n"
+                      "implement Show List a { fn show(x: List a): Int { return 2; } }\n"
+                      "implement Show List Int { fn show(x: List Int): Int { return 3; } }\n"
+                      "let x = 1;";
+    auto program = pilaf::analyze(src, options);
+    BOOST_REQUIRE(program != nullptr);
+    auto scope = program->globalScope;
+    auto implOf = [&](size_t i) { return std::static_pointer_cast<pilaf::ClassImplementationNode>(program->declarations[i])->functions[0]; };
+    auto show = pilaf::intern("show");
+    auto intType = std::make_shared<pilaf::TyBasic>("Int");
+    auto list = std::make_shared<pilaf::TyBasic>("List");
+    auto listOf = [&](std::shared_ptr<pilaf::Ty> t) { return std::make_shared<pilaf::TyAppl>(list, std::vector<std::shared_ptr<pilaf::Ty>>{t}); };
+    BOOST_CHECK(pilaf::resolveMethod(scope, show, intType) == implOf(2));
+    BOOST_CHECK(pilaf::resolveMethod(scope, show, listOf(std::make_shared<pilaf::TyBasic>("Double"))) == implOf(3));
+    BOOST_CHECK(pilaf::resolveMethod(scope, show, listOf(intType)) == implOf(4));
+    BOOST_CHECK(pilaf::resolveMethod(scope, show, std::make_shared<pilaf::TyBasic>("Double")) == nullptr);
+}
+BOOST_AUTO_TEST_CASE(instance_test_overlap)
+{
+    //neither instance is more specific than the other, but both match Pair Int Int
+    const char* src = "struct Pair a b { first: a; second: b; }\n"
+                      "class Show s { fn show(x: s): Int; }\n"
+                      "implement Show Pair Int a { fn show(x: Pair Int a): Int { return 2; } }\n"
+                      "implement Show Pair a Int { fn show(x: Pair a Int): Int { return 3; } }";
+    BOOST_CHECK(pilaf::parse(src)->hadError);
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(specialize_test);
+BOOST_AUTO_TEST_CASE(specialize_test_direct_calls)
+{
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    const char* src = "struct List a { head: a; }\n"
+                      "class Show s { fn show(x: s): Int; }\n"
+                      "implement Show Int { fn show(x: Int): Int { return 1; } }\n"
+                      "implement Show List a { fn show(x: List a): Int { return 2; } }\n"
+                      "fn f(x: List Int): Int { return show(x); }\n"
+                      "fn g(x: List Double): Int { return show(x); }\n"
+                      "fn h(x: List Double): Int { return show(x); }\n"
+                      "fn k(x: Int): Int { return show(x); }\n"
+                      "fn poly(x: a): Int { return show(x); }\n"
+                      "let y = 1;";
+    auto program = pilaf::analyze(src, options);
+    BOOST_REQUIRE(program != nullptr);
+    auto callIn = [&](size_t i) {
+        auto fd = std::static_pointer_cast<pilaf::FunctionDeclarationNode>(program->declarations[i]);
+        auto ret = std::static_pointer_cast<pilaf::ReturnStatementNode>(std::static_pointer_cast<pilaf::BlockStatementNode>(fd->body)->declarations[0]);
+        return std::static_pointer_cast<pilaf::FunctionCallNode>(ret->returnExpr);
+    };
+    auto listImpl = std::static_pointer_cast<pilaf::ClassImplementationNode>(program->declarations[3])->functions[0];
+    auto intImpl = std::static_pointer_cast<pilaf::ClassImplementationNode>(program->declarations[2])->functions[0];
+    BOOST_REQUIRE(callIn(4)->target != nullptr);
+    BOOST_CHECK(callIn(4)->target->function == listImpl);
+    BOOST_CHECK(callIn(4)->target->name == "Show.show[List Int]");
+    BOOST_CHECK(pilaf::typeToString(callIn(4)->target->typeArguments.at(pilaf::intern("a"))) == "Int");
+    //the same (function, type arguments) pair shares one specialization
+    BOOST_REQUIRE(callIn(5)->target != nullptr);
+    BOOST_CHECK(callIn(5)->target == callIn(6)->target);
+    BOOST_CHECK(callIn(5)->target != callIn(4)->target);
+    BOOST_REQUIRE(callIn(7)->target != nullptr);
+    BOOST_CHECK(callIn(7)->target->function == intImpl);
+    //the instance is unknown inside a polymorphic function
+    BOOST_CHECK(callIn(8)->target == nullptr);
+    BOOST_CHECK(program->specializations.size() == 3);
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(check_test);
+BOOST_AUTO_TEST_CASE(check_test_annotations_need_no_constraints)
+{
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    const char* src = "struct Point { x: Int; y: Double; }\n"
+                      "fn f(a: Int, b: Double): Int {\n"
+                      "    let p: Point = Point { x: a, y: b };\n"
+                      "    let pair: (Int, Double) = (a, 2.5);\n"
+                      "    if(true) { return a; } else { return f(a, b); }\n"
+                      "}\n"
+                      "let g: Int -> Double -> Int = f;\n"
+                      "let r = f(1, 2.0);";
+    auto program = pilaf::analyze(src, options);
+    BOOST_REQUIRE(program != nullptr);
+    //only the unannotated `r` is left: its pattern and value variables are unified as they are
+    //generated, so the call is all the solver sees
+    BOOST_CHECK(program->constraintCount == 1);
+    BOOST_CHECK(program->constraintsEliminated == 1);
+    BOOST_CHECK(pilaf::typeToString(program->globalScope->variables.at("g")->identifiers.at("g")) == "Int -> Double -> Int");
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(constraint_test);
+BOOST_AUTO_TEST_CASE(constraint_test_elimination)
+{
+    pilaf::resetConstraints();
+    auto scope = std::make_shared<pilaf::ScopeNode>();
+    auto intType = std::make_shared<pilaf::TyBasic>("Int");
+    auto a = pilaf::newGenericType();
+    auto b = pilaf::newGenericType();
+    pilaf::constrain(scope, intType, std::make_shared<pilaf::TyBasic>("Int"));
+    pilaf::constrain(scope, a, b);
+    pilaf::constrain(scope, a, intType);
+    pilaf::constrain(scope, intType, b);
+    //the trivial pair and the variable pair never reach the scope
+    BOOST_CHECK(scope->constraints.size() == 2);
+    std::deque<std::pair<std::shared_ptr<pilaf::Ty>, std::shared_ptr<pilaf::Ty>>> substitutions;
+    auto constraints = pilaf::prepareConstraints(scope->constraints, substitutions);
+    //with `a` aliased to `b`, both remaining pairs say b == Int
+    BOOST_CHECK(constraints.size() == 1);
+    BOOST_CHECK(substitutions.size() == 1);
+    auto& stats = pilaf::constraintStats();
+    BOOST_CHECK(stats.trivial == 1 && stats.aliased == 1 && stats.duplicates == 1);
+    BOOST_CHECK(pilaf::typesEqual(pilaf::applySubstitutions(a, substitutions), b));
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(field_test);
+BOOST_AUTO_TEST_CASE(field_test_tables)
+{
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    const char* src = "struct Point { x: Int; y: Double; flag: Bool; }\n"
+                      "struct Pair a b { first: a; second: b; }\n"
+                      "struct Named { first: Int; }\n"
+                      "fn px(p: Point): Double { return p.y; }\n"
+                      "fn ps(p: Pair Int Double): Double { return p.second; }\n"
+                      "let s = Point { y: 2.0, flag: true, x: 1 };\n"
+                      "let t = s.y;\n"
+                      "let u = px(s);";
+    auto program = pilaf::analyze(src, options);
+    BOOST_REQUIRE(program != nullptr);
+    auto scope = program->globalScope;
+    auto point = scope->structs.at("Point");
+    auto y = point->field(pilaf::intern("y"));
+    BOOST_REQUIRE(y != nullptr);
+    BOOST_CHECK(y->index == 1);
+    BOOST_CHECK(pilaf::typeToString(y->type) == "Double");
+    BOOST_CHECK(point->field(pilaf::intern("z")) == nullptr);
+    //the reverse index lists every struct declaring a field
+    BOOST_CHECK(scope->fieldOwners.at(pilaf::intern("first")).size() == 2);
+    BOOST_CHECK(scope->fieldOwners.at(pilaf::intern("flag")).front() == point);
+    //`s` is not annotated, so its record is inferred from the field
+    auto access = std::static_pointer_cast<pilaf::VariableDeclarationNode>(program->declarations[6])->value;
+    BOOST_REQUIRE(access->nodeType == pilaf::NODE_FIELDCALL);
+    BOOST_CHECK(pilaf::typeToString(pilaf::typeInf(access, scope)) == "Double");
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(diagnostic_test);
+BOOST_AUTO_TEST_CASE(diagnostic_test_syntax)
+{
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.diagnostics = &engine;
+    const char* src = "let x = 1;\nlet y = ;";
+    BOOST_CHECK(pilaf::analyze(src, options) == nullptr);
+    BOOST_REQUIRE(engine.errorCount() == 1);
+    auto& d = engine.all().front();
+    BOOST_CHECK(d.code == pilaf::DIAG_SYNTAX);
+    BOOST_CHECK(d.begin == src + 19);
+}
+BOOST_AUTO_TEST_CASE(diagnostic_test_render)
+{
+    const char* src = "let a = 1;\nlet b = a.nope;\nlet c = a.nope;";
+    pilaf::DiagnosticEngine engine(src);
+    //reported out of order, with one repeat and one without a location
+    engine.report(pilaf::DIAG_UNKNOWN_FIELD, pilaf::SEVERITY_ERROR, src + 37, src + 41, "unknown field!");
+    engine.report(pilaf::DIAG_UNKNOWN_NAME, pilaf::SEVERITY_ERROR, nullptr, nullptr, "no location!");
+    engine.report(pilaf::DIAG_UNKNOWN_FIELD, pilaf::SEVERITY_ERROR, src + 21, src + 25, "unknown field!");
+    engine.report(pilaf::DIAG_UNKNOWN_FIELD, pilaf::SEVERITY_ERROR, src + 21, src + 25, "unknown field!");
+    BOOST_CHECK(engine.errorCount() == 4);
+    auto out = tmpfile();
+    BOOST_REQUIRE(out != nullptr);
+    BOOST_CHECK(engine.render(out, pilaf::DIAGNOSTICS_JSON, 2) == 2);
+    std::string json(1024, '\0');
+    rewind(out);
+    json.resize(fread(&json[0], 1, json.size(), out));
+    fclose(out);
+    BOOST_CHECK(json == "{\"diagnostics\":["
+                        "{\"code\":\"E0004\",\"severity\":\"error\",\"line\":2,\"column\":11,\"length\":4,\"message\":\"unknown field!\"},"
+                        "{\"code\":\"E0004\",\"severity\":\"error\",\"line\":3,\"column\":11,\"length\":4,\"message\":\"unknown field!\"}"
+                        "],\"omitted\":1}\n");
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(recovery_test);
+BOOST_AUTO_TEST_CASE(recovery_test_independent_errors)
+{
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.diagnostics = &engine;
+    const char* src = "let x = ;\n"
+                      "struct Point { x: Int; y: Double; }\n"
+                      "let p = Point { x: 1, y: 2.0 };\n"
+                      "let q = p.z;\n"
+                      "fn pick(x, y) { let z = x; z = y; return z; }\n"
+                      "let a = pick(1, 2.0);\n"
+                      "let c = (1 + ;\n"
+                      "let d = p.y;";
+    BOOST_CHECK(pilaf::analyze(src, options) == nullptr);
+    //both syntax errors, the unknown field and the conflict in the solver, from one compile
+    BOOST_REQUIRE(engine.errorCount() == 4);
+    std::vector<pilaf::DiagnosticCode> codes;
+    for(auto& d : engine.all()) codes.push_back(d.code);
+    std::sort(codes.begin(), codes.end());
+    BOOST_CHECK(codes == std::vector<pilaf::DiagnosticCode>({pilaf::DIAG_SYNTAX, pilaf::DIAG_SYNTAX, pilaf::DIAG_TYPE_MISMATCH, pilaf::DIAG_UNKNOWN_FIELD}));
+    //the declarations that failed to parse are kept as error nodes
+    auto program = pilaf::parse(src, options);
+    BOOST_REQUIRE(program->declarations.size() == 8);
+    BOOST_CHECK(program->declarations[0]->nodeType == pilaf::NODE_ERROR);
+    BOOST_CHECK(program->declarations[6]->nodeType == pilaf::NODE_ERROR);
+    BOOST_CHECK(program->declarations[7]->nodeType == pilaf::NODE_VARIABLEDECL);
+}
+BOOST_AUTO_TEST_CASE(recovery_test_poisoned_solve)
+{
+    pilaf::DiagnosticEngine engine;
+    pilaf::setDiagnostics(&engine);
+    pilaf::clearErrors();
+    auto basic = [](const char* name) { return std::make_shared<pilaf::TyBasic>(name); };
+    auto tuple = [](std::shared_ptr<pilaf::Ty> a, std::shared_ptr<pilaf::Ty> b) { return std::make_shared<pilaf::TyTuple>(std::vector<std::shared_ptr<pilaf::Ty>>{a, b}); };
+    auto p = pilaf::newGenericType();
+    auto q = pilaf::newGenericType();
+    auto r = pilaf::newGenericType();
+    std::deque<std::pair<std::shared_ptr<pilaf::Ty>, std::shared_ptr<pilaf::Ty>>> constraints;
+    //Int == Double fails, taking p and q with it
+    constraints.emplace_back(tuple(p, basic("Int")), tuple(q, basic("Double")));
+    constraints.emplace_back(p, basic("Bool"));
+    constraints.emplace_back(r, basic("Bool"));
+    auto substitutions = pilaf::resolveConstraints(constraints);
+    pilaf::setDiagnostics(nullptr);
+    BOOST_CHECK(pilaf::hadError());
+    //the poisoned p == Bool is not reported again
+    BOOST_CHECK(engine.errorCount() == 1);
+    BOOST_CHECK(pilaf::isErrorType(pilaf::applySubstitutions(p, substitutions)));
+    BOOST_CHECK(pilaf::isErrorType(pilaf::applySubstitutions(q, substitutions)));
+    BOOST_CHECK(pilaf::typesEqual(pilaf::applySubstitutions(r, substitutions), basic("Bool")));
+    pilaf::clearErrors();
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(error_flag_test);
+BOOST_AUTO_TEST_CASE(error_flag_test_children)
+{
+    //every child that used to sit behind `x ? ... : false || ...` is checked
+    auto ok = [] { return std::make_shared<pilaf::PlaceholderNode>(); };
+    auto bad = [] { return std::make_shared<pilaf::ErrorNode>(); };
+    pilaf::Token op{pilaf::TokenTypes::OPERATOR, "+", 1, 1};
+    BOOST_CHECK(!std::make_shared<pilaf::IfStatementNode>(ok(), ok(), ok())->hasError());
+    BOOST_CHECK(std::make_shared<pilaf::IfStatementNode>(ok(), bad(), nullptr)->hasError());
+    BOOST_CHECK(std::make_shared<pilaf::IfStatementNode>(ok(), ok(), bad())->hasError());
+    BOOST_CHECK(std::make_shared<pilaf::WhileStatementNode>(ok(), bad())->hasError());
+    BOOST_CHECK(std::make_shared<pilaf::ForStatementNode>(ok(), bad(), nullptr, ok())->hasError());
+    BOOST_CHECK(std::make_shared<pilaf::ForStatementNode>(ok(), ok(), bad(), ok())->hasError());
+    BOOST_CHECK(std::make_shared<pilaf::ForStatementNode>(ok(), ok(), ok(), bad())->hasError());
+    BOOST_CHECK(std::make_shared<pilaf::CaseNode>(ok(), bad(), nullptr)->hasError());
+    BOOST_CHECK(std::make_shared<pilaf::ArrayIndexNode>(ok(), bad())->hasError());
+    BOOST_CHECK(std::make_shared<pilaf::AssignmentNode>(ok(), bad())->hasError());
+    BOOST_CHECK(std::make_shared<pilaf::BinaryNode>(ok(), op, bad())->hasError());
+    BOOST_CHECK(!std::make_shared<pilaf::BinaryNode>(ok(), op, ok())->hasError());
+}
+BOOST_AUTO_TEST_CASE(error_flag_test_parsed)
+{
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.diagnostics = &engine;
+    auto program = pilaf::parse("fn f(x: Int): Int { if(x) { return 1; } else { let y = ; } return x; }\n"
+                                "fn g(x: Int): Int { return x; }", options);
+    BOOST_REQUIRE(program->declarations.size() == 2);
+    //the error sits in the else branch, three levels below the function
+    BOOST_CHECK(program->declarations[0]->hasError());
+    BOOST_CHECK(!program->declarations[1]->hasError());
+    BOOST_CHECK(program->hasError());
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(nesting_test);
+BOOST_AUTO_TEST_CASE(nesting_test_limit)
+{
+    auto nested = [](size_t depth)
+    {
+        return "fn f(x: Int): Int { return " + std::string(depth, '(') + "x" + std::string(depth, ')') + "; }";
+    };
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.diagnostics = &engine;
+    auto shallow = nested(200);
+    pilaf::parse(shallow.c_str(), options);
+    BOOST_CHECK(engine.errorCount() == 0);
+    //far deeper than the stack could take if the parser recursed all the way down
+    auto deep = nested(1000000);
+    auto program = pilaf::parse(deep.c_str(), options);
+    BOOST_REQUIRE(program != nullptr);
+    BOOST_CHECK(program->hasError());
+    BOOST_REQUIRE(!engine.all().empty());
+    BOOST_CHECK(engine.all().front().code == pilaf::DIAG_NESTING_TOO_DEEP);
+}
+BOOST_AUTO_TEST_CASE(nesting_test_long_chains)
+{
+    //a flat operator chain is as tall as it is long, but it is not nesting and is not limited
+    std::string src = "infix (+) 6;\nfn main(): Int { let x = 1";
+    for(int i = 1; i < 100000; i++) src.append(" + 1");
+    src.append("; return x; }");
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.diagnostics = &engine;
+    auto module = pilaf::compileBytecode(src, options);
+    BOOST_REQUIRE(module != nullptr);
+    BOOST_CHECK(engine.errorCount() == 0);
+    pilaf::VM vm(*module);
+    pilaf::Value result;
+    BOOST_REQUIRE(vm.run(result));
+    BOOST_CHECK_EQUAL(pilaf::valueToString(result, *module), "100000");
+}
+BOOST_AUTO_TEST_CASE(nesting_test_deep_types)
+{
+    //types built by inference are not bounded by the source, so none of these may recurse
+    const int depth = 200000;
+    auto chain = [&](std::shared_ptr<pilaf::Ty> leaf)
+    {
+        std::shared_ptr<pilaf::Ty> t = leaf;
+        for(int i = 0; i < depth; i++) t = std::make_shared<pilaf::TyFunc>(leaf, t);
+        return t;
+    };
+    auto a = chain(std::make_shared<pilaf::TyBasic>("Int"));
+    auto b = chain(std::make_shared<pilaf::TyBasic>("Int"));
+    auto c = chain(std::make_shared<pilaf::TyBasic>("Bool"));
+    BOOST_CHECK(pilaf::typesEqual(a, b));
+    BOOST_CHECK(!pilaf::typesEqual(a, c));
+    BOOST_CHECK(pilaf::typeToString(a).size() == 7 * depth + 3);
+    pilaf::TypeVarMap map;
+    auto quantified = chain(std::make_shared<pilaf::TyVar>("a"));
+    auto instantiated = pilaf::generic(quantified, map);
+    BOOST_CHECK(instantiated != quantified);
+    BOOST_CHECK(pilaf::generic(a, map) == a);
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(lazy_test);
+BOOST_AUTO_TEST_CASE(lazy_test_deferred_bodies)
+{
+    pilaf::CompileOptions options;
+    options.lazyBodies = true;
+    auto program = pilaf::parse("fn f(x: Int): Int { let y = x; return y; }\nfn g(x: Int): Int;", options);
+    BOOST_REQUIRE(program->declarations.size() == 2);
+    auto f = std::static_pointer_cast<pilaf::FunctionDeclarationNode>(program->declarations[0]);
+    auto g = std::static_pointer_cast<pilaf::FunctionDeclarationNode>(program->declarations[1]);
+    BOOST_CHECK(f->body == nullptr && f->deferred != nullptr);
+    BOOST_CHECK(g->body == nullptr && g->deferred == nullptr);
+    auto body = pilaf::functionBody(*f);
+    BOOST_REQUIRE(body != nullptr);
+    BOOST_CHECK(body->nodeType == pilaf::NODE_BLOCK);
+    BOOST_CHECK(f->deferred == nullptr && f->body == body);
+    //parameters are bound in the body's scope, as in an eager parse
+    auto block = std::static_pointer_cast<pilaf::BlockStatementNode>(body);
+    BOOST_CHECK(block->scope->variables.count("x") == 1);
+    BOOST_CHECK(block->declarations.size() == 2);
+    BOOST_CHECK(pilaf::functionBody(*g) == nullptr);
+}
+BOOST_AUTO_TEST_CASE(lazy_test_errors)
+{
+    const char* src = "fn f(x: Int): Int { let y = ; return x; }\nfn g(x: Int): Int { return x; }\nfn g(x: Int): Int { return x; }";
+    pilaf::DiagnosticEngine lazyEngine;
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.lazyBodies = true;
+    options.diagnostics = &lazyEngine;
+    BOOST_CHECK(pilaf::analyze(src, options) == nullptr);
+    //the redefinition is found while skipping, the syntax error once f's body is needed
+    BOOST_REQUIRE(lazyEngine.errorCount() == 2);
+
+    //checking signatures never parses the broken body
+    pilaf::DiagnosticEngine signatureEngine;
+    options.signaturesOnly = true;
+    options.diagnostics = &signatureEngine;
+    BOOST_CHECK(pilaf::analyze(src, options) == nullptr);
+    BOOST_REQUIRE(signatureEngine.errorCount() == 1);
+    BOOST_CHECK(signatureEngine.all().front().code == pilaf::DIAG_SYNTAX);
+    BOOST_CHECK(pilaf::analyze("fn f(x: Int): Int { let y = ; return x; }", options) != nullptr);
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(parallel_test);
+static std::string parallelSource(const char* middle, const char* last)
+{
+    std::string src;
+    for(int i = 0; i < 3000; i++)
+    {
+        auto n = std::to_string(i);
+        src.append("struct S").append(n).append(" { x: Int; }\nfn f").append(n).append("(x: Int, y): Int { let z = x; return z; }\n");
+        if(i == 1500) src.append(middle);
+    }
+    return src.append(last);
+}
+BOOST_AUTO_TEST_CASE(parallel_test_matches_sequential)
+{
+    auto src = parallelSource("infix ($) 2;\n", "fn g(a, b) { return a $ b; }\n");
+    pilaf::CompileOptions options;
+    options.parseThreads = 1;
+    auto sequential = pilaf::parse(src.c_str(), options);
+    options.parseThreads = 4;
+    auto parallel = pilaf::parse(src.c_str(), options);
+    BOOST_CHECK(!sequential->hadError && !parallel->hadError);
+    BOOST_CHECK(sequential->parseThreads == 1 && parallel->parseThreads == 4);
+    BOOST_REQUIRE(sequential->declarations.size() == parallel->declarations.size());
+    for(size_t i = 0; i < sequential->declarations.size(); i++)
+    {
+        BOOST_CHECK(sequential->declarations[i]->nodeType == parallel->declarations[i]->nodeType);
+        BOOST_CHECK(sequential->declarations[i]->start == parallel->declarations[i]->start);
+    }
+    auto& a = *sequential->globalScope;
+    auto& b = *parallel->globalScope;
+    BOOST_CHECK(a.functions.size() == b.functions.size() && a.structs.size() == b.structs.size());
+    BOOST_CHECK(a.namespaces.size() == b.namespaces.size() && a.fieldOwners.at(pilaf::intern("x")).size() == b.fieldOwners.at(pilaf::intern("x")).size());
+    BOOST_CHECK(b.opRules.count("($)") == 1);
+    BOOST_REQUIRE(a.childScopes.size() == b.childScopes.size());
+    for(auto& child : b.childScopes) BOOST_CHECK(child.lock()->parentScope == parallel->globalScope);
+    //generic variables get names of their own, in source order
+    auto first = std::static_pointer_cast<pilaf::TyVar>(b.functions.at("f0")->params[1].type);
+    auto second = std::static_pointer_cast<pilaf::TyVar>(b.functions.at("f1")->params[1].type);
+    BOOST_CHECK(first->var != "'" && second->var != "'" && first->var != second->var);
+}
+BOOST_AUTO_TEST_CASE(parallel_test_errors)
+{
+    //an operator used before it is declared and a function redefined across the source are reported
+    //exactly as a sequential parse reports them
+    auto src = parallelSource("fn h(a, b) { return a $ b; }\ninfix ($) 2;\n", "fn f0(x: Int): Int { return x; }\n");
+    pilaf::DiagnosticEngine sequentialEngine;
+    pilaf::DiagnosticEngine parallelEngine;
+    pilaf::CompileOptions options;
+    options.parseThreads = 1;
+    options.diagnostics = &sequentialEngine;
+    auto sequential = pilaf::parse(src.c_str(), options);
+    options.parseThreads = 4;
+    options.diagnostics = &parallelEngine;
+    auto parallel = pilaf::parse(src.c_str(), options);
+    BOOST_CHECK(sequential->hadError && parallel->hadError);
+    BOOST_REQUIRE(sequentialEngine.errorCount() == 2);
+    BOOST_REQUIRE(parallelEngine.errorCount() == sequentialEngine.errorCount());
+    for(size_t i = 0; i < sequentialEngine.all().size(); i++)
+    {
+        BOOST_CHECK(sequentialEngine.all()[i].code == parallelEngine.all()[i].code);
+        BOOST_CHECK(sequentialEngine.all()[i].begin == parallelEngine.all()[i].begin);
+    }
+}
+BOOST_AUTO_TEST_CASE(parallel_test_cached_modules)
+{
+    //workers decode cached interfaces while other workers do the same
+    auto dir = std::filesystem::temp_directory_path() / "pilaf-test-parallel-interfaces";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::string src;
+    for(int i = 0; i < 3000; i++)
+    {
+        auto n = std::to_string(i);
+        src.append("struct S").append(n).append(" { x: Int; }\n");
+        //spread out, so that they fall into different ranges
+        if(i % 375 == 0) src.append("module M").append(n).append(" { struct Box a { v: a; } union Maybe a { Nothing, Just(a) } fn id(x: Int): Int { return x; } }\n");
+    }
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.interfaceCacheDir = dir.string();
+    options.parseThreads = 1;
+    BOOST_REQUIRE(pilaf::analyze(src.c_str(), options) != nullptr);
+    options.parseThreads = 4;
+    auto parallel = pilaf::parse(src.c_str(), options);
+    BOOST_CHECK(!parallel->hadError);
+    BOOST_CHECK(parallel->parseThreads == 4);
+    size_t loaded = 0;
+    for(auto& dec : parallel->declarations)
+    {
+        if(dec->nodeType == pilaf::NODE_MODULE && std::static_pointer_cast<pilaf::ModuleDeclarationNode>(dec)->interface != nullptr) loaded++;
+    }
+    BOOST_CHECK(loaded == 8);
+    std::filesystem::remove_all(dir);
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(vm_test);
+static const char* vmOperators = "infix (+) 6; infix (-) 6; infix (*) 7; infix (/) 7; infix (<) 4; infix (==) 3;\n";
+//runs `src` and renders main's result, or the runtime error
+static std::string runProgram(const std::string& body)
+{
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.diagnostics = &engine;
+    auto module = pilaf::compileBytecode(vmOperators + body, options);
+    if(module == nullptr) return "(compile failed)";
+    pilaf::VM vm(*module);
+    pilaf::Value result;
+    if(!vm.run(result)) return vm.error();
+    return pilaf::valueToString(result, *module);
+}
+BOOST_AUTO_TEST_CASE(vm_test_functions)
+{
+    BOOST_CHECK_EQUAL(runProgram("fn fib(n: Int): Int {\n    if (n < 2) return n;\n    return fib(n - 1) + fib(n - 2);\n}\nfn main(): Int { return fib(20); }"), "6765");
+    //top-level statements run before main
+    BOOST_CHECK_EQUAL(runProgram("let base = 40;\nfn main(): Int { return base + 2; }"), "42");
+    BOOST_CHECK_EQUAL(runProgram("fn twice(f: Int -> Int, x: Int): Int { return f(f(x)); }\nfn inc(x: Int): Int { return x + 1; }\nfn main(): Int { return twice(inc, 1); }"), "3");
+}
+BOOST_AUTO_TEST_CASE(vm_test_loops)
+{
+    BOOST_CHECK_EQUAL(runProgram("fn main(): Int {\n    let total = 0;\n    for (let i = 0; i < 10; i = i + 1) { total = total + i; }\n    let j = 0;\n    while (j < 5) { j = j + 1; total = total + j; }\n    return total;\n}"), "60");
+    BOOST_CHECK_EQUAL(runProgram("fn main(): Int {\n    let i = 0;\n    while (true) { i = i + 1; if (i == 7) break; }\n    return i;\n}"), "7");
+}
+BOOST_AUTO_TEST_CASE(vm_test_aggregates)
+{
+    BOOST_CHECK_EQUAL(runProgram("struct Point { x: Double; y: Double; }\nfn main(): Point {\n    let p = Point { y: 2.0, x: 1.0 };\n    p.x = p.x + p.y;\n    return p;\n}"), "Point { x: 3.0, y: 2.0 }");
+    BOOST_CHECK_EQUAL(runProgram("fn main(): Int {\n    let a = [1, 2, 3];\n    a[0] = a[1] * a[2];\n    return a[0];\n}"), "6");
+    BOOST_CHECK_EQUAL(runProgram("fn main() {\n    let t = (1, 2.5);\n    return t;\n}"), "(1, 2.5)");
+}
+BOOST_AUTO_TEST_CASE(vm_test_unions)
+{
+    const char* shapes = "union Shape { Circle(Double), Square(Double), Empty }\n"
+        "fn area(s: Shape): Double {\n    switch (s) {\n        case Circle(r): return r * r * 3.0;\n        case Square(w): return w * w;\n        case Empty: return 0.0;\n    }\n}\n";
+    BOOST_CHECK_EQUAL(runProgram(std::string(shapes) + "fn main(): Double { return area(Circle(2.0)) + area(Square(3.0)) + area(Empty); }"), "21.0");
+    BOOST_CHECK_EQUAL(runProgram(std::string(shapes) + "fn main(): Shape { return Square(1.5); }"), "Square(1.5)");
+}
+BOOST_AUTO_TEST_CASE(vm_test_errors)
+{
+    //runtime errors name the line and function they happened in
+    BOOST_CHECK_EQUAL(runProgram("fn div(a: Int, b: Int): Int {\n    return a / b;\n}\nfn main(): Int { return div(1, 0); }"), "[line 3] runtime error in div: integer division by zero");
+    BOOST_CHECK_EQUAL(runProgram("fn f(n: Int): Int { return f(n + 1) + 1; }\nfn main(): Int { return f(0); }"), "[line 2] runtime error in f: stack overflow");
+    //what the backend cannot express yet is a compile error rather than a wrong program
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.diagnostics = &engine;
+    BOOST_CHECK(pilaf::compileBytecode("infix (+) 6;\nfn add(x: Int, y: Int): Int { return x + y; }\nlet inc = add(1, _);", options) == nullptr);
+    BOOST_REQUIRE(engine.errorCount() == 1);
+    BOOST_CHECK(engine.all().front().code == pilaf::DIAG_UNSUPPORTED);
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(ir_test);
+//lowers `body` and returns its dump, or why it could not be lowered
+static std::string lowerProgramText(const std::string& body, std::shared_ptr<pilaf::IrModule>* lowered = nullptr)
+{
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.diagnostics = &engine;
+    auto module = pilaf::compileIr(vm_test::vmOperators + body, options);
+    if(module == nullptr) return "(lowering failed)";
+    if(lowered != nullptr) *lowered = module;
+    char* text = nullptr;
+    size_t size = 0;
+    FILE* out = open_memstream(&text, &size);
+    pilaf::dumpIr(*module, out);
+    fclose(out);
+    std::string result(text, size);
+    free(text);
+    return result;
+}
+BOOST_AUTO_TEST_CASE(ir_test_dump)
+{
+    auto text = lowerProgramText("fn fib(n: Int): Int {\n    if (n < 2) return n;\n    return fib(n - 1) + fib(n - 2);\n}");
+    BOOST_CHECK(text.find("fn fib(Int): Int\nb0:\n    %0: Int = param 0\n    %1: Int = const 2\n    %2: Bool = lt %0, %1\n    branch %2, b1, b2\n") != std::string::npos);
+    BOOST_CHECK(text.find("%7: Int = call fib(%6)") != std::string::npos);
+}
+BOOST_AUTO_TEST_CASE(ir_test_ssa)
+{
+    //variables assigned in a loop meet in phis at its header, and nowhere else
+    std::shared_ptr<pilaf::IrModule> module;
+    lowerProgramText("fn sum(n: Int): Int {\n    let total = 0;\n    for (let i = 0; i < n; i = i + 1) { total = total + i; }\n    return total;\n}", &module);
+    BOOST_REQUIRE(module != nullptr);
+    auto& sum = module->functions[1];
+    BOOST_CHECK_EQUAL(sum.name, "sum");
+    size_t phis = 0;
+    for(auto& block : sum.blocks)
+    {
+        for(auto i : block.instructions) if(sum.instructions[i].op == pilaf::IR_PHI) phis++;
+    }
+    BOOST_CHECK_EQUAL(phis, 2);
+    //a variable that is only read in the loop needs none
+    lowerProgramText("fn f(n: Int): Int {\n    let k = 3;\n    let i = 0;\n    while (i < n) { i = i + k; }\n    return k;\n}", &module);
+    BOOST_REQUIRE(module != nullptr);
+    phis = 0;
+    auto& f = module->functions[1];
+    for(auto& block : f.blocks)
+    {
+        for(auto i : block.instructions) if(f.instructions[i].op == pilaf::IR_PHI) phis++;
+    }
+    BOOST_CHECK_EQUAL(phis, 1);
+}
+BOOST_AUTO_TEST_CASE(ir_test_programs)
+{
+    //everything the interpreter runs lowers to IR that verifies
+    const char* programs[] = {
+        "let base = 40;\nfn main(): Int { return base + 2; }",
+        "fn twice(f: Int -> Int, x: Int): Int { return f(f(x)); }\nfn inc(x: Int): Int { return x + 1; }\nfn main(): Int { return twice(inc, 1); }",
+        "fn main(): Int {\n    let i = 0;\n    while (true) { i = i + 1; if (i == 7) break; }\n    return i;\n}",
+        "struct Point { x: Double; y: Double; }\nfn main(): Point {\n    let p = Point { y: 2.0, x: 1.0 };\n    p.x = p.x + p.y;\n    return p;\n}",
+        "fn main(): Int {\n    let a = [1, 2, 3];\n    a[0] = a[1] * a[2];\n    return a[0];\n}",
+        "fn main() {\n    let t = (1, 2.5);\n    return t;\n}",
+        "union Shape { Circle(Double), Square(Double), Empty }\nfn area(s: Shape): Double {\n    switch (s) {\n        case Circle(r): return r * r * 3.0;\n        case Square(w): return w * w;\n        case Empty: return 0.0;\n    }\n}\nfn main(): Double { return area(Circle(2.0)); }",
+    };
+    for(auto program : programs)
+    {
+        std::shared_ptr<pilaf::IrModule> module;
+        BOOST_CHECK(lowerProgramText(program, &module) != "(lowering failed)");
+        if(module != nullptr) BOOST_CHECK(module->main != pilaf::irNone);
+    }
+    BOOST_CHECK_EQUAL(lowerProgramText("fn add(x: Int, y: Int): Int { return x + y; }\nlet inc = add(1, _);"), "(lowering failed)");
+}
+BOOST_AUTO_TEST_CASE(ir_test_verifier)
+{
+    std::shared_ptr<pilaf::IrModule> module;
+    lowerProgramText("fn f(x: Int): Int {\n    if (x < 0) return 0;\n    return x;\n}", &module);
+    BOOST_REQUIRE(module != nullptr);
+    std::string error;
+    BOOST_CHECK(pilaf::verifyIr(*module, error));
+    //a use that its definition does not dominate
+    auto broken = *module;
+    auto& f = broken.functions[1];
+    auto& ret = f.instructions[f.blocks[2].instructions.back()];
+    BOOST_REQUIRE(ret.op == pilaf::IR_RETURN);
+    ret.a = f.blocks[1].instructions.front();
+    BOOST_CHECK(!pilaf::verifyIr(broken, error));
+    BOOST_CHECK(!error.empty());
+    //a block without a terminator
+    broken = *module;
+    broken.functions[1].blocks[1].instructions.pop_back();
+    BOOST_CHECK(!pilaf::verifyIr(broken, error));
+    BOOST_CHECK_EQUAL(sizeof(pilaf::IrInstruction), 20);
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(opt_test);
+//runs `body` with its IR optimized at `level` and renders main's result, or the runtime error
+static std::string runOptimized(const std::string& body, int level)
+{
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.diagnostics = &engine;
+    options.optLevel = level;
+    auto module = pilaf::compileBytecode(vm_test::vmOperators + body, options);
+    if(module == nullptr) return "(compile failed)";
+    pilaf::VM vm(*module);
+    pilaf::Value result;
+    if(!vm.run(result)) return vm.error();
+    return pilaf::valueToString(result, *module);
+}
+static std::shared_ptr<pilaf::IrModule> optimized(const std::string& body, int level)
+{
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.diagnostics = &engine;
+    options.optLevel = level;
+    return pilaf::compileIr(vm_test::vmOperators + body, options);
+}
+static size_t count(const pilaf::IrFunction& f, pilaf::IrOpcode op)
+{
+    size_t n = 0;
+    for(auto& block : f.blocks)
+    {
+        for(auto i : block.instructions) if(f.instructions[i].op == op) n++;
+    }
+    return n;
+}
+BOOST_AUTO_TEST_CASE(opt_test_programs)
+{
+    //every level computes what the unoptimized program computes, errors and their lines included
+    const std::pair<const char*, const char*> programs[] = {
+        {"fn fib(n: Int): Int {\n    if (n < 2) return n;\n    return fib(n - 1) + fib(n - 2);\n}\nfn main(): Int { return fib(20); }", "6765"},
+        {"fn twice(f: Int -> Int, x: Int): Int { return f(f(x)); }\nfn inc(x: Int): Int { return x + 1; }\nfn main(): Int { return twice(inc, 1); }", "3"},
+        {"fn main(): Int {\n    let total = 0;\n    for (let i = 0; i < 10; i = i + 1) { total = total + i; }\n    let j = 0;\n    while (j < 5) { j = j + 1; total = total + j; }\n    return total;\n}", "60"},
+        {"fn main(): Int {\n    let i = 0;\n    while (true) { i = i + 1; if (i == 7) break; }\n    return i;\n}", "7"},
+        {"struct Point { x: Double; y: Double; }\nfn main(): Point {\n    let p = Point { y: 2.0, x: 1.0 };\n    p.x = p.x + p.y;\n    p.y = p.x * p.x;\n    return p;\n}", "Point { x: 3.0, y: 9.0 }"},
+        {"fn main(): Int {\n    let a = [1, 2, 3];\n    a[0] = a[1] * a[2];\n    return a[0] + a[0];\n}", "12"},
+        {"union Shape { Circle(Double), Square(Double), Empty }\nfn area(s: Shape): Double {\n    switch (s) {\n        case Circle(r): return r * r * 3.0;\n        case Square(w): return w * w;\n        case Empty: return 0.0;\n    }\n}\nfn main(): Double { return area(Circle(2.0)) + area(Square(3.0)) + area(Empty); }", "21.0"},
+        {"fn swap(n: Int): Int {\n    let a = 1;\n    let b = 2;\n    for (let i = 0; i < n; i = i + 1) { let t = a; a = b; b = t; }\n    return a * 10 + b;\n}\nfn main(): Int { return swap(3); }", "21"},
+        {"fn div(a: Int, b: Int): Int {\n    return a / b;\n}\nfn main(): Int { return div(1, 0); }", "[line 3] runtime error in div: integer division by zero"},
+        {"fn main(): Int {\n    let unused = 1 / 0;\n    return 2;\n}", "[line 3] runtime error in main: integer division by zero"},
+    };
+    for(auto& program : programs)
+    {
+        for(int level = 0; level <= 2; level++) BOOST_CHECK_EQUAL(runOptimized(program.first, level), program.second);
+    }
+}
+BOOST_AUTO_TEST_CASE(opt_test_constants)
+{
+    //the branch that cannot be taken is gone, along with the arithmetic that decided it
+    auto module = optimized("fn f(x: Int): Int {\n    let k = 2 * 3;\n    if (k == 6) return x + k;\n    return 0;\n}", 1);
+    BOOST_REQUIRE(module != nullptr);
+    auto& f = module->functions[1];
+    BOOST_CHECK_EQUAL(f.blocks.size(), 1);
+    BOOST_CHECK_EQUAL(count(f, pilaf::IR_BRANCH), 0);
+    BOOST_CHECK_EQUAL(count(f, pilaf::IR_MUL), 0);
+    BOOST_CHECK_EQUAL(count(f, pilaf::IR_ADD), 1);
+    //nothing changes without optimization
+    module = optimized("fn f(x: Int): Int {\n    let k = 2 * 3;\n    if (k == 6) return x + k;\n    return 0;\n}", 0);
+    BOOST_REQUIRE(module != nullptr);
+    BOOST_CHECK_EQUAL(count(module->functions[1], pilaf::IR_MUL), 1);
+}
+BOOST_AUTO_TEST_CASE(opt_test_dead_code)
+{
+    auto module = optimized("fn f(x: Int): Int {\n    let unused = x * 7;\n    let kept = 7 / x;\n    return x;\n}", 1);
+    BOOST_REQUIRE(module != nullptr);
+    //a division may fail, so it stays even though its value is unused
+    BOOST_CHECK_EQUAL(count(module->functions[1], pilaf::IR_MUL), 0);
+    BOOST_CHECK_EQUAL(count(module->functions[1], pilaf::IR_DIV), 1);
+}
+BOOST_AUTO_TEST_CASE(opt_test_values)
+{
+    auto module = optimized("fn f(x: Int, y: Int): Int { return (x + y) * (y + x); }", 2);
+    BOOST_REQUIRE(module != nullptr);
+    BOOST_CHECK_EQUAL(count(module->functions[1], pilaf::IR_ADD), 1);
+    //a load is reused until something may store to it
+    module = optimized("struct P { x: Int; y: Int; }\nfn f(p: P): Int {\n    let a = p.x + p.x;\n    p.y = 1;\n    let b = p.x;\n    p.x = 2;\n    return a + b + p.x;\n}", 2);
+    BOOST_REQUIRE(module != nullptr);
+    BOOST_CHECK_EQUAL(count(module->functions[1], pilaf::IR_GETFIELD), 1);
+    //adding strings concatenates them, which does not commute
+    module = optimized("fn f(x: String, y: String): String {\n    let a = x + y;\n    let b = y + x;\n    return a + b;\n}", 2);
+    BOOST_REQUIRE(module != nullptr);
+    BOOST_CHECK_EQUAL(count(module->functions[1], pilaf::IR_ADD), 3);
+}
+BOOST_AUTO_TEST_CASE(opt_test_loops)
+{
+    auto module = optimized("fn f(n: Int, a: Int, b: Int): Int {\n    let t = 0;\n    for (let i = 0; i < n; i = i + 1) { t = t + a * b; }\n    return t;\n}", 2);
+    BOOST_REQUIRE(module != nullptr);
+    auto& f = module->functions[1];
+    //the product is computed in a block that cannot reach itself again
+    uint32_t product = pilaf::irNone;
+    for(uint32_t b = 0; b < f.blocks.size(); b++)
+    {
+        for(auto i : f.blocks[b].instructions) if(f.instructions[i].op == pilaf::IR_MUL) product = b;
+    }
+    BOOST_REQUIRE(product != pilaf::irNone);
+    std::vector<uint32_t> work = {product};
+    std::vector<bool> seen(f.blocks.size(), false);
+    bool cycles = false;
+    while(!work.empty())
+    {
+        auto b = work.back();
+        work.pop_back();
+        std::vector<uint32_t> next;
+        auto n = pilaf::successors(f, b, next);
+        for(size_t k = 0; k < n; k++)
+        {
+            if(next[k] == product) cycles = true;
+            if(!seen[next[k]]) work.push_back(next[k]);
+            seen[next[k]] = true;
+        }
+    }
+    BOOST_CHECK(!cycles);
+    std::string error;
+    BOOST_CHECK(pilaf::verifyIr(*module, error));
+}
+static const pilaf::IrFunction* named(const pilaf::IrModule& module, const std::string& name)
+{
+    for(auto& f : module.functions) if(f.name == name) return &f;
+    return nullptr;
+}
+BOOST_AUTO_TEST_CASE(opt_test_inlining)
+{
+    //operators written as a single block are always inlined, and at level 2 the record one builds
+    //is not even allocated when only its fields are used
+    const std::string vectors = "struct V { x: Double; y: Double; }\nfn (+)(a: V, b: V): V { return V { x: a.x + b.x, y: a.y + b.y }; }\n";
+    auto module = optimized(vectors + "fn f(a: V, b: V): Double { return (a + b).x; }", 1);
+    BOOST_REQUIRE(module != nullptr);
+    BOOST_REQUIRE(named(*module, "f") != nullptr);
+    BOOST_CHECK_EQUAL(count(*named(*module, "f"), pilaf::IR_CALL), 0);
+    module = optimized(vectors + "fn f(a: V, b: V): Double { return (a + b).x; }", 2);
+    BOOST_REQUIRE(module != nullptr);
+    BOOST_CHECK_EQUAL(count(*named(*module, "f"), pilaf::IR_RECORD), 0);
+    BOOST_CHECK_EQUAL(runOptimized(vectors + "fn main(): Double { return (V { x: 1.0, y: 2.0 } + V { x: 3.0, y: 4.0 }).y; }", 1), "6.0");
+    //other functions bigger than the call itself wait for level 2
+    const std::string scale = "fn scale(x: Int, k: Int): Int {\n    let y = x * k;\n    let z = y - k;\n    return y * z + z / k;\n}\nfn g(x: Int): Int { return scale(x, 3) + scale(x, 4); }\n";
+    module = optimized(scale, 1);
+    BOOST_REQUIRE(module != nullptr);
+    BOOST_CHECK_EQUAL(count(*named(*module, "g"), pilaf::IR_CALL), 2);
+    module = optimized(scale, 2);
+    BOOST_REQUIRE(module != nullptr);
+    BOOST_CHECK_EQUAL(count(*named(*module, "g"), pilaf::IR_CALL), 0);
+    //functions that call each other keep calling each other
+    const std::string parity = "fn even(n: Int): Bool { if (n == 0) return true; return odd(n - 1); }\nfn odd(n: Int): Bool { if (n == 0) return false; return even(n - 1); }\n";
+    module = optimized(parity, 2);
+    BOOST_REQUIRE(module != nullptr);
+    BOOST_CHECK_EQUAL(count(*named(*module, "even"), pilaf::IR_CALL), 1);
+    BOOST_CHECK_EQUAL(count(*named(*module, "odd"), pilaf::IR_CALL), 1);
+    BOOST_CHECK_EQUAL(runOptimized(parity + "fn main(): Bool { return even(11); }", 2), "false");
+    //an error in inlined code names the function it was written in
+    module = optimized("fn div(a: Int, b: Int): Int {\n    return a / b;\n}\nfn main(): Int { return div(1, 0); }", 2);
+    BOOST_REQUIRE(module != nullptr);
+    BOOST_CHECK_EQUAL(count(*named(*module, "main"), pilaf::IR_CALL), 0);
+    BOOST_CHECK_EQUAL(runOptimized("fn div(a: Int, b: Int): Int {\n    return a / b;\n}\nfn main(): Int { return div(1, 0); }", 2), "[line 3] runtime error in div: integer division by zero");
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(cbackend_test);
+//builds `body` through C at `level`, runs it and returns what it wrote to stdout and stderr,
+//followed by its exit status when that is not 0
+static std::string buildAndRun(const std::string& body, int level)
+{
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.diagnostics = &engine;
+    options.optLevel = level;
+    auto dir = std::filesystem::temp_directory_path() / "pilaf-test-cbackend";
+    std::filesystem::create_directories(dir);
+    auto exe = (dir / ("program" + std::to_string(level))).string();
+    int status = pilaf::build(vm_test::vmOperators + body, options, exe);
+    if(status != 0) return "(build failed: " + std::to_string(status) + ")";
+    std::string text;
+    auto pipe = popen(("'" + exe + "' 2>&1").c_str(), "r");
+    if(pipe == nullptr) return "(could not run)";
+    char buffer[256];
+    size_t n;
+    while((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) text.append(buffer, n);
+    status = pclose(pipe);
+    std::filesystem::remove(exe);
+    if(WIFEXITED(status) && WEXITSTATUS(status) != 0) text += "exit " + std::to_string(WEXITSTATUS(status));
+    return text;
+}
+BOOST_AUTO_TEST_CASE(cbackend_test_programs)
+{
+    //the native program prints what `pilaf run` prints, errors included
+    const std::pair<const char*, const char*> programs[] = {
+        {"fn fib(n: Int): Int {\n    if (n < 2) return n;\n    return fib(n - 1) + fib(n - 2);\n}\nfn main(): Int { return fib(20); }", "6765\n"},
+        {"fn twice(f: Int -> Int, x: Int): Int { return f(f(x)); }\nfn inc(x: Int): Int { return x + 1; }\nfn main(): Int { return twice(inc, 1); }", "3\n"},
+        {"fn main(): Int {\n    let total = 0;\n    for (let i = 0; i < 10; i = i + 1) { total = total + i; }\n    let j = 0;\n    while (j < 5) { j = j + 1; total = total + j; }\n    return total;\n}", "60\n"},
+        {"struct Point { x: Double; y: Double; }\nfn main(): Point {\n    let p = Point { y: 2.0, x: 1.0 };\n    p.x = p.x + p.y;\n    p.y = p.x * p.x;\n    return p;\n}", "Point { x: 3.0, y: 9.0 }\n"},
+        {"fn main(): Int {\n    let a = [1, 2, 3];\n    a[0] = a[1] * a[2];\n    return a[0] + a[0];\n}", "12\n"},
+        {"union Shape { Circle(Double), Square(Double), Empty }\nfn area(s: Shape): Double {\n    switch (s) {\n        case Circle(r): return r * r * 3.0;\n        case Square(w): return w * w;\n        case Empty: return 0.0;\n    }\n}\nfn main(): Double { return area(Circle(2.0)) + area(Square(3.0)) + area(Empty); }", "21.0\n"},
+        {"fn swap(n: Int): Int {\n    let a = 1;\n    let b = 2;\n    for (let i = 0; i < n; i = i + 1) { let t = a; a = b; b = t; }\n    return a * 10 + b;\n}\nfn main(): Int { return swap(3); }", "21\n"},
+        {"fn main() {\n    let t = (1, 2.5);\n    return t;\n}", "(1, 2.5)\n"},
+        {"union Shape { Circle(Double), Square(Double), Empty }\nfn main(): Shape { return Square(1.5); }", "Square(1.5)\n"},
+        //generic functions get an instance per representation of their arguments
+        {"fn print(x: a): Void;\nfn id(x: a): a { return x; }\nstruct P { x: Int; }\nfn main() {\n    print(id(2) + id(3));\n    print(id(\"a\") + id(\"b\"));\n    print(id(P { x: 4 }));\n    print(id(1.5) == 1.5);\n}", "5\nab\nP { x: 4 }\ntrue\n"},
+        {"let base = 40;\nfn main(): Int { return base + 2; }", "42\n"},
+        {"fn div(a: Int, b: Int): Int {\n    return a / b;\n}\nfn main(): Int { return div(1, 0); }", "[line 3] runtime error in div: integer division by zero\nexit 70"},
+        {"fn main(): Int {\n    let a = [1, 2, 3];\n    return a[3];\n}", "[line 4] runtime error in main: index 3 out of bounds for an array of length 3\nexit 70"},
+        {"fn f(n: Int): Int { return f(n + 1) + 1; }\nfn main(): Int { return f(0); }", "[line 2] runtime error in f: stack overflow\nexit 70"},
+    };
+    for(auto& program : programs)
+    {
+        for(int level : {0, 2}) BOOST_CHECK_EQUAL(buildAndRun(program.first, level), program.second);
+    }
+}
+BOOST_AUTO_TEST_CASE(cbackend_test_output)
+{
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.diagnostics = &engine;
+    //an output ending in .c is the C program itself
+    auto path = (std::filesystem::temp_directory_path() / "pilaf-test-cbackend.c").string();
+    BOOST_REQUIRE_EQUAL(pilaf::build("fn main(): Int { return 1; }", options, path), 0);
+    std::ifstream in(path);
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    BOOST_CHECK(text.find("int main(void)") != std::string::npos);
+    std::filesystem::remove(path);
+    //external functions other than the built-ins have nothing to link against
+    BOOST_CHECK_EQUAL(pilaf::build("fn missing(x: Int): Int;\nfn main(): Int { return missing(1); }", options, path), 65);
+    BOOST_REQUIRE(engine.errorCount() == 1);
+    BOOST_CHECK(engine.all().front().code == pilaf::DIAG_UNSUPPORTED);
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(jit_test);
+//runs `body` at `level` with functions compiled after `threshold` calls and renders main's result,
+//or the runtime error. `compiled` counts the calls made into machine code
+static std::string runJit(const std::string& body, int level, uint32_t threshold, size_t& compiled)
+{
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.diagnostics = &engine;
+    options.optLevel = level;
+    auto module = pilaf::compileBytecode(vm_test::vmOperators + body, options);
+    compiled = 0;
+    if(module == nullptr) return "(compile failed)";
+    pilaf::VM vm(*module);
+    vm.setJitThreshold(threshold);
+    pilaf::Value result;
+    bool ok = vm.run(result);
+    compiled = vm.compiledCalls();
+    if(!ok) return vm.error();
+    return pilaf::valueToString(result, *module);
+}
+BOOST_AUTO_TEST_CASE(jit_test_programs)
+{
+    const char* natives = "fn sqrt(x: Double): Double;\nfn toDouble(x: Int): Double;\nfn toInt(x: Double): Int;\n";
+    //machine code gives what the interpreter gives, errors included
+    const std::pair<std::string, const char*> programs[] = {
+        {"fn fib(n: Int): Int {\n    if (n < 2) return n;\n    return fib(n - 1) + fib(n - 2);\n}\nfn main(): Int { return fib(25); }", "75025"},
+        {"fn swap(n: Int): Int {\n    let a = 1;\n    let b = 2;\n    for (let i = 0; i < n; i = i + 1) { let t = a; a = b; b = t; }\n    return a * 10 + b;\n}\nfn main(): Int { return swap(3) + swap(4); }", "33"},
+        {std::string(natives) + "fn norm(x: Double, y: Double): Double { return sqrt(x * x + y * y); }\nfn main(): Double { return norm(3.0, 4.0); }", "5.0"},
+        {std::string(natives) + "fn mix(a: Int, x: Double, b: Int, y: Double): Int { return toInt(toDouble(a) * x - toDouble(b) * y); }\nfn main(): Int { return mix(3, 2.5, 2, 0.25); }", "7"},
+        {"fn same(x: Double): Int {\n    let n = x / x;\n    if (n == n) return 1;\n    if (n < n) return 2;\n    return 3;\n}\nfn main(): Int { return same(0.0) * 10 + same(1.0); }", "31"},
+        {"infix (%) 7;\nfn q(a: Int, b: Int): Int { return a / b * 100 + a % b; }\nfn main(): Int { return q(0 - 7, 2); }", "-301"},
+        {"fn depth(n: Int): Int {\n    if (n == 0) return 0;\n    return depth(n - 1) + 1;\n}\nfn main(): Int { return depth(60000); }", "60000"},
+        {"fn div(a: Int, b: Int): Int {\n    return a / b;\n}\nfn main(): Int { return div(1, 0); }", "[line 3] runtime error in div: integer division by zero"},
+        {"fn f(n: Int): Int { return f(n + 1) + 1; }\nfn main(): Int { return f(0); }", "[line 2] runtime error in f: stack overflow"},
+        {std::string(natives) + "fn big(x: Double): Int { return toInt(x * x); }\nfn main(): Int { return big(10000000000.0); }", "[line 5] runtime error in big: toInt of a number outside the range of Int"},
+    };
+    for(auto& program : programs)
+    {
+        for(int level : {0, 2})
+        {
+            size_t compiled;
+            BOOST_CHECK_EQUAL(runJit(program.first, level, 0, compiled), program.second);
+            BOOST_CHECK_EQUAL(compiled, 0u);
+            BOOST_CHECK_EQUAL(runJit(program.first, level, 1, compiled), program.second);
+            //at level 2 the functions main calls once may have been inlined into it
+            if(pilaf::Jit::supported() && level == 0) BOOST_CHECK_MESSAGE(compiled > 0, program.first);
+        }
+    }
+}
+BOOST_AUTO_TEST_CASE(jit_test_eligibility)
+{
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.diagnostics = &engine;
+    auto ir = pilaf::compileIr(std::string(vm_test::vmOperators) + "struct P { x: Int; }\nfn fib(n: Int): Int {\n    if (n < 2) return n;\n    return fib(n - 1) + fib(n - 2);\n}\n"
+        "fn getX(p: P): Int { return p.x; }\nfn viaFib(n: Int): Int { return fib(n) + 1; }\nfn viaGetX(n: Int): Int { return getX(P { x: n }); }\n", options);
+    BOOST_REQUIRE(ir != nullptr);
+    pilaf::Jit jit(*ir);
+    auto find = [&](const std::string& name)
+    {
+        for(uint32_t f = 0; f < ir->functions.size(); f++) if(ir->functions[f].name == name) return f;
+        return pilaf::irNone;
+    };
+    bool supported = pilaf::Jit::supported();
+    BOOST_CHECK_EQUAL(jit.qualifies(find("fib")), supported);
+    BOOST_CHECK_EQUAL(jit.qualifies(find("viaFib")), supported);
+    //records stay in the interpreter, and so do the functions that call what uses them
+    BOOST_CHECK(!jit.qualifies(find("getX")));
+    BOOST_CHECK(!jit.qualifies(find("viaGetX")));
+    if(!supported) return;
+    //compiling a function compiles what it calls
+    BOOST_REQUIRE(jit.compile(find("viaFib")));
+    BOOST_CHECK(jit.compiled(find("fib")));
+    uint64_t args[] = {20};
+    uint64_t result = 0;
+    BOOST_REQUIRE(jit.call(find("fib"), args, 100, result));
+    BOOST_CHECK_EQUAL(result, 6765u);
+    BOOST_CHECK(!jit.call(find("fib"), args, 10, result));
+    BOOST_CHECK_EQUAL(jit.error(), "[line 5] runtime error in fib: stack overflow");
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(match_test);
+static const char* grades = "fn grade(n: Int): Int {\n    switch (n) {\n        case 0..10: return 1;\n        case 10...19: return 2;\n        case 20..30: return 3;\n        case 100: return 4;\n        case _: return 0;\n    }\n    return 9;\n}\n";
+static const char* shapes = "union Shape { Circle(Int), Rect(Int, Int), Empty }\n"
+    "fn area(p: (Shape, Int)): Int {\n    switch (p) {\n        case (Circle(0), _): return 100;\n        case (Circle(r), 1): return r;\n        case (Rect(w, 2), k): return w * k;\n"
+    "        case (Rect(w, h), _): return w * h;\n        case (Empty, k): return k;\n        case (_, _): return 7;\n    }\n    return 9;\n}\n";
+BOOST_AUTO_TEST_CASE(match_test_programs)
+{
+    //the decision tree picks the case testing them in order would pick, in every backend
+    const std::pair<std::string, const char*> programs[] = {
+        {"fn digit(n: Int): Int {\n    switch (n) {\n        case 0: return 10;\n        case 1: return 11;\n        case 2: return 12;\n        case 3: return 13;\n        case 4: return 14;\n        case 7: return 17;\n        case _: return 0 - 1;\n    }\n    return 9;\n}\n"
+            "fn main(): Int {\n    let s = 0;\n    for (let i = 0 - 1; i < 9; i = i + 1) { s = s * 3 + digit(i); }\n    return s;\n}", "83039"},
+        {std::string(grades) + "fn main(): Int { return grade(0 - 1) * 1000000 + grade(9) * 100000 + grade(10) * 10000 + grade(19) * 1000 + grade(29) * 100 + grade(30) * 10 + grade(100); }", "122304"},
+        {std::string(shapes) + "fn main(): Int { return area((Circle(0), 1)) + area((Circle(5), 1)) * 1000 + area((Circle(5), 2)) * 10 + area((Rect(3, 2), 4)) + area((Rect(3, 4), 5)) * 100 + area((Empty, 9)); }", "6391"},
+        {"fn word(s: String): Int {\n    switch (s) {\n        case \"one\": return 1;\n        case \"two\": return 2;\n        case _: return 0;\n    }\n    return 9;\n}\nfn main(): Int { return word(\"two\") * 100 + word(\"x\") * 10 + word(\"one\"); }", "201"},
+        {"fn flag(b: Bool): Int {\n    switch (b) {\n        case true: return 1;\n        case false: return 2;\n    }\n    return 9;\n}\nfn main(): Int { return flag(true) * 10 + flag(false); }", "12"},
+    };
+    for(auto& program : programs)
+    {
+        for(int level : {0, 2})
+        {
+            BOOST_CHECK_EQUAL(opt_test::runOptimized(program.first, level), program.second);
+            size_t compiled;
+            BOOST_CHECK_EQUAL(jit_test::runJit(program.first, level, 1, compiled), program.second);
+        }
+    }
+    BOOST_CHECK_EQUAL(cbackend_test::buildAndRun(programs[0].first, 2), std::string(programs[0].second) + "\n");
+}
+BOOST_AUTO_TEST_CASE(match_test_tables)
+{
+    //dense values jump through a table, and a union's members are told apart with one switch
+    BOOST_CHECK(ir_test::lowerProgramText("fn f(n: Int): Int {\n    switch (n) {\n        case 1: return 5;\n        case 2: return 6;\n        case 3: return 7;\n        case 4: return 8;\n        case _: return 0;\n    }\n    return 9;\n}").find("switch %0, ") != std::string::npos);
+    BOOST_CHECK(ir_test::lowerProgramText(shapes).find("switch") != std::string::npos);
+    //sparse values are searched with comparisons instead
+    BOOST_CHECK(ir_test::lowerProgramText("fn f(n: Int): Int {\n    switch (n) {\n        case 1: return 5;\n        case 1000: return 6;\n        case 1000000: return 7;\n        case _: return 0;\n    }\n    return 9;\n}").find("switch") == std::string::npos);
+}
+BOOST_AUTO_TEST_CASE(match_test_tree)
+{
+    //an Int: 0..9, 5 and anything else. 5 is never reached first
+    std::vector<pilaf::MatchPattern> cases = {
+        {pilaf::MATCH_RANGE, 0, 0, 0, 0, 9, pilaf::CONST_INT, 0, {}},
+        {pilaf::MATCH_RANGE, 0, 0, 0, 5, 5, pilaf::CONST_INT, 0, {}},
+    };
+    pilaf::MatchTree tree;
+    BOOST_REQUIRE(pilaf::compileMatch(cases, 0, 64, tree));
+    BOOST_CHECK(!tree.exhaustive);
+    BOOST_CHECK(tree.reached[0]);
+    BOOST_CHECK(!tree.reached[1]);
+    auto& root = tree.nodes[tree.root];
+    BOOST_CHECK(root.kind == pilaf::MATCH_VALUE);
+    BOOST_REQUIRE_EQUAL(root.edges.size(), 1u);
+    BOOST_CHECK_EQUAL(root.edges[0].low, 0);
+    BOOST_CHECK_EQUAL(root.edges[0].high, 9);
+    cases.push_back({pilaf::MATCH_ANY, 0, 0, 0, 0, 0, pilaf::CONST_INT, 0, {}});
+    BOOST_REQUIRE(pilaf::compileMatch(cases, 0, 64, tree));
+    BOOST_CHECK(tree.exhaustive);
+    BOOST_CHECK(tree.reached[2]);
+    //a tree that outgrows its limit is not built
+    BOOST_CHECK(!pilaf::compileMatch(cases, 0, 1, tree));
+}
+BOOST_AUTO_TEST_CASE(match_test_warnings)
+{
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.diagnostics = &engine;
+    BOOST_REQUIRE(pilaf::compileIr(std::string(vm_test::vmOperators) + "union Shape { Circle(Int), Rect(Int, Int), Empty }\nfn f(s: Shape): Int {\n    switch (s) {\n        case Circle(r): return r;\n        case Empty: return 0;\n    }\n    return 1;\n}\n"
+        "fn g(n: Int): Int {\n    switch (n) {\n        case 0..10: return 1;\n        case 5: return 2;\n        case _: return 3;\n    }\n    return 9;\n}\n", options) != nullptr);
+    BOOST_CHECK_EQUAL(engine.errorCount(), 0u);
+    BOOST_REQUIRE_EQUAL(engine.all().size(), 2u);
+    bool nonexhaustive = false, redundant = false;
+    for(auto& d : engine.all())
+    {
+        nonexhaustive = nonexhaustive || d.code == pilaf::DIAG_NONEXHAUSTIVE_MATCH;
+        redundant = redundant || d.code == pilaf::DIAG_REDUNDANT_CASE;
+    }
+    BOOST_CHECK(nonexhaustive);
+    BOOST_CHECK(redundant);
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(layout_test);
+//a program that builds a value of every record, so that all of them are lowered
+static const char* program = "struct P { a: Bool; b: Int; c: Bool; }\nstruct repr(C) Q { a: Bool; b: Int; c: Bool; }\nstruct Pair a b { first: a; second: b; }\nunion Link { Next(P), End }\nunion Flag { On(Bool), Off, Unknown }\nunion Shape { Circle(Double), Rect(Int, Int), Empty }\nunion repr(C) E { X(Int), Y }\nfn print(x: a): Void;\nfn end(): Link { return End; }\nfn off(): Flag { return Off; }\nfn y(): E { return Y; }\nfn pair(): Pair Int Double { return Pair { first: 1, second: 2.5 }; }\nfn next(l: Link): Int {\n    switch (l) {\n        case Next(p): return p.b;\n        case End: return 0;\n    }\n}\nfn main() {\n    let p = P { a: true, b: 2, c: false };\n    print(p);\n    print(Q { a: false, b: 3, c: true });\n    print(Next(p));\n    print(end());\n    print(On(false));\n    print(off());\n    print(X(5));\n    print(y());\n    print(Rect(1, 2));\n    print(off() == off());\n    print(end() == Next(p));\n    print(pair());\n    return next(Next(p)) * 10 + next(End);\n}";
+static const pilaf::DataLayout& layoutNamed(pilaf::LayoutEngine& engine, const pilaf::IrModule& module, const std::string& name)
+{
+    uint32_t l = 0;
+    while(l < module.layouts.size() && module.layouts[l].name != name) l++;
+    BOOST_REQUIRE(l < module.layouts.size());
+    return engine.ofLayout(l);
+}
+BOOST_AUTO_TEST_CASE(layout_test_sizes)
+{
+    std::shared_ptr<pilaf::IrModule> module;
+    ir_test::lowerProgramText(program, &module);
+    BOOST_REQUIRE(module != nullptr);
+    pilaf::LayoutEngine engine(*module);
+    //the Int goes first and the Bools share its last word, unless the declaration's order is kept
+    auto& p = layoutNamed(engine, *module, "P");
+    BOOST_CHECK_EQUAL(p.size, 16u);
+    BOOST_CHECK_EQUAL(p.offsets[1], 0u);
+    BOOST_CHECK_EQUAL(p.offsets[0], 8u);
+    BOOST_CHECK_EQUAL(p.offsets[2], 9u);
+    auto& q = layoutNamed(engine, *module, "Q");
+    BOOST_CHECK_EQUAL(q.size, 24u);
+    BOOST_CHECK_EQUAL(q.offsets[1], 8u);
+    //a pointer that is never null, or a Bool, leaves room for the other members' tags
+    auto& link = layoutNamed(engine, *module, "Link");
+    BOOST_CHECK_EQUAL(link.size, 8u);
+    BOOST_CHECK_EQUAL(link.tagSize, 0u);
+    BOOST_CHECK_EQUAL(link.dataful, 0u);
+    BOOST_CHECK_EQUAL(layoutNamed(engine, *module, "Flag").size, 1u);
+    //otherwise a byte after the largest payload holds it, or a C int before them
+    auto& shape = layoutNamed(engine, *module, "Shape");
+    BOOST_CHECK_EQUAL(shape.size, 16u);
+    BOOST_CHECK_EQUAL(shape.tagOffset, 8u);
+    BOOST_CHECK_EQUAL(shape.tagSize, 1u);
+    auto& e = layoutNamed(engine, *module, "E");
+    BOOST_CHECK_EQUAL(e.size, 16u);
+    BOOST_CHECK_EQUAL(e.tagOffset, 0u);
+    BOOST_CHECK_EQUAL(e.offsets[0], 8u);
+    //an instance of a generic struct holds its arguments unboxed
+    BOOST_CHECK_EQUAL(layoutNamed(engine, *module, "Pair").size, 32u);
+    bool instantiated = false;
+    for(uint32_t t = 0; t < module->types.size(); t++)
+    {
+        if(pilaf::typeToString(module->types[t]) != "Pair Int Double") continue;
+        instantiated = true;
+        BOOST_CHECK_EQUAL(engine.ofType(t)->size, 16u);
+    }
+    BOOST_CHECK(instantiated);
+}
+BOOST_AUTO_TEST_CASE(layout_test_print)
+{
+    std::shared_ptr<pilaf::IrModule> module;
+    ir_test::lowerProgramText(program, &module);
+    BOOST_REQUIRE(module != nullptr);
+    char* text = nullptr;
+    size_t size = 0;
+    FILE* out = open_memstream(&text, &size);
+    pilaf::printLayouts(*module, out);
+    fclose(out);
+    std::string result(text, size);
+    free(text);
+    BOOST_CHECK(result.find("struct P: 16 bytes, align 8, 8 bytes smaller than in declaration order\n       0  b: Int, Int of 8 bytes\n       8  a: Bool, Bool of 1 byte\n       9  c: Bool, Bool of 1 byte\n          6 bytes of padding\n") != std::string::npos);
+    BOOST_CHECK(result.find("struct Q: 24 bytes, align 8, repr(C)\n") != std::string::npos);
+    BOOST_CHECK(result.find("union Link: 8 bytes, align 8, tag in the unused values of Next\n") != std::string::npos);
+    BOOST_CHECK(result.find("union Shape: 16 bytes, align 8, tag at 8 (1 byte)\n") != std::string::npos);
+    BOOST_CHECK(result.find("  as Pair Int Double: 16 bytes, align 8\n") != std::string::npos);
+}
+BOOST_AUTO_TEST_CASE(layout_test_native)
+{
+    //values of every kind of layout get through the C backend as the interpreter has them
+    const char* expected = "P { a: true, b: 2, c: false }\nQ { a: false, b: 3, c: true }\nNext(P { a: true, b: 2, c: false })\nEnd\nOn(false)\nOff\nX(5)\nY\nRect((1, 2))\ntrue\nfalse\nPair { first: 1, second: 2.5 }\n20\n";
+    for(int level : {0, 2}) BOOST_CHECK_EQUAL(cbackend_test::buildAndRun(program, level), expected);
+}
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE(closure_test);
+//map is inlined and its lambda with it, fold is recursive and gets its lambda in a tail call that
+//takes over main's frame, and adder's lambda is returned, so both of those are made on the heap
+static const char* program = "fn print(x: a): Void;\nfn array(n: Int, value: a): a[];\nfn length(xs: a[]): Int;\n"
+    "fn map(f: Int -> Int, xs: Int[]): Int[] {\n    let out = array(length(xs), 0);\n    for (let i = 0; i < length(xs); i = i + 1) { out[i] = f(xs[i]); }\n    return out;\n}\n"
+    "fn fold(f: Int -> Int -> Int, acc: Int, xs: Int[], i: Int): Int {\n    if (i < length(xs)) return fold(f, f(acc, xs[i]), xs, i + 1);\n    return acc;\n}\n"
+    "fn adder(n: Int): Int -> Int { return lambda(x: Int) { return x + n; }; }\n"
+    "fn main(): Int {\n    let k = 3;\n    let ys = map(lambda(x: Int) { return x * k; }, [1, 2, 3, 4]);\n    print(ys);\n    let add = adder(10);\n    print(add(5));\n    print(add);\n"
+    "    let scale = 2;\n    return fold(lambda(a: Int, x: Int) { return a + x * scale; }, 0, ys, 0);\n}";
+static const pilaf::IrFunction& functionNamed(const pilaf::IrModule& module, const std::string& name)
+{
+    uint32_t f = 0;
+    while(f < module.functions.size() && module.functions[f].name != name) f++;
+    BOOST_REQUIRE(f < module.functions.size());
+    return module.functions[f];
+}
+//runs `body` at `level` and returns what it printed followed by main's result
+static std::string runPrinting(const std::string& body, int level)
+{
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.diagnostics = &engine;
+    options.optLevel = level;
+    auto module = pilaf::compileBytecode(vm_test::vmOperators + body, options);
+    if(module == nullptr) return "(compile failed)";
+    char* text = nullptr;
+    size_t size = 0;
+    FILE* out = open_memstream(&text, &size);
+    pilaf::VM vm(*module, out);
+    pilaf::Value result;
+    bool ok = vm.run(result);
+    fclose(out);
+    std::string printed(text, size);
+    free(text);
+    return printed + (ok ? pilaf::valueToString(result, *module) : vm.error());
+}
+BOOST_AUTO_TEST_CASE(closure_test_capture)
+{
+    for(int level : {0, 1, 2}) BOOST_CHECK_EQUAL(runPrinting(program, level), "[3, 6, 9, 12]\n15\n<fn lambda>\n60");
+    for(int level : {0, 2}) BOOST_CHECK_EQUAL(cbackend_test::buildAndRun(program, level), "[3, 6, 9, 12]\n15\n<fn lambda>\n60\n");
+    //lambdas in lambdas capture through the ones around them, and a capture is the value the
+    //variable had when the lambda was made
+    const char* nested = "fn twice(f: Int -> Int, x: Int): Int { return f(f(x)); }\n"
+        "fn main(): Int {\n    let base = 100;\n    let total = 0;\n    for (let i = 0; i < 10; i = i + 1) {\n"
+        "        let f = lambda(x: Int) {\n            let g = lambda(y: Int) { return y + base + i; };\n            return g(x);\n        };\n"
+        "        total = total + twice(f, 1);\n    }\n    let late = lambda(x: Int) { return x + base; };\n    base = 0;\n    return total + late(1);\n}";
+    for(int level : {0, 2}) BOOST_CHECK_EQUAL(opt_test::runOptimized(nested, level), "2201");
+}
+BOOST_AUTO_TEST_CASE(closure_test_escape)
+{
+    auto module = opt_test::optimized(program, 2);
+    BOOST_REQUIRE(module != nullptr);
+    auto& main = functionNamed(*module, "main");
+    BOOST_CHECK_EQUAL(opt_test::count(main, pilaf::IR_LOCALCLOSURE), 0u);
+    BOOST_CHECK_EQUAL(opt_test::count(main, pilaf::IR_CALLVALUE), 0u);
+    //adder's closure is inlined into main, where it is printed, next to the one fold is given
+    BOOST_CHECK_EQUAL(opt_test::count(main, pilaf::IR_CLOSURE), 2u);
+    BOOST_CHECK_EQUAL(opt_test::count(functionNamed(*module, "adder"), pilaf::IR_CLOSURE), 1u);
+    //without optimization every closure is made on the heap
+    module = opt_test::optimized(program, 0);
+    BOOST_REQUIRE(module != nullptr);
+    BOOST_CHECK_EQUAL(opt_test::count(functionNamed(*module, "main"), pilaf::IR_CLOSURE), 2u);
+}
+BOOST_AUTO_TEST_CASE(closure_test_allocation)
+{
+    //a lambda that does not escape takes nothing from the collected heap however often it is made
+    const char* loop = "fn fold(f: Int -> Int -> Int, acc: Int, n: Int): Int {\n    if (n < 1) return acc;\n    return fold(f, f(acc, n), n - 1);\n}\n"
+        "fn main(): Int {\n    let total = 0;\n    for (let i = 0; i < 1000; i = i + 1) { total = total + fold(lambda(a: Int, x: Int) { return a + x * i; }, 0, 10); }\n    return total;\n}";
+    for(int level : {0, 2})
+    {
+        pilaf::DiagnosticEngine engine;
+        pilaf::CompileOptions options;
+        options.dumpConstraints = false;
+        options.diagnostics = &engine;
+        options.optLevel = level;
+        auto module = pilaf::compileBytecode(vm_test::vmOperators + std::string(loop), options);
+        BOOST_REQUIRE(module != nullptr);
+        pilaf::VM vm(*module);
+        pilaf::Value result;
+        BOOST_REQUIRE(vm.run(result));
+        BOOST_CHECK_EQUAL(pilaf::valueToString(result, *module), "27472500");
+        BOOST_CHECK_EQUAL(vm.allocations(), level == 0 ? 1000u : 0u);
+    }
+}
+BOOST_AUTO_TEST_CASE(closure_test_errors)
+{
+    //captures are copies, so a lambda cannot assign to one
+    pilaf::DiagnosticEngine engine;
+    pilaf::CompileOptions options;
+    options.dumpConstraints = false;
+    options.diagnostics = &engine;
+    BOOST_CHECK(pilaf::compileBytecode(vm_test::vmOperators + std::string("fn main(): Int {\n    let k = 1;\n    let f = lambda(x: Int) { k = x; return x; };\n    return f(2);\n}"), options) == nullptr);
+    BOOST_REQUIRE(engine.errorCount() == 1);
+    BOOST_CHECK(engine.all().front().code == pilaf::DIAG_UNSUPPORTED);
+}
+BOOST_AUTO_TEST_SUITE_END();
+
+BOOST_AUTO_TEST_SUITE(tailcall_test);
+//a hundred million calls deep, through a function calling itself and two calling each other
+static const char* deep = "fn isEven(n: Int): Bool { if (n == 0) return true; return isOdd(n - 1); }\n"
+    "fn isOdd(n: Int): Bool { if (n == 0) return false; return isEven(n - 1); }\n"
+    "fn count(n: Int, acc: Int): Int { if (n == 0) return acc; return count(n - 1, acc + 1); }\n"
+    "fn main(): Int {\n    if (isOdd(100000001)) return count(100000000, 0);\n    return 0;\n}";
+BOOST_AUTO_TEST_CASE(tailcall_test_marked)
+{
+    //only the calls whose result is returned are tail calls: main's of count, not of isOdd
+    auto module = opt_test::optimized(deep, 0);
+    BOOST_REQUIRE(module != nullptr);
+    for(auto name : {"isEven", "isOdd", "count", "main"})
+    {
+        auto& f = closure_test::functionNamed(*module, name);
+        size_t calls = 0;
+        for(uint32_t b = 0; b < f.blocks.size(); b++)
+        {
+            for(auto i : f.blocks[b].instructions) if(pilaf::isTailCall(f, b, i)) calls++;
+        }
+        BOOST_CHECK_EQUAL(calls, 1u);
+    }
+}
+BOOST_AUTO_TEST_CASE(tailcall_test_depth)
+{
+    for(int level : {0, 2}) BOOST_CHECK_EQUAL(opt_test::runOptimized(deep, level), "100000000");
+    for(int level : {0, 2}) BOOST_CHECK_EQUAL(cbackend_test::buildAndRun(deep, level), "100000000\n");
+    size_t compiled;
+    BOOST_CHECK_EQUAL(jit_test::runJit(deep, 2, 1, compiled), "100000000");
+    BOOST_CHECK(compiled > 0);
+}
+BOOST_AUTO_TEST_CASE(tailcall_test_closures)
+{
+    //the frame of a tail call's caller is gone, so a lambda made there and passed on is made on
+    //the heap, while one the caller was given stays where it is
+    const char* loop = "fn loop(f: Int -> Int, n: Int, acc: Int): Int {\n    if (n == 0) return acc;\n    return loop(f, n - 1, f(acc));\n}\n"
+        "fn main(): Int {\n    let k = 3;\n    return loop(lambda(x: Int) { return x + k; }, 1000, 0);\n}";
+    for(int level : {0, 1, 2}) BOOST_CHECK_EQUAL(opt_test::runOptimized(loop, level), "3000");
+    for(int level : {0, 2}) BOOST_CHECK_EQUAL(cbackend_test::buildAndRun(loop, level), "3000\n");
+    auto module = opt_test::optimized(loop, 2);
+    BOOST_REQUIRE(module != nullptr);
+    auto& main = closure_test::functionNamed(*module, "main");
+    BOOST_CHECK_EQUAL(opt_test::count(main, pilaf::IR_CLOSURE), 1u);
+    BOOST_CHECK_EQUAL(opt_test::count(main, pilaf::IR_LOCALCLOSURE), 0u);
+}
+BOOST_AUTO_TEST_CASE(tailcall_test_fresh_closures)
+{
+    //a new capturing lambda at every step still leaves the calls a million deep in one frame
+    const char* step = "fn step(f: Int -> Int, n: Int, acc: Int): Int {\n    if (n == 0) return acc;\n    return step(lambda(x: Int) { return x + n; }, n - 1, f(acc));\n}\n"
+        "fn main(): Int {\n    let k = 1;\n    return step(lambda(x: Int) { return x + k; }, 1000000, 0);\n}";
+    for(int level : {0, 1, 2}) BOOST_CHECK_EQUAL(opt_test::runOptimized(step, level), "500000500000");
+    for(int level : {0, 1, 2}) BOOST_CHECK_EQUAL(cbackend_test::buildAndRun(step, level), "500000500000\n");
+}
+BOOST_AUTO_TEST_SUITE_END();